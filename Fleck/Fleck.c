@@ -40,11 +40,37 @@
 
 //Variables globals
 int gotham_socket = -1;      
+ConnectionParams gotham_params = FRAME_LEGACY_PARAMS;     // Paràmetres de trama acordats amb Gotham en el handshake 0x01
 
 volatile int exit_distortion = 0;                           // Variable global per a forçar la terminació de threads
 volatile int exit_program_flag = 0;                         // Variable global per controlar la sortida del programa, en el cas de Ctrl+C, GothamCrash o Logout
 
 pthread_mutex_t print_mutex = PTHREAD_MUTEX_INITIALIZER;    // Mutex per a la impressió per pantalla
+MuxPool worker_sessions = MUX_EMPTY_POOL;                   // Sessions multiplexades amb els workers, compartides per les distorsions en curs
+
+/*********************************************** 
+* 
+* @Finalidad: Comprobar si un archivo tiene una distorsión en curso según el registro. 
+* 
+* @Parámetros: 
+* in: distortion_record = Puntero a la estructura `DistortionRecord` con el historial de distorsiones. 
+* in: filename = Nombre del archivo. 
+* 
+* @Retorno: 
+*           1 = El archivo tiene una distorsión en curso. 
+*           0 = No la tiene. 
+* 
+************************************************/
+int isDistortionOngoing(DistortionRecord* distortion_record, const char* filename) {
+    int ongoing = 0;
+
+    pthread_mutex_lock(&distortion_record->mutex);
+    for (int i = 0; i < distortion_record->n_distortions && !ongoing; i++) {
+        ongoing = distortion_record->distortions[i].status == ONGOING && !strcmp(distortion_record->distortions[i].filename, filename);
+    }
+    pthread_mutex_unlock(&distortion_record->mutex);
+    return ongoing;
+}
 
 /*********************************************** 
 * 
@@ -54,12 +80,13 @@ pthread_mutex_t print_mutex = PTHREAD_MUTEX_INITIALIZER;    // Mutex per a la im
 * @Parámetros: 
 * in: cmd = Comando de distorsión en formato de cadena que incluye el nombre del archivo y el factor de distorsión. 
 * in: fleck_config = Puntero a la estructura `FleckConfig` que contiene la configuración del fleck
-* in: distortion_context = Array que contiene las estructuras de contexto de distorsión de texto y de media
-* in: main_worker = Array que contiene las estructuras `MainWorker` para Harley y Enigma.
-* in: distortion_threads = Array que contiene los hilos de distorsión de texto y de media
+* in: distortion_context = Array que contiene las estructuras de contexto de distorsión de cada posición
+* in: main_worker = Array que contiene las estructuras `MainWorker` de cada posición.
+* in: distortion_threads = Array que contiene los hilos de distorsión de cada posición
 * in/out: distortion_record = Puntero a la estructura `DistortionRecord` que almacena el historial de distorsiones ralizadas y en curso.
 * in/out: connected_to_gotham = Puntero a un valor entero que indica si hay una conexión activa con el servidor Gotham (1 si está conectado, 0 si no lo está).
-* in/out: distorting_flag = Array que contiene los flags de distorsión de texto y media en curso
+* in/out: distorting_flag = Array que contiene los flags de distorsión en curso de cada posición
+* in/out: finished_distortion = Array que contiene los flags de distorsión finalizada de cada posición
 * 
 * @Retorno: ---
 * 
@@ -73,7 +100,9 @@ void processDistortionCommand(char* cmd, FleckConfig* fleck_config, DistortionCo
     char *cmd_copy = strdup(cmd);
     char *filename = NULL;
     char *extension = NULL;
+    char *type = NULL;
     int factor = 0;
+    int slot = 0;
 
     // Validem la comanda i extraiem el nom del fitxer i factor introduïts
     if (!CMD_isDistortCommandValid(cmd_copy, &filename, &factor, &print_mutex)) {
@@ -97,20 +126,26 @@ void processDistortionCommand(char* cmd, FleckConfig* fleck_config, DistortionCo
         goto cleanup;
     }
 
-    // Gestionar distorsió de text
-    if (strcmp(extension, "Text") == 0) {
-        if (!DIST_prepareAndStartDistortion(&distortion_context[TEXT], filename, fleck_config->username, "Text", &distortion_threads[TEXT], factor, &distorting_flag[TEXT], &main_worker[TEXT], gotham_socket, fleck_config->folder_path, distortion_record, &exit_distortion, &finished_distortion[TEXT], &print_mutex)) {
-            goto cleanup;
-        }
+    // El thread de distorsió conserva el tipus (per demanar un altre worker si cal), així que ha de ser una cadena constant
+    if (strcmp(extension, "Text") == 0) type = "Text";
+    else if (strcmp(extension, "Media") == 0) type = "Media";
+    else goto cleanup;
+
+    // Un mateix fitxer no es pot distorsionar dues vegades alhora (les dues escriurien el mateix fitxer distorsionat)
+    if (isDistortionOngoing(distortion_record, filename)) {
+        STRING_printF(&print_mutex, STDOUT_FILENO, RED, "Error: %s distortion already in progress\n", filename);
+        goto cleanup;
     }
 
-    // Gestionar distorsió de media
-    if (strcmp(extension, "Media") == 0) {
-        if (!DIST_prepareAndStartDistortion(&distortion_context[MEDIA], filename, fleck_config->username, "Media", &distortion_threads[MEDIA], factor, &distorting_flag[MEDIA], &main_worker[MEDIA], gotham_socket, fleck_config->folder_path, distortion_record, &exit_distortion, &finished_distortion[MEDIA], &print_mutex)) {
-            goto cleanup;
-        }
+    // Cada distorsió en curs ocupa una posició (context, worker i thread); les de text i media ja no s'esperen entre elles
+    while (slot < FLECK_MAX_DISTORTIONS && distorting_flag[slot]) slot++;
+    if (slot == FLECK_MAX_DISTORTIONS) {
+        STRING_printF(&print_mutex, STDOUT_FILENO, RED, "Error: %d distortions already in progress, wait for one to finish\n", FLECK_MAX_DISTORTIONS);
+        goto cleanup;
     }
 
+    DIST_prepareAndStartDistortion(&distortion_context[slot], filename, fleck_config->username, type, &distortion_threads[slot], slot, factor, &distorting_flag[slot], &main_worker[slot], gotham_socket, &gotham_params, fleck_config->folder_path, distortion_record, &exit_distortion, &finished_distortion[slot], &print_mutex);
+
 cleanup:
     free(cmd_copy);
     free(filename);
@@ -152,7 +187,7 @@ void connectToServer(char **cmd, int *gotham_alive, pthread_t *monitor_thread, F
     }
 
     // Establir connexió formal amb Gotham
-    if (COMM_connectToGotham(gotham_socket, fleck_config) < 0) {
+    if (COMM_connectToGotham(gotham_socket, fleck_config, &gotham_params) < 0) {
         IO_printStatic(STDOUT_FILENO, RED "Failed to connect to Gotham.\n" RESET);
         free(*cmd); 
         *cmd = NULL; 
@@ -177,22 +212,22 @@ void connectToServer(char **cmd, int *gotham_alive, pthread_t *monitor_thread, F
 *             y el estado actual del proceso. 
 * 
 * @Parámetros: 
-* in: file_type = Tipo de archivo cuya distorsión se está procesando (`TEXT` o `MEDIA`). 
-*             Este valor determina qué contexto de distorsión (texto o media) se usará para calcular el progreso.
-* in: distortion_context = Array que contiene las estructuras de contexto de distorsión para los tipos de archivo (texto y media).
+* in: slot = Posición de la distorsión que se está procesando. 
+*             Este valor determina qué contexto de distorsión se usará para calcular el progreso.
+* in: distortion_context = Array que contiene las estructuras de contexto de distorsión de cada posición.
 * 
 * @Retorno: 
 * Retorna un valor de tipo `float` que representa el porcentaje de progreso de la distorsión, 
 *          expresado en un rango de 0 a 100. 
 ************************************************/
-float getDistortionProgress(int file_type, DistortionContext distortion_context[]) {
+float getDistortionProgress(int slot, DistortionContext distortion_context[]) {
     float processed_packets;
     float total_packets;
     int distortion_stage; 
 
-    processed_packets = file_type == TEXT ? (float) distortion_context[TEXT].n_processed_packets : (float) distortion_context[MEDIA].n_processed_packets;
-    total_packets = file_type == TEXT ? (float) distortion_context[TEXT].n_packets : (float) distortion_context[MEDIA].n_packets; 
-    distortion_stage = file_type == TEXT? distortion_context[TEXT].current_stage : distortion_context[MEDIA].current_stage;
+    processed_packets = (float) distortion_context[slot].n_processed_packets;
+    total_packets = (float) distortion_context[slot].n_packets; 
+    distortion_stage = distortion_context[slot].current_stage;
 
     if(distortion_stage == STAGE_SND_FILE || distortion_stage == STAGE_RCV_METADATA) {
         return (processed_packets * 50) / total_packets;
@@ -212,7 +247,7 @@ float getDistortionProgress(int file_type, DistortionContext distortion_context[
 * in: distortion_record = Puntero a la estructura `DistortionRecord` que contiene el historial de distorsiones 
 *                         realizadas y en curso, incluyendo el estado de cada archivo (completado, fallido, en progreso).
 * in: distortion_context = Array de estructuras `DistortionContext` que contienen la información sobre el progreso 
-*                          de la distorsión para cada tipo de archivo (texto o media).
+*                          de la distorsión de cada posición.
 * 
 * @Retorno: 
 * Ninguno. La función imprime directamente los resultados del estado de las distorsiones en curso o finalizadas en 
@@ -221,18 +256,21 @@ float getDistortionProgress(int file_type, DistortionContext distortion_context[
 ************************************************/
 void checkStatus(DistortionRecord* distortion_record, DistortionContext distortion_context[]) {
     int status; 
-    int file_type;
+    int slot;
     char* filename;
     float progress_percentage;
     int n_progress_chars; 
 
+    // Els threads de distorsió actualitzen l'estat de les seves entrades mentre les recorrem
+    pthread_mutex_lock(&distortion_record->mutex);
     if(distortion_record->n_distortions == 0) {
+        pthread_mutex_unlock(&distortion_record->mutex);
         STRING_printF(&print_mutex, STDOUT_FILENO, YELLOW, "You have no ongoing or finished distortions\n"); 
         return;
     }
     for(int i = 0; i < distortion_record->n_distortions; i++) {
         status = distortion_record->distortions[i].status;
-        file_type = distortion_record->distortions[i].file_type;
+        slot = distortion_record->distortions[i].slot;
         filename = distortion_record->distortions[i].filename;
         if(status == COMPLETED) {
             STRING_printF(&print_mutex, STDOUT_FILENO, GREEN, "%s\t\t100%% |====================|\n", filename); 
@@ -241,7 +279,7 @@ void checkStatus(DistortionRecord* distortion_record, DistortionContext distorti
             STRING_printF(&print_mutex, STDOUT_FILENO, RED, "%s\t\tFAILED TO DISTORT\n", filename); 
         } 
         else {
-            progress_percentage = getDistortionProgress(file_type, distortion_context);
+            progress_percentage = getDistortionProgress(slot, distortion_context);
             STRING_printF(&print_mutex, STDOUT_FILENO, YELLOW, "%s\t\t%d%%  |", filename, (int)progress_percentage);
             n_progress_chars = (int) (progress_percentage * 20.0f / 100.0f);
             for(int j = 0; j < 20; j++) {
@@ -255,6 +293,7 @@ void checkStatus(DistortionRecord* distortion_record, DistortionContext distorti
             STRING_printF(&print_mutex, STDOUT_FILENO, YELLOW, "|\n"); 
         }
     }
+    pthread_mutex_unlock(&distortion_record->mutex);
 }
 
 /*********************************************** 
@@ -269,12 +308,13 @@ void checkStatus(DistortionRecord* distortion_record, DistortionContext distorti
 *                          encargado de monitorear la conexión con Gotham.
 * in: fleck_config = Puntero a la estructura `FleckConfig` que contiene la configuración de fleck
 * in: distortion_context = Array de estructuras `DistortionContext` que contienen la información sobre el progreso 
-*                          de la distorsión para cada tipo de archivo (texto y media).
-* in: main_worker = Array que contiene las estructuras `MainWorker` para Harley y Enigma.
+*                          de la distorsión de cada posición.
+* in: main_worker = Array que contiene las estructuras `MainWorker` de cada posición.
 * in/out: distortion_record = Puntero a la estructura `DistortionRecord` que almacena el historial de distorsiones realizadas y en curso.
-* in/out: distortion_threads = Array que contiene los identificadores de los hilos de distorsión de texto y de media.
+* in/out: distortion_threads = Array que contiene los identificadores de los hilos de distorsión de cada posición.
 * in/out: connected_to_gotham = Puntero a un valor entero que indica si hay una conexión activa con el servidor Gotham (1 si está conectado, 0 si no).
-* in/out: distorting_flag = Array que contiene los flags de distorsión en curso de tipo texto y media.
+* in/out: distorting_flag = Array que contiene los flags de distorsión en curso de cada posición.
+* in/out: finished_distortion = Array que contiene los flags de distorsión finalizada de cada posición.
 * 
 * @Retorno: ---
 * 
@@ -369,30 +409,34 @@ void terminateMonitoringThread(pthread_t* monitor_thread) {
 
 /*********************************************** 
 * 
-* @Finalidad: Manejar la desconexión de Gotham al finalizar un proceso de distorsión, 
-*             asegurándose de cerrar el socket y el hilo de monitoreo si no hay otras 
-*             distorsiones en curso. 
+* @Finalidad: Manejar la desconexión de Gotham al finalizar procesos de distorsión, 
+*             asegurándose de cerrar el socket, el hilo de monitoreo y las sesiones 
+*             multiplexadas con los workers si no hay otras distorsiones en curso. 
 * 
 * @Parámetros: 
 * in: distorting_flag[] = Array de banderas que indican si hay procesos de distorsión en curso. 
 * in: fleck_config = Configuración del fleck (no utilizado en esta función). 
 * in/out: monitor_thread = Puntero al identificador del hilo de monitoreo que será terminado si se cierra la conexión. 
 * in/out: finished_distortion = Array que indica los estados de finalización de los procesos de distorsión. 
-* in: finished_type = Tipo de distorsión que ha finalizado (`TEXT` o `MEDIA`). 
 * in/out: connected_to_gotham = Bandera que indica si la conexión con Gotham sigue activa. 
 * 
 * @Retorno: Ninguno. 
 * 
 ************************************************/
-void handleGothamDisconnection(int distorting_flag[], FleckConfig fleck_config __attribute__((unused)),pthread_t* monitor_thread, int* finished_distortion, int finished_type, int* connected_to_gotham) {
-    int alternate_type = finished_type == TEXT ? MEDIA : TEXT;
-    // Si la distorsió oposada a la que ha acabat no es troba en progrés tanquem la connexió amb gotham
-    if(!distorting_flag[alternate_type]) {
+void handleGothamDisconnection(int distorting_flag[], FleckConfig fleck_config __attribute__((unused)),pthread_t* monitor_thread, int* finished_distortion, int* connected_to_gotham) {
+    int distorting = 0;
+
+    for (int i = 0; i < FLECK_MAX_DISTORTIONS; i++) {
+        finished_distortion[i] = 0;
+        distorting |= distorting_flag[i];
+    }
+    // Si no queda cap altra distorsió en progrés tanquem la connexió amb gotham i les sessions amb els workers
+    if(!distorting) {
         SOCKET_closeSocket(&gotham_socket);
         terminateMonitoringThread(monitor_thread);
         *connected_to_gotham = 0;
+        MUX_destroyPool(&worker_sessions, NULL);
     }
-    finished_distortion[finished_type] = 0;
 }
 
 /*********************************************** 
@@ -417,17 +461,18 @@ int main(int argc, char** argv) {
     int gotham_alive = 1; 
     pthread_t monitor_thread = 0;               // Thread per a la connexió al monitoreig de Gotham
     
-    pthread_t distortion_threads[2] = {0, 0};   // Threads per a distorsió de text i media respectivament
+    pthread_t distortion_threads[FLECK_MAX_DISTORTIONS] = {0};   // Thread de la distorsió de cada posició
     FleckConfig fleck_config;                   // Variable per a la configuració de Fleck
-    DistortionContext distortion_context[2] = {{NULL, NULL, NULL, NULL, 0, 0, 0, 0, 0}, {NULL, NULL, NULL, NULL, 0, 0, 0, 0, 0}};
-    MainWorker main_worker[2] = {{NULL, -1, -1}, {NULL, -1, -1}};
-    DistortionRecord distortion_record = {0, NULL}; 
-    int distorting_flag[2] = {0, 0};
-    int finished_distortion[2] = {0, 0};
+    DistortionContext distortion_context[FLECK_MAX_DISTORTIONS];
+    MainWorker main_worker[FLECK_MAX_DISTORTIONS];
+    DistortionRecord distortion_record = {0, NULL, PTHREAD_MUTEX_INITIALIZER}; 
+    int distorting_flag[FLECK_MAX_DISTORTIONS] = {0};
+    int finished_distortion[FLECK_MAX_DISTORTIONS] = {0};
     int connected_to_gotham = 0; 
 
     signal(SIGUSR1, handle_thread_signal); 
     signal(SIGINT, sigint_handler);
+    signal(SIGPIPE, SIG_IGN);   // Si el worker cau mentre li enviem un fitxer, el send retorna error i ens podem reconnectar al nou worker principal
 
     STRING_initScreenMutex(print_mutex);
 
@@ -439,25 +484,40 @@ int main(int argc, char** argv) {
     //Carregar configuració del fitxer
     if(LOAD_loadConfigFile(argv[1], &fleck_config, FLECK_CONF) == LOAD_FAILURE) exit(EXIT_FAILURE);
     LOAD_printConfig(&fleck_config, FLECK_CONF);
+    COMM_setStatistics(fleck_config.statistics);
+    SOCKET_configure(&fleck_config.socket_options);
+
+    // La finestra d'enviament de fitxers, les capacitats que s'ofereixen als workers, el motor d'E/S, les connexions per fitxer i les sessions multiplexades les fixa la configuració de Fleck
+    for (int i = 0; i < FLECK_MAX_DISTORTIONS; i++) {
+        distortion_context[i] = (DistortionContext) {NULL, NULL, NULL, NULL, 0, 0, 0, 0, 0, DATA_SIZE, SACK_EMPTY_MAP, 0, {{0, 0, 0}}, HASH_EMPTY, MERKLE_EMPTY_TREE};
+        main_worker[i] = (MainWorker) {NULL, -1, -1, FRAME_LEGACY_PARAMS, FRAME_EMPTY_POOL, FRAME_EMPTY_READER, 1, NULL, 0, {0, 0, 0, 0, 0, 0}};
+        main_worker[i].params.window_size = fleck_config.window_size;
+        main_worker[i].params.local.window_size = fleck_config.window_size;
+        main_worker[i].params.local.capabilities = fleck_config.capabilities;
+        main_worker[i].params.io_engine = fleck_config.io_engine;
+        main_worker[i].stripes = fleck_config.stripes;
+        main_worker[i].sessions = fleck_config.socket_options.multiplex ? &worker_sessions : NULL;
+    }
 
     while (!exit_program_flag) {
         STRING_printF(&print_mutex, STDOUT_FILENO, RESET, "$ ");
-        command = IO_nonBlockingReadUntil(STDIN_FILENO, '\n', &exit_program_flag, &finished_distortion[TEXT], &finished_distortion[MEDIA]);
+        command = IO_nonBlockingReadUntil(STDIN_FILENO, '\n', &exit_program_flag, finished_distortion, FLECK_MAX_DISTORTIONS);
         if(!command) {
             if(exit_program_flag) break;
-            handleGothamDisconnection(distorting_flag, fleck_config, &monitor_thread, finished_distortion, finished_distortion[TEXT] ? TEXT : MEDIA, &connected_to_gotham);
+            handleGothamDisconnection(distorting_flag, fleck_config, &monitor_thread, finished_distortion, &connected_to_gotham);
             continue;
         } 
         commandHandler(command, &gotham_alive, &monitor_thread, &fleck_config, distortion_context, main_worker, &distortion_record, distortion_threads, &connected_to_gotham, distorting_flag, finished_distortion);
     }
     
-    for(int i = 0; i < 2; i++) {
-        pthread_join(distortion_threads[i], NULL);
+    for(int i = 0; i < FLECK_MAX_DISTORTIONS; i++) {
+        if (distortion_threads[i]) pthread_join(distortion_threads[i], NULL);
     }
 
     terminateMonitoringThread(&monitor_thread);
+    MUX_destroyPool(&worker_sessions, NULL);
 
-    EXIT_freeMemory(&fleck_config, &distortion_context[TEXT], &distortion_context[MEDIA], &main_worker[TEXT], &main_worker[MEDIA], &distortion_record);
+    EXIT_freeMemory(&fleck_config, distortion_context, main_worker, FLECK_MAX_DISTORTIONS, &distortion_record);
     STRING_destroyScreenMutex(print_mutex);
     return 0;
 }
\ No newline at end of file
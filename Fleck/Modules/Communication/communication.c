@@ -14,6 +14,8 @@
 
 #include "communication.h"
 
+static pthread_mutex_t connection_mutex = PTHREAD_MUTEX_INITIALIZER;  // Les distorsions comparteixen el socket de Gotham i les sessions amb els workers: cada thread demana el worker i s'hi connecta sense intercalar-se amb un altre
+
 /*********************************************** 
 * 
 * @Finalidad: Obtener la dirección IP y el puerto local asociados a un socket específico. 
@@ -56,19 +58,19 @@ int COMM_getFleckIpAndPort(int socket_fd, char *ip_buffer, size_t ip_buffer_size
 * 
 * @Finalidad: Enviar una trama de conexión desde el proceso Fleck al servidor Gotham. 
 *             La trama incluye el nombre de usuario, la dirección IP y el puerto local 
-*             del proceso Fleck. 
+*             del proceso Fleck, y las capacidades que ofrece. 
 * 
 * @Parámetros: 
 * in: gotham_socket = Descriptor del socket conectado al servidor Gotham. 
 * in: config = Puntero a la configuración del proceso Fleck que contiene el nombre de usuario. 
+* in: offer = Capacidades que el fleck anuncia a Gotham. 
 * 
 * @Retorno: Retorna un entero que indica el estado de la operación:
 *           0 = Operación exitosa. La trama de conexión se ha enviado correctamente. 
 *          -1 = Error al obtener la IP y el puerto, crear la trama o enviarla. 
 * 
 ************************************************/
-int COMM_sendConnectionFrame(int gotham_socket, FleckConfig *config) {
-    char *data;
+int COMM_sendConnectionFrame(int gotham_socket, FleckConfig *config, const ConnectionOffer *offer) {
     char local_ip[INET_ADDRSTRLEN];
     int local_port; 
 
@@ -78,25 +80,21 @@ int COMM_sendConnectionFrame(int gotham_socket, FleckConfig *config) {
         return -1;
     }
 
-    //creem la cadena amb el username, IP i port del fleck
-    if (asprintf(&data, "%s&%s&%d", config->username, local_ip, local_port) == -1) {
-        IO_printStatic(STDOUT_FILENO, "Error: The connection string has not been created.\n");
-        return -1;  
+    //afegim el username, IP, port del fleck i les capacitats que oferim (un Gotham v1 les ignora)
+    Metadata metadata;
+    METADATA_init(&metadata);
+    METADATA_setString(&metadata, METADATA_USERNAME, config->username);
+    METADATA_setString(&metadata, METADATA_IP, local_ip);
+    METADATA_setNumber(&metadata, METADATA_PORT, (uint32_t)local_port);
+    COMM_setOfferMetadata(&metadata, offer);
+
+    //encara no sabem si Gotham és antic, així que la trama de connexió va en text
+    if (COMM_sendMetadata(gotham_socket, 0x01, &metadata, METADATA_MSG_FLECK_CONNECTION, NULL) < 0) {
+        IO_printStatic(STDOUT_FILENO, "Error: The connection frame has not been sent.\n");
+        return -1;
     }
-    
-    //creem la trama de connexió
-    Frame *connect_frame = FRAME_createFrame(0x01, data, strlen(data));
-    
-    //enviem la trama de connexió a Gotham
-    int result = FRAME_sendFrame(gotham_socket, connect_frame);
-
-    //destruïm la trama 
-    FRAME_destroyFrame(connect_frame);
 
-    //alliberem la memòria assignada per asprintf
-    free(data);
-    
-    return result; 
+    return 0; 
 }
 
 /*********************************************** 
@@ -107,6 +105,7 @@ int COMM_sendConnectionFrame(int gotham_socket, FleckConfig *config) {
 * @Parámetros: 
 * in: gotham_socket = Descriptor del socket conectado al servidor Gotham. 
 * in: config = Puntero a la configuración del proceso Fleck que contiene el nombre de usuario. 
+* out: gotham_params = Parámetros de trama acordados con Gotham (v1 si Gotham no los negocia). 
 * 
 * @Retorno: Retorna un entero que indica el estado de la operación:
 *           0 = Conexión establecida correctamente con Gotham. 
@@ -114,9 +113,16 @@ int COMM_sendConnectionFrame(int gotham_socket, FleckConfig *config) {
 *               o verificación de la respuesta del servidor. 
 * 
 ************************************************/
-int COMM_connectToGotham(int gotham_socket, FleckConfig *config) {
-    //enviem trama de connexió (username, IP i port)
-    if (COMM_sendConnectionFrame(gotham_socket, config) < 0) {
+int COMM_connectToGotham(int gotham_socket, FleckConfig *config, ConnectionParams *gotham_params) {
+    //a Gotham li oferim el mateix que als workers segons la configuració
+    ConnectionOffer offer;
+    FRAME_initLegacyParams(gotham_params);
+    gotham_params->local.window_size = config->window_size;
+    gotham_params->local.capabilities = config->capabilities;
+    COMM_getLocalOffer(gotham_socket, gotham_params, &offer);
+
+    //enviem trama de connexió (username, IP, port i capacitats)
+    if (COMM_sendConnectionFrame(gotham_socket, config, &offer) < 0) {
         //IO_printStatic(STDOUT_FILENO, RED "Unable to send connection frame to Gotham.\n" RESET);       
         return -1;  
     }
@@ -131,16 +137,23 @@ int COMM_connectToGotham(int gotham_socket, FleckConfig *config) {
     Frame *frame = result.frame;    
     //verifiquem la resposta de Gotham
     if (frame->type == 0x01) {
-        if (frame->data_length == 0) {
-            IO_printFormat(STDOUT_FILENO, GREEN "%s connected to Mr. J System. Let the chaos begin!:)\n" RESET, config->username); //gotham ha retornat OK
-            FRAME_destroyFrame(frame);
-
-            return 0;  
-        }
         if (frame->data_length > 0 && strcmp((char *)frame->data, "CON_KO") == 0) {
             FRAME_destroyFrame(frame); //gotham ha retornat KO
             return -1;  
         }
+
+        //gotham ha retornat OK. Si la resposta porta la combinació escollida, Gotham accepta trames v2
+        Metadata response;
+        ConnectionOffer chosen;
+        if (METADATA_decode(frame->data, frame->data_length, METADATA_MSG_CONNECTION_RESPONSE, &response) < 0) {
+            METADATA_init(&response);
+        }
+        COMM_getOfferMetadata(&response, &chosen);
+        FRAME_negotiate(&chosen, &offer, gotham_params);
+        IO_printFormat(STDOUT_FILENO, GREEN "%s connected to Mr. J System. Let the chaos begin!:)\n" RESET, config->username);
+        FRAME_destroyFrame(frame);
+
+        return 0;  
     }
 
     //gotham no ha rebut la trama correctament i ha enviat errorFrame
@@ -161,9 +174,10 @@ int COMM_connectToGotham(int gotham_socket, FleckConfig *config) {
 *             solicitud es una reconexión o una nueva petición de trabajo. 
 * 
 * @Parámetros: 
-* in: data = Cadena de datos que contiene la información necesaria para la solicitud. 
-*           Este puntero se libera internamente tras enviar la solicitud. 
+* in: media_type = Tipo de medio solicitado (e.g., "Media", "Text"). 
+* in: filename = Nombre del archivo a procesar. 
 * in: gotham_socket = Descriptor del socket conectado al servidor Gotham. 
+* in: gotham_params = Parámetros de trama acordados con Gotham. 
 * in: reconnecting = Indicador de si la solicitud corresponde a una reconexión (1) 
 *                    o a una nueva petición de trabajo (0). 
 * 
@@ -172,13 +186,13 @@ int COMM_connectToGotham(int gotham_socket, FleckConfig *config) {
 *          -1 = Error al crear o enviar la trama al servidor Gotham. 
 * 
 ************************************************/
-int COMM_sendWorkerRequestToGotham(char *data, int gotham_socket, int reconnecting) {
-    Frame *request_frame = FRAME_createFrame(reconnecting? 0x11 : 0x10, data, strlen(data));
-    int result = FRAME_sendFrame(gotham_socket, request_frame);
+int COMM_sendWorkerRequestToGotham(const char *media_type, const char *filename, int gotham_socket, const ConnectionParams *gotham_params, int reconnecting) {
+    Metadata metadata;
+    METADATA_init(&metadata);
+    METADATA_setString(&metadata, METADATA_MEDIA_TYPE, media_type);
+    METADATA_setString(&metadata, METADATA_FILENAME, filename);
 
-    FRAME_destroyFrame(request_frame);
-    free(data);
-    return result;
+    return COMM_sendMetadata(gotham_socket, reconnecting ? 0x11 : 0x10, &metadata, METADATA_MSG_DISTORT_REQUEST, gotham_params);
 }
 
 /*********************************************** 
@@ -190,21 +204,25 @@ int COMM_sendWorkerRequestToGotham(char *data, int gotham_socket, int reconnecti
 * @Parámetros: 
 * in: result_frame = Puntero a la estructura `FrameResult` que contiene la trama de respuesta 
 *                    del servidor Gotham y el código de error asociado. 
-* out: data_buffer = Puntero al buffer donde se almacenará temporalmente la respuesta recibida. 
-*                    La memoria asignada se debe liberar externamente cuando ya no se use. 
+* out: response_frame = Puntero donde se guardará la trama de respuesta, a la que apunta 
+*                       `worker_ip`. Se debe liberar externamente cuando ya no se use. 
 * out: worker_ip = Puntero donde se almacenará la dirección IP del worker asignado. 
 * out: worker_port = Puntero donde se almacenará el puerto del worker asignado. 
+* out: worker_data_size = Tamaño de datos que acepta el worker en tramas v2, o 0 si el 
+*                         worker (o Gotham) es antiguo. 
+* out: worker_candidates = Workers alternativos del mismo tipo (`ip:puerto` separados por 
+*                          comas) que apuntan a la trama de respuesta, o NULL si no hay. 
 * in: type = Tipo de archivo o tarea solicitada (e.g., "media", "text"). 
 * in: reconnecting = Indicador de si la solicitud era una reconexión (1) o una nueva petición (0). 
 * in: print_mutex = Mutex para garantizar la exclusión mutua al imprimir mensajes de error. 
 * 
 * @Retorno: Retorna un entero que indica el estado de la operación:
 *           0 = Operación exitosa. Se ha obtenido la dirección IP y el puerto del worker. 
-*          -1 = Error en la recepción de la respuesta, en la asignación de memoria, o si no hay 
+*          -1 = Error en la recepción de la respuesta, respuesta malformada, o si no hay 
 *               workers disponibles o soportan el tipo de archivo solicitado. 
 * 
 ************************************************/
-int COMM_processGothamResponse(FrameResult *result_frame, char **data_buffer, char **worker_ip, int *worker_port, const char* type, int reconnecting, pthread_mutex_t *print_mutex) {
+int COMM_processGothamResponse(FrameResult *result_frame, Frame **response_frame_out, const char **worker_ip, int *worker_port, uint32_t *worker_data_size, const char **worker_candidates, const char* type, int reconnecting, pthread_mutex_t *print_mutex) {
     if (result_frame->error_code != FRAME_SUCCESS) {
         STRING_printF(print_mutex, STDOUT_FILENO, RED, "Error: Failed to receive response from Gotham.\n");
         return -1;
@@ -227,19 +245,19 @@ int COMM_processGothamResponse(FrameResult *result_frame, char **data_buffer, ch
         }
 
         //si arribem aquí significa que hem rebut la ip i port del worker
-        *data_buffer = strdup((char *)response_frame->data);  //copiem les dades de la trama a buffer auxiliar
-        if (!*data_buffer) {
-            STRING_printF(print_mutex, STDOUT_FILENO, RED, "Error: Could not allocate memory for response.\n");
+        Metadata assignment;
+        if (METADATA_decode(response_frame->data, response_frame->data_length, METADATA_MSG_WORKER_ASSIGNMENT, &assignment) < 0) {
+            STRING_printF(print_mutex, STDOUT_FILENO, RED, "Error: Malformed worker details received from Gotham.\n");
             FRAME_destroyFrame(response_frame);
             return -1;
         }
 
-        //extreiem la IP i el port del worker
-        *worker_ip = strtok(*data_buffer, "&"); 
-        char *worker_port_str = strtok(NULL, "&");
-        *worker_port = atoi(worker_port_str); 
-
-        FRAME_destroyFrame(response_frame);
+        //la IP apunta a les dades de la trama, que es conserva fins que ja no es necessita
+        *worker_ip = METADATA_getString(&assignment, METADATA_IP);
+        *worker_port = (int)METADATA_getNumber(&assignment, METADATA_PORT, 0);
+        *worker_data_size = METADATA_getNumber(&assignment, METADATA_DATA_SIZE, 0);
+        *worker_candidates = METADATA_getString(&assignment, METADATA_CANDIDATES);
+        *response_frame_out = response_frame;
         return 0;  
     }
 
@@ -255,13 +273,16 @@ int COMM_processGothamResponse(FrameResult *result_frame, char **data_buffer, ch
 *             del worker asignado. 
 * 
 * @Parámetros: 
-* out: data_buffer = Puntero al buffer donde se almacenará temporalmente la respuesta recibida. 
-*                    La memoria asignada se debe liberar externamente cuando ya no se use. 
+* out: response_frame = Puntero donde se guardará la trama de respuesta de Gotham, a la 
+*                       que apunta `worker_ip`. Se debe liberar externamente cuando ya no se use. 
 * out: worker_ip = Puntero donde se almacenará la dirección IP del worker asignado. 
 * out: worker_port = Puntero donde se almacenará el puerto del worker asignado. 
+* out: worker_data_size = Tamaño de datos que acepta el worker en tramas v2 (0 si es antiguo). 
+* out: worker_candidates = Workers alternativos del mismo tipo, o NULL si no hay. 
 * in: media_type = Tipo de medio solicitado (e.g., "media", "text"). 
 * in: filename = Nombre del archivo a procesar. 
 * in: gotham_socket = Descriptor del socket conectado al servidor Gotham. 
+* in: gotham_params = Parámetros de trama acordados con Gotham. 
 * in: reconnecting = Indicador de si la solicitud es una reconexión (1) o una nueva petición (0). 
 * in: print_mutex = Mutex para garantizar la exclusión mutua al imprimir mensajes de error. 
 * 
@@ -271,23 +292,16 @@ int COMM_processGothamResponse(FrameResult *result_frame, char **data_buffer, ch
 *               de la respuesta del servidor Gotham. 
 * 
 ************************************************/
-int COMM_requestWorkerAndProcessResponse(char** data_buffer, char** worker_ip, int* worker_port, const char* media_type, const char* filename, int gotham_socket, int reconnecting, pthread_mutex_t *print_mutex) {
-    char *data = NULL;
-
-    // Creem camp de dades de la trama
-    if (asprintf(&data, "%s&%s", media_type, filename) == -1) {
-        STRING_printF(print_mutex, STDOUT_FILENO, RED, "Error: Could not allocate memory for the request.\n");
-        return -1;
-    }
-
+int COMM_requestWorkerAndProcessResponse(Frame** response_frame, const char** worker_ip, int* worker_port, uint32_t* worker_data_size, const char** worker_candidates, const char* media_type, const char* filename, int gotham_socket, const ConnectionParams *gotham_params, int reconnecting, pthread_mutex_t *print_mutex) {
     // Enviem petició a Gotham
-    if (COMM_sendWorkerRequestToGotham(data, gotham_socket, reconnecting) < 0) {
+    if (COMM_sendWorkerRequestToGotham(media_type, filename, gotham_socket, gotham_params, reconnecting) < 0) {
+        STRING_printF(print_mutex, STDOUT_FILENO, RED, "Error: Could not send the request to Gotham.\n");
         return -1;
     }
 
     // Rebem i processem resposta de Gotham
     FrameResult result_frame = FRAME_receiveFrame(gotham_socket);
-    int response_result = COMM_processGothamResponse(&result_frame, data_buffer, worker_ip, worker_port, media_type, reconnecting, print_mutex);
+    int response_result = COMM_processGothamResponse(&result_frame, response_frame, worker_ip, worker_port, worker_data_size, worker_candidates, media_type, reconnecting, print_mutex);
 
     return response_result;
 }
@@ -309,7 +323,7 @@ int COMM_requestWorkerAndProcessResponse(char** data_buffer, char** worker_ip, i
 *           1 = No se realizaron cambios porque el worker actual ya está registrado. 
 * 
 ************************************************/
-int COMM_updateMainWorker(MainWorker* main_worker, char* worker_ip, int worker_port) {
+int COMM_updateMainWorker(MainWorker* main_worker, const char* worker_ip, int worker_port) {
     // Si venim d'una primera connexió de fleck a worker, simplement actualitzem l'estructua de main_worker
     if(main_worker->ip == NULL) goto assign_ip_and_port;
     // Si la connexió amb un worker no es tracta de la primera establerta, mirem si la connexió s'estableix amb el mateix worker previ. En aquest cas no cal actualitzar l'estructura.
@@ -350,66 +364,232 @@ int COMM_connectToWorker(const char* worker_ip, int worker_port, pthread_mutex_t
 
 /*********************************************** 
 * 
-* @Finalidad: Solicitar al servidor Gotham la dirección IP y puerto de un worker según 
-*             el tipo de tarea solicitada, procesar la respuesta, actualizar la información 
-*             del worker principal y establecer la conexión con el worker. 
+* @Finalidad: Proponer al worker recién conectado que la conexión sea una sesión 
+*             multiplexada, con una trama 0x1C que lleva la oferta de este fleck para las 
+*             distorsiones de la sesión. El worker la acepta con otra trama 0x1C, con la 
+*             combinación escogida (o vacía si es de una versión que no la acuerda), o la 
+*             rechaza con "CON_KO" (y espera los metadatos de una sola distorsión por la 
+*             misma conexión); un worker de una versión anterior cierra la conexión. 
 * 
 * @Parámetros: 
-* in: filename = Nombre del archivo que se va a procesar. 
-* in: type = Tipo de distorsión solicitada (e.g., "media", "text"). 
-* in/out: main_worker = Estructura `MainWorker` que contiene la información del worker principal 
-*                       actual y su socket. Se actualiza si el worker cambia. 
-* in: gotham_socket = Descriptor del socket conectado al servidor Gotham. 
-* in: reconnecting_flag = Indicador de si esta solicitud es parte de un proceso de reconexión (1) 
-*                         o una nueva conexión (0). 
+* in: worker_socket = Descriptor del socket recién conectado al worker. 
+* in: params = Parámetros con el worker según Gotham (v2) y la oferta local. 
+* out: agreed = Combinación acordada para todas las distorsiones de la sesión, o a cero si 
+*               el worker no ha acordado ninguna. 
+* 
+* @Retorno: 
+*           1 = El worker acepta la sesión. 
+*           0 = El worker la rechaza; la conexión sirve para una sola distorsión. 
+*          -1 = El worker ha cerrado la conexión o no ha respondido con una trama 0x1C. 
+* 
+************************************************/
+static int COMM_proposeSession(int worker_socket, const ConnectionParams *params, ConnectionOffer *agreed) {
+    memset(agreed, 0, sizeof(ConnectionOffer));
+
+    // Les distorsions d'una sessió van per streams, sense franges, i la sessió no pot saber si el worker conserva una versió anterior d'un fitxer
+    ConnectionOffer offer;
+    Metadata metadata;
+    COMM_getLocalOffer(worker_socket, params, &offer);
+    offer.stripes = 1;
+    offer.capabilities &= ~CONN_CAP_DELTA;
+    METADATA_init(&metadata);
+    COMM_setOfferMetadata(&metadata, &offer);
+    if (COMM_sendMetadata(worker_socket, 0x1C, &metadata, METADATA_MSG_SESSION_OFFER, params) < 0) return -1;
+
+    // Un worker en espera accepta la connexió però no respon; sense termini ens hi quedaríem bloquejats
+    if (SOCKET_waitForReply(worker_socket) < 0) return -1;
+    FrameResult result = FRAME_receiveFrame(worker_socket);
+    if (result.error_code != FRAME_SUCCESS) {
+        if (result.frame) FRAME_destroyFrame(result.frame);
+        return -1;
+    }
+    Frame *response_frame = result.frame;
+    int proposal = response_frame->type != 0x1C ? -1 : 1;
+    if (proposal == 1 && response_frame->data_length > 0) {
+        // Una resposta no buida és un rebuig o la combinació escollida, amb el mateix format que la resposta a un 0x03
+        Metadata response;
+        if (strcmp((char *)response_frame->data, "CON_KO") == 0 || METADATA_decode(response_frame->data, response_frame->data_length, METADATA_MSG_CONNECTION_RESPONSE, &response) < 0) {
+            proposal = 0;
+        } else {
+            COMM_getOfferMetadata(&response, agreed);
+        }
+    }
+    FRAME_destroyFrame(response_frame);
+    return proposal;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Convertir la conexión recién establecida con un worker en una sesión 
+*             multiplexada del pool y dejar en `main_worker->socket` su primer stream. Si 
+*             el worker no acepta sesiones, la conexión se usa tal cual para la distorsión 
+*             (volviendo a conectar si el worker la ha cerrado). 
+* 
+* @Parámetros: 
+* in/out: main_worker = Worker principal con la conexión recién establecida, los parámetros 
+*                       según Gotham y el pool de sesiones. Se le guarda la combinación 
+*                       acordada para las distorsiones de la sesión. 
+* in: endpoint = Worker al que se ha conectado. 
 * in: print_mutex = Mutex para garantizar la exclusión mutua al imprimir mensajes de estado o error. 
 * 
-* @Retorno: Retorna un entero que indica el estado de la operación:
-*           CONNECTED_TO_NEW_WORKER = Conexión exitosa con un nuevo worker principal. 
-*           CONNECTED_TO_SAME_WORKER = Conexión con el mismo worker al que estaba conectado 
-*                                      previamente (durante una reconexión). 
-*           FAILED_TO_CONNECT = Error al establecer la conexión con el worker. 
-*           0 = Error al procesar la respuesta de Gotham o al solicitar el worker. 
+* @Retorno: 
+*           0 = `main_worker->socket` es un stream de la sesión o una conexión propia. 
+*          -1 = Se ha perdido la conexión con el worker. 
+* 
+************************************************/
+static int COMM_openWorkerSession(MainWorker* main_worker, const SocketEndpoint* endpoint, pthread_mutex_t *print_mutex) {
+    int proposal = COMM_proposeSession(main_worker->socket, &main_worker->params, &main_worker->agreed);
+    if (proposal == 0) return 0;
+    if (proposal < 0) {
+        SOCKET_closeSocket(&main_worker->socket);
+        main_worker->socket = SOCKET_initClientSocket(endpoint->ip, endpoint->port);
+        return main_worker->socket < 0 ? -1 : 0;
+    }
+
+    int stream_socket = MUX_poolAddSession(main_worker->sessions, endpoint->ip, endpoint->port, main_worker->socket, &main_worker->agreed, NULL);
+    if (stream_socket < 0) {
+        SOCKET_closeSocket(&main_worker->socket);
+        return -1;
+    }
+    main_worker->socket = stream_socket;
+    main_worker->session = 1;
+    STRING_printF(print_mutex, STDOUT_FILENO, YELLOW, "Opened a multiplexed session with the worker, distortions sent to it will share this connection\n");
+    return 0;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Cuerpo de `COMM_requestWorkerAndEstablishConnection`, con el mutex de 
+*             conexión ya bloqueado. 
+* 
+* @Parámetros: Los de `COMM_requestWorkerAndEstablishConnection`. 
+* 
+* @Retorno: El de `COMM_requestWorkerAndEstablishConnection`. 
 * 
 ************************************************/
-int COMM_requestWorkerAndEstablishConnection(char* filename, char* type, MainWorker* main_worker, int gotham_socket, int reconnecting_flag, pthread_mutex_t *print_mutex) {
-    char* data_buffer = NULL;
-    char* worker_ip = NULL; 
+static int COMM_establishConnection(char* filename, char* type, MainWorker* main_worker, int gotham_socket, const ConnectionParams *gotham_params, int reconnecting_flag, pthread_mutex_t *print_mutex) {
+    Frame* response_frame = NULL;
+    const char* worker_ip = NULL; 
     int worker_port = -1;
+    uint32_t worker_data_size = 0;
+    const char* worker_candidates = NULL;
+    SocketEndpoint endpoints[SOCKET_MAX_ENDPOINTS];
+    int n_endpoints = 0;
+    int winner = 0;
     int connected_to_same_worker = 0; // Flag per indicar si la connexió s'estableix amb el mateix worker principal al que estavem connectats prèviament. Això ens interessa per quan fleck faci una distorsió i rebi un frame_disconnected de part del worker, quan faci la reconnexió sàpiga si la desconnexió ha sigut per una caiguda (!connected_to_same_worker) o per una fallida d'alguna fase del procés de distorsió (connected_to_same_worker).
     
     // Demanem a gotham la ip i port del worker principal segons el tipus de distorsió sol·licitat i processem la resposta
-    int result = COMM_requestWorkerAndProcessResponse(&data_buffer, &worker_ip, &worker_port, type, filename, gotham_socket, reconnecting_flag, print_mutex); 
+    int result = COMM_requestWorkerAndProcessResponse(&response_frame, &worker_ip, &worker_port, &worker_data_size, &worker_candidates, type, filename, gotham_socket, gotham_params, reconnecting_flag, print_mutex); 
     if (result < 0) {
-        freePointer((void**)&data_buffer); 
         return 0; 
     }
     
     STRING_printF(print_mutex, STDOUT_FILENO, YELLOW, "Retrieved main worker details. Establishing connection...\n");
 
-    // Comprovem si fleck s'està intentant connectar al mateix worker al que estava connectat prèviament. Si no és el cas, actualitzem l'estructura the worker principal
-    connected_to_same_worker = COMM_updateMainWorker(main_worker, worker_ip, worker_port); 
-    // Si el worker retornat per gotham és el worker al que estavem connectats abortem connexió (hem fet reconnect per fallida del worker, no por caiguda)
-    if(reconnecting_flag && connected_to_same_worker) { 
-        freePointer((void**)&data_buffer); 
+    // El worker principal va primer; els alternatius només s'intenten si el principal rebutja la connexió o esgota el termini (e.g., ha caigut i Gotham encara no ho sap)
+    if (SOCKET_setEndpoint(&endpoints[0], worker_ip, worker_port) == 0) {
+        n_endpoints = 1 + SOCKET_parseEndpoints(worker_candidates, endpoints + 1, SOCKET_MAX_ENDPOINTS - 1);
+    }
+
+    // Comprovem si fleck s'està intentant connectar al mateix worker al que estava connectat prèviament
+    connected_to_same_worker = main_worker->ip != NULL && !strcmp(main_worker->ip, worker_ip) && main_worker->port == worker_port;
+    // Si el worker retornat per gotham és el worker al que estavem connectats i no n'hi ha cap altre abortem connexió (hem fet reconnect per fallida del worker, no por caiguda)
+    // Tampoc no ha caigut si la seva sessió multiplexada encara és activa: quan cau, la sessió es tanca abans que els seus streams
+    if(reconnecting_flag && connected_to_same_worker && (n_endpoints <= 1 || (main_worker->sessions && MUX_poolHasSession(main_worker->sessions, worker_ip, worker_port)))) { 
+        FRAME_destroyFrame(response_frame); 
         return CONNECTED_TO_SAME_WORKER; 
     }
 
     SOCKET_closeSocket(&main_worker->socket);
-    main_worker->socket = COMM_connectToWorker(worker_ip, worker_port, print_mutex);
-    if (main_worker->socket < 0) {
+    main_worker->session = 0;
+    memset(&main_worker->agreed, 0, sizeof(ConnectionOffer));
+
+    // Si ja tenim una sessió amb el worker principal, la distorsió hi va en un stream nou sense obrir cap connexió
+    if (main_worker->sessions && n_endpoints > 0) {
+        main_worker->socket = MUX_poolOpenStream(main_worker->sessions, worker_ip, worker_port, NULL, &main_worker->agreed);
+        main_worker->session = main_worker->socket >= 0;
+    }
+
+    if (!main_worker->session) {
+        main_worker->socket = n_endpoints > 0 ? SOCKET_raceConnect(endpoints, n_endpoints, &winner) : -1;
+        if (main_worker->socket < 0) {
+            STRING_printF(print_mutex, STDOUT_FILENO, RED, "Error: Failed to connect to worker with IP: %s, Port: %d\n", worker_ip, worker_port);
+        }
+
+        // Si el mateix worker encara respon, la reconnexió era per una fallida seva i no per una caiguda
+        if (main_worker->socket >= 0 && reconnecting_flag && connected_to_same_worker && winner == 0) {
+            SOCKET_closeSocket(&main_worker->socket);
+            FRAME_destroyFrame(response_frame); 
+            return CONNECTED_TO_SAME_WORKER; 
+        }
+        if (main_worker->socket >= 0 && winner > 0) {
+            STRING_printF(print_mutex, STDOUT_FILENO, YELLOW, "Main worker %s:%d is not responding, connected to standby worker %s:%d\n", worker_ip, worker_port, endpoints[winner].ip, endpoints[winner].port);
+        }
+    }
+
+    // Si Gotham indica que el worker accepta trames v2, el 0x03 ja hi pot anar (en binari i sense el límit de DATA_SIZE). La resta es negocia amb el worker (amb un worker alternatiu, des de v1)
+    ConnectionOffer hint = {winner == 0 ? worker_data_size : 0, 0, 0, 0, 0, 0};
+    FRAME_negotiate(&hint, &main_worker->params.local, &main_worker->params);
+
+    // Amb un worker principal v2 proposem fer de la connexió una sessió per a totes les distorsions que li enviem, amb la combinació que faran servir ja acordada
+    if (!main_worker->session && main_worker->socket >= 0 && main_worker->sessions && winner == 0 && worker_data_size > 0 && COMM_openWorkerSession(main_worker, &endpoints[0], print_mutex) < 0) {
+        STRING_printF(print_mutex, STDOUT_FILENO, RED, "Error: Failed to connect to worker with IP: %s, Port: %d\n", worker_ip, worker_port);
+    }
+
+    if (main_worker->socket < 0 || FRAME_resetReader(&main_worker->reader, main_worker->socket) < 0) { // El lector es reinicia per no arrossegar bytes de la connexió anterior
         STRING_printF(print_mutex, STDOUT_FILENO, RED, "Error: Failed to connect to worker\n");
-        freePointer((void**)&data_buffer); 
+        FRAME_destroyFrame(response_frame); 
         return FAILED_TO_CONNECT;
     }
 
+    // Si no és el worker al que ja estàvem connectats, actualitzem l'estructura del worker principal
+    connected_to_same_worker = COMM_updateMainWorker(main_worker, endpoints[winner].ip, endpoints[winner].port); 
+
     STRING_printF(print_mutex, STDOUT_FILENO, GREEN, "Connection successful\n");
 
-    freePointer((void**)&data_buffer); 
+    FRAME_destroyFrame(response_frame); 
 
     return connected_to_same_worker? CONNECTED_TO_SAME_WORKER : CONNECTED_TO_NEW_WORKER; 
 }
 
+/*********************************************** 
+* 
+* @Finalidad: Solicitar al servidor Gotham la dirección IP y puerto de un worker según 
+*             el tipo de tarea solicitada, procesar la respuesta, actualizar la información 
+*             del worker principal y establecer la conexión con el worker. Si Gotham indica 
+*             workers alternativos del mismo tipo, se intentan (escalonadamente) solo si el 
+*             principal rechaza la conexión o agota el plazo, de modo que un principal 
+*             caído no bloquea al fleck más que dos plazos de conexión. Si el fleck 
+*             ya tiene una sesión multiplexada con el worker principal, la distorsión va en 
+*             un stream nuevo de la sesión; si no, se propone abrir una con él. Las peticiones 
+*             de distintos hilos de distorsión se atienden de una en una. 
+* 
+* @Parámetros: 
+* in: filename = Nombre del archivo que se va a procesar. 
+* in: type = Tipo de distorsión solicitada (e.g., "media", "text"). 
+* in/out: main_worker = Estructura `MainWorker` que contiene la información del worker principal 
+*                       actual y su socket. Se actualiza si el worker cambia. 
+* in: gotham_socket = Descriptor del socket conectado al servidor Gotham. 
+* in: gotham_params = Parámetros de trama acordados con Gotham. 
+* in: reconnecting_flag = Indicador de si esta solicitud es parte de un proceso de reconexión (1) 
+*                         o una nueva conexión (0). 
+* in: print_mutex = Mutex para garantizar la exclusión mutua al imprimir mensajes de estado o error. 
+* 
+* @Retorno: Retorna un entero que indica el estado de la operación:
+*           CONNECTED_TO_NEW_WORKER = Conexión exitosa con un nuevo worker principal. 
+*           CONNECTED_TO_SAME_WORKER = Conexión con el mismo worker al que estaba conectado 
+*                                      previamente (durante una reconexión). 
+*           FAILED_TO_CONNECT = Error al establecer la conexión con el worker. 
+*           0 = Error al procesar la respuesta de Gotham o al solicitar el worker. 
+* 
+************************************************/
+int COMM_requestWorkerAndEstablishConnection(char* filename, char* type, MainWorker* main_worker, int gotham_socket, const ConnectionParams *gotham_params, int reconnecting_flag, pthread_mutex_t *print_mutex) {
+    pthread_mutex_lock(&connection_mutex);
+    int result = COMM_establishConnection(filename, type, main_worker, gotham_socket, gotham_params, reconnecting_flag, print_mutex);
+    pthread_mutex_unlock(&connection_mutex);
+    return result;
+}
+
 /*********************************************** 
 * 
 * @Finalidad: Procesar la respuesta del worker tras intentar establecer conexión para 
@@ -418,14 +598,21 @@ int COMM_requestWorkerAndEstablishConnection(char* filename, char* type, MainWor
 * 
 * @Parámetros: 
 * in: worker_socket = Descriptor del socket conectado al worker. 
+* out: params = Parámetros de trama acordados con el worker (v1 si el worker no los negocia). 
 * in: print_mutex = Mutex para garantizar la exclusión mutua al imprimir mensajes de estado o error. 
 * 
 * @Retorno: Retorna un entero que indica el estado de la operación:
 *           0 = Conexión establecida con éxito. El worker está listo para recibir el archivo. 
-*          -1 = Error en la respuesta del worker o rechazo de la conexión (CON_KO). 
+*          -1 = Error en la respuesta del worker, rechazo de la conexión (CON_KO) o el 
+*               worker no ha respondido dentro del plazo de conexión. 
 * 
 ************************************************/
-int COMM_processDistortionResponse(int worker_socket, pthread_mutex_t *print_mutex) {
+int COMM_processDistortionResponse(int worker_socket, ConnectionParams *params, pthread_mutex_t *print_mutex) {
+    // Un worker en espera accepta la connexió però no respon; sense termini ens hi quedaríem bloquejats
+    if (SOCKET_waitForReply(worker_socket) < 0) {
+        STRING_printF(print_mutex, STDOUT_FILENO, RED, "Error: The worker did not answer the connection request in time.\n");
+        return -1;
+    }
     FrameResult result_frame = FRAME_receiveFrame(worker_socket);
     if (result_frame.error_code != FRAME_SUCCESS) {
         STRING_printF(print_mutex, STDOUT_FILENO, RED, "Error: The worker's response is not available.\n");
@@ -434,16 +621,27 @@ int COMM_processDistortionResponse(int worker_socket, pthread_mutex_t *print_mut
 
     Frame *response_frame = result_frame.frame;
 
-    if (response_frame->type == 0x03 && response_frame->data_length == 0) {
-        STRING_printF(print_mutex, STDOUT_FILENO, YELLOW, "Connection established with the worker. Ready to send the file.\n");
+    if (response_frame->type == 0x03 && response_frame->data_length > 0 && strcmp((char *)response_frame->data, "CON_KO") == 0) {
+        STRING_printF(print_mutex, STDOUT_FILENO, RED, "Error: The worker refused the connection request (CON_KO).\n");
         FRAME_destroyFrame(response_frame);
-        return 0;  
+        return -1;
     }
 
-    if (response_frame->type == 0x03 && response_frame->data_length > 0) {
-        STRING_printF(print_mutex, STDOUT_FILENO, RED, "Error: The worker refused the connection request (CON_KO).\n");
+    if (response_frame->type == 0x03) {
+        // Una resposta buida és un OK d'un worker v1; si porta la mida de dades acordada el worker accepta trames v2
+        Metadata response;
+        if (METADATA_decode(response_frame->data, response_frame->data_length, METADATA_MSG_CONNECTION_RESPONSE, &response) < 0) {
+            STRING_printF(print_mutex, STDOUT_FILENO, RED, "Error: Malformed response from the worker.\n");
+            FRAME_destroyFrame(response_frame);
+            return -1;
+        }
+        ConnectionOffer chosen, offer;
+        COMM_getOfferMetadata(&response, &chosen);
+        COMM_getLocalOffer(worker_socket, params, &offer);
+        FRAME_negotiate(&chosen, &offer, params);
+        STRING_printF(print_mutex, STDOUT_FILENO, YELLOW, "Connection established with the worker. Ready to send the file.\n");
         FRAME_destroyFrame(response_frame);
-        return -1;
+        return 0;  
     }
 
     // Si el tipus no es correspon amb 0x03 retornem error
@@ -462,8 +660,18 @@ int COMM_processDistortionResponse(int worker_socket, pthread_mutex_t *print_mut
 * in: username = Nombre del usuario que solicita la distorsión. 
 * in: filename = Nombre del archivo que se va a distorsionar. 
 * in: file_size = Tamaño del archivo en bytes. 
-* in: md5sum = Hash MD5 del archivo, utilizado para validar la integridad. 
+* in: md5sum = Hash MD5 del archivo, utilizado para validar la integridad, o NULL si aún no 
+*             se ha calculado y se enviará al final del archivo (`CONN_CAP_HASH_TRAILER`). 
 * in: factor = Factor de distorsión solicitado. 
+* in: merkle = Árbol de Merkle del archivo, o NULL. Su raíz va en los metadatos y, si el 
+*              worker acepta `CONN_CAP_MERKLE`, sus hojas se envían después de la respuesta. 
+* in: agreed = Combinación acordada al abrir la sesión multiplexada, o NULL. Si se indica, 
+*              la petición la ofrece tal cual y no se espera la respuesta del worker, que 
+*              solo responde (con CON_KO) si no la acepta; las hojas y el archivo salen 
+*              justo detrás de los metadatos. 
+* in/out: params = Parámetros de trama con el worker. Si ya indican tramas v2 (según Gotham) 
+*                  los metadatos se envían en binario; al volver contienen los acordados 
+*                  en la respuesta del worker (o en la sesión). 
 * in: print_mutex = Mutex para garantizar la exclusión mutua al imprimir mensajes de estado o error. 
 * 
 * @Retorno: Retorna un entero que indica el estado de la operación:
@@ -472,27 +680,115 @@ int COMM_processDistortionResponse(int worker_socket, pthread_mutex_t *print_mut
 * 
 ************************************************/
 
-int COMM_sendFileMetadata(int worker_socket, const char* username, const char* filename, int file_size, const char* md5sum, const int factor, pthread_mutex_t *print_mutex) {
-    char *data = NULL;
-
-    if(asprintf(&data, "%s&%s&%d&%s&%d", username, filename, file_size, md5sum, factor) < 0) return -1;
+int COMM_sendFileMetadata(int worker_socket, const char* username, const char* filename, int file_size, const char* md5sum, const int factor, const MerkleTree *merkle, const ConnectionOffer *agreed, ConnectionParams *params, pthread_mutex_t *print_mutex) {
+    Metadata metadata;
+    char merkle_root[HASH_MD5_HEX_SIZE];
+    METADATA_init(&metadata);
+    METADATA_setString(&metadata, METADATA_USERNAME, username);
+    METADATA_setString(&metadata, METADATA_FILENAME, filename);
+    METADATA_setNumber(&metadata, METADATA_FILE_SIZE, (uint32_t)file_size);
+    METADATA_setString(&metadata, METADATA_MD5SUM, md5sum ? md5sum : "");     // Buit: el worker el rebrà darrere del fitxer
+    METADATA_setNumber(&metadata, METADATA_FACTOR, (uint32_t)factor);
+    // Els últims camps anuncien les capacitats que oferim (un worker v1 els ignora)
+    // Dins d'una sessió que ja ho ha acordat, l'oferta és la combinació de la sessió i el worker no hi respon si l'accepta
+    ConnectionOffer offer;
+    if (agreed) {
+        offer = *agreed;
+        METADATA_setNumber(&metadata, METADATA_PIPELINED, 1);
+    } else {
+        COMM_getLocalOffer(worker_socket, params, &offer);
+    }
+    COMM_setOfferMetadata(&metadata, &offer);
+    COMM_setMerkleMetadata(&metadata, merkle, merkle_root);
 
-    // Creem i enviem trama de metadades al worker (petició de distorsió)
-    Frame *metadata_frame = FRAME_createFrame(0x03, data, strlen(data));
-    if(FRAME_sendFrame(worker_socket, metadata_frame) < 0) {
+    // Enviem trama de metadades al worker (petició de distorsió)
+    if(COMM_sendMetadata(worker_socket, 0x03, &metadata, METADATA_MSG_FILE_REQUEST, params) < 0) {
         STRING_printF(print_mutex, STDOUT_FILENO, RED, "Error: Failed to send warp request to worker\n");
-        FRAME_destroyFrame(metadata_frame);
-        free(data);
         return -1; 
     }
 
-    // Processem la resposta del worker (CON_OK / CON_KO)
-    int result = COMM_processDistortionResponse(worker_socket, print_mutex);
+    // Processem la resposta del worker (CON_OK / CON_KO). Sense esperar-la, un CON_KO arriba on esperem el primer ACK o les metadades del resultat i atura igualment la distorsió
+    if (agreed) {
+        FRAME_negotiate(agreed, agreed, params);
+    } else if (COMM_processDistortionResponse(worker_socket, params, print_mutex) < 0) {
+        return -1;
+    }
 
-    free(data);
-    FRAME_destroyFrame(metadata_frame);
+    // Si el worker comprova els blocs, li enviem les fulles de l'arbre abans del fitxer
+    if (merkle && merkle->n_chunks > 0 && (params->capabilities & CONN_CAP_MERKLE) && COMM_sendMerkleLeaves(worker_socket, merkle, params) < 0) {
+        STRING_printF(print_mutex, STDOUT_FILENO, RED, "Error: Failed to send the file's chunk hashes to the worker\n");
+        return -1;
+    }
+    return 0;
+}
 
-    return result;
+/*********************************************** 
+* 
+* @Finalidad: Abrir las conexiones adicionales (franjas 1 a `params.stripes - 1`) con el 
+*             worker principal para enviarle un archivo en paralelo. Cada una se presenta 
+*             con una trama 0x13 que indica la distorsión y la franja que transportará, y 
+*             el worker la confirma con una trama 0x13 vacía. 
+* 
+* @Parámetros: 
+* in: main_worker = Worker principal, ya con los parámetros acordados en el handshake 0x03. 
+* in: username = Nombre del usuario que solicita la distorsión. 
+* in: filename = Nombre del archivo que se va a distorsionar. 
+* out: sockets = Conexiones de las franjas (la 0 es la conexión principal). 
+* in: print_mutex = Mutex para garantizar la exclusión mutua al imprimir mensajes de error. 
+* 
+* @Retorno: 
+*           0 = Todas las conexiones de franja se han abierto y el worker las ha aceptado. 
+*          -1 = Alguna conexión ha fallado. Las que se habían abierto se cierran. 
+* 
+************************************************/
+int COMM_openStripeConnections(MainWorker* main_worker, const char* username, const char* filename, int* sockets, pthread_mutex_t *print_mutex) {
+    int n_stripes = main_worker->params.stripes;
+    sockets[0] = main_worker->socket;
+
+    for (int i = 1; i < n_stripes; i++) {
+        sockets[i] = COMM_connectToWorker(main_worker->ip, main_worker->port, print_mutex);
+        int joined = 0;
+
+        if (sockets[i] >= 0) {
+            // Presentem la connexió amb el mateix format de trama acordat per la principal
+            Metadata metadata;
+            METADATA_init(&metadata);
+            METADATA_setString(&metadata, METADATA_USERNAME, username);
+            METADATA_setString(&metadata, METADATA_FILENAME, filename);
+            METADATA_setNumber(&metadata, METADATA_STRIPE, (uint32_t)i);
+
+            if (COMM_sendMetadata(sockets[i], 0x13, &metadata, METADATA_MSG_STRIPE_JOIN, &main_worker->params) == 0) {
+                FrameResult result = FRAME_receiveFrame(sockets[i]);
+                joined = result.error_code == FRAME_SUCCESS && result.frame->type == 0x13 && result.frame->data_length == 0;
+                if (result.frame) FRAME_destroyFrame(result.frame);
+            }
+        }
+
+        if (!joined) {
+            STRING_printF(print_mutex, STDOUT_FILENO, RED, "Error: The worker did not accept parallel connection %d\n", i);
+            COMM_closeStripeConnections(sockets, i + 1);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Cerrar las conexiones adicionales abiertas con `COMM_openStripeConnections`. 
+*             La conexión principal (posición 0) no se cierra. 
+* 
+* @Parámetros: 
+* in/out: sockets = Conexiones de las franjas. Las adicionales quedan a -1. 
+* in: n_stripes = Número de franjas. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void COMM_closeStripeConnections(int* sockets, int n_stripes) {
+    for (int i = 1; i < n_stripes; i++) {
+        if (sockets[i] >= 0) SOCKET_closeSocket(&sockets[i]);
+    }
 }
 
 /*********************************************** 
@@ -507,6 +803,7 @@ int COMM_sendFileMetadata(int worker_socket, const char* username, const char* f
 * in/out: main_worker = Estructura `MainWorker` que contiene la información del worker principal 
 *                       y su socket. Se actualiza si la reconexión es exitosa. 
 * in: gotham_socket = Descriptor del socket conectado al servidor Gotham. 
+* in: gotham_params = Parámetros de trama acordados con Gotham. 
 * in: print_mutex = Mutex para garantizar la exclusión mutua al imprimir mensajes de estado o error. 
 * 
 * @Retorno: Retorna un entero que indica el estado de la reconexión:
@@ -514,8 +811,8 @@ int COMM_sendFileMetadata(int worker_socket, const char* username, const char* f
 *           0 = Error al reconectar o reconexión con el mismo worker al que estaba conectado previamente. 
 * 
 ************************************************/
-int COMM_reconnectToWorker(char* filename, char* worker_type, MainWorker* main_worker, int gotham_socket, pthread_mutex_t *print_mutex) {
-    int reconnect_result = COMM_requestWorkerAndEstablishConnection(filename, worker_type, main_worker, gotham_socket, RECONNECTION, print_mutex);
+int COMM_reconnectToWorker(char* filename, char* worker_type, MainWorker* main_worker, int gotham_socket, const ConnectionParams *gotham_params, pthread_mutex_t *print_mutex) {
+    int reconnect_result = COMM_requestWorkerAndEstablishConnection(filename, worker_type, main_worker, gotham_socket, gotham_params, RECONNECTION, print_mutex);
     if (reconnect_result == FAILED_TO_CONNECT || reconnect_result == CONNECTED_TO_SAME_WORKER) {
         return 0; 
     }
@@ -526,10 +823,11 @@ int COMM_reconnectToWorker(char* filename, char* worker_type, MainWorker* main_w
 * 
 * @Finalidad: Recibir y procesar los metadatos del archivo distorsionado enviados por el worker. 
 *             Configura la estructura de contexto de distorsión (`DistortionContext`) 
-*             con los datos recibidos. 
+*             con los datos recibidos y, si llevan la raíz de su árbol de Merkle, recibe 
+*             las hojas que el worker envía a continuación. 
 * 
 * @Parámetros: 
-* in: worker_socket = Descriptor del socket conectado al worker. 
+* in/out: reader = Lector con buffer de la conexión con el worker. 
 * out: distorted_file = Puntero a la estructura `DistortionContext` donde se almacenarán 
 *                       los metadatos del archivo distorsionado. 
 * in: print_mutex = Mutex para garantizar la exclusión mutua al imprimir mensajes de estado o error. 
@@ -541,12 +839,11 @@ int COMM_reconnectToWorker(char* filename, char* worker_type, MainWorker* main_w
 *                              o tipo de trama incorrecto. 
 * 
 ************************************************/
-int COMM_retrieveFileMetadata(int worker_socket, DistortionContext* distorted_file, pthread_mutex_t *print_mutex) {
-    char* data_buffer = NULL;
+int COMM_retrieveFileMetadata(FrameReader *reader, DistortionContext* distorted_file, pthread_mutex_t *print_mutex) {
     int unexpected_error = 1;
 
-    // Rebem la trama del worker
-    FrameResult result = FRAME_receiveFrame(worker_socket);
+    // Rebem la trama del worker a través del lector de la connexió, ja que pot haver arribat juntament amb la verificació MD5
+    FrameResult result = FRAME_readerReceiveFrame(reader);
 
     // Si hi ha error en deserialitzar la trama retornem codi d'error 
     if (result.error_code != FRAME_SUCCESS) {
@@ -562,32 +859,46 @@ int COMM_retrieveFileMetadata(int worker_socket, DistortionContext* distorted_fi
     Frame *response_frame = result.frame;
     
     if(response_frame->type == 0x04) {
-        data_buffer = strdup((char *)response_frame->data);  // Copiem les dades de la trama a buffer auxiliar
-        if (!data_buffer) {
+        Metadata metadata;
+        if (METADATA_decode(response_frame->data, response_frame->data_length, METADATA_MSG_FILE_RESULT, &metadata) < 0) {
+            STRING_printF(print_mutex, STDOUT_FILENO, RED, "WERROR: malformed distorted file's metadata\n");
             FRAME_destroyFrame(response_frame);
             return UNEXPECTED_ERROR; // Retornem codi d'error
         }
 
         // Extreiem el filesize del fitxer distorsionat i l'emmagatzemem a l'estructura de context de distorsió
-        char* filesize_str = strtok(data_buffer, "&");
-        distorted_file->filesize = atoi(filesize_str); 
+        distorted_file->filesize = (int)METADATA_getNumber(&metadata, METADATA_FILE_SIZE, 0); 
         
         // Alliberem el md5sum del fitxer original i fem que estructura de context referencï el md5sum del fitxer distorsionat 
         freePointer((void**)&distorted_file->md5sum);
-        distorted_file->md5sum = strdup(strtok(NULL, "&"));
-
-        free(data_buffer);
+        distorted_file->md5sum = strdup(METADATA_getString(&metadata, METADATA_MD5SUM));
+        if (!distorted_file->md5sum) {
+            FRAME_destroyFrame(response_frame);
+            return UNEXPECTED_ERROR; // Retornem codi d'error
+        }
 
-        // Setegem el número de paquets equivalents al filesize del fitxer
-        distorted_file->n_packets = distorted_file->filesize / DATA_SIZE;
-        if (distorted_file->filesize % DATA_SIZE != 0) {
+        // Setegem el número de paquets equivalents al filesize del fitxer segons la mida de paquet acordada
+        distorted_file->n_packets = distorted_file->filesize / distorted_file->data_size;
+        if (distorted_file->filesize % distorted_file->data_size != 0) {
             distorted_file->n_packets++;
         }
 
-        // Setegem número de paquets processats a 0
+        // Setegem número de paquets processats a 0 i buidem el bitmap de paquets rebuts, que es prepararà en començar la recepció
         distorted_file->n_processed_packets = 0;
+        SACK_freeMap(&distorted_file->received);
+        HASH_init(&distorted_file->hash);   // L'md5sum del fitxer distorsionat es calcula mentre es rep
 
+        // Si el worker ens envia l'arbre de Merkle del fitxer distorsionat, les fulles arriben just després de les metadades
+        int merkle_root = COMM_getMerkleMetadata(&metadata, &distorted_file->merkle, (off_t)distorted_file->filesize);
         FRAME_destroyFrame(response_frame);
+        if (merkle_root < 0) {
+            STRING_printF(print_mutex, STDOUT_FILENO, RED, "WERROR: invalid Merkle root in the distorted file's metadata\n");
+            return UNEXPECTED_ERROR;
+        }
+        if (merkle_root > 0) {
+            int leaves_result = COMM_retrieveMerkleLeaves(reader, &distorted_file->merkle, FLECK, print_mutex);
+            if (leaves_result != TRANSFER_SUCCESS) return leaves_result;
+        }
         STRING_printF(print_mutex,STDOUT_FILENO, GREEN, "Successfully retrieved distorted file's metadata and set up distortion context\n");
 
         return TRANSFER_SUCCESS; // Procés executat satisfactòriament 
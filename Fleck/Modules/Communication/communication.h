@@ -46,6 +46,7 @@
 #include "../../../Libs/Frame/frame.h"           // Per a les funcions de manipulació de frames
 #include "../../../Libs/Socket/socket.h"         // Per a les funcions de connexió per sockets
 #include "../../../Libs/String/string.h"         // Per a les funcions de manipulació de strings
+#include "../../../Libs/Communication/communication.h"  // Per a les opcions de trama que s'anuncien als workers
 
 //.h estructures
 #include "../../typeFleck.h"                          // Per a les estructures de configuracio de Fleck
@@ -59,6 +60,7 @@
 * @Parámetros: 
 * in: gotham_socket = Descriptor del socket conectado al servidor Gotham. 
 * in: config = Puntero a la configuración del proceso Fleck que contiene el nombre de usuario. 
+* out: gotham_params = Parámetros de trama acordados con Gotham (v1 si Gotham no los negocia). 
 * 
 * @Retorno: Retorna un entero que indica el estado de la operación:
 *           0 = Conexión establecida correctamente con Gotham. 
@@ -66,13 +68,16 @@
 *               o verificación de la respuesta del servidor. 
 * 
 ************************************************/
-int COMM_connectToGotham(int gotham_socket, FleckConfig *config);
+int COMM_connectToGotham(int gotham_socket, FleckConfig *config, ConnectionParams *gotham_params);
 
 /*********************************************** 
 * 
 * @Finalidad: Solicitar al servidor Gotham la dirección IP y puerto de un worker según 
 *             el tipo de tarea solicitada, procesar la respuesta, actualizar la información 
-*             del worker principal y establecer la conexión con el worker. 
+*             del worker principal y establecer la conexión con el worker. Si Gotham indica 
+*             workers alternativos del mismo tipo, se intentan (escalonadamente) solo si el 
+*             principal rechaza la conexión o agota el plazo, de modo que un principal 
+*             caído no bloquea al fleck más que dos plazos de conexión. 
 * 
 * @Parámetros: 
 * in: filename = Nombre del archivo que se va a procesar. 
@@ -80,6 +85,7 @@ int COMM_connectToGotham(int gotham_socket, FleckConfig *config);
 * in/out: main_worker = Estructura `MainWorker` que contiene la información del worker principal 
 *                       actual y su socket. Se actualiza si el worker cambia. 
 * in: gotham_socket = Descriptor del socket conectado al servidor Gotham. 
+* in: gotham_params = Parámetros de trama acordados con Gotham. 
 * in: reconnecting_flag = Indicador de si esta solicitud es parte de un proceso de reconexión (1) 
 *                         o una nueva conexión (0). 
 * in: print_mutex = Mutex para garantizar la exclusión mutua al imprimir mensajes de estado o error. 
@@ -92,7 +98,7 @@ int COMM_connectToGotham(int gotham_socket, FleckConfig *config);
 *           0 = Error al procesar la respuesta de Gotham o al solicitar el worker. 
 * 
 ************************************************/
-int COMM_requestWorkerAndEstablishConnection(char* filename, char* type, MainWorker* main_worker, int gotham_socket, int reconnecting_flag, pthread_mutex_t *print_mutex);
+int COMM_requestWorkerAndEstablishConnection(char* filename, char* type, MainWorker* main_worker, int gotham_socket, const ConnectionParams *gotham_params, int reconnecting_flag, pthread_mutex_t *print_mutex);
 
 /*********************************************** 
 * 
@@ -105,8 +111,18 @@ int COMM_requestWorkerAndEstablishConnection(char* filename, char* type, MainWor
 * in: username = Nombre del usuario que solicita la distorsión. 
 * in: filename = Nombre del archivo que se va a distorsionar. 
 * in: file_size = Tamaño del archivo en bytes. 
-* in: md5sum = Hash MD5 del archivo, utilizado para validar la integridad. 
+* in: md5sum = Hash MD5 del archivo, utilizado para validar la integridad, o NULL si aún no 
+*             se ha calculado y se enviará al final del archivo (`CONN_CAP_HASH_TRAILER`). 
 * in: factor = Factor de distorsión solicitado. 
+* in: merkle = Árbol de Merkle del archivo, o NULL. Su raíz va en los metadatos y, si el 
+*              worker acepta `CONN_CAP_MERKLE`, sus hojas se envían después de la respuesta. 
+* in: agreed = Combinación acordada al abrir la sesión multiplexada, o NULL. Si se indica, 
+*              la petición la ofrece tal cual y no se espera la respuesta del worker, que 
+*              solo responde (con CON_KO) si no la acepta; las hojas y el archivo salen 
+*              justo detrás de los metadatos. 
+* in/out: params = Parámetros de trama con el worker. Si ya indican tramas v2 (según Gotham) 
+*                  los metadatos se envían en binario; al volver contienen los acordados 
+*                  en la respuesta del worker (o en la sesión). 
 * in: print_mutex = Mutex para garantizar la exclusión mutua al imprimir mensajes de estado o error. 
 * 
 * @Retorno: Retorna un entero que indica el estado de la operación:
@@ -114,7 +130,42 @@ int COMM_requestWorkerAndEstablishConnection(char* filename, char* type, MainWor
 *          -1 = Error al enviar la solicitud o rechazo por parte del worker. 
 * 
 ************************************************/
-int COMM_sendFileMetadata(int worker_socket, const char* username, const char* filename, int file_size, const char* md5sum, const int factor, pthread_mutex_t *print_mutex);
+int COMM_sendFileMetadata(int worker_socket, const char* username, const char* filename, int file_size, const char* md5sum, const int factor, const MerkleTree *merkle, const ConnectionOffer *agreed, ConnectionParams *params, pthread_mutex_t *print_mutex);
+
+/*********************************************** 
+* 
+* @Finalidad: Abrir las conexiones adicionales (franjas 1 a `params.stripes - 1`) con el 
+*             worker principal para enviarle un archivo en paralelo. Cada una se presenta 
+*             con una trama 0x13 que indica la distorsión y la franja que transportará, y 
+*             el worker la confirma con una trama 0x13 vacía. 
+* 
+* @Parámetros: 
+* in: main_worker = Worker principal, ya con los parámetros acordados en el handshake 0x03. 
+* in: username = Nombre del usuario que solicita la distorsión. 
+* in: filename = Nombre del archivo que se va a distorsionar. 
+* out: sockets = Conexiones de las franjas (la 0 es la conexión principal). 
+* in: print_mutex = Mutex para garantizar la exclusión mutua al imprimir mensajes de error. 
+* 
+* @Retorno: 
+*           0 = Todas las conexiones de franja se han abierto y el worker las ha aceptado. 
+*          -1 = Alguna conexión ha fallado. Las que se habían abierto se cierran. 
+* 
+************************************************/
+int COMM_openStripeConnections(MainWorker* main_worker, const char* username, const char* filename, int* sockets, pthread_mutex_t *print_mutex);
+
+/*********************************************** 
+* 
+* @Finalidad: Cerrar las conexiones adicionales abiertas con `COMM_openStripeConnections`. 
+*             La conexión principal (posición 0) no se cierra. 
+* 
+* @Parámetros: 
+* in/out: sockets = Conexiones de las franjas. Las adicionales quedan a -1. 
+* in: n_stripes = Número de franjas. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void COMM_closeStripeConnections(int* sockets, int n_stripes);
 
 /*********************************************** 
 * 
@@ -128,6 +179,7 @@ int COMM_sendFileMetadata(int worker_socket, const char* username, const char* f
 * in/out: main_worker = Estructura `MainWorker` que contiene la información del worker principal 
 *                       y su socket. Se actualiza si la reconexión es exitosa. 
 * in: gotham_socket = Descriptor del socket conectado al servidor Gotham. 
+* in: gotham_params = Parámetros de trama acordados con Gotham. 
 * in: print_mutex = Mutex para garantizar la exclusión mutua al imprimir mensajes de estado o error. 
 * 
 * @Retorno: Retorna un entero que indica el estado de la reconexión:
@@ -135,16 +187,17 @@ int COMM_sendFileMetadata(int worker_socket, const char* username, const char* f
 *           0 = Error al reconectar o reconexión con el mismo worker al que estaba conectado previamente. 
 * 
 ************************************************/
-int COMM_reconnectToWorker(char* filename, char* worker_type, MainWorker* main_worker, int gotham_socket, pthread_mutex_t *print_mutex); 
+int COMM_reconnectToWorker(char* filename, char* worker_type, MainWorker* main_worker, int gotham_socket, const ConnectionParams *gotham_params, pthread_mutex_t *print_mutex); 
 
 /*********************************************** 
 * 
 * @Finalidad: Recibir y procesar los metadatos del archivo distorsionado enviados por el worker. 
 *             Configura la estructura de contexto de distorsión (`DistortionContext`) 
-*             con los datos recibidos. 
+*             con los datos recibidos y, si llevan la raíz de su árbol de Merkle, recibe 
+*             las hojas que el worker envía a continuación. 
 * 
 * @Parámetros: 
-* in: worker_socket = Descriptor del socket conectado al worker. 
+* in/out: reader = Lector con buffer de la conexión con el worker. 
 * out: distorted_file = Puntero a la estructura `DistortionContext` donde se almacenarán 
 *                       los metadatos del archivo distorsionado. 
 * in: print_mutex = Mutex para garantizar la exclusión mutua al imprimir mensajes de estado o error. 
@@ -156,7 +209,7 @@ int COMM_reconnectToWorker(char* filename, char* worker_type, MainWorker* main_w
 *                              o tipo de trama incorrecto. 
 * 
 ************************************************/
-int COMM_retrieveFileMetadata(int worker_socket, DistortionContext* distorted_file, pthread_mutex_t *print_mutex);
+int COMM_retrieveFileMetadata(FrameReader *reader, DistortionContext* distorted_file, pthread_mutex_t *print_mutex);
 
 /*********************************************** 
 * 
@@ -42,23 +42,78 @@ int DIST_updateContextFilePath(DistortionContext* context) {
 
 /*********************************************** 
 * 
-* @Finalidad: Actualizar el estado de las distorsiones en el registro según el tipo 
-*             de archivo y el resultado de la operación. 
+* @Finalidad: Actualizar el estado de la distorsión en curso de una posición en el 
+*             registro según el resultado de la operación. 
 * 
 * @Parámetros: 
 * in/out: distortion_record = Puntero al registro de distorsiones a actualizar. 
 * in: finished = Indicador de finalización (1 para completado, 0 para fallido). 
-* in: type = Tipo de archivo cuya distorsión se debe actualizar. 
+* in: slot = Posición de la distorsión cuya entrada se debe actualizar. 
 * 
 * @Retorno: Ninguno. 
 * 
 ************************************************/
-void DIST_updateDistortionRecord(DistortionRecord* distortion_record, int finished, int type) {
+void DIST_updateDistortionRecord(DistortionRecord* distortion_record, int finished, int slot) {
+    pthread_mutex_lock(&distortion_record->mutex);
     for (int i = 0; i < distortion_record->n_distortions; i++) {
-        if (distortion_record->distortions[i].status == ONGOING && distortion_record->distortions[i].file_type == type) {
+        if (distortion_record->distortions[i].status == ONGOING && distortion_record->distortions[i].slot == slot) {
             distortion_record->distortions[i].status = finished ? COMPLETED : FAILED;
         }
     }
+    pthread_mutex_unlock(&distortion_record->mutex);
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Adaptar el número de paquetes del contexto a la mida de dades acordada 
+*             con el worker. Si la distorsión ya estaba en curso con otra mida de paquete, 
+*             los paquetes procesados se convierten a bytes para conservar el punto de 
+*             reanudación. 
+* 
+* @Parámetros: 
+* in/out: context = Puntero a la estructura `DistortionContext` a actualizar. 
+* in: data_size = Bytes de datos por paquete acordados en el handshake. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void DIST_applyNegotiatedDataSize(DistortionContext* context, int data_size) {
+    // Convertim els paquets processats a la nova mida arrodonint cap avall, de manera que com a molt es retransmet part d'un paquet
+    if (context->data_size > 0 && context->data_size != data_size) {
+        context->n_processed_packets = (int)(((long long)context->n_processed_packets * context->data_size) / data_size);
+    }
+    context->data_size = data_size;
+
+    context->n_packets = context->filesize / data_size;
+    if (context->filesize % data_size != 0) {
+        context->n_packets++;
+    }
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Decidir si los metadatos de la distorsión pueden ir con la combinación 
+*             acordada en la sesión multiplexada, sin esperar la respuesta del worker 
+*             (`CONN_CAP_PIPELINE`). Así no se puede ofrecer un delta, de modo que para 
+*             enviar el archivo original solo se hace si cabe en la ventana de congestión 
+*             de la conexión: en una sola ráfaga, un delta ya no ahorraría nada. 
+* 
+* @Parámetros: 
+* in: main_worker = Worker principal, con el stream de la distorsión y la combinación de su sesión. 
+* in: context = Contexto de la distorsión (fase y tamaño del archivo). 
+* 
+* @Retorno: 
+*           1 = La petición puede ir sin esperar la respuesta. 
+*           0 = Debe esperar la respuesta del worker. 
+* 
+************************************************/
+int DIST_canPipelineRequest(const MainWorker* main_worker, const DistortionContext* context) {
+    if (!main_worker->session || !(main_worker->agreed.capabilities & CONN_CAP_PIPELINE)) return 0;
+    if (context->current_stage != STAGE_SND_FILE) return 1;
+
+    SocketInfo socket_info;
+    if (SOCKET_getInfo(MUX_getTransport(main_worker->socket), &socket_info) < 0) return 0;
+    return (long long)context->filesize <= (long long)socket_info.cwnd * socket_info.mss;
 }
 
 /*********************************************** 
@@ -86,37 +141,90 @@ void* DIST_handleFileDistortion(void* arg) {
     int gotham_socket = distortion_args->gotham_socket;
     volatile int* exit_distortion = distortion_args->exit_distortion; 
     int* finished_distortion = distortion_args->finished_distortion;
+    int stripe_sockets[CONN_MAX_STRIPES];                    // Connexions per on s'envia el fitxer original (la 0 és la principal)
+    DeltaSignature delta_signature = DELTA_EMPTY_SIGNATURE;  // Signatura de l'última versió del fitxer que conserva el worker, si n'accepta un delta
 
     distortion_context->current_stage = STAGE_SND_FILE;
-    *distorting_flag = 1;
-    *finished_distortion = 0;
 
 enviaMetadades:
-    // Fase 1: enviament al worker de les metadades del fitxer a distorsionar
-    if (COMM_sendFileMetadata(worker_socket, distortion_context->username, distortion_context->filename, distortion_context->filesize, distortion_context->md5sum, distortion_context->factor, distortion_args->print_mutex) < 0) {
+    // Després d'una reconnexió el socket (i el lector associat) és el del nou worker
+    worker_socket = main_worker->socket;
+
+    // Fase 1: enviament al worker de les metadades del fitxer a distorsionar. Només oferim franges si encara hem d'enviar-li el fitxer i la distorsió té una connexió pròpia
+    main_worker->params.local.stripes = distortion_context->current_stage == STAGE_SND_FILE && !main_worker->session ? main_worker->stripes : 1;
+    // Tampoc no té sentit oferir-li un delta si ja té el fitxer; si el té d'una distorsió anterior, només li enviarem el que ha canviat
+    if (distortion_context->current_stage == STAGE_SND_FILE) {
+        main_worker->params.local.capabilities |= CONN_CAP_DELTA;
+    } else {
+        main_worker->params.local.capabilities &= ~CONN_CAP_DELTA;
+    }
+    // L'md5sum es calcula mentre s'envia el fitxer i va darrere dels paquets; un worker v1 (segons Gotham) el necessita ja a les metadades
+    // Amb un worker v2 que comprovi els blocs calculem l'arbre de Merkle d'un fitxer gran, que en la mateixa lectura completa l'md5sum. Un fitxer petit es llegeix una sola vegada, mentre s'envia
+    if (distortion_context->current_stage == STAGE_SND_FILE && main_worker->params.frame_version == FRAME_V2 && (main_worker->params.local.capabilities & CONN_CAP_MERKLE) && distortion_context->filesize >= MERKLE_MIN_FILE_SIZE && distortion_context->merkle.n_chunks == 0) {
+        if (MERKLE_build(&distortion_context->merkle, distortion_context->file_path, MERKLE_chooseChunkSize(distortion_context->filesize, main_worker->params.local.data_size - FRAME_PACKET_OFFSET_SIZE), &distortion_context->hash) < 0) goto exit_thread;
+    }
+    if (!distortion_context->md5sum && (main_worker->params.frame_version != FRAME_V2 || distortion_context->merkle.n_chunks > 0)) {
+        distortion_context->md5sum = HASH_completeFile(&distortion_context->hash, distortion_context->file_path);
+        if (!distortion_context->md5sum) goto exit_thread;
+    }
+    // Dins d'una sessió que ja ha acordat la combinació, les metadades no esperen la resposta del worker i el fitxer els segueix de seguida
+    const ConnectionOffer* agreed = DIST_canPipelineRequest(main_worker, distortion_context) ? &main_worker->agreed : NULL;
+    if (COMM_sendFileMetadata(worker_socket, distortion_context->username, distortion_context->filename, distortion_context->filesize, distortion_context->md5sum, distortion_context->factor, distortion_context->current_stage == STAGE_SND_FILE ? &distortion_context->merkle : NULL, agreed, &main_worker->params, distortion_args->print_mutex) < 0) {
         goto exit_thread;
     }
 
+    // Si el worker conserva una versió anterior del fitxer, ens n'envia la signatura just després de la resposta
+    if ((main_worker->params.capabilities & CONN_CAP_DELTA) && COMM_retrieveDeltaSignature(&main_worker->reader, &delta_signature, FLECK, distortion_args->print_mutex) != TRANSFER_SUCCESS) {
+        if (!COMM_reconnectToWorker(distortion_context->filename, worker_type, main_worker, gotham_socket, distortion_args->gotham_params, distortion_args->print_mutex)) goto exit_thread;
+        goto enviaMetadades;
+    }
+
+    // Recalculem els paquets amb la mida de dades acordada amb el worker
+    DIST_applyNegotiatedDataSize(distortion_context, FRAME_getDataSize(&main_worker->params));
+
     STRING_printF(distortion_args->print_mutex, STDOUT_FILENO, MAGENTA, "Sent worker original file's metadada\n");
     
     while(!*finished_distortion && !*exit_distortion) {
         switch(distortion_context->current_stage) {
             case STAGE_SND_FILE:
                 // Fase 2: enviament del fitxer a distorsionar
-                int send_result = COMM_sendFile(distortion_context->file_path, distortion_context->filename, distortion_context->n_packets, &distortion_context->n_processed_packets, worker_socket, exit_distortion, FLECK, distortion_args->print_mutex);
+                int send_result;
+                int inline_digest = 0;      // L'md5sum ha sortit darrere de l'últim paquet, dins de la transferència
+                FileTransfer send_transfer;
+                // Si el worker ja té una versió anterior del fitxer, només li enviem el que ha canviat. Si no, i accepta franges, el fitxer es reparteix
+                // entre diverses connexions; si no les podem obrir totes, l'enviem per la principal
+                if (main_worker->params.capabilities & CONN_CAP_DELTA) {
+                    send_result = COMM_sendFileDelta(distortion_context->file_path, distortion_context->filename, &delta_signature, &distortion_context->hash, worker_socket, &main_worker->params, &main_worker->pool, exit_distortion, FLECK, distortion_args->print_mutex);
+                } else if (main_worker->params.stripes > 1 && COMM_openStripeConnections(main_worker, distortion_context->username, distortion_context->filename, stripe_sockets, distortion_args->print_mutex) == 0) {
+                    COMM_initTransfer(&send_transfer, distortion_context, &main_worker->pool, &main_worker->reader, exit_distortion, FLECK, distortion_args->print_mutex);
+                    send_result = COMM_sendFileStriped(&send_transfer, stripe_sockets, main_worker->params.stripes, &main_worker->params);
+                    COMM_closeStripeConnections(stripe_sockets, main_worker->params.stripes);
+                } else {
+                    inline_digest = COMM_hasInlineDigest(&main_worker->params);
+                    COMM_initTransfer(&send_transfer, distortion_context, &main_worker->pool, &main_worker->reader, exit_distortion, FLECK, distortion_args->print_mutex);
+                    send_result = COMM_sendFile(&send_transfer, worker_socket, &main_worker->params);
+                }
+                if(send_result == TRANSFER_SUCCESS) {
+                    // L'md5sum, que ja cobreix tot el fitxer, es desa per si cal reenviar les metadades a un altre worker i, si el worker ho suporta, s'envia darrere dels paquets
+                    if (!distortion_context->md5sum) {
+                        distortion_context->md5sum = HASH_completeFile(&distortion_context->hash, distortion_context->file_path);
+                        if (!distortion_context->md5sum) goto exit_thread;
+                    }
+                    if ((main_worker->params.capabilities & CONN_CAP_HASH_TRAILER) && !inline_digest && COMM_sendFileDigest(worker_socket, &distortion_context->hash, &main_worker->params) < 0) send_result = REMOTE_END_DISCONNECTION;
+                }
                 if(send_result != TRANSFER_SUCCESS) {
                     if(send_result == UNEXPECTED_ERROR || send_result == INTERRUPTED_BY_SIGINT) goto exit_thread; 
                     // Si el worker ha caigut demanem a gotham el nou worker principal i ens intentem connectar a aquest
-                    if (!COMM_reconnectToWorker(distortion_context->filename, worker_type, main_worker, gotham_socket, distortion_args->print_mutex)) goto exit_thread;
+                    if (!COMM_reconnectToWorker(distortion_context->filename, worker_type, main_worker, gotham_socket, distortion_args->gotham_params, distortion_args->print_mutex)) goto exit_thread;
                     
                     goto enviaMetadades; // Connexió satisfactòria a un NOU worker principal
                 }
 
                 // Fase 3: worker compara md5sum de la trama de metadades amb el del fitxer reconstruït i ens envia CHECK_OK O CHECK_KO
-                int check_ok = COMM_retrieveMD5Check(worker_socket, FLECK, distortion_args->print_mutex);
+                int check_ok = COMM_retrieveMD5Check(&main_worker->reader, FLECK, distortion_args->print_mutex);
                 if(check_ok != TRANSFER_SUCCESS) {
                     if(send_result == UNEXPECTED_ERROR || send_result == INTERRUPTED_BY_SIGINT) goto exit_thread; // Si hi ha error en rebre la trama/ worker retorna check_ko / ha hagut sigint abortem distorsió
-                    if (!COMM_reconnectToWorker(distortion_context->filename, worker_type, main_worker, gotham_socket, distortion_args->print_mutex)) goto exit_thread;
+                    if (!COMM_reconnectToWorker(distortion_context->filename, worker_type, main_worker, gotham_socket, distortion_args->gotham_params, distortion_args->print_mutex)) goto exit_thread;
 
                     goto enviaMetadades; 
                 }
@@ -124,10 +232,10 @@ enviaMetadades:
             break; 
             case STAGE_RCV_METADATA:
                 // Fase 4: recepció de les metadades del fitxer distorsionat i actualització de l'estructura de context
-                int frame_error = COMM_retrieveFileMetadata(worker_socket, distortion_context, distortion_args->print_mutex); 
+                int frame_error = COMM_retrieveFileMetadata(&main_worker->reader, distortion_context, distortion_args->print_mutex); 
                 if(frame_error != TRANSFER_SUCCESS) {
                     if(frame_error == UNEXPECTED_ERROR) goto exit_thread; // Si hi ha error en rebre la trama abortem distorsió
-                    if (!COMM_reconnectToWorker(distortion_context->filename, worker_type, main_worker, gotham_socket, distortion_args->print_mutex)) goto exit_thread;
+                    if (!COMM_reconnectToWorker(distortion_context->filename, worker_type, main_worker, gotham_socket, distortion_args->gotham_params, distortion_args->print_mutex)) goto exit_thread;
 
                     goto enviaMetadades;
                 }
@@ -138,16 +246,22 @@ enviaMetadades:
             break; 
             case STAGE_RECV_FILE:
                 // Fase 5: recepció del fitxer distorsionat
-                int rcv_result = COMM_receiveFile(distortion_context->file_path, distortion_context->filename, distortion_context->n_packets, &distortion_context->n_processed_packets, worker_socket, exit_distortion, FLECK, distortion_args->print_mutex);
+                FileTransfer rcv_transfer;
+                COMM_initTransfer(&rcv_transfer, distortion_context, &main_worker->pool, &main_worker->reader, exit_distortion, FLECK, distortion_args->print_mutex);
+                int rcv_result = COMM_receiveFile(&rcv_transfer, worker_socket, &main_worker->params);
+                // Darrere dels paquets el worker ens envia l'md5sum del fitxer distorsionat, que ha calculat mentre l'enviava (amb CONN_CAP_PIPELINE ja l'ha recollit COMM_receiveFile)
+                if(rcv_result == TRANSFER_SUCCESS && (main_worker->params.capabilities & CONN_CAP_HASH_TRAILER) && !COMM_hasInlineDigest(&main_worker->params)) {
+                    rcv_result = COMM_retrieveFileDigest(&main_worker->reader, &distortion_context->md5sum, FLECK, distortion_args->print_mutex);
+                }
                 if(rcv_result != TRANSFER_SUCCESS) {
                     if(send_result == UNEXPECTED_ERROR || send_result == INTERRUPTED_BY_SIGINT) goto exit_thread; // Si hi ha hagut error inesperat en la rececpió del fitxer abortem distorsió
-                    if (!COMM_reconnectToWorker(distortion_context->filename, worker_type, main_worker, gotham_socket, distortion_args->print_mutex)) goto exit_thread;
+                    if (!COMM_reconnectToWorker(distortion_context->filename, worker_type, main_worker, gotham_socket, distortion_args->gotham_params, distortion_args->print_mutex)) goto exit_thread;
                     
                     goto enviaMetadades; // Connexió satisfactòria a un NOU worker principal
                 }
 
                 // Fase 6: comprovació del md5sum i notificació pertinent al worker
-                int verify_status = COMM_verifyFileIntegrity(distortion_context->file_path, distortion_context->md5sum, worker_socket, distortion_args->print_mutex);
+                int verify_status = COMM_verifyFileIntegrity(distortion_context->file_path, distortion_context->md5sum, &distortion_context->hash, worker_socket, distortion_args->print_mutex);
                 if(verify_status != TRANSFER_SUCCESS) goto exit_thread;
                 distortion_context->current_stage = STAGE_DISCONNECT;
             break;
@@ -160,8 +274,9 @@ enviaMetadades:
     }
 
 exit_thread:
-    SOCKET_closeSocket(&worker_socket);
-    DIST_updateDistortionRecord(distortion_args->distortion_record, *finished_distortion, !strcmp(worker_type, "Text") ? TEXT : MEDIA);
+    SOCKET_closeSocket(&main_worker->socket);     // La connexió (o el stream) és la de l'últim worker, i la posició es pot reutilitzar
+    DIST_updateDistortionRecord(distortion_args->distortion_record, *finished_distortion, distortion_args->slot);
+    DELTA_freeSignature(&delta_signature);
     EXIT_cleanupDistortionContext(&distortion_context); 
     *distorting_flag = 0;
     *finished_distortion = 1;
@@ -181,18 +296,20 @@ exit_thread:
 * in: distorting_flag = Puntero a una bandera que indica si la distorsión está en curso. 
 * in: main_worker = Puntero al `MainWorker` asociado. 
 * in: gotham_socket = Descriptor del socket conectado al servidor Gotham. 
+* in: gotham_params = Parámetros de trama acordados con Gotham. 
 * in: folder_path = Ruta al directorio donde se procesará el archivo distorsionado. 
 * in: username = Nombre del usuario que solicita la distorsión. 
 * in: distortion_record = Puntero al registro de distorsiones para registrar el progreso. 
 * in: exit = Puntero a una bandera de tipo `volatile int` que indica si se debe salir del hilo. 
 * in: print_mutex = Mutex para garantizar la exclusión mutua al imprimir mensajes. 
 * in: finished_distortion = Puntero a flag que indica si el thread de distorsión ha finalizado. 
+* in: slot = Posición de la distorsión. 
 *
 * @Retorno: Retorna un puntero a la estructura `DistortionThreadArgsF` inicializada 
 *           o `NULL` si no se pudo asignar memoria. 
 * 
 ************************************************/
-DistortionThreadArgsF* DIST_initDistortionThreadArgs(char* type, DistortionContext *context, int *distorting_flag, MainWorker *main_worker, int gotham_socket, char* folder_path, DistortionRecord* distortion_record, volatile int* exit, int* finished_distortion, pthread_mutex_t* print_mutex) {
+DistortionThreadArgsF* DIST_initDistortionThreadArgs(char* type, DistortionContext *context, int *distorting_flag, MainWorker *main_worker, int gotham_socket, const ConnectionParams *gotham_params, char* folder_path, DistortionRecord* distortion_record, volatile int* exit, int* finished_distortion, int slot, pthread_mutex_t* print_mutex) {
     DistortionThreadArgsF* distortion_args = (DistortionThreadArgsF*) malloc (sizeof(DistortionThreadArgsF)); 
     if(!distortion_args) return NULL;
 
@@ -201,19 +318,22 @@ DistortionThreadArgsF* DIST_initDistortionThreadArgs(char* type, DistortionConte
     distortion_args->main_worker = main_worker; 
     distortion_args->worker_type = type;
     distortion_args->gotham_socket = gotham_socket;
+    distortion_args->gotham_params = gotham_params;
     distortion_args->folder_path = folder_path;
     distortion_args->distortion_record = distortion_record;
     distortion_args->exit_distortion = exit;
     distortion_args->print_mutex = print_mutex;
     distortion_args->finished_distortion = finished_distortion;
+    distortion_args->slot = slot;
     return distortion_args;
 }
 
 /*********************************************** 
 * 
 * @Finalidad: Configurar e inicializar la estructura `DistortionContext` con la información 
-*             necesaria para realizar una distorsión, incluyendo el archivo, tamaño, 
-*             hash MD5, y número de paquetes. 
+*             necesaria para realizar una distorsión, incluyendo el archivo, tamaño y 
+*             número de paquetes. El hash MD5 no se calcula aquí: se va calculando 
+*             mientras se envía el archivo. 
 * 
 * @Parámetros: 
 * in/out: context = Puntero a la estructura `DistortionContext` que se va a configurar. 
@@ -223,7 +343,7 @@ DistortionThreadArgsF* DIST_initDistortionThreadArgs(char* type, DistortionConte
 * 
 * @Retorno: Retorna un entero que indica el estado de la operación:
 *           1 = Configuración completada con éxito. 
-*           0 = Error al calcular el tamaño del archivo o el hash MD5. 
+*           0 = Error al calcular el tamaño del archivo. 
 *          -1 = Error al asignar memoria o construir la ruta del archivo. 
 * 
 ************************************************/
@@ -239,18 +359,23 @@ int DIST_setupDistortionContext(DistortionContext *context, char *folder_path, c
     context->filesize = FILE_getFileSize(context->file_path);
     if (context->filesize < 0) return 0; 
 
-    context->md5sum = FILE_calculateMD5(context->file_path);
-    if (!context->md5sum) return 0; 
+    // L'md5sum es calcula mentre s'envia el fitxer (o abans d'enviar les metadades, si el worker és v1)
+    freePointer((void**)&context->md5sum);
+    HASH_init(&context->hash);
+    MERKLE_free(&context->merkle);
 
     context->username = strdup(username);
     if (!context->username) return 0;
 
+    // Fins al handshake amb el worker comptem els paquets amb la mida d'una trama v1
+    context->data_size = DATA_SIZE;
     context->n_packets = context->filesize / DATA_SIZE;
     if (context->filesize % DATA_SIZE != 0) {
         context->n_packets++;
     }
 
     context->n_processed_packets = 0;
+    SACK_freeMap(&context->received);
 
     return 1;
 }
@@ -264,17 +389,23 @@ int DIST_setupDistortionContext(DistortionContext *context, char *folder_path, c
 * in/out: distortion_record = Puntero al registro de distorsiones donde se añadirá la nueva entrada. 
 * in: filename = Nombre del archivo asociado a la distorsión. 
 * in: type = Tipo de archivo a distorsionar ("Text" o "Media"). 
+* in: slot = Posición de la distorsión. 
 * 
 * @Retorno: Ninguno. 
 * 
 ************************************************/
-void DIST_recordDistortion(DistortionRecord* distortion_record, char* filename, char* type) {
-    distortion_record->distortions = realloc(distortion_record->distortions, (distortion_record->n_distortions + 1) * sizeof(CheckStatus));
-    if (!distortion_record->distortions) return;
-    distortion_record->distortions[distortion_record->n_distortions].filename = strdup(filename);
-    distortion_record->distortions[distortion_record->n_distortions].file_type = !strcmp(type, "Text") ? TEXT : MEDIA;
-    distortion_record->distortions[distortion_record->n_distortions].status = ONGOING;
-    distortion_record->n_distortions++;
+void DIST_recordDistortion(DistortionRecord* distortion_record, char* filename, char* type, int slot) {
+    pthread_mutex_lock(&distortion_record->mutex);
+    CheckStatus* distortions = realloc(distortion_record->distortions, (distortion_record->n_distortions + 1) * sizeof(CheckStatus));
+    if (distortions) {
+        distortion_record->distortions = distortions;
+        distortion_record->distortions[distortion_record->n_distortions].filename = strdup(filename);
+        distortion_record->distortions[distortion_record->n_distortions].file_type = !strcmp(type, "Text") ? TEXT : MEDIA;
+        distortion_record->distortions[distortion_record->n_distortions].status = ONGOING;
+        distortion_record->distortions[distortion_record->n_distortions].slot = slot;
+        distortion_record->n_distortions++;
+    }
+    pthread_mutex_unlock(&distortion_record->mutex);
 }
 
 /*********************************************** 
@@ -288,10 +419,12 @@ void DIST_recordDistortion(DistortionRecord* distortion_record, char* filename,
 * in: username = Nombre del usuario que solicita la distorsión. 
 * in: type = Tipo de distorsión a realizar ("Text" o "Media"). 
 * in/out: thread = Puntero al identificador del hilo que manejará la distorsión. 
+* in: slot = Posición de la distorsión entre las que pueden estar en curso a la vez. 
 * in: factor = Factor de distorsión aplicado al archivo. 
 * in/out: distorting_flag = Bandera que indica si hay un proceso de distorsión en curso. 
 * in: main_worker = Puntero a la estructura `MainWorker` para manejar la conexión con el worker. 
 * in: gotham_socket = Descriptor del socket conectado al servidor Gotham. 
+* in: gotham_params = Parámetros de trama acordados con Gotham. 
 * in: folder_path = Ruta al directorio donde se encuentra el archivo. 
 * in/out: distortion_record = Puntero al registro de distorsiones donde se añadirá la nueva entrada. 
 * in: exit_distortion = Bandera para indicar si se debe salir del proceso de distorsión. 
@@ -302,20 +435,15 @@ void DIST_recordDistortion(DistortionRecord* distortion_record, char* filename,
 *           0 = Error en alguna etapa del proceso (e.g., preparación del contexto, conexión, o creación del hilo). 
 * 
 ************************************************/
-int DIST_prepareAndStartDistortion (DistortionContext *context, char *filename, char* username, char *type, pthread_t *thread, int factor, int* distorting_flag, MainWorker* main_worker, int gotham_socket, char* folder_path, DistortionRecord* distortion_record, volatile int* exit_distortion, int* finished_distortion, pthread_mutex_t *print_mutex) {
-    // Validem si ja hi ha una distorsió del tipus sol·licitat en curs
-    if (*distorting_flag) {
-        STRING_printF(print_mutex, STDOUT_FILENO, RED, "Error: %s distortion already in progress\n", type);
-        return 0;  // Cas fallit
-    }
-
-    // Alliberem l'anterior thread de distorsió del tipus sol·licitat
-    int join_result = pthread_join(*thread, NULL);
-    if(join_result != 0) {
-        if(join_result != ESRCH) { // Si no existeix el thread significa que és la primera vegada que el volem llançar. Si l'error és diferent a ESRCH avortem la distorsió
+int DIST_prepareAndStartDistortion (DistortionContext *context, char *filename, char* username, char *type, pthread_t *thread, int slot, int factor, int* distorting_flag, MainWorker* main_worker, int gotham_socket, const ConnectionParams *gotham_params, char* folder_path, DistortionRecord* distortion_record, volatile int* exit_distortion, int* finished_distortion, pthread_mutex_t *print_mutex) {
+    // Alliberem l'anterior thread de distorsió d'aquesta posició
+    if (*thread) {
+        int join_result = pthread_join(*thread, NULL);
+        if(join_result != 0 && join_result != ESRCH) {
             STRING_printF(print_mutex, STDOUT_FILENO, RED, "Error joining distortion thread: %s\n", strerror(join_result));
             return 0;
         }
+        *thread = 0;
     }
 
     // Preparem l'estructura de context
@@ -328,16 +456,29 @@ int DIST_prepareAndStartDistortion (DistortionContext *context, char *filename,
     }
 
     // Demanen un worker a gotham i ens intentem connectar a aquest
-    if (COMM_requestWorkerAndEstablishConnection(context->filename, type, main_worker, gotham_socket, CONNECTION, print_mutex) == FAILED_TO_CONNECT) {
+    if (COMM_requestWorkerAndEstablishConnection(context->filename, type, main_worker, gotham_socket, gotham_params, CONNECTION, print_mutex) == FAILED_TO_CONNECT) {
+        EXIT_cleanupDistortionContext(&context); 
+        return 0;  // Cas fallit
+    }
+
+    DistortionThreadArgsF* distortion_args = DIST_initDistortionThreadArgs(type, context, distorting_flag, main_worker, gotham_socket, gotham_params, folder_path, distortion_record, exit_distortion, finished_distortion, slot, print_mutex);
+    if (!distortion_args) {
+        SOCKET_closeSocket(&main_worker->socket);
         EXIT_cleanupDistortionContext(&context); 
         return 0;  // Cas fallit
     }
 
-    DistortionThreadArgsF* distortion_args = DIST_initDistortionThreadArgs(type, context, distorting_flag, main_worker, gotham_socket, folder_path, distortion_record, exit_distortion, finished_distortion, print_mutex);
+    // Registrem la distorsió a l'estructura d'historial abans de llançar-la, perquè el thread la trobi si acaba de seguida
+    DIST_recordDistortion(distortion_record, context->filename, type, slot); 
+    *distorting_flag = 1;
+    *finished_distortion = 0;
 
     // Llancem el thread de distorsió
     if (pthread_create(thread, NULL, DIST_handleFileDistortion, distortion_args) != 0) {
         STRING_printF(print_mutex, STDOUT_FILENO, RED, "Failed to create %s distortion thread\n", type);
+        *thread = 0;
+        *distorting_flag = 0;
+        DIST_updateDistortionRecord(distortion_record, 0, slot);
         SOCKET_closeSocket(&main_worker->socket);
         EXIT_cleanupDistortionContext(&context); 
         free(distortion_args);
@@ -346,8 +487,5 @@ int DIST_prepareAndStartDistortion (DistortionContext *context, char *filename,
 
     STRING_printF(print_mutex, STDOUT_FILENO, YELLOW, "\n%s distortion process successfully started\n", type);
     
-    // Registrem la distorsió iniciada a l'estructura d'historial
-    DIST_recordDistortion(distortion_record, context->filename, type); 
-    
     return 1;  // Cas exitós
 }
\ No newline at end of file
@@ -66,10 +66,12 @@
 * in: username = Nombre del usuario que solicita la distorsión. 
 * in: type = Tipo de distorsión a realizar ("Text" o "Media"). 
 * in/out: thread = Puntero al identificador del hilo que manejará la distorsión. 
+* in: slot = Posición de la distorsión entre las que pueden estar en curso a la vez. 
 * in: factor = Factor de distorsión aplicado al archivo. 
 * in/out: distorting_flag = Bandera que indica si hay un proceso de distorsión en curso. 
 * in: main_worker = Puntero a la estructura `MainWorker` para manejar la conexión con el worker. 
 * in: gotham_socket = Descriptor del socket conectado al servidor Gotham. 
+* in: gotham_params = Parámetros de trama acordados con Gotham. 
 * in: folder_path = Ruta al directorio donde se encuentra el archivo. 
 * in/out: distortion_record = Puntero al registro de distorsiones donde se añadirá la nueva entrada. 
 * in: exit_distortion = Bandera para indicar si se debe salir del proceso de distorsión. 
@@ -81,6 +83,6 @@
 *           0 = Error en alguna etapa del proceso (e.g., preparación del contexto, conexión, o creación del hilo). 
 * 
 ************************************************/
-int DIST_prepareAndStartDistortion(DistortionContext *context, char *filename, char* username, char *type, pthread_t *thread, int factor, int* distorting_flag, MainWorker* main_worker, int gotham_socket, char* folder_path, DistortionRecord* distortion_record, volatile int* exit_distortion, int* finished_distortion, pthread_mutex_t *print_mutex);
+int DIST_prepareAndStartDistortion(DistortionContext *context, char *filename, char* username, char *type, pthread_t *thread, int slot, int factor, int* distorting_flag, MainWorker* main_worker, int gotham_socket, const ConnectionParams *gotham_params, char* folder_path, DistortionRecord* distortion_record, volatile int* exit_distortion, int* finished_distortion, pthread_mutex_t *print_mutex);
 
 #endif // _DISTORTION_FLECK_CUSTOM_H_
\ No newline at end of file
@@ -22,36 +22,31 @@
 * 
 * @Parámetros: 
 * in/out: fleck_config = Puntero a la estructura `FleckConfig` cuya memoria será liberada. 
-* in/out: text_context = Puntero al contexto de distorsión de archivos de texto. 
-* in/out: media_context = Puntero al contexto de distorsión de archivos de medios. 
-* in/out: main_enigma = Puntero a la estructura del worker principal de tipo Enigma. 
-* in/out: main_harley = Puntero a la estructura del worker principal de tipo Harley. 
+* in/out: distortion_context = Array con los contextos de distorsión de cada posición. 
+* in/out: main_worker = Array con las estructuras del worker principal de cada posición. 
+* in: n_slots = Número de posiciones de los arrays. 
 * in/out: distortion_record = Puntero al registro de distorsiones que será liberado. 
 * 
 * @Retorno: Ninguno. 
 * 
 ************************************************/
-void EXIT_freeMemory(FleckConfig *fleck_config, DistortionContext *text_context, DistortionContext *media_context, MainWorker *main_enigma, MainWorker *main_harley, DistortionRecord* distortion_record) {
+void EXIT_freeMemory(FleckConfig *fleck_config, DistortionContext distortion_context[], MainWorker main_worker[], int n_slots, DistortionRecord* distortion_record) {
     //alliberem estructura configuració
     freePointer((void**)&fleck_config->username);
     freePointer((void**)&fleck_config->folder_path);
     freePointer((void**)&fleck_config->gotham_ip);
 
-    //alliberem estructura de propietats del fitxer text a distorsionar
-    freePointer((void**)&text_context->filename);
-    freePointer((void**)&text_context->md5sum);
-    freePointer((void**)&text_context->file_path); 
+    for (int i = 0; i < n_slots; i++) {
+        //alliberem estructura de propietats del fitxer a distorsionar
+        freePointer((void**)&distortion_context[i].filename);
+        freePointer((void**)&distortion_context[i].md5sum);
+        freePointer((void**)&distortion_context[i].file_path); 
 
-    //alliberem estructura de propietats del fitxer media a distorsionar
-    freePointer((void**)&media_context->filename);
-    freePointer((void**)&media_context->md5sum);
-    freePointer((void**)&media_context->file_path); 
-
-    //alliberem estructura enigma principal
-    freePointer((void**)&main_enigma->ip);
-
-    //alliberem estructura harley principal
-    freePointer((void**)&main_harley->ip);
+        //alliberem estructura del worker principal
+        freePointer((void**)&main_worker[i].ip);
+        FRAME_destroyPool(&main_worker[i].pool);
+        FRAME_destroyReader(&main_worker[i].reader);
+    }
 
     EXIT_freeDistortionRecord(distortion_record);
 }
@@ -73,6 +68,8 @@ void EXIT_cleanupDistortionContext(DistortionContext **context) {
     freePointer((void**)&((*context)->md5sum));
     freePointer((void**)&((*context)->file_path));
     freePointer((void**)&((*context)->username));
+    SACK_freeMap(&(*context)->received);
+    MERKLE_free(&(*context)->merkle);
 }
 
 /*********************************************** 
@@ -87,9 +84,11 @@ void EXIT_cleanupDistortionContext(DistortionContext **context) {
 * 
 ************************************************/
 void EXIT_freeDistortionRecord(DistortionRecord* record) {
+    pthread_mutex_lock(&record->mutex);
     for(int i = 0; i < record->n_distortions; i++) {
         freePointer((void**)&record->distortions[i].filename);
     }
     freePointer((void**)&record->distortions);
     record->n_distortions = 0;
+    pthread_mutex_unlock(&record->mutex);
 }
\ No newline at end of file
@@ -21,6 +21,8 @@
 
 //Llibreries pròpies
 #include "../../../Libs/IO/io.h"                  // Per a les funcions d'entrada/sortida
+#include "../../../Libs/Sack/sack.h"              // Per alliberar el bitmap de paquets rebuts
+#include "../../../Libs/Hash/merkle.h"            // Per alliberar l'arbre de blocs del fitxer
 
 //.h estructures
 #include "../../typeFleck.h"                          // Per a les estructures de configuracio de Fleck
@@ -35,16 +37,15 @@
 * 
 * @Parámetros: 
 * in/out: fleck_config = Puntero a la estructura `FleckConfig` cuya memoria será liberada. 
-* in/out: text_to_distort = Puntero al contexto de distorsión de archivos de texto. 
-* in/out: media_to_distort = Puntero al contexto de distorsión de archivos de medios. 
-* in/out: main_enigma = Puntero a la estructura del worker principal de tipo Enigma. 
-* in/out: main_harley = Puntero a la estructura del worker principal de tipo Harley. 
+* in/out: distortion_context = Array con los contextos de distorsión de cada posición. 
+* in/out: main_worker = Array con las estructuras del worker principal de cada posición. 
+* in: n_slots = Número de posiciones de los arrays. 
 * in/out: distortion_record = Puntero al registro de distorsiones que será liberado. 
 * 
 * @Retorno: Ninguno. 
 * 
 ************************************************/
-void EXIT_freeMemory(FleckConfig *fleck_config, DistortionContext *text_to_distort, DistortionContext *media_to_distort, MainWorker *main_enigma, MainWorker *main_harley, DistortionRecord* distortion_record);
+void EXIT_freeMemory(FleckConfig *fleck_config, DistortionContext distortion_context[], MainWorker main_worker[], int n_slots, DistortionRecord* distortion_record);
 
 /*********************************************** 
 * 
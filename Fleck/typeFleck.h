@@ -13,45 +13,68 @@
 #define _TYPE_FLECK_CUSTOM_H_
 
 #include "../Libs/Structure/typeDistort.h"
+#include "../Libs/Structure/typeConnection.h"
+#include "../Libs/Frame/frame.h"
+#include "../Libs/Socket/socket.h"
+#include "../Libs/Mux/mux.h"
 
 typedef struct {
     char* username; 
     char* folder_path;
     char* gotham_ip; 
     int gotham_port;
+    int window_size;        // Trames de fitxer en vol sense ACK (línia opcional "window <trames>", CONN_DEFAULT_WINDOW_SIZE si no hi és)
+    int statistics;         // 1 = es mostren les opcions en arrencar i les mesures de cada transferència (línia opcional "stats on", 0 si no hi és)
+    int capabilities;       // Capacitats CONN_CAP_* que s'ofereixen (ACK selectius i MD5 final sempre, compressió amb la línia opcional "compression on")
+    int io_engine;          // Motor d'E/S CONN_IO_* de les transferències (línia opcional "io_engine io_uring", crides al sistema si no hi és)
+    int stripes;            // Connexions paral·leles per enviar cada fitxer al worker (línia opcional "stripes <connexions>", 1 si no hi és)
+    SocketOptions socket_options;   // Opcions TCP (línies opcionals "nodelay", "quickack", "buffer", "link", "keepalive", "fastopen", "connect_timeout", "connect_stagger", "shm" i "multiplex", en qualsevol ordre; SOCKET_DEFAULT_OPTIONS si no hi són)
 } FleckConfig;
 
 typedef struct {
     char* ip;
     int port;
     int socket;
+    ConnectionParams params;    // Paràmetres de trama acordats amb el worker en el handshake 0x03
+    FramePool pool;             // Trames reutilitzables per enviar i rebre fitxers amb el worker
+    FrameReader reader;         // Lector amb buffer de les trames que arriben del worker
+    int stripes;                // Connexions paral·leles (franges) amb què es vol enviar el fitxer al worker, segons la configuració
+    MuxPool* sessions;          // Sessions multiplexades amb els workers, compartides per totes les distorsions (NULL amb "multiplex off")
+    int session;                // 1 = socket és un stream d'una sessió multiplexada (el fitxer no es reparteix en franges)
+    ConnectionOffer agreed;     // Combinació acordada per a les distorsions de la sessió (a zero si no és una sessió o el worker no n'ha acordat cap)
 } MainWorker;
 
 typedef struct {
     char* filename; 
     int status; 
     int file_type; 
+    int slot;                   // Posició (context, worker i thread) de la distorsió mentre està en curs
 } CheckStatus;
 
 typedef struct {
     int n_distortions;
     CheckStatus* distortions; 
+    pthread_mutex_t mutex;      // Els threads de distorsió actualitzen l'estat de les seves entrades mentre el thread principal n'hi afegeix
 } DistortionRecord; 
 
 typedef struct {
-    DistortionContext* distortion_context; // Punter a text_to_distort o media_to_distort
-    int* distorting_flag;                  // Punter a flag distorting_text o distorting_media
+    DistortionContext* distortion_context; // Punter al context de la posició de la distorsió
+    int* distorting_flag;                  // Punter al flag de distorsió en curs de la posició
     char* worker_type; 
     MainWorker* main_worker;               // Punter a l'estructura global de worker principal
     int gotham_socket;	
+    const ConnectionParams* gotham_params; // Punter als paràmetres de trama acordats amb Gotham
     char* folder_path;
     DistortionRecord* distortion_record;
     volatile int* exit_distortion;
     pthread_mutex_t* print_mutex;
     int* finished_distortion; 
+    int slot;                              // Posició de la distorsió, per actualitzar la seva entrada del registre
 } DistortionThreadArgsF;
 
 #define TEXT    0
 #define MEDIA   1
 
+#define FLECK_MAX_DISTORTIONS 8     // Distorsions en curs alhora (amb un worker, comparteixen la seva sessió multiplexada)
+
 #endif // _TYPE_FLECK_CUSTOM_H_
\ No newline at end of file
@@ -180,6 +180,7 @@ int main(int argc, char** argv) {
             }
 
             LOAD_printConfig(&gotham_conf, GOTHAM_CONF);
+            SOCKET_configure(&gotham_conf.socket_options);
             
             if (SRV_initGothamServer(&gotham_server, &gotham_conf) == -1) {
                 IO_printStatic(STDOUT_FILENO, RED "Error: Initializing Gotham server\n" RESET);
@@ -19,8 +19,10 @@
 /*********************************************** 
 * 
 * @Finalidad: Proporcionar a un fleck los detalles del worker principal asignado 
-*             para el tipo de media solicitado, incluyendo IP y puerto. En caso de 
-*             no encontrar un worker adecuado, se envía una respuesta de error. 
+*             para el tipo de media solicitado, incluyendo IP y puerto, y los workers 
+*             alternativos del mismo tipo, a los que el fleck se conecta si el principal 
+*             no responde (quedan en cola hasta que Gotham promueve a uno de ellos). En 
+*             caso de no encontrar un worker adecuado, se envía una respuesta de error. 
 * 
 * @Parámetros: 
 * in/out: server = Puntero a la estructura `GothamServer` que contiene la lista de workers conectados. 
@@ -34,6 +36,10 @@
 void HANDLE_provideFleckMainWorkerDetails(GothamServer *server, int client_socket, char *mediaType, int type) {
     char *worker_ip = NULL;	
     int worker_port;
+    int worker_socket = -1;
+    char candidates[SOCKET_MAX_ENDPOINTS * (INET_ADDRSTRLEN + 7)] = "";   // Workers alternatius "ip:port" separats per comes
+    size_t candidates_length = 0;
+    int n_candidates = 0;
 
     WORKER_LINKEDLIST_goToHead(&server->worker_list);
     int found = 0;
@@ -42,11 +48,20 @@ void HANDLE_provideFleckMainWorkerDetails(GothamServer *server, int client_socke
         WorkerElement worker = WORKER_LINKEDLIST_get(&server->worker_list);
         
         if (strcmp(worker.worker_type, mediaType) == 0) {
-            if (worker.is_main) {
+            if (worker.is_main && !found) {
                 found = 1;  
                 worker_ip = strdup(worker.ip); //fem copia de l'atribut original per a que el punter worker_ip passat per parametres no referencii el contingut original
                 worker_port = worker.port;
-                break;      
+                worker_socket = worker.socket_fd;
+            } else if (n_candidates < SOCKET_MAX_ENDPOINTS - 1) {
+                // La resta de workers del tipus són alternatives per si el principal ha caigut i Gotham encara no se n'ha adonat
+                int written = snprintf(candidates + candidates_length, sizeof(candidates) - candidates_length, "%s%s:%d", n_candidates > 0 ? "," : "", worker.ip, worker.port);
+                if (written > 0 && (size_t)written < sizeof(candidates) - candidates_length) {
+                    candidates_length += (size_t)written;
+                    n_candidates++;
+                } else {
+                    candidates[candidates_length] = '\0';
+                }
             }
         }
 
@@ -54,21 +69,22 @@ void HANDLE_provideFleckMainWorkerDetails(GothamServer *server, int client_socke
     }
 
     if (found) {
-        // Crear trama amb IP i port del worker, Mirar lo de nptioms y cosas d estas
-        char *data;
+        // Crear trama amb IP i port del worker. Si el worker accepta trames v2 també n'indiquem la mida de dades, així el fleck ja li pot enviar les metadades en binari
+        const ConnectionParams *worker_params = MC_getClientParams(server, worker_socket);
+        Metadata metadata;
+        METADATA_init(&metadata);
+        METADATA_setString(&metadata, METADATA_IP, worker_ip);
+        METADATA_setNumber(&metadata, METADATA_PORT, (uint32_t)worker_port);
+        if (worker_params && worker_params->frame_version == FRAME_V2) {
+            METADATA_setNumber(&metadata, METADATA_DATA_SIZE, worker_params->data_size);
+        }
+        if (n_candidates > 0) METADATA_setString(&metadata, METADATA_CANDIDATES, candidates);
 
-        if (asprintf(&data, "%s&%d", worker_ip, worker_port) == -1) {
-            IO_printStatic(STDOUT_FILENO, "Error: Could not create connection string\n");
-            free(worker_ip);
-            if (data) {
-                free(data);
-            }
-            return;
+        if (COMM_sendMetadata(client_socket, type, &metadata, METADATA_MSG_WORKER_ASSIGNMENT, MC_getClientParams(server, client_socket)) < 0) {
+            IO_printStatic(STDOUT_FILENO, RED "Failed to send distord response frame to fleck.\n" RESET);
         }
-        COMM_sendDistortResponse(client_socket, data, 1, type);   
         IO_printStatic(STDOUT_FILENO, YELLOW "Forwarding worker connection details...\n" RESET);
         free(worker_ip); 
-        free(data);                  
     }
     else {
         // Crear trama de error
@@ -84,9 +100,10 @@ void HANDLE_provideFleckMainWorkerDetails(GothamServer *server, int client_socke
 *             el nombre del archivo, y si la extensión es válida para el tipo especificado. 
 * 
 * @Parámetros: 
-* in/out: data_buffer = Cadena que contiene los datos de la solicitud a validar. 
-* in/out: mediaType = Puntero que recibirá el tipo de media extraído ("Media" o "Text"). 
-* in/out: fileName = Puntero que recibirá el nombre del archivo extraído. 
+* in/out: data = Datos de la trama de la solicitud a validar (binarios o texto con '&'). 
+* in: length = Número de bytes de `data`. 
+* out: mediaType = Puntero que recibirá el tipo de media extraído ("Media" o "Text"). 
+* out: fileName = Puntero que recibirá el nombre del archivo extraído. Apunta a `data`. 
 * 
 * @Retorno: 
 *           0 = La solicitud es inválida (atributos faltantes, tipo o extensión no válidos). 
@@ -94,15 +111,15 @@ void HANDLE_provideFleckMainWorkerDetails(GothamServer *server, int client_socke
 *           2 = La solicitud es válida y corresponde a un tipo "Text". 
 * 
 ************************************************/
-int HANDLE_validateAttributesDistortRequest (char *data_buffer, char *mediaType, char **fileName) {
-    mediaType = strtok(data_buffer, "&");
-    *fileName = strtok(NULL, "&");
-
-    if (!(*mediaType) || !(*fileName)) {
+int HANDLE_validateAttributesDistortRequest (uint8_t *data, size_t length, const char **mediaType, const char **fileName) {
+    Metadata request;
+    if (METADATA_decode(data, length, METADATA_MSG_DISTORT_REQUEST, &request) < 0) {
         return 0;  
     }
+    *mediaType = METADATA_getString(&request, METADATA_MEDIA_TYPE);
+    *fileName = METADATA_getString(&request, METADATA_FILENAME);
 
-    if (strcmp(mediaType, "Media") != 0 && strcmp(mediaType, "Text") != 0) {
+    if (strcmp(*mediaType, "Media") != 0 && strcmp(*mediaType, "Text") != 0) {
         return 0;  
     }
 
@@ -120,7 +137,7 @@ int HANDLE_validateAttributesDistortRequest (char *data_buffer, char *mediaType,
     }
 
     //Bucle per mirar si dintr dels tres arrays globals es troba l'extensió
-    if (strcmp(mediaType, "Media") == 0) {
+    if (strcmp(*mediaType, "Media") == 0) {
         // Verificar a audioExtensions
         for (int i = 0; i < audioExtensionsSize; i++) {
             if (strcmp(extension, audioExtensions[i]) == 0) {
@@ -138,7 +155,7 @@ int HANDLE_validateAttributesDistortRequest (char *data_buffer, char *mediaType,
     }
 
     // Si mediaType es "Text", verifica que l'extensió sigui .txt
-    if (strcmp(mediaType, "Text") == 0 && strcmp(extension, "txt") == 0) {
+    if (strcmp(*mediaType, "Text") == 0 && strcmp(extension, "txt") == 0) {
         return 2; 
     }
 
@@ -186,24 +203,16 @@ char *HANDLE_getUsernameFromSocket(GothamServer *server, int client_socket) {
 ************************************************/
 void HANDLE_handleDistortionRequest(GothamServer *server, int client_socket, FrameResult result, int type) {
     IO_printFormat(STDOUT_FILENO, YELLOW "\n%s\n", type == 0x11 ? "Processing request to resume distortion" : "Distortion request received");
-    char *data_buffer = strdup((char *)result.frame->data);
-
-    if (!data_buffer) {
-        IO_printStatic(STDOUT_FILENO, RED "Error: Could not process warp request\n" RESET);
-        COMM_sendDistortResponse(client_socket, "MEDIA_KO", 0, type);  //KO
-        writeLog(result.frame, server->fd_log, "Error: Could not process warp request");
-        return;
-    }
 
-    //Validar atributs de la trama
-    char *mediaType = NULL;
-    char *fileName = NULL;
+    //Validar atributs de la trama (es llegeixen directament de les dades de la trama)
+    const char *mediaType = NULL;
+    const char *fileName = NULL;
     int valid = 0; 
 
     char *data = NULL;
     char *username = strdup(HANDLE_getUsernameFromSocket(server, client_socket));
     
-    valid = HANDLE_validateAttributesDistortRequest(data_buffer, mediaType, &fileName);
+    valid = HANDLE_validateAttributesDistortRequest(result.frame->data, result.frame->data_length, &mediaType, &fileName);
   
 
     switch (valid) {
@@ -235,7 +244,6 @@ void HANDLE_handleDistortionRequest(GothamServer *server, int client_socket, Fra
             break;
     }
 
-    free(data_buffer);
     free(username);
 }
 
@@ -245,35 +253,31 @@ void HANDLE_handleDistortionRequest(GothamServer *server, int client_socket, Fra
 *             y validez de la cadena, dirección IP y puerto proporcionados en la solicitud. 
 * 
 * @Parámetros: 
-* in/out: data_buffer = Cadena que contiene los datos de la solicitud de conexión. 
-* out: string = Puntero que recibirá la cadena extraída del campo de datos. 
-* out: ip_address = Puntero que recibirá la dirección IP extraída. 
-* out: port_str = Puntero que recibirá el puerto extraído como cadena. 
+* in/out: data = Datos de la trama de la solicitud de conexión (binarios o texto con '&'). 
+* in: length = Número de bytes de `data`. 
+* in: message = Mensaje esperado (`METADATA_MSG_FLECK_CONNECTION` o `METADATA_MSG_WORKER_CONNECTION`). 
+* out: request = Campos de la solicitud. Los de texto apuntan a `data`; la mida de dades 
+*                solo está presente si el cliente acepta tramas v2. 
 * 
 * @Retorno: 
 *           0 = Los atributos son inválidos (faltantes o valores no válidos). 
 *           1 = Los atributos son válidos. 
 * 
 ************************************************/
-int HANDLE_validateAttributesConnection(char *data_buffer, char **string, char **ip_address, char **port_str) {
-    //extreiem els atributs del camp de dades
-    *string = strtok(data_buffer, "&");
-    *ip_address = strtok(NULL, "&");
-    *port_str = strtok(NULL, "&");
-
-    //validem que tots els atributs existeixin
-    if (!(*string) || !(*ip_address) || !(*port_str)) {
+int HANDLE_validateAttributesConnection(uint8_t *data, size_t length, MetadataMessage message, Metadata *request) {
+    //extreiem els atributs del camp de dades i validem que hi siguin tots els obligatoris
+    if (METADATA_decode(data, length, message, request) < 0) {
         return 0;  
     }
 
     //comprovem que l'adreça IP sigui vàlida
-    if (!STRING_isValidIP(*ip_address)) {
+    if (!STRING_isValidIP(METADATA_getString(request, METADATA_IP))) {
         return 0;  
     }
 
     //comprovem que el port és vàlid 
-    int port = atoi(*port_str);
-    if (port <= 0 || port > 65535) {
+    uint32_t port = METADATA_getNumber(request, METADATA_PORT, 0);
+    if (port == 0 || port > 65535) {
         return 0;  
     }
 
@@ -296,34 +300,30 @@ int HANDLE_validateAttributesConnection(char *data_buffer, char **string, char *
 * 
 ************************************************/
 void HANDLE_handleConnectionRequest(GothamServer *server, int client_socket, FrameResult result, char client_type) {
-    // Creem una còpia dinàmica de data_buffer per evitar modificar l'original
-    char *data_buffer = strdup((char *)result.frame->data);
-    if (!data_buffer) {
-        if (client_type == 'f') {
-            COMM_sendConnectionResponse(client_socket, "CON_KO", 0, 0x01);  // Error de memòria
-            writeLog(result.frame, server->fd_log, "Error: Could not process connection request");
-        } else {
-            COMM_sendConnectionResponse(client_socket, "CON_KO", 0, 0x02);  // Error de memòria
-            writeLog(result.frame, server->fd_log, "Error: Could not process connection request");
-        }
-        return;
-    }
-
-    // Inicialitzem els punters als atributs per passar-los a la funció de validació
-    char *username = NULL;
-    char *worker_type = NULL;
-    char *ip_address = NULL;
-    char *port_str = NULL;
+    Metadata request;
     int valid = 0;
 
-    // Validem si els atributs del camp de dades són correctes
-    valid = HANDLE_validateAttributesConnection(data_buffer, client_type == 'f' ? &username : &worker_type, &ip_address, &port_str);
+    // Validem si els atributs del camp de dades són correctes (es llegeixen directament de les dades de la trama)
+    valid = HANDLE_validateAttributesConnection(result.frame->data, result.frame->data_length, client_type == 'f' ? METADATA_MSG_FLECK_CONNECTION : METADATA_MSG_WORKER_CONNECTION, &request);
     char *data = NULL;
 
     if (valid) {
+        const char *ip_address = METADATA_getString(&request, METADATA_IP);
+        int port = (int)METADATA_getNumber(&request, METADATA_PORT, 0);
+
+        // Escollim amb el client la combinació més ràpida que suportem tots dos i la desem per a la resta de la connexió
+        ConnectionParams params;
+        ConnectionOffer peer, offer;
+        FRAME_initLegacyParams(&params);
+        COMM_getOfferMetadata(&request, &peer);
+        COMM_getLocalOffer(client_socket, &params, &offer);
+        FRAME_negotiate(&peer, &offer, &params);
+        MC_setClientParams(server, client_socket, &params);
+
         if (client_type == 'f') {
-            COMM_sendConnectionResponse(client_socket, NULL, 1, 0x01);
-            MC_addFleckToServer(server, client_socket, username, ip_address, port_str);
+            const char *username = METADATA_getString(&request, METADATA_USERNAME);
+            COMM_sendConnectionResponse(client_socket, NULL, 1, 0x01, &params);
+            MC_addFleckToServer(server, client_socket, username, ip_address, port);
             if (asprintf(&data, "Fleck connected: username=%s", username) == -1) {
                 IO_printStatic(STDOUT_FILENO, "Error: Creating log\n");
                 free(data);
@@ -333,9 +333,10 @@ void HANDLE_handleConnectionRequest(GothamServer *server, int client_socket, Fra
             free(data);
         }
         else {
-            COMM_sendConnectionResponse(client_socket, NULL, 1, 0x02);
-            int is_main_worker = MC_addWorkerToServer(server, client_socket, worker_type, ip_address, port_str);
-            if (asprintf(&data, "%s connected: IP:%s:%s", !strcmp(worker_type, "Text") ? "Enigma" : "Harley", ip_address, port_str) == -1) {
+            const char *worker_type = METADATA_getString(&request, METADATA_WORKER_TYPE);
+            COMM_sendConnectionResponse(client_socket, NULL, 1, 0x02, &params);
+            int is_main_worker = MC_addWorkerToServer(server, client_socket, worker_type, ip_address, port);
+            if (asprintf(&data, "%s connected: IP:%s:%d", !strcmp(worker_type, "Text") ? "Enigma" : "Harley", ip_address, port) == -1) {
                     IO_printStatic(STDOUT_FILENO, "Error: Creating log\n");
                     free(data);
                     return;
@@ -345,7 +346,7 @@ void HANDLE_handleConnectionRequest(GothamServer *server, int client_socket, Fra
 
             if (is_main_worker) {
                 COMM_sendNewMainWorkerResponse(client_socket);
-                if (asprintf(&data, "%s assigned as primary worker: IP:%s:%s", !strcmp(worker_type, "Text") ? "Enigma" : "Harley", ip_address, port_str) == -1) {
+                if (asprintf(&data, "%s assigned as primary worker: IP:%s:%d", !strcmp(worker_type, "Text") ? "Enigma" : "Harley", ip_address, port) == -1) {
                     IO_printStatic(STDOUT_FILENO, "Error: Creating log\n");
                     free(data);
                     return;
@@ -356,12 +357,10 @@ void HANDLE_handleConnectionRequest(GothamServer *server, int client_socket, Fra
         }        
     } else {
         IO_printStatic(STDOUT_FILENO, RED "Connection request failed: invalid attributes.\n" RESET);
-        COMM_sendConnectionResponse(client_socket, "CON_KO", 0, client_type == 'f' ? 0x01 : 0x02);
+        COMM_sendConnectionResponse(client_socket, "CON_KO", 0, client_type == 'f' ? 0x01 : 0x02, NULL);
         writeLog(result.frame, server->fd_log, "Error: Invalid connection request");
 
     }
-
-    free(data_buffer); 
 }
 
 
@@ -453,6 +452,7 @@ int HANDLE_acceptNewConnection(int listen_socket, GothamServer *server, bool is_
         IO_printStatic(STDOUT_FILENO, "Error: Error accepting connection.\n");
         return -1;
     }
+    SOCKET_tuneConnection(client_socket);
 
     //afegim el socket a l'estructura de sockets de clients del server
     MC_addClient(server, client_socket, is_fleck ? 'f' : 'w');
@@ -59,12 +59,58 @@ void MC_addClient(GothamServer *server, int client_socket, char client_type) {
 
     server->clients[server->n_clients].socket_fd = client_socket;
     server->clients[server->n_clients].type = client_type;
+    FRAME_initLegacyParams(&server->clients[server->n_clients].params); // Fins al handshake el client es tracta com a v1
     server->n_clients++;
 
     FD_SET(client_socket, &server->active_fds);
     MC_updateMaxFD(server);
 }
 
+/*********************************************** 
+* 
+* @Finalidad: Guardar los parámetros de trama acordados con un cliente durante su 
+*             handshake de conexión. 
+* 
+* @Parámetros: 
+* in/out: server = Puntero a la estructura `GothamServer` que contiene la lista de clientes conectados. 
+* in: client_socket = Descriptor del socket del cliente. 
+* in: params = Parámetros acordados con el cliente. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void MC_setClientParams(GothamServer *server, int client_socket, const ConnectionParams *params) {
+    for (int i = 0; i < server->n_clients; i++) {
+        if (server->clients[i].socket_fd == client_socket) {
+            server->clients[i].params = *params;
+            return;
+        }
+    }
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Obtener los parámetros de trama acordados con un cliente durante su 
+*             handshake de conexión. 
+* 
+* @Parámetros: 
+* in: server = Puntero a la estructura `GothamServer` que contiene la lista de clientes conectados. 
+* in: client_socket = Descriptor del socket del cliente. 
+* 
+* @Retorno: 
+*           Puntero a los parámetros acordados con el cliente. 
+*           NULL si no hay ningún cliente con ese socket. 
+* 
+************************************************/
+const ConnectionParams *MC_getClientParams(GothamServer *server, int client_socket) {
+    for (int i = 0; i < server->n_clients; i++) {
+        if (server->clients[i].socket_fd == client_socket) {
+            return &server->clients[i].params;
+        }
+    }
+    return NULL;
+}
+
 /*********************************************** 
 * 
 * @Finalidad: Agregar un nuevo fleck al servidor Gotham, creando una estructura `Fleck` 
@@ -75,18 +121,18 @@ void MC_addClient(GothamServer *server, int client_socket, char client_type) {
 * in: client_socket = Descriptor del socket del fleck que se conectó. 
 * in: username = Nombre del usuario asociado al fleck. 
 * in: ip_address = Dirección IP del fleck conectado. 
-* in: port_str = Puerto del fleck conectado en formato de cadena. 
+* in: port = Puerto del fleck conectado. 
 * 
 * @Retorno: Ninguno. 
 * 
 ************************************************/
-void MC_addFleckToServer(GothamServer *server, int client_socket, char* username, char* ip_address, char* port_str) {
+void MC_addFleckToServer(GothamServer *server, int client_socket, const char* username, const char* ip_address, int port) {
     Fleck new_fleck;
 
-    if (username && ip_address && port_str) {
+    if (username && ip_address) {
         new_fleck.username = strdup(username);
         new_fleck.ip = strdup(ip_address);
-        new_fleck.port = atoi(port_str);  
+        new_fleck.port = port;  
         new_fleck.socket_fd = client_socket;
         FLECK_LINKEDLIST_add(&server->fleck_list, new_fleck);
         IO_printFormat(STDOUT_FILENO, GREEN "\nNew Fleck connected: %s\n" RESET, new_fleck.username);
@@ -104,20 +150,20 @@ void MC_addFleckToServer(GothamServer *server, int client_socket, char* username
 * in: client_socket = Descriptor del socket del worker que se conectó. 
 * in: worker_type = Tipo de worker conectado ("Text" o "Media"). 
 * in: ip_address = Dirección IP del worker conectado. 
-* in: port_str = Puerto del worker conectado en formato de cadena. 
+* in: port = Puerto del worker conectado. 
 * 
 * @Retorno: 
 *           1 = El worker agregado es el principal (main worker) para su tipo. 
 *           0 = El worker agregado no es el principal. 
 * 
 ************************************************/
-int MC_addWorkerToServer(GothamServer *server, int client_socket, char* worker_type, char* ip_address, char* port_str) {
+int MC_addWorkerToServer(GothamServer *server, int client_socket, const char* worker_type, const char* ip_address, int port) {
     Worker new_worker;
 
-    if (worker_type && ip_address && port_str) {
+    if (worker_type && ip_address) {
         new_worker.worker_type = strdup(worker_type);
         new_worker.ip = strdup(ip_address);
-        new_worker.port = atoi(port_str);  
+        new_worker.port = port;  
         new_worker.socket_fd = client_socket;
         if (strcmp(worker_type, "Text") == 0) {
             new_worker.is_main = (server->n_enigmas == 0) ? 1 : 0;
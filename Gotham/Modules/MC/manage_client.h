@@ -57,6 +57,21 @@
 ************************************************/
 void MC_addClient(GothamServer *server, int client_socket, char client_type);
 
+/*********************************************** 
+* 
+* @Finalidad: Guardar los parámetros de trama acordados con un cliente durante su 
+*             handshake de conexión. 
+* 
+* @Parámetros: 
+* in/out: server = Puntero a la estructura `GothamServer` que contiene la lista de clientes conectados. 
+* in: client_socket = Descriptor del socket del cliente. 
+* in: params = Parámetros acordados con el cliente. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void MC_setClientParams(GothamServer *server, int client_socket, const ConnectionParams *params);
+
 /*********************************************** 
 * 
 * @Finalidad: Eliminar un cliente (fleck o worker) del servidor Gotham, cerrando su socket, 
@@ -72,6 +87,22 @@ void MC_addClient(GothamServer *server, int client_socket, char client_type);
 ************************************************/
 void MC_removeClient(GothamServer *server, int client_socket, char client_type);
 
+/*********************************************** 
+* 
+* @Finalidad: Obtener los parámetros de trama acordados con un cliente durante su 
+*             handshake de conexión. 
+* 
+* @Parámetros: 
+* in: server = Puntero a la estructura `GothamServer` que contiene la lista de clientes conectados. 
+* in: client_socket = Descriptor del socket del cliente. 
+* 
+* @Retorno: 
+*           Puntero a los parámetros acordados con el cliente. 
+*           NULL si no hay ningún cliente con ese socket. 
+* 
+************************************************/
+const ConnectionParams *MC_getClientParams(GothamServer *server, int client_socket);
+
 /*********************************************** 
 * 
 * @Finalidad: Agregar un nuevo fleck al servidor Gotham, creando una estructura `Fleck` 
@@ -82,12 +113,12 @@ void MC_removeClient(GothamServer *server, int client_socket, char client_type);
 * in: client_socket = Descriptor del socket del fleck que se conectó. 
 * in: username = Nombre del usuario asociado al fleck. 
 * in: ip_address = Dirección IP del fleck conectado. 
-* in: port_str = Puerto del fleck conectado en formato de cadena. 
+* in: port = Puerto del fleck conectado. 
 * 
 * @Retorno: Ninguno. 
 * 
 ************************************************/
-void MC_addFleckToServer(GothamServer *server, int client_socket, char* username, char* ip_address, char* port_str);
+void MC_addFleckToServer(GothamServer *server, int client_socket, const char* username, const char* ip_address, int port);
 
 /*********************************************** 
 * 
@@ -100,13 +131,13 @@ void MC_addFleckToServer(GothamServer *server, int client_socket, char* username
 * in: client_socket = Descriptor del socket del worker que se conectó. 
 * in: worker_type = Tipo de worker conectado ("Text" o "Media"). 
 * in: ip_address = Dirección IP del worker conectado. 
-* in: port_str = Puerto del worker conectado en formato de cadena. 
+* in: port = Puerto del worker conectado. 
 * 
 * @Retorno: 
 *           1 = El worker agregado es el principal (main worker) para su tipo. 
 *           0 = El worker agregado no es el principal. 
 * 
 ************************************************/
-int MC_addWorkerToServer(GothamServer *server, int client_socket, char* worker_type, char* ip_address, char* port_str);
+int MC_addWorkerToServer(GothamServer *server, int client_socket, const char* worker_type, const char* ip_address, int port);
 
 #endif // _MANAGE_CLIENT_GOTHAM_H_
\ No newline at end of file
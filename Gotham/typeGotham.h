@@ -14,6 +14,8 @@
 
 #include "../Libs/LinkedList/fleckLinkedList.h"
 #include "../Libs/LinkedList/workerLinkedList.h"
+#include "../Libs/Structure/typeConnection.h"
+#include "../Libs/Socket/socket.h"
 
 //Constants pròpies
 #define MAX_CLIENTS 10
@@ -21,6 +23,7 @@
 typedef struct {
     int socket_fd; 
     char type; //'f' = fleck; 'w' = worker
+    ConnectionParams params; // Paràmetres de trama acordats en el handshake 0x01/0x02
 } Client; 
 
 typedef struct {
@@ -42,6 +45,8 @@ typedef struct {
     int fleck_port; 
     char * worker_ip; 
     int worker_port; 
+    int statistics;         // 1 = es mostren les opcions TCP en arrencar (línia opcional "stats on", 0 si no hi és)
+    SocketOptions socket_options;   // Opcions TCP (línies opcionals "nodelay", "quickack", "buffer", "link", "keepalive", "fastopen", "connect_timeout", "connect_stagger", "shm" i "multiplex", en qualsevol ordre; SOCKET_DEFAULT_OPTIONS si no hi són)
 } GothamConfig; 
 
 #endif // _TYPE_GOTHAM_CUSTOM_H_
\ No newline at end of file
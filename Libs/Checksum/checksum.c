@@ -0,0 +1,195 @@
+/***********************************************
+*
+* @Autores: Alexandre Contreras, Armand López.
+*
+* @Finalidad: Proveer el cálculo del CRC32C (polinomio de Castagnoli) de las tramas.
+*             Si el procesador soporta SSE4.2 se usa su instrucción CRC32, que procesa
+*             8 bytes por instrucción; si no, una implementación "slicing-by-8" con
+*             tablas que se generan la primera vez que se necesitan.
+*
+* @Fecha de creación: 16 de octubre de 2026.
+*
+* @Última modificación: 16 de octubre de 2026.
+*
+************************************************/
+
+#include "checksum.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>  // _mm_crc32_u8, _mm_crc32_u32, _mm_crc32_u64
+#define CHECKSUM_HAS_SSE42_PATH 1
+#else
+#define CHECKSUM_HAS_SSE42_PATH 0
+#endif
+
+#define CHECKSUM_CRC32C_POLY 0x82F63B78u   // Polinomi de Castagnoli en ordre de bits invertit
+
+static uint32_t crc32c_table[8][256];                      // Taules del càlcul per software
+static int crc32c_hardware = 0;                            // 1 si s'utilitza la instrucció de SSE4.2
+static pthread_once_t crc32c_once = PTHREAD_ONCE_INIT;     // Inicialització única de les taules i la detecció
+
+/***********************************************
+*
+* @Finalidad: Generar las tablas del cálculo por software y detectar si el procesador
+*             dispone de la instrucción CRC32 de SSE4.2. Se ejecuta una sola vez.
+*
+* @Parámetros: Ninguno.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+static void CHECKSUM_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (CHECKSUM_CRC32C_POLY & (0u - (crc & 1)));
+        }
+        crc32c_table[0][i] = crc;
+    }
+
+    //cada taula k avança el CRC d'un byte seguit de k bytes a zero
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int k = 1; k < 8; k++) {
+            uint32_t prev = crc32c_table[k - 1][i];
+            crc32c_table[k][i] = (prev >> 8) ^ crc32c_table[0][prev & 0xFF];
+        }
+    }
+
+#if CHECKSUM_HAS_SSE42_PATH
+    __builtin_cpu_init();
+    crc32c_hardware = __builtin_cpu_supports("sse4.2") ? 1 : 0;
+#endif
+}
+
+/***********************************************
+*
+* @Finalidad: Calcular el CRC32C por software procesando 8 bytes por iteración.
+*
+* @Parámetros:
+* in: crc = Estado interno del CRC (ya invertido).
+* in: p = Puntero a los bytes.
+* in: length = Número de bytes.
+*
+* @Retorno: Estado interno del CRC tras procesar los bytes.
+*
+************************************************/
+static uint32_t CHECKSUM_crc32cSoftware(uint32_t crc, const uint8_t *p, size_t length) {
+    while (length >= 8) {
+        uint32_t low, high;
+        memcpy(&low, p, sizeof(low));
+        memcpy(&high, p + 4, sizeof(high));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        low = __builtin_bswap32(low);
+        high = __builtin_bswap32(high);
+#endif
+        low ^= crc;
+        crc = crc32c_table[7][low & 0xFF] ^ crc32c_table[6][(low >> 8) & 0xFF] ^
+              crc32c_table[5][(low >> 16) & 0xFF] ^ crc32c_table[4][low >> 24] ^
+              crc32c_table[3][high & 0xFF] ^ crc32c_table[2][(high >> 8) & 0xFF] ^
+              crc32c_table[1][(high >> 16) & 0xFF] ^ crc32c_table[0][high >> 24];
+        p += 8;
+        length -= 8;
+    }
+
+    while (length--) {
+        crc = (crc >> 8) ^ crc32c_table[0][(crc ^ *p++) & 0xFF];
+    }
+    return crc;
+}
+
+#if CHECKSUM_HAS_SSE42_PATH
+/***********************************************
+*
+* @Finalidad: Calcular el CRC32C con la instrucción CRC32 de SSE4.2. Solo se llama si
+*             `CHECKSUM_init` ha detectado que el procesador la soporta.
+*
+* @Parámetros:
+* in: crc = Estado interno del CRC (ya invertido).
+* in: p = Puntero a los bytes.
+* in: length = Número de bytes.
+*
+* @Retorno: Estado interno del CRC tras procesar los bytes.
+*
+************************************************/
+__attribute__((target("sse4.2")))
+static uint32_t CHECKSUM_crc32cHardware(uint32_t crc, const uint8_t *p, size_t length) {
+    //alineem a 8 bytes perquè les lectures grans no creuin línies de cache innecessàriament
+    while (length > 0 && ((uintptr_t)p & 7)) {
+        crc = _mm_crc32_u8(crc, *p++);
+        length--;
+    }
+
+#if defined(__x86_64__)
+    uint64_t crc64 = crc;
+    while (length >= 8) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+        p += 8;
+        length -= 8;
+    }
+    crc = (uint32_t)crc64;
+#endif
+
+    while (length >= 4) {
+        uint32_t word;
+        memcpy(&word, p, sizeof(word));
+        crc = _mm_crc32_u32(crc, word);
+        p += 4;
+        length -= 4;
+    }
+
+    while (length--) {
+        crc = _mm_crc32_u8(crc, *p++);
+    }
+    return crc;
+}
+#endif
+
+/***********************************************
+*
+* @Finalidad: Calcular el CRC32C de un bloque de bytes. El resultado de una llamada se
+*             puede pasar como `crc` de la siguiente para calcular el CRC de varios
+*             bloques consecutivos como si fueran uno solo.
+*
+* @Parámetros:
+* in: crc = CRC de los bloques anteriores, o 0 para empezar un cálculo nuevo.
+* in: data = Puntero a los bytes sobre los que se calculará el CRC.
+* in: length = Número de bytes de `data`.
+*
+* @Retorno: Valor CRC32C acumulado hasta el final de `data`.
+*
+************************************************/
+uint32_t CHECKSUM_crc32c(uint32_t crc, const void *data, size_t length) {
+    pthread_once(&crc32c_once, CHECKSUM_init);
+
+    crc = ~crc;
+    if (data && length > 0) {
+#if CHECKSUM_HAS_SSE42_PATH
+        if (crc32c_hardware) {
+            crc = CHECKSUM_crc32cHardware(crc, (const uint8_t *)data, length);
+        } else {
+            crc = CHECKSUM_crc32cSoftware(crc, (const uint8_t *)data, length);
+        }
+#else
+        crc = CHECKSUM_crc32cSoftware(crc, (const uint8_t *)data, length);
+#endif
+    }
+    return ~crc;
+}
+
+/***********************************************
+*
+* @Finalidad: Consultar si el CRC32C se calcula con la instrucción de hardware.
+*
+* @Parámetros: Ninguno.
+*
+* @Retorno:
+*           1 = Se usa la instrucción CRC32 de SSE4.2.
+*           0 = Se usa la implementación por tablas.
+*
+************************************************/
+int CHECKSUM_isHardwareAccelerated(void) {
+    pthread_once(&crc32c_once, CHECKSUM_init);
+    return crc32c_hardware;
+}
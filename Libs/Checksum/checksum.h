@@ -0,0 +1,52 @@
+/***********************************************
+*
+* @Autores: Alexandre Contreras y Armand López
+* @Propósito: Proveer el cálculo del CRC32C (Castagnoli) usado para verificar la
+*             integridad de las tramas, con la instrucción CRC32 de SSE4.2 cuando el
+*             procesador la soporta y una implementación por tablas en caso contrario.
+* @Fecha de creación: 16 de octubre de 2026
+* @Última modificación: 16 de octubre de 2026
+*
+************************************************/
+
+#ifndef _CHECKSUM_CUSTOM_H_
+#define _CHECKSUM_CUSTOM_H_
+
+//Libreries del sistema
+#include <stdint.h>    // uint8_t, uint32_t, uint64_t
+#include <stddef.h>    // size_t
+#include <string.h>    // memcpy
+#include <pthread.h>   // pthread_once
+
+//Funcions
+
+/***********************************************
+*
+* @Finalidad: Calcular el CRC32C de un bloque de bytes. El resultado de una llamada se
+*             puede pasar como `crc` de la siguiente para calcular el CRC de varios
+*             bloques consecutivos como si fueran uno solo.
+*
+* @Parámetros:
+* in: crc = CRC de los bloques anteriores, o 0 para empezar un cálculo nuevo.
+* in: data = Puntero a los bytes sobre los que se calculará el CRC.
+* in: length = Número de bytes de `data`.
+*
+* @Retorno: Valor CRC32C acumulado hasta el final de `data`.
+*
+************************************************/
+uint32_t CHECKSUM_crc32c(uint32_t crc, const void *data, size_t length);
+
+/***********************************************
+*
+* @Finalidad: Consultar si el CRC32C se calcula con la instrucción de hardware.
+*
+* @Parámetros: Ninguno.
+*
+* @Retorno:
+*           1 = Se usa la instrucción CRC32 de SSE4.2.
+*           0 = Se usa la implementación por tablas.
+*
+************************************************/
+int CHECKSUM_isHardwareAccelerated(void);
+
+#endif // _CHECKSUM_CUSTOM_H_
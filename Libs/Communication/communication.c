@@ -15,382 +15,3372 @@
 
 #include "communication.h"
 
+#define COMM_RING_USER_DATA(operation, index) (((uint64_t)(operation) << 32) | (uint64_t)(index))    // Identificador d'una operació io_uring sobre una trama del lot
+
+#define COMM_SLOT_FREE    0     // Trama lliure
+#define COMM_SLOT_READING 1     // S'hi està llegint un paquet del fitxer
+#define COMM_SLOT_READY   2     // Trama completa esperant el seu torn per sortir pel socket
+
+#define COMM_ENGINE_FRAMES    0     // Els paquets es copien a les trames del pool (preadv i writev en enviar; projecció o pwrite en rebre)
+#define COMM_ENGINE_ZERO_COPY 1     // Els paquets van del fitxer al socket amb sendfile, sense passar per les trames (només en enviar)
+#define COMM_ENGINE_IO_URING  2     // Les lectures, escriptures i enviaments es fan amb io_uring sobre les trames del pool
+
+typedef struct {
+    Frame *frame;           // Trama que s'envia
+    Frame *source;          // Trama on es llegeix el paquet (la mateixa si no hi ha compressió)
+    int packet;             // Paquet del fitxer que porta
+    uint32_t length;        // Bytes de dades del fitxer del paquet
+    struct iovec wire;      // Trama serialitzada tal com surt pel socket
+    int state;              // COMM_SLOT_*
+} RingSlot;                 // Trama del lot d'enviament amb io_uring
+
+typedef struct {
+    int packet[FRAME_POOL_SIZE];        // Paquet que s'està escrivint des de cada trama (-1 si la trama és lliure)
+    uint32_t length[FRAME_POOL_SIZE];   // Bytes de l'escriptura de cada trama
+    int pending;                        // Escriptures en curs
+} RingWrites;               // Escriptures al fitxer en curs de la recepció amb io_uring
+
+typedef struct {
+    MerkleTree *merkle;                 // Arbre del fitxer amb les fulles (NULL si no es comproven els blocs)
+    const DistortionStripe *stripe;     // Franja que rep aquesta connexió (NULL = el fitxer sencer): només es comproven els blocs que hi són sencers
+    int first_packet;                   // Primer i últim paquet rebuts des de l'última comprovació (first_packet > last_packet si no n'hi ha cap)
+    int last_packet;
+    char *filename;
+    pthread_mutex_t *print_mutex;
+} ChunkCheck;               // Comprovació dels blocs rebuts contra l'arbre de Merkle del fitxer
+
+typedef struct {
+    FileTransfer transfer;              // Transferència de la franja: apunta al seu progrés, al seu bitmap i al pool i lector de la seva connexió
+    int index;                          // Franja que transporta aquesta connexió
+    const int *sockets;                 // Connexions de totes les franges, per tallar-les si aquesta falla
+    int n_stripes;
+    DistortionStripe range;             // Paquets de la franja
+    PacketMap received;                 // Bitmap propi de la franja (només en recepció)
+    int n_processed_packets;            // Paquets confirmats, comptant com a confirmats els de fora de la franja
+    const ConnectionParams *params;
+    FramePool own_pool;                 // Pool i lector propis de les connexions addicionals
+    FrameReader own_reader;
+    int result;                         // Resultat de la transferència de la franja (TRANSFER_SUCCESS, ...)
+} StripeTransfer;           // Franja d'un fitxer que es transfereix per una connexió paral·lela
+
+typedef struct {
+    const FileTransfer *transfer;       // Fitxer i progrés de la transferència
+    int socket;                         // Socket per on surten els paquets
+    const ConnectionParams *params;
+    int engine;                         // COMM_ENGINE_* amb què surten els paquets pel socket
+    int shm;                            // El receptor és a la mateixa màquina: els paquets que falten passen primer per un anell de memòria compartida
+    int fd;                             // Fitxer obert per llegir (-1 si no s'ha pogut obrir)
+    off_t file_size;
+    int n_packets;                      // Paquets a enviar (es redueix si el fitxer s'acaba abans)
+    int next_packet;                    // Següent paquet a enviar
+    uint32_t data_size;
+    int sack;                           // La connexió ha acordat CONN_CAP_SACK
+    int compress;                       // La connexió ha acordat CONN_CAP_COMPRESSION
+    uint32_t offset_size;               // Bytes de cada trama reservats a l'offset del paquet
+    PacketMap acked;                    // Paquets que el receptor ha confirmat (només amb ACK selectius)
+    Frame *batch[FRAME_POOL_SIZE];      // Trames reservades del pool (amb compressió, la segona meitat rep el fitxer)
+    int n_frames;
+    int batch_size;                     // Paquets per lot com a màxim
+    struct iovec file_iov[FRAME_POOL_SIZE];     // Camps de dades on preadv llegeix cada paquet del lot
+    Frame *sparse_frame;                // Trama on es codifiquen els paquets amb trams d'un mateix byte (CONN_CAP_SPARSE), o NULL
+    uint8_t *mapped;                    // Projecció del fitxer on es busquen els trams dels paquets que surten amb sendfile
+    IORing ring;                        // Ring del motor io_uring (buit amb les crides al sistema)
+    int buffer_index;                   // Índex del pool registrat al ring (-1 si no s'ha pogut registrar)
+    ShmRing shm_ring;                   // Anell de la transferència (buit si no s'ha pogut fer servir)
+    CongestionControl control;          // Finestra i lot, que s'ajusten amb el RTT i el cabal dels ACK
+    int inline_digest;                  // El MD5 surt darrere de l'últim paquet, abans dels últims ACK
+    int digest_sent;
+    SparseStats sparse_stats;
+    int sent_packets;
+    unsigned long long bytes_sent;      // Bytes del fitxer enviats
+    unsigned long long payload_bytes;   // Bytes de dades que han sortit a les trames (comprimits o no)
+} SendState;                // Estat d'un enviament de fitxer, compartit per les rutines de cada motor
+
+typedef struct {
+    const FileTransfer *transfer;       // Fitxer i progrés de la transferència
+    int socket;                         // Socket per on arriben els paquets
+    const ConnectionParams *params;
+    int engine;                         // COMM_ENGINE_FRAMES o COMM_ENGINE_IO_URING
+    int shm;                            // L'emisor és a la mateixa màquina: els paquets que falten arriben primer per un anell de memòria compartida
+    int fd;                             // Fitxer obert per escriure (-1 si no s'ha pogut obrir)
+    off_t file_size;
+    uint8_t *mapped;                    // Projecció del fitxer on es copien els paquets (NULL si s'escriuen amb pwrite o io_uring)
+    uint32_t data_size;
+    int sack;                           // La connexió ha acordat CONN_CAP_SACK
+    IORing ring;                        // Ring del motor io_uring (buit amb les crides al sistema)
+    int buffer_index;                   // Índex del pool registrat al ring (-1 si no s'ha pogut registrar)
+    ShmRing shm_ring;                   // Anell de la transferència (buit si no s'ha fet servir)
+    Frame *frames[FRAME_POOL_SIZE];     // Trames del pool on es reben els paquets (amb io_uring, un lot que s'alterna mentre s'escriuen)
+    int n_frames;
+    ChunkCheck check;                   // Comprovació dels blocs rebuts contra l'arbre de Merkle
+    int inline_digest;                  // El MD5 arriba darrere dels paquets (o entre ells, si es torna a demanar un bloc)
+    char *digest;                       // MD5 que ha enviat l'emisor (NULL fins que arriba)
+    int written_packets;
+    SparseStats sparse_stats;
+} ReceiveState;             // Estat d'una recepció de fitxer, compartit per les rutines de cada motor
+
+static int show_statistics = 0;     // Línia "stats on" de la configuració: es mostren les mesures de cada transferència
+
+/*********************************************** 
+* 
+* @Finalidad: Activar o desactivar las medidas que se muestran después de cada 
+*             transferencia de archivo (línea `stats on` de la configuración). Sin ellas, 
+*             la consola solo muestra los mensajes habituales. 
+* 
+* @Parámetros: 
+* in: enabled = 1 para mostrar las medidas, 0 para no mostrarlas. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void COMM_setStatistics(int enabled) {
+    show_statistics = enabled;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Indicar si se muestran las medidas de las transferencias (ver 
+*             `COMM_setStatistics`). 
+* 
+* @Parámetros: Ninguno. 
+* 
+* @Retorno: 
+*           1 = Se muestran las medidas. 
+*           0 = No se muestran. 
+* 
+************************************************/
+int COMM_showStatistics(void) {
+    return show_statistics;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Recibir y procesar una trama de reconocimiento (ACK) desde un socket, 
+*             verificando posibles errores o desconexiones. Los ACK acumulativos llevan 
+*             en el campo de datos el número de paquetes recibidos de forma contigua. 
+* 
+* @Parámetros: 
+* in/out: reader = Lector con buffer de la conexión desde la cual se espera recibir la trama ACK. 
+* out: acked_packets = Número de paquetes confirmados por el ACK, o -1 si el ACK no lleva 
+*                      datos (peer antiguo que confirma los paquetes de uno en uno). 
+* 
+* @Retorno: 
+*           TRANSFER_SUCCESS = La trama ACK fue recibida y procesada correctamente. 
+*           REMOTE_END_DISCONNECTION = El extremo remoto se desconectó. 
+*           UNEXPECTED_ERROR = Error inesperado al recibir la trama. 
+* 
+************************************************/
+int COMM_retrieveAckFrame(FrameReader *reader, int *acked_packets) {
+    int error = UNEXPECTED_ERROR;
+
+    // L'ACK cap en una trama v1, per tant el rebem a la pila sense reservar memòria
+    uint8_t storage[FRAME_STORAGE_SIZE(DATA_SIZE)];
+    Frame ack_frame;
+    FRAME_initFrame(&ack_frame, storage, sizeof(storage));
+
+    FrameErrorCode error_code = FRAME_readerReceiveFrameInto(reader, &ack_frame);
+    if (error_code != FRAME_SUCCESS) {
+        if(error_code == FRAME_DISCONNECTED) {
+            error = REMOTE_END_DISCONNECTION; 
+        }
+        return error; 
+    }
+
+    *acked_packets = ack_frame.data_length > 0 ? atoi((char *)ack_frame.data) : -1;
+    return TRANSFER_SUCCESS;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Crear y enviar una trama de reconocimiento (ACK) acumulativo a través de un 
+*             socket especificado. 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket a través del cual se enviará la trama ACK. 
+* in: acked_packets = Número de paquetes recibidos de forma contigua que se confirman. 
+* 
+* @Retorno: 
+*           TRANSFER_SUCCESS = La trama ACK fue creada y enviada correctamente. 
+*           UNEXPECTED_ERROR = Error al crear o enviar la trama ACK. 
+* 
+************************************************/
+int COMM_sendAckFrame(int socket, int acked_packets) {
+    char count[12];
+    int count_length = snprintf(count, sizeof(count), "%d", acked_packets);
+
+    // Construïm l'ACK sobre un buffer de la pila per no reservar memòria per cada confirmació
+    uint8_t storage[FRAME_STORAGE_SIZE(DATA_SIZE)];
+    Frame ack_frame;
+    FRAME_initFrame(&ack_frame, storage, sizeof(storage));
+    FRAME_fillFrame(&ack_frame, 0x12, count, count_length);
+
+    if (FRAME_sendFrame(socket, &ack_frame) < 0) {
+        return UNEXPECTED_ERROR;
+    }
+    return TRANSFER_SUCCESS;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Crear y enviar un ACK selectivo con el primer paquete que falta y el bitmap 
+*             de los paquetes recibidos a partir de este, de modo que el emisor solo 
+*             reenvíe los huecos. Se usa en las conexiones que han acordado `CONN_CAP_SACK`. 
+*             Con tramas v2 el bitmap puede ocupar todo el tamaño de datos acordado. 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket a través del cual se enviará la trama ACK. 
+* in: received = Bitmap de paquetes escritos en el archivo. 
+* in: params = Parámetros acordados con el otro extremo. 
+* 
+* @Retorno: 
+*           TRANSFER_SUCCESS = La trama ACK fue creada y enviada correctamente. 
+*           UNEXPECTED_ERROR = Error al crear o enviar la trama ACK. 
+* 
+************************************************/
+static int COMM_sendSackFrame(int socket, const PacketMap *received, const ConnectionParams *params) {
+    // En v2 el bitmap pot ocupar tota la mida de dades acordada; si hi cap (o en v1, on el que no hi cap es tornarà a demanar més endavant) es codifica en una trama de la pila
+    size_t capacity = params->frame_version == FRAME_V2 ? params->data_size : DATA_SIZE;
+    size_t needed = SACK_ACK_HEADER_SIZE + ((size_t)received->n_packets + 7) / 8;
+    if (capacity > needed) capacity = needed;
+    if (capacity < DATA_SIZE) capacity = DATA_SIZE;
+
+    uint8_t stack_storage[FRAME_STORAGE_SIZE(DATA_SIZE)];
+    uint8_t *storage = capacity > DATA_SIZE ? (uint8_t *)malloc(FRAME_STORAGE_SIZE(capacity)) : stack_storage;
+    if (!storage) return UNEXPECTED_ERROR;
+
+    Frame ack_frame;
+    FRAME_initFrame(&ack_frame, storage, FRAME_STORAGE_SIZE(capacity));
+    size_t ack_length = SACK_encodeAck(received, ack_frame.data, capacity);
+    FRAME_fillFrame(&ack_frame, 0x12, NULL, ack_length);
+
+    int result = FRAME_sendFrameWithParams(socket, &ack_frame, params) < 0 ? UNEXPECTED_ERROR : TRANSFER_SUCCESS;
+    if (storage != stack_storage) free(storage);
+    return result;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Marcar en el bitmap del emisor los paquetes que confirma un ACK selectivo 
+*             recibido o, si es una petición de bloque corrupto (trama 0x16), volver a 
+*             marcar sus paquetes como no confirmados para que se reenvíen. 
+* 
+* @Parámetros: 
+* in: ack_frame = Trama recibida. 
+* in/out: acked = Bitmap de paquetes confirmados por el receptor. 
+* in: next_packet = Siguiente paquete que enviará el emisor. 
+* out: acked_in_flight = Número de paquetes en vuelo que dejan de estarlo (ver `COMM_retrieveSackFrame`). 
+* 
+* @Retorno: 
+*           TRANSFER_SUCCESS = La trama fue procesada correctamente. 
+*           UNEXPECTED_ERROR = Tipo de trama inesperado o ACK malformado. 
+* 
+************************************************/
+static int COMM_applySackFrame(const Frame *ack_frame, PacketMap *acked, int next_packet, int *acked_in_flight) {
+    if (ack_frame->type == 0x16) {
+        if (ack_frame->data_length < COMM_CHUNK_RETRY_SIZE) return UNEXPECTED_ERROR;
+
+        int first = (int)(((uint32_t)ack_frame->data[0] << 24) | ((uint32_t)ack_frame->data[1] << 16) | ((uint32_t)ack_frame->data[2] << 8) | ack_frame->data[3]);
+        int count = (int)(((uint32_t)ack_frame->data[4] << 24) | ((uint32_t)ack_frame->data[5] << 16) | ((uint32_t)ack_frame->data[6] << 8) | ack_frame->data[7]);
+        if (first < 0 || count < 0 || first >= acked->n_packets) return UNEXPECTED_ERROR;
+
+        //els paquets del bloc enviats i encara sense confirmar ja no es confirmaran: deixen d'estar en vol
+        *acked_in_flight = 0;
+        for (int packet = first; packet < first + count && packet < next_packet && packet < acked->n_packets; packet++) {
+            if (!SACK_isReceived(acked, packet)) (*acked_in_flight)++;
+        }
+        SACK_markMissing(acked, first, count);
+        return TRANSFER_SUCCESS;
+    }
+    if (ack_frame->type != 0x12) return UNEXPECTED_ERROR;
+
+    *acked_in_flight = SACK_applyAck(acked, ack_frame->data, ack_frame->data_length, next_packet);
+    return *acked_in_flight < 0 ? UNEXPECTED_ERROR : TRANSFER_SUCCESS;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Recibir un ACK selectivo y marcar en el bitmap del emisor los paquetes que 
+*             el receptor confirma tener. Si en su lugar llega una petición de bloque 
+*             corrupto (trama 0x16), sus paquetes se vuelven a marcar como no confirmados 
+*             para que se reenvíen. 
+* 
+* @Parámetros: 
+* in/out: reader = Lector con buffer de la conexión desde la cual se espera recibir la trama ACK. 
+* in/out: acked = Bitmap de paquetes confirmados por el receptor. 
+* in: next_packet = Siguiente paquete que enviará el emisor. Solo los paquetes anteriores 
+*                   pueden estar en vuelo. 
+* out: acked_in_flight = Número de paquetes en vuelo que dejan de estarlo: los que el ACK 
+*                        confirma por primera vez o, en una petición de bloque, los del 
+*                        bloque que se habían enviado y ya no se confirmarán. 
+* 
+* @Retorno: 
+*           TRANSFER_SUCCESS = La trama ACK fue recibida y procesada correctamente. 
+*           REMOTE_END_DISCONNECTION = El extremo remoto se desconectó. 
+*           UNEXPECTED_ERROR = Error inesperado al recibir la trama o ACK malformado. 
+* 
+************************************************/
+static int COMM_retrieveSackFrame(FrameReader *reader, PacketMap *acked, int next_packet, int *acked_in_flight) {
+    uint8_t storage[FRAME_STORAGE_SIZE(DATA_SIZE)];
+    Frame stack_frame;
+    Frame *large_frame = NULL;
+    FRAME_initFrame(&stack_frame, storage, sizeof(storage));
+
+    // Un ACK v2 pot ocupar tota la mida de dades acordada: només es reserva una trama si no cap a la de la pila
+    FrameErrorCode error_code = FRAME_readerReceiveFrameFit(reader, &stack_frame, &large_frame);
+    if (error_code != FRAME_SUCCESS) {
+        return error_code == FRAME_DISCONNECTED ? REMOTE_END_DISCONNECTION : UNEXPECTED_ERROR;
+    }
+    int result = COMM_applySackFrame(large_frame ? large_frame : &stack_frame, acked, next_packet, acked_in_flight);
+    FRAME_destroyFrame(large_frame);
+    return result;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Escribir al inicio de un paquete de fichero el offset de sus datos dentro 
+*             del archivo (big endian). 
+* 
+* @Parámetros: 
+* out: data = Campo de datos del paquete (como mínimo `FRAME_PACKET_OFFSET_SIZE` bytes). 
+* in: offset = Offset de los datos del paquete en el archivo. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+static void COMM_writePacketOffset(uint8_t *data, uint64_t offset) {
+    for (int i = FRAME_PACKET_OFFSET_SIZE - 1; i >= 0; i--) {
+        data[i] = offset & 0xFF;
+        offset >>= 8;
+    }
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Leer el offset que lleva al inicio un paquete de fichero. 
+* 
+* @Parámetros: 
+* in: data = Campo de datos del paquete (como mínimo `FRAME_PACKET_OFFSET_SIZE` bytes). 
+* 
+* @Retorno: Offset de los datos del paquete en el archivo. 
+* 
+************************************************/
+static uint64_t COMM_readPacketOffset(const uint8_t *data) {
+    uint64_t offset = 0;
+    for (int i = 0; i < FRAME_PACKET_OFFSET_SIZE; i++) {
+        offset = (offset << 8) | data[i];
+    }
+    return offset;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Comprobar sin bloquear si quedan datos pendientes de procesar en una conexión, 
+*             ya sea en el buffer del lector o todavía en el socket. 
+* 
+* @Parámetros: 
+* in: reader = Lector con buffer de la conexión a consultar. 
+* 
+* @Retorno: 
+*           1 = Hay datos pendientes de leer. 
+*           0 = No hay datos pendientes o no se ha podido consultar el socket. 
+* 
+************************************************/
+int COMM_hasPendingData(const FrameReader *reader) {
+    int pending = 0;
+    if (FRAME_readerBufferedBytes(reader) > 0) return 1;
+    if (ioctl(reader->socket, FIONREAD, &pending) < 0) return 0;
+    return pending > 0;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Añadir al MD5 incremental los datos de un paquete si son justo los que siguen 
+*             a los ya resumidos. Los paquetes que llegan o se envían fuera de orden no se 
+*             añaden aquí: se resumen después desde el archivo con `HASH_advance`. 
+* 
+* @Parámetros: 
+* in/out: hash = MD5 incremental del archivo, o NULL si no se calcula. 
+* in: offset = Posición del paquete dentro del archivo. 
+* in: data = Datos del paquete. 
+* in: length = Número de bytes de `data`. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+static void COMM_hashPacket(FileHash *hash, off_t offset, const uint8_t *data, uint32_t length) {
+    if (hash && offset == (off_t)hash->length) HASH_update(hash, data, length);
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Calcular hasta qué posición del archivo llegan los paquetes recibidos sin 
+*             ningún hueco, que es hasta donde se puede resumir el archivo recibido. 
+* 
+* @Parámetros: 
+* in: received = Bitmap de los paquetes escritos en el archivo. 
+* in: data_size = Bytes de datos por paquete. 
+* in: file_size = Tamaño final del archivo en bytes. 
+* 
+* @Retorno: Bytes del principio del archivo que ya están escritos. 
+* 
+************************************************/
+static off_t COMM_receivedPrefix(const PacketMap *received, uint32_t data_size, off_t file_size) {
+    off_t prefix = (off_t)received->first_missing * data_size;
+    return prefix < file_size ? prefix : file_size;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Calcular hasta qué posición se puede resumir el archivo recibido: hasta 
+*             donde llegan los paquetes sin huecos y, si se comprueban los bloques, sin 
+*             pasar del primer bloque no verificado (un paquete corrupto no debe entrar 
+*             en el MD5 aunque después se reciba de nuevo). 
+* 
+* @Parámetros: 
+* in: received = Bitmap de los paquetes escritos en el archivo. 
+* in: merkle = Árbol con los bloques verificados, o NULL si no se comprueban. 
+* in: hash = MD5 incremental del archivo. 
+* in: data_size = Bytes de datos por paquete. 
+* in: file_size = Tamaño final del archivo en bytes. 
+* 
+* @Retorno: Bytes del principio del archivo que se pueden resumir. 
+* 
+************************************************/
+static off_t COMM_hashablePrefix(const PacketMap *received, const MerkleTree *merkle, const FileHash *hash, uint32_t data_size, off_t file_size) {
+    off_t prefix = COMM_receivedPrefix(received, data_size, file_size);
+
+    if (merkle) {
+        off_t verified = MERKLE_verifiedPrefix(merkle, (off_t)hash->length, file_size);
+        if (verified < prefix) prefix = verified;
+    }
+    return prefix;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Pedir al emisor que vuelva a enviar los paquetes de un bloque corrupto 
+*             (trama 0x16 con el primer paquete y el número de paquetes, big endian). 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket por el que llega el archivo. 
+* in: first_packet = Primer paquete del bloque. 
+* in: n_packets = Número de paquetes del bloque. 
+* 
+* @Retorno: 
+*           TRANSFER_SUCCESS = Petición enviada. 
+*           UNEXPECTED_ERROR = Error al enviar la trama. 
+* 
+************************************************/
+static int COMM_sendChunkRetry(int socket, int first_packet, int n_packets) {
+    uint8_t storage[FRAME_STORAGE_SIZE(DATA_SIZE)];
+    Frame retry_frame;
+    FRAME_initFrame(&retry_frame, storage, sizeof(storage));
+
+    for (int i = 0; i < 4; i++) {
+        retry_frame.data[i] = (uint8_t)((uint32_t)first_packet >> (24 - 8 * i));
+        retry_frame.data[4 + i] = (uint8_t)((uint32_t)n_packets >> (24 - 8 * i));
+    }
+    FRAME_fillFrame(&retry_frame, 0x16, NULL, COMM_CHUNK_RETRY_SIZE);
+
+    if (FRAME_sendFrame(socket, &retry_frame) < 0) {
+        return UNEXPECTED_ERROR;
+    }
+    return TRANSFER_SUCCESS;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Anotar un paquete recibido para comprobar su bloque en la próxima 
+*             comprobación. 
+* 
+* @Parámetros: 
+* in/out: check = Comprobación de bloques de la recepción. 
+* in: packet = Paquete recibido. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+static void COMM_trackChunkPacket(ChunkCheck *check, int packet) {
+    if (packet < check->first_packet) check->first_packet = packet;
+    if (packet > check->last_packet) check->last_packet = packet;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Comprobar contra su hoja del árbol de Merkle cada bloque que tiene algún 
+*             paquete recibido desde la última comprobación y ya está entero. Los 
+*             paquetes de un bloque corrupto se desmarcan del bitmap y se piden de nuevo 
+*             al emisor, de modo que solo se reenvía ese bloque. Se llama antes de cada 
+*             ACK, para no confirmar nunca paquetes de un bloque que no se ha comprobado. 
+* 
+* @Parámetros: 
+* in/out: check = Comprobación de bloques de la recepción. Se vacía el tramo de paquetes 
+*                 pendientes de comprobar. 
+* in/out: received = Bitmap de los paquetes escritos en el archivo. 
+* in: fd = Descriptor del archivo (solo se usa si `mapped` es NULL). 
+* in: mapped = Proyección en memoria del archivo, o NULL. 
+* in: file_size = Tamaño final del archivo en bytes. 
+* in: socket = Descriptor del socket por el que llega el archivo, o -1 para no avisar al 
+*              emisor (e.g., antes del primer ACK, que ya no incluirá los paquetes). 
+* 
+* @Retorno: 
+*           >= 0 = Número de bloques corruptos encontrados. 
+*             -1 = Error al leer el archivo o al enviar una petición de bloque. 
+* 
+************************************************/
+static int COMM_checkChunks(ChunkCheck *check, PacketMap *received, int fd, const uint8_t *mapped, off_t file_size, int socket) {
+    MerkleTree *merkle = check->merkle;
+    uint32_t data_size = (uint32_t)received->data_size;
+    int corrupted = 0;
+
+    if (!merkle || check->first_packet > check->last_packet) return 0;
+
+    int first_chunk = (int)((off_t)check->first_packet * data_size / merkle->chunk_size);
+    int last_chunk = (int)((((off_t)check->last_packet + 1) * data_size - 1) / merkle->chunk_size);
+    if (last_chunk >= merkle->n_chunks) last_chunk = merkle->n_chunks - 1;
+    check->first_packet = received->n_packets;
+    check->last_packet = -1;
+
+    for (int chunk = first_chunk; chunk <= last_chunk; chunk++) {
+        int first, count, complete = 1;
+
+        if (merkle->verified[chunk]) continue;
+        MERKLE_getChunkPackets(merkle, chunk, data_size, file_size, &first, &count);
+        //els blocs que comparteixen paquets amb una altra franja es comproven quan s'han ajuntat totes
+        if (check->stripe && (first < check->stripe->first_packet || first + count > check->stripe->first_packet + check->stripe->n_packets)) continue;
+        for (int packet = first; packet < first + count && complete; packet++) complete = SACK_isReceived(received, packet);
+        if (!complete) continue;
+
+        int verified = MERKLE_verifyChunk(merkle, chunk, fd, mapped, file_size);
+        if (verified < 0) return -1;
+        if (verified) continue;
+
+        //descartem els paquets del bloc; si algun el comparteix amb un veí, el veí s'haurà de tornar a comprovar quan arribi
+        corrupted++;
+        SACK_markMissing(received, first, count);
+        if (chunk > 0 && ((off_t)chunk * merkle->chunk_size) % data_size != 0) merkle->verified[chunk - 1] = 0;
+        if (chunk + 1 < merkle->n_chunks && ((off_t)(chunk + 1) * merkle->chunk_size) % data_size != 0) merkle->verified[chunk + 1] = 0;
+        STRING_printF(check->print_mutex, STDOUT_FILENO, YELLOW, "Chunk %d of %s does not match its hash, requesting its %d packets again\n", chunk, check->filename, count);
+        if (socket >= 0 && COMM_sendChunkRetry(socket, first, count) != TRANSFER_SUCCESS) return -1;
+    }
+    return corrupted;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Devolver al pool las tramas de un lote de envío. 
+* 
+* @Parámetros: 
+* in/out: pool = Pool de tramas de la conexión. 
+* in: frames = Tramas del lote obtenidas con `FRAME_acquireFrame`. 
+* in: n_frames = Número de tramas del lote. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+static void COMM_releaseFrames(FramePool *pool, Frame **frames, int n_frames) {
+    for (int i = 0; i < n_frames; i++) {
+        FRAME_releaseFrame(pool, frames[i]);
+    }
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Completar la trama de un paquete de fichero leído a memoria: codificado con 
+*             sus tramos de un mismo byte si los tiene (trama 0x1A), comprimido si la 
+*             conexión lo ha acordado o, si no, con los datos donde ya están. 
+* 
+* @Parámetros: 
+* out: frame = Trama que se enviará. 
+* in: source = Datos de la trama donde se ha leído el paquete (la misma `frame->data` sin 
+*              compresión), con el offset al inicio si lo lleva. 
+* in: offset_size = Bytes del offset al inicio de `source` (0 sin `CONN_CAP_SACK`). 
+* in: length = Bytes del paquete a continuación del offset. 
+* in: offset = Posición del paquete en el archivo. 
+* in: compress = 1 si la conexión ha acordado `CONN_CAP_COMPRESSION`. 
+* in/out: sparse_frame = Trama donde se codifican los paquetes con tramos, o NULL si no se 
+*                        buscan (sin `CONN_CAP_SPARSE`). 
+* in/out: sparse_stats = Estadísticas de los paquetes con tramos. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+static void COMM_fillPacketFrame(Frame *frame, uint8_t *source, uint32_t offset_size, uint32_t length, uint64_t offset, int compress, Frame *sparse_frame, SparseStats *sparse_stats) {
+    uint32_t encoded = sparse_frame ? SPARSE_encodePacket(source + offset_size, length, offset, sparse_frame->data + offset_size, sparse_stats) : 0;
+    int type = 0x05;
+
+    // Els trams es codifiquen a part (no poden sobreescriure el paquet mentre el llegeixen) i la trama s'omple des d'allà
+    if (encoded > 0) {
+        memcpy(sparse_frame->data, source, offset_size);
+        source = sparse_frame->data;
+        length = encoded;
+        type = 0x1A;
+    }
+    if (compress) {
+        FRAME_fillFrameCompressed(frame, type, source, offset_size + length);
+    } else {
+        FRAME_fillFrame(frame, type, (const char *)source, offset_size + length);
+    }
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Comprobar sin bloquear si el otro extremo ha cerrado la conexión (e.g., porque 
+*             ha caído), mientras los datos del archivo pasan por el anillo de memoria 
+*             compartida y por el socket no se espera nada. 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket de la transferencia. 
+* 
+* @Retorno: 
+*           1 = El otro extremo ha cerrado la conexión o el socket tiene un error. 
+*           0 = La conexión sigue abierta. 
+* 
+************************************************/
+static int COMM_isPeerClosed(int socket) {
+    struct pollfd peer = {socket, POLLRDHUP, 0};
+    if (poll(&peer, 1, 0) <= 0) return 0;
+    return (peer.revents & (POLLRDHUP | POLLHUP | POLLERR)) != 0;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Preparar el envío de un archivo: abrirlo, escoger el motor con que saldrán 
+*             los paquetes por el socket, dimensionar el lote y la ventana y reservar las 
+*             tramas del pool que necesita el motor. Con sendfile y `CONN_CAP_SPARSE` el 
+*             archivo se proyecta para buscar los tramos de un mismo byte de cada paquete. 
+* 
+* @Parámetros: 
+* out: state = Estado del envío. Aunque falle se puede pasar a `COMM_closeSend`. 
+* in: transfer = Archivo a enviar y estado de la transferencia. 
+* in: socket = Descriptor del socket por el que se envían los paquetes. 
+* in: params = Parámetros acordados con el otro extremo y motor de E/S local. 
+* 
+* @Retorno: 
+*           TRANSFER_SUCCESS = Envío preparado. 
+*           UNEXPECTED_ERROR = No se ha podido abrir el archivo o reservar las tramas. 
+* 
+************************************************/
+static int COMM_openSend(SendState *state, const FileTransfer *transfer, int socket, const ConnectionParams *params) {
+    int window_size = (params && params->window_size > 0) ? params->window_size : 1;
+    int sparse;
+    IORing empty_ring = IO_EMPTY_RING;
+    ShmRing empty_shm = SHM_EMPTY_RING;
+    PacketMap empty_map = SACK_EMPTY_MAP;
+    SparseStats empty_stats = SPARSE_EMPTY_STATS;
+
+    state->transfer = transfer;
+    state->socket = socket;
+    state->params = params;
+    state->fd = -1;
+    state->file_size = 0;
+    state->n_packets = transfer->n_packets;
+    state->next_packet = *(transfer->n_processed_packets);
+    state->data_size = FRAME_getDataSize(params);
+    state->sack = params && params->frame_version == FRAME_V2 && (params->capabilities & CONN_CAP_SACK);
+    state->compress = params && params->frame_version == FRAME_V2 && (params->capabilities & CONN_CAP_COMPRESSION);
+    state->offset_size = state->sack ? FRAME_PACKET_OFFSET_SIZE : 0;
+    state->shm = state->sack && (params->capabilities & CONN_CAP_SHM) && !transfer->stripe;
+    state->acked = empty_map;
+    state->n_frames = 0;
+    state->sparse_frame = NULL;
+    state->mapped = NULL;
+    state->ring = empty_ring;
+    state->buffer_index = -1;
+    state->shm_ring = empty_shm;
+    state->inline_digest = transfer->hash && !transfer->stripe && COMM_hasInlineDigest(params);
+    state->digest_sent = 0;
+    state->sparse_stats = empty_stats;
+    state->sent_packets = 0;
+    state->bytes_sent = 0;
+    state->payload_bytes = 0;
+    sparse = state->sack && (params->capabilities & CONN_CAP_SPARSE);
+
+    // Els buffers del socket es tornen a dimensionar amb el RTT que TCP ha mesurat fins ara (handshake i metadades), més fiable que el del SYN
+    SOCKET_sizeBuffers(MUX_getTransport(socket));
+
+    state->fd = open(transfer->file_path, O_RDONLY);
+    struct stat file_stat;
+    if (state->fd < 0 || fstat(state->fd, &file_stat) < 0) return UNEXPECTED_ERROR;
+    state->file_size = file_stat.st_size;
+
+    // Amb io_uring (si la configuració el demana i el kernel el permet) el fitxer es llegeix a les trames del pool en paral·lel als enviaments, sense sendfile.
+    // Si no, amb paquets grans sense compressió les dades van del fitxer al socket amb sendfile, sense passar per les trames
+    if (params && params->frame_version == FRAME_V2 && params->io_engine == CONN_IO_URING && IO_ringInit(&state->ring) == 0) {
+        state->engine = COMM_ENGINE_IO_URING;
+    } else {
+        state->engine = FRAME_canSendFileFrames(params) ? COMM_ENGINE_ZERO_COPY : COMM_ENGINE_FRAMES;
+    }
+
+    // Paquets per lot com a màxim: els que càpiguen a la finestra sense passar de COMM_SEND_BATCH_BYTES (amb trames v2 d'1 MiB és un sol paquet).
+    // Amb io_uring el lot són les trames que es poden estar llegint o enviant a la vegada
+    int batch_size = state->engine == COMM_ENGINE_IO_URING ? COMM_RING_FRAMES : (int)(COMM_SEND_BATCH_BYTES / state->data_size);
+    if (batch_size > window_size) batch_size = window_size;
+    if (batch_size > FRAME_POOL_SIZE) batch_size = FRAME_POOL_SIZE;
+    if (state->compress && batch_size > FRAME_POOL_SIZE / 2) batch_size = FRAME_POOL_SIZE / 2;
+    if (sparse && batch_size > (FRAME_POOL_SIZE - 1) / (state->compress ? 2 : 1)) batch_size = (FRAME_POOL_SIZE - 1) / (state->compress ? 2 : 1);
+    if (batch_size < 1) batch_size = 1;
+    state->batch_size = batch_size;
+
+    // La finestra i el lot comencen petits i s'ajusten amb el RTT i el cabal que mesurem, sense passar de l'acordada ni de les trames reservades
+    CONG_init(&state->control, window_size, batch_size, state->data_size);
+
+    // Les trames del pool es reserven un cop per connexió i el fitxer es llegeix directament als seus camps de dades (darrere de l'offset, si n'hi ha).
+    // Amb compressió es reserven el doble: el fitxer es llegeix a la segona meitat i es comprimeix a les trames que s'envien. Amb sendfile no cal cap trama.
+    // Amb trams se'n reserva una més al final, on es codifiquen els paquets que en tenen
+    int n_frames = state->engine == COMM_ENGINE_ZERO_COPY ? 0 : (state->compress ? 2 * batch_size : batch_size);
+    if (sparse) n_frames++;
+    if (n_frames > 0 && FRAME_reservePool(transfer->pool, state->data_size + state->offset_size, n_frames) < 0) return UNEXPECTED_ERROR;
+    while (state->n_frames < n_frames) {
+        state->batch[state->n_frames] = FRAME_acquireFrame(transfer->pool);
+        if (!state->batch[state->n_frames]) return UNEXPECTED_ERROR;
+        state->n_frames++;
+    }
+    if (state->engine == COMM_ENGINE_IO_URING && IO_ringRegisterBuffer(&state->ring, transfer->pool->storage, (size_t)transfer->pool->n_frames * FRAME_STORAGE_SIZE(transfer->pool->capacity)) == 0) state->buffer_index = 0;
+    if (sparse) state->sparse_frame = state->batch[n_frames - 1];
+
+    // Amb sendfile les dades no passen per les trames: els trams es busquen a la projecció del fitxer, on només es llegeix el principi de cada bloc que no en forma part
+    if (sparse && state->engine == COMM_ENGINE_ZERO_COPY && state->file_size > 0) {
+        state->mapped = mmap(NULL, (size_t)state->file_size, PROT_READ, MAP_SHARED, state->fd, 0);
+        if (state->mapped == MAP_FAILED) state->mapped = NULL;
+    }
+    for (int i = 0; i < batch_size && state->engine == COMM_ENGINE_FRAMES; i++) {
+        state->file_iov[i].iov_base = (state->compress ? state->batch[batch_size + i] : state->batch[i])->data + state->offset_size;
+        state->file_iov[i].iov_len = state->data_size;
+    }
+    return TRANSFER_SUCCESS;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Alliberar los recursos de un envío: las tramas del pool, el bitmap de ACK, la 
+*             proyección, el ring de io_uring, el anillo de memoria compartida y el archivo. 
+* 
+* @Parámetros: 
+* in/out: state = Estado del envío, preparado con `COMM_openSend`. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+static void COMM_closeSend(SendState *state) {
+    COMM_releaseFrames(state->transfer->pool, state->batch, state->n_frames);
+    SACK_freeMap(&state->acked);
+    if (state->mapped) munmap(state->mapped, (size_t)state->file_size);
+    IO_ringDestroy(&state->ring);
+    SHM_destroyRing(&state->shm_ring);
+    if (state->fd >= 0) close(state->fd);
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Con ACK selectivos, recibir el primer ACK del receptor, que indica qué 
+*             paquetes ya tiene (e.g., los que recibió el worker que ha caído), para enviar 
+*             solo los que faltan. Con `CONN_CAP_PIPELINE` (sin franjas ni anillo) una 
+*             transferencia nueva no lo espera: el primer lote sale enseguida y este ACK se 
+*             trata como los demás cuando llega. 
+* 
+* @Parámetros: 
+* in/out: state = Estado del envío. Se prepara el bitmap de ACK y, si llega el ACK, se 
+*                 actualizan los paquetes confirmados y el siguiente paquete a enviar. 
+* 
+* @Retorno: 
+*           TRANSFER_SUCCESS = Bitmap preparado (o sin ACK selectivos). 
+*           REMOTE_END_DISCONNECTION = El receptor se ha desconectado. 
+*           UNEXPECTED_ERROR = ACK incorrecto o error al preparar el bitmap. 
+* 
+************************************************/
+static int COMM_retrieveInitialSack(SendState *state) {
+    const FileTransfer *transfer = state->transfer;
+    int *n_processed_packets = transfer->n_processed_packets;
+    int n_packets = state->n_packets;
+    int eager = state->sack && (state->params->capabilities & CONN_CAP_PIPELINE) && !transfer->stripe && !state->shm;
+    int acked_packets = 0;
+
+    if (!state->sack) return TRANSFER_SUCCESS;
+    if ((*n_processed_packets < n_packets || (eager && n_packets > 0)) && SACK_prepareMap(&state->acked, n_packets, state->data_size) < 0) return UNEXPECTED_ERROR;
+    if (eager ? (n_packets <= 0 || *n_processed_packets <= 0) : *n_processed_packets >= n_packets) return TRANSFER_SUCCESS;
+
+    int result = COMM_retrieveSackFrame(transfer->reader, &state->acked, 0, &acked_packets);
+    if (result != TRANSFER_SUCCESS) return result;
+
+    // Els paquets de fora de la franja els envien les altres connexions, així que per aquesta ja estan confirmats
+    int outside = 0;
+    if (transfer->stripe) {
+        SACK_markOutsideStripe(&state->acked, transfer->stripe);
+        outside = n_packets - transfer->stripe->n_packets;
+    }
+
+    state->next_packet = 0;
+    *n_processed_packets = state->acked.n_received;
+    if (state->acked.n_received > outside) {
+        STRING_printF(transfer->print_mutex, STDOUT_FILENO, GREEN, "%s already has %d of %d packets of %s, sending only the missing ones\n", transfer->process == FLECK ? "Worker" : "Fleck", state->acked.n_received - outside, n_packets - outside, transfer->filename);
+    }
+    return TRANSFER_SUCCESS;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Enviar por un anillo de memoria compartida los paquetes del archivo que el 
+*             receptor aún no tiene (`CONN_CAP_SHM`). El nombre del segmento se ofrece por 
+*             el socket (trama 0x1B) y, si el receptor lo abre, cada tramo de paquetes 
+*             consecutivos que falta (hasta `COMM_SEND_BATCH_BYTES`) se lee del archivo 
+*             directamente al anillo, sin tramas ni ACK por paquete. Al cerrar el anillo se 
+*             espera un único ACK selectivo con los paquetes que el receptor ha escrito y 
+*             comprobado; los que falten se envían después por el socket. Si el segmento no 
+*             se puede crear o el receptor no lo puede abrir (e.g., está en otro 
+*             contenedor), todo el archivo va por el socket. 
+* 
+* @Parámetros: 
+* in/out: state = Estado del envío. Su anillo queda vacío si no se usa y lo destruye 
+*                 `COMM_closeSend`; se le suman los paquetes y bytes que pasan por él. 
+* 
+* @Retorno: 
+*           TRANSFER_SUCCESS = Anillo terminado (o no usado) y ACK recibido. 
+*           REMOTE_END_DISCONNECTION = El receptor se ha desconectado. 
+*           UNEXPECTED_ERROR = Error al leer el archivo o respuesta inesperada. 
+* 
+************************************************/
+static int COMM_sendFileShm(SendState *state) {
+    const FileTransfer *transfer = state->transfer;
+    ShmRing *ring = &state->shm_ring;
+    PacketMap *acked = &state->acked;
+    int worker_socket = state->socket;
+    volatile int *exit_distortion = transfer->exit_distortion;
+    int n_packets = state->n_packets;
+    off_t file_size = state->file_size;
+    int result = TRANSFER_SUCCESS;
+    int acked_packets = 0;
+    uint32_t data_size = (uint32_t)acked->data_size;
+    int batch_packets = data_size < COMM_SEND_BATCH_BYTES ? (int)(COMM_SEND_BATCH_BYTES / data_size) : 1;
+    uint8_t storage[FRAME_STORAGE_SIZE(DATA_SIZE)];
+    Frame control_frame;
+    FRAME_initFrame(&control_frame, storage, sizeof(storage));
+
+    // Un fitxer petit no necessita tot l'anell: n'hi ha prou que hi càpiga dues vegades (cada registre pot ocupar com a molt la meitat de l'anell)
+    uint64_t capacity = 2 * ((uint64_t)file_size + SHM_MIN_CAPACITY);
+    if (capacity > SHM_DEFAULT_CAPACITY) capacity = SHM_DEFAULT_CAPACITY;
+
+    // Si no es pot crear l'anell (e.g., sense /dev/shm), l'oferta buida indica al receptor que tot anirà pel socket
+    int created = SHM_createRing(ring, capacity) == 0;
+    FRAME_fillFrame(&control_frame, 0x1B, created ? ring->name : NULL, created ? strlen(ring->name) : 0);
+    if (FRAME_sendFrame(worker_socket, &control_frame) < 0) {
+        return (errno == EPIPE || errno == ECONNRESET) ? REMOTE_END_DISCONNECTION : UNEXPECTED_ERROR;
+    }
+    if (!created) return TRANSFER_SUCCESS;
+
+    // El receptor respon "1" si ha pogut obrir el segment
+    FrameErrorCode error_code = FRAME_readerReceiveFrameInto(transfer->reader, &control_frame);
+    if (error_code != FRAME_SUCCESS) return error_code == FRAME_DISCONNECTED ? REMOTE_END_DISCONNECTION : UNEXPECTED_ERROR;
+    if (control_frame.type != 0x1B) return UNEXPECTED_ERROR;
+    if (control_frame.data_length == 0 || control_frame.data[0] != '1') {
+        SHM_destroyRing(ring);
+        return TRANSFER_SUCCESS;
+    }
+
+    for (int packet = 0; packet < n_packets && result == TRANSFER_SUCCESS && !*(exit_distortion); ) {
+        if (SACK_isReceived(acked, packet)) {
+            packet++;
+            continue;
+        }
+
+        // Cada registre porta el tram consecutiu de paquets que falten, llegit del fitxer directament a l'anell
+        int count = SACK_countMissing(acked, packet, batch_packets);
+        off_t offset = (off_t)packet * data_size;
+        uint32_t length = (off_t)count * data_size < file_size - offset ? (uint32_t)count * data_size : (uint32_t)(file_size - offset);
+        SHAPER_acquire(state->params->shaper, SHAPER_EGRESS, length, exit_distortion);
+
+        uint8_t *data = NULL;
+        int status = 0;
+        while (status == 0 && !*(exit_distortion)) {
+            status = SHM_reserve(ring, length, COMM_SHM_WAIT_MS, &data);
+            if (status == 0 && COMM_isPeerClosed(worker_socket)) result = REMOTE_END_DISCONNECTION;
+            if (result != TRANSFER_SUCCESS) break;
+        }
+        // El receptor ha tancat l'anell: el seu ACK dirà què té i la resta anirà pel socket
+        if (status < 0) break;
+        if (status == 0) continue;
+
+        if (pread(state->fd, data, length, offset) != (ssize_t)length) {
+            result = UNEXPECTED_ERROR;
+            break;
+        }
+        COMM_hashPacket(transfer->hash, offset, data, length);
+        SHM_commit(ring, (uint64_t)offset, length);
+        state->sent_packets += count;
+        state->bytes_sent += length;
+        packet += count;
+    }
+    SHM_close(ring);
+    if (result != TRANSFER_SUCCESS || *(exit_distortion)) return result;
+
+    // L'únic ACK de l'anell: el receptor el manda quan ha escrit i comprovat tot el que hi ha passat
+    result = COMM_retrieveSackFrame(transfer->reader, acked, n_packets, &acked_packets);
+    if (result == TRANSFER_SUCCESS) *(transfer->n_processed_packets) = acked->n_received;
+    state->payload_bytes = state->bytes_sent;
+    return result;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Enviar los paquetes que faltan de un archivo con el motor io_uring, de modo 
+*             que la lectura del disco, el envío por el socket y la recepción de los ACK 
+*             están en curso a la vez. Cada trama del lote pasa por tres estados: se lee el 
+*             paquete del archivo a la trama (registrada en el ring), se completa y se envía 
+*             en orden de paquete (un solo envío en curso, para que las tramas no se mezclen 
+*             en el socket) y vuelve a quedar libre. Mientras haya paquetes en vuelo hay una 
+*             recepción en curso sobre el buffer del lector, y los ACK completos se procesan 
+*             igual que en el envío con llamadas al sistema. 
+* 
+* @Parámetros: 
+* in/out: state = Estado del envío con el ring creado (`COMM_ENGINE_IO_URING`). Al acabar no 
+*                 le queda ninguna operación en curso. Las `batch_size` primeras tramas se 
+*                 envían y, con compresión, las `batch_size` siguientes reciben los datos 
+*                 leídos del archivo. 
+* 
+* @Retorno: 
+*           TRANSFER_SUCCESS = Envío acabado o interrumpido por `exit_distortion`. 
+*           REMOTE_END_DISCONNECTION = El extremo remoto se desconectó. 
+*           UNEXPECTED_ERROR = Error al leer el archivo, al enviar o en un ACK. 
+* 
+************************************************/
+static int COMM_sendFileRing(SendState *state) {
+    const FileTransfer *transfer = state->transfer;
+    IORing *ring = &state->ring;
+    PacketMap *acked = &state->acked;
+    FrameReader *reader = transfer->reader;
+    CongestionControl *control = &state->control;
+    int *n_processed_packets = transfer->n_processed_packets;
+    int *n_packets = &state->n_packets;
+    int *next_packet = &state->next_packet;
+    volatile int *exit_distortion = transfer->exit_distortion;
+    int worker_socket = state->socket;
+    int buffer_index = state->buffer_index;
+    int n_slots = state->batch_size;
+    int sack = state->sack;
+    int compress = state->compress;
+    uint32_t data_size = state->data_size;
+    uint32_t offset_size = state->offset_size;
+    int result = TRANSFER_SUCCESS;
+    int acked_packets = 0;
+    RingSlot slots[FRAME_POOL_SIZE];
+    int queue[FRAME_POOL_SIZE];         // Trames llegint-se o pendents d'enviar, en ordre de paquet
+    int queue_head = 0;
+    int queued = 0;
+    int in_flight = 0;                  // Paquets enviats pendents de confirmar
+    int sending = 0;                    // Hi ha un enviament en curs (el de la primera trama de la cua)
+    size_t send_done = 0;               // Bytes de la primera trama de la cua que ja han sortit
+    int receiving = 0;                  // Hi ha una recepció en curs sobre el buffer del lector
+    IORingCompletion completion;
+
+    for (int i = 0; i < n_slots; i++) {
+        slots[i].frame = state->batch[i];
+        slots[i].source = compress ? state->batch[n_slots + i] : state->batch[i];
+        slots[i].state = COMM_SLOT_FREE;
+    }
+
+    while (*n_processed_packets < *n_packets && !*(exit_distortion)) {
+        // Processem els ACK que ja són complets al buffer del lector (sense cap crida al sistema)
+        while (FRAME_readerHasFrame(reader)) {
+            int sent_next = *next_packet - queued;      // Sense ACK selectius els paquets van en ordre i els de la cua encara no han sortit
+            int sent_limit = queued > 0 ? slots[queue[queue_head]].packet : *next_packet;  // Amb ACK selectius, els paquets de la cua (a partir del primer) tampoc
+            int processed = *n_processed_packets;
+            result = sack ? COMM_retrieveSackFrame(reader, acked, sent_limit, &acked_packets) : COMM_retrieveAckFrame(reader, &acked_packets);
+            if (result != TRANSFER_SUCCESS) goto end_ring;
+
+            if (sack) {
+                in_flight -= acked_packets;
+                *n_processed_packets = acked->n_received;
+            } else {
+                if (acked_packets < 0) {
+                    (*n_processed_packets)++;
+                } else if (acked_packets > *n_processed_packets) {
+                    *n_processed_packets = acked_packets < sent_next ? acked_packets : sent_next;
+                }
+                in_flight = sent_next - *n_processed_packets;
+            }
+            CONG_onAck(control, *n_processed_packets - processed);
+        }
+        if (*n_processed_packets >= *n_packets) break;
+
+        // Si el receptor ha tornat a demanar un bloc corrupte, quan ja no queda res en vol tornem a passar pels paquets que falten
+        if (sack && *next_packet >= *n_packets && in_flight == 0 && queued == 0) *next_packet = acked->first_missing;
+
+        // Llegim del fitxer els paquets que falten a les trames lliures, sense passar de la finestra que permet el control
+        for (int i = 0; i < n_slots && in_flight + queued < control->window; i++) {
+            if (slots[i].state != COMM_SLOT_FREE) continue;
+            while (sack && *next_packet < *n_packets && SACK_isReceived(acked, *next_packet)) (*next_packet)++;
+            if (*next_packet >= *n_packets) break;
+
+            off_t offset = (off_t)*next_packet * data_size;
+            if (offset >= state->file_size) {
+                *n_packets = *next_packet; // Fi del fitxer (no hauriem d'arribar si la segmentació del fitxer en paquets és correcta)
+                break;
+            }
+            slots[i].packet = *next_packet;
+            slots[i].length = state->file_size - offset > (off_t)data_size ? data_size : (uint32_t)(state->file_size - offset);
+            if (IO_ringPrepRead(ring, state->fd, slots[i].source->data + offset_size, slots[i].length, (uint64_t)offset, buffer_index, COMM_RING_USER_DATA(COMM_RING_READ, i)) < 0) break;
+
+            slots[i].state = COMM_SLOT_READING;
+            queue[(queue_head + queued) % FRAME_POOL_SIZE] = i;
+            queued++;
+            (*next_packet)++;
+        }
+
+        // Enviem la primera trama de la cua quan ja està llesta (o la resta si l'enviament anterior va ser parcial)
+        if (!sending && queued > 0 && slots[queue[queue_head]].state == COMM_SLOT_READY) {
+            RingSlot *slot = &slots[queue[queue_head]];
+            if (send_done == 0) SHAPER_acquire(state->params->shaper, SHAPER_EGRESS, slot->wire.iov_len, exit_distortion);
+            if (IO_ringPrepWrite(ring, worker_socket, (uint8_t *)slot->wire.iov_base + send_done, slot->wire.iov_len - send_done, 0, buffer_index, COMM_RING_USER_DATA(COMM_RING_SEND, queue[queue_head])) == 0) sending = 1;
+        }
+
+        // Mentre hi hagi paquets en vol esperem ACKs al buffer del lector
+        if (!receiving && in_flight > 0) {
+            size_t space;
+            uint8_t *space_start = FRAME_readerSpace(reader, &space);
+            if (IO_ringPrepRecv(ring, worker_socket, space_start, space, COMM_RING_USER_DATA(COMM_RING_RECV, 0)) == 0) receiving = 1;
+        }
+
+        // Esperem que acabi qualsevol de les operacions en curs (un senyal ens torna al principi per comprovar exit_distortion)
+        int completed = IO_ringGetCompletion(ring, &completion, 1);
+        if (completed < 0 && errno == EINTR) continue;
+        if (completed <= 0) {
+            result = UNEXPECTED_ERROR;
+            goto end_ring;
+        }
+
+        int index = (int)(completion.user_data & 0xFFFFFFFF);
+        RingSlot *slot = &slots[index];
+        switch (completion.user_data >> 32) {
+            case COMM_RING_READ:
+                if (completion.result != (int)slot->length) {
+                    result = UNEXPECTED_ERROR;
+                    goto end_ring;
+                }
+
+                // Completem la trama (sense compressió ni trams les dades ja són al seu lloc) i en serialitzem la capçalera davant de les dades
+                COMM_hashPacket(transfer->hash, (off_t)slot->packet * data_size, slot->source->data + offset_size, slot->length);
+                if (sack) COMM_writePacketOffset(slot->source->data, (uint64_t)slot->packet * data_size);
+                COMM_fillPacketFrame(slot->frame, slot->source->data, offset_size, slot->length, (uint64_t)slot->packet * data_size, compress, state->sparse_frame, &state->sparse_stats);
+                FRAME_serializeInPlace(slot->frame, state->params, &slot->wire);
+                slot->state = COMM_SLOT_READY;
+                break;
+
+            case COMM_RING_SEND:
+                sending = 0;
+                if (completion.result < 0) {
+                    // Si l'altre extrem ha tancat la connexió ho tractem com una caiguda, per poder reprendre l'enviament amb un altre worker
+                    result = (completion.result == -EPIPE || completion.result == -ECONNRESET) ? REMOTE_END_DISCONNECTION : UNEXPECTED_ERROR;
+                    goto end_ring;
+                }
+                send_done += (size_t)completion.result;
+                if (send_done < slot->wire.iov_len) break;
+
+                // La trama ha sortit sencera: queda lliure per llegir-hi un altre paquet
+                send_done = 0;
+                slot->state = COMM_SLOT_FREE;
+                queue_head = (queue_head + 1) % FRAME_POOL_SIZE;
+                queued--;
+                in_flight++;
+                CONG_onSend(control, 1);
+                state->sent_packets++;
+                state->bytes_sent += slot->length;
+                state->payload_bytes += slot->frame->data_length;
+                break;
+
+            case COMM_RING_RECV:
+                receiving = 0;
+                if (completion.result <= 0) {
+                    result = (completion.result == 0 || completion.result == -ECONNRESET) ? REMOTE_END_DISCONNECTION : UNEXPECTED_ERROR;
+                    goto end_ring;
+                }
+                FRAME_readerCommit(reader, (size_t)completion.result);
+                break;
+        }
+    }
+
+end_ring:
+    // Cancel·lem el que quedi en curs (e.g., la recepció d'un ACK en sortir per SIGINT) i esperem que acabi, ja que escriu a les trames i al lector
+    IO_ringCancelAll(ring);
+    while (1) {
+        int completed = IO_ringGetCompletion(ring, &completion, 1);
+        if (completed < 0 && errno == EINTR) continue;
+        if (completed <= 0) break;
+        if ((completion.user_data >> 32) == COMM_RING_RECV && completion.result > 0) FRAME_readerCommit(reader, (size_t)completion.result);
+    }
+    if (result == UNEXPECTED_ERROR) STRING_printF(transfer->print_mutex, STDOUT_FILENO, RED, "ERROR: failed to send file %s with io_uring\n", transfer->filename);
+    return result;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Enviar un tramo de paquetes consecutivos copiándolos a las tramas del pool 
+*             (`COMM_ENGINE_FRAMES`): se leen del archivo con un solo `preadv` a los campos 
+*             de datos de las tramas del lote, se completan (comprimidos o con sus tramos de 
+*             un mismo byte, si toca) y salen todos con un solo `writev`. 
+* 
+* @Parámetros: 
+* in/out: state = Estado del envío. El tramo empieza en `next_packet`. 
+* in: count = Número de paquetes del tramo (como mucho `batch_size`). 
+* out: filled = Paquetes enviados (menos de `count` si el archivo se acaba antes). 
+* 
+* @Retorno: 
+*           TRANSFER_SUCCESS = Tramo enviado. 
+*           REMOTE_END_DISCONNECTION = El extremo remoto ha cerrado la conexión. 
+*           UNEXPECTED_ERROR = Error al leer el archivo o al enviar. 
+* 
+************************************************/
+static int COMM_sendRunFrames(SendState *state, int count, int *filled) {
+    const FileTransfer *transfer = state->transfer;
+    uint32_t data_size = state->data_size;
+    int batch_size = state->batch_size;
+    size_t batch_bytes = 0;
+    *filled = 0;
+
+    ssize_t bytes_read = preadv(state->fd, state->file_iov, count, (off_t)state->next_packet * data_size);
+    if (bytes_read < 0) {
+        STRING_printF(transfer->print_mutex, STDOUT_FILENO, RED, "ERROR: failed to read file %s\n", transfer->filename);
+        return UNEXPECTED_ERROR;
+    }
+
+    // Completar les trames del lot (sense compressió ni trams les dades ja són al seu lloc) i enviar-les totes amb una sola escriptura
+    state->bytes_sent += bytes_read;
+    while (bytes_read > 0) {
+        int packet = state->next_packet + *filled;
+        uint32_t length = bytes_read > (ssize_t)data_size ? data_size : (uint32_t)bytes_read;
+        Frame *source = state->compress ? state->batch[batch_size + *filled] : state->batch[*filled];
+        COMM_hashPacket(transfer->hash, (off_t)packet * data_size, source->data + state->offset_size, length);
+        if (state->sack) COMM_writePacketOffset(source->data, (uint64_t)packet * data_size);
+        COMM_fillPacketFrame(state->batch[*filled], source->data, state->offset_size, length, (uint64_t)packet * data_size, state->compress, state->sparse_frame, &state->sparse_stats);
+        batch_bytes += state->batch[*filled]->data_length;
+        state->payload_bytes += state->batch[(*filled)++]->data_length;
+        bytes_read -= length;
+    }
+    // Si el worker té l'amplada de banda limitada, esperem que l'usuari tingui fitxes per a tot el lot
+    SHAPER_acquire(state->params ? state->params->shaper : NULL, SHAPER_EGRESS, batch_bytes, transfer->exit_distortion);
+    if (*filled > 0 && FRAME_sendFrames(state->socket, state->batch, *filled, state->params, 0) < 0) {
+        // Si l'altre extrem ha tancat la connexió ho tractem com una caiguda, per poder reprendre l'enviament amb un altre worker
+        return (errno == EPIPE || errno == ECONNRESET) ? REMOTE_END_DISCONNECTION : UNEXPECTED_ERROR;
+    }
+    return TRANSFER_SUCCESS;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Enviar un tramo de paquetes consecutivos sin copiarlos a memoria de usuario 
+*             (`COMM_ENGINE_ZERO_COPY`), con una trama `FRAME_sendFileFrame` por paquete. 
+*             Si el archivo está proyectado (`CONN_CAP_SPARSE`), antes se buscan en la 
+*             proyección los tramos de un mismo byte de cada paquete, y los paquetes que 
+*             tienen alguno salen codificados en una trama 0x1A. 
+* 
+* @Parámetros: 
+* in/out: state = Estado del envío. El tramo empieza en `next_packet`. 
+* in: count = Número de paquetes del tramo. 
+* out: filled = Paquetes enviados (menos de `count` si el archivo se acaba antes). 
+* 
+* @Retorno: 
+*           TRANSFER_SUCCESS = Tramo enviado. 
+*           REMOTE_END_DISCONNECTION = El extremo remoto ha cerrado la conexión. 
+*           UNEXPECTED_ERROR = Error al enviar algún paquete. 
+* 
+************************************************/
+static int COMM_sendRunZeroCopy(SendState *state, int count, int *filled) {
+    uint8_t prefix[FRAME_PACKET_OFFSET_SIZE];
+    uint32_t data_size = state->data_size;
+    Frame *sparse_frame = state->sparse_frame;
+    *filled = 0;
+
+    // Cada paquet surt amb la seva capçalera i un sendfile des del fitxer
+    SHAPER_acquire(state->params->shaper, SHAPER_EGRESS, (size_t)count * data_size, state->transfer->exit_distortion);
+    for (int i = 0; i < count; i++) {
+        off_t offset = (off_t)(state->next_packet + i) * data_size;
+        if (offset >= state->file_size) break;
+        uint32_t length = state->file_size - offset > (off_t)data_size ? data_size : (uint32_t)(state->file_size - offset);
+
+        // Un paquet amb trams d'un mateix byte surt codificat des de la projecció; la resta, amb sendfile
+        uint32_t encoded = state->mapped ? SPARSE_encodePacket(state->mapped + offset, length, (uint64_t)offset, sparse_frame->data + FRAME_PACKET_OFFSET_SIZE, &state->sparse_stats) : 0;
+        int sent;
+        if (encoded > 0) {
+            COMM_writePacketOffset(sparse_frame->data, (uint64_t)offset);
+            FRAME_fillFrame(sparse_frame, 0x1A, NULL, FRAME_PACKET_OFFSET_SIZE + encoded);
+            sent = FRAME_sendFrames(state->socket, &sparse_frame, 1, state->params, 0);
+        } else {
+            if (state->sack) COMM_writePacketOffset(prefix, (uint64_t)offset);
+            sent = FRAME_sendFileFrame(state->socket, 0x05, prefix, state->sack ? FRAME_PACKET_OFFSET_SIZE : 0, state->fd, offset, length, state->params);
+        }
+        if (sent < 0) return (errno == EPIPE || errno == ECONNRESET) ? REMOTE_END_DISCONNECTION : UNEXPECTED_ERROR;
+
+        (*filled)++;
+        state->bytes_sent += length;
+    }
+    return TRANSFER_SUCCESS;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Enviar los paquetes que faltan con llamadas al sistema, manteniendo paquetes 
+*             en vuelo sin confirmar y avanzando con los ACK del receptor. La ventana y los 
+*             paquetes de cada lote se ajustan con el control de congestión y cada tramo de 
+*             paquetes consecutivos que falta sale con la rutina del motor (`send_run`). Con 
+*             todo el archivo enviado, el MD5 sale enseguida si viaja con la transferencia. 
+* 
+* @Parámetros: 
+* in/out: state = Estado del envío. 
+* in: send_run = Rutina que envía un tramo a partir de `next_packet` (`COMM_sendRunFrames` 
+*                o `COMM_sendRunZeroCopy`). 
+* 
+* @Retorno: 
+*           TRANSFER_SUCCESS = Envío acabado o interrumpido por `exit_distortion`. 
+*           REMOTE_END_DISCONNECTION = El extremo remoto se desconectó. 
+*           UNEXPECTED_ERROR = Error al leer o enviar el archivo o en un ACK. 
+* 
+************************************************/
+static int COMM_sendFileWindow(SendState *state, int (*send_run)(SendState *, int, int *)) {
+    const FileTransfer *transfer = state->transfer;
+    int *n_processed_packets = transfer->n_processed_packets;
+    volatile int *exit_distortion = transfer->exit_distortion;
+    PacketMap *acked = &state->acked;
+    int sack = state->sack;
+    uint32_t data_size = state->data_size;
+    int in_flight = 0;                          // Paquets enviats pendents de confirmar
+    int acked_packets = 0;
+    int result;
+
+    // Mentre el receptor no hagi confirmat tots els paquets continuem enviant i esperant ACKs
+    while (*n_processed_packets < state->n_packets && !*(exit_distortion)) {
+        // Si el receptor ha tornat a demanar un bloc corrupte, quan ja no queda res en vol tornem a passar pels paquets que falten
+        if (sack && state->next_packet >= state->n_packets && in_flight == 0) state->next_packet = acked->first_missing;
+
+        // Omplim la finestra per lots: enviem paquets fins a tenir els paquets sense confirmar que permet el control
+        while (state->next_packet < state->n_packets && in_flight < state->control.window && !*(exit_distortion)) {
+            // Saltem els paquets que el receptor ja té i enviem d'un sol lot el tram consecutiu que falta
+            while (sack && state->next_packet < state->n_packets && SACK_isReceived(acked, state->next_packet)) state->next_packet++;
+            if (state->next_packet >= state->n_packets) break;
+
+            int count = state->control.window - in_flight;
+            if (count > state->control.batch) count = state->control.batch;
+            if (count > state->n_packets - state->next_packet) count = state->n_packets - state->next_packet;
+            if (sack) count = SACK_countMissing(acked, state->next_packet, count);
+
+            int filled = 0;
+            result = send_run(state, count, &filled);
+            if (result != TRANSFER_SUCCESS) return result;
+            if (filled == 0) {
+                state->n_packets = state->next_packet; // Fi del fitxer (no hauriem d'arribar si la segmentació del fitxer en paquets és correcta)
+                break;
+            }
+            state->next_packet += filled;
+            in_flight += filled;
+            state->sent_packets += filled;
+            CONG_onSend(&state->control, filled);
+
+            // El que no s'ha pogut resumir des de les trames (sendfile o paquets que el receptor ja tenia) es resumeix ara, amb el fitxer encara a la memòria cau
+            off_t sent_end = (off_t)state->next_packet * data_size;
+            if (transfer->hash && HASH_advance(transfer->hash, state->fd, NULL, sent_end < state->file_size ? sent_end : state->file_size) < 0) return UNEXPECTED_ERROR;
+        }
+
+        // Amb tot el fitxer enviat, el MD5 surt ja, sense esperar els ACK que falten, i el receptor el té tan bon punt acaba
+        if (state->inline_digest && !state->digest_sent && state->next_packet >= state->n_packets && !*(exit_distortion)) {
+            if (HASH_advance(transfer->hash, state->fd, NULL, state->file_size) < 0) return UNEXPECTED_ERROR;
+            if (COMM_sendFileDigest(state->socket, transfer->hash, state->params) < 0) return REMOTE_END_DISCONNECTION;
+            state->digest_sent = 1;
+        }
+
+        if (*n_processed_packets >= state->n_packets || *(exit_distortion)) break;
+
+        // Esperar ACK del receptor. Retornem REMOTE_END_DISCONNECTION si ha caigut i UNEXPECTED_ERROR si hi ha hagut un error en deserialitzar la trama
+        int processed = *n_processed_packets;
+        result = sack ? COMM_retrieveSackFrame(transfer->reader, acked, state->next_packet, &acked_packets) : COMM_retrieveAckFrame(transfer->reader, &acked_packets);
+        if (result != TRANSFER_SUCCESS) return result;
+
+        // Un ACK selectiu confirma paquets solts; un ACK sense dades (peer antic) confirma un sol paquet; un ACK acumulatiu confirma tots els paquets fins al número indicat
+        if (sack) {
+            in_flight -= acked_packets;
+            *n_processed_packets = acked->n_received;
+        } else {
+            if (acked_packets < 0) {
+                (*n_processed_packets)++;
+            } else if (acked_packets > *n_processed_packets) {
+                *n_processed_packets = acked_packets < state->next_packet ? acked_packets : state->next_packet;
+            }
+            in_flight = state->next_packet - *n_processed_packets;
+        }
+        CONG_onAck(&state->control, *n_processed_packets - processed);
+    }
+    return TRANSFER_SUCCESS;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Mostrar las medidas de un envío acabado (con "stats on"), para comparar los 
+*             motores y ajustar la configuración: paquetes, reservas de memoria y llamadas de 
+*             envío, tiempo de CPU, caudal de punta a punta, anillo de memoria compartida, 
+*             compresión, tramos de un mismo byte, control de congestión y estado del socket. 
+* 
+* @Parámetros: 
+* in: state = Estado del envío, antes de `COMM_closeSend`. 
+* in: cpu_start = Tiempo de CPU del hilo al empezar el envío. 
+* in: wall_start = Instante en que empezó el envío. 
+* in: allocations = Tramas reservadas durante el envío. 
+* in: send_calls = Llamadas al sistema de envío hechas durante el envío. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+static void COMM_printSendStatistics(const SendState *state, const struct timespec *cpu_start, const struct timespec *wall_start, unsigned long allocations, unsigned long send_calls) {
+    const FileTransfer *transfer = state->transfer;
+    struct timespec cpu_end, wall_end;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_end);
+    double cpu_ms = (cpu_end.tv_sec - cpu_start->tv_sec) * 1000.0 + (cpu_end.tv_nsec - cpu_start->tv_nsec) / 1000000.0;
+    clock_gettime(CLOCK_MONOTONIC, &wall_end);
+    double wall_ms = (wall_end.tv_sec - wall_start->tv_sec) * 1000.0 + (wall_end.tv_nsec - wall_start->tv_nsec) / 1000000.0;
+    int shm_used = state->shm_ring.header != NULL;
+    const char *engine = "copied through frames";
+    if (shm_used) {
+        engine = "shared-memory ring";
+    } else if (state->engine == COMM_ENGINE_ZERO_COPY) {
+        engine = "zero-copy sendfile";
+    } else if (state->engine == COMM_ENGINE_IO_URING) {
+        engine = state->buffer_index == 0 ? "io_uring with registered buffers" : "io_uring";
+    }
+
+    double megabytes = state->bytes_sent / (1024.0 * 1024.0);
+    STRING_printF(transfer->print_mutex, STDOUT_FILENO, GREEN, "Successfully sent distorted file to %s (%d packets, %lu frame allocations, %lu send syscalls, %.1f per MB)\n", transfer->process == FLECK ? "Worker" : "Fleck", state->sent_packets, allocations, send_calls, megabytes > 0 ? send_calls / megabytes : 0.0);
+    STRING_printF(transfer->print_mutex, STDOUT_FILENO, GREEN, "Sender CPU time: %.1f ms, %.1f ms per GB (%s)\n", cpu_ms, megabytes > 0 ? cpu_ms * 1024.0 / megabytes : 0.0, engine);
+    // El cabal de punta a punta (amb el handshake de l'anell o l'espera dels ACK) és el que es compara entre l'anell i el TCP de loopback
+    STRING_printF(transfer->print_mutex, STDOUT_FILENO, GREEN, "Sender throughput: %.1f MB in %.1f ms, %.1f MB/s (%s)\n", megabytes, wall_ms, wall_ms > 0 ? megabytes * 1000.0 / wall_ms : 0.0, engine);
+    if (shm_used) {
+        STRING_printF(transfer->print_mutex, STDOUT_FILENO, GREEN, "Shared-memory ring: %lu futex waits for space, %lu wakeups of the receiver\n", state->shm_ring.waits, state->shm_ring.wakeups);
+    }
+    if (state->compress) {
+        STRING_printF(transfer->print_mutex, STDOUT_FILENO, GREEN, "Compressed file data: %llu -> %llu bytes\n", state->bytes_sent, state->payload_bytes);
+    }
+    if (state->sparse_stats.packets > 0) {
+        STRING_printF(transfer->print_mutex, STDOUT_FILENO, GREEN, "Repeated-byte runs not sent: %.1f MB in %d packets\n", state->sparse_stats.run_bytes / (1024.0 * 1024.0), state->sparse_stats.packets);
+    }
+    // Amb l'anell la finestra no ha intervingut
+    if (!shm_used) {
+        char congestion_summary[CONG_SUMMARY_SIZE];
+        CONG_describe(&state->control, congestion_summary, sizeof(congestion_summary));
+        STRING_printF(transfer->print_mutex, STDOUT_FILENO, GREEN, "%s", congestion_summary);
+    }
+    SocketInfo socket_info;
+    if (SOCKET_getInfo(MUX_getTransport(state->socket), &socket_info) == 0) {
+        char socket_summary[SOCKET_DESCRIPTION_SIZE];
+        SOCKET_describeInfo(&socket_info, socket_summary, sizeof(socket_summary));
+        STRING_printF(transfer->print_mutex, STDOUT_FILENO, GREEN, "%s", socket_summary);
+    }
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Enviar un archivo al worker o fleck en paquetes, utilizando un socket especificado. 
+*             Mantiene paquetes en vuelo sin confirmar y avanza con los ACK del receptor, 
+*             permitiendo la reanudación en caso de interrupción. Cada motor tiene su rutina 
+*             y esta solo las encadena: `COMM_openSend` escoge el motor y reserva lo que 
+*             necesita, `COMM_retrieveInitialSack` recoge los paquetes que el receptor ya 
+*             tiene, `COMM_sendFileShm` pasa los que faltan por el anillo de memoria 
+*             compartida (`CONN_CAP_SHM`, sin franjas) y el resto sale por el socket con 
+*             io_uring (`COMM_sendFileRing`), con `sendfile` (`COMM_sendRunZeroCopy`) o 
+*             copiado a las tramas del pool con `preadv` y `writev` (`COMM_sendRunFrames`), 
+*             los dos últimos dentro de la ventana de `COMM_sendFileWindow`. Al acabar se 
+*             completa el MD5 y, si viaja con la transferencia y aún no ha salido, se envía. 
+* 
+* @Parámetros: 
+* in: transfer = Archivo a enviar y estado de la transferencia. 
+* in: worker_socket = Descriptor del socket utilizado para enviar los paquetes. 
+* in: params = Parámetros acordados con el otro extremo y motor de E/S local. 
+* 
+* @Retorno: 
+*           TRANSFER_SUCCESS = El archivo fue enviado con éxito. 
+*           REMOTE_END_DISCONNECTION = El extremo remoto (worker o fleck) se desconectó. 
+*           UNEXPECTED_ERROR = Ocurrió un error durante la lectura o envío del archivo. 
+*           INTERRUPTED_BY_SIGINT = El envío fue interrumpido por una señal SIGINT. 
+* 
+************************************************/
+int COMM_sendFile(const FileTransfer *transfer, int worker_socket, const ConnectionParams *params) {
+    SendState state;
+    volatile int *exit_distortion = transfer->exit_distortion;
+    struct timespec cpu_start, wall_start;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_start);
+    clock_gettime(CLOCK_MONOTONIC, &wall_start);
+
+    int result = COMM_openSend(&state, transfer, worker_socket, params);
+    unsigned long allocations = FRAME_getAllocationCount();
+    unsigned long send_calls = FRAME_getSendCallCount();
+    if (result == TRANSFER_SUCCESS) result = COMM_retrieveInitialSack(&state);
+
+    // Amb el receptor a la mateixa màquina els paquets que falten passen per l'anell i pel socket només l'ACK final (i després els que no hagin arribat bé)
+    if (result == TRANSFER_SUCCESS && state.shm && *(transfer->n_processed_packets) < state.n_packets) result = COMM_sendFileShm(&state);
+
+    if (result == TRANSFER_SUCCESS) {
+        switch (state.engine) {
+            case COMM_ENGINE_IO_URING:
+                result = COMM_sendFileRing(&state);
+                break;
+            case COMM_ENGINE_ZERO_COPY:
+                result = COMM_sendFileWindow(&state, COMM_sendRunZeroCopy);
+                break;
+            default:
+                result = COMM_sendFileWindow(&state, COMM_sendRunFrames);
+                break;
+        }
+    }
+
+    // Completem el MD5 amb el que falti (e.g., els paquets d'altres franges o els que ja tenia el receptor en reprendre) i, si no ha sortit encara (anell, io_uring o el receptor ja ho tenia tot), l'enviem
+    if (result == TRANSFER_SUCCESS && !*(exit_distortion) && transfer->hash && HASH_advance(transfer->hash, state.fd, NULL, state.file_size) < 0) result = UNEXPECTED_ERROR;
+    if (result == TRANSFER_SUCCESS && !*(exit_distortion) && state.inline_digest && !state.digest_sent && COMM_sendFileDigest(worker_socket, transfer->hash, params) < 0) result = REMOTE_END_DISCONNECTION;
+
+    if (result == REMOTE_END_DISCONNECTION) {
+        STRING_printF(transfer->print_mutex, STDOUT_FILENO, RED, "%s crashed while receiving file %s\n", transfer->process == FLECK ? "Worker" : "Fleck", transfer->filename);
+    } else if (result == TRANSFER_SUCCESS && *(exit_distortion)) {
+        STRING_printF(transfer->print_mutex, STDOUT_FILENO, RED, "Exiting send method because of sigint\n");
+        result = INTERRUPTED_BY_SIGINT;
+    } else if (result == TRANSFER_SUCCESS && !COMM_showStatistics()) {
+        STRING_printF(transfer->print_mutex, STDOUT_FILENO, GREEN, "Successfully sent distorted file to %s\n", transfer->process == FLECK ? "Worker" : "Fleck");
+    } else if (result == TRANSFER_SUCCESS) {
+        COMM_printSendStatistics(&state, &cpu_start, &wall_start, FRAME_getAllocationCount() - allocations, FRAME_getSendCallCount() - send_calls + state.ring.enter_calls);
+    }
+
+    COMM_closeSend(&state);
+    return result;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Abrir el archivo donde se recibirá un fichero, dejarlo con su tamaño final y 
+*             reservar todos sus bloques con `fallocate`, de modo que no se fragmenta y la 
+*             escritura de los paquetes no puede fallar por falta de espacio. Si la reserva 
+*             funciona, el archivo se proyecta en memoria para copiar los paquetes 
+*             directamente. No se trunca el contenido, para conservar los paquetes ya 
+*             recibidos al reanudar. 
+* 
+* @Parámetros: 
+* in: file_path = Ruta completa del archivo. 
+* in: file_size = Tamaño final del archivo en bytes. 
+* out: mapped = Proyección del archivo entero, o NULL si los paquetes se deben escribir 
+*               con `pwrite` (archivo vacío o sistema de ficheros sin `fallocate`). Si se 
+*               pasa NULL el archivo se reserva pero no se proyecta (e.g., con io_uring). 
+* 
+* @Retorno: 
+*           >= 0 = Descriptor del archivo abierto para lectura y escritura. 
+*           -1 = Error al abrir el archivo, al ajustar su tamaño o falta de espacio. 
+* 
+************************************************/
+static int COMM_openReceiveFile(const char *file_path, off_t file_size, uint8_t **mapped) {
+    if (mapped) *mapped = NULL;
+
+    int fd = open(file_path, O_RDWR | O_CREAT, 0666);
+    if (fd < 0) return -1;
+
+    // Si el fitxer ja existia amb una altra mida (e.g., d'una distorsió anterior) l'ajustem; en reprendre ja té la mida final
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) < 0 || (file_stat.st_size != file_size && ftruncate(fd, file_size) < 0)) {
+        close(fd);
+        return -1;
+    }
+    if (file_size == 0) return fd;
+
+    // Sense blocs reservats, escriure a la projecció d'un fitxer sense espai faria petar el procés amb SIGBUS: en aquest cas fem servir pwrite
+    if (fallocate(fd, 0, 0, file_size) < 0) {
+        if (errno == ENOSPC) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+    if (!mapped) return fd;
+
+    uint8_t *file_map = mmap(NULL, (size_t)file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (file_map != MAP_FAILED) *mapped = file_map;
+    return fd;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Escribir los datos de un paquete en su posición del archivo que se recibe, 
+*             copiándolos a la proyección si la hay o con `pwrite` si no. 
+* 
+* @Parámetros: 
+* in: fd = Descriptor del archivo. 
+* in: mapped = Proyección del archivo (puede ser NULL). 
+* in: file_size = Tamaño final del archivo en bytes. 
+* in: offset = Posición del paquete dentro del archivo. 
+* in: data = Datos del paquete. 
+* in: length = Número de bytes de `data`. 
+* 
+* @Retorno: 
+*           0 = Datos escritos. 
+*          -1 = El paquete se sale del archivo o error de escritura. 
+* 
+************************************************/
+static int COMM_writeReceivedPacket(int fd, uint8_t *mapped, off_t file_size, off_t offset, const uint8_t *data, uint32_t length) {
+    if (offset < 0 || offset + (off_t)length > file_size) return -1;
+
+    if (mapped) {
+        memcpy(mapped + offset, data, length);
+        return 0;
+    }
+    return pwrite(fd, data, length, offset) == (ssize_t)length ? 0 : -1;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Validar un paquete de fichero recibido y obtener su número y sus datos. Con 
+*             ACK selectivos el paquete lleva su offset; si no, es el siguiente del archivo. 
+*             Con `CONN_CAP_SPARSE` el paquete puede llegar codificado con sus tramos de un 
+*             mismo byte (trama 0x1A), que se escribe con `SPARSE_writePacket`. 
+* 
+* @Parámetros: 
+* in: frame = Trama recibida. 
+* in: sack = 1 si la conexión ha acordado `CONN_CAP_SACK`. 
+* in: data_size = Bytes de datos por paquete. 
+* in: n_packets = Número total de paquetes del archivo. 
+* in/out: packet = Número del paquete (se indica el siguiente en orden y se sustituye por 
+*                  el del offset con ACK selectivos). 
+* out: data = Datos del archivo que lleva el paquete (codificados si la trama es 0x1A). 
+* out: length = Número de bytes de `data`. 
+* 
+* @Retorno: 
+*           1 = El paquete es válido. 
+*           0 = Tipo de trama incorrecto o offset fuera del archivo. 
+* 
+************************************************/
+static int COMM_parsePacket(const Frame *frame, int sack, uint32_t data_size, int n_packets, int *packet, uint8_t **data, uint32_t *length) {
+    *data = frame->data;
+    *length = frame->data_length;
+    if (frame->type != 0x05 && frame->type != 0x1A) return 0;
+    if (!sack) return frame->type == 0x05;
+
+    if (*length < FRAME_PACKET_OFFSET_SIZE) return 0;
+    uint64_t packet_offset = COMM_readPacketOffset(*data);
+    *packet = (int)(packet_offset / data_size);
+    *data += FRAME_PACKET_OFFSET_SIZE;
+    *length -= FRAME_PACKET_OFFSET_SIZE;
+    return packet_offset % data_size == 0 && packet_offset / data_size < (uint64_t)n_packets && *length <= data_size;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Guardar el MD5 que lleva una trama 0x14 en lugar del que se tenía. 
+* 
+* @Parámetros: 
+* in: frame = Trama recibida. 
+* in/out: md5sum = MD5 guardado (se libera el anterior, que puede ser NULL). 
+* 
+* @Retorno: 
+*           0 = MD5 guardado. 
+*          -1 = La trama no es un MD5 válido o no se ha podido copiar. 
+* 
+************************************************/
+static int COMM_takeFileDigest(const Frame *frame, char **md5sum) {
+    Metadata metadata;
+    if (frame->type != 0x14 || METADATA_decode(frame->data, frame->data_length, METADATA_MSG_FILE_DIGEST, &metadata) < 0) return -1;
+
+    // El MD5 apunta a les dades de la trama, així que el copiem abans que es reutilitzi
+    char *digest = strdup(METADATA_getString(&metadata, METADATA_MD5SUM));
+    if (!digest) return -1;
+
+    free(*md5sum);
+    *md5sum = digest;
+    return 0;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Recoger la finalización de una escritura de paquete al archivo hecha con 
+*             io_uring, marcar el paquete como recibido y liberar su trama. 
+* 
+* @Parámetros: 
+* in/out: ring = Ring con las escrituras en curso. 
+* in/out: writes = Escrituras en curso (paquete y bytes de cada trama). 
+* in/out: received = Bitmap de los paquetes escritos en el archivo. 
+* in: wait = 1 para esperar a que acabe una escritura, 0 para no esperar. 
+* 
+* @Retorno: 
+*           1 = Se ha escrito un paquete. 
+*           0 = No ha acabado ninguna escritura (o no hay ninguna en curso). 
+*          -1 = Error al escribir el paquete. 
+* 
+************************************************/
+static int COMM_completeRingWrite(IORing *ring, RingWrites *writes, PacketMap *received, int wait) {
+    IORingCompletion completion;
+    int completed;
+
+    // Les escriptures a disc acaben igualment, de manera que un senyal no ens fa deixar d'esperar-les
+    do {
+        completed = IO_ringGetCompletion(ring, &completion, wait && writes->pending > 0);
+    } while (completed < 0 && errno == EINTR);
+    if (completed <= 0) return completed;
+
+    int index = (int)completion.user_data;
+    int packet = writes->packet[index];
+    writes->packet[index] = -1;
+    writes->pending--;
+    if (completion.result != (int)writes->length[index]) return -1;
+
+    SACK_markReceived(received, packet);
+    return 1;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Preparar la recepción de un archivo: escoger el motor con que se escriben los 
+*             paquetes, abrir el archivo con su tamaño final (sin truncarlo, ya que al 
+*             reanudar conserva los paquetes recibidos), preparar el bitmap y reservar las 
+*             tramas del pool donde se reciben los paquetes. 
+* 
+* @Parámetros: 
+* out: state = Estado de la recepción. Aunque falle se puede pasar a `COMM_closeReceive`. 
+* in: transfer = Archivo a recibir y estado de la transferencia. 
+* in: socket = Descriptor del socket por el que llegan los paquetes. 
+* in: params = Parámetros acordados con el otro extremo y motor de E/S local. 
+* 
+* @Retorno: 
+*           TRANSFER_SUCCESS = Recepción preparada. 
+*           UNEXPECTED_ERROR = No se ha podido abrir el archivo o reservar las tramas. 
+* 
+************************************************/
+static int COMM_openReceive(ReceiveState *state, const FileTransfer *transfer, int socket, const ConnectionParams *params) {
+    IORing empty_ring = IO_EMPTY_RING;
+    ShmRing empty_shm = SHM_EMPTY_RING;
+    SparseStats empty_stats = SPARSE_EMPTY_STATS;
+
+    state->transfer = transfer;
+    state->socket = socket;
+    state->params = params;
+    state->fd = -1;
+    state->file_size = (off_t)transfer->file_size;
+    state->mapped = NULL;
+    state->data_size = FRAME_getDataSize(params);
+    state->sack = params && params->frame_version == FRAME_V2 && (params->capabilities & CONN_CAP_SACK);
+    state->shm = state->sack && (params->capabilities & CONN_CAP_SHM) && !transfer->stripe;
+    state->ring = empty_ring;
+    state->buffer_index = -1;
+    state->shm_ring = empty_shm;
+    state->n_frames = 0;
+    state->inline_digest = transfer->md5sum && !transfer->stripe && COMM_hasInlineDigest(params);
+    state->digest = NULL;
+    state->written_packets = 0;
+    state->sparse_stats = empty_stats;
+
+    // Els blocs només es comproven si tenim les fulles de l'arbre i els paquets porten el seu offset (un bloc corrupte es torna a demanar per paquets)
+    state->check.merkle = (state->sack && transfer->merkle && transfer->merkle->verified) ? transfer->merkle : NULL;
+    state->check.stripe = transfer->stripe;
+    state->check.first_packet = 0;
+    state->check.last_packet = transfer->n_packets - 1;
+    state->check.filename = transfer->filename;
+    state->check.print_mutex = transfer->print_mutex;
+
+    // Amb io_uring (si la configuració el demana i el kernel el permet) els paquets s'escriuen al fitxer en paral·lel a la recepció, sense projectar-lo
+    int use_ring = params && params->frame_version == FRAME_V2 && params->io_engine == CONN_IO_URING && IO_ringInit(&state->ring) == 0;
+    state->engine = use_ring ? COMM_ENGINE_IO_URING : COMM_ENGINE_FRAMES;
+    SOCKET_sizeBuffers(MUX_getTransport(socket));
+
+    // Obrim el fitxer amb la mida final sense truncar-lo, ja que en reprendre la recepció conserva els paquets ja rebuts
+    state->fd = COMM_openReceiveFile(transfer->file_path, state->file_size, use_ring ? NULL : &state->mapped);
+    if (state->fd < 0) {
+        STRING_printF(transfer->print_mutex, STDOUT_FILENO, MAGENTA, "ERROR: failed to open file %s\n", transfer->filename);
+        return UNEXPECTED_ERROR;
+    }
+
+    // Reutilitzem la mateixa trama del pool per a tots els paquets (amb io_uring, un lot de trames que s'alternen mentre s'escriuen)
+    int n_frames = use_ring ? COMM_RING_FRAMES : 1;
+    uint32_t offset_size = state->sack ? FRAME_PACKET_OFFSET_SIZE : 0;
+    if (SACK_prepareMap(transfer->received, transfer->n_packets, state->data_size) < 0 || FRAME_reservePool(transfer->pool, state->data_size + offset_size, n_frames) < 0) return UNEXPECTED_ERROR;
+    while (state->n_frames < n_frames) {
+        state->frames[state->n_frames] = FRAME_acquireFrame(transfer->pool);
+        if (!state->frames[state->n_frames]) return UNEXPECTED_ERROR;
+        state->n_frames++;
+    }
+    if (use_ring && IO_ringRegisterBuffer(&state->ring, transfer->pool->storage, (size_t)transfer->pool->n_frames * FRAME_STORAGE_SIZE(transfer->pool->capacity)) == 0) state->buffer_index = 0;
+    return TRANSFER_SUCCESS;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Acabar una recepción: dejar el MD5 hasta donde llegan los paquetes recibidos 
+*             sin huecos (con io_uring, los que se han escrito fuera de orden), también si 
+*             la recepción se ha interrumpido, guardar el MD5 que ha llegado con los 
+*             paquetes y liberar las tramas, la proyección, los anillos y el archivo. Los 
+*             datos copiados a la proyección ya están en la memoria caché del archivo, donde 
+*             los ve cualquier otro proceso que lo lea. 
+* 
+* @Parámetros: 
+* in/out: state = Estado de la recepción, preparado con `COMM_openReceive`. 
+* in: result = Resultado de la recepción. 
+* 
+* @Retorno: `result`, o UNEXPECTED_ERROR si la recepción había acabado bien pero no se ha 
+*           podido avanzar el MD5. 
+* 
+************************************************/
+static int COMM_closeReceive(ReceiveState *state, int result) {
+    const FileTransfer *transfer = state->transfer;
+
+    if (transfer->hash && result != UNEXPECTED_ERROR && HASH_advance(transfer->hash, state->fd, state->mapped, COMM_hashablePrefix(transfer->received, state->check.merkle, transfer->hash, state->data_size, state->file_size)) < 0 && result == TRANSFER_SUCCESS) result = UNEXPECTED_ERROR;
+
+    if (state->digest && result == TRANSFER_SUCCESS) {
+        free(*(transfer->md5sum));
+        *(transfer->md5sum) = state->digest;
+    } else {
+        free(state->digest);
+    }
+
+    COMM_releaseFrames(transfer->pool, state->frames, state->n_frames);
+    if (state->mapped) munmap(state->mapped, (size_t)state->file_size);
+    IO_ringDestroy(&state->ring);
+    SHM_destroyRing(&state->shm_ring);
+    if (state->fd >= 0) close(state->fd);
+    return result;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Con ACK selectivos, informar al emisor de los paquetes que ya se tienen, para 
+*             que solo envíe los que faltan. Antes se comprueban los bloques ya recibidos, 
+*             y los de un bloque corrupto no se le cuentan. Si el emisor no espera este ACK 
+*             (`CONN_CAP_PIPELINE`) se envía igualmente, aunque ya se tenga todo, para que 
+*             deje de enviar lo que ya se tiene. 
+* 
+* @Parámetros: 
+* in/out: state = Estado de la recepción. Se actualizan los paquetes confirmados. 
+* 
+* @Retorno: 
+*           TRANSFER_SUCCESS = ACK enviado (o sin ACK selectivos). 
+*           UNEXPECTED_ERROR = Error al comprobar los bloques o al enviar el ACK. 
+* 
+************************************************/
+static int COMM_sendInitialSack(ReceiveState *state) {
+    const FileTransfer *transfer = state->transfer;
+    PacketMap *received = transfer->received;
+    int eager = state->sack && (state->params->capabilities & CONN_CAP_PIPELINE) && !transfer->stripe && !state->shm;
+
+    if (!state->sack) return TRANSFER_SUCCESS;
+    if (COMM_checkChunks(&state->check, received, state->fd, state->mapped, state->file_size, -1) < 0) return UNEXPECTED_ERROR;
+    *(transfer->n_processed_packets) = received->n_received;
+    if (received->n_received < transfer->n_packets || (eager && transfer->n_packets > 0)) {
+        if (COMM_sendSackFrame(state->socket, received, state->params) != TRANSFER_SUCCESS) return UNEXPECTED_ERROR;
+    }
+    return TRANSFER_SUCCESS;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Recibir por un anillo de memoria compartida los paquetes del archivo que 
+*             faltan (`CONN_CAP_SHM`). Se abre el segmento que ofrece el emisor (trama 
+*             0x1B) y se le responde si se ha podido abrir; cada registro del anillo se 
+*             copia a su posición del archivo y se marca en el bitmap. Cuando el emisor 
+*             cierra el anillo se comprueban los bloques enteros contra el árbol de Merkle 
+*             y se manda un único ACK selectivo: los paquetes que no han llegado o son de 
+*             un bloque corrupto los vuelve a enviar el emisor por el socket. 
+* 
+* @Parámetros: 
+* in/out: state = Estado de la recepción. Su anillo queda vacío si no se usa y lo destruye 
+*                 `COMM_closeReceive`; se le suman los paquetes escritos desde él. 
+* 
+* @Retorno: 
+*           TRANSFER_SUCCESS = Anillo terminado (o no usado) y ACK enviado. 
+*           REMOTE_END_DISCONNECTION = El emisor se ha desconectado. 
+*           UNEXPECTED_ERROR = Error al escribir el archivo o registro no válido. 
+* 
+************************************************/
+static int COMM_receiveFileShm(ReceiveState *state) {
+    const FileTransfer *transfer = state->transfer;
+    ShmRing *ring = &state->shm_ring;
+    PacketMap *received = transfer->received;
+    ChunkCheck *check = &state->check;
+    volatile int *exit_distortion = transfer->exit_distortion;
+    int worker_socket = state->socket;
+    int result = TRANSFER_SUCCESS;
+    uint32_t data_size = (uint32_t)received->data_size;
+    uint8_t storage[FRAME_STORAGE_SIZE(DATA_SIZE)];
+    Frame control_frame;
+    FRAME_initFrame(&control_frame, storage, sizeof(storage));
+
+    // L'emisor ofereix el nom del segment; una oferta buida vol dir que no ha pogut crear l'anell
+    FrameErrorCode error_code = FRAME_readerReceiveFrameInto(transfer->reader, &control_frame);
+    if (error_code != FRAME_SUCCESS) return error_code == FRAME_DISCONNECTED ? REMOTE_END_DISCONNECTION : UNEXPECTED_ERROR;
+    if (control_frame.type != 0x1B) return UNEXPECTED_ERROR;
+    if (control_frame.data_length == 0) return TRANSFER_SUCCESS;
+
+    char name[SHM_NAME_SIZE];
+    size_t name_length = control_frame.data_length < SHM_NAME_SIZE - 1 ? control_frame.data_length : SHM_NAME_SIZE - 1;
+    memcpy(name, control_frame.data, name_length);
+    name[name_length] = '\0';
+    int attached = SHM_attachRing(ring, name) == 0;
+    FRAME_fillFrame(&control_frame, 0x1B, attached ? "1" : NULL, attached ? 1 : 0);
+    if (FRAME_sendFrame(worker_socket, &control_frame) < 0) return UNEXPECTED_ERROR;
+    if (!attached) return TRANSFER_SUCCESS;
+
+    for (;;) {
+        uint64_t offset;
+        const uint8_t *data;
+        uint32_t length;
+        int status = SHM_peek(ring, COMM_SHM_WAIT_MS, &offset, &data, &length);
+        if (status < 0) break;
+        if (status == 0) {
+            if (*(exit_distortion)) break;
+            if (COMM_isPeerClosed(worker_socket)) {
+                result = REMOTE_END_DISCONNECTION;
+                break;
+            }
+            continue;
+        }
+
+        // Cada registre és un tram de paquets sencers (l'últim pot ser el final del fitxer)
+        if (length == 0 || offset % data_size != 0 || COMM_writeReceivedPacket(state->fd, state->mapped, state->file_size, (off_t)offset, data, length) < 0) {
+            result = UNEXPECTED_ERROR;
+            break;
+        }
+        SHAPER_acquire(state->params->shaper, SHAPER_INGRESS, length, exit_distortion);
+        if (!check->merkle) COMM_hashPacket(transfer->hash, (off_t)offset, data, length);
+        SHM_release(ring);
+
+        int first = (int)(offset / data_size);
+        int last = (int)((offset + length - 1) / data_size);
+        for (int packet = first; packet <= last; packet++) {
+            SACK_markReceived(received, packet);
+            COMM_trackChunkPacket(check, packet);
+        }
+        state->written_packets += last - first + 1;
+        if (transfer->hash && HASH_advance(transfer->hash, state->fd, state->mapped, COMM_hashablePrefix(received, check->merkle, transfer->hash, data_size, state->file_size)) < 0) {
+            result = UNEXPECTED_ERROR;
+            break;
+        }
+    }
+    if (result != TRANSFER_SUCCESS || *(exit_distortion)) {
+        SHM_close(ring);
+        return result;
+    }
+
+    // Els blocs corruptes queden fora del bitmap sense demanar-los a part: l'ACK ja diu a l'emisor que els ha de tornar a enviar
+    if (COMM_checkChunks(check, received, state->fd, state->mapped, state->file_size, -1) < 0) return UNEXPECTED_ERROR;
+    SOCKET_rearmQuickAck(worker_socket);
+    result = COMM_sendSackFrame(worker_socket, received, state->params);
+    if (result == TRANSFER_SUCCESS) *(transfer->n_processed_packets) = received->n_received;
+    return result;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Recibir los paquetes que faltan de un archivo con el motor io_uring. Cada 
+*             paquete se recibe en una trama libre del lote y su escritura al archivo se 
+*             pone en curso en el ring sin esperarla, de modo que la recepción del socket 
+*             continúa mientras se escriben los anteriores. Antes de cada ACK se esperan 
+*             las escrituras en curso, para confirmar solo paquetes que ya están en el 
+*             archivo (y, con árbol de Merkle, cuyos bloques enteros ya se han comprobado). 
+* 
+* @Parámetros: 
+* in/out: state = Estado de la recepción con el ring creado (`COMM_ENGINE_IO_URING`). Al 
+*                 acabar no le queda ninguna escritura en curso. 
+* 
+* @Retorno: 
+*           TRANSFER_SUCCESS = Recepción acabada o interrumpida por `exit_distortion`. 
+*           REMOTE_END_DISCONNECTION = El extremo remoto se desconectó. 
+*           UNEXPECTED_ERROR = Paquete incorrecto o error al escribir o al enviar un ACK. 
+* 
+************************************************/
+static int COMM_receiveFileRing(ReceiveState *state) {
+    const FileTransfer *transfer = state->transfer;
+    IORing *ring = &state->ring;
+    PacketMap *received = transfer->received;
+    ChunkCheck *check = &state->check;
+    FrameReader *reader = transfer->reader;
+    Frame **frames = state->frames;
+    volatile int *exit_distortion = transfer->exit_distortion;
+    int *n_processed_packets = transfer->n_processed_packets;
+    int n_packets = transfer->n_packets;
+    int worker_socket = state->socket;
+    off_t file_size = state->file_size;
+    int fd = state->fd;
+    uint32_t data_size = state->data_size;
+    int sack = state->sack;
+    int result = TRANSFER_SUCCESS;
+    RingWrites writes;
+    int received_packets = sack ? received->n_received : *n_processed_packets;
+    int next_sequential = received_packets;     // Sense ACK selectius, número del següent paquet que arribarà
+    int pending_ack = 0;                        // Paquets escrits des de l'últim ACK
+
+    writes.pending = 0;
+    for (int i = 0; i < state->n_frames; i++) writes.packet[i] = -1;
+
+    while (received_packets < n_packets && !*(exit_distortion)) {
+        // Trama lliure on rebre el següent paquet: si totes s'estan escrivint, esperem que n'acabi alguna
+        int index = -1;
+        while (index < 0) {
+            for (int i = 0; i < state->n_frames && index < 0; i++) {
+                if (writes.packet[i] < 0) index = i;
+            }
+            if (index >= 0) break;
+
+            int completed = COMM_completeRingWrite(ring, &writes, received, 1);
+            if (completed < 0) {
+                result = UNEXPECTED_ERROR;
+                goto end_ring;
+            }
+            received_packets = sack ? received->n_received : received_packets + completed;
+            pending_ack += completed;
+            state->written_packets += completed;
+        }
+
+        FrameErrorCode error_code = FRAME_readerReceiveFrameInto(reader, frames[index]);
+        if (error_code != FRAME_SUCCESS) {
+            result = error_code == FRAME_DISCONNECTED ? REMOTE_END_DISCONNECTION : UNEXPECTED_ERROR;
+            goto end_ring;
+        }
+        // El MD5 arriba abans que els paquets d'un bloc que s'ha tornat a demanar
+        if (state->inline_digest && frames[index]->type == 0x14) {
+            if (COMM_takeFileDigest(frames[index], &state->digest) < 0) {
+                result = UNEXPECTED_ERROR;
+                goto end_ring;
+            }
+            continue;
+        }
+        SHAPER_acquire(state->params->shaper, SHAPER_INGRESS, frames[index]->data_length, exit_distortion);
+
+        int packet = next_sequential;
+        uint8_t *data;
+        uint32_t length;
+        if (!COMM_parsePacket(frames[index], sack, data_size, n_packets, &packet, &data, &length) || (frames[index]->type == 0x05 && (off_t)packet * data_size + length > file_size)) {
+            result = UNEXPECTED_ERROR;
+            goto end_ring;
+        }
+
+        if (frames[index]->type == 0x1A) {
+            // Un paquet amb trams s'escriu en el moment (els trams de zeros són forats, sense escriptura) i la trama queda lliure
+            if (SPARSE_writePacket(fd, NULL, file_size, (off_t)packet * data_size, data, length, data_size, &state->sparse_stats) < 0) {
+                result = UNEXPECTED_ERROR;
+                goto end_ring;
+            }
+            SACK_markReceived(received, packet);
+            received_packets = sack ? received->n_received : received_packets + 1;
+            pending_ack++;
+            state->written_packets++;
+
+            // Les dades no són a cap trama: el MD5 el continua des del fitxer, fins on arriben els paquets ja escrits
+            if (!check->merkle && transfer->hash && HASH_advance(transfer->hash, fd, NULL, COMM_receivedPrefix(received, data_size, file_size)) < 0) {
+                result = UNEXPECTED_ERROR;
+                goto end_ring;
+            }
+        } else {
+            // Resumim el paquet mentre encara és a la trama (amb arbre de Merkle, només quan el seu bloc s'hagi comprovat) i posem en curs la seva escriptura al fitxer directament des d'ella
+            if (!check->merkle) COMM_hashPacket(transfer->hash, (off_t)packet * data_size, data, length);
+            if (IO_ringPrepWrite(ring, fd, data, length, (uint64_t)packet * data_size, state->buffer_index, (uint64_t)index) < 0 || (IO_ringSubmit(ring) < 0 && errno != EINTR)) {
+                result = UNEXPECTED_ERROR;
+                goto end_ring;
+            }
+            writes.packet[index] = packet;
+            writes.length[index] = length;
+            writes.pending++;
+        }
+        next_sequential++;
+        COMM_trackChunkPacket(check, packet);
+
+        // Recollim les escriptures que ja han acabat
+        int completed;
+        while ((completed = COMM_completeRingWrite(ring, &writes, received, 0)) > 0) {
+            received_packets = sack ? received->n_received : received_packets + 1;
+            pending_ack++;
+            state->written_packets++;
+        }
+        if (completed < 0) {
+            result = UNEXPECTED_ERROR;
+            goto end_ring;
+        }
+
+        // Confirmem si ja s'estan escrivint els últims paquets, si ja n'hi ha prou de pendents o si l'emisor s'ha quedat sense paquets en vol
+        if (received_packets + writes.pending >= n_packets || pending_ack + writes.pending >= COMM_ACK_INTERVAL || !COMM_hasPendingData(reader)) {
+            while (writes.pending > 0) {
+                completed = COMM_completeRingWrite(ring, &writes, received, 1);
+                if (completed < 0) {
+                    result = UNEXPECTED_ERROR;
+                    goto end_ring;
+                }
+                received_packets = sack ? received->n_received : received_packets + completed;
+                pending_ack += completed;
+                state->written_packets += completed;
+            }
+
+            // Els blocs que ja són sencers es comproven abans de confirmar-ne els paquets
+            if (COMM_checkChunks(check, received, fd, NULL, file_size, worker_socket) < 0) {
+                result = UNEXPECTED_ERROR;
+                goto end_ring;
+            }
+            if (sack) received_packets = received->n_received;
+
+            // El nucli desactiva els ACK immediats quan creu que la connexió és interactiva, i aleshores l'ACK de TCP de les dades esperaria al de la trama
+            SOCKET_rearmQuickAck(worker_socket);
+            int ack_result = sack ? COMM_sendSackFrame(worker_socket, received, state->params) : COMM_sendAckFrame(worker_socket, received_packets);
+            if (ack_result != TRANSFER_SUCCESS) {
+                result = UNEXPECTED_ERROR;
+                goto end_ring;
+            }
+            *n_processed_packets = received_packets;
+            pending_ack = 0;
+        }
+    }
+
+end_ring:
+    // Les trames no es poden reutilitzar ni el fitxer tancar-se fins que no acabin les escriptures en curs
+    while (writes.pending > 0) {
+        if (COMM_completeRingWrite(ring, &writes, received, 1) == 0) break;
+    }
+    return result;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Recibir los paquetes que faltan de un archivo sobre una sola trama del pool 
+*             (`COMM_ENGINE_FRAMES`), copiando cada uno a la proyección del archivo o, si 
+*             no se ha podido proyectar, escribiéndolo con `pwrite`. Se confirma cada 
+*             `COMM_ACK_INTERVAL` paquetes, al recibir el último y siempre que el emisor no 
+*             tenga más paquetes en vuelo, después de comprobar los bloques ya enteros. 
+* 
+* @Parámetros: 
+* in/out: state = Estado de la recepción. 
+* 
+* @Retorno: 
+*           TRANSFER_SUCCESS = Recepción acabada o interrumpida por `exit_distortion`. 
+*           REMOTE_END_DISCONNECTION = El extremo remoto se desconectó. 
+*           UNEXPECTED_ERROR = Paquete incorrecto o error al escribir o al enviar un ACK. 
+* 
+************************************************/
+static int COMM_receiveFileFrames(ReceiveState *state) {
+    const FileTransfer *transfer = state->transfer;
+    PacketMap *received = transfer->received;
+    ChunkCheck *check = &state->check;
+    Frame *packet_frame = state->frames[0];
+    volatile int *exit_distortion = transfer->exit_distortion;
+    int n_packets = transfer->n_packets;
+    int worker_socket = state->socket;
+    off_t file_size = state->file_size;
+    uint32_t data_size = state->data_size;
+    int sack = state->sack;
+    int received_packets = sack ? received->n_received : *(transfer->n_processed_packets);    // Sense ACK selectius, paquets escrits al fitxer en ordre, confirmats o no
+    int pending_ack = 0;                                                                        // Paquets escrits des de l'últim ACK
+
+    // Mentre no haguem rebut tots els paquets, continuem processant
+    while (received_packets < n_packets && !*(exit_distortion)) {
+        // Rebem la trama del worker
+        FrameErrorCode error_code = FRAME_readerReceiveFrameInto(transfer->reader, packet_frame);
+        if (error_code != FRAME_SUCCESS) return error_code == FRAME_DISCONNECTED ? REMOTE_END_DISCONNECTION : UNEXPECTED_ERROR;
+
+        // El MD5 arriba abans que els paquets d'un bloc que s'ha tornat a demanar
+        if (state->inline_digest && packet_frame->type == 0x14) {
+            if (COMM_takeFileDigest(packet_frame, &state->digest) < 0) return UNEXPECTED_ERROR;
+            continue;
+        }
+        // Si el worker té l'amplada de banda limitada, deixem de llegir del socket fins que l'usuari té fitxes (el control de flux de TCP frena l'emissor)
+        SHAPER_acquire(state->params ? state->params->shaper : NULL, SHAPER_INGRESS, packet_frame->data_length, exit_distortion);
+
+        // Amb ACK selectius el paquet porta el seu offset; si no, és el següent del fitxer
+        int packet = received_packets;
+        uint8_t *data;
+        uint32_t length;
+        int valid = COMM_parsePacket(packet_frame, sack, data_size, n_packets, &packet, &data, &length);
+        int sparse = valid && packet_frame->type == 0x1A;
+
+        // Si el tipus de trama rebut no és correcte o no podem escriure les dades al fitxer abortem amb codi d'error. Un paquet amb trams els materialitza sense haver-los rebut
+        if (sparse) valid = SPARSE_writePacket(state->fd, state->mapped, file_size, (off_t)packet * data_size, data, length, data_size, &state->sparse_stats) >= 0;
+        if (!valid || (!sparse && COMM_writeReceivedPacket(state->fd, state->mapped, file_size, (off_t)packet * data_size, data, length) < 0)) return UNEXPECTED_ERROR;
+        SACK_markReceived(received, packet);
+        received_packets = sack ? received->n_received : received_packets + 1;
+        pending_ack++;
+        state->written_packets++;
+        COMM_trackChunkPacket(check, packet);
+
+        // Resumim el paquet si és el següent del fitxer i, si omple un buit, els que havien arribat abans fora d'ordre (amb arbre de Merkle, un cop comprovat el seu bloc; amb trams, des del fitxer)
+        if (!check->merkle && !sparse) COMM_hashPacket(transfer->hash, (off_t)packet * data_size, data, length);
+        if (transfer->hash && HASH_advance(transfer->hash, state->fd, state->mapped, COMM_hashablePrefix(received, check->merkle, transfer->hash, data_size, file_size)) < 0) return UNEXPECTED_ERROR;
+
+        // Confirmem si és l'últim paquet, si ja n'hi ha prou de pendents o si l'emisor s'ha quedat sense paquets en vol
+        if (received_packets == n_packets || pending_ack >= COMM_ACK_INTERVAL || !COMM_hasPendingData(transfer->reader)) {
+            // Els blocs que ja són sencers es comproven abans de confirmar-ne els paquets
+            if (COMM_checkChunks(check, received, state->fd, state->mapped, file_size, worker_socket) < 0) return UNEXPECTED_ERROR;
+            if (sack) received_packets = received->n_received;
+
+            SOCKET_rearmQuickAck(worker_socket);
+            int ack_result = sack ? COMM_sendSackFrame(worker_socket, received, state->params) : COMM_sendAckFrame(worker_socket, received_packets);
+            if (ack_result != TRANSFER_SUCCESS) return UNEXPECTED_ERROR;
+
+            // Actualitzem el nombre de paquets confirmats
+            *(transfer->n_processed_packets) = received_packets;
+            pending_ack = 0;
+        }
+    }
+    return TRANSFER_SUCCESS;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Esperar el MD5 que el emisor envía detrás de los paquetes, si aún no ha 
+*             llegado entre ellos. Los paquetes que lleguen antes son duplicados que el 
+*             emisor ha enviado sin saber que ya se tenían y se descartan. 
+* 
+* @Parámetros: 
+* in/out: state = Estado de la recepción. Se guarda el MD5 recibido. 
+* 
+* @Retorno: 
+*           TRANSFER_SUCCESS = MD5 recibido (o no viaja con la transferencia). 
+*           REMOTE_END_DISCONNECTION = El emisor se ha desconectado antes de enviarlo. 
+*           UNEXPECTED_ERROR = Trama incorrecta o error al guardar el MD5. 
+* 
+************************************************/
+static int COMM_receiveInlineDigest(ReceiveState *state) {
+    const FileTransfer *transfer = state->transfer;
+    Frame *frame = state->frames[0];
+
+    while (state->inline_digest && !state->digest && !*(transfer->exit_distortion)) {
+        FrameErrorCode error_code = FRAME_readerReceiveFrameInto(transfer->reader, frame);
+        if (error_code != FRAME_SUCCESS) {
+            if (error_code != FRAME_DISCONNECTED) return UNEXPECTED_ERROR;
+            STRING_printF(transfer->print_mutex, STDOUT_FILENO, RED, "%s disconnected while sending the file's md5\n", transfer->process == FLECK ? "Worker" : "Fleck");
+            return REMOTE_END_DISCONNECTION;
+        }
+        if ((frame->type == 0x14 && COMM_takeFileDigest(frame, &state->digest) < 0) || (frame->type != 0x14 && frame->type != 0x05 && frame->type != 0x1A)) {
+            STRING_printF(transfer->print_mutex, STDOUT_FILENO, RED, "ERROR: wrong frame received as the file's md5\n");
+            return UNEXPECTED_ERROR;
+        }
+    }
+    return TRANSFER_SUCCESS;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Mostrar las medidas de una recepción acabada (con "stats on"): paquetes 
+*             escritos, reservas de memoria, forma de escribir el archivo, anillo de 
+*             memoria compartida, tramos de un mismo byte y estado del socket. 
+* 
+* @Parámetros: 
+* in: state = Estado de la recepción, antes de `COMM_closeReceive`. 
+* in: allocations = Tramas reservadas durante la recepción. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+static void COMM_printReceiveStatistics(const ReceiveState *state, unsigned long allocations) {
+    const FileTransfer *transfer = state->transfer;
+    const char *written = state->mapped ? "preallocated and memory-mapped" : (state->engine == COMM_ENGINE_IO_URING ? "preallocated and written with io_uring" : "written with pwrite");
+
+    STRING_printF(transfer->print_mutex, STDOUT_FILENO, GREEN, "Successfully received %s's file (%d packets, %lu frame allocations, %s)\n", transfer->process == FLECK ? "Worker" : "Fleck", state->written_packets, allocations, written);
+    if (state->shm_ring.header) {
+        STRING_printF(transfer->print_mutex, STDOUT_FILENO, GREEN, "Received through a shared-memory ring (%lu futex waits for data, %lu wakeups of the sender)\n", state->shm_ring.waits, state->shm_ring.wakeups);
+    }
+    if (state->sparse_stats.packets > 0) {
+        STRING_printF(transfer->print_mutex, STDOUT_FILENO, GREEN, "Repeated-byte runs not received: %.1f MB in %d packets (%.1f MB left as holes)\n", state->sparse_stats.run_bytes / (1024.0 * 1024.0), state->sparse_stats.packets, state->sparse_stats.hole_bytes / (1024.0 * 1024.0));
+    }
+    SocketInfo socket_info;
+    if (SOCKET_getInfo(MUX_getTransport(state->socket), &socket_info) == 0) {
+        char socket_summary[SOCKET_DESCRIPTION_SIZE];
+        SOCKET_describeInfo(&socket_info, socket_summary, sizeof(socket_summary));
+        STRING_printF(transfer->print_mutex, STDOUT_FILENO, GREEN, "%s", socket_summary);
+    }
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Recibir un archivo desde un worker o fleck en paquetes a través de un socket, 
+*             escribiendo los datos en un archivo local y confirmándolos con ACK. Cada motor 
+*             tiene su rutina y esta solo las encadena: `COMM_openReceive` escoge el motor, 
+*             abre el archivo y reserva las tramas, `COMM_sendInitialSack` informa al 
+*             emisor de los paquetes que ya se tienen, `COMM_receiveFileShm` recibe los que 
+*             llegan por el anillo de memoria compartida (`CONN_CAP_SHM`, sin franjas) y el 
+*             resto llega por el socket y se escribe con io_uring (`COMM_receiveFileRing`) o 
+*             a la proyección o con `pwrite` (`COMM_receiveFileFrames`). Si el MD5 viaja con 
+*             la transferencia y aún no ha llegado, se espera con `COMM_receiveInlineDigest`. 
+* 
+* @Parámetros: 
+* in: transfer = Archivo a recibir y estado de la transferencia. 
+* in: worker_socket = Descriptor del socket utilizado para recibir los paquetes. 
+* in: params = Parámetros acordados con el otro extremo y motor de E/S local. 
+* 
+* @Retorno: 
+*           TRANSFER_SUCCESS = El archivo fue recibido con éxito. 
+*           REMOTE_END_DISCONNECTION = El extremo remoto (worker o fleck) se desconectó durante la transmisión. 
+*           UNEXPECTED_ERROR = Ocurrió un error durante la recepción o escritura del archivo. 
+*           INTERRUPTED_BY_SIGINT = La recepción fue interrumpida por una señal SIGINT. 
+* 
+************************************************/
+int COMM_receiveFile(const FileTransfer *transfer, int worker_socket, const ConnectionParams *params) {
+    ReceiveState state;
+    int result = COMM_openReceive(&state, transfer, worker_socket, params);
+    unsigned long allocations = FRAME_getAllocationCount();
+    if (result == TRANSFER_SUCCESS) result = COMM_sendInitialSack(&state);
+
+    // Amb l'emisor a la mateixa màquina els paquets que falten arriben per l'anell; pel socket només arriben els que hi hagin faltat
+    if (result == TRANSFER_SUCCESS && state.shm && transfer->received->n_received < transfer->n_packets) result = COMM_receiveFileShm(&state);
+
+    if (result == TRANSFER_SUCCESS) {
+        result = state.engine == COMM_ENGINE_IO_URING ? COMM_receiveFileRing(&state) : COMM_receiveFileFrames(&state);
+    }
+    if (result == REMOTE_END_DISCONNECTION) {
+        STRING_printF(transfer->print_mutex, STDOUT_FILENO, RED, "%s disconnected while sending file %s\n", transfer->process == FLECK ? "Worker" : "Fleck", transfer->filename);
+    }
+    if (result == TRANSFER_SUCCESS) result = COMM_receiveInlineDigest(&state);
+    allocations = FRAME_getAllocationCount() - allocations;
+
+    if (result == TRANSFER_SUCCESS && *(transfer->exit_distortion)) {
+        STRING_printF(transfer->print_mutex, STDOUT_FILENO, RED, "Exiting receive method because of sigint\n");
+        result = INTERRUPTED_BY_SIGINT;
+    } else if (result == TRANSFER_SUCCESS && !COMM_showStatistics()) {
+        STRING_printF(transfer->print_mutex, STDOUT_FILENO, GREEN, "Successfully received %s's file\n", transfer->process == FLECK ? "Worker" : "Fleck");
+    } else if (result == TRANSFER_SUCCESS) {
+        COMM_printReceiveStatistics(&state, allocations);
+    }
+    return COMM_closeReceive(&state, result);
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Preparar la transferencia por paquetes del archivo de una distorsión, con su 
+*             progreso, su bitmap, su MD5 incremental y su árbol de Merkle, de modo que se 
+*             pueda pasar a `COMM_sendFile`, `COMM_receiveFile` o a sus versiones por 
+*             franjas. Se prepara justo antes de transferir, ya que se copian la ruta y el 
+*             número de paquetes que tiene el contexto en ese momento. 
+* 
+* @Parámetros: 
+* out: transfer = Transferencia a preparar (sin franja). 
+* in/out: context = Contexto de la distorsión, cuyo progreso se actualiza durante la transferencia. 
+* in/out: pool = Pool de tramas de la conexión. 
+* in/out: reader = Lector con buffer de la conexión. 
+* in: exit_distortion = Bandera que indica si se debe interrumpir la transferencia. 
+* in: process = Indica si se está comunicando con un worker o un fleck (e.g., `FLECK`). 
+* in: print_mutex = Mutex para sincronizar los mensajes de impresión. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void COMM_initTransfer(FileTransfer *transfer, DistortionContext *context, FramePool *pool, FrameReader *reader, volatile int *exit_distortion, int process, pthread_mutex_t *print_mutex) {
+    transfer->file_path = context->file_path;
+    transfer->filename = context->filename;
+    transfer->file_size = context->filesize;
+    transfer->n_packets = context->n_packets;
+    transfer->n_processed_packets = &context->n_processed_packets;
+    transfer->received = &context->received;
+    transfer->stripe = NULL;
+    transfer->hash = &context->hash;
+    transfer->merkle = &context->merkle;
+    transfer->md5sum = &context->md5sum;
+    transfer->pool = pool;
+    transfer->reader = reader;
+    transfer->exit_distortion = exit_distortion;
+    transfer->process = process;
+    transfer->print_mutex = print_mutex;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Cortar las conexiones de las otras franjas de una transferencia cuando la 
+*             de una franja falla, para que sus hilos no se queden esperando paquetes o 
+*             ACK que ya no llegarán. 
+* 
+* @Parámetros: 
+* in: stripe = Franja cuya transferencia ha fallado. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+static void COMM_abortStripes(const StripeTransfer *stripe) {
+    for (int i = 0; i < stripe->n_stripes; i++) {
+        if (i != stripe->index) shutdown(stripe->sockets[i], SHUT_RDWR);
+    }
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Enviar la franja de un archivo por su conexión (rutina de los hilos de 
+*             `COMM_sendFileStriped`). 
+* 
+* @Parámetros: 
+* in/out: arg = Puntero a la `StripeTransfer` de la franja. Se guarda el resultado. 
+* 
+* @Retorno: Siempre NULL. 
+* 
+************************************************/
+static void *COMM_sendStripe(void *arg) {
+    StripeTransfer *stripe = (StripeTransfer *)arg;
+
+    stripe->result = COMM_sendFile(&stripe->transfer, stripe->sockets[stripe->index], stripe->params);
+    if (stripe->result != TRANSFER_SUCCESS) COMM_abortStripes(stripe);
+    return NULL;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Recibir la franja de un archivo por su conexión (rutina de los hilos de 
+*             `COMM_receiveFileStriped`). Si la franja ya estaba completa solo se informa 
+*             al emisor con el ACK selectivo inicial, que es lo que espera para acabar. 
+* 
+* @Parámetros: 
+* in/out: arg = Puntero a la `StripeTransfer` de la franja. Se guarda el resultado. 
+* 
+* @Retorno: Siempre NULL. 
+* 
+************************************************/
+static void *COMM_receiveStripe(void *arg) {
+    StripeTransfer *stripe = (StripeTransfer *)arg;
+    int socket = stripe->sockets[stripe->index];
+
+    if (stripe->received.n_received == stripe->transfer.n_packets) {
+        stripe->n_processed_packets = stripe->transfer.n_packets;
+        stripe->result = COMM_sendSackFrame(socket, &stripe->received, stripe->params);
+    } else {
+        stripe->result = COMM_receiveFile(&stripe->transfer, socket, stripe->params);
+    }
+    if (stripe->result != TRANSFER_SUCCESS) COMM_abortStripes(stripe);
+    return NULL;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Transferir todas las franjas a la vez: la franja 0 en el hilo que llama, 
+*             con el pool y el lector de la conexión principal, y cada una de las demás 
+*             en un hilo propio con su pool y su lector. 
+* 
+* @Parámetros: 
+* in/out: stripes = Franjas de la transferencia, ya inicializadas. Se guarda el resultado 
+*                   de cada una. 
+* in: n_stripes = Número de franjas. 
+* in: routine = Rutina que transfiere una franja (`COMM_sendStripe` o `COMM_receiveStripe`). 
+* 
+* @Retorno: 
+*           TRANSFER_SUCCESS = Todas las franjas se han transferido. 
+*           INTERRUPTED_BY_SIGINT, REMOTE_END_DISCONNECTION o UNEXPECTED_ERROR = Resultado 
+*           de las franjas fallidas, en este orden de prioridad (cuando una falla, las 
+*           demás acaban como desconectadas). 
+* 
+************************************************/
+static int COMM_runStripes(StripeTransfer *stripes, int n_stripes, void *(*routine)(void *)) {
+    pthread_t threads[CONN_MAX_STRIPES];
+    int launched[CONN_MAX_STRIPES] = {0};
+
+    for (int i = 1; i < n_stripes; i++) {
+        FRAME_initPool(&stripes[i].own_pool);
+        FRAME_initReader(&stripes[i].own_reader);
+        stripes[i].transfer.pool = &stripes[i].own_pool;
+        stripes[i].transfer.reader = &stripes[i].own_reader;
+        stripes[i].result = UNEXPECTED_ERROR;
+
+        if (FRAME_resetReader(&stripes[i].own_reader, stripes[i].sockets[i]) < 0 || pthread_create(&threads[i], NULL, routine, &stripes[i]) != 0) {
+            COMM_abortStripes(&stripes[i]);
+            continue;
+        }
+        launched[i] = 1;
+    }
+
+    routine(&stripes[0]);
+
+    int result = TRANSFER_SUCCESS;
+    for (int i = 0; i < n_stripes; i++) {
+        if (i > 0) {
+            if (launched[i]) pthread_join(threads[i], NULL);
+            FRAME_destroyPool(&stripes[i].own_pool);
+            FRAME_destroyReader(&stripes[i].own_reader);
+        }
+
+        // Prioritzem l'aturada per SIGINT i després la caiguda de l'altre extrem, que és la que permet reprendre la transferència
+        int stripe_result = stripes[i].result;
+        if (stripe_result == INTERRUPTED_BY_SIGINT || (stripe_result == REMOTE_END_DISCONNECTION && result != INTERRUPTED_BY_SIGINT) || (stripe_result == UNEXPECTED_ERROR && result == TRANSFER_SUCCESS)) {
+            result = stripe_result;
+        }
+    }
+    return result;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Inicializar las franjas de una transferencia repartida entre `n_stripes` 
+*             conexiones, cada una con su propio progreso y su propio bitmap. 
+* 
+* @Parámetros: 
+* out: stripes = Franjas a inicializar. 
+* in: transfer = Archivo y estado de la transferencia por la conexión principal. 
+* in: sockets = Conexiones de las franjas (la 0 es la conexión principal). 
+* in: n_stripes = Número de franjas. 
+* in: params = Parámetros acordados en la conexión principal, que comparten todas. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+static void COMM_initStripes(StripeTransfer *stripes, const FileTransfer *transfer, const int *sockets, int n_stripes, const ConnectionParams *params) {
+    for (int i = 0; i < n_stripes; i++) {
+        stripes[i].transfer = *transfer;
+        stripes[i].transfer.n_processed_packets = &stripes[i].n_processed_packets;
+        stripes[i].transfer.received = &stripes[i].received;
+        stripes[i].transfer.stripe = &stripes[i].range;
+        stripes[i].transfer.hash = NULL;
+        stripes[i].transfer.md5sum = NULL;
+        stripes[i].index = i;
+        stripes[i].sockets = sockets;
+        stripes[i].n_stripes = n_stripes;
+        SACK_getStripe(transfer->n_packets, n_stripes, i, &stripes[i].range);
+        SACK_initMap(&stripes[i].received);
+        stripes[i].n_processed_packets = 0;
+        stripes[i].params = params;
+        stripes[i].result = UNEXPECTED_ERROR;
+    }
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Enviar un archivo repartido en franjas de paquetes consecutivos, una por 
+*             conexión paralela con el mismo receptor, que las reconstruye por offset. 
+*             Cada franja se envía con `COMM_sendFile` en su propio hilo, de modo que 
+*             las conexiones no comparten ventana ni esperan los ACK de las demás. Requiere 
+*             `CONN_CAP_SACK` (cada paquete lleva su offset). 
+* 
+* @Parámetros: 
+* in: transfer = Archivo a enviar y estado de la transferencia por la conexión principal. 
+*                `n_processed_packets` acaba con los paquetes confirmados entre todas las 
+*                franjas. Los hilos de las franjas no calculan `hash`; si el envío acaba 
+*                bien se completa leyendo el archivo, que ya está en la memoria caché. 
+* in: sockets = Conexiones de las franjas; la 0 es la conexión principal. 
+* in: n_stripes = Número de franjas (como mucho `CONN_MAX_STRIPES`). 
+* in: params = Parámetros acordados en la conexión principal, que comparten todas. 
+* 
+* @Retorno: 
+*           TRANSFER_SUCCESS = El archivo fue enviado con éxito por todas las conexiones. 
+*           REMOTE_END_DISCONNECTION = El extremo remoto (worker o fleck) se desconectó. 
+*           UNEXPECTED_ERROR = Ocurrió un error durante la lectura o envío del archivo. 
+*           INTERRUPTED_BY_SIGINT = El envío fue interrumpido por una señal SIGINT. 
+* 
+************************************************/
+int COMM_sendFileStriped(const FileTransfer *transfer, const int *sockets, int n_stripes, const ConnectionParams *params) {
+    StripeTransfer stripes[CONN_MAX_STRIPES];
+    int n_packets = transfer->n_packets;
+    if (n_stripes > CONN_MAX_STRIPES) n_stripes = CONN_MAX_STRIPES;
+
+    COMM_initStripes(stripes, transfer, sockets, n_stripes, params);
+    int result = COMM_runStripes(stripes, n_stripes, COMM_sendStripe);
+
+    // Paquets confirmats de cada franja, sense comptar els de fora que ja es donaven per confirmats
+    *(transfer->n_processed_packets) = 0;
+    for (int i = 0; i < n_stripes; i++) {
+        int confirmed = stripes[i].n_processed_packets - (n_packets - stripes[i].range.n_packets);
+        if (confirmed > 0) *(transfer->n_processed_packets) += confirmed;
+    }
+
+    // Les franges s'envien en paral·lel i fora d'ordre: el MD5 es completa un cop enviades, llegint el fitxer de la memòria cau
+    if (result == TRANSFER_SUCCESS && transfer->hash) {
+        int fd = open(transfer->file_path, O_RDONLY);
+        struct stat file_stat;
+        if (fd < 0 || fstat(fd, &file_stat) < 0 || HASH_advance(transfer->hash, fd, NULL, file_stat.st_size) < 0) result = UNEXPECTED_ERROR;
+        if (fd >= 0) close(fd);
+    }
+
+    if (result == TRANSFER_SUCCESS) {
+        STRING_printF(transfer->print_mutex, STDOUT_FILENO, GREEN, "Sent %s over %d parallel connections\n", transfer->filename, n_stripes);
+    }
+    return result;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Recibir un archivo repartido en franjas de paquetes consecutivos, una por 
+*             conexión paralela con el mismo emisor. Cada franja se recibe con 
+*             `COMM_receiveFile` en su propio hilo sobre un bitmap propio y escribe sus 
+*             paquetes en su offset del archivo; al acabar (también si falla) los bitmaps 
+*             de las franjas se pasan al del archivo y se anota el progreso de cada franja, 
+*             de modo que una recepción interrumpida se puede reanudar en otro worker. 
+* 
+* @Parámetros: 
+* in: transfer = Archivo a recibir y estado de la transferencia por la conexión principal. 
+*                `received` son los paquetes ya escritos en el archivo (e.g., los 
+*                recuperados de la memoria compartida al reanudar) y `n_processed_packets` 
+*                acaba con los recibidos entre todas las franjas. Los hilos de las franjas 
+*                no calculan `hash`; al acabar se avanza hasta donde llegan los paquetes 
+*                recibidos sin huecos leyendo el archivo, que ya está en la memoria caché. 
+*                Cada franja comprueba sus bloques contra `merkle` y los que comparten 
+*                paquetes entre franjas se comprueban al acabar; si alguno es corrupto la 
+*                recepción falla y sus paquetes quedan pendientes para la reanudación. 
+* out: ranges = Franjas (`n_stripes` posiciones) con los paquetes consecutivos recibidos 
+*               de cada una. 
+* in: sockets = Conexiones de las franjas; la 0 es la conexión principal. 
+* in: n_stripes = Número de franjas (como mucho `CONN_MAX_STRIPES`). 
+* in: params = Parámetros acordados en la conexión principal, que comparten todas. 
+* 
+* @Retorno: 
+*           TRANSFER_SUCCESS = El archivo fue recibido con éxito por todas las conexiones. 
+*           REMOTE_END_DISCONNECTION = El extremo remoto (worker o fleck) se desconectó durante la transmisión. 
+*           UNEXPECTED_ERROR = Ocurrió un error durante la recepción o escritura del archivo. 
+*           INTERRUPTED_BY_SIGINT = La recepción fue interrumpida por una señal SIGINT. 
+* 
+************************************************/
+int COMM_receiveFileStriped(const FileTransfer *transfer, DistortionStripe *ranges, const int *sockets, int n_stripes, const ConnectionParams *params) {
+    StripeTransfer stripes[CONN_MAX_STRIPES];
+    PacketMap *received = transfer->received;
+    MerkleTree *merkle = transfer->merkle;
+    FileHash *hash = transfer->hash;
+    int n_packets = transfer->n_packets;
+    int result = TRANSFER_SUCCESS;
+    if (n_stripes > CONN_MAX_STRIPES) n_stripes = CONN_MAX_STRIPES;
+
+    COMM_initStripes(stripes, transfer, sockets, n_stripes, params);
+
+    // Cada franja parteix dels paquets que ja tenim i dona per rebuts els de les altres
+    if (SACK_prepareMap(received, n_packets, FRAME_getDataSize(params)) < 0) return UNEXPECTED_ERROR;
+    for (int i = 0; i < n_stripes && result == TRANSFER_SUCCESS; i++) {
+        if (SACK_prepareStripeMap(&stripes[i].received, received, &stripes[i].range) < 0) result = UNEXPECTED_ERROR;
+    }
+
+    if (result == TRANSFER_SUCCESS) {
+        result = COMM_runStripes(stripes, n_stripes, COMM_receiveStripe);
+    }
+
+    // Passem els paquets de cada franja al bitmap del fitxer, tant si s'ha acabat com si no, perquè es puguin reprendre
+    for (int i = 0; i < n_stripes; i++) {
+        ranges[i] = stripes[i].range;
+        if (stripes[i].received.bits) SACK_mergeStripe(received, &stripes[i].received, &ranges[i]);
+        SACK_freeMap(&stripes[i].received);
+    }
+
+    // Els blocs que comparteixen paquets entre franges només es poden comprovar ara. Si algun és corrupte, el treiem del progrés de la seva franja perquè es torni a demanar en reprendre
+    ChunkCheck check = {(merkle && merkle->verified && received->bits) ? merkle : NULL, NULL, 0, n_packets - 1, transfer->filename, transfer->print_mutex};
+    int fd = (check.merkle || hash) && received->bits ? open(transfer->file_path, O_RDONLY) : -1;
+    if (check.merkle && fd >= 0) {
+        int corrupted = COMM_checkChunks(&check, received, fd, NULL, (off_t)transfer->file_size, -1);
+        if (corrupted != 0) {
+            for (int i = 0; i < n_stripes; i++) {
+                ranges[i].n_received = 0;
+                while (ranges[i].n_received < ranges[i].n_packets && SACK_isReceived(received, ranges[i].first_packet + ranges[i].n_received)) ranges[i].n_received++;
+            }
+            if (result == TRANSFER_SUCCESS) result = UNEXPECTED_ERROR;
+        }
+    }
+    *(transfer->n_processed_packets) = received->n_received;
+
+    // Avancem el MD5 fins on arriben els paquets rebuts sense buits (i verificats), tant si s'ha acabat com si no, perquè es pugui guardar amb el progrés
+    if (hash && received->bits) {
+        if ((fd < 0 || HASH_advance(hash, fd, NULL, COMM_hashablePrefix(received, check.merkle, hash, FRAME_getDataSize(params), (off_t)transfer->file_size)) < 0) && result == TRANSFER_SUCCESS) result = UNEXPECTED_ERROR;
+    }
+    if (fd >= 0) close(fd);
+
+    if (result == TRANSFER_SUCCESS) {
+        STRING_printF(transfer->print_mutex, STDOUT_FILENO, GREEN, "Received %s over %d parallel connections\n", transfer->filename, n_stripes);
+    }
+    return result;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Crear y enviar una trama de comprobación MD5 a través de un socket, 
+*             utilizando el tipo de trama y contenido especificado. 
+* 
+* @Parámetros: 
+* in: client_socket = Descriptor del socket al que se enviará la trama. 
+* in: type = Tipo de trama que se enviará (por ejemplo, para indicar éxito o fallo en la verificación MD5). 
+* in: string = Cadena que contiene el contenido de la trama (e.g., resultado de la verificación MD5). 
+* 
+* @Retorno: 
+*           0 = La trama fue enviada con éxito. 
+*          -1 = Error al enviar la trama. 
+* 
+************************************************/
+int COMM_sendMD5CheckFrame (int client_socket, int type, char* string) {
+    int send_success = 0;
+    Frame* check_frame = FRAME_createFrame(type, string, strlen(string)); 
+    if(FRAME_sendFrame(client_socket, check_frame) < 0) send_success = -1;
+    FRAME_destroyFrame(check_frame);
+    return send_success; 
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Verificar la integridad de un archivo mediante la comparación de su hash MD5 
+*             con el esperado, y enviar el resultado al worker a través de un socket. 
+* 
+* @Parámetros: 
+* in: file_path = Ruta completa del archivo cuya integridad se verificará. 
+* in: md5sum = Hash MD5 esperado del archivo. 
+* in: hash = MD5 incremental calculado durante la recepción, o NULL. Si cubre el archivo 
+*            entero no se vuelve a leer el archivo; si no, se calcula el MD5 leyéndolo. 
+* in: worker_socket = Descriptor del socket utilizado para enviar el resultado de la verificación. 
+* in: print_mutex = Mutex para sincronizar los mensajes de impresión. 
+* 
+* @Retorno: 
+*           TRANSFER_SUCCESS = La integridad del archivo fue verificada exitosamente (MD5 coincide). 
+*           UNEXPECTED_ERROR = Error en la verificación o el MD5 no coincide. 
+* 
+************************************************/
+int COMM_verifyFileIntegrity(char* file_path, char* md5sum, const FileHash *hash, int worker_socket, pthread_mutex_t *print_mutex) {
+    int md5_match = 0;
+
+    // Si el MD5 s'ha anat calculant mentre es rebia el fitxer i ja el cobreix sencer no cal tornar-lo a llegir
+    if (hash && (int)hash->length == FILE_getFileSize(file_path)) {
+        char received_md5[HASH_MD5_HEX_SIZE];
+        HASH_toHex(hash, received_md5);
+        md5_match = md5sum && !strcmp(md5sum, received_md5);
+    } else if (md5sum && *md5sum) {
+        md5_match = FILE_compareMD5(md5sum, file_path);
+    }
+ 
+    if(md5_match) {
+        // MD5 coincideix
+        if(COMM_sendMD5CheckFrame(worker_socket, 0x06, "CHECK_OK") < 0) {
+            STRING_printF(print_mutex, STDOUT_FILENO, RED, "ERROR: failed to send check frame\n");
+            return UNEXPECTED_ERROR;
+        }
+        STRING_printF(print_mutex, STDOUT_FILENO, GREEN, "Reassembled file matches the expected md5\n");
+    } else {
+        // MD5 no coincideix
+        if(COMM_sendMD5CheckFrame(worker_socket, 0x06, "CHECK_KO") < 0) {
+            STRING_printF(print_mutex, STDOUT_FILENO, RED, "ERROR: failed to send check frame\n");
+            return UNEXPECTED_ERROR;
+        }
+        STRING_printF(print_mutex, STDOUT_FILENO, RED, "ERROR: md5 mismatch between the original and reassembled file\n");
+    }
+
+    return md5_match ? TRANSFER_SUCCESS : UNEXPECTED_ERROR; 
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Recibir y procesar la verificación MD5 desde un worker o fleck a través de un socket, 
+*             evaluando si el archivo fue reensamblado correctamente. 
+* 
+* @Parámetros: 
+* in/out: reader = Lector con buffer de la conexión por la que se recibe la verificación MD5. 
+* in: process = Indica si la comunicación es con un worker o un fleck (e.g., `FLECK`). 
+* in: print_mutex = Mutex para sincronizar los mensajes de impresión. 
+* 
+* @Retorno: 
+*           TRANSFER_SUCCESS = El archivo fue reensamblado correctamente (MD5 coincide). 
+*           UNEXPECTED_ERROR = Error en la verificación o el reensamblado falló. 
+*           REMOTE_END_DISCONNECTION = El extremo remoto (worker o fleck) se desconectó durante la transmisión. 
+* 
+************************************************/
+int COMM_retrieveMD5Check(FrameReader *reader, int process, pthread_mutex_t *print_mutex) {
+    int unexpected_error = 1; 
+
+    // Rebem la trama del worker a través del lector, que pot tenir-la ja al buffer juntament amb l'últim ACK
+    FrameResult result = FRAME_readerReceiveFrame(reader);
+
+    // Si hi ha error en deserialitzar la trama retornem codi d'error (si caigués el worker en aquest punt es consideraria error)
+    if (result.error_code != FRAME_SUCCESS) {
+        if (result.error_code == FRAME_DISCONNECTED) {
+            STRING_printF(print_mutex, STDOUT_FILENO, RED, "%s disconnected while sending MD5 check\n", process == FLECK ? "Worker" : "Fleck");
+            unexpected_error = 0;
+        }
+        if (result.frame) FRAME_destroyFrame(result.frame);
+        return unexpected_error ? UNEXPECTED_ERROR : REMOTE_END_DISCONNECTION;
+    }
+
+    Frame *response_frame = result.frame;
+    if (response_frame->type == 0x06) {
+        if (strncmp((char *)response_frame->data, "CHECK_OK", 8) == 0) {
+            STRING_printF(print_mutex, STDOUT_FILENO, GREEN, "%s successfully reassembled the file!\n", process == FLECK ? "Worker" : "Fleck");
+            FRAME_destroyFrame(response_frame);
+            return TRANSFER_SUCCESS;  // CHECK_OK
+        }
+        
+        if (strncmp((char *)response_frame->data, "CHECK_KO", 8) == 0) {
+            STRING_printF(print_mutex, STDOUT_FILENO, RED, "Error: %s failed to reassmble the file\n", process == FLECK ? "Worker" : "Fleck");
+            FRAME_destroyFrame(response_frame);
+            return UNEXPECTED_ERROR;  // CHECK_KO
+        }
+
+        FRAME_destroyFrame(response_frame);
+        return UNEXPECTED_ERROR;  
+    }
+
+    FRAME_destroyFrame(response_frame);
+    return UNEXPECTED_ERROR;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Enviar el MD5 de un archivo justo después de sus paquetes (trama 0x14), 
+*             cuando la conexión ha acordado `CONN_CAP_HASH_TRAILER`. Así el MD5 se 
+*             calcula en la misma pasada en que se envía el archivo, en lugar de leerlo 
+*             entero antes para ponerlo en los metadatos. 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket por el que se ha enviado el archivo. 
+* in: hash = MD5 incremental del archivo, que ya lo cubre entero. 
+* in: params = Parámetros acordados con el otro extremo. 
+* 
+* @Retorno: 
+*           0 = La trama fue enviada con éxito. 
+*          -1 = Error al enviar la trama. 
+* 
+************************************************/
+int COMM_sendFileDigest(int socket, const FileHash *hash, const ConnectionParams *params) {
+    char md5sum[HASH_MD5_HEX_SIZE];
+    Metadata metadata;
+
+    HASH_toHex(hash, md5sum);
+    METADATA_init(&metadata);
+    METADATA_setString(&metadata, METADATA_MD5SUM, md5sum);
+    return COMM_sendMetadata(socket, 0x14, &metadata, METADATA_MSG_FILE_DIGEST, params);
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Recibir el MD5 que el emisor envía después de los paquetes de un archivo 
+*             (trama 0x14) y sustituir con él el MD5 esperado, que en los metadatos 
+*             puede haber llegado vacío. 
+* 
+* @Parámetros: 
+* in/out: reader = Lector con buffer de la conexión por la que ha llegado el archivo. 
+* in/out: md5sum = MD5 esperado del archivo. Se libera el anterior. 
+* in: process = Indica si se está comunicando con un worker o un fleck (e.g., `FLECK`). 
+* in: print_mutex = Mutex para sincronizar los mensajes de impresión. 
+* 
+* @Retorno: 
+*           TRANSFER_SUCCESS = MD5 recibido. 
+*           REMOTE_END_DISCONNECTION = El extremo remoto se desconectó antes de enviarlo. 
+*           UNEXPECTED_ERROR = Trama incorrecta o error al guardar el MD5. 
+* 
+************************************************/
+int COMM_retrieveFileDigest(FrameReader *reader, char **md5sum, int process, pthread_mutex_t *print_mutex) {
+    FrameResult result = FRAME_readerReceiveFrame(reader);
+
+    if (result.error_code != FRAME_SUCCESS) {
+        if (result.frame) FRAME_destroyFrame(result.frame);
+        if (result.error_code == FRAME_DISCONNECTED) {
+            STRING_printF(print_mutex, STDOUT_FILENO, RED, "%s disconnected while sending the file's md5\n", process == FLECK ? "Worker" : "Fleck");
+            return REMOTE_END_DISCONNECTION;
+        }
+        return UNEXPECTED_ERROR;
+    }
+
+    int taken = COMM_takeFileDigest(result.frame, md5sum);
+    FRAME_destroyFrame(result.frame);
+    if (taken < 0) {
+        STRING_printF(print_mutex, STDOUT_FILENO, RED, "ERROR: wrong frame received as the file's md5\n");
+        return UNEXPECTED_ERROR;
+    }
+    return TRANSFER_SUCCESS;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Comprobar si el MD5 de un archivo viaja dentro de su transferencia: con 
+*             `CONN_CAP_PIPELINE` y `CONN_CAP_HASH_TRAILER`, `COMM_sendFile` lo envía justo 
+*             detrás del último paquete, sin esperar sus ACK, y `COMM_receiveFile` lo 
+*             recoge, de modo que no se llama a `COMM_sendFileDigest` ni a 
+*             `COMM_retrieveFileDigest` (salvo en las transferencias por franjas o delta). 
+* 
+* @Parámetros: 
+* in: params = Parámetros acordados con el otro extremo. 
+* 
+* @Retorno: 
+*           1 = El MD5 viaja con la transferencia. 
+*           0 = Se envía y se recibe aparte. 
+* 
+************************************************/
+int COMM_hasInlineDigest(const ConnectionParams *params) {
+    return params && params->frame_version == FRAME_V2 && (params->capabilities & CONN_CAP_PIPELINE) && (params->capabilities & CONN_CAP_HASH_TRAILER);
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Añadir a unos metadatos la raíz y el tamaño de bloque del árbol de Merkle 
+*             de un archivo, si el árbol tiene algún bloque. 
+* 
+* @Parámetros: 
+* in/out: metadata = Metadatos del archivo (FILE_REQUEST o FILE_RESULT). 
+* in: merkle = Árbol del archivo, o NULL. 
+* out: root_hex = Buffer donde se escribe la raíz en hexadecimal. Los metadatos apuntan a 
+*                 él, así que debe existir hasta que se codifiquen. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void COMM_setMerkleMetadata(Metadata *metadata, const MerkleTree *merkle, char root_hex[HASH_MD5_HEX_SIZE]) {
+    if (!merkle || merkle->n_chunks == 0) return;
+
+    MERKLE_rootToHex(merkle, root_hex);
+    METADATA_setString(metadata, METADATA_MERKLE_ROOT, root_hex);
+    METADATA_setNumber(metadata, METADATA_MERKLE_CHUNK, merkle->chunk_size);
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Preparar el árbol de Merkle del archivo que se va a recibir con la raíz y el 
+*             tamaño de bloque de sus metadatos. 
+* 
+* @Parámetros: 
+* in: metadata = Metadatos del archivo. 
+* out: merkle = Árbol a preparar. Se libera el anterior y queda vacío si no hay raíz. 
+* in: file_size = Tamaño del archivo en bytes. 
+* 
+* @Retorno: 
+*           1 = Árbol preparado; sus hojas llegarán en tramas 0x15. 
+*           0 = Los metadatos no llevan raíz. 
+*          -1 = La raíz o el tamaño de bloque no son válidos. 
+* 
+************************************************/
+int COMM_getMerkleMetadata(const Metadata *metadata, MerkleTree *merkle, off_t file_size) {
+    MERKLE_free(merkle);
+    if (!METADATA_has(metadata, METADATA_MERKLE_ROOT)) return 0;
+
+    if (MERKLE_setRoot(merkle, METADATA_getString(metadata, METADATA_MERKLE_ROOT), METADATA_getNumber(metadata, METADATA_MERKLE_CHUNK, 0), file_size) < 0) return -1;
+    return merkle->n_chunks > 0 ? 1 : 0;
+}
+
 /*********************************************** 
 * 
-* @Finalidad: Recibir y procesar una trama de reconocimiento (ACK) desde un socket, 
-*             verificando posibles errores o desconexiones. 
+* @Finalidad: Enviar las hojas del árbol de Merkle de un archivo (el MD5 de cada bloque) en 
+*             tramas 0x15 de como mucho `params->data_size` bytes, para que el receptor 
+*             pueda comprobar cada bloque en cuanto lo tenga entero. 
 * 
 * @Parámetros: 
-* in: socket = Descriptor del socket desde el cual se espera recibir la trama ACK. 
+* in: socket = Descriptor del socket por el que se enviará el archivo. 
+* in: merkle = Árbol calculado con `MERKLE_build`. 
+* in: params = Parámetros acordados con el otro extremo (tramas v2). 
 * 
 * @Retorno: 
-*           TRANSFER_SUCCESS = La trama ACK fue recibida y procesada correctamente. 
-*           REMOTE_END_DISCONNECTION = El extremo remoto se desconectó. 
-*           UNEXPECTED_ERROR = Error inesperado al recibir la trama. 
+*           0 = Hojas enviadas. 
+*          -1 = Error al crear o enviar una trama. 
 * 
 ************************************************/
-int COMM_retrieveAckFrame(int socket) {
-    int error = UNEXPECTED_ERROR;
-    FrameResult ack_frame = FRAME_receiveFrame(socket);
-    if (ack_frame.error_code != FRAME_SUCCESS) {
-        if(ack_frame.error_code == FRAME_DISCONNECTED) {
-            error = REMOTE_END_DISCONNECTION; 
+int COMM_sendMerkleLeaves(int socket, const MerkleTree *merkle, const ConnectionParams *params) {
+    size_t length = (size_t)merkle->n_chunks * MERKLE_DIGEST_SIZE;
+    size_t piece = params->data_size - params->data_size % MERKLE_DIGEST_SIZE;
+
+    for (size_t sent = 0; sent < length; sent += piece) {
+        size_t size = length - sent < piece ? length - sent : piece;
+        Frame *frame = FRAME_createFrame(0x15, (const char *)merkle->leaves + sent, size);
+        if (!frame) return -1;
+
+        int result = FRAME_sendFrameWithParams(socket, frame, params);
+        FRAME_destroyFrame(frame);
+        if (result < 0) return -1;
+    }
+    return 0;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Recibir las hojas del árbol de Merkle de un archivo (tramas 0x15) y 
+*             comprobar que llevan a la raíz recibida en sus metadatos. 
+* 
+* @Parámetros: 
+* in/out: reader = Lector con buffer de la conexión por la que llegará el archivo. 
+* in/out: merkle = Árbol preparado con `COMM_getMerkleMetadata`. Se le guardan las hojas. 
+* in: process = Indica si se está comunicando con un worker o un fleck (e.g., `FLECK`). 
+* in: print_mutex = Mutex para sincronizar los mensajes de impresión. 
+* 
+* @Retorno: 
+*           TRANSFER_SUCCESS = Hojas recibidas y comprobadas. 
+*           REMOTE_END_DISCONNECTION = El extremo remoto se desconectó antes de enviarlas. 
+*           UNEXPECTED_ERROR = Trama incorrecta, hojas que no llevan a la raíz o error de memoria. 
+* 
+************************************************/
+int COMM_retrieveMerkleLeaves(FrameReader *reader, MerkleTree *merkle, int process, pthread_mutex_t *print_mutex) {
+    size_t length = (size_t)merkle->n_chunks * MERKLE_DIGEST_SIZE;
+    size_t received = 0;
+    uint8_t *leaves = (uint8_t *)malloc(length);
+    if (!leaves) return UNEXPECTED_ERROR;
+
+    while (received < length) {
+        FrameResult result = FRAME_readerReceiveFrame(reader);
+        if (result.error_code != FRAME_SUCCESS) {
+            if (result.frame) FRAME_destroyFrame(result.frame);
+            free(leaves);
+            if (result.error_code == FRAME_DISCONNECTED) {
+                STRING_printF(print_mutex, STDOUT_FILENO, RED, "%s disconnected while sending the file's chunk hashes\n", process == FLECK ? "Worker" : "Fleck");
+                return REMOTE_END_DISCONNECTION;
+            }
+            return UNEXPECTED_ERROR;
         }
-        if (ack_frame.frame) FRAME_destroyFrame(ack_frame.frame);
-        return error; 
+
+        Frame *leaves_frame = result.frame;
+        if (leaves_frame->type != 0x15 || leaves_frame->data_length > length - received) {
+            STRING_printF(print_mutex, STDOUT_FILENO, RED, "ERROR: wrong frame received as the file's chunk hashes\n");
+            FRAME_destroyFrame(leaves_frame);
+            free(leaves);
+            return UNEXPECTED_ERROR;
+        }
+        memcpy(leaves + received, leaves_frame->data, leaves_frame->data_length);
+        received += leaves_frame->data_length;
+        FRAME_destroyFrame(leaves_frame);
     }
 
-    FRAME_destroyFrame(ack_frame.frame);
+    int valid = MERKLE_setLeaves(merkle, leaves, length) == 0;
+    free(leaves);
+    if (!valid) {
+        STRING_printF(print_mutex, STDOUT_FILENO, RED, "ERROR: the file's chunk hashes do not match its Merkle root\n");
+        return UNEXPECTED_ERROR;
+    }
     return TRANSFER_SUCCESS;
 }
 
 /*********************************************** 
 * 
-* @Finalidad: Crear y enviar una trama de reconocimiento (ACK) a través de un socket especificado. 
+* @Finalidad: Enviar la signatura de la versión anterior de un archivo que conserva este 
+*             extremo: el tamaño de la versión y de sus bloques (trama 0x17) y la 
+*             signatura de cada bloque en tramas 0x18 de como mucho `params->data_size` 
+*             bytes, para que el emisor solo envíe lo que ha cambiado. 
 * 
 * @Parámetros: 
-* in: socket = Descriptor del socket a través del cual se enviará la trama ACK. 
+* in: socket = Descriptor del socket por el que llegará el archivo. 
+* in: signature = Signatura calculada con `DELTA_buildSignature`. 
+* in: params = Parámetros acordados con el otro extremo (tramas v2). 
 * 
 * @Retorno: 
-*           TRANSFER_SUCCESS = La trama ACK fue creada y enviada correctamente. 
-*           UNEXPECTED_ERROR = Error al crear o enviar la trama ACK. 
+*           0 = Signatura enviada. 
+*          -1 = Error de memoria o al enviar una trama. 
 * 
 ************************************************/
-int COMM_sendAckFrame(int socket) {
-    Frame *ack_frame = FRAME_createFrame(0x12, NULL, 0);
-    if (!ack_frame || FRAME_sendFrame(socket, ack_frame) < 0) { // Si ack_frame és NULL, el primer operand avalua CERT i no es fa el sendFrame
-        if (ack_frame) FRAME_destroyFrame(ack_frame);
-        return UNEXPECTED_ERROR;
+int COMM_sendDeltaSignature(int socket, const DeltaSignature *signature, const ConnectionParams *params) {
+    size_t length = (size_t)signature->n_blocks * DELTA_SIGNATURE_SIZE;
+    size_t piece = params->data_size - params->data_size % DELTA_SIGNATURE_SIZE;
+    Metadata metadata;
+
+    METADATA_init(&metadata);
+    METADATA_setNumber(&metadata, METADATA_FILE_SIZE, (uint32_t)signature->basis_size);
+    METADATA_setNumber(&metadata, METADATA_DELTA_BLOCK, signature->block_size);
+    if (COMM_sendMetadata(socket, 0x17, &metadata, METADATA_MSG_DELTA_BASIS, params) < 0) return -1;
+    if (length == 0) return 0;
+
+    uint8_t *data = (uint8_t *)malloc(length);
+    if (!data) return -1;
+    DELTA_packSignature(signature, data);
+
+    int result = 0;
+    for (size_t sent = 0; sent < length && result == 0; sent += piece) {
+        size_t size = length - sent < piece ? length - sent : piece;
+        Frame *frame = FRAME_createFrame(0x18, (const char *)data + sent, size);
+        if (!frame) {
+            result = -1;
+            break;
+        }
+        result = FRAME_sendFrameWithParams(socket, frame, params) < 0 ? -1 : 0;
+        FRAME_destroyFrame(frame);
     }
-    FRAME_destroyFrame(ack_frame);
-    return TRANSFER_SUCCESS;
+    free(data);
+    return result;
 }
 
+
 /*********************************************** 
 * 
-* @Finalidad: Enviar un archivo al worker o fleck en paquetes, utilizando un socket especificado. 
-*             Maneja la confirmación (ACK) después de cada paquete y permite la reanudación 
-*             en caso de interrupción. 
+* @Finalidad: Recibir la signatura de la versión anterior de un archivo que conserva el 
+*             receptor (tramas 0x17 y 0x18) y preparar la búsqueda de sus bloques. 
 * 
 * @Parámetros: 
-* in: file_path = Ruta completa del archivo a enviar. 
-* in: filename = Nombre del archivo que se está enviando. 
-* in: n_packets = Número total de paquetes en que está dividido el archivo. 
-* in/out: n_processed_packets = Puntero al número de paquetes procesados hasta el momento. 
-* in: worker_socket = Descriptor del socket utilizado para enviar los paquetes. 
-* in: exit_distortion = Bandera que indica si se debe interrumpir el proceso de envío. 
+* in/out: reader = Lector con buffer de la conexión por la que se enviará el archivo. 
+* out: signature = Signatura recibida. Se libera la anterior. 
 * in: process = Indica si se está comunicando con un worker o un fleck (e.g., `FLECK`). 
 * in: print_mutex = Mutex para sincronizar los mensajes de impresión. 
 * 
 * @Retorno: 
-*           TRANSFER_SUCCESS = El archivo fue enviado con éxito. 
-*           REMOTE_END_DISCONNECTION = El extremo remoto (worker o fleck) se desconectó. 
-*           UNEXPECTED_ERROR = Ocurrió un error durante la lectura o envío del archivo. 
-*           INTERRUPTED_BY_SIGINT = El envío fue interrumpido por una señal SIGINT. 
+*           TRANSFER_SUCCESS = Signatura recibida. 
+*           REMOTE_END_DISCONNECTION = El extremo remoto se desconectó antes de enviarla. 
+*           UNEXPECTED_ERROR = Trama incorrecta, tamaños no válidos o error de memoria. 
 * 
 ************************************************/
-int COMM_sendFile(char* file_path, char* filename, int n_packets, int* n_processed_packets, int worker_socket, volatile int* exit_distortion, int process, pthread_mutex_t *print_mutex) {
-    int ack_result = TRANSFER_SUCCESS; 
-
-    int fd = open(file_path, O_RDONLY);
-    if (fd < 0) {
+int COMM_retrieveDeltaSignature(FrameReader *reader, DeltaSignature *signature, int process, pthread_mutex_t *print_mutex) {
+    Metadata metadata;
+    FrameResult result = FRAME_readerReceiveFrame(reader);
+    if (result.error_code != FRAME_SUCCESS) {
+        if (result.frame) FRAME_destroyFrame(result.frame);
+        if (result.error_code == FRAME_DISCONNECTED) {
+            STRING_printF(print_mutex, STDOUT_FILENO, RED, "%s disconnected while sending its copy's block hashes\n", process == FLECK ? "Worker" : "Fleck");
+            return REMOTE_END_DISCONNECTION;
+        }
         return UNEXPECTED_ERROR;
     }
 
-    // Ens posicionem al lloc correcte segons l'últim paquet enviat 
-    off_t offset = *n_processed_packets * DATA_SIZE;
-    if (lseek(fd, offset, SEEK_SET) < 0) {
-        close(fd);
+    // La mida de bloc es valida abans de reservar res, ja que d'ella depèn quants blocs arriben
+    Frame *basis_frame = result.frame;
+    int valid = basis_frame->type == 0x17 && METADATA_decode(basis_frame->data, basis_frame->data_length, METADATA_MSG_DELTA_BASIS, &metadata) == 0;
+    off_t basis_size = valid ? (off_t)METADATA_getNumber(&metadata, METADATA_FILE_SIZE, 0) : 0;
+    uint32_t block_size = valid ? METADATA_getNumber(&metadata, METADATA_DELTA_BLOCK, 0) : 0;
+    FRAME_destroyFrame(basis_frame);
+    if (!valid || block_size < DELTA_MIN_BLOCK_SIZE || block_size > DELTA_MAX_BLOCK_SIZE) {
+        STRING_printF(print_mutex, STDOUT_FILENO, RED, "ERROR: wrong frame received as the previous copy's block hashes\n");
         return UNEXPECTED_ERROR;
     }
 
-    char buffer[DATA_SIZE];
-    int bytes_read = 0;
+    size_t length = (size_t)((basis_size + block_size - 1) / block_size) * DELTA_SIGNATURE_SIZE;
+    size_t received = 0;
+    uint8_t *data = (uint8_t *)malloc(length > 0 ? length : 1);
+    if (!data) return UNEXPECTED_ERROR;
 
-    // Mentre el nombre de paquets enviats sigui menor al nombre de paquets totals enviem paquets al worker
-    while (*n_processed_packets < n_packets && !*(exit_distortion)) {
-        bytes_read = read(fd, buffer, DATA_SIZE);
-        if (bytes_read < 0) {
-            STRING_printF(print_mutex, STDOUT_FILENO, RED, "ERROR: failed to read file %s\n", filename);
-            close(fd);
+    while (received < length) {
+        result = FRAME_readerReceiveFrame(reader);
+        if (result.error_code != FRAME_SUCCESS) {
+            if (result.frame) FRAME_destroyFrame(result.frame);
+            free(data);
+            if (result.error_code == FRAME_DISCONNECTED) {
+                STRING_printF(print_mutex, STDOUT_FILENO, RED, "%s disconnected while sending its copy's block hashes\n", process == FLECK ? "Worker" : "Fleck");
+                return REMOTE_END_DISCONNECTION;
+            }
             return UNEXPECTED_ERROR;
-        } else if (bytes_read == 0) {
-            break; // Fi del fitxer (no hauriem d'arribar si la segmentació del fitxer en paquets és correcta)
         }
 
-        // Crear i enviar la trama al worker
-        Frame *packet_frame = FRAME_createFrame(0x05, buffer, bytes_read); 
-        if (!packet_frame || FRAME_sendFrame(worker_socket, packet_frame) < 0) { // Si packet_frame és NULL el primer operand avalua CERT i per tant no s'arriba a enviar la trama
-            if (packet_frame) FRAME_destroyFrame(packet_frame);
-            close(fd);
+        Frame *signature_frame = result.frame;
+        if (signature_frame->type != 0x18 || signature_frame->data_length > length - received) {
+            STRING_printF(print_mutex, STDOUT_FILENO, RED, "ERROR: wrong frame received as the previous copy's block hashes\n");
+            FRAME_destroyFrame(signature_frame);
+            free(data);
             return UNEXPECTED_ERROR;
         }
+        memcpy(data + received, signature_frame->data, signature_frame->data_length);
+        received += signature_frame->data_length;
+        FRAME_destroyFrame(signature_frame);
+    }
+
+    int loaded = DELTA_setSignature(signature, basis_size, block_size, data, length) == 0;
+    free(data);
+    return loaded ? TRANSFER_SUCCESS : UNEXPECTED_ERROR;
+}
+
+
+/*********************************************** 
+* 
+* @Finalidad: Enviar un archivo como delta respecto a la versión anterior que conserva el 
+*             receptor, en tramas 0x19 de operaciones (copias de bloques de esa versión y 
+*             bytes literales) que se generan a medida que se recorre el archivo. Una trama 
+*             0x19 vacía indica el final. El MD5 del archivo se completa en la misma pasada. 
+* 
+* @Parámetros: 
+* in: file_path = Ruta completa del archivo a enviar. 
+* in: filename = Nombre del archivo, para los mensajes. 
+* in: signature = Signatura de la versión anterior recibida con `COMM_retrieveDeltaSignature`. 
+* in/out: hash = MD5 incremental del archivo, o NULL. 
+* in: worker_socket = Descriptor del socket utilizado para enviar el delta. 
+* in: params = Parámetros acordados con el otro extremo (tramas v2 y compresión). 
+* in/out: pool = Pool de tramas de la conexión. 
+* in: exit_distortion = Bandera que indica si se debe interrumpir el proceso de envío. 
+* in: process = Indica si se está comunicando con un worker o un fleck (e.g., `FLECK`). 
+* in: print_mutex = Mutex para sincronizar los mensajes de impresión. 
+* 
+* @Retorno: 
+*           TRANSFER_SUCCESS = El delta fue enviado con éxito. 
+*           REMOTE_END_DISCONNECTION = El extremo remoto se desconectó. 
+*           UNEXPECTED_ERROR = Error al leer el archivo o al enviar una trama. 
+*           INTERRUPTED_BY_SIGINT = El envío fue interrumpido por una señal SIGINT. 
+* 
+************************************************/
+int COMM_sendFileDelta(char* file_path, char* filename, const DeltaSignature *signature, FileHash *hash, int worker_socket, const ConnectionParams *params, FramePool *pool, volatile int* exit_distortion, int process, pthread_mutex_t *print_mutex) {
+    int result = TRANSFER_SUCCESS;
+    int compress = params->capabilities & CONN_CAP_COMPRESSION;
+    int n_frames = compress ? 2 : 1;    // Amb compressió les operacions es generen a la segona trama i es comprimeixen a la primera
+    Frame *frames[2] = {NULL, NULL};
+    int n_acquired = 0;
+    uint8_t *mapped = NULL;
+    unsigned long long bytes_sent = 0;
+    DeltaEncoder encoder;
 
-        FRAME_destroyFrame(packet_frame); 
+    int fd = open(file_path, O_RDONLY);
+    if (fd < 0) return UNEXPECTED_ERROR;
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) < 0) {
+        close(fd);
+        return UNEXPECTED_ERROR;
+    }
 
-        // Esperar heartbeat del worker a mode d'ACK
-        ack_result = COMM_retrieveAckFrame(worker_socket);
-        if(ack_result == REMOTE_END_DISCONNECTION || ack_result == UNEXPECTED_ERROR) {
-            if(ack_result == REMOTE_END_DISCONNECTION) STRING_printF(print_mutex, STDOUT_FILENO, RED, "%s crashed while receiving file %s\n", process == FLECK ? "Worker" : "Fleck", filename);
+    // El fitxer es recorre byte a byte buscant els blocs de la versió anterior, així que el projectem sencer en memòria
+    if (file_stat.st_size > 0) {
+        mapped = mmap(NULL, (size_t)file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
             close(fd);
-            return ack_result; // Retornem WORKER DOWN si el worker ha caigut i UNEXPECTED_ERROR si ha ahgut un error en deserialitzar la trama
+            return UNEXPECTED_ERROR;
         }
+        madvise(mapped, (size_t)file_stat.st_size, MADV_SEQUENTIAL);
+    }
 
-        // resposta del worker és correcta, actualitzem l'últim paquet enviat
-        (*n_processed_packets)++;
+    if (FRAME_reservePool(pool, params->data_size, n_frames) < 0) {
+        result = UNEXPECTED_ERROR;
+        goto end_delta;
+    }
+    while (n_acquired < n_frames && (frames[n_acquired] = FRAME_acquireFrame(pool)) != NULL) n_acquired++;
+    if (n_acquired < n_frames) {
+        result = UNEXPECTED_ERROR;
+        goto end_delta;
     }
 
-    // Tanquem file descriptor del fitxer que hem llegit
-    close(fd);
+    DELTA_initEncoder(&encoder, signature, mapped, file_stat.st_size);
+    while (!*(exit_distortion)) {
+        Frame *ops = frames[n_frames - 1];
+        size_t length = DELTA_nextOps(&encoder, ops->data, params->data_size);
+
+        // Una trama sense operacions indica al receptor que el delta s'ha acabat
+        if (compress) {
+            FRAME_fillFrameCompressed(frames[0], 0x19, ops->data, length);
+        } else {
+            FRAME_fillFrame(frames[0], 0x19, NULL, length);
+        }
+        SHAPER_acquire(params->shaper, SHAPER_EGRESS, frames[0]->data_length, exit_distortion);
+        if (FRAME_sendFrames(worker_socket, frames, 1, params, 0) < 0) {
+            result = (errno == EPIPE || errno == ECONNRESET) ? REMOTE_END_DISCONNECTION : UNEXPECTED_ERROR;
+            if (result == REMOTE_END_DISCONNECTION) STRING_printF(print_mutex, STDOUT_FILENO, RED, "%s crashed while receiving file %s\n", process == FLECK ? "Worker" : "Fleck", filename);
+            goto end_delta;
+        }
+        bytes_sent += frames[0]->data_length;
 
-    if(*exit_distortion) {
+        // El MD5 avança fins on ha arribat el recorregut, amb les pàgines del fitxer encara a memòria
+        if (hash && HASH_advance(hash, fd, mapped, encoder.position) < 0) {
+            result = UNEXPECTED_ERROR;
+            goto end_delta;
+        }
+        if (length == 0) break;
+    }
+
+    if (*(exit_distortion)) {
         STRING_printF(print_mutex, STDOUT_FILENO, RED, "Exiting send method because of sigint\n");
-        return INTERRUPTED_BY_SIGINT; 
-    } else {
+        result = INTERRUPTED_BY_SIGINT;
+    } else if (!COMM_showStatistics()) {
         STRING_printF(print_mutex, STDOUT_FILENO, GREEN, "Successfully sent distorted file to %s\n", process == FLECK ? "Worker" : "Fleck");
-        return TRANSFER_SUCCESS; 
+    } else {
+        STRING_printF(print_mutex, STDOUT_FILENO, GREEN, "Successfully sent %s as a delta: %lld bytes reused from the %s's previous copy, %lld new bytes, %llu bytes sent (%.1f%% of the file)\n", filename, (long long)encoder.copied_bytes, process == FLECK ? "worker" : "fleck", (long long)encoder.literal_bytes, bytes_sent, file_stat.st_size > 0 ? bytes_sent * 100.0 / file_stat.st_size : 0.0);
     }
+
+end_delta:
+    COMM_releaseFrames(pool, frames, n_acquired);
+    if (mapped) munmap(mapped, (size_t)file_stat.st_size);
+    close(fd);
+    return result;
 }
 
+
 /*********************************************** 
 * 
-* @Finalidad: Recibir un archivo desde un worker o fleck en paquetes a través de un socket, 
-*             confirmando la recepción de cada paquete y escribiendo los datos en un archivo local. 
+* @Finalidad: Recibir un archivo enviado como delta (tramas 0x19) y reconstruirlo a partir 
+*             de la versión anterior que conserva este extremo. El MD5 del archivo se 
+*             calcula a medida que se reconstruye, con los bytes aún en la memoria caché. 
 * 
 * @Parámetros: 
-* in: file_path = Ruta completa del archivo donde se escribirán los datos recibidos. 
-* in: filename = Nombre del archivo que se está recibiendo. 
-* in: n_packets = Número total de paquetes esperados. 
-* in/out: n_processed_packets = Puntero al número de paquetes procesados hasta el momento. 
-* in: worker_socket = Descriptor del socket utilizado para recibir los paquetes. 
+* in: file_path = Ruta completa donde se reconstruye el archivo. 
+* in: basis_path = Ruta de la versión anterior del archivo. 
+* in: filename = Nombre del archivo, para los mensajes. 
+* in: file_size = Tamaño del archivo nuevo en bytes. 
+* in: signature = Signatura de la versión anterior enviada con `COMM_sendDeltaSignature`. 
+* in/out: hash = MD5 incremental del archivo (vacío), o NULL. 
+* in: params = Parámetros acordados con el otro extremo (tramas v2). 
+* in/out: pool = Pool de tramas de la conexión. 
+* in/out: reader = Lector con buffer de la conexión por la que llega el delta. 
 * in: exit_distortion = Bandera que indica si se debe interrumpir el proceso de recepción. 
 * in: process = Indica si se está comunicando con un worker o un fleck (e.g., `FLECK`). 
 * in: print_mutex = Mutex para sincronizar los mensajes de impresión. 
 * 
 * @Retorno: 
-*           TRANSFER_SUCCESS = El archivo fue recibido con éxito. 
-*           REMOTE_END_DISCONNECTION = El extremo remoto (worker o fleck) se desconectó durante la transmisión. 
-*           UNEXPECTED_ERROR = Ocurrió un error durante la recepción o escritura del archivo. 
+*           TRANSFER_SUCCESS = El archivo fue reconstruido con éxito. 
+*           REMOTE_END_DISCONNECTION = El extremo remoto se desconectó durante la transmisión. 
+*           UNEXPECTED_ERROR = Delta mal formado, versión anterior cambiada o error de escritura. 
 *           INTERRUPTED_BY_SIGINT = La recepción fue interrumpida por una señal SIGINT. 
 * 
 ************************************************/
-int COMM_receiveFile(char* file_path, char* filename, int n_packets, int* n_processed_packets, int worker_socket, volatile int* exit_distortion, int process, pthread_mutex_t *print_mutex) {
-    int unexpected_error = 1;
+int COMM_receiveFileDelta(char* file_path, char* basis_path, char* filename, int file_size, const DeltaSignature *signature, FileHash *hash, const ConnectionParams *params, FramePool *pool, FrameReader *reader, volatile int* exit_distortion, int process, pthread_mutex_t *print_mutex) {
+    int result = TRANSFER_SUCCESS;
+    DeltaPatch patch;
+    Frame *frame = NULL;
+    int finished = 0;
 
-    // Obrim el fitxer en mode escriptura (per worker ens interessa flag d'append pero per fleck no ja que volem sobreescriure el contingut del fitxer original)
-    int fd = open(file_path, O_WRONLY | O_CREAT, 0666);
-    if (fd < 0) {
-        STRING_printF(print_mutex, STDOUT_FILENO, MAGENTA, "ERROR: failed to open file %s\n", filename);
+    if (DELTA_openPatch(&patch, basis_path, file_path, (off_t)file_size, signature) < 0) {
+        STRING_printF(print_mutex, STDOUT_FILENO, MAGENTA, "ERROR: failed to open %s or its previous copy\n", filename);
         return UNEXPECTED_ERROR;
     }
-
-    // Ens posicionem al lloc correcte segons l'últim paquet rebut
-    off_t offset = *n_processed_packets * DATA_SIZE;
-    if (lseek(fd, offset, SEEK_SET) < 0) {
-        close(fd);
+    if (FRAME_reservePool(pool, params->data_size, 1) < 0 || !(frame = FRAME_acquireFrame(pool))) {
+        DELTA_closePatch(&patch);
         return UNEXPECTED_ERROR;
     }
 
-    // Mentre no haguem rebut tots els paquets, continuem processant
-    while (*n_processed_packets < n_packets && !*(exit_distortion)) {
-        // Rebem la trama del worker
-        FrameResult result = FRAME_receiveFrame(worker_socket);
-        if (result.error_code != FRAME_SUCCESS) {
-            if (result.error_code == FRAME_DISCONNECTED) {
+    while (!finished && !*(exit_distortion)) {
+        FrameErrorCode error_code = FRAME_readerReceiveFrameInto(reader, frame);
+        if (error_code != FRAME_SUCCESS) {
+            result = UNEXPECTED_ERROR;
+            if (error_code == FRAME_DISCONNECTED) {
                 STRING_printF(print_mutex, STDOUT_FILENO, RED, "%s disconnected while sending file %s\n", process == FLECK ? "Worker" : "Fleck", filename);
-                unexpected_error = 0;
+                result = REMOTE_END_DISCONNECTION;
             }
-            if (result.frame) FRAME_destroyFrame(result.frame);
-            close(fd);
-            return unexpected_error ? UNEXPECTED_ERROR : REMOTE_END_DISCONNECTION;
-        }
-
-        Frame *packet_frame = result.frame;
-
-        // Si el tipus de trama rebut no és correcte abortem amb codi d'error
-        if (packet_frame->type != 0x05) {
-            FRAME_destroyFrame(packet_frame);
-            close(fd);
-            return UNEXPECTED_ERROR;
+            break;
         }
+        SHAPER_acquire(params->shaper, SHAPER_INGRESS, frame->data_length, exit_distortion);
 
-        // Escrivim les dades del paquet al fitxer
-        if (write(fd, packet_frame->data, packet_frame->data_length) < 0) {
-            FRAME_destroyFrame(packet_frame);
-            close(fd);
-            return UNEXPECTED_ERROR;
+        // Cada trama porta operacions senceres; la trama buida tanca el delta
+        if (frame->type != 0x19 || (frame->data_length > 0 && DELTA_applyOps(&patch, frame->data, frame->data_length) < 0)) {
+            STRING_printF(print_mutex, STDOUT_FILENO, RED, "ERROR: invalid delta received for file %s\n", filename);
+            result = UNEXPECTED_ERROR;
+            break;
         }
+        finished = frame->data_length == 0;
 
-        FRAME_destroyFrame(packet_frame);
-
-        // Confirmem la recepció al worker enviant-li un heartbeat a mode d'ACK
-        if(COMM_sendAckFrame(worker_socket) != TRANSFER_SUCCESS) {
-            close(fd);
-            return UNEXPECTED_ERROR; 
+        // Resumim el que s'acaba de reconstruir mentre encara és a la memòria cau
+        if (hash && HASH_advance(hash, patch.target_fd, NULL, patch.offset) < 0) {
+            result = UNEXPECTED_ERROR;
+            break;
         }
+    }
 
-        // Actualitzem el nombre de paquets processats
-        (*n_processed_packets)++;
+    FRAME_releaseFrame(pool, frame);
+    off_t literal_bytes = patch.literal_bytes, copied_bytes = patch.copied_bytes;
+    if (DELTA_closePatch(&patch) < 0 && result == TRANSFER_SUCCESS && finished) {
+        STRING_printF(print_mutex, STDOUT_FILENO, RED, "ERROR: the delta received for file %s is incomplete\n", filename);
+        result = UNEXPECTED_ERROR;
     }
+    if (result != TRANSFER_SUCCESS) return result;
 
-    // Tanquem el fitxer i alliberem recursos
-    close(fd);
-    
-    if(*exit_distortion) {
+    if (*(exit_distortion)) {
         STRING_printF(print_mutex, STDOUT_FILENO, RED, "Exiting receive method because of sigint\n");
-        return INTERRUPTED_BY_SIGINT; 
-    } else {
+        return INTERRUPTED_BY_SIGINT;
+    }
+    if (!COMM_showStatistics()) {
         STRING_printF(print_mutex, STDOUT_FILENO, GREEN, "Successfully received %s's file\n", process == FLECK ? "Worker" : "Fleck");
-        return TRANSFER_SUCCESS; 
-    }    
+        return TRANSFER_SUCCESS;
+    }
+    STRING_printF(print_mutex, STDOUT_FILENO, GREEN, "Successfully rebuilt %s's file from a delta (%lld bytes reused from the previous copy, %lld bytes received)\n", process == FLECK ? "Worker" : "Fleck", (long long)copied_bytes, (long long)literal_bytes);
+    return TRANSFER_SUCCESS;
 }
 
 /*********************************************** 
 * 
-* @Finalidad: Crear y enviar una trama de comprobación MD5 a través de un socket, 
-*             utilizando el tipo de trama y contenido especificado. 
+* @Finalidad: Codificar y enviar un mensaje de metadatos de control. Si la conexión ha 
+*             acordado tramas v2 el mensaje se codifica en binario (TLV) y se envía en 
+*             una trama v2, sin el límite de `DATA_SIZE`; si no, se codifica como texto 
+*             con '&' en una trama v1 para que los peers antiguos lo entiendan. 
 * 
 * @Parámetros: 
-* in: client_socket = Descriptor del socket al que se enviará la trama. 
-* in: type = Tipo de trama que se enviará (por ejemplo, para indicar éxito o fallo en la verificación MD5). 
-* in: string = Cadena que contiene el contenido de la trama (e.g., resultado de la verificación MD5). 
+* in: socket = Descriptor del socket por el que se enviará el mensaje. 
+* in: type = Tipo de la trama. 
+* in: metadata = Campos del mensaje. 
+* in: message = Mensaje del esquema de metadatos. 
+* in: params = Parámetros acordados con el otro extremo (NULL si todavía no hay acuerdo). 
 * 
 * @Retorno: 
-*           0 = La trama fue enviada con éxito. 
-*          -1 = Error al enviar la trama. 
+*           0 = Mensaje enviado correctamente. 
+*          -1 = Falta un campo obligatorio, el mensaje no cabe en una trama o error al enviarlo. 
 * 
 ************************************************/
-int COMM_sendMD5CheckFrame (int client_socket, int type, char* string) {
-    int send_success = 0;
-    Frame* check_frame = FRAME_createFrame(type, string, strlen(string)); 
-    if(FRAME_sendFrame(client_socket, check_frame) < 0) send_success = -1;
-    FRAME_destroyFrame(check_frame);
-    return send_success; 
+int COMM_sendMetadata(int socket, int type, const Metadata *metadata, MetadataMessage message, const ConnectionParams *params) {
+    uint8_t data[METADATA_MAX_SIZE];
+    int binary = params && params->frame_version == FRAME_V2;
+
+    long length = METADATA_encode(metadata, message, binary ? METADATA_BINARY : METADATA_TEXT, data, sizeof(data));
+    //en text el missatge ha de cabre en una trama v1, si no el peer antic el rebria truncat
+    if (length < 0 || (!binary && length > DATA_SIZE)) return -1;
+
+    Frame *frame = FRAME_createFrame(type, (const char *)data, (size_t)length);
+    if (!frame) return -1;
+
+    int result = FRAME_sendFrameWithParams(socket, frame, binary ? params : NULL);
+    FRAME_destroyFrame(frame);
+    return result;
 }
 
 /*********************************************** 
 * 
-* @Finalidad: Verificar la integridad de un archivo mediante la comparación de su hash MD5 
-*             con el esperado, y enviar el resultado al worker a través de un socket. 
+* @Finalidad: Crear y enviar una respuesta de conexión a un cliente (fleck o worker) a través de un socket. 
+*             La respuesta puede indicar éxito o error, dependiendo de la validez de la solicitud. 
 * 
 * @Parámetros: 
-* in: file_path = Ruta completa del archivo cuya integridad se verificará. 
-* in: md5sum = Hash MD5 esperado del archivo. 
-* in: worker_socket = Descriptor del socket utilizado para enviar el resultado de la verificación. 
-* in: print_mutex = Mutex para sincronizar los mensajes de impresión. 
+* in: client_socket = Descriptor del socket del cliente al que se enviará la respuesta. 
+* in: string_err = Cadena que contiene el mensaje de error en caso de respuesta no válida. 
+*                  Si es válida, esta cadena puede ser NULL. 
+* in: is_valid = Indicador de validez de la respuesta (1 para válida, 0 para no válida). 
+* in: type = Tipo de cliente (`0x01` para fleck o `0x02` para worker). 
+* in: params = Parámetros acordados con el cliente. Si la conexión es v2, la respuesta 
+*              válida lleva en binario la combinación acordada (tamaño de datos, 
+*              capacidades, checksum, hash, ventana y conexiones paralelas); si es 
+*              NULL o v1, la respuesta válida va vacía como en el protocolo original. 
 * 
-* @Retorno: 
-*           TRANSFER_SUCCESS = La integridad del archivo fue verificada exitosamente (MD5 coincide). 
-*           UNEXPECTED_ERROR = Error en la verificación o el MD5 no coincide. 
+* @Retorno: Ninguno. 
 * 
 ************************************************/
-int COMM_verifyFileIntegrity(char* file_path, char* md5sum, int worker_socket, pthread_mutex_t *print_mutex) {
-    int md5_match = FILE_compareMD5(md5sum, file_path);
- 
-    if(md5_match) {
-        // MD5 coincideix
-        if(COMM_sendMD5CheckFrame(worker_socket, 0x06, "CHECK_OK") < 0) {
-            STRING_printF(print_mutex, STDOUT_FILENO, RED, "ERROR: failed to send check frame\n");
-            return UNEXPECTED_ERROR;
-        }
-        STRING_printF(print_mutex, STDOUT_FILENO, GREEN, "Reassembled file matches the expected md5\n");
+void COMM_sendConnectionResponse(int client_socket, char* string_err, int is_valid, int type, const ConnectionParams *params) {
+    int result;
+
+    if (is_valid && params && params->frame_version == FRAME_V2) {
+        //la combinació escollida es respon amb el mateix format que una oferta
+        ConnectionOffer chosen = {params->data_size, params->capabilities, params->checksum, params->hash, params->window_size, params->stripes};
+        Metadata metadata;
+        METADATA_init(&metadata);
+        COMM_setOfferMetadata(&metadata, &chosen);
+        result = COMM_sendMetadata(client_socket, type, &metadata, METADATA_MSG_CONNECTION_RESPONSE, params);
     } else {
-        // MD5 no coincideix
-        if(COMM_sendMD5CheckFrame(worker_socket, 0x06, "CHECK_KO") < 0) {
-            STRING_printF(print_mutex, STDOUT_FILENO, RED, "ERROR: failed to send check frame\n");
-            return UNEXPECTED_ERROR;
-        }
-        STRING_printF(print_mutex, STDOUT_FILENO, RED, "ERROR: md5 mismatch between the original and reassembled file\n");
+        //un OK v1 va buit, com al protocol original
+        Frame *response_frame = is_valid ? FRAME_createFrame(type, "", 0) : FRAME_createFrame(type, string_err, strlen(string_err));
+        result = FRAME_sendFrame(client_socket, response_frame);
+        FRAME_destroyFrame(response_frame);
     }
 
-    return md5_match ? TRANSFER_SUCCESS : UNEXPECTED_ERROR; 
+    if (result < 0) {
+        if (type == 0x01) {
+            IO_printStatic(STDOUT_FILENO, RED "Failed to send connnection response frame to fleck.\n" RESET);
+        } else {
+            IO_printStatic(STDOUT_FILENO, RED "Failed to send connnection response frame to worker.\n" RESET);
+        }
+    }
 }
 
 /*********************************************** 
 * 
-* @Finalidad: Recibir y procesar la verificación MD5 desde un worker o fleck a través de un socket, 
-*             evaluando si el archivo fue reensamblado correctamente. 
+* @Finalidad: Obtener la oferta que este extremo anuncia en el handshake de una conexión: 
+*             la oferta configurada localmente y, en conexiones de loopback, la posibilidad 
+*             de omitir el checksum por trama, ya que el MD5 del archivo ya protege la 
+*             transferencia. Si el otro extremo está en esta máquina se ofrece además pasar 
+*             los datos de los ficheros por memoria compartida (`CONN_CAP_SHM`). 
+*             Si el socket es un stream de una sesión multiplexada, se mira su conexión. 
 * 
 * @Parámetros: 
-* in: worker_socket = Descriptor del socket utilizado para recibir la verificación MD5. 
-* in: process = Indica si la comunicación es con un worker o un fleck (e.g., `FLECK`). 
-* in: print_mutex = Mutex para sincronizar los mensajes de impresión. 
+* in: socket = Descriptor del socket conectado con el otro extremo. 
+* in: params = Parámetros de la conexión con la oferta configurada localmente (puede ser NULL). 
+* out: offer = Oferta que se anunciará en el handshake. 
 * 
-* @Retorno: 
-*           TRANSFER_SUCCESS = El archivo fue reensamblado correctamente (MD5 coincide). 
-*           UNEXPECTED_ERROR = Error en la verificación o el reensamblado falló. 
-*           REMOTE_END_DISCONNECTION = El extremo remoto (worker o fleck) se desconectó durante la transmisión. 
+* @Retorno: Ninguno. 
 * 
 ************************************************/
-int COMM_retrieveMD5Check(int worker_socket, int process, pthread_mutex_t *print_mutex) {
-    int unexpected_error = 1; 
-
-    // Rebem la trama del worker
-    FrameResult result = FRAME_receiveFrame(worker_socket);
-
-    // Si hi ha error en deserialitzar la trama retornem codi d'error (si caigués el worker en aquest punt es consideraria error)
-    if (result.error_code != FRAME_SUCCESS) {
-        if (result.error_code == FRAME_DISCONNECTED) {
-            STRING_printF(print_mutex, STDOUT_FILENO, RED, "%s disconnected while sending MD5 check\n", process == FLECK ? "Worker" : "Fleck");
-            unexpected_error = 0;
-        }
-        if (result.frame) FRAME_destroyFrame(result.frame);
-        return unexpected_error ? UNEXPECTED_ERROR : REMOTE_END_DISCONNECTION;
+void COMM_getLocalOffer(int socket, const ConnectionParams *params, ConnectionOffer *offer) {
+    socket = MUX_getTransport(socket);
+    if (params) {
+        *offer = params->local;
+    } else {
+        FRAME_initOffer(offer);
     }
-
-    Frame *response_frame = result.frame;
-    if (response_frame->type == 0x06) {
-        if (strncmp((char *)response_frame->data, "CHECK_OK", 8) == 0) {
-            STRING_printF(print_mutex, STDOUT_FILENO, GREEN, "%s successfully reassembled the file!\n", process == FLECK ? "Worker" : "Fleck");
-            FRAME_destroyFrame(response_frame);
-            return TRANSFER_SUCCESS;  // CHECK_OK
-        }
-        
-        if (strncmp((char *)response_frame->data, "CHECK_KO", 8) == 0) {
-            STRING_printF(print_mutex, STDOUT_FILENO, RED, "Error: %s failed to reassmble the file\n", process == FLECK ? "Worker" : "Fleck");
-            FRAME_destroyFrame(response_frame);
-            return UNEXPECTED_ERROR;  // CHECK_KO
-        }
-
-        FRAME_destroyFrame(response_frame);
-        return UNEXPECTED_ERROR;  
+    if (SOCKET_isLoopback(socket)) {
+        offer->checksums |= CONN_CHECKSUM_NONE;
+    }
+    if (SOCKET_canShareMemory(socket)) {
+        offer->capabilities |= CONN_CAP_SHM;
     }
-
-    FRAME_destroyFrame(response_frame);
-    return UNEXPECTED_ERROR;
 }
 
 /*********************************************** 
 * 
-* @Finalidad: Crear y enviar una respuesta de conexión a un cliente (fleck o worker) a través de un socket. 
-*             La respuesta puede indicar éxito o error, dependiendo de la validez de la solicitud. 
+* @Finalidad: Añadir una oferta de capacidades a un mensaje de metadatos de handshake. 
 * 
 * @Parámetros: 
-* in: client_socket = Descriptor del socket del cliente al que se enviará la respuesta. 
-* in: string_err = Cadena que contiene el mensaje de error en caso de respuesta no válida. 
-*                  Si es válida, esta cadena puede ser NULL. 
-* in: is_valid = Indicador de validez de la respuesta (1 para válida, 0 para no válida). 
-* in: type = Tipo de cliente (`0x01` para fleck o `0x02` para worker). 
+* in/out: metadata = Campos del mensaje. 
+* in: offer = Oferta a añadir. 
 * 
 * @Retorno: Ninguno. 
 * 
 ************************************************/
-void COMM_sendConnectionResponse(int client_socket, char* string_err, int is_valid, int type) {
-    Frame *response_frame;
+void COMM_setOfferMetadata(Metadata *metadata, const ConnectionOffer *offer) {
+    METADATA_setNumber(metadata, METADATA_DATA_SIZE, offer->data_size);
+    METADATA_setNumber(metadata, METADATA_CAPABILITIES, (uint32_t)offer->capabilities);
+    METADATA_setNumber(metadata, METADATA_CHECKSUMS, (uint32_t)offer->checksums);
+    METADATA_setNumber(metadata, METADATA_HASHES, (uint32_t)offer->hashes);
+    METADATA_setNumber(metadata, METADATA_WINDOW_SIZE, (uint32_t)offer->window_size);
+    METADATA_setNumber(metadata, METADATA_STRIPES, (uint32_t)offer->stripes);
+}
 
-    if (is_valid) {
-        response_frame = FRAME_createFrame(type, "", 0);
-    } else {
-        response_frame = FRAME_createFrame(type, string_err, strlen(string_err));
-    }
+/*********************************************** 
+* 
+* @Finalidad: Extraer la oferta de capacidades de un mensaje de metadatos de handshake. 
+*             Los campos que el otro extremo no anuncia (peers antiguos) quedan a 0. 
+* 
+* @Parámetros: 
+* in: metadata = Campos del mensaje recibido. 
+* out: offer = Oferta del otro extremo. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void COMM_getOfferMetadata(const Metadata *metadata, ConnectionOffer *offer) {
+    offer->data_size = METADATA_getNumber(metadata, METADATA_DATA_SIZE, 0);
+    offer->capabilities = (int)METADATA_getNumber(metadata, METADATA_CAPABILITIES, 0);
+    offer->checksums = (int)METADATA_getNumber(metadata, METADATA_CHECKSUMS, 0);
+    offer->hashes = (int)METADATA_getNumber(metadata, METADATA_HASHES, 0);
 
-    if(FRAME_sendFrame(client_socket, response_frame) < 0) {
-        if (type == 0x01) {
-            IO_printStatic(STDOUT_FILENO, RED "Failed to send connnection response frame to fleck.\n" RESET);
-        } else {
-            IO_printStatic(STDOUT_FILENO, RED "Failed to send connnection response frame to worker.\n" RESET);
-        }
-    }
+    //cap extrem envia més trames sense confirmar que CONN_MAX_WINDOW_SIZE
+    uint32_t window_size = METADATA_getNumber(metadata, METADATA_WINDOW_SIZE, 0);
+    offer->window_size = window_size > CONN_MAX_WINDOW_SIZE ? CONN_MAX_WINDOW_SIZE : (int)window_size;
 
-    FRAME_destroyFrame(response_frame);
-}
\ No newline at end of file
+    //ni les connexions paral·leles per fitxer
+    uint32_t stripes = METADATA_getNumber(metadata, METADATA_STRIPES, 0);
+    offer->stripes = stripes > CONN_MAX_STRIPES ? CONN_MAX_STRIPES : (int)stripes;
+}
@@ -22,12 +22,28 @@
 #include <string.h>   // Para strcmp, memcpy
 #include <errno.h>    // Para manejar errores con errno
 #include <stdint.h>   // Para tipos como uint8_t
+#include <sys/ioctl.h> // Para ioctl, FIONREAD
+#include <sys/stat.h> // Para fstat
+#include <sys/socket.h> // Para shutdown
+#include <pthread.h>  // Para pthread_create, pthread_join
 
 //Llibreries pròpies
 #include "../IO/io.h"
+#include "../IO/io_ring.h"
 #include "../Frame/frame.h"
 #include "../File/file.h"	
 #include "../String/string.h"
+#include "../Socket/socket.h"
+#include "../Metadata/metadata.h"
+#include "../Sack/sack.h"
+#include "../Hash/hash.h"
+#include "../Hash/merkle.h"
+#include "../Delta/delta.h"
+#include "../Congestion/congestion.h"
+#include "../Shaper/shaper.h"
+#include "../Sparse/sparse.h"
+#include "../Shm/shm.h"
+#include "../Mux/mux.h"
 
 #define FLECK  1
 #define WORKER 2
@@ -37,24 +53,134 @@
 #define TRANSFER_SUCCESS         1
 #define INTERRUPTED_BY_SIGINT    2
 
+#define COMM_ACK_INTERVAL        4      // Paquets rebuts com a màxim abans d'enviar un ACK acumulatiu
+#define COMM_SEND_BATCH_BYTES    (256 * 1024)   // Bytes de dades de fitxer que s'envien com a màxim en una sola crida a FRAME_sendFrames (el control de congestió escull quants)
+#define COMM_RING_FRAMES         8      // Trames del pool que es fan servir a la vegada amb el motor io_uring (lectures, escriptures i enviaments en curs)
+#define COMM_RING_READ           1      // Operació io_uring de lectura del fitxer (bits alts de user_data, els baixos indiquen la trama)
+#define COMM_RING_SEND           2      // Operació io_uring d'enviament d'una trama pel socket
+#define COMM_RING_RECV           3      // Operació io_uring de recepció d'ACKs al buffer del lector
+#define COMM_CHUNK_RETRY_SIZE    8      // Primer paquet i nombre de paquets (4 bytes cadascun, big endian) d'una petició de bloc corrupte (trama 0x16)
+#define COMM_SHM_WAIT_MS         100    // Mil·lisegons que s'espera l'anell de memòria compartida abans de comprovar si l'altre extrem ha caigut o s'ha d'interrompre la transferència
+
+typedef struct {
+    char *file_path;                    // Fitxer que es transfereix
+    char *filename;                     // Nom del fitxer, per als missatges
+    int file_size;                      // Mida final del fitxer (només en recepció)
+    int n_packets;                      // Paquets del fitxer sencer
+    int *n_processed_packets;           // Paquets confirmats (de forma contigua, sense ACK selectius)
+    PacketMap *received;                // Bitmap dels paquets escrits al fitxer (només en recepció)
+    const DistortionStripe *stripe;     // Franja que va per aquesta connexió (NULL = el fitxer sencer)
+    FileHash *hash;                     // MD5 incremental del fitxer (NULL si no es calcula)
+    MerkleTree *merkle;                 // Arbre del fitxer amb les fulles (només en recepció, o NULL)
+    char **md5sum;                      // MD5 segons l'emisor, si arriba darrere dels paquets (només en recepció, o NULL)
+    FramePool *pool;                    // Pool i lector de la connexió
+    FrameReader *reader;
+    volatile int *exit_distortion;
+    int process;                        // Procés amb qui es comunica (FLECK o WORKER)
+    pthread_mutex_t *print_mutex;
+} FileTransfer;             // Fitxer i estat d'una transferència per paquets, compartit per tots els motors
+
 //Funcions
 
 /*********************************************** 
 * 
-* @Finalidad: Enviar un archivo al worker o fleck en paquetes, utilizando un socket especificado. 
-*             Maneja la confirmación (ACK) después de cada paquete y permite la reanudación 
-*             en caso de interrupción. 
+* @Finalidad: Activar o desactivar las medidas que se muestran después de cada 
+*             transferencia de archivo (línea `stats on` de la configuración). Sin ellas, 
+*             la consola solo muestra los mensajes habituales. 
 * 
 * @Parámetros: 
-* in: file_path = Ruta completa del archivo a enviar. 
-* in: filename = Nombre del archivo que se está enviando. 
-* in: n_packets = Número total de paquetes en que está dividido el archivo. 
-* in/out: n_processed_packets = Puntero al número de paquetes procesados hasta el momento. 
-* in: worker_socket = Descriptor del socket utilizado para enviar los paquetes. 
-* in: exit_distortion = Bandera que indica si se debe interrumpir el proceso de envío. 
+* in: enabled = 1 para mostrar las medidas, 0 para no mostrarlas. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void COMM_setStatistics(int enabled);
+
+/*********************************************** 
+* 
+* @Finalidad: Indicar si se muestran las medidas de las transferencias (ver 
+*             `COMM_setStatistics`). 
+* 
+* @Parámetros: Ninguno. 
+* 
+* @Retorno: 
+*           1 = Se muestran las medidas. 
+*           0 = No se muestran. 
+* 
+************************************************/
+int COMM_showStatistics(void);
+
+/*********************************************** 
+* 
+* @Finalidad: Preparar la transferencia por paquetes del archivo de una distorsión, con su 
+*             progreso, su bitmap, su MD5 incremental y su árbol de Merkle, de modo que se 
+*             pueda pasar a `COMM_sendFile`, `COMM_receiveFile` o a sus versiones por 
+*             franjas. Se prepara justo antes de transferir, ya que se copian la ruta y el 
+*             número de paquetes que tiene el contexto en ese momento. 
+* 
+* @Parámetros: 
+* out: transfer = Transferencia a preparar (sin franja). 
+* in/out: context = Contexto de la distorsión, cuyo progreso se actualiza durante la transferencia. 
+* in/out: pool = Pool de tramas de la conexión. 
+* in/out: reader = Lector con buffer de la conexión. 
+* in: exit_distortion = Bandera que indica si se debe interrumpir la transferencia. 
 * in: process = Indica si se está comunicando con un worker o un fleck (e.g., `FLECK`). 
 * in: print_mutex = Mutex para sincronizar los mensajes de impresión. 
 * 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void COMM_initTransfer(FileTransfer *transfer, DistortionContext *context, FramePool *pool, FrameReader *reader, volatile int *exit_distortion, int process, pthread_mutex_t *print_mutex);
+
+/*********************************************** 
+* 
+* @Finalidad: Enviar un archivo al worker o fleck en paquetes, utilizando un socket especificado. 
+*             Mantiene hasta `window_size` paquetes en vuelo sin confirmar y avanza con los 
+*             ACK del receptor, permitiendo la reanudación en caso de interrupción. 
+*             Los paquetes que caben en la ventana se leen del archivo con un solo `preadv` y 
+*             se envían con un solo `writev` (hasta `COMM_SEND_BATCH_BYTES` por lote). Si la 
+*             conexión ha acordado `CONN_CAP_COMPRESSION`, los paquetes compresibles se 
+*             envían comprimidos. Si ha acordado `CONN_CAP_SACK`, cada paquete lleva su offset, 
+*             el receptor indica primero qué paquetes ya tiene y solo se envían los que faltan. 
+*             Con paquetes grandes sin compresión (`FRAME_canSendFileFrames`) los datos no 
+*             pasan por memoria de usuario: van del archivo al socket con `sendfile`. 
+*             Si la configuración escoge `CONN_IO_URING` y el kernel lo permite, la lectura 
+*             del archivo, el envío y la recepción de los ACK se hacen con io_uring sobre las 
+*             tramas del pool registradas, en paralelo entre ellas. Con ACK selectivos se 
+*             puede enviar solo una franja del archivo (e.g., desde `COMM_sendFileStriped`) y, 
+*             si el receptor pide de nuevo un bloque corrupto (trama 0x16), sus paquetes se 
+*             reenvían después de los que aún no se habían enviado. Con `CONN_CAP_SPARSE`, 
+*             los paquetes con bloques enteros de un mismo byte (e.g., silencio o relleno) 
+*             salen codificados como una lista de tramos más el resto de bytes (trama 0x1A). 
+*             Con el receptor en la misma máquina (`CONN_CAP_SHM`, sin franjas) los paquetes 
+*             que faltan pasan por un anillo de memoria compartida (`SHM_reserve`) y por el 
+*             socket solo va el nombre del segmento y un único ACK; los que no lleguen bien 
+*             se envían después por el socket. Con `CONN_CAP_PIPELINE` (sin franjas ni 
+*             anillo) una transferencia nueva empieza sin esperar el primer ACK selectivo, 
+*             y el MD5 sale justo detrás del último paquete (`COMM_hasInlineDigest`). Al 
+*             acabar se muestra el caudal de punta a punta, para compararlo entre el anillo 
+*             y TCP. 
+* 
+* @Parámetros: 
+* in: transfer = Archivo a enviar y estado de la transferencia (`file_size`, `received`, 
+*                `merkle` y `md5sum` no se usan): 
+*                `n_processed_packets` = Paquetes confirmados por el receptor (de forma 
+*                contigua, si la conexión no usa ACK selectivos). Los paquetes en vuelo no 
+*                se cuentan, de modo que al reanudar se vuelven a enviar. Con franja, los 
+*                paquetes de fuera de la franja cuentan como confirmados. 
+*                `stripe` = Franja de paquetes que se envía por esta conexión, o NULL para 
+*                enviar el archivo entero. Solo se tiene en cuenta con `CONN_CAP_SACK`. 
+*                `hash` = MD5 incremental del archivo, o NULL. Se le añaden los paquetes a 
+*                medida que se envían y, si el envío acaba bien, cubre el archivo entero 
+*                (continuando desde donde lo dejó un envío anterior). 
+*                `pool` = Pool de tramas de la conexión. Se reutilizan sus tramas (una por 
+*                paquete del lote), de modo que el bucle de envío no reserva memoria dinámica. 
+*                `reader` = Lector con buffer de `worker_socket`, por el que llegan los ACK. 
+* in: worker_socket = Descriptor del socket utilizado para enviar los paquetes. 
+* in: params = Parámetros acordados con el otro extremo (formato de trama, bytes por paquete, 
+*              ventana de envío y capacidades), motor de E/S local y, en un worker con 
+*              límites, la parte del ancho de banda del usuario (`SHAPER_acquire`). 
+* 
 * @Retorno: 
 *           TRANSFER_SUCCESS = El archivo fue enviado con éxito. 
 *           REMOTE_END_DISCONNECTION = El extremo remoto (worker o fleck) se desconectó. 
@@ -62,22 +188,60 @@
 *           INTERRUPTED_BY_SIGINT = El envío fue interrumpido por una señal SIGINT. 
 * 
 ************************************************/
-int COMM_sendFile(char* file_path, char* filename, int n_packets, int* n_processed_packets, int worker_socket, volatile int* exit_distortion, int process, pthread_mutex_t *print_mutex);
+int COMM_sendFile(const FileTransfer *transfer, int worker_socket, const ConnectionParams *params);
 
 /*********************************************** 
 * 
 * @Finalidad: Recibir un archivo desde un worker o fleck en paquetes a través de un socket, 
-*             confirmando la recepción de cada paquete y escribiendo los datos en un archivo local. 
+*             escribiendo los datos en un archivo local y confirmándolos con ACK. 
+*             Se confirma cada `COMM_ACK_INTERVAL` paquetes, al recibir el último y siempre 
+*             que el emisor no tenga más paquetes en vuelo, de modo que un emisor antiguo 
+*             que espera un ACK por paquete sigue funcionando. Si la conexión ha acordado 
+*             `CONN_CAP_SACK`, cada paquete se escribe en el offset que lleva, al empezar se 
+*             informa al emisor de los paquetes que ya se tienen y los ACK llevan el bitmap 
+*             de paquetes recibidos; si no, los ACK son acumulativos. El archivo se reserva 
+*             entero con `fallocate` y se proyecta en memoria, de modo que los paquetes se 
+*             copian a la proyección sin ninguna escritura por paquete (con `pwrite` si el 
+*             sistema de ficheros no lo permite). Con `CONN_IO_URING`, si el kernel lo 
+*             permite, el archivo no se proyecta: cada paquete se escribe con io_uring desde 
+*             su trama mientras se reciben los siguientes. Con el árbol de Merkle del 
+*             archivo (`CONN_CAP_MERKLE`), antes de cada ACK se comprueba cada bloque que ya 
+*             está entero y los paquetes de los bloques corruptos se vuelven a pedir. Los 
+*             paquetes que llegan con sus tramos de un mismo byte (`CONN_CAP_SPARSE`) los 
+*             materializan sin recibirlos, los de ceros como agujeros del archivo. 
+*             Con el emisor en la misma máquina (`CONN_CAP_SHM`, sin franjas) los paquetes 
+*             llegan por un anillo de memoria compartida y se confirman con un solo ACK 
+*             cuando el emisor lo cierra. Con `CONN_CAP_PIPELINE` el emisor de una 
+*             transferencia nueva no espera el primer ACK, así que pueden llegar paquetes 
+*             que ya se tenían: se descartan al esperar el MD5, que llega detrás de ellos. 
 * 
 * @Parámetros: 
-* in: file_path = Ruta completa del archivo donde se escribirán los datos recibidos. 
-* in: filename = Nombre del archivo que se está recibiendo. 
-* in: n_packets = Número total de paquetes esperados. 
-* in/out: n_processed_packets = Puntero al número de paquetes procesados hasta el momento. 
+* in: transfer = Archivo a recibir y estado de la transferencia: 
+*                `file_size` = Tamaño final del archivo en bytes, según sus metadatos. 
+*                `n_processed_packets` = Paquetes confirmados al emisor (de forma contigua, 
+*                si la conexión no usa ACK selectivos). 
+*                `received` = Bitmap de los paquetes escritos en el archivo. Se conserva 
+*                entre reanudaciones (e.g., en la memoria compartida de los workers) y se 
+*                convierte si ahora los paquetes tienen otro tamaño. 
+*                `stripe` = Franja de paquetes que llega por esta conexión, o NULL si llega 
+*                el archivo entero. Solo se comprueban los bloques enteros dentro de la franja. 
+*                `hash` = MD5 incremental del archivo, o NULL. Se le añaden los paquetes a 
+*                medida que se reciben sin huecos delante (con árbol de Merkle, sin pasar del 
+*                primer bloque no verificado), de modo que al acabar cubre todo lo recibido y 
+*                se puede guardar para continuarlo al reanudar. 
+*                `merkle` = Árbol del archivo con sus hojas, o NULL. Sus bloques se marcan 
+*                como verificados a medida que se comprueban. 
+*                `md5sum` = MD5 del archivo según el emisor, o NULL. Si la conexión lo envía 
+*                detrás de los paquetes (`COMM_hasInlineDigest`), se espera aquí y se 
+*                sustituye el que había; si no, no se modifica. 
+*                `pool` = Pool de tramas de la conexión. Los paquetes se reciben sobre las 
+*                mismas tramas, de modo que el bucle de recepción no reserva memoria dinámica. 
+*                `reader` = Lector con buffer de `worker_socket`. Con cada `recv` se obtienen 
+*                tantos paquetes como haya disponibles en el socket. 
 * in: worker_socket = Descriptor del socket utilizado para recibir los paquetes. 
-* in: exit_distortion = Bandera que indica si se debe interrumpir el proceso de recepción. 
-* in: process = Indica si se está comunicando con un worker o un fleck (e.g., `FLECK`). 
-* in: print_mutex = Mutex para sincronizar los mensajes de impresión. 
+* in: params = Parámetros acordados con el otro extremo (formato de trama, bytes por paquete 
+*              y capacidades), motor de E/S local y, en un worker con límites, la parte del 
+*              ancho de banda del usuario (`SHAPER_acquire`). 
 * 
 * @Retorno: 
 *           TRANSFER_SUCCESS = El archivo fue recibido con éxito. 
@@ -86,7 +250,70 @@ int COMM_sendFile(char* file_path, char* filename, int n_packets, int* n_process
 *           INTERRUPTED_BY_SIGINT = La recepción fue interrumpida por una señal SIGINT. 
 * 
 ************************************************/
-int COMM_receiveFile(char* file_path, char* filename, int n_packets, int* n_processed_packets, int worker_socket, volatile int* exit_distortion, int process, pthread_mutex_t *print_mutex);
+int COMM_receiveFile(const FileTransfer *transfer, int worker_socket, const ConnectionParams *params);
+
+/*********************************************** 
+* 
+* @Finalidad: Enviar un archivo repartido en franjas de paquetes consecutivos, una por 
+*             conexión paralela con el mismo receptor, que las reconstruye por offset. 
+*             Cada franja se envía con `COMM_sendFile` en su propio hilo, de modo que 
+*             las conexiones no comparten ventana ni esperan los ACK de las demás. Requiere 
+*             `CONN_CAP_SACK` (cada paquete lleva su offset). 
+* 
+* @Parámetros: 
+* in: transfer = Archivo a enviar y estado de la transferencia por la conexión principal 
+*                (`stripe` no se usa: cada franja lleva la suya). `n_processed_packets` 
+*                acaba con los paquetes confirmados entre todas las franjas. Los hilos de 
+*                las franjas no calculan `hash`; si el envío acaba bien se completa leyendo 
+*                el archivo, que ya está en la memoria caché. Las demás conexiones usan un 
+*                pool y un lector propios. 
+* in: sockets = Conexiones de las franjas; la 0 es la conexión principal. 
+* in: n_stripes = Número de franjas (como mucho `CONN_MAX_STRIPES`). 
+* in: params = Parámetros acordados en la conexión principal, que comparten todas. 
+* 
+* @Retorno: 
+*           TRANSFER_SUCCESS = El archivo fue enviado con éxito por todas las conexiones. 
+*           REMOTE_END_DISCONNECTION = El extremo remoto (worker o fleck) se desconectó. 
+*           UNEXPECTED_ERROR = Ocurrió un error durante la lectura o envío del archivo. 
+*           INTERRUPTED_BY_SIGINT = El envío fue interrumpido por una señal SIGINT. 
+* 
+************************************************/
+int COMM_sendFileStriped(const FileTransfer *transfer, const int *sockets, int n_stripes, const ConnectionParams *params);
+
+/*********************************************** 
+* 
+* @Finalidad: Recibir un archivo repartido en franjas de paquetes consecutivos, una por 
+*             conexión paralela con el mismo emisor. Cada franja se recibe con 
+*             `COMM_receiveFile` en su propio hilo sobre un bitmap propio y escribe sus 
+*             paquetes en su offset del archivo; al acabar (también si falla) los bitmaps 
+*             de las franjas se pasan al del archivo y se anota el progreso de cada franja, 
+*             de modo que una recepción interrumpida se puede reanudar en otro worker. 
+* 
+* @Parámetros: 
+* in: transfer = Archivo a recibir y estado de la transferencia por la conexión principal 
+*                (`stripe` y `md5sum` no se usan). `received` son los paquetes ya escritos 
+*                en el archivo (e.g., los recuperados de la memoria compartida al reanudar) 
+*                y `n_processed_packets` acaba con los recibidos entre todas las franjas. 
+*                Los hilos de las franjas no calculan `hash`; al acabar se avanza hasta donde 
+*                llegan los paquetes recibidos sin huecos leyendo el archivo, que ya está en 
+*                la memoria caché. Cada franja comprueba sus bloques contra `merkle` y los 
+*                que comparten paquetes entre franjas se comprueban al acabar; si alguno es 
+*                corrupto la recepción falla y sus paquetes quedan pendientes para la 
+*                reanudación. Las demás conexiones usan un pool y un lector propios. 
+* out: ranges = Franjas (`n_stripes` posiciones) con los paquetes consecutivos recibidos 
+*               de cada una. 
+* in: sockets = Conexiones de las franjas; la 0 es la conexión principal. 
+* in: n_stripes = Número de franjas (como mucho `CONN_MAX_STRIPES`). 
+* in: params = Parámetros acordados en la conexión principal, que comparten todas. 
+* 
+* @Retorno: 
+*           TRANSFER_SUCCESS = El archivo fue recibido con éxito por todas las conexiones. 
+*           REMOTE_END_DISCONNECTION = El extremo remoto (worker o fleck) se desconectó durante la transmisión. 
+*           UNEXPECTED_ERROR = Ocurrió un error durante la recepción o escritura del archivo. 
+*           INTERRUPTED_BY_SIGINT = La recepción fue interrumpida por una señal SIGINT. 
+* 
+************************************************/
+int COMM_receiveFileStriped(const FileTransfer *transfer, DistortionStripe *ranges, const int *sockets, int n_stripes, const ConnectionParams *params);
 
 /*********************************************** 
 * 
@@ -96,6 +323,8 @@ int COMM_receiveFile(char* file_path, char* filename, int n_packets, int* n_proc
 * @Parámetros: 
 * in: file_path = Ruta completa del archivo cuya integridad se verificará. 
 * in: md5sum = Hash MD5 esperado del archivo. 
+* in: hash = MD5 incremental calculado durante la recepción, o NULL. Si cubre el archivo 
+*            entero no se vuelve a leer el archivo; si no, se calcula el MD5 leyéndolo. 
 * in: worker_socket = Descriptor del socket utilizado para enviar el resultado de la verificación. 
 * in: print_mutex = Mutex para sincronizar los mensajes de impresión. 
 * 
@@ -104,7 +333,7 @@ int COMM_receiveFile(char* file_path, char* filename, int n_packets, int* n_proc
 *           UNEXPECTED_ERROR = Error en la verificación o el MD5 no coincide. 
 * 
 ************************************************/
-int COMM_verifyFileIntegrity(char* file_path, char* md5sum, int worker_socket, pthread_mutex_t *print_mutex);
+int COMM_verifyFileIntegrity(char* file_path, char* md5sum, const FileHash *hash, int worker_socket, pthread_mutex_t *print_mutex);
 
 /*********************************************** 
 * 
@@ -112,7 +341,7 @@ int COMM_verifyFileIntegrity(char* file_path, char* md5sum, int worker_socket, p
 *             evaluando si el archivo fue reensamblado correctamente. 
 * 
 * @Parámetros: 
-* in: worker_socket = Descriptor del socket utilizado para recibir la verificación MD5. 
+* in/out: reader = Lector con buffer de la conexión por la que se recibe la verificación MD5. 
 * in: process = Indica si la comunicación es con un worker o un fleck (e.g., `FLECK`). 
 * in: print_mutex = Mutex para sincronizar los mensajes de impresión. 
 * 
@@ -122,7 +351,254 @@ int COMM_verifyFileIntegrity(char* file_path, char* md5sum, int worker_socket, p
 *           REMOTE_END_DISCONNECTION = El extremo remoto (worker o fleck) se desconectó durante la transmisión. 
 * 
 ************************************************/
-int COMM_retrieveMD5Check(int worker_socket, int process, pthread_mutex_t *print_mutex);
+int COMM_retrieveMD5Check(FrameReader *reader, int process, pthread_mutex_t *print_mutex);
+
+/*********************************************** 
+* 
+* @Finalidad: Enviar el MD5 de un archivo justo después de sus paquetes (trama 0x14), 
+*             cuando la conexión ha acordado `CONN_CAP_HASH_TRAILER`. Así el MD5 se 
+*             calcula en la misma pasada en que se envía el archivo, en lugar de leerlo 
+*             entero antes para ponerlo en los metadatos. 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket por el que se ha enviado el archivo. 
+* in: hash = MD5 incremental del archivo, que ya lo cubre entero. 
+* in: params = Parámetros acordados con el otro extremo. 
+* 
+* @Retorno: 
+*           0 = La trama fue enviada con éxito. 
+*          -1 = Error al enviar la trama. 
+* 
+************************************************/
+int COMM_sendFileDigest(int socket, const FileHash *hash, const ConnectionParams *params);
+
+/*********************************************** 
+* 
+* @Finalidad: Recibir el MD5 que el emisor envía después de los paquetes de un archivo 
+*             (trama 0x14) y sustituir con él el MD5 esperado, que en los metadatos 
+*             puede haber llegado vacío. 
+* 
+* @Parámetros: 
+* in/out: reader = Lector con buffer de la conexión por la que ha llegado el archivo. 
+* in/out: md5sum = MD5 esperado del archivo. Se libera el anterior. 
+* in: process = Indica si se está comunicando con un worker o un fleck (e.g., `FLECK`). 
+* in: print_mutex = Mutex para sincronizar los mensajes de impresión. 
+* 
+* @Retorno: 
+*           TRANSFER_SUCCESS = MD5 recibido. 
+*           REMOTE_END_DISCONNECTION = El extremo remoto se desconectó antes de enviarlo. 
+*           UNEXPECTED_ERROR = Trama incorrecta o error al guardar el MD5. 
+* 
+************************************************/
+int COMM_retrieveFileDigest(FrameReader *reader, char **md5sum, int process, pthread_mutex_t *print_mutex);
+
+/*********************************************** 
+* 
+* @Finalidad: Comprobar si el MD5 de un archivo viaja dentro de su transferencia: con 
+*             `CONN_CAP_PIPELINE` y `CONN_CAP_HASH_TRAILER`, `COMM_sendFile` lo envía justo 
+*             detrás del último paquete, sin esperar sus ACK, y `COMM_receiveFile` lo 
+*             recoge, de modo que no se llama a `COMM_sendFileDigest` ni a 
+*             `COMM_retrieveFileDigest` (salvo en las transferencias por franjas o delta). 
+* 
+* @Parámetros: 
+* in: params = Parámetros acordados con el otro extremo. 
+* 
+* @Retorno: 
+*           1 = El MD5 viaja con la transferencia. 
+*           0 = Se envía y se recibe aparte. 
+* 
+************************************************/
+int COMM_hasInlineDigest(const ConnectionParams *params);
+
+/*********************************************** 
+* 
+* @Finalidad: Añadir a unos metadatos la raíz y el tamaño de bloque del árbol de Merkle 
+*             de un archivo, si el árbol tiene algún bloque. 
+* 
+* @Parámetros: 
+* in/out: metadata = Metadatos del archivo (FILE_REQUEST o FILE_RESULT). 
+* in: merkle = Árbol del archivo, o NULL. 
+* out: root_hex = Buffer donde se escribe la raíz en hexadecimal. Los metadatos apuntan a 
+*                 él, así que debe existir hasta que se codifiquen. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void COMM_setMerkleMetadata(Metadata *metadata, const MerkleTree *merkle, char root_hex[HASH_MD5_HEX_SIZE]);
+
+/*********************************************** 
+* 
+* @Finalidad: Preparar el árbol de Merkle del archivo que se va a recibir con la raíz y el 
+*             tamaño de bloque de sus metadatos. 
+* 
+* @Parámetros: 
+* in: metadata = Metadatos del archivo. 
+* out: merkle = Árbol a preparar. Se libera el anterior y queda vacío si no hay raíz. 
+* in: file_size = Tamaño del archivo en bytes. 
+* 
+* @Retorno: 
+*           1 = Árbol preparado; sus hojas llegarán en tramas 0x15. 
+*           0 = Los metadatos no llevan raíz. 
+*          -1 = La raíz o el tamaño de bloque no son válidos. 
+* 
+************************************************/
+int COMM_getMerkleMetadata(const Metadata *metadata, MerkleTree *merkle, off_t file_size);
+
+/*********************************************** 
+* 
+* @Finalidad: Enviar las hojas del árbol de Merkle de un archivo (el MD5 de cada bloque) en 
+*             tramas 0x15 de como mucho `params->data_size` bytes, para que el receptor 
+*             pueda comprobar cada bloque en cuanto lo tenga entero. 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket por el que se enviará el archivo. 
+* in: merkle = Árbol calculado con `MERKLE_build`. 
+* in: params = Parámetros acordados con el otro extremo (tramas v2). 
+* 
+* @Retorno: 
+*           0 = Hojas enviadas. 
+*          -1 = Error al crear o enviar una trama. 
+* 
+************************************************/
+int COMM_sendMerkleLeaves(int socket, const MerkleTree *merkle, const ConnectionParams *params);
+
+/*********************************************** 
+* 
+* @Finalidad: Recibir las hojas del árbol de Merkle de un archivo (tramas 0x15) y 
+*             comprobar que llevan a la raíz recibida en sus metadatos. 
+* 
+* @Parámetros: 
+* in/out: reader = Lector con buffer de la conexión por la que llegará el archivo. 
+* in/out: merkle = Árbol preparado con `COMM_getMerkleMetadata`. Se le guardan las hojas. 
+* in: process = Indica si se está comunicando con un worker o un fleck (e.g., `FLECK`). 
+* in: print_mutex = Mutex para sincronizar los mensajes de impresión. 
+* 
+* @Retorno: 
+*           TRANSFER_SUCCESS = Hojas recibidas y comprobadas. 
+*           REMOTE_END_DISCONNECTION = El extremo remoto se desconectó antes de enviarlas. 
+*           UNEXPECTED_ERROR = Trama incorrecta, hojas que no llevan a la raíz o error de memoria. 
+* 
+************************************************/
+int COMM_retrieveMerkleLeaves(FrameReader *reader, MerkleTree *merkle, int process, pthread_mutex_t *print_mutex);
+
+/*********************************************** 
+* 
+* @Finalidad: Enviar la signatura de la versión anterior de un archivo que conserva este 
+*             extremo: el tamaño de la versión y de sus bloques (trama 0x17) y la 
+*             signatura de cada bloque en tramas 0x18 de como mucho `params->data_size` 
+*             bytes, para que el emisor solo envíe lo que ha cambiado. 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket por el que llegará el archivo. 
+* in: signature = Signatura calculada con `DELTA_buildSignature`. 
+* in: params = Parámetros acordados con el otro extremo (tramas v2). 
+* 
+* @Retorno: 
+*           0 = Signatura enviada. 
+*          -1 = Error de memoria o al enviar una trama. 
+* 
+************************************************/
+int COMM_sendDeltaSignature(int socket, const DeltaSignature *signature, const ConnectionParams *params);
+
+
+/*********************************************** 
+* 
+* @Finalidad: Recibir la signatura de la versión anterior de un archivo que conserva el 
+*             receptor (tramas 0x17 y 0x18) y preparar la búsqueda de sus bloques. 
+* 
+* @Parámetros: 
+* in/out: reader = Lector con buffer de la conexión por la que se enviará el archivo. 
+* out: signature = Signatura recibida. Se libera la anterior. 
+* in: process = Indica si se está comunicando con un worker o un fleck (e.g., `FLECK`). 
+* in: print_mutex = Mutex para sincronizar los mensajes de impresión. 
+* 
+* @Retorno: 
+*           TRANSFER_SUCCESS = Signatura recibida. 
+*           REMOTE_END_DISCONNECTION = El extremo remoto se desconectó antes de enviarla. 
+*           UNEXPECTED_ERROR = Trama incorrecta, tamaños no válidos o error de memoria. 
+* 
+************************************************/
+int COMM_retrieveDeltaSignature(FrameReader *reader, DeltaSignature *signature, int process, pthread_mutex_t *print_mutex);
+
+
+/*********************************************** 
+* 
+* @Finalidad: Enviar un archivo como delta respecto a la versión anterior que conserva el 
+*             receptor, en tramas 0x19 de operaciones (copias de bloques de esa versión y 
+*             bytes literales) que se generan a medida que se recorre el archivo. Una trama 
+*             0x19 vacía indica el final. El MD5 del archivo se completa en la misma pasada. 
+* 
+* @Parámetros: 
+* in: file_path = Ruta completa del archivo a enviar. 
+* in: filename = Nombre del archivo, para los mensajes. 
+* in: signature = Signatura de la versión anterior recibida con `COMM_retrieveDeltaSignature`. 
+* in/out: hash = MD5 incremental del archivo, o NULL. 
+* in: worker_socket = Descriptor del socket utilizado para enviar el delta. 
+* in: params = Parámetros acordados con el otro extremo (tramas v2 y compresión). 
+* in/out: pool = Pool de tramas de la conexión. 
+* in: exit_distortion = Bandera que indica si se debe interrumpir el proceso de envío. 
+* in: process = Indica si se está comunicando con un worker o un fleck (e.g., `FLECK`). 
+* in: print_mutex = Mutex para sincronizar los mensajes de impresión. 
+* 
+* @Retorno: 
+*           TRANSFER_SUCCESS = El delta fue enviado con éxito. 
+*           REMOTE_END_DISCONNECTION = El extremo remoto se desconectó. 
+*           UNEXPECTED_ERROR = Error al leer el archivo o al enviar una trama. 
+*           INTERRUPTED_BY_SIGINT = El envío fue interrumpido por una señal SIGINT. 
+* 
+************************************************/
+int COMM_sendFileDelta(char* file_path, char* filename, const DeltaSignature *signature, FileHash *hash, int worker_socket, const ConnectionParams *params, FramePool *pool, volatile int* exit_distortion, int process, pthread_mutex_t *print_mutex);
+
+
+/*********************************************** 
+* 
+* @Finalidad: Recibir un archivo enviado como delta (tramas 0x19) y reconstruirlo a partir 
+*             de la versión anterior que conserva este extremo. El MD5 del archivo se 
+*             calcula a medida que se reconstruye, con los bytes aún en la memoria caché. 
+* 
+* @Parámetros: 
+* in: file_path = Ruta completa donde se reconstruye el archivo. 
+* in: basis_path = Ruta de la versión anterior del archivo. 
+* in: filename = Nombre del archivo, para los mensajes. 
+* in: file_size = Tamaño del archivo nuevo en bytes. 
+* in: signature = Signatura de la versión anterior enviada con `COMM_sendDeltaSignature`. 
+* in/out: hash = MD5 incremental del archivo (vacío), o NULL. 
+* in: params = Parámetros acordados con el otro extremo (tramas v2). 
+* in/out: pool = Pool de tramas de la conexión. 
+* in/out: reader = Lector con buffer de la conexión por la que llega el delta. 
+* in: exit_distortion = Bandera que indica si se debe interrumpir el proceso de recepción. 
+* in: process = Indica si se está comunicando con un worker o un fleck (e.g., `FLECK`). 
+* in: print_mutex = Mutex para sincronizar los mensajes de impresión. 
+* 
+* @Retorno: 
+*           TRANSFER_SUCCESS = El archivo fue reconstruido con éxito. 
+*           REMOTE_END_DISCONNECTION = El extremo remoto se desconectó durante la transmisión. 
+*           UNEXPECTED_ERROR = Delta mal formado, versión anterior cambiada o error de escritura. 
+*           INTERRUPTED_BY_SIGINT = La recepción fue interrumpida por una señal SIGINT. 
+* 
+************************************************/
+int COMM_receiveFileDelta(char* file_path, char* basis_path, char* filename, int file_size, const DeltaSignature *signature, FileHash *hash, const ConnectionParams *params, FramePool *pool, FrameReader *reader, volatile int* exit_distortion, int process, pthread_mutex_t *print_mutex);
+
+/*********************************************** 
+* 
+* @Finalidad: Codificar y enviar un mensaje de metadatos de control. Si la conexión ha 
+*             acordado tramas v2 el mensaje se codifica en binario (TLV) y se envía en 
+*             una trama v2, sin el límite de `DATA_SIZE`; si no, se codifica como texto 
+*             con '&' en una trama v1 para que los peers antiguos lo entiendan. 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket por el que se enviará el mensaje. 
+* in: type = Tipo de la trama. 
+* in: metadata = Campos del mensaje. 
+* in: message = Mensaje del esquema de metadatos. 
+* in: params = Parámetros acordados con el otro extremo (NULL si todavía no hay acuerdo). 
+* 
+* @Retorno: 
+*           0 = Mensaje enviado correctamente. 
+*          -1 = Falta un campo obligatorio, el mensaje no cabe en una trama o error al enviarlo. 
+* 
+************************************************/
+int COMM_sendMetadata(int socket, int type, const Metadata *metadata, MetadataMessage message, const ConnectionParams *params);
 
 /*********************************************** 
 * 
@@ -135,10 +611,59 @@ int COMM_retrieveMD5Check(int worker_socket, int process, pthread_mutex_t *print
 *                  Si es válida, esta cadena puede ser NULL. 
 * in: is_valid = Indicador de validez de la respuesta (1 para válida, 0 para no válida). 
 * in: type = Tipo de cliente (`0x01` para fleck o `0x02` para worker). 
+* in: params = Parámetros acordados con el cliente. Si la conexión es v2, la respuesta 
+*              válida lleva en binario la combinación acordada (tamaño de datos, 
+*              capacidades, checksum, hash, ventana y conexiones paralelas); si es 
+*              NULL o v1, la respuesta válida va vacía como en el protocolo original. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void COMM_sendConnectionResponse(int client_socket, char* string_err, int is_valid, int type, const ConnectionParams *params);  //Usada tant per Gotham com els Workers
+
+/*********************************************** 
+* 
+* @Finalidad: Obtener la oferta que este extremo anuncia en el handshake de una conexión: 
+*             la oferta configurada localmente y, en conexiones de loopback, la posibilidad 
+*             de omitir el checksum por trama, ya que el MD5 del archivo ya protege la 
+*             transferencia. Si el otro extremo está en esta máquina se ofrece además pasar 
+*             los datos de los ficheros por memoria compartida (`CONN_CAP_SHM`). 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket conectado con el otro extremo. 
+* in: params = Parámetros de la conexión con la oferta configurada localmente (puede ser NULL). 
+* out: offer = Oferta que se anunciará en el handshake. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void COMM_getLocalOffer(int socket, const ConnectionParams *params, ConnectionOffer *offer);
+
+/*********************************************** 
+* 
+* @Finalidad: Añadir una oferta de capacidades a un mensaje de metadatos de handshake. 
+* 
+* @Parámetros: 
+* in/out: metadata = Campos del mensaje. 
+* in: offer = Oferta a añadir. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void COMM_setOfferMetadata(Metadata *metadata, const ConnectionOffer *offer);
+
+/*********************************************** 
+* 
+* @Finalidad: Extraer la oferta de capacidades de un mensaje de metadatos de handshake. 
+*             Los campos que el otro extremo no anuncia (peers antiguos) quedan a 0. 
+* 
+* @Parámetros: 
+* in: metadata = Campos del mensaje recibido. 
+* out: offer = Oferta del otro extremo. 
 * 
 * @Retorno: Ninguno. 
 * 
 ************************************************/
-void COMM_sendConnectionResponse(int client_socket, char* string_err, int is_valid, int type);  //Usada tant per Gotham com els Workers
+void COMM_getOfferMetadata(const Metadata *metadata, ConnectionOffer *offer);
 
 #endif // _COMMUNICATION_CUSTOM_H_
\ No newline at end of file
@@ -0,0 +1,245 @@
+/***********************************************
+*
+* @Autores: Alexandre Contreras, Armand López.
+*
+* @Finalidad: Implementar el ajuste de la ventana de paquetes en vuelo y del lote de cada
+*             escritura durante el envío de un fichero, a partir del RTT de los ACK y del
+*             caudal confirmado en cada ronda.
+*
+* @Fecha de creación: 16 de octubre de 2026.
+*
+* @Última modificación: 16 de octubre de 2026.
+*
+************************************************/
+
+#include "congestion.h"
+
+/***********************************************
+*
+* @Finalidad: Calcular los milisegundos entre dos instantes.
+*
+* @Parámetros:
+* in: from = Instante inicial.
+* in: to = Instante final.
+*
+* @Retorno: Milisegundos transcurridos.
+*
+************************************************/
+static double CONG_elapsedMs(const struct timespec *from, const struct timespec *to) {
+    return (to->tv_sec - from->tv_sec) * 1000.0 + (to->tv_nsec - from->tv_nsec) / 1000000.0;
+}
+
+/***********************************************
+*
+* @Finalidad: Dejar la ventana y el lote dentro de sus límites y, si han cambiado, guardar
+*             el cambio en el historial.
+*
+* @Parámetros:
+* in/out: control = Control del envío.
+* in: window = Ventana escogida.
+* in: batch = Lote escogido.
+* in: now = Instante del cambio.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+static void CONG_apply(CongestionControl *control, int window, int batch, const struct timespec *now) {
+    if (window > control->max_window) window = control->max_window;
+    if (window < 1) window = 1;
+    if (batch > control->max_batch) batch = control->max_batch;
+    if (batch > window) batch = window;
+    if (batch < 1) batch = 1;
+    if (window == control->window && batch == control->batch) return;
+
+    control->window = window;
+    control->batch = batch;
+    if (window > control->peak_window) control->peak_window = window;
+    if (batch > control->peak_batch) control->peak_batch = batch;
+
+    CongestionSample *sample = &control->history[control->n_changes % CONG_HISTORY_SIZE];
+    sample->time_ms = CONG_elapsedMs(&control->start, now);
+    sample->window = window;
+    sample->batch = batch;
+    sample->rtt_ms = control->srtt_ms;
+    sample->goodput = control->goodput;
+    control->n_changes++;
+}
+
+/***********************************************
+*
+* @Finalidad: Acabar una ronda: medir el caudal confirmado durante la ronda y ajustar la
+*             ventana y el lote.
+*
+* @Parámetros:
+* in/out: control = Control del envío.
+* in: now = Instante en que se confirma el último paquete de la ronda.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+static void CONG_endRound(CongestionControl *control, const struct timespec *now) {
+    double elapsed_ms = CONG_elapsedMs(&control->round_start, now);
+    int window = control->window;
+    int batch = control->batch;
+
+    if (elapsed_ms > 0 && control->srtt_ms > 0) {
+        double goodput = (control->acked - control->round_acked) * (double)control->data_size * 1000.0 / elapsed_ms;
+        int improved = goodput >= control->best_goodput * CONG_GOODPUT_GAIN;
+        // Amb el RTT mínim la finestra sortiria sense esperar; el que el RTT actual hi afegeix són els paquets que fan cua
+        double queued = window * (1.0 - control->min_rtt_ms / control->srtt_ms);
+        control->goodput = goodput;
+        if (goodput > control->best_goodput) control->best_goodput = goodput;
+
+        if (control->slow_start && improved && queued < CONG_MIN_QUEUED) {
+            // A l'arrencada doblem mentre el cabal millori i gairebé no hi hagi cua
+            window *= 2;
+            batch *= 2;
+        } else {
+            // Després seguim els canvis de l'enllaç de paquet en paquet; el lot creix si el cabal es manté i es redueix amb la cua
+            control->slow_start = 0;
+            if (queued < CONG_MIN_QUEUED) {
+                window++;
+                if (goodput >= control->best_goodput / CONG_GOODPUT_GAIN) batch++;
+            } else if (queued > CONG_MAX_QUEUED) {
+                window--;
+                batch--;
+            }
+        }
+    }
+
+    CONG_apply(control, window, batch, now);
+    control->round_end = control->sent;
+    control->round_acked = control->acked;
+    control->round_start = *now;
+}
+
+/***********************************************
+*
+* @Finalidad: Preparar el control de un envío, empezando con una ventana pequeña que crece
+*             a cada ronda mientras el caudal mejora.
+*
+* @Parámetros:
+* out: control = Control a preparar.
+* in: max_window = Paquetes en vuelo acordados con el otro extremo.
+* in: max_batch = Paquetes que caben como máximo en una escritura.
+* in: data_size = Bytes de datos por paquete.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void CONG_init(CongestionControl *control, int max_window, int max_batch, uint32_t data_size) {
+    memset(control, 0, sizeof(*control));
+    control->max_window = max_window > 0 ? max_window : 1;
+    control->max_batch = max_batch > 0 ? max_batch : 1;
+    control->window = control->max_window < CONG_INITIAL_WINDOW ? control->max_window : CONG_INITIAL_WINDOW;
+    control->batch = control->max_batch < control->window ? control->max_batch : control->window;
+    control->peak_window = control->window;
+    control->peak_batch = control->batch;
+    control->slow_start = 1;
+    control->data_size = data_size;
+    clock_gettime(CLOCK_MONOTONIC, &control->start);
+    control->round_start = control->start;
+}
+
+/***********************************************
+*
+* @Finalidad: Registrar que han salido paquetes en una escritura, para medir el RTT cuando
+*             se confirmen.
+*
+* @Parámetros:
+* in/out: control = Control del envío.
+* in: packets = Paquetes de la escritura.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void CONG_onSend(CongestionControl *control, int packets) {
+    if (packets <= 0) return;
+    control->sent += packets;
+
+    // Si no queda lloc (no hauria de passar, hi ha com a molt una escriptura per paquet en vol) deixem de mesurar la més antiga
+    if (control->n_bursts == CONG_MAX_BURSTS) {
+        control->burst_head = (control->burst_head + 1) % CONG_MAX_BURSTS;
+        control->n_bursts--;
+    }
+    CongestionBurst *burst = &control->bursts[(control->burst_head + control->n_bursts) % CONG_MAX_BURSTS];
+    burst->end = control->sent;
+    clock_gettime(CLOCK_MONOTONIC, &burst->time);
+    control->n_bursts++;
+}
+
+/***********************************************
+*
+* @Finalidad: Registrar los paquetes que confirma un ACK. Cuando una escritura queda
+*             confirmada entera se toma su RTT y, al acabar cada ronda (los paquetes que
+*             estaban en vuelo al empezarla), se mide el caudal y se ajustan la ventana y
+*             el lote: en el arranque se doblan mientras el caudal mejora, después crecen
+*             de uno en uno y, si el RTT indica que los paquetes hacen cola, se reducen.
+*
+* @Parámetros:
+* in/out: control = Control del envío.
+* in: packets = Paquetes confirmados por el ACK (0 si no confirma ninguno nuevo).
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void CONG_onAck(CongestionControl *control, int packets) {
+    if (packets <= 0) return;
+    control->acked += packets;
+    if (control->acked > control->sent) control->acked = control->sent;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    // El RTT es mesura amb l'escriptura més recent que ja està confirmada sencera
+    double rtt_ms = -1;
+    while (control->n_bursts > 0 && control->bursts[control->burst_head].end <= control->acked) {
+        rtt_ms = CONG_elapsedMs(&control->bursts[control->burst_head].time, &now);
+        control->burst_head = (control->burst_head + 1) % CONG_MAX_BURSTS;
+        control->n_bursts--;
+    }
+    if (rtt_ms >= 0) {
+        control->srtt_ms = control->srtt_ms == 0 ? rtt_ms : control->srtt_ms * 7 / 8 + rtt_ms / 8;
+        if (control->min_rtt_ms == 0 || rtt_ms < control->min_rtt_ms) control->min_rtt_ms = rtt_ms;
+    }
+
+    if (control->acked >= control->round_end) CONG_endRound(control, &now);
+}
+
+/***********************************************
+*
+* @Finalidad: Describir los valores escogidos durante el envío y los últimos cambios, para
+*             poder ajustar la ventana de cada instalación.
+*
+* @Parámetros:
+* in: control = Control del envío.
+* out: buffer = Texto con la descripción, acabado en salto de línea.
+* in: size = Bytes de `buffer` (e.g., `CONG_SUMMARY_SIZE`).
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void CONG_describe(const CongestionControl *control, char *buffer, size_t size) {
+    size_t used = 0;
+    int written = snprintf(buffer, size, "Adaptive window: %d packets (peak %d of %d), batch: %d packets (peak %d of %d), RTT: %.2f ms (min %.2f ms), goodput: %.1f MB/s",
+                           control->window, control->peak_window, control->max_window, control->batch, control->peak_batch, control->max_batch,
+                           control->srtt_ms, control->min_rtt_ms, control->best_goodput / (1024.0 * 1024.0));
+    if (written < 0) written = 0;
+    used = (size_t)written < size ? (size_t)written : size - 1;
+
+    // Els últims canvis, del més antic al més recent
+    int first = control->n_changes > CONG_HISTORY_SIZE ? control->n_changes - CONG_HISTORY_SIZE : 0;
+    if (control->n_changes > 0 && used < size) {
+        written = snprintf(buffer + used, size - used, "\nWindow history (%d changes%s):", control->n_changes, first > 0 ? ", latest shown" : "");
+        if (written > 0) used += (size_t)written < size - used ? (size_t)written : size - used - 1;
+    }
+    for (int i = first; i < control->n_changes && used < size; i++) {
+        const CongestionSample *sample = &control->history[i % CONG_HISTORY_SIZE];
+        written = snprintf(buffer + used, size - used, " %.0fms w%d/b%d (RTT %.2f ms, %.1f MB/s)", sample->time_ms, sample->window, sample->batch, sample->rtt_ms, sample->goodput / (1024.0 * 1024.0));
+        if (written > 0) used += (size_t)written < size - used ? (size_t)written : size - used - 1;
+    }
+    if (used + 1 < size) {
+        buffer[used++] = '\n';
+        buffer[used] = '\0';
+    }
+}
@@ -0,0 +1,142 @@
+/***********************************************
+*
+* @Autores: Alexandre Contreras y Armand López
+* @Propósito: Ajustar durante el envío de un fichero la ventana de paquetes en vuelo y los
+*             paquetes que salen en cada escritura (el lote) a partir del tiempo de ida y
+*             vuelta de los ACK y del caudal confirmado, al estilo del control de
+*             congestión de TCP Vegas: con el RTT mínimo y el actual se estima cuántos
+*             paquetes hacen cola en el camino, y la ventana crece mientras son pocos y se
+*             reduce cuando son demasiados. También guarda el historial de los valores
+*             escogidos para mostrarlo en los logs.
+* @Fecha de creación: 16 de octubre de 2026
+* @Última modificación: 16 de octubre de 2026
+*
+************************************************/
+
+#ifndef _CONGESTION_CUSTOM_H_
+#define _CONGESTION_CUSTOM_H_
+
+//Libreries del sistema
+#include <stdio.h>     // snprintf
+#include <string.h>    // memset
+#include <stddef.h>    // size_t
+#include <stdint.h>    // uint32_t
+#include <time.h>      // clock_gettime, CLOCK_MONOTONIC
+
+//Llibreries pròpies
+#include "../Structure/typeConnection.h"
+
+//Constants
+#define CONG_INITIAL_WINDOW 2             // Paquets en vol en començar l'enviament (si la finestra acordada ho permet)
+#define CONG_MAX_BURSTS CONN_MAX_WINDOW_SIZE   // Escriptures pendents de confirmar que es poden mesurar (com a molt, una per paquet en vol)
+#define CONG_HISTORY_SIZE 16              // Últims canvis de la finestra o del lot que es guarden per als logs
+#define CONG_MIN_QUEUED 1.0               // Paquets a la cua de l'enllaç per sota dels quals la finestra creix (perquè mai es buidi)
+#define CONG_MAX_QUEUED 3.0               // Paquets a la cua de l'enllaç per sobre dels quals la finestra es redueix
+#define CONG_GOODPUT_GAIN 1.05            // Millora mínima del cabal d'una ronda per seguir doblant en l'arrencada
+#define CONG_SUMMARY_SIZE 1024            // Bytes del buffer on es descriu l'historial
+
+typedef struct {
+    long long end;              // Paquets enviats (acumulat) en acabar l'escriptura
+    struct timespec time;       // Moment de l'escriptura
+} CongestionBurst;              // Escriptura pendent de confirmar, per mesurar el RTT
+
+typedef struct {
+    double time_ms;             // Temps des del principi de l'enviament
+    int window;
+    int batch;
+    double rtt_ms;              // RTT suavitzat en el moment del canvi
+    double goodput;             // Cabal confirmat de l'última ronda (bytes/s)
+} CongestionSample;             // Canvi de la finestra o del lot
+
+typedef struct {
+    int window;                 // Paquets en vol sense confirmar
+    int batch;                  // Paquets que surten en cada escriptura
+    int max_window;             // Finestra acordada amb l'altre extrem
+    int max_batch;              // Paquets que caben a les trames reservades per lot
+    int slow_start;             // 1 mentre la finestra es dobla a cada ronda
+    uint32_t data_size;         // Bytes de dades per paquet
+    long long sent;             // Paquets enviats (acumulat)
+    long long acked;            // Paquets confirmats (acumulat)
+    CongestionBurst bursts[CONG_MAX_BURSTS];
+    int burst_head;
+    int n_bursts;
+    double srtt_ms;             // RTT suavitzat (0 = encara cap mostra)
+    double min_rtt_ms;          // RTT mínim observat (0 = encara cap mostra)
+    double goodput;             // Cabal confirmat de l'última ronda (bytes/s)
+    double best_goodput;        // Millor cabal d'una ronda
+    long long round_end;        // La ronda acaba quan es confirmen aquests paquets
+    long long round_acked;      // Paquets confirmats en començar la ronda
+    struct timespec round_start;
+    struct timespec start;      // Principi de l'enviament
+    CongestionSample history[CONG_HISTORY_SIZE];   // Últims canvis (cua circular)
+    int n_changes;              // Canvis totals, inclosos els que ja no són a l'historial
+    int peak_window;
+    int peak_batch;
+} CongestionControl;            // Estat del control de la finestra i del lot d'un enviament
+
+//Funcions
+
+/***********************************************
+*
+* @Finalidad: Preparar el control de un envío, empezando con una ventana pequeña que crece
+*             a cada ronda mientras el caudal mejora.
+*
+* @Parámetros:
+* out: control = Control a preparar.
+* in: max_window = Paquetes en vuelo acordados con el otro extremo.
+* in: max_batch = Paquetes que caben como máximo en una escritura.
+* in: data_size = Bytes de datos por paquete.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void CONG_init(CongestionControl *control, int max_window, int max_batch, uint32_t data_size);
+
+/***********************************************
+*
+* @Finalidad: Registrar que han salido paquetes en una escritura, para medir el RTT cuando
+*             se confirmen.
+*
+* @Parámetros:
+* in/out: control = Control del envío.
+* in: packets = Paquetes de la escritura.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void CONG_onSend(CongestionControl *control, int packets);
+
+/***********************************************
+*
+* @Finalidad: Registrar los paquetes que confirma un ACK. Cuando una escritura queda
+*             confirmada entera se toma su RTT y, al acabar cada ronda (los paquetes que
+*             estaban en vuelo al empezarla), se mide el caudal y se ajustan la ventana y
+*             el lote: en el arranque se doblan mientras el caudal mejora y casi no hay
+*             cola, y después crecen o se reducen de uno en uno para mantener entre
+*             `CONG_MIN_QUEUED` y `CONG_MAX_QUEUED` paquetes en la cola.
+*
+* @Parámetros:
+* in/out: control = Control del envío.
+* in: packets = Paquetes confirmados por el ACK (0 si no confirma ninguno nuevo).
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void CONG_onAck(CongestionControl *control, int packets);
+
+/***********************************************
+*
+* @Finalidad: Describir los valores escogidos durante el envío y los últimos cambios, para
+*             poder ajustar la ventana de cada instalación.
+*
+* @Parámetros:
+* in: control = Control del envío.
+* out: buffer = Texto con la descripción, acabado en salto de línea.
+* in: size = Bytes de `buffer` (e.g., `CONG_SUMMARY_SIZE`).
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void CONG_describe(const CongestionControl *control, char *buffer, size_t size);
+
+#endif // _CONGESTION_CUSTOM_H_
@@ -0,0 +1,705 @@
+/***********************************************
+*
+* @Autores: Alexandre Contreras, Armand López.
+*
+* @Finalidad: Implementar la transferencia de un fichero como delta respecto a la versión
+*             anterior que tiene el receptor: signatura de los bloques de esa versión,
+*             búsqueda de los bloques en el fichero nuevo con un checksum rodante (como
+*             rsync) y reconstrucción del fichero nuevo con copias y literales.
+*
+* @Fecha de creación: 16 de octubre de 2026.
+*
+* @Última modificación: 16 de octubre de 2026.
+*
+************************************************/
+
+#include "delta.h"
+
+#define DELTA_COPY_BUFFER_SIZE (64 * 1024)   // Bytes del buffer de les còpies quan no es pot fer `copy_file_range`
+
+/***********************************************
+*
+* @Finalidad: Escribir un entero de 32 bits en big endian.
+*
+* @Parámetros:
+* out: buffer = Destino (4 bytes).
+* in: value = Valor a escribir.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+static void DELTA_putUint32(uint8_t *buffer, uint32_t value) {
+    buffer[0] = (uint8_t)(value >> 24);
+    buffer[1] = (uint8_t)(value >> 16);
+    buffer[2] = (uint8_t)(value >> 8);
+    buffer[3] = (uint8_t)value;
+}
+
+/***********************************************
+*
+* @Finalidad: Leer un entero de 32 bits en big endian.
+*
+* @Parámetros:
+* in: buffer = Origen (4 bytes).
+*
+* @Retorno: Valor leído.
+*
+************************************************/
+static uint32_t DELTA_getUint32(const uint8_t *buffer) {
+    return ((uint32_t)buffer[0] << 24) | ((uint32_t)buffer[1] << 16) | ((uint32_t)buffer[2] << 8) | (uint32_t)buffer[3];
+}
+
+/***********************************************
+*
+* @Finalidad: Calcular desde cero el checksum rodante de un tramo: `a` es la suma de los
+*             bytes y `b` la suma ponderada por la distancia al final, ambas módulo 2^16.
+*
+* @Parámetros:
+* in: data = Bytes del tramo.
+* in: length = Bytes del tramo.
+* out: a = Suma de los bytes.
+* out: b = Suma ponderada de los bytes.
+*
+* @Retorno: Checksum del tramo (`a` en los 16 bits bajos y `b` en los altos).
+*
+************************************************/
+static uint32_t DELTA_weakChecksum(const uint8_t *data, size_t length, uint32_t *a, uint32_t *b) {
+    uint32_t sum_a = 0, sum_b = 0;
+
+    for (size_t i = 0; i < length; i++) {
+        sum_a += data[i];
+        sum_b += sum_a;
+    }
+    *a = sum_a & 0xffff;
+    *b = sum_b & 0xffff;
+    return *a | (*b << 16);
+}
+
+/***********************************************
+*
+* @Finalidad: Obtener la posición de la tabla de dispersión de un checksum rodante.
+*
+* @Parámetros:
+* in: signature = Signatura con la tabla.
+* in: weak = Checksum rodante.
+*
+* @Retorno: Índice de `signature->buckets`.
+*
+************************************************/
+static uint32_t DELTA_bucket(const DeltaSignature *signature, uint32_t weak) {
+    return ((weak ^ (weak >> 16)) * 0x9e3779b1u) & (signature->n_buckets - 1);
+}
+
+/***********************************************
+*
+* @Finalidad: Dejar una `DeltaSignature` vacía, sin bloques.
+*
+* @Parámetros:
+* out: signature = Signatura a inicializar.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void DELTA_initSignature(DeltaSignature *signature) {
+    DeltaSignature empty = DELTA_EMPTY_SIGNATURE;
+
+    *signature = empty;
+}
+
+/***********************************************
+*
+* @Finalidad: Liberar la memoria de una signatura y dejarla vacía.
+*
+* @Parámetros:
+* in/out: signature = Signatura a liberar.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void DELTA_freeSignature(DeltaSignature *signature) {
+    free(signature->weak);
+    free(signature->strong);
+    free(signature->buckets);
+    free(signature->next);
+    DELTA_initSignature(signature);
+}
+
+/***********************************************
+*
+* @Finalidad: Escoger el tamaño de bloque de la versión anterior de un fichero: cerca de
+*             la raíz cuadrada de su tamaño (como rsync), de modo que ni las signaturas ni
+*             los bytes que se reenvían alrededor de cada cambio crecen demasiado.
+*
+* @Parámetros:
+* in: basis_size = Tamaño en bytes de la versión anterior.
+*
+* @Retorno: Bytes de cada bloque, entre `DELTA_MIN_BLOCK_SIZE` y `DELTA_MAX_BLOCK_SIZE`.
+*
+************************************************/
+uint32_t DELTA_chooseBlockSize(off_t basis_size) {
+    uint32_t block_size = DELTA_MIN_BLOCK_SIZE;
+
+    while (block_size < DELTA_MAX_BLOCK_SIZE && (off_t)block_size * block_size < basis_size) {
+        block_size *= 2;
+    }
+    return block_size;
+}
+
+/***********************************************
+*
+* @Finalidad: Reservar los vectores de una signatura según el tamaño de la versión anterior.
+*
+* @Parámetros:
+* out: signature = Signatura vacía.
+* in: basis_size = Tamaño en bytes de la versión anterior.
+* in: block_size = Bytes de cada bloque.
+*
+* @Retorno:
+*           0 = Signatura reservada.
+*          -1 = Tamaño de bloque no válido o error de memoria.
+*
+************************************************/
+static int DELTA_allocSignature(DeltaSignature *signature, off_t basis_size, uint32_t block_size) {
+    off_t n_blocks = (basis_size + block_size - 1) / block_size;
+
+    if (block_size < DELTA_MIN_BLOCK_SIZE || block_size > DELTA_MAX_BLOCK_SIZE || basis_size < 0 || n_blocks > INT32_MAX / DELTA_SIGNATURE_SIZE) return -1;
+
+    signature->block_size = block_size;
+    signature->basis_size = basis_size;
+    signature->n_blocks = (int)n_blocks;
+    signature->n_full_blocks = (int)(basis_size / block_size);
+    if (n_blocks == 0) return 0;
+
+    signature->weak = (uint32_t *)malloc((size_t)n_blocks * sizeof(uint32_t));
+    signature->strong = (uint8_t *)malloc((size_t)n_blocks * HASH_MD5_SIZE);
+    if (!signature->weak || !signature->strong) {
+        DELTA_freeSignature(signature);
+        return -1;
+    }
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalidad: Calcular la signatura de la versión anterior de un fichero (el checksum
+*             rodante y el MD5 de cada bloque) leyéndola una sola vez.
+*
+* @Parámetros:
+* out: signature = Signatura del fichero. Se libera la anterior.
+* in: basis_path = Ruta de la versión anterior.
+* in: block_size = Bytes de cada bloque (e.g., de `DELTA_chooseBlockSize`).
+*
+* @Retorno:
+*           0 = Signatura calculada.
+*          -1 = Error al leer el fichero o de memoria.
+*
+************************************************/
+int DELTA_buildSignature(DeltaSignature *signature, const char *basis_path, uint32_t block_size) {
+    struct stat file_stat;
+    uint8_t *buffer;
+    int fd;
+
+    DELTA_freeSignature(signature);
+
+    fd = open(basis_path, O_RDONLY);
+    if (fd < 0) return -1;
+    if (fstat(fd, &file_stat) < 0 || DELTA_allocSignature(signature, file_stat.st_size, block_size) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    buffer = (uint8_t *)malloc(block_size);
+    if (!buffer) {
+        DELTA_freeSignature(signature);
+        close(fd);
+        return -1;
+    }
+
+    for (int i = 0; i < signature->n_blocks; i++) {
+        off_t offset = (off_t)i * block_size;
+        size_t length = (size_t)(file_stat.st_size - offset < (off_t)block_size ? file_stat.st_size - offset : (off_t)block_size);
+        size_t done = 0;
+        FileHash strong = HASH_EMPTY;
+        uint32_t a, b;
+
+        while (done < length) {
+            ssize_t got = pread(fd, buffer + done, length - done, offset + (off_t)done);
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) {
+                free(buffer);
+                DELTA_freeSignature(signature);
+                close(fd);
+                return -1;
+            }
+            done += (size_t)got;
+        }
+
+        signature->weak[i] = DELTA_weakChecksum(buffer, length, &a, &b);
+        HASH_update(&strong, buffer, length);
+        HASH_digest(&strong, signature->strong + (size_t)i * HASH_MD5_SIZE);
+    }
+
+    free(buffer);
+    close(fd);
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalidad: Cargar la signatura recibida del receptor y preparar la búsqueda de sus
+*             bloques por checksum rodante.
+*
+* @Parámetros:
+* out: signature = Signatura a cargar. Se libera la anterior.
+* in: basis_size = Tamaño en bytes de la versión anterior.
+* in: block_size = Bytes de cada bloque.
+* in: data = Signaturas de los bloques (`DELTA_SIGNATURE_SIZE` bytes cada una).
+* in: length = Bytes de `data`.
+*
+* @Retorno:
+*           0 = Signatura cargada.
+*          -1 = Tamaños que no corresponden o error de memoria.
+*
+************************************************/
+int DELTA_setSignature(DeltaSignature *signature, off_t basis_size, uint32_t block_size, const uint8_t *data, size_t length) {
+    DELTA_freeSignature(signature);
+    if (DELTA_allocSignature(signature, basis_size, block_size) < 0) return -1;
+    if (length != (size_t)signature->n_blocks * DELTA_SIGNATURE_SIZE) {
+        DELTA_freeSignature(signature);
+        return -1;
+    }
+
+    //només els blocs sencers es busquen amb el checksum rodant; l'últim, si és més curt, es compara a part
+    signature->n_buckets = 16;
+    while (signature->n_buckets < (uint32_t)signature->n_full_blocks * 2) signature->n_buckets *= 2;
+    signature->buckets = (int *)malloc(signature->n_buckets * sizeof(int));
+    signature->next = (int *)malloc(((size_t)signature->n_blocks + 1) * sizeof(int));
+    if (!signature->buckets || !signature->next) {
+        DELTA_freeSignature(signature);
+        return -1;
+    }
+    memset(signature->buckets, 0xff, signature->n_buckets * sizeof(int));
+
+    for (int i = 0; i < signature->n_blocks; i++) {
+        signature->weak[i] = DELTA_getUint32(data + (size_t)i * DELTA_SIGNATURE_SIZE);
+        memcpy(signature->strong + (size_t)i * HASH_MD5_SIZE, data + (size_t)i * DELTA_SIGNATURE_SIZE + 4, HASH_MD5_SIZE);
+    }
+    //s'insereix del final al principi perquè cada cadena quedi ordenada per posició
+    for (int i = signature->n_full_blocks - 1; i >= 0; i--) {
+        uint32_t bucket = DELTA_bucket(signature, signature->weak[i]);
+
+        signature->next[i] = signature->buckets[bucket];
+        signature->buckets[bucket] = i;
+    }
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalidad: Serializar las signaturas de los bloques para enviarlas.
+*
+* @Parámetros:
+* in: signature = Signatura calculada con `DELTA_buildSignature`.
+* out: data = Buffer de `n_blocks * DELTA_SIGNATURE_SIZE` bytes.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void DELTA_packSignature(const DeltaSignature *signature, uint8_t *data) {
+    for (int i = 0; i < signature->n_blocks; i++) {
+        DELTA_putUint32(data + (size_t)i * DELTA_SIGNATURE_SIZE, signature->weak[i]);
+        memcpy(data + (size_t)i * DELTA_SIGNATURE_SIZE + 4, signature->strong + (size_t)i * HASH_MD5_SIZE, HASH_MD5_SIZE);
+    }
+}
+
+/***********************************************
+*
+* @Finalidad: Preparar la generación del delta de un fichero respecto a una signatura.
+*
+* @Parámetros:
+* out: encoder = Generador a preparar.
+* in: signature = Signatura de la versión anterior. Debe existir mientras se use.
+* in: data = Fichero nuevo proyectado en memoria.
+* in: size = Bytes del fichero nuevo.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void DELTA_initEncoder(DeltaEncoder *encoder, const DeltaSignature *signature, const uint8_t *data, off_t size) {
+    memset(encoder, 0, sizeof(DeltaEncoder));
+    encoder->signature = signature;
+    encoder->data = data;
+    encoder->size = size;
+}
+
+/***********************************************
+*
+* @Finalidad: Comprobar con el MD5 si la ventana actual es un bloque concreto.
+*
+* @Parámetros:
+* in: encoder = Generador con la ventana.
+* in: block = Índice del bloque.
+* in: length = Bytes de la ventana.
+* in/out: digest = MD5 de la ventana; se calcula la primera vez que hace falta.
+* in/out: has_digest = Indica si `digest` ya está calculado.
+*
+* @Retorno: 1 si la ventana es el bloque, 0 si no.
+*
+************************************************/
+static int DELTA_matchStrong(const DeltaEncoder *encoder, int block, size_t length, uint8_t digest[HASH_MD5_SIZE], int *has_digest) {
+    if (!*has_digest) {
+        FileHash strong = HASH_EMPTY;
+
+        HASH_update(&strong, encoder->data + encoder->position, length);
+        HASH_digest(&strong, digest);
+        *has_digest = 1;
+    }
+    return memcmp(digest, encoder->signature->strong + (size_t)block * HASH_MD5_SIZE, HASH_MD5_SIZE) == 0;
+}
+
+/***********************************************
+*
+* @Finalidad: Buscar el bloque de la versión anterior que coincide con la ventana actual.
+*             Primero se prueba el bloque que sigue a la copia pendiente, que es el caso
+*             habitual en las zonas sin cambios.
+*
+* @Parámetros:
+* in/out: encoder = Generador con la ventana; se actualiza el checksum rodante.
+*
+* @Retorno: Índice del bloque, o -1 si la ventana no coincide con ninguno.
+*
+************************************************/
+static int DELTA_findBlock(DeltaEncoder *encoder) {
+    const DeltaSignature *signature = encoder->signature;
+    off_t remaining = encoder->size - encoder->position;
+    uint8_t digest[HASH_MD5_SIZE];
+    int has_digest = 0;
+    uint32_t weak;
+
+    if (remaining >= (off_t)signature->block_size && signature->n_full_blocks > 0) {
+        int expected = encoder->copy_count > 0 ? encoder->copy_block + encoder->copy_count : -1;
+
+        if (!encoder->rolling) {
+            DELTA_weakChecksum(encoder->data + encoder->position, signature->block_size, &encoder->a, &encoder->b);
+            encoder->rolling = 1;
+        }
+        weak = encoder->a | (encoder->b << 16);
+
+        if (expected >= 0 && expected < signature->n_full_blocks && signature->weak[expected] == weak
+            && DELTA_matchStrong(encoder, expected, signature->block_size, digest, &has_digest)) {
+            return expected;
+        }
+        for (int block = signature->buckets[DELTA_bucket(signature, weak)]; block >= 0; block = signature->next[block]) {
+            if (signature->weak[block] == weak && DELTA_matchStrong(encoder, block, signature->block_size, digest, &has_digest)) {
+                return block;
+            }
+        }
+        return -1;
+    }
+
+    //l'últim bloc, si és més curt, només pot coincidir amb el final exacte del fitxer nou
+    if (signature->n_blocks > signature->n_full_blocks
+        && remaining == signature->basis_size - (off_t)signature->n_full_blocks * signature->block_size) {
+        uint32_t a, b;
+        int last = signature->n_blocks - 1;
+
+        weak = DELTA_weakChecksum(encoder->data + encoder->position, (size_t)remaining, &a, &b);
+        if (signature->weak[last] == weak && DELTA_matchStrong(encoder, last, (size_t)remaining, digest, &has_digest)) {
+            return last;
+        }
+    }
+    return -1;
+}
+
+/***********************************************
+*
+* @Finalidad: Escribir la copia pendiente en el buffer de operaciones.
+*
+* @Parámetros:
+* in/out: encoder = Generador con la copia pendiente.
+* out: ops = Posición del buffer donde se escribe.
+*
+* @Retorno: Bytes escritos.
+*
+************************************************/
+static size_t DELTA_emitCopy(DeltaEncoder *encoder, uint8_t *ops) {
+    ops[0] = DELTA_OP_COPY;
+    DELTA_putUint32(ops + 1, (uint32_t)encoder->copy_block);
+    DELTA_putUint32(ops + 5, (uint32_t)encoder->copy_count);
+    encoder->copy_count = 0;
+    return DELTA_COPY_SIZE;
+}
+
+/***********************************************
+*
+* @Finalidad: Escribir en el buffer de operaciones tantos bytes del literal pendiente como
+*             quepan.
+*
+* @Parámetros:
+* in/out: encoder = Generador con el literal pendiente.
+* out: ops = Posición del buffer donde se escribe.
+* in: room = Bytes libres del buffer (más que `DELTA_LITERAL_HEADER_SIZE`).
+*
+* @Retorno: Bytes escritos.
+*
+************************************************/
+static size_t DELTA_emitLiteral(DeltaEncoder *encoder, uint8_t *ops, size_t room) {
+    size_t length = (size_t)(encoder->position - encoder->literal_start);
+
+    if (length > room - DELTA_LITERAL_HEADER_SIZE) length = room - DELTA_LITERAL_HEADER_SIZE;
+    ops[0] = DELTA_OP_LITERAL;
+    DELTA_putUint32(ops + 1, (uint32_t)length);
+    memcpy(ops + DELTA_LITERAL_HEADER_SIZE, encoder->data + encoder->literal_start, length);
+    encoder->literal_start += (off_t)length;
+    encoder->literal_bytes += (off_t)length;
+    return DELTA_LITERAL_HEADER_SIZE + length;
+}
+
+/***********************************************
+*
+* @Finalidad: Generar las siguientes operaciones del delta en un buffer. El fichero se
+*             recorre con una ventana del tamaño de bloque: si su checksum rodante y su
+*             MD5 coinciden con un bloque de la versión anterior se genera una copia (los
+*             bloques consecutivos se juntan en una sola) y si no, la ventana avanza un
+*             byte y el byte que sale queda como literal.
+*
+* @Parámetros:
+* in/out: encoder = Generador preparado con `DELTA_initEncoder`.
+* out: ops = Buffer donde se escriben las operaciones.
+* in: capacity = Bytes de `ops` (como mínimo `DELTA_MIN_OPS_CAPACITY`).
+*
+* @Retorno: Bytes escritos en `ops`; 0 cuando ya se ha generado todo el delta.
+*
+************************************************/
+size_t DELTA_nextOps(DeltaEncoder *encoder, uint8_t *ops, size_t capacity) {
+    const DeltaSignature *signature = encoder->signature;
+    size_t used = 0;
+
+    while (encoder->position < encoder->size) {
+        int block = DELTA_findBlock(encoder);
+        off_t length;
+
+        if (block >= 0) {
+            //el literal d'abans ha de sortir primer; si no hi cap sencer, la finestra es torna a provar a la crida següent
+            if (encoder->position > encoder->literal_start) {
+                if (capacity - used <= DELTA_LITERAL_HEADER_SIZE) return used;
+                used += DELTA_emitLiteral(encoder, ops + used, capacity - used);
+                if (encoder->position > encoder->literal_start) return used;
+            }
+            if (encoder->copy_count > 0 && encoder->copy_block + encoder->copy_count != block) {
+                if (capacity - used < DELTA_COPY_SIZE) return used;
+                used += DELTA_emitCopy(encoder, ops + used);
+            }
+            if (encoder->copy_count == 0) encoder->copy_block = block;
+            encoder->copy_count++;
+
+            length = (off_t)block * signature->block_size + signature->block_size > signature->basis_size
+                   ? signature->basis_size - (off_t)block * signature->block_size : (off_t)signature->block_size;
+            encoder->position += length;
+            encoder->copied_bytes += length;
+            encoder->literal_start = encoder->position;
+            encoder->rolling = 0;
+            continue;
+        }
+
+        if (encoder->copy_count > 0) {
+            if (capacity - used < DELTA_COPY_SIZE) return used;
+            used += DELTA_emitCopy(encoder, ops + used);
+        }
+
+        //la finestra avança un byte: el que surt passa al literal i el checksum es roda amb el que entra
+        if (encoder->rolling && encoder->position + (off_t)signature->block_size < encoder->size) {
+            uint32_t out = encoder->data[encoder->position];
+            uint32_t in = encoder->data[encoder->position + signature->block_size];
+
+            encoder->a = (encoder->a - out + in) & 0xffff;
+            encoder->b = (encoder->b - signature->block_size * out + encoder->a) & 0xffff;
+        } else {
+            encoder->rolling = 0;
+        }
+        encoder->position++;
+
+        //el literal surt quan omple el que queda del buffer, així les trames surten mentre es recorre el fitxer
+        length = encoder->position - encoder->literal_start;
+        if (capacity - used <= DELTA_LITERAL_HEADER_SIZE || (size_t)length >= capacity - used - DELTA_LITERAL_HEADER_SIZE) {
+            if (capacity - used > DELTA_LITERAL_HEADER_SIZE) used += DELTA_emitLiteral(encoder, ops + used, capacity - used);
+            return used;
+        }
+    }
+
+    //final del fitxer: surt el que quedi pendent
+    if (encoder->copy_count > 0) {
+        if (capacity - used < DELTA_COPY_SIZE) return used;
+        used += DELTA_emitCopy(encoder, ops + used);
+    }
+    if (encoder->position > encoder->literal_start && capacity - used > DELTA_LITERAL_HEADER_SIZE) {
+        used += DELTA_emitLiteral(encoder, ops + used, capacity - used);
+    }
+    return used;
+}
+
+/***********************************************
+*
+* @Finalidad: Preparar la reconstrucción de un fichero a partir de su versión anterior.
+*
+* @Parámetros:
+* out: patch = Reconstrucción a preparar.
+* in: basis_path = Ruta de la versión anterior.
+* in: target_path = Ruta del fichero que se reconstruye. Se trunca y se reserva entero.
+* in: target_size = Tamaño final del fichero nuevo.
+* in: signature = Signatura de la versión anterior que se ha enviado al emisor.
+*
+* @Retorno:
+*           0 = Reconstrucción preparada.
+*          -1 = Error al abrir o reservar los ficheros.
+*
+************************************************/
+int DELTA_openPatch(DeltaPatch *patch, const char *basis_path, const char *target_path, off_t target_size, const DeltaSignature *signature) {
+    struct stat basis_stat;
+
+    memset(patch, 0, sizeof(DeltaPatch));
+    patch->basis_fd = open(basis_path, O_RDONLY);
+    if (patch->basis_fd < 0) return -1;
+
+    //si la versió anterior ha canviat des que se'n va fer la signatura, les còpies no serien vàlides
+    if (fstat(patch->basis_fd, &basis_stat) < 0 || basis_stat.st_size != signature->basis_size) {
+        close(patch->basis_fd);
+        return -1;
+    }
+
+    patch->target_fd = open(target_path, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if (patch->target_fd < 0 || ftruncate(patch->target_fd, target_size) < 0) {
+        if (patch->target_fd >= 0) close(patch->target_fd);
+        close(patch->basis_fd);
+        return -1;
+    }
+
+    patch->basis_size = signature->basis_size;
+    patch->block_size = signature->block_size;
+    patch->n_blocks = signature->n_blocks;
+    patch->target_size = target_size;
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalidad: Copiar un tramo de la versión anterior al fichero nuevo.
+*
+* @Parámetros:
+* in/out: patch = Reconstrucción en curso.
+* in: source = Posición del tramo en la versión anterior.
+* in: length = Bytes del tramo.
+*
+* @Retorno:
+*           0 = Tramo copiado a continuación de lo ya reconstruido.
+*          -1 = Error de lectura o escritura.
+*
+************************************************/
+static int DELTA_copyRange(DeltaPatch *patch, off_t source, off_t length) {
+    off_t target = patch->offset;
+    off_t end = source + length;
+
+    //primer sense passar per memòria d'usuari; si el sistema de fitxers no ho permet, amb pread/pwrite
+    while (source < end) {
+        ssize_t copied = copy_file_range(patch->basis_fd, &source, patch->target_fd, &target, (size_t)(end - source), 0);
+        if (copied < 0 && errno == EINTR) continue;
+        if (copied <= 0) break;
+    }
+
+    while (source < end) {
+        uint8_t buffer[DELTA_COPY_BUFFER_SIZE];
+        size_t want = end - source > DELTA_COPY_BUFFER_SIZE ? DELTA_COPY_BUFFER_SIZE : (size_t)(end - source);
+        ssize_t got = pread(patch->basis_fd, buffer, want, source);
+
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return -1;
+        for (ssize_t written = 0; written < got; ) {
+            ssize_t n = pwrite(patch->target_fd, buffer + written, (size_t)(got - written), target + written);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return -1;
+            written += n;
+        }
+        source += got;
+        target += got;
+    }
+
+    patch->offset += length;
+    patch->copied_bytes += length;
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalidad: Aplicar un tramo de operaciones del delta, escribiendo sus bytes a
+*             continuación de lo ya reconstruido. Las copias pasan de un fichero al otro
+*             sin copiarse a memoria de usuario (`copy_file_range`) siempre que se puede.
+*
+* @Parámetros:
+* in/out: patch = Reconstrucción en curso.
+* in: ops = Operaciones completas (ninguna queda partida entre dos tramos).
+* in: length = Bytes de `ops`.
+*
+* @Retorno:
+*           0 = Operaciones aplicadas.
+*          -1 = Operación mal formada, fuera de los ficheros o error de escritura.
+*
+************************************************/
+int DELTA_applyOps(DeltaPatch *patch, const uint8_t *ops, size_t length) {
+    size_t i = 0;
+
+    while (i < length) {
+        if (ops[i] == DELTA_OP_COPY) {
+            uint32_t first, count;
+            off_t source, bytes;
+
+            if (length - i < DELTA_COPY_SIZE) return -1;
+            first = DELTA_getUint32(ops + i + 1);
+            count = DELTA_getUint32(ops + i + 5);
+            if (count == 0 || first >= (uint32_t)patch->n_blocks || count > (uint32_t)patch->n_blocks - first) return -1;
+
+            source = (off_t)first * patch->block_size;
+            bytes = (off_t)count * patch->block_size;
+            if (source + bytes > patch->basis_size) bytes = patch->basis_size - source;
+            if (patch->offset + bytes > patch->target_size || DELTA_copyRange(patch, source, bytes) < 0) return -1;
+            i += DELTA_COPY_SIZE;
+        } else if (ops[i] == DELTA_OP_LITERAL) {
+            uint32_t literal;
+
+            if (length - i < DELTA_LITERAL_HEADER_SIZE) return -1;
+            literal = DELTA_getUint32(ops + i + 1);
+            if (literal > length - i - DELTA_LITERAL_HEADER_SIZE || patch->offset + (off_t)literal > patch->target_size) return -1;
+            i += DELTA_LITERAL_HEADER_SIZE;
+
+            for (uint32_t written = 0; written < literal; ) {
+                ssize_t n = pwrite(patch->target_fd, ops + i + written, literal - written, patch->offset + written);
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) return -1;
+                written += (uint32_t)n;
+            }
+            patch->offset += literal;
+            patch->literal_bytes += literal;
+            i += literal;
+        } else {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalidad: Cerrar los ficheros de una reconstrucción.
+*
+* @Parámetros:
+* in/out: patch = Reconstrucción a cerrar.
+*
+* @Retorno:
+*           0 = El fichero nuevo está completo.
+*          -1 = Faltan bytes por reconstruir.
+*
+************************************************/
+int DELTA_closePatch(DeltaPatch *patch) {
+    close(patch->basis_fd);
+    close(patch->target_fd);
+    return patch->offset == patch->target_size ? 0 : -1;
+}
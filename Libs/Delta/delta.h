@@ -0,0 +1,254 @@
+/***********************************************
+*
+* @Autores: Alexandre Contreras y Armand López
+* @Propósito: Proveer la transferencia de un fichero como delta respecto a una versión
+*             anterior que ya tiene el receptor (al estilo de rsync): el receptor resume
+*             su versión en bloques con un checksum rodante y un MD5, el emisor busca
+*             esos bloques en cualquier posición del fichero nuevo y solo envía los bytes
+*             que no encuentra, y el receptor reconstruye el fichero con las dos partes.
+* @Fecha de creación: 16 de octubre de 2026
+* @Última modificación: 16 de octubre de 2026
+*
+************************************************/
+
+#ifndef _DELTA_CUSTOM_H_
+#define _DELTA_CUSTOM_H_
+
+//Constant del sistema
+#define _GNU_SOURCE
+
+//Libreries del sistema
+#include <stdint.h>    // uint8_t, uint32_t
+#include <stdlib.h>    // malloc, calloc, free
+#include <string.h>    // memcpy, memcmp
+#include <unistd.h>    // pread, pwrite, close, ftruncate, copy_file_range
+#include <fcntl.h>     // open, O_RDONLY, O_RDWR, O_CREAT, O_TRUNC
+#include <errno.h>     // errno, EINTR
+#include <sys/types.h> // off_t
+#include <sys/stat.h>  // fstat
+
+//Llibreries pròpies
+#include "../Hash/hash.h"
+
+//Constants
+#define DELTA_MIN_BLOCK_SIZE 2048            // Bytes mínims d'un bloc de la versió anterior
+#define DELTA_MAX_BLOCK_SIZE (128 * 1024)    // Bytes màxims d'un bloc de la versió anterior
+#define DELTA_SIGNATURE_SIZE (4 + HASH_MD5_SIZE)   // Bytes de la signatura d'un bloc: checksum rodant (big endian) i MD5
+#define DELTA_OP_COPY 0x01                   // Operació: copiar blocs consecutius de la versió anterior
+#define DELTA_OP_LITERAL 0x02                // Operació: escriure els bytes que segueixen
+#define DELTA_COPY_SIZE 9                    // Bytes d'una operació de còpia (tipus, primer bloc i nombre de blocs, big endian)
+#define DELTA_LITERAL_HEADER_SIZE 5          // Bytes de la capçalera d'un literal (tipus i longitud, big endian)
+#define DELTA_MIN_OPS_CAPACITY 64            // Bytes mínims del buffer on es generen les operacions
+#define DELTA_EMPTY_SIGNATURE {NULL, NULL, NULL, NULL, 0, 0, 0, 0, 0}   // Inicialitzador d'una signatura buida (equivalent a DELTA_initSignature)
+
+typedef struct {
+    uint32_t *weak;          // Checksum rodant de cada bloc
+    uint8_t *strong;         // MD5 de cada bloc, un darrere l'altre
+    int *buckets;            // Taula de dispersió dels blocs sencers pel seu checksum rodant (-1 = buida)
+    int *next;               // Següent bloc amb el mateix índex de la taula (-1 = cap)
+    uint32_t n_buckets;      // Mida de la taula (potència de 2)
+    int n_blocks;            // Blocs de la versió anterior (l'últim pot ser més curt)
+    int n_full_blocks;       // Blocs de `block_size` bytes sencers
+    uint32_t block_size;
+    off_t basis_size;        // Bytes de la versió anterior
+} DeltaSignature;            // Signatura de la versió anterior d'un fitxer
+
+typedef struct {
+    const DeltaSignature *signature;
+    const uint8_t *data;     // Fitxer nou projectat en memòria
+    off_t size;
+    off_t position;          // Inici de la finestra que es compara amb els blocs
+    off_t literal_start;     // Primer byte que encara no s'ha enviat ni s'ha trobat en un bloc
+    uint32_t a, b;           // Checksum rodant de la finestra (vàlid si `rolling`)
+    int rolling;
+    int copy_block;          // Còpia pendent de generar: primer bloc i nombre de blocs consecutius
+    int copy_count;
+    off_t literal_bytes;     // Bytes enviats com a literals
+    off_t copied_bytes;      // Bytes trobats a la versió anterior
+} DeltaEncoder;              // Generació incremental de les operacions d'un delta
+
+typedef struct {
+    int basis_fd;            // Versió anterior (lectura)
+    int target_fd;           // Fitxer que es reconstrueix (lectura i escriptura, per resumir-lo a mesura que es reconstrueix)
+    off_t basis_size;
+    uint32_t block_size;
+    int n_blocks;
+    off_t target_size;
+    off_t offset;            // Bytes del fitxer nou ja reconstruïts
+    off_t literal_bytes;     // Bytes rebuts com a literals
+    off_t copied_bytes;      // Bytes copiats de la versió anterior
+} DeltaPatch;                // Reconstrucció d'un fitxer a partir de la versió anterior i un delta
+
+//Funcions
+
+/***********************************************
+*
+* @Finalidad: Dejar una `DeltaSignature` vacía, sin bloques.
+*
+* @Parámetros:
+* out: signature = Signatura a inicializar.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void DELTA_initSignature(DeltaSignature *signature);
+
+/***********************************************
+*
+* @Finalidad: Liberar la memoria de una signatura y dejarla vacía.
+*
+* @Parámetros:
+* in/out: signature = Signatura a liberar.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void DELTA_freeSignature(DeltaSignature *signature);
+
+/***********************************************
+*
+* @Finalidad: Escoger el tamaño de bloque de la versión anterior de un fichero: cerca de
+*             la raíz cuadrada de su tamaño (como rsync), de modo que ni las signaturas ni
+*             los bytes que se reenvían alrededor de cada cambio crecen demasiado.
+*
+* @Parámetros:
+* in: basis_size = Tamaño en bytes de la versión anterior.
+*
+* @Retorno: Bytes de cada bloque, entre `DELTA_MIN_BLOCK_SIZE` y `DELTA_MAX_BLOCK_SIZE`.
+*
+************************************************/
+uint32_t DELTA_chooseBlockSize(off_t basis_size);
+
+/***********************************************
+*
+* @Finalidad: Calcular la signatura de la versión anterior de un fichero (el checksum
+*             rodante y el MD5 de cada bloque) leyéndola una sola vez.
+*
+* @Parámetros:
+* out: signature = Signatura del fichero. Se libera la anterior.
+* in: basis_path = Ruta de la versión anterior.
+* in: block_size = Bytes de cada bloque (e.g., de `DELTA_chooseBlockSize`).
+*
+* @Retorno:
+*           0 = Signatura calculada.
+*          -1 = Error al leer el fichero o de memoria.
+*
+************************************************/
+int DELTA_buildSignature(DeltaSignature *signature, const char *basis_path, uint32_t block_size);
+
+/***********************************************
+*
+* @Finalidad: Cargar la signatura recibida del receptor y preparar la búsqueda de sus
+*             bloques por checksum rodante.
+*
+* @Parámetros:
+* out: signature = Signatura a cargar. Se libera la anterior.
+* in: basis_size = Tamaño en bytes de la versión anterior.
+* in: block_size = Bytes de cada bloque.
+* in: data = Signaturas de los bloques (`DELTA_SIGNATURE_SIZE` bytes cada una).
+* in: length = Bytes de `data`.
+*
+* @Retorno:
+*           0 = Signatura cargada.
+*          -1 = Tamaños que no corresponden o error de memoria.
+*
+************************************************/
+int DELTA_setSignature(DeltaSignature *signature, off_t basis_size, uint32_t block_size, const uint8_t *data, size_t length);
+
+/***********************************************
+*
+* @Finalidad: Serializar las signaturas de los bloques para enviarlas.
+*
+* @Parámetros:
+* in: signature = Signatura calculada con `DELTA_buildSignature`.
+* out: data = Buffer de `n_blocks * DELTA_SIGNATURE_SIZE` bytes.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void DELTA_packSignature(const DeltaSignature *signature, uint8_t *data);
+
+/***********************************************
+*
+* @Finalidad: Preparar la generación del delta de un fichero respecto a una signatura.
+*
+* @Parámetros:
+* out: encoder = Generador a preparar.
+* in: signature = Signatura de la versión anterior. Debe existir mientras se use.
+* in: data = Fichero nuevo proyectado en memoria.
+* in: size = Bytes del fichero nuevo.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void DELTA_initEncoder(DeltaEncoder *encoder, const DeltaSignature *signature, const uint8_t *data, off_t size);
+
+/***********************************************
+*
+* @Finalidad: Generar las siguientes operaciones del delta en un buffer. El fichero se
+*             recorre con una ventana del tamaño de bloque: si su checksum rodante y su
+*             MD5 coinciden con un bloque de la versión anterior se genera una copia (los
+*             bloques consecutivos se juntan en una sola) y si no, la ventana avanza un
+*             byte y el byte que sale queda como literal.
+*
+* @Parámetros:
+* in/out: encoder = Generador preparado con `DELTA_initEncoder`.
+* out: ops = Buffer donde se escriben las operaciones.
+* in: capacity = Bytes de `ops` (como mínimo `DELTA_MIN_OPS_CAPACITY`).
+*
+* @Retorno: Bytes escritos en `ops`; 0 cuando ya se ha generado todo el delta.
+*
+************************************************/
+size_t DELTA_nextOps(DeltaEncoder *encoder, uint8_t *ops, size_t capacity);
+
+/***********************************************
+*
+* @Finalidad: Preparar la reconstrucción de un fichero a partir de su versión anterior.
+*
+* @Parámetros:
+* out: patch = Reconstrucción a preparar.
+* in: basis_path = Ruta de la versión anterior.
+* in: target_path = Ruta del fichero que se reconstruye. Se trunca y se reserva entero.
+* in: target_size = Tamaño final del fichero nuevo.
+* in: signature = Signatura de la versión anterior que se ha enviado al emisor.
+*
+* @Retorno:
+*           0 = Reconstrucción preparada.
+*          -1 = Error al abrir o reservar los ficheros.
+*
+************************************************/
+int DELTA_openPatch(DeltaPatch *patch, const char *basis_path, const char *target_path, off_t target_size, const DeltaSignature *signature);
+
+/***********************************************
+*
+* @Finalidad: Aplicar un tramo de operaciones del delta, escribiendo sus bytes a
+*             continuación de lo ya reconstruido. Las copias pasan de un fichero al otro
+*             sin copiarse a memoria de usuario (`copy_file_range`) siempre que se puede.
+*
+* @Parámetros:
+* in/out: patch = Reconstrucción en curso.
+* in: ops = Operaciones completas (ninguna queda partida entre dos tramos).
+* in: length = Bytes de `ops`.
+*
+* @Retorno:
+*           0 = Operaciones aplicadas.
+*          -1 = Operación mal formada, fuera de los ficheros o error de escritura.
+*
+************************************************/
+int DELTA_applyOps(DeltaPatch *patch, const uint8_t *ops, size_t length);
+
+/***********************************************
+*
+* @Finalidad: Cerrar los ficheros de una reconstrucción.
+*
+* @Parámetros:
+* in/out: patch = Reconstrucción a cerrar.
+*
+* @Retorno:
+*           0 = El fichero nuevo está completo.
+*          -1 = Faltan bytes por reconstruir.
+*
+************************************************/
+int DELTA_closePatch(DeltaPatch *patch);
+
+#endif // _DELTA_CUSTOM_H_
@@ -29,7 +29,7 @@
 *           Retorna NULL si ocurre un error al construir la ruta. 
 * 
 ************************************************/
-char* FILE_buildPrivateFilePath(char* distortions_folder_path, char* filename, char* username) {
+char* FILE_buildPrivateFilePath(char* distortions_folder_path, const char* filename, const char* username) {
     char* full_path = NULL;  
 
     if(!username) {
@@ -64,6 +64,200 @@ char* FILE_buildSharedFilePath(char* filename, char* username) {
     return global_file_path; 
 }
 
+/*********************************************** 
+* 
+* @Finalidad: Comprobar que un nombre recibido del par (de usuario o de archivo) se puede 
+*             usar como un único componente de una ruta: no está vacío y no contiene `/` 
+*             ni `..`, de modo que no puede salir de la carpeta donde se construye la ruta. 
+* 
+* @Parámetros: 
+* in: name = Nombre a comprobar. 
+* 
+* @Retorno: 
+*           1 = El nombre es seguro. 
+*           0 = El nombre es NULL, está vacío o contiene `/` o `..`. 
+* 
+************************************************/
+int FILE_isSafeName(const char* name) {
+    return name && *name && !strchr(name, '/') && !strstr(name, "..");
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Construir la ruta donde se conserva la última versión recibida de un archivo 
+*             de un usuario, dentro de la carpeta privada, para recibir la siguiente como delta. 
+*             Cada usuario tiene su propia subcarpeta, de modo que dos pares usuario-archivo 
+*             distintos nunca comparten ruta. 
+* 
+* @Parámetros: 
+* in: distortions_folder_path = Ruta base de la carpeta de distorsiones privadas. 
+* in: filename = Nombre del archivo. 
+* in: username = Nombre del usuario asociado al archivo. 
+* 
+* @Retorno: 
+*           Puntero a una cadena que contiene la ruta de la versión conservada. 
+*           Retorna NULL si ocurre un error al construir la ruta. 
+* 
+************************************************/
+char* FILE_buildBasisFilePath(char* distortions_folder_path, const char* filename, const char* username) {
+    char* full_path = NULL;
+
+    // Els noms arriben del par: si no els validem, "../" permetria escriure o llegir fora de la subcarpeta de l'usuari
+    if (!FILE_isSafeName(filename) || !FILE_isSafeName(username)) return NULL;
+
+    // El punt inicial amaga la subcarpeta dels llistats i la distingeix dels fitxers que s'estan distorsionant
+    if (asprintf(&full_path, ".%s/.last_%s/%s", distortions_folder_path, username, filename) < 0) return NULL;
+    return full_path;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Conservar un archivo como la última versión recibida de un usuario (ver 
+*             `FILE_buildBasisFilePath`) sin copiar su contenido: se enlaza (`link`) con un 
+*             nombre temporal en la misma carpeta y sustituye a la versión anterior con 
+*             `rename`, de modo que quien la lea para reconstruir un delta nunca ve una versión 
+*             a medias. Quien llama no debe reescribir después `source_path` en el mismo 
+*             archivo, sino sustituirlo por uno nuevo. Después se recorta la carpeta con 
+*             `FILE_trimBasisCache`. 
+* 
+* @Parámetros: 
+* in: distortions_folder_path = Ruta base de la carpeta de distorsiones privadas. 
+* in: filename = Nombre del archivo. 
+* in: username = Nombre del usuario asociado al archivo. 
+* in: source_path = Ruta del archivo que se conserva. 
+* 
+* @Retorno: 
+*           0 = El archivo sustituye a la versión anterior. 
+*          -1 = Algún nombre no es seguro (ver `FILE_isSafeName`) o no se ha podido crear la 
+*               subcarpeta, enlazar el archivo o renombrar el enlace (la versión anterior, 
+*               si la había, se mantiene). 
+* 
+************************************************/
+int FILE_keepBasisFile(char* distortions_folder_path, const char* filename, const char* username, const char* source_path) {
+    char* basis_path = FILE_buildBasisFilePath(distortions_folder_path, filename, username);
+    char* tmp_path = NULL;
+    int result = -1;
+    if (!basis_path) return -1;
+
+    // La subcarpeta de l'usuari es crea la primera vegada
+    char* slash = strrchr(basis_path, '/');
+    *slash = '\0';
+    int folder_ready = mkdir(basis_path, 0700) == 0 || errno == EEXIST;
+    *slash = '/';
+
+    if (folder_ready && asprintf(&tmp_path, "%s.XXXXXX", basis_path) >= 0) {
+        int tmp_fd = mkstemp(tmp_path);
+        if (tmp_fd >= 0) {
+            // mkstemp només reserva un nom únic: l'enllaç necessita que no existeixi
+            close(tmp_fd);
+            unlink(tmp_path);
+            if (link(source_path, tmp_path) == 0) {
+                if (rename(tmp_path, basis_path) == 0) result = 0;
+                else unlink(tmp_path);
+            }
+        }
+    }
+
+    if (result == 0) FILE_trimBasisCache(distortions_folder_path, basis_path);
+    free(tmp_path);
+    free(basis_path);
+    return result;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Marcar una versión conservada (ver `FILE_buildBasisFilePath`) como usada ahora, 
+*             actualizando su fecha de modificación, para que `FILE_trimBasisCache` 
+*             la descarte la última. 
+* 
+* @Parámetros: 
+* in: basis_path = Ruta de la versión conservada. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void FILE_touchBasisFile(const char* basis_path) {
+    utimensat(AT_FDCWD, basis_path, NULL, 0);
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Mantener la carpeta de versiones conservadas de todos los usuarios por debajo 
+*             de `FILE_BASIS_CACHE_MAX_BYTES`, borrando primero las que hace más tiempo que 
+*             no se usan (fecha de modificación más antigua). 
+* 
+* @Parámetros: 
+* in: distortions_folder_path = Ruta base de la carpeta de distorsiones privadas. 
+* in: keep_path = Ruta de la versión que se acaba de conservar, que nunca se borra. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void FILE_trimBasisCache(char* distortions_folder_path, const char* keep_path) {
+    char* root_path = NULL;
+    BasisEntry* entries = NULL;
+    int n_entries = 0;
+    long long total_bytes = 0;
+
+    if (asprintf(&root_path, ".%s", distortions_folder_path) < 0) return;
+    DIR* root = opendir(root_path);
+    if (!root) {
+        free(root_path);
+        return;
+    }
+
+    // Recollim els fitxers de totes les subcarpetes .last_<usuari>
+    struct dirent* user_entry;
+    while ((user_entry = readdir(root)) != NULL) {
+        if (strncmp(user_entry->d_name, ".last_", 6)) continue;
+        char* user_path = NULL;
+        if (asprintf(&user_path, "%s/%s", root_path, user_entry->d_name) < 0) continue;
+        DIR* user_dir = opendir(user_path);
+        struct dirent* file_entry;
+        while (user_dir && (file_entry = readdir(user_dir)) != NULL) {
+            struct stat file_stat;
+            char* file_path = NULL;
+            if (asprintf(&file_path, "%s/%s", user_path, file_entry->d_name) < 0) continue;
+            if (stat(file_path, &file_stat) < 0 || !S_ISREG(file_stat.st_mode)) {
+                free(file_path);
+                continue;
+            }
+            total_bytes += file_stat.st_size;
+
+            // La versió que s'acaba de conservar compta per al total però no es pot esborrar
+            BasisEntry* grown = NULL;
+            if (!strcmp(file_path, keep_path) || !(grown = realloc(entries, (n_entries + 1) * sizeof(BasisEntry)))) {
+                free(file_path);
+                continue;
+            }
+            entries = grown;
+            entries[n_entries].path = file_path;
+            entries[n_entries].size = file_stat.st_size;
+            entries[n_entries].last_use = file_stat.st_mtime;
+            n_entries++;
+        }
+        if (user_dir) closedir(user_dir);
+        free(user_path);
+    }
+    closedir(root);
+
+    // Esborrem la menys usada fins que el total torna a cabre
+    while (total_bytes > FILE_BASIS_CACHE_MAX_BYTES && n_entries > 0) {
+        int oldest = 0;
+        for (int i = 1; i < n_entries; i++) {
+            if (entries[i].last_use < entries[oldest].last_use) oldest = i;
+        }
+        unlink(entries[oldest].path);
+        total_bytes -= entries[oldest].size;
+        free(entries[oldest].path);
+        entries[oldest] = entries[--n_entries];
+    }
+
+    for (int i = 0; i < n_entries; i++) free(entries[i].path);
+    free(entries);
+    free(root_path);
+}
+
 /*********************************************** 
 * 
 * @Finalidad: Copiar un archivo desde una ruta de origen a una ruta de destino 
@@ -75,11 +269,12 @@ char* FILE_buildSharedFilePath(char* filename, char* username) {
 * 
 * @Retorno: 
 *           0 = La copia del archivo se realizó con éxito. 
-*          -1 = Ocurrió un error durante el fork o la ejecución de la copia. 
+*          -1 = Ocurrió un error durante el fork, la ejecución de `cp` o la copia. 
 * 
 ************************************************/
 int FILE_copyFile(const char *source_path, const char *destination_path) {
     pid_t pid;
+    int status = 0;
 
     pid = fork();  // Fem un fork per generar el procés fill
     if (pid == -1) {
@@ -92,13 +287,13 @@ int FILE_copyFile(const char *source_path, const char *destination_path) {
         // Executem la comanda 'cp' per copiar el fitxer
         execlp("cp", "cp", source_path, destination_path, (char *)NULL);
 
-        // Si arribem a aquest punt significa que no s'ha substituït el codi del procés fill pel programa 'cp'
-        return -1;
-    } else {
-        // Codi del procés pare
-        wait(NULL);  // Esperem a que el procés fill acabi
+        // Si arribem a aquest punt significa que no s'ha substituït el codi del procés fill pel programa 'cp'; el fill no pot continuar executant el codi del pare
+        _exit(EXIT_FAILURE);
     }
 
+    // Codi del procés pare: esperem aquest fill (no un altre d'un altre thread) i comprovem que 'cp' hagi acabat bé
+    if (waitpid(pid, &status, 0) == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) return -1;
+
     return 0;  // Còpia realitzada amb èxit
 }
 
@@ -281,62 +476,20 @@ char* FILE_determineFileType(const char *filename, pthread_mutex_t *print_mutex)
 
 /*********************************************** 
 * 
-* @Finalidad: Calcular el hash MD5 de un archivo especificado utilizando el comando `md5sum`. 
+* @Finalidad: Calcular el hash MD5 de un archivo especificado leyéndolo en el propio proceso. 
 * 
 * @Parámetros: 
 * in: file_path = Ruta completa del archivo cuyo MD5 se desea calcular. 
 * 
 * @Retorno: 
 *           Puntero a una cadena dinámica que contiene el hash MD5 del archivo. 
-*           Retorna NULL si ocurre un error durante la operación (e.g., fallo en el fork, 
-*           error en la ejecución de `md5sum` o problemas con la pipe). 
+*           Retorna NULL si ocurre un error durante la operación (e.g., no se puede 
+*           abrir o leer el archivo). 
 * 
 ************************************************/
 char* FILE_calculateMD5(const char *file_path) {
-    int pipe_fd[2];  
-    pid_t pid;
-
-    // Creem una pipe
-    if (pipe(pipe_fd) == -1) {
-        return NULL;
-    }
-
-    pid = fork();  // Fem un fork per generar el procés fill on carregarem el programa md5sum
-    if (pid == -1) {
-        perror("fork failed");
-        close(pipe_fd[0]); 
-        close(pipe_fd[1]);
-        return NULL;
-    }
-
-    // Codi del procés fill
-    if (pid == 0) {
-        close(pipe_fd[0]);  // Tanquem l'extrem de lectura de la pipe
-
-        // Redirigim la sortida estàndard (pantalla) a l'extrem d'escriptura de la pipe 
-        if (dup2(pipe_fd[1], STDOUT_FILENO) == -1) {
-            close(pipe_fd[1]);
-            return NULL;
-        }
-        close(pipe_fd[1]);  // Tanquem pipe d'escriptura una vegada duplicat
-
-        // Carreguem programa md5sum i executem la comanda md5sum sobre el fitxer
-        execlp("md5sum", "md5sum", file_path, (char *)NULL);
-
-        // Si arribem a aquest punt significa que no s'ha substituït el codi del procés fill pel programa md5sum al procés fill
-        return NULL;
-    } else {
-        // Codi del procés pare
-        close(pipe_fd[1]);  // Tanquem extrem d'escriptura
-
-        // Llegim md5sum de la pipe
-        char *md5sum = IO_readUntil(pipe_fd[0], ' ');  
-
-        close(pipe_fd[0]);  // Tanquem extrem de lectura de la pipe
-        wait(NULL);  // Esperem a que acabi procés fill
-
-        return md5sum; // Retornem md5sum
-    }
+    // Resumim el fitxer en el mateix procés, sense fer fork d'md5sum
+    return HASH_fileMD5(file_path);
 }
 
 /*********************************************** 
@@ -31,14 +31,25 @@
 #include <time.h>         // time()
 #include <signal.h>       // Manejo de señales
 #include <ctype.h>        // tolower()
+#include <dirent.h>       // opendir(), readdir()
 
 //Llibreries pròpies
 #include "../IO/io.h"
 #include "../String/string.h"
+#include "../Hash/hash.h"
 
 #define PATH_FLECK  1
 #define PATH_WORKER 2
 
+#define FILE_BASIS_CACHE_MAX_BYTES (256LL * 1024 * 1024)   // Bytes màxims de les versions conservades de tots els usuaris per als deltes
+
+//Tipus propis
+typedef struct {
+    char* path;              // Ruta de la versió conservada
+    off_t size;
+    time_t last_use;         // Data de modificació: es marca cada vegada que s'usa com a base d'un delta
+} BasisEntry;
+
 //Funcions
 
 /*********************************************** 
@@ -56,7 +67,7 @@
 *           Retorna NULL si ocurre un error al construir la ruta. 
 * 
 ************************************************/
-char* FILE_buildPrivateFilePath(char* distortions_folder_path, char* filename, char* username);
+char* FILE_buildPrivateFilePath(char* distortions_folder_path, const char* filename, const char* username);
 
 /*********************************************** 
 * 
@@ -74,6 +85,95 @@ char* FILE_buildPrivateFilePath(char* distortions_folder_path, char* filename, c
 ************************************************/
 char* FILE_buildSharedFilePath(char* filename, char* username);
 
+/*********************************************** 
+* 
+* @Finalidad: Comprobar que un nombre recibido del par (de usuario o de archivo) se puede 
+*             usar como un único componente de una ruta: no está vacío y no contiene `/` 
+*             ni `..`, de modo que no puede salir de la carpeta donde se construye la ruta. 
+* 
+* @Parámetros: 
+* in: name = Nombre a comprobar. 
+* 
+* @Retorno: 
+*           1 = El nombre es seguro. 
+*           0 = El nombre es NULL, está vacío o contiene `/` o `..`. 
+* 
+************************************************/
+int FILE_isSafeName(const char* name);
+
+/*********************************************** 
+* 
+* @Finalidad: Construir la ruta donde se conserva la última versión recibida de un archivo 
+*             de un usuario, dentro de la carpeta privada, para recibir la siguiente como delta. 
+*             Cada usuario tiene su propia subcarpeta, de modo que dos pares usuario-archivo 
+*             distintos nunca comparten ruta. 
+* 
+* @Parámetros: 
+* in: distortions_folder_path = Ruta base de la carpeta de distorsiones privadas. 
+* in: filename = Nombre del archivo. 
+* in: username = Nombre del usuario asociado al archivo. 
+* 
+* @Retorno: 
+*           Puntero a una cadena que contiene la ruta de la versión conservada. 
+*           Retorna NULL si ocurre un error al construir la ruta. 
+* 
+************************************************/
+char* FILE_buildBasisFilePath(char* distortions_folder_path, const char* filename, const char* username);
+
+/*********************************************** 
+* 
+* @Finalidad: Conservar un archivo como la última versión recibida de un usuario (ver 
+*             `FILE_buildBasisFilePath`) sin copiar su contenido: se enlaza (`link`) con un 
+*             nombre temporal en la misma carpeta y sustituye a la versión anterior con 
+*             `rename`, de modo que quien la lea para reconstruir un delta nunca ve una versión 
+*             a medias. Quien llama no debe reescribir después `source_path` en el mismo 
+*             archivo, sino sustituirlo por uno nuevo. Después se recorta la carpeta con 
+*             `FILE_trimBasisCache`. 
+* 
+* @Parámetros: 
+* in: distortions_folder_path = Ruta base de la carpeta de distorsiones privadas. 
+* in: filename = Nombre del archivo. 
+* in: username = Nombre del usuario asociado al archivo. 
+* in: source_path = Ruta del archivo que se conserva. 
+* 
+* @Retorno: 
+*           0 = El archivo sustituye a la versión anterior. 
+*          -1 = Algún nombre no es seguro (ver `FILE_isSafeName`) o no se ha podido crear la 
+*               subcarpeta, enlazar el archivo o renombrar el enlace (la versión anterior, 
+*               si la había, se mantiene). 
+* 
+************************************************/
+int FILE_keepBasisFile(char* distortions_folder_path, const char* filename, const char* username, const char* source_path);
+
+/*********************************************** 
+* 
+* @Finalidad: Marcar una versión conservada (ver `FILE_buildBasisFilePath`) como usada ahora, 
+*             actualizando su fecha de modificación, para que `FILE_trimBasisCache` 
+*             la descarte la última. 
+* 
+* @Parámetros: 
+* in: basis_path = Ruta de la versión conservada. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void FILE_touchBasisFile(const char* basis_path);
+
+/*********************************************** 
+* 
+* @Finalidad: Mantener la carpeta de versiones conservadas de todos los usuarios por debajo 
+*             de `FILE_BASIS_CACHE_MAX_BYTES`, borrando primero las que hace más tiempo que 
+*             no se usan (fecha de modificación más antigua). 
+* 
+* @Parámetros: 
+* in: distortions_folder_path = Ruta base de la carpeta de distorsiones privadas. 
+* in: keep_path = Ruta de la versión que se acaba de conservar, que nunca se borra. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void FILE_trimBasisCache(char* distortions_folder_path, const char* keep_path);
+
 /*********************************************** 
 * 
 * @Finalidad: Copiar un archivo desde una ruta de origen a una ruta de destino 
@@ -85,7 +185,7 @@ char* FILE_buildSharedFilePath(char* filename, char* username);
 * 
 * @Retorno: 
 *           0 = La copia del archivo se realizó con éxito. 
-*          -1 = Ocurrió un error durante el fork o la ejecución de la copia. 
+*          -1 = Ocurrió un error durante el fork, la ejecución de `cp` o la copia. 
 * 
 ************************************************/
 int FILE_copyFile(const char *source_path, const char *destination_path);
@@ -156,15 +256,15 @@ char* FILE_determineFileType(const char *filename, pthread_mutex_t *print_mutex)
 
 /*********************************************** 
 * 
-* @Finalidad: Calcular el hash MD5 de un archivo especificado utilizando el comando `md5sum`. 
+* @Finalidad: Calcular el hash MD5 de un archivo especificado leyéndolo en el propio proceso. 
 * 
 * @Parámetros: 
 * in: file_path = Ruta completa del archivo cuyo MD5 se desea calcular. 
 * 
 * @Retorno: 
 *           Puntero a una cadena dinámica que contiene el hash MD5 del archivo. 
-*           Retorna NULL si ocurre un error durante la operación (e.g., fallo en el fork, 
-*           error en la ejecución de `md5sum` o problemas con la pipe). 
+*           Retorna NULL si ocurre un error durante la operación (e.g., no se puede 
+*           abrir o leer el archivo). 
 * 
 ************************************************/
 char* FILE_calculateMD5(const char *file_path);
@@ -15,24 +15,34 @@
 
 #include "frame.h"
 
+static __thread unsigned long frame_heap_allocations = 0;   // Reserves de memòria dinàmica fetes pel mòdul de trames en aquest thread
+static __thread unsigned long frame_send_calls = 0;         // Crides a write/writev/sendfile fetes pel mòdul de trames en aquest thread
+
 /*********************************************** 
 * 
-* @Finalidad: Calcular el checksum de una trama (`Frame`) utilizando los campos de 
-*             la estructura, para validar su integridad. 
+* @Finalidad: Calcular el checksum de una trama (`Frame`) para validar su integridad. 
+*             En las tramas v1 es la suma clásica de los campos de la trama, con los 
+*             `DATA_SIZE` bytes del campo de datos (padding incluido), para mantener la 
+*             compatibilidad con peers antiguos. En las v2 es el CRC32C calculado 
+*             únicamente sobre los `data_length` bytes útiles. 
 * 
 * @Parámetros: 
 * in: frame = Puntero a la estructura `Frame` de la cual se calculará el checksum. 
 * 
 * @Retorno: 
-*           Valor `uint16_t` que representa el checksum calculado, obtenido como el 
-*           módulo de la suma acumulada de los campos de la trama. 
+*           Checksum calculado: suma módulo 2^16 en v1 o CRC32C de los datos en v2. 
 * 
 ************************************************/
-uint16_t FRAME_calculateChecksum(const Frame *frame) {
+uint32_t FRAME_calculateChecksum(const Frame *frame) {
+    if (frame->version == FRAME_V2) {
+        return CHECKSUM_crc32c(0, frame->data, frame->data_length);
+    }
+
     uint32_t sum = 0;
+
     sum += frame->type;
     sum += frame->data_length;
-    for (int i = 0; i < DATA_SIZE; i++) {
+    for (uint32_t i = 0; i < DATA_SIZE; i++) {
         sum += frame->data[i];
     }
     sum += frame->timestamp & 0xFFFF;
@@ -41,6 +51,146 @@ uint16_t FRAME_calculateChecksum(const Frame *frame) {
     return (uint16_t)(sum % 65536); //mòdul 2^16
 }
 
+/*********************************************** 
+* 
+* @Finalidad: Reservar en un único bloque la estructura `Frame`, el espacio para la 
+*             cabecera v2 y el campo de datos, de manera que la cabecera y los datos 
+*             queden contiguos y se puedan enviar con una sola escritura. 
+* 
+* @Parámetros: 
+* in: data_length = Número de bytes de datos que tendrá la trama. 
+* 
+* @Retorno: 
+*           Puntero a la trama reservada, con capacidad para al menos `DATA_SIZE` bytes. 
+*           Retorna NULL si ocurre un error al asignar memoria. 
+* 
+************************************************/
+static Frame *FRAME_allocFrame(uint32_t data_length) {
+    //reservem com a mínim DATA_SIZE bytes per poder serialitzar la trama en format v1 amb padding, i un byte extra pel '\0'
+    uint32_t capacity = data_length > DATA_SIZE ? data_length : DATA_SIZE;
+
+    Frame *frame = (Frame *)malloc(sizeof(Frame) + FRAME_STORAGE_SIZE(capacity));
+    if (!frame) return NULL;
+    frame_heap_allocations++;
+
+    FRAME_initFrame(frame, (uint8_t *)(frame + 1), FRAME_STORAGE_SIZE(capacity));
+    frame->data_length = data_length;
+    return frame;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Inicializar una trama sobre un buffer proporcionado por quien llama, sin 
+*             reservar memoria dinámica. Los primeros `FRAME_V2_HEADER_SIZE` bytes del 
+*             buffer se reservan para serializar la cabecera v2 justo antes de los datos. 
+* 
+* @Parámetros: 
+* out: frame = Puntero a la estructura `Frame` a inicializar. 
+* in: storage = Buffer donde residirán la cabecera y los datos de la trama. 
+* in: storage_size = Tamaño del buffer; debe ser al menos `FRAME_STORAGE_SIZE(DATA_SIZE)`. 
+* 
+* @Retorno: 
+*           0 = La trama se ha inicializado correctamente. 
+*          -1 = Parámetros inválidos o buffer demasiado pequeño. 
+* 
+************************************************/
+int FRAME_initFrame(Frame *frame, uint8_t *storage, size_t storage_size) {
+    if (!frame || !storage || storage_size < FRAME_STORAGE_SIZE(DATA_SIZE)) return -1;
+
+    frame->type = 0;
+    frame->data_length = 0;
+    frame->data = storage + FRAME_V2_HEADER_SIZE;
+    frame->capacity = (uint32_t)(storage_size - FRAME_V2_HEADER_SIZE - 1);
+    frame->checksum = 0;
+    frame->timestamp = 0;
+    frame->version = FRAME_V1;
+    frame->compressed = 0;
+    return 0;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Rellenar una trama ya inicializada con el tipo y los datos indicados, 
+*             calculando su timestamp sin reservar memoria. El checksum se calcula una 
+*             sola vez al enviarla, con el formato acordado para la conexión. 
+* 
+* @Parámetros: 
+* in/out: frame = Puntero a la trama a rellenar. 
+* in: type = Tipo de la trama. 
+* in: data = Datos de la trama. Si es NULL o apunta al propio campo de datos de la trama, 
+*            se conservan los bytes ya escritos en él (e.g., leídos directamente de un fichero). 
+* in: dataLength = Longitud de los datos. Si excede la capacidad de la trama se trunca. 
+* 
+* @Retorno: 
+*           0 = La trama se ha rellenado correctamente. 
+*          -1 = Trama nula. 
+* 
+************************************************/
+int FRAME_fillFrame(Frame *frame, int type, const char *data, size_t dataLength) {
+    if (!frame) return -1;
+
+    frame->type = (uint8_t)type;
+    frame->data_length = (uint32_t)(dataLength > frame->capacity ? frame->capacity : dataLength);
+    frame->version = FRAME_V1;
+    if (data && (const uint8_t *)data != frame->data) {
+        memcpy(frame->data, data, frame->data_length);
+    }
+
+    //posem a 0 el padding v1 i el terminador perquè les dades es puguin tractar com a cadena
+    uint32_t padding = frame->data_length < DATA_SIZE ? DATA_SIZE - frame->data_length : 0;
+    memset(frame->data + frame->data_length, 0, padding + 1);
+
+    frame->timestamp = (int32_t)time(NULL);      //generem timestamp
+    frame->checksum = 0;                         //es calcula en enviar-la, segons el format de la connexió
+    frame->compressed = 0;
+    return 0;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Rellenar una trama con los datos indicados comprimidos, si vale la pena. 
+*             Una muestra del inicio decide si los datos son compresibles; si no lo son 
+*             (e.g., jpg, png, wav) o el resultado no ahorra al menos 1/16, los datos se 
+*             copian sin comprimir. Solo debe usarse en conexiones que hayan acordado 
+*             `CONN_CAP_COMPRESSION`. 
+* 
+* @Parámetros: 
+* in/out: frame = Puntero a la trama a rellenar. No puede compartir buffer con `data`. 
+* in: type = Tipo de la trama. 
+* in: data = Datos de la trama sin comprimir. 
+* in: dataLength = Longitud de los datos. Si excede la capacidad de la trama se trunca. 
+* 
+* @Retorno: 
+*           1 = La trama lleva los datos comprimidos. 
+*           0 = La trama lleva los datos sin comprimir. 
+*          -1 = Trama o datos nulos. 
+* 
+************************************************/
+int FRAME_fillFrameCompressed(Frame *frame, int type, const uint8_t *data, size_t dataLength) {
+    if (!frame || !data) return -1;
+
+    uint32_t length = (uint32_t)(dataLength > frame->capacity ? frame->capacity : dataLength);
+
+    if (length > FRAME_COMPRESSED_LENGTH_SIZE && FRAME_lzIsCompressible(data, length)) {
+        //el bloc comprimit ha de cabre, amb la mida original al davant, en 15/16 de les dades originals
+        size_t limit = length - length / 16 - FRAME_COMPRESSED_LENGTH_SIZE;
+        size_t packed = FRAME_lzCompress(data, length, frame->data + FRAME_COMPRESSED_LENGTH_SIZE, limit);
+        if (packed > 0) {
+            frame->data[0] = (length >> 24) & 0xFF;
+            frame->data[1] = (length >> 16) & 0xFF;
+            frame->data[2] = (length >> 8) & 0xFF;
+            frame->data[3] = length & 0xFF;
+            FRAME_fillFrame(frame, type, NULL, packed + FRAME_COMPRESSED_LENGTH_SIZE);
+            frame->compressed = 1;
+            return 1;
+        }
+    }
+
+    //dades incompressibles: s'envien tal qual
+    FRAME_fillFrame(frame, type, (const char *)data, length);
+    return 0;
+}
+
 /*********************************************** 
 * 
 * @Finalidad: Crear y inicializar una nueva estructura `Frame`, asignando memoria dinámica 
@@ -49,7 +199,7 @@ uint16_t FRAME_calculateChecksum(const Frame *frame) {
 * @Parámetros: 
 * in: type = Tipo de la trama, representado como un entero. 
 * in: data = Puntero a los datos que se incluirán en la trama (puede ser NULL). 
-* in: dataLength = Longitud de los datos proporcionados. Si excede `DATA_SIZE`, 
+* in: dataLength = Longitud de los datos proporcionados. Si excede `FRAME_MAX_DATA_SIZE`, 
 *                  se truncará al tamaño máximo permitido. 
 * 
 * @Retorno: 
@@ -58,22 +208,12 @@ uint16_t FRAME_calculateChecksum(const Frame *frame) {
 * 
 ************************************************/
 Frame *FRAME_createFrame(int type, const char *data, size_t dataLength) {
-    Frame *frame = (Frame *)malloc(sizeof(Frame));
-    if (!frame) return NULL;
-
-    uint8_t frameType = (uint8_t)type;
-    uint16_t frameDataLength = (uint16_t)(dataLength > DATA_SIZE ? DATA_SIZE : dataLength);
+    uint32_t frameDataLength = (uint32_t)(dataLength > FRAME_MAX_DATA_SIZE ? FRAME_MAX_DATA_SIZE : dataLength);
 
-    frame->type = frameType;
-    frame->data_length = frameDataLength;
+    Frame *frame = FRAME_allocFrame(frameDataLength);
+    if (!frame) return NULL;
 
-    memset(frame->data, 0, DATA_SIZE); //inicialitzem tot el camp de dades a 0 (padding)
-    if (data) {
-        memcpy(frame->data, data, frame->data_length);
-    }
-    
-    frame->timestamp = (int32_t)time(NULL);      //generem timestamp
-    frame->checksum = FRAME_calculateChecksum(frame);  //calculem checksum
+    FRAME_fillFrame(frame, type, data, frameDataLength);
     return frame;
 }
 
@@ -95,14 +235,14 @@ void FRAME_destroyFrame(Frame *frame) {
 
 /*********************************************** 
 * 
-* @Finalidad: Serializar una estructura `Frame` en un buffer de bytes, convirtiendo 
-*             sus campos en un formato adecuado para la transmisión o almacenamiento. 
+* @Finalidad: Serializar una estructura `Frame` en un buffer de bytes con el formato v1 
+*             de 256 bytes, convirtiendo sus campos en un formato adecuado para la 
+*             transmisión o almacenamiento. 
 * 
 * @Parámetros: 
 * in: frame = Puntero a la estructura `Frame` que se desea serializar. 
 * out: buffer = Puntero al buffer donde se almacenará la representación serializada 
-*               de la trama. El buffer debe tener suficiente espacio para almacenar 
-*               todos los campos de la estructura `Frame`. 
+*               de la trama. El buffer debe tener al menos `FRAME_SIZE` bytes. 
 * 
 * @Retorno: Ninguno. 
 * 
@@ -117,16 +257,16 @@ void FRAME_serializeFrame(const Frame *frame, uint8_t *buffer) {
     //serialitzem camp data length
     buffer[offset] = (frame->data_length >> 8) & 0xFF; //byte alt (8MSB)
     buffer[offset + 1] = frame->data_length & 0xFF;     //byte baix (8LSB)
-    offset += sizeof(frame->data_length);
+    offset += sizeof(uint16_t);
     
     //serialitzem dades
-    memcpy(buffer + offset, frame->data, sizeof(frame->data));
-    offset += sizeof(frame->data);
+    memcpy(buffer + offset, frame->data, DATA_SIZE);
+    offset += DATA_SIZE;
     
     //serialitzem checksum
     buffer[offset] = (frame->checksum >> 8) & 0xFF; //byte alt (8MSB)
     buffer[offset + 1] = frame->checksum & 0xFF;    //byte baix (8LSB)
-    offset += sizeof(frame->checksum);
+    offset += sizeof(uint16_t);
     
     //serialitzem timestamp
     buffer[offset] = (frame->timestamp >> 24) & 0xFF; //byte alt (8MSB)
@@ -137,12 +277,13 @@ void FRAME_serializeFrame(const Frame *frame, uint8_t *buffer) {
 
 /*********************************************** 
 * 
-* @Finalidad: Deserializar un buffer de bytes en una estructura `Frame`, reconstruyendo 
-*             los campos de la trama a partir de su representación serializada. 
+* @Finalidad: Deserializar un buffer de bytes con formato v1 en una estructura `Frame`, 
+*             reconstruyendo los campos de la trama a partir de su representación serializada. 
 * 
 * @Parámetros: 
 * in: buffer = Puntero al buffer que contiene los datos serializados de la trama. 
 * out: frame = Puntero a la estructura `Frame` donde se almacenarán los datos deserializados. 
+*              Su campo de datos debe tener capacidad para `DATA_SIZE` bytes. 
 * 
 * @Retorno: Ninguno. 
 * 
@@ -156,21 +297,305 @@ void FRAME_deserializeFrame(const uint8_t *buffer, Frame *frame) {
     
     //deserialitzem camp data length
     frame->data_length = (buffer[offset] << 8) | buffer[offset + 1]; //shiftem el byte alt i el sumem amb el byte baix
-    offset += sizeof(frame->data_length);
+    offset += sizeof(uint16_t);
     
     //deserialitzem dades
-    memcpy(frame->data, buffer + offset, sizeof(frame->data));
-    offset += sizeof(frame->data);
+    memcpy(frame->data, buffer + offset, DATA_SIZE);
+    offset += DATA_SIZE;
     
     //deserialitzem checksum
     frame->checksum = (buffer[offset] << 8) | buffer[offset + 1];
-    offset += sizeof(frame->checksum);
+    offset += sizeof(uint16_t);
     
     //deseralitzem timestamp
     frame->timestamp = (buffer[offset] << 24) | (buffer[offset + 1] << 16) | //shiftem bytes i fem suma lògica
                        (buffer[offset + 2] << 8) | buffer[offset + 3];
 }
 
+/*********************************************** 
+* 
+* @Finalidad: Serializar la cabecera v2 de una trama (type amb el bit `FRAME_V2_FLAG`, 
+*             data_length de 32 bits, checksum de 32 bits i timestamp) en un buffer de bytes. 
+* 
+* @Parámetros: 
+* in: frame = Puntero a la estructura `Frame` cuya cabecera se desea serializar. 
+* in: with_checksum = 0 si la trama se envía sin checksum (`FRAME_V2_NO_CHECKSUM_FLAG`). 
+* out: buffer = Puntero al buffer de `FRAME_V2_HEADER_SIZE` bytes donde se escribirá. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+static void FRAME_serializeHeaderV2(const Frame *frame, int with_checksum, uint8_t *buffer) {
+    buffer[0] = frame->type | FRAME_V2_FLAG | (with_checksum ? 0 : FRAME_V2_NO_CHECKSUM_FLAG) | (frame->compressed ? FRAME_V2_COMPRESSED_FLAG : 0);
+
+    //serialitzem data length en 4 bytes (big endian)
+    buffer[1] = (frame->data_length >> 24) & 0xFF;
+    buffer[2] = (frame->data_length >> 16) & 0xFF;
+    buffer[3] = (frame->data_length >> 8) & 0xFF;
+    buffer[4] = frame->data_length & 0xFF;
+
+    //serialitzem checksum en 4 bytes (big endian)
+    buffer[5] = (frame->checksum >> 24) & 0xFF;
+    buffer[6] = (frame->checksum >> 16) & 0xFF;
+    buffer[7] = (frame->checksum >> 8) & 0xFF;
+    buffer[8] = frame->checksum & 0xFF;
+
+    //serialitzem timestamp
+    buffer[9] = (frame->timestamp >> 24) & 0xFF;
+    buffer[10] = (frame->timestamp >> 16) & 0xFF;
+    buffer[11] = (frame->timestamp >> 8) & 0xFF;
+    buffer[12] = frame->timestamp & 0xFF;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Escribir exactamente `size` bytes en un socket, reintentando las escrituras 
+*             parciales que se pueden producir con tramas grandes. 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket donde se escribirá. 
+* in: buffer = Bytes a escribir. 
+* in: size = Número de bytes a escribir. 
+* 
+* @Retorno: 
+*           0 = Se han escrito todos los bytes. 
+*          -1 = Error en la escritura. 
+* 
+************************************************/
+static int FRAME_writeAll(int socket, const uint8_t *buffer, size_t size) {
+    size_t written = 0;
+    while (written < size) {
+        ssize_t n = write(socket, buffer + written, size - written);
+        frame_send_calls++;
+        if (n <= 0) return -1;
+        written += n;
+    }
+    return 0;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Escribir en un socket todos los bytes descritos por un array de `iovec`, 
+*             reintentando las escrituras parciales a partir del punto donde se quedaron. 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket donde se escribirá. 
+* in/out: iov = Array de buffers a escribir. Se modifica para avanzar tras escrituras parciales. 
+* in: iov_count = Número de elementos del array. 
+* 
+* @Retorno: 
+*           0 = Se han escrito todos los bytes. 
+*          -1 = Error en la escritura. 
+* 
+************************************************/
+static int FRAME_writevAll(int socket, struct iovec *iov, int iov_count) {
+    while (iov_count > 0) {
+        ssize_t n = writev(socket, iov, iov_count);
+        frame_send_calls++;
+        if (n <= 0) return -1;
+
+        //saltem els buffers escrits del tot i avancem dins del primer que s'ha escrit a mitges
+        while (iov_count > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            iov_count--;
+        }
+        if (iov_count > 0) {
+            iov->iov_base = (uint8_t *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return 0;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Traducir el resultado de una lectura fallida o vacía de un socket al 
+*             código de error de trama correspondiente. 
+* 
+* @Parámetros: 
+* in: n = Valor retornado por `read` o `recv` (0 o negativo). 
+* 
+* @Retorno: 
+*           FRAME_DISCONNECTED = El extremo remoto cerró o reinició la conexión. 
+*           FRAME_PENDING = Descriptor de archivo inválido (socket cerrado localmente). 
+*           FRAME_RECV_ERROR = Cualquier otro error de lectura. 
+* 
+************************************************/
+static FrameErrorCode FRAME_readError(ssize_t n) {
+    if (n == 0) {
+        //La connexió s'ha tancat pel costat remot
+        return FRAME_DISCONNECTED;
+    } else if (errno == ECONNRESET) {
+        // La connexió ha estat reiniciada pel costat remot
+        return FRAME_DISCONNECTED;
+    } else if (errno == EBADF) {
+        // Descriptor de fitxer invàlid. Si el socket s'ha tancat abans de fer la lectura
+        return FRAME_PENDING; //error: bad file descriptor, entrarem a aquesta condició quan es tanqui 
+    }
+    // Qualsevol altre problema amb la lectura
+    return FRAME_RECV_ERROR;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Leer exactamente `size` bytes de un socket, ya que una trama v2 puede 
+*             llegar fragmentada en varios segmentos TCP. 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket desde el cual se leerá. 
+* out: buffer = Buffer donde se almacenarán los bytes leídos. 
+* in: size = Número de bytes a leer. 
+* 
+* @Retorno: 
+*           FRAME_SUCCESS = Se han leído todos los bytes. 
+*           FRAME_DISCONNECTED = El extremo remoto cerró o reinició la conexión. 
+*           FRAME_PENDING = Descriptor de archivo inválido (socket cerrado localmente). 
+*           FRAME_RECV_ERROR = Cualquier otro error de lectura. 
+* 
+************************************************/
+static FrameErrorCode FRAME_readExact(int socket, uint8_t *buffer, size_t size) {
+    size_t received = 0;
+    while (received < size) {
+        ssize_t n = read(socket, buffer + received, size - received);
+        if (n <= 0) return FRAME_readError(n);
+        received += n;
+    }
+    return FRAME_SUCCESS;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Obtener `size` bytes de un lector con buffer. Primero se consumen los bytes 
+*             ya almacenados y, si faltan, se hace `recv` de bloques grandes que pueden 
+*             contener varias tramas. Si lo que falta no cabe en el buffer del lector 
+*             (datos de una trama v2 grande) se lee directamente sobre el destino. 
+* 
+* @Parámetros: 
+* in/out: reader = Lector asociado al socket. 
+* out: buffer = Buffer donde se copiarán los bytes. 
+* in: size = Número de bytes a obtener. 
+* 
+* @Retorno: 
+*           FRAME_SUCCESS, FRAME_DISCONNECTED, FRAME_PENDING o FRAME_RECV_ERROR, con el 
+*           mismo significado que en `FRAME_readExact`. 
+* 
+************************************************/
+static FrameErrorCode FRAME_readerTake(FrameReader *reader, uint8_t *buffer, size_t size) {
+    while (size > 0) {
+        //consumim primer el que ja tenim al buffer
+        size_t buffered = reader->end - reader->start;
+        if (buffered > 0) {
+            size_t n = buffered < size ? buffered : size;
+            memcpy(buffer, reader->buffer + reader->start, n);
+            reader->start += n;
+            buffer += n;
+            size -= n;
+            continue;
+        }
+
+        //el buffer és buit: tornem a començar per l'inici
+        reader->start = reader->end = 0;
+
+        //si el que falta no cap al buffer ho llegim directament al destí per no copiar-ho dos cops
+        if (size >= reader->capacity) return FRAME_readExact(reader->socket, buffer, size);
+
+        ssize_t n = recv(reader->socket, reader->buffer, reader->capacity, 0);
+        if (n <= 0) return FRAME_readError(n);
+        reader->end = (size_t)n;
+    }
+    return FRAME_SUCCESS;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Leer `size` bytes de la conexión, a través del lector con buffer si se 
+*             proporciona o directamente del socket en caso contrario. 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket (se ignora si hay lector). 
+* in/out: reader = Lector con buffer de la conexión (puede ser NULL). 
+* out: buffer = Buffer donde se almacenarán los bytes leídos. 
+* in: size = Número de bytes a leer. 
+* 
+* @Retorno: Igual que `FRAME_readExact`. 
+* 
+************************************************/
+static FrameErrorCode FRAME_readBytes(int socket, FrameReader *reader, uint8_t *buffer, size_t size) {
+    if (reader) return FRAME_readerTake(reader, buffer, size);
+    return FRAME_readExact(socket, buffer, size);
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Preparar una trama v2 del pool para enviarla con cualquier mecanismo de 
+*             escritura (e.g., un envío de io_uring): calcula su checksum si la conexión 
+*             lo usa y serializa su cabecera justo antes de los datos, de modo que la 
+*             trama completa queda en bytes consecutivos de su almacenamiento. 
+* 
+* @Parámetros: 
+* in/out: frame = Trama a preparar (inicializada con `FRAME_initFrame` o del pool). 
+* in: params = Parámetros acordados en el handshake. 
+* out: iov = Bytes que hay que escribir en el socket para enviar la trama. 
+* 
+* @Retorno: 
+*           0 = La trama está lista para enviarse. 
+*          -1 = La conexión no es v2 (las tramas v1 se serializan aparte). 
+* 
+************************************************/
+int FRAME_serializeInPlace(Frame *frame, const ConnectionParams *params, struct iovec *iov) {
+    if (!params || params->frame_version != FRAME_V2) return -1;
+
+    int with_checksum = params->checksum != CONN_CHECKSUM_NONE;
+    frame->version = FRAME_V2;
+    frame->checksum = with_checksum ? FRAME_calculateChecksum(frame) : 0;
+
+    //la capçalera es serialitza just abans de les dades per enviar-ho tot en una sola escriptura
+    uint8_t *header = frame->data - FRAME_V2_HEADER_SIZE;
+    FRAME_serializeHeaderV2(frame, with_checksum, header);
+    iov->iov_base = header;
+    iov->iov_len = FRAME_V2_HEADER_SIZE + frame->data_length;
+    return 0;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Preparar una trama para enviarla con el formato acordado, calculando su 
+*             checksum una sola vez y serializando su cabecera. En v2 la cabecera se 
+*             escribe justo antes de los datos para enviarlo todo desde el almacenamiento 
+*             de la trama; en v1 se serializa la trama completa en `v1_buffer`. 
+* 
+* @Parámetros: 
+* in/out: frame = Trama a preparar. 
+* in: params = Parámetros acordados en el handshake. Si es NULL se usa el formato v1. 
+* out: v1_buffer = Buffer de `FRAME_SIZE` bytes usado solo si la trama se envía en v1. 
+* out: iov = Bytes a escribir en el socket para enviar la trama. 
+* 
+* @Retorno: 
+*           0 = La trama está lista para enviarse. 
+*          -1 = La trama lleva datos comprimidos y la conexión es v1. 
+* 
+************************************************/
+static int FRAME_prepareSend(Frame *frame, const ConnectionParams *params, uint8_t *v1_buffer, struct iovec *iov) {
+    if (params && params->frame_version == FRAME_V2) return FRAME_serializeInPlace(frame, params, iov);
+
+    //el format v1 no té manera d'indicar un payload comprimit
+    if (frame->compressed) return -1;
+
+    //un peer v1 només pot rebre DATA_SIZE bytes de dades
+    frame->version = FRAME_V1;
+    if (frame->data_length > DATA_SIZE) {
+        frame->data_length = DATA_SIZE;
+    }
+
+    //calculem el checksum de la trama i la serialitzem en un buffer de 256 bytes
+    frame->checksum = FRAME_calculateChecksum(frame);
+    FRAME_serializeFrame(frame, v1_buffer);
+    iov->iov_base = v1_buffer;
+    iov->iov_len = FRAME_SIZE;
+    return 0;
+}
+
 /*********************************************** 
 * 
 * @Finalidad: Enviar una estructura `Frame` a través de un socket, serializándola previamente 
@@ -186,17 +611,34 @@ void FRAME_deserializeFrame(const uint8_t *buffer, Frame *frame) {
 * 
 ************************************************/
 int FRAME_sendFrame(int socket, Frame *frame) {
-    if (!frame) return -1;
+    return FRAME_sendFrameWithParams(socket, frame, NULL);
+}
 
-    //calculem el checksum de la trama
-    frame->checksum = FRAME_calculateChecksum(frame);
+/*********************************************** 
+* 
+* @Finalidad: Enviar una trama utilizando el formato acordado con el otro extremo de la 
+*             conexión (v1 de 256 bytes o v2 de longitud variable). En v2 el checksum es 
+*             el CRC32C de los `data_length` bytes de datos, y se omite si la conexión ha 
+*             acordado `CONN_CHECKSUM_NONE`. 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket donde se enviará la trama. 
+* in: frame = Puntero a la estructura `Frame` que se desea enviar. 
+* in: params = Parámetros acordados en el handshake. Si es NULL se usa el formato v1. 
+* 
+* @Retorno: 
+*           0 = La trama fue enviada con éxito. 
+*          -1 = Error al enviar la trama. 
+* 
+************************************************/
+int FRAME_sendFrameWithParams(int socket, Frame *frame, const ConnectionParams *params) {
+    if (!frame) return -1;
 
-    //serialitzem la trama en un buffer de 256 bytes
     uint8_t buffer[FRAME_SIZE];
-    FRAME_serializeFrame(frame, buffer);
+    struct iovec iov;
+    if (FRAME_prepareSend(frame, params, buffer, &iov) < 0) return -1;
 
-    //enviem trama en una sola escriptura de 256 bytes
-    if (write(socket, buffer, FRAME_SIZE) != FRAME_SIZE) {
+    if (FRAME_writeAll(socket, iov.iov_base, iov.iov_len) < 0) {
         perror("Failed to send frame: ");
         return -1;
     }
@@ -206,64 +648,967 @@ int FRAME_sendFrame(int socket, Frame *frame) {
 
 /*********************************************** 
 * 
-* @Finalidad: Recibir una trama (`Frame`) a través de un socket, deserializarla y verificar 
-*             su integridad mediante el cálculo de su checksum. 
+* @Finalidad: Activar o desactivar `TCP_CORK` en un socket. Mientras está activo, el kernel 
+*             acumula los datos y solo emite segmentos completos; al desactivarlo se envía 
+*             lo que quede pendiente. 
 * 
 * @Parámetros: 
-* in: socket = Descriptor del socket desde el cual se recibirá la trama. 
+* in: socket = Descriptor del socket. 
+* in: enable = 1 para activar, 0 para desactivar. 
+* 
+* @Retorno: Ninguno. Si el socket no es TCP la opción simplemente no se aplica. 
+* 
+************************************************/
+static void FRAME_setCork(int socket, int enable) {
+    setsockopt(socket, IPPROTO_TCP, TCP_CORK, &enable, sizeof(enable));
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Enviar varias tramas con el formato acordado usando una sola llamada a 
+*             `writev` por cada `FRAME_SEND_BATCH` tramas, en lugar de una escritura por 
+*             trama. Opcionalmente se activa `TCP_CORK` durante el envío para que el kernel 
+*             solo emita segmentos completos. 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket donde se enviarán las tramas. 
+* in: frames = Array de punteros a las tramas a enviar, en orden. 
+* in: n_frames = Número de tramas del array. 
+* in: params = Parámetros acordados en el handshake. Si es NULL se usa el formato v1. 
+* in: cork = 1 para envolver el envío con `TCP_CORK` (se ignora si el socket no es TCP). 
 * 
 * @Retorno: 
-*           Una estructura `FrameResult` que contiene: 
-*           - `frame`: Puntero a la trama recibida (NULL si hubo un error). 
-*           - `error_code`: Código que indica el resultado de la operación:
-*               - `FRAME_SUCCESS`: La trama se recibió correctamente. 
-*               - `FRAME_DISCONNECTED`: El extremo remoto cerró la conexión. 
-*               - `FRAME_PENDING`: Error debido a un descriptor de archivo inválido. 
-*               - `FRAME_RECV_ERROR`: Error durante la recepción o problemas con el checksum. 
+*           0 = Todas las tramas fueron enviadas con éxito. 
+*          -1 = Error al enviar alguna trama. 
 * 
 ************************************************/
-FrameResult FRAME_receiveFrame(int socket) {
-    uint8_t buffer[FRAME_SIZE];
-    FrameResult result = {NULL, FRAME_SUCCESS};
+int FRAME_sendFrames(int socket, Frame **frames, int n_frames, const ConnectionParams *params, int cork) {
+    if (!frames || n_frames < 0) return -1;
 
-    ssize_t bytes_received = read(socket, buffer, FRAME_SIZE); 
-    if (bytes_received == 0) {
-        //La connexió s'ha tancat pel costat remot
-        result.error_code = FRAME_DISCONNECTED;
-        return result;
-    } else if (bytes_received < 0) {
-        if (errno == ECONNRESET) {
-            // La connexió ha estat reiniciada pel costat remot
-            result.error_code = FRAME_DISCONNECTED;
-        } else if (errno == EBADF) {
-            // Descriptor de fitxer invàlid. Si el socket s'ha tancat abans de fer la lectura
-            result.error_code = FRAME_PENDING; //error: bad file descriptor, entrarem a aquesta condició quan es tanqui 
-        } else {
-            // Qualsevol altre problema amb la lectura
-            result.error_code = FRAME_RECV_ERROR;
-        }
-        return result;
-    }
+    //les trames v2 s'envien des del seu propi emmagatzematge; només les v1 necessiten un buffer de 256 bytes
+    uint8_t v1_buffers[FRAME_SEND_BATCH][FRAME_SIZE];
+    struct iovec iov[FRAME_SEND_BATCH];
+    int result = 0;
 
-    //creem i deserialitzem la trama
-    result.frame = (Frame *)malloc(sizeof(Frame));
-    if (!result.frame) {
-        result.error_code = FRAME_RECV_ERROR;
-        return result;
-    }
+    if (cork) FRAME_setCork(socket, 1);
 
-    FRAME_deserializeFrame(buffer, result.frame);
+    for (int sent = 0; sent < n_frames && result == 0; ) {
+        int batch = n_frames - sent < FRAME_SEND_BATCH ? n_frames - sent : FRAME_SEND_BATCH;
+        for (int i = 0; i < batch; i++) {
+            if (!frames[sent + i] || FRAME_prepareSend(frames[sent + i], params, v1_buffers[i], &iov[i]) < 0) {
+                result = -1;
+                break;
+            }
+        }
 
-    //comprovem el checksum
-    if (result.frame->checksum != FRAME_calculateChecksum(result.frame)) {
-        free(result.frame);
-        // Error en el checksum
-        result.error_code = FRAME_RECV_ERROR;
+        if (result == 0 && FRAME_writevAll(socket, iov, batch) < 0) {
+            int send_errno = errno;     //el conservem perquè qui crida pugui distingir una desconnexió
+            perror("Failed to send frames: ");
+            errno = send_errno;
+            result = -1;
+        }
+        sent += batch;
     }
 
+    if (cork) FRAME_setCork(socket, 0);
     return result;
 }
 
+/*********************************************** 
+* 
+* @Finalidad: Consultar si los paquetes de fichero de una conexión se pueden enviar sin 
+*             copiarlos a memoria de usuario con `FRAME_sendFileFrame`: la conexión debe 
+*             ser v2, con paquetes de al menos `FRAME_ZEROCOPY_MIN_DATA_SIZE` bytes y sin 
+*             compresión (el payload comprimido no existe en el fichero). 
+* 
+* @Parámetros: 
+* in: params = Parámetros acordados en el handshake (puede ser NULL). 
+* 
+* @Retorno: 
+*           1 = Los paquetes de fichero se pueden enviar con `FRAME_sendFileFrame`. 
+*           0 = Hay que leerlos a una trama y enviarlos con `FRAME_sendFrames`. 
+* 
+************************************************/
+int FRAME_canSendFileFrames(const ConnectionParams *params) {
+    return params && params->frame_version == FRAME_V2 && params->data_size >= FRAME_ZEROCOPY_MIN_DATA_SIZE && !(params->capabilities & CONN_CAP_COMPRESSION);
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Calcular el CRC32C de un fragmento de un fichero proyectándolo en memoria, 
+*             de modo que los bytes se leen directamente de la caché de páginas sin 
+*             copiarlos a un buffer. 
+* 
+* @Parámetros: 
+* in: fd = Descriptor del fichero abierto para lectura. 
+* in: offset = Posición del fragmento dentro del fichero. 
+* in: length = Número de bytes del fragmento. 
+* in/out: crc = CRC de los bytes anteriores (e.g., el prefijo de la trama); se actualiza 
+*               con el del fragmento. 
+* 
+* @Retorno: 
+*           0 = CRC calculado. 
+*          -1 = Error al proyectar el fichero. 
+* 
+************************************************/
+static int FRAME_checksumFileRange(int fd, off_t offset, uint32_t length, uint32_t *crc) {
+    if (length == 0) return 0;
+
+    //mmap necessita un offset alineat a pàgina: projectem des de l'inici de la pàgina i saltem el tros de davant
+    off_t page_size = (off_t)sysconf(_SC_PAGESIZE);
+    off_t map_offset = offset - offset % page_size;
+    size_t map_length = (size_t)(offset - map_offset) + length;
+
+    uint8_t *mapped = mmap(NULL, map_length, PROT_READ, MAP_SHARED, fd, map_offset);
+    if (mapped == MAP_FAILED) return -1;
+
+    *crc = CHECKSUM_crc32c(*crc, mapped + (offset - map_offset), length);
+    munmap(mapped, map_length);
+    return 0;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Enviar una trama v2 cuyos datos son un fragmento de un fichero sin pasar por 
+*             memoria de usuario: solo se escriben la cabecera y un prefijo opcional, y los 
+*             datos pasan del fichero al socket con `sendfile`. Si la conexión usa checksum, 
+*             el CRC32C se calcula sobre el fragmento proyectado con `mmap`, sin copiarlo. 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket donde se enviará la trama. 
+* in: type = Tipo de la trama. 
+* in: prefix = Bytes que van al principio de los datos, antes del fragmento (e.g., el 
+*              offset del paquete con `CONN_CAP_SACK`). Puede ser NULL si `prefix_length` es 0. 
+* in: prefix_length = Número de bytes de `prefix` (como mucho `FRAME_PACKET_OFFSET_SIZE`). 
+* in: fd = Descriptor del fichero abierto para lectura. 
+* in: offset = Posición del fragmento dentro del fichero. 
+* in: length = Número de bytes del fragmento. 
+* in: params = Parámetros acordados en el handshake (deben cumplir `FRAME_canSendFileFrames`). 
+* 
+* @Retorno: 
+*           0 = La trama fue enviada con éxito. 
+*          -1 = Parámetros inválidos, error al leer el fichero o al escribir en el socket 
+*               (`errno` indica la causa). 
+* 
+************************************************/
+int FRAME_sendFileFrame(int socket, int type, const uint8_t *prefix, uint32_t prefix_length, int fd, off_t offset, uint32_t length, const ConnectionParams *params) {
+    if (!FRAME_canSendFileFrames(params) || prefix_length > FRAME_PACKET_OFFSET_SIZE || (prefix_length > 0 && !prefix) || length > FRAME_MAX_DATA_SIZE) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    //la trama només descriu la capçalera: les dades no arriben a passar per memòria d'usuari
+    Frame frame = {0};
+    frame.type = (uint8_t)type;
+    frame.data_length = prefix_length + length;
+    frame.timestamp = (int32_t)time(NULL);
+    frame.version = FRAME_V2;
+
+    int with_checksum = params->checksum != CONN_CHECKSUM_NONE;
+    if (with_checksum) {
+        frame.checksum = CHECKSUM_crc32c(0, prefix, prefix_length);
+        if (FRAME_checksumFileRange(fd, offset, length, &frame.checksum) < 0) {
+            perror("Failed to map file frame: ");
+            return -1;
+        }
+    }
+
+    //capçalera i prefix en una sola escriptura; MSG_MORE fa que el kernel els enganxi al primer segment de dades
+    uint8_t header[FRAME_V2_HEADER_SIZE + FRAME_PACKET_OFFSET_SIZE];
+    size_t header_length = FRAME_V2_HEADER_SIZE + prefix_length;
+    FRAME_serializeHeaderV2(&frame, with_checksum, header);
+    if (prefix_length > 0) memcpy(header + FRAME_V2_HEADER_SIZE, prefix, prefix_length);
+
+    size_t written = 0;
+    while (written < header_length) {
+        ssize_t n = send(socket, header + written, header_length - written, MSG_MORE);
+        frame_send_calls++;
+        if (n <= 0) {
+            int send_errno = errno;     //el conservem perquè qui crida pugui distingir una desconnexió
+            perror("Failed to send file frame: ");
+            errno = send_errno;
+            return -1;
+        }
+        written += n;
+    }
+
+    off_t position = offset;
+    uint32_t remaining = length;
+    while (remaining > 0) {
+        ssize_t n = sendfile(socket, fd, &position, remaining);
+        frame_send_calls++;
+        if (n <= 0) {
+            //si el fitxer s'ha escurçat la trama queda a mitges i la connexió ja no és vàlida
+            if (n == 0) errno = EIO;
+            int send_errno = errno;
+            perror("Failed to send file frame: ");
+            errno = send_errno;
+            return -1;
+        }
+        remaining -= (uint32_t)n;
+    }
+
+    return 0;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Inicializar una oferta con todo lo que soporta este extremo sin configuración 
+*             adicional: tramas v2 de hasta `FRAME_MAX_DATA_SIZE` bytes, ACK selectivos, 
+*             MD5 al final del fichero, checksum CRC32C, hash MD5, la ventana por defecto 
+*             y una sola conexión por fichero. Las capacidades opcionales (compresión) y 
+*             las conexiones paralelas las activa la configuración. 
+* 
+* @Parámetros: 
+* out: offer = Puntero a la estructura `ConnectionOffer` a inicializar. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void FRAME_initOffer(ConnectionOffer *offer) {
+    offer->data_size = FRAME_MAX_DATA_SIZE;
+    offer->capabilities = CONN_DEFAULT_CAPABILITIES;
+    offer->checksums = CONN_CHECKSUM_CRC32C;
+    offer->hashes = CONN_HASH_MD5;
+    offer->window_size = CONN_DEFAULT_WINDOW_SIZE;
+    offer->stripes = 1;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Inicializar unos parámetros de conexión con los valores del protocolo 
+*             clásico (tramas de 256 bytes, envío de una trama por ACK, sin capacidades, 
+*             hash MD5 y una sola conexión), usados con peers que no negocian. La oferta local se inicializa 
+*             con `FRAME_initOffer` y el motor de E/S es `CONN_IO_SYSCALLS`. 
+* 
+* @Parámetros: 
+* out: params = Puntero a la estructura `ConnectionParams` a inicializar. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void FRAME_initLegacyParams(ConnectionParams *params) {
+    params->frame_version = FRAME_V1;
+    params->data_size = DATA_SIZE;
+    params->window_size = 1;
+    params->capabilities = 0;
+    params->checksum = 0;
+    params->hash = CONN_HASH_MD5;
+    params->stripes = 1;
+    FRAME_initOffer(&params->local);
+    params->io_engine = CONN_IO_SYSCALLS;
+    params->shaper = NULL;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Escoger el algoritmo más rápido de entre los que soportan los dos extremos. 
+* 
+* @Parámetros: 
+* in: mutual = Bitmap de algoritmos que soportan los dos extremos. 
+* in: preference = Algoritmos ordenados del más rápido al más lento. 
+* in: n_preferences = Número de algoritmos de `preference`. 
+* in: fallback = Algoritmo obligatorio, usado si no hay ninguno en común. 
+* 
+* @Retorno: Algoritmo escogido. 
+* 
+************************************************/
+static int FRAME_pickFastest(int mutual, const int *preference, int n_preferences, int fallback) {
+    for (int i = 0; i < n_preferences; i++) {
+        if (mutual & preference[i]) return preference[i];
+    }
+    return fallback;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Acordar la combinación más rápida que soportan los dos extremos a partir 
+*             de la oferta del otro extremo y la de este. El tamaño de trama y la ventana 
+*             son los menores de las dos ofertas, las capacidades las que anuncian ambos, 
+*             y el checksum y el hash los más rápidos de los comunes. Las conexiones 
+*             paralelas por fichero son las menores de las dos ofertas, y solo si se han 
+*             acordado ACK selectivos (los paquetes de cada conexión llevan su offset) y no 
+*             se ha acordado memoria compartida (`CONN_CAP_SHM`). Si 
+*             el otro extremo no anuncia tamaño de trama es un peer v1 y se mantiene el 
+*             formato clásico. 
+*             La oferta local de `params` no se modifica. 
+* 
+* @Parámetros: 
+* in: peer = Oferta del otro extremo (o combinación que ha escogido, en una respuesta). 
+* in: local = Oferta de este extremo. 
+* in/out: params = Puntero a la estructura `ConnectionParams` resultante. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void FRAME_negotiate(const ConnectionOffer *peer, const ConnectionOffer *local, ConnectionParams *params) {
+    //algorismes del més ràpid al més lent
+    static const int checksum_preference[] = {CONN_CHECKSUM_NONE, CONN_CHECKSUM_CRC32C};
+    static const int hash_preference[] = {CONN_HASH_MD5};
+
+    params->frame_version = FRAME_V1;
+    params->data_size = DATA_SIZE;
+    params->capabilities = 0;
+    params->checksum = 0;
+    params->stripes = 1;
+
+    //la finestra és la menor de les dues; un peer v1 no n'anuncia i confirma trama a trama, així que mana la local
+    params->window_size = local->window_size > 0 ? local->window_size : 1;
+    if (peer->window_size > 0 && peer->window_size < params->window_size) params->window_size = peer->window_size;
+
+    //el hash del fitxer també s'acorda amb peers v1, que només entenen MD5
+    params->hash = FRAME_pickFastest(peer->hashes & local->hashes & FRAME_SUPPORTED_HASHES, hash_preference, (int)(sizeof(hash_preference) / sizeof(hash_preference[0])), CONN_HASH_MD5);
+
+    if (peer->data_size == 0 || local->data_size == 0) return;
+
+    //acotem la mida entre la d'una trama v1 i el màxim que accepten els dos extrems
+    uint32_t requested = peer->data_size < local->data_size ? peer->data_size : local->data_size;
+    if (requested < DATA_SIZE) requested = DATA_SIZE;
+    if (requested > FRAME_MAX_DATA_SIZE) requested = FRAME_MAX_DATA_SIZE;
+
+    params->frame_version = FRAME_V2;
+    params->data_size = requested;
+
+    //només activem el que els dos extrems anuncien i sabem tractar. Tot peer v2 suporta CRC32C
+    params->capabilities = peer->capabilities & local->capabilities & FRAME_SUPPORTED_CAPABILITIES;
+    params->checksum = FRAME_pickFastest(peer->checksums & local->checksums & FRAME_SUPPORTED_CHECKSUMS, checksum_preference, (int)(sizeof(checksum_preference) / sizeof(checksum_preference[0])), CONN_CHECKSUM_CRC32C);
+
+    //els blocs corruptes es tornen a demanar marcant els seus paquets com a no rebuts, cosa que només permeten els ACK selectius
+    if (!(params->capabilities & CONN_CAP_SACK)) params->capabilities &= ~CONN_CAP_MERKLE;
+
+    //un paquet amb trams surt com una trama diferent de les 0x05, de manera que ha de portar el seu offset
+    if (!(params->capabilities & CONN_CAP_SACK)) params->capabilities &= ~CONN_CAP_SPARSE;
+
+    //l'anell de memòria compartida porta els paquets amb el seu offset i els paquets que hi falten es tornen a enviar pel socket segons l'ACK selectiu
+    if (!(params->capabilities & CONN_CAP_SACK)) params->capabilities &= ~CONN_CAP_SHM;
+
+    //sense esperar el primer ACK, el receptor pot rebre paquets que ja tenia, que només es poden descartar si porten el seu offset
+    if (!(params->capabilities & CONN_CAP_SACK)) params->capabilities &= ~CONN_CAP_PIPELINE;
+
+    //repartir un fitxer entre diverses connexions només és possible si cada paquet porta el seu offset
+    if (params->capabilities & CONN_CAP_SACK) {
+        int stripes = peer->stripes < local->stripes ? peer->stripes : local->stripes;
+        if (stripes > CONN_MAX_STRIPES) stripes = CONN_MAX_STRIPES;
+        if (stripes > 1) params->stripes = stripes;
+    }
+
+    //amb l'anell de memòria compartida les dades ja no passen pel socket, i repartir-les entre connexions no hi afegeix res
+    if (params->capabilities & CONN_CAP_SHM) params->stripes = 1;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Obtener el número de bytes de datos por paquete de fichero según los 
+*             parámetros de la conexión. Con `CONN_CAP_SACK` cada paquete reserva 
+*             `FRAME_PACKET_OFFSET_SIZE` bytes de la trama para su offset. 
+* 
+* @Parámetros: 
+* in: params = Parámetros acordados en el handshake (puede ser NULL). 
+* 
+* @Retorno: Bytes de datos por paquete (`DATA_SIZE` si la conexión es v1). 
+* 
+************************************************/
+uint32_t FRAME_getDataSize(const ConnectionParams *params) {
+    if (!params || params->frame_version != FRAME_V2) return DATA_SIZE;
+    if (params->capabilities & CONN_CAP_SACK) return params->data_size - FRAME_PACKET_OFFSET_SIZE;
+    return params->data_size;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Obtener un buffer donde leer un payload comprimido. Con lector se reutiliza 
+*             su buffer auxiliar, que solo crece cuando llega un payload mayor; sin lector 
+*             se reserva un buffer temporal que el llamador debe liberar. 
+* 
+* @Parámetros: 
+* in/out: reader = Lector con buffer de la conexión, o NULL. 
+* in: size = Bytes que debe poder contener el buffer. 
+* out: temporary = Buffer temporal reservado (NULL si se usa el del lector). 
+* 
+* @Retorno: 
+*           Puntero al buffer. 
+*           Retorna NULL si ocurre un error al asignar memoria. 
+* 
+************************************************/
+static uint8_t *FRAME_getScratch(FrameReader *reader, uint32_t size, uint8_t **temporary) {
+    *temporary = NULL;
+    if (!reader) {
+        *temporary = (uint8_t *)malloc(size ? size : 1);
+        if (*temporary) frame_heap_allocations++;
+        return *temporary;
+    }
+
+    if (reader->scratch_capacity < size) {
+        //com a mínim dupliquem la mida perquè payloads creixents no provoquin una reserva per trama
+        size_t capacity = reader->scratch_capacity * 2 > size ? reader->scratch_capacity * 2 : size;
+        uint8_t *scratch = (uint8_t *)realloc(reader->scratch, capacity);
+        if (!scratch) return NULL;
+        frame_heap_allocations++;
+        reader->scratch = scratch;
+        reader->scratch_capacity = capacity;
+    }
+    return reader->scratch;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Leer el payload comprimido de una trama v2, verificar su checksum (calculado 
+*             sobre los bytes transmitidos) y descomprimirlo en el campo de datos de la trama. 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket desde el cual se recibirá la trama. 
+* in/out: reader = Lector con buffer de la conexión, o NULL para leer directamente del socket. 
+* in: header = Cabecera v2 de la trama ya leída. 
+* in: payload_length = Bytes del payload comprimido indicados en la cabecera. 
+* in/out: frame = Trama donde se recibirá; si apunta a NULL (o los datos no caben y 
+*                 `allocated_frame` no es NULL) se reserva una del tamaño original de los datos. 
+* out: allocated_frame = Trama reservada, si se ha tenido que reservar. 
+* 
+* @Retorno: 
+*           FRAME_SUCCESS, FRAME_DISCONNECTED, FRAME_PENDING o FRAME_RECV_ERROR, con el 
+*           mismo significado que en `FRAME_receiveFrame`. 
+* 
+************************************************/
+static FrameErrorCode FRAME_readCompressedPayload(int socket, FrameReader *reader, const uint8_t *header, uint32_t payload_length, Frame **frame, Frame **allocated_frame) {
+    uint8_t *temporary = NULL;
+    uint8_t *payload = FRAME_getScratch(reader, payload_length, &temporary);
+    if (!payload) return FRAME_RECV_ERROR;
+
+    FrameErrorCode error_code = FRAME_readBytes(socket, reader, payload, payload_length);
+    if (error_code != FRAME_SUCCESS) goto done;
+
+    error_code = FRAME_RECV_ERROR;
+    uint32_t checksum = ((uint32_t)header[5] << 24) | ((uint32_t)header[6] << 16) | ((uint32_t)header[7] << 8) | header[8];
+    if (!(header[0] & FRAME_V2_NO_CHECKSUM_FLAG) && checksum != CHECKSUM_crc32c(0, payload, payload_length)) goto done;
+    if (payload_length < FRAME_COMPRESSED_LENGTH_SIZE) goto done;
+
+    uint32_t original_length = ((uint32_t)payload[0] << 24) | ((uint32_t)payload[1] << 16) | ((uint32_t)payload[2] << 8) | payload[3];
+    if (original_length > FRAME_MAX_DATA_SIZE) goto done;
+
+    if (!*frame || (original_length > (*frame)->capacity && allocated_frame)) {
+        *frame = *allocated_frame = FRAME_allocFrame(original_length);
+        if (!*frame) goto done;
+    } else if (original_length > (*frame)->capacity) {
+        goto done;
+    }
+
+    //descomprimim directament al camp de dades de la trama
+    long decompressed = FRAME_lzDecompress(payload + FRAME_COMPRESSED_LENGTH_SIZE, payload_length - FRAME_COMPRESSED_LENGTH_SIZE, (*frame)->data, original_length);
+    if (decompressed != (long)original_length) goto done;
+
+    (*frame)->version = FRAME_V2;
+    (*frame)->type = header[0] & ~(FRAME_V2_FLAG | FRAME_V2_NO_CHECKSUM_FLAG | FRAME_V2_COMPRESSED_FLAG);
+    (*frame)->data_length = original_length;
+    (*frame)->checksum = checksum;
+    (*frame)->timestamp = (header[9] << 24) | (header[10] << 16) | (header[11] << 8) | header[12];
+    (*frame)->compressed = 0;
+    error_code = FRAME_SUCCESS;
+
+done:
+    free(temporary);
+    return error_code;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Leer una trama completa de un socket (v1 o v2, según el primer byte) y 
+*             verificar su checksum. Si no se proporciona trama, se reserva una del tamaño 
+*             justo una vez conocida la longitud de los datos. 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket desde el cual se recibirá la trama. 
+* in/out: reader = Lector con buffer de la conexión, o NULL para leer directamente del socket. 
+* in/out: frame = Trama donde se recibirá, o NULL para reservar una nueva. 
+* out: allocated_frame = Trama reservada cuando `frame` es NULL o, si este parámetro no es 
+*                       NULL, cuando los datos de una trama v2 no caben en `frame` (NULL si 
+*                       no se ha reservado ninguna o hubo un error). 
+* 
+* @Retorno: 
+*           FRAME_SUCCESS, FRAME_DISCONNECTED, FRAME_PENDING o FRAME_RECV_ERROR, con el 
+*           mismo significado que en `FRAME_receiveFrame`. 
+* 
+************************************************/
+static FrameErrorCode FRAME_readFrame(int socket, FrameReader *reader, Frame *frame, Frame **allocated_frame) {
+    uint8_t buffer[FRAME_SIZE];
+
+    //llegim el primer byte per saber si es tracta d'una trama v1 o v2
+    FrameErrorCode error_code = FRAME_readBytes(socket, reader, buffer, 1);
+    if (error_code != FRAME_SUCCESS) return error_code;
+
+    if (buffer[0] & FRAME_V2_FLAG) {
+        //llegim la resta de la capçalera v2
+        error_code = FRAME_readBytes(socket, reader, buffer + 1, FRAME_V2_HEADER_SIZE - 1);
+        if (error_code != FRAME_SUCCESS) return error_code;
+
+        uint32_t data_length = ((uint32_t)buffer[1] << 24) | ((uint32_t)buffer[2] << 16) | ((uint32_t)buffer[3] << 8) | buffer[4];
+        if (data_length > FRAME_MAX_DATA_SIZE) return FRAME_RECV_ERROR;
+
+        //el payload comprimit es llegeix a part i es descomprimeix al camp de dades de la trama
+        if (buffer[0] & FRAME_V2_COMPRESSED_FLAG) {
+            error_code = FRAME_readCompressedPayload(socket, reader, buffer, data_length, &frame, allocated_frame);
+            if (error_code != FRAME_SUCCESS) goto failed;
+            goto verified;
+        }
+
+        //si qui crida accepta una trama reservada, les dades que no caben a la seva es reben en una de nova
+        if (!frame || (data_length > frame->capacity && allocated_frame)) {
+            frame = *allocated_frame = FRAME_allocFrame(data_length);
+            if (!frame) return FRAME_RECV_ERROR;
+        } else if (data_length > frame->capacity) {
+            return FRAME_RECV_ERROR;
+        }
+
+        frame->version = FRAME_V2;
+        frame->type = buffer[0] & ~(FRAME_V2_FLAG | FRAME_V2_NO_CHECKSUM_FLAG);
+        frame->compressed = 0;
+        frame->data_length = data_length;
+        frame->checksum = ((uint32_t)buffer[5] << 24) | ((uint32_t)buffer[6] << 16) | ((uint32_t)buffer[7] << 8) | buffer[8];
+        frame->timestamp = (buffer[9] << 24) | (buffer[10] << 16) | (buffer[11] << 8) | buffer[12];
+
+        //llegim les dades de la trama directament al seu camp
+        error_code = FRAME_readBytes(socket, reader, frame->data, data_length);
+        if (error_code != FRAME_SUCCESS) goto failed;
+
+        //el peer ha acordat no calcular checksum en aquesta connexió
+        if (buffer[0] & FRAME_V2_NO_CHECKSUM_FLAG) goto verified;
+    } else {
+        //llegim la resta de la trama v1 de 256 bytes
+        error_code = FRAME_readBytes(socket, reader, buffer + 1, FRAME_SIZE - 1);
+        if (error_code != FRAME_SUCCESS) return error_code;
+
+        if (!frame) {
+            frame = *allocated_frame = FRAME_allocFrame(DATA_SIZE);
+            if (!frame) return FRAME_RECV_ERROR;
+        }
+
+        //deserialitzem la trama
+        frame->version = FRAME_V1;
+        FRAME_deserializeFrame(buffer, frame);
+    }
+
+    //comprovem el checksum
+    if (frame->checksum != FRAME_calculateChecksum(frame)) {
+        // Error en el checksum
+        error_code = FRAME_RECV_ERROR;
+        goto failed;
+    }
+
+verified:
+    //una trama v1 mai pot portar més de DATA_SIZE bytes útils
+    if (frame->data_length > DATA_SIZE && frame->version == FRAME_V1) {
+        frame->data_length = DATA_SIZE;
+    }
+    frame->data[frame->data_length] = '\0';
+
+    return FRAME_SUCCESS;
+
+failed:
+    if (allocated_frame && *allocated_frame) {
+        FRAME_destroyFrame(*allocated_frame);
+        *allocated_frame = NULL;
+    }
+    return error_code;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Recibir una trama (`Frame`) a través de un socket, deserializarla y verificar 
+*             su integridad mediante el cálculo de su checksum. El formato (v1 o v2) se 
+*             detecta a partir del primer byte recibido. 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket desde el cual se recibirá la trama. 
+* 
+* @Retorno: 
+*           Una estructura `FrameResult` que contiene: 
+*           - `frame`: Puntero a la trama recibida (NULL si hubo un error). 
+*           - `error_code`: Código que indica el resultado de la operación:
+*               - `FRAME_SUCCESS`: La trama se recibió correctamente. 
+*               - `FRAME_DISCONNECTED`: El extremo remoto cerró la conexión. 
+*               - `FRAME_PENDING`: Error debido a un descriptor de archivo inválido. 
+*               - `FRAME_RECV_ERROR`: Error durante la recepción o problemas con el checksum. 
+* 
+************************************************/
+FrameResult FRAME_receiveFrame(int socket) {
+    FrameResult result = {NULL, FRAME_SUCCESS};
+    result.error_code = FRAME_readFrame(socket, NULL, NULL, &result.frame);
+    return result;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Recibir una trama sobre una estructura `Frame` proporcionada por quien llama 
+*             (inicializada con `FRAME_initFrame` u obtenida de un `FramePool`), sin 
+*             reservar memoria dinámica. 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket desde el cual se recibirá la trama. 
+* out: frame = Trama donde se almacenará el resultado. Sus datos solo son válidos si 
+*              se retorna `FRAME_SUCCESS`. 
+* 
+* @Retorno: 
+*           FRAME_SUCCESS = La trama se recibió correctamente. 
+*           FRAME_DISCONNECTED = El extremo remoto cerró la conexión. 
+*           FRAME_PENDING = Descriptor de archivo inválido. 
+*           FRAME_RECV_ERROR = Error de recepción, checksum incorrecto o datos que no 
+*                              caben en la capacidad de la trama. 
+* 
+************************************************/
+FrameErrorCode FRAME_receiveFrameInto(int socket, Frame *frame) {
+    if (!frame) return FRAME_RECV_ERROR;
+    return FRAME_readFrame(socket, NULL, frame, NULL);
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Dejar un `FrameReader` vacío, sin socket asociado ni memoria reservada. 
+*             Equivale a `FRAME_EMPTY_READER`. 
+* 
+* @Parámetros: 
+* out: reader = Puntero al lector a inicializar. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void FRAME_initReader(FrameReader *reader) {
+    memset(reader, 0, sizeof(FrameReader));
+    reader->socket = -1;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Asociar un lector con buffer a un socket recién conectado, descartando 
+*             cualquier byte que quedara de una conexión anterior. El buffer se reserva 
+*             la primera vez y se reutiliza en las siguientes conexiones. 
+* 
+* @Parámetros: 
+* in/out: reader = Puntero al lector de la conexión. 
+* in: socket = Descriptor del socket del que leerá el lector. 
+* 
+* @Retorno: 
+*           0 = El lector está listo. 
+*          -1 = Error al reservar el buffer. 
+* 
+************************************************/
+int FRAME_resetReader(FrameReader *reader, int socket) {
+    if (!reader->buffer) {
+        reader->buffer = (uint8_t *)malloc(FRAME_READER_BUFFER_SIZE);
+        if (!reader->buffer) return -1;
+        frame_heap_allocations++;
+        reader->capacity = FRAME_READER_BUFFER_SIZE;
+    }
+    reader->socket = socket;
+    reader->start = reader->end = 0;
+    return 0;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Liberar los buffers de un `FrameReader` y dejarlo vacío. 
+* 
+* @Parámetros: 
+* in/out: reader = Puntero al lector a liberar. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void FRAME_destroyReader(FrameReader *reader) {
+    free(reader->buffer);
+    free(reader->scratch);
+    FRAME_initReader(reader);
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Consultar cuántos bytes recibidos del socket están en el buffer del lector 
+*             pendientes de procesar. 
+* 
+* @Parámetros: 
+* in: reader = Puntero al lector. 
+* 
+* @Retorno: Número de bytes pendientes en el buffer. 
+* 
+************************************************/
+size_t FRAME_readerBufferedBytes(const FrameReader *reader) {
+    return reader->end - reader->start;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Comprobar si el buffer del lector contiene una trama completa, de modo que 
+*             `FRAME_readerReceiveFrameInto` la procesará sin leer del socket. Una trama 
+*             que no cabe entera en el buffer se considera disponible en cuanto está su 
+*             cabecera, ya que su payload se lee directamente del socket. 
+* 
+* @Parámetros: 
+* in: reader = Puntero al lector. 
+* 
+* @Retorno: 
+*           1 = Hay una trama disponible. 
+*           0 = Faltan bytes de la trama. 
+* 
+************************************************/
+int FRAME_readerHasFrame(const FrameReader *reader) {
+    size_t buffered = reader->end - reader->start;
+    if (buffered == 0) return 0;
+
+    const uint8_t *bytes = reader->buffer + reader->start;
+    if (!(bytes[0] & FRAME_V2_FLAG)) return buffered >= FRAME_SIZE;
+    if (buffered < FRAME_V2_HEADER_SIZE) return 0;
+
+    uint32_t data_length = ((uint32_t)bytes[1] << 24) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 8) | bytes[4];
+    size_t frame_size = FRAME_V2_HEADER_SIZE + (size_t)data_length;
+    return buffered >= frame_size || frame_size > reader->capacity;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Obtener la parte libre del buffer del lector, para que otro mecanismo (e.g., 
+*             una recepción de io_uring) escriba en ella los bytes del socket. Los bytes 
+*             pendientes se mueven antes al inicio del buffer. 
+* 
+* @Parámetros: 
+* in/out: reader = Puntero al lector. 
+* out: space = Número de bytes libres a partir del puntero devuelto. 
+* 
+* @Retorno: Inicio de la parte libre del buffer. 
+* 
+************************************************/
+uint8_t *FRAME_readerSpace(FrameReader *reader, size_t *space) {
+    size_t buffered = reader->end - reader->start;
+    if (reader->start > 0) {
+        memmove(reader->buffer, reader->buffer + reader->start, buffered);
+        reader->start = 0;
+        reader->end = buffered;
+    }
+    *space = reader->capacity - reader->end;
+    return reader->buffer + reader->end;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Añadir a los bytes pendientes del lector los que se han escrito en la parte 
+*             libre obtenida con `FRAME_readerSpace`. 
+* 
+* @Parámetros: 
+* in/out: reader = Puntero al lector. 
+* in: length = Bytes escritos (como mucho el espacio libre). 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void FRAME_readerCommit(FrameReader *reader, size_t length) {
+    reader->end += length;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Recibir una trama a través del lector con buffer de la conexión. Se comporta 
+*             como `FRAME_receiveFrame`, pero las tramas que ya estén en el buffer se 
+*             procesan sin ninguna llamada al sistema. 
+* 
+* @Parámetros: 
+* in/out: reader = Lector asociado al socket con `FRAME_resetReader`. 
+* 
+* @Retorno: Igual que `FRAME_receiveFrame`. 
+* 
+************************************************/
+FrameResult FRAME_readerReceiveFrame(FrameReader *reader) {
+    FrameResult result = {NULL, FRAME_SUCCESS};
+    result.error_code = FRAME_readFrame(reader->socket, reader, NULL, &result.frame);
+    return result;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Recibir una trama a través del lector con buffer sobre una trama 
+*             proporcionada por quien llama, sin reservar memoria dinámica. 
+* 
+* @Parámetros: 
+* in/out: reader = Lector asociado al socket con `FRAME_resetReader`. 
+* out: frame = Trama donde se almacenará el resultado. 
+* 
+* @Retorno: Igual que `FRAME_receiveFrameInto`. 
+* 
+************************************************/
+FrameErrorCode FRAME_readerReceiveFrameInto(FrameReader *reader, Frame *frame) {
+    if (!frame) return FRAME_RECV_ERROR;
+    return FRAME_readFrame(reader->socket, reader, frame, NULL);
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Recibir una trama a través del lector con buffer sobre una trama 
+*             proporcionada por quien llama y, solo si sus datos no caben en ella, sobre 
+*             una trama reservada del tamaño justo. Sirve para las tramas que casi siempre 
+*             son pequeñas pero pueden llegar a ocupar todo el tamaño de datos acordado. 
+* 
+* @Parámetros: 
+* in/out: reader = Lector asociado al socket con `FRAME_resetReader`. 
+* out: frame = Trama donde se almacenará el resultado si cabe. 
+* out: allocated_frame = Trama reservada con el resultado, o NULL si ha cabido en `frame`. 
+*                        Quien llama la libera con `FRAME_destroyFrame`. 
+* 
+* @Retorno: Igual que `FRAME_receiveFrameInto`. 
+* 
+************************************************/
+FrameErrorCode FRAME_readerReceiveFrameFit(FrameReader *reader, Frame *frame, Frame **allocated_frame) {
+    if (!frame || !allocated_frame) return FRAME_RECV_ERROR;
+    *allocated_frame = NULL;
+    return FRAME_readFrame(reader->socket, reader, frame, allocated_frame);
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Dejar un `FramePool` vacío, sin memoria reservada. Equivale a inicializar 
+*             la estructura a cero. 
+* 
+* @Parámetros: 
+* out: pool = Puntero al pool a inicializar. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void FRAME_initPool(FramePool *pool) {
+    memset(pool, 0, sizeof(FramePool));
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Garantizar que el pool tenga al menos `n_frames` tramas con capacidad para 
+*             `capacity` bytes de datos. Solo se reserva memoria si el pool está vacío o se 
+*             queda pequeño (e.g., tras negociar un tamaño de paquete mayor), nunca por paquete. 
+* 
+* @Parámetros: 
+* in/out: pool = Puntero al pool de la conexión. 
+* in: capacity = Bytes de datos que deben caber en cada trama. 
+* in: n_frames = Tramas que se necesitan a la vez (se acota entre 1 y `FRAME_POOL_SIZE`). 
+* 
+* @Retorno: 
+*           0 = El pool tiene la capacidad pedida. 
+*          -1 = Error al reservar memoria o hay tramas del pool en uso. 
+* 
+************************************************/
+int FRAME_reservePool(FramePool *pool, uint32_t capacity, int n_frames) {
+    if (capacity < DATA_SIZE) capacity = DATA_SIZE;
+    if (n_frames < 1) n_frames = 1;
+    if (n_frames > FRAME_POOL_SIZE) n_frames = FRAME_POOL_SIZE;
+    if (pool->storage && pool->capacity >= capacity && pool->n_frames >= n_frames) return 0;
+
+    //no podem moure l'emmagatzematge mentre hi hagi trames prestades
+    for (int i = 0; i < pool->n_frames; i++) {
+        if (pool->in_use[i]) return -1;
+    }
+
+    //el pool mai es redueix, així una connexió que alterna enviament i recepció no reserva memòria cada cop
+    if (pool->capacity > capacity) capacity = pool->capacity;
+    if (pool->n_frames > n_frames) n_frames = pool->n_frames;
+
+    free(pool->storage);
+    pool->storage = (uint8_t *)malloc((size_t)n_frames * FRAME_STORAGE_SIZE(capacity));
+    if (!pool->storage) {
+        FRAME_initPool(pool);
+        return -1;
+    }
+    frame_heap_allocations++;
+
+    pool->capacity = capacity;
+    pool->n_frames = n_frames;
+    for (int i = 0; i < n_frames; i++) {
+        FRAME_initFrame(&pool->frames[i], pool->storage + (size_t)i * FRAME_STORAGE_SIZE(capacity), FRAME_STORAGE_SIZE(capacity));
+        pool->in_use[i] = 0;
+    }
+    return 0;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Obtener una trama libre del pool de la conexión. 
+* 
+* @Parámetros: 
+* in/out: pool = Puntero al pool de la conexión. 
+* 
+* @Retorno: 
+*           Puntero a una trama libre del pool. 
+*           Retorna NULL si el pool está vacío o todas sus tramas están en uso. 
+* 
+************************************************/
+Frame *FRAME_acquireFrame(FramePool *pool) {
+    if (!pool->storage) return NULL;
+
+    for (int i = 0; i < pool->n_frames; i++) {
+        if (!pool->in_use[i]) {
+            pool->in_use[i] = 1;
+            return &pool->frames[i];
+        }
+    }
+    return NULL;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Devolver al pool una trama obtenida con `FRAME_acquireFrame`. 
+* 
+* @Parámetros: 
+* in/out: pool = Puntero al pool de la conexión. 
+* in: frame = Trama a devolver (puede ser NULL). 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void FRAME_releaseFrame(FramePool *pool, Frame *frame) {
+    for (int i = 0; i < pool->n_frames; i++) {
+        if (frame == &pool->frames[i]) pool->in_use[i] = 0;
+    }
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Liberar la memoria de un `FramePool` y dejarlo vacío. 
+* 
+* @Parámetros: 
+* in/out: pool = Puntero al pool a liberar. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void FRAME_destroyPool(FramePool *pool) {
+    free(pool->storage);
+    FRAME_initPool(pool);
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Consultar cuántas reservas de memoria dinámica ha hecho el módulo de tramas 
+*             en el thread actual, para comprobar que un bucle de transferencia no reserva 
+*             memoria por paquete. 
+* 
+* @Parámetros: Ninguno. 
+* 
+* @Retorno: Número de reservas hechas por `FRAME_createFrame`, `FRAME_receiveFrame`, 
+*           `FRAME_reservePool`, `FRAME_resetReader` y la recepción de tramas comprimidas 
+*           en el thread actual. 
+* 
+************************************************/
+unsigned long FRAME_getAllocationCount(void) {
+    return frame_heap_allocations;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Consultar cuántas llamadas al sistema de escritura (`write`/`writev`) ha 
+*             hecho el módulo de tramas en el thread actual, para medir cuántas se 
+*             necesitan por MB transferido. 
+* 
+* @Parámetros: Ninguno. 
+* 
+* @Retorno: Número de llamadas de escritura hechas al enviar tramas en el thread actual. 
+* 
+************************************************/
+unsigned long FRAME_getSendCallCount(void) {
+    return frame_send_calls;
+}
+
 /*********************************************** 
 * 
 * @Finalidad: Escribir entradas en un archivo de log, incluyendo un timestamp legible 
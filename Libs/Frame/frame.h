@@ -23,18 +23,51 @@
 #include <stdint.h>    // uint8_t, uint16_t, uint32_t
 #include <time.h>      // time
 #include <errno.h>        // errno, códigos de error como ECONNRESET, EBADF
+#include <sys/socket.h>   // recv
+#include <sys/uio.h>      // writev, struct iovec
+#include <sys/sendfile.h> // sendfile
+#include <sys/mman.h>     // mmap, munmap
+#include <netinet/in.h>   // IPPROTO_TCP
+#include <netinet/tcp.h>  // TCP_CORK
+
+//Llibreries pròpies
+#include "../Structure/typeConnection.h"
+#include "../Checksum/checksum.h"
+#include "frame_lz.h"
 
 //Constants
 #define FRAME_SIZE 256
 #define DATA_SIZE (FRAME_SIZE - 9) 
 
+#define FRAME_V1 1                          // Trama clàssica de 256 bytes fixos
+#define FRAME_V2 2                          // Trama de longitud variable amb capçalera de 32 bits
+#define FRAME_V2_FLAG 0x80                  // Bit alt del camp type que identifica una trama v2 al cable
+#define FRAME_V2_NO_CHECKSUM_FLAG 0x40      // Bit del camp type d'una trama v2 que indica que no porta checksum
+#define FRAME_V2_COMPRESSED_FLAG 0x20       // Bit del camp type d'una trama v2 que indica que el payload va comprimit
+#define FRAME_COMPRESSED_LENGTH_SIZE 4      // Bytes al davant d'un payload comprimit amb la seva mida original (big endian)
+#define FRAME_PACKET_OFFSET_SIZE 8          // Bytes al davant de les dades d'un paquet de fitxer amb CONN_CAP_SACK amb el seu offset al fitxer (big endian)
+#define FRAME_SUPPORTED_CAPABILITIES (CONN_CAP_COMPRESSION | CONN_CAP_SACK | CONN_CAP_HASH_TRAILER | CONN_CAP_MERKLE | CONN_CAP_DELTA | CONN_CAP_SPARSE | CONN_CAP_SHM | CONN_CAP_PIPELINE)      // Capacitats que sap tractar aquest mòdul
+#define FRAME_SUPPORTED_CHECKSUMS (CONN_CHECKSUM_CRC32C | CONN_CHECKSUM_NONE)    // Algorismes de checksum de trama que sap tractar aquest mòdul
+#define FRAME_SUPPORTED_HASHES CONN_HASH_MD5                                     // Algorismes de hash de fitxer que saben tractar els processos
+#define FRAME_V2_HEADER_SIZE 13             // type(1) + data_length(4) + checksum(4) + timestamp(4)
+#define FRAME_MAX_DATA_SIZE (1024 * 1024)   // Màxim de dades acceptat en una trama v2 (1 MiB)
+#define FRAME_STORAGE_SIZE(capacity) (FRAME_V2_HEADER_SIZE + (capacity) + 1)   // Bytes de buffer per a una trama amb 'capacity' bytes de dades (capçalera v2 + dades + '\0')
+#define FRAME_POOL_SIZE CONN_MAX_WINDOW_SIZE // Màxim de trames reutilitzables per connexió (una per trama en vol)
+#define FRAME_SEND_BATCH 64                 // Trames que FRAME_sendFrames agrupa com a màxim en una sola crida a writev
+#define FRAME_READER_BUFFER_SIZE (64 * 1024) // Bytes que el lector amb buffer demana al socket en cada recv
+#define FRAME_ZEROCOPY_MIN_DATA_SIZE (64 * 1024) // Bytes per paquet a partir dels quals els paquets de fitxer s'envien amb sendfile (per sota, agrupar-los amb writev surt més a compte)
+#define FRAME_LEGACY_PARAMS {FRAME_V1, DATA_SIZE, 1, 0, 0, CONN_HASH_MD5, 1, {FRAME_MAX_DATA_SIZE, CONN_DEFAULT_CAPABILITIES, CONN_CHECKSUM_CRC32C, CONN_HASH_MD5, CONN_DEFAULT_WINDOW_SIZE, 1}, CONN_IO_SYSCALLS, NULL}   // Inicialitzador de paràmetres v1 (equivalent a FRAME_initLegacyParams)
+
 //Tipus propis
 typedef struct {
     uint8_t type;             // Tipus de trama (1 byte)
-    uint16_t data_length;     // Longitut de dades (2 bytes)
-    uint8_t data[DATA_SIZE];  // Dades (ajustades al tamany restant)
-    uint16_t checksum;        // Checksum (2 bytes)
+    uint32_t data_length;     // Longitut de dades (2 bytes a v1, 4 bytes a v2)
+    uint8_t *data;            // Dades (DATA_SIZE a v1, fins a FRAME_MAX_DATA_SIZE a v2)
+    uint32_t checksum;        // Checksum (suma de 2 bytes a v1, CRC32C de les dades a v2)
     int32_t timestamp;        // Timestamp (4 bytes)
+    uint8_t version;          // Format amb què s'ha rebut o s'enviarà la trama (FRAME_V1 o FRAME_V2)
+    uint32_t capacity;        // Bytes de dades que caben al buffer de la trama (com a mínim DATA_SIZE)
+    uint8_t compressed;       // 1 si data conté el payload comprimit per FRAME_fillFrameCompressed (només v2)
 } Frame;
 
 typedef enum {
@@ -49,6 +82,28 @@ typedef struct {
     FrameErrorCode error_code;
 } FrameResult;
 
+typedef struct {
+    Frame frames[FRAME_POOL_SIZE];    // Trames lligades a l'emmagatzematge del pool
+    int in_use[FRAME_POOL_SIZE];      // 1 si la trama corresponent està prestada
+    uint8_t *storage;                 // Bloc únic amb la capçalera v2 i les dades de cada trama
+    uint32_t capacity;                // Bytes de dades que caben a cada trama
+    int n_frames;                     // Trames reservades (les primeres n_frames de l'array)
+} FramePool;                          // Pool per connexió, només l'utilitza el thread que gestiona la connexió
+
+#define FRAME_EMPTY_POOL {{{0, 0, NULL, 0, 0, 0, 0, 0}}, {0}, NULL, 0, 0}   // Inicialitzador d'un pool buit (equivalent a FRAME_initPool)
+
+typedef struct {
+    int socket;               // Socket del qual llegeix
+    uint8_t *buffer;          // Bytes rebuts pendents de processar (poden contenir diverses trames i una de parcial)
+    size_t capacity;          // Mida del buffer
+    size_t start;             // Primer byte pendent de processar
+    size_t end;               // Final dels bytes vàlids del buffer
+    uint8_t *scratch;         // Buffer on es llegeixen els payloads comprimits abans de descomprimir-los
+    size_t scratch_capacity;  // Mida del buffer auxiliar (es reserva amb la primera trama comprimida)
+} FrameReader;                // Lector amb buffer per connexió, només l'utilitza el thread que gestiona la connexió
+
+#define FRAME_EMPTY_READER {-1, NULL, 0, 0, 0, NULL, 0}   // Inicialitzador d'un lector buit (equivalent a FRAME_initReader)
+
 //Funcions
 
 /*********************************************** 
@@ -59,7 +114,7 @@ typedef struct {
 * @Parámetros: 
 * in: type = Tipo de la trama, representado como un entero. 
 * in: data = Puntero a los datos que se incluirán en la trama (puede ser NULL). 
-* in: dataLength = Longitud de los datos proporcionados. Si excede `DATA_SIZE`, 
+* in: dataLength = Longitud de los datos proporcionados. Si excede `FRAME_MAX_DATA_SIZE`, 
 *                  se truncará al tamaño máximo permitido. 
 * 
 * @Retorno: 
@@ -69,6 +124,66 @@ typedef struct {
 ************************************************/
 Frame *FRAME_createFrame(int type, const char *data, size_t dataLength);
 
+/*********************************************** 
+* 
+* @Finalidad: Inicializar una trama sobre un buffer proporcionado por quien llama, sin 
+*             reservar memoria dinámica. Los primeros `FRAME_V2_HEADER_SIZE` bytes del 
+*             buffer se reservan para serializar la cabecera v2 justo antes de los datos. 
+* 
+* @Parámetros: 
+* out: frame = Puntero a la estructura `Frame` a inicializar. 
+* in: storage = Buffer donde residirán la cabecera y los datos de la trama. 
+* in: storage_size = Tamaño del buffer; debe ser al menos `FRAME_STORAGE_SIZE(DATA_SIZE)`. 
+* 
+* @Retorno: 
+*           0 = La trama se ha inicializado correctamente. 
+*          -1 = Parámetros inválidos o buffer demasiado pequeño. 
+* 
+************************************************/
+int FRAME_initFrame(Frame *frame, uint8_t *storage, size_t storage_size);
+
+/*********************************************** 
+* 
+* @Finalidad: Rellenar una trama ya inicializada con el tipo y los datos indicados, 
+*             calculando su timestamp sin reservar memoria. El checksum se calcula una 
+*             sola vez al enviarla, con el formato acordado para la conexión. 
+* 
+* @Parámetros: 
+* in/out: frame = Puntero a la trama a rellenar. 
+* in: type = Tipo de la trama. 
+* in: data = Datos de la trama. Si es NULL o apunta al propio campo de datos de la trama, 
+*            se conservan los bytes ya escritos en él (e.g., leídos directamente de un fichero). 
+* in: dataLength = Longitud de los datos. Si excede la capacidad de la trama se trunca. 
+* 
+* @Retorno: 
+*           0 = La trama se ha rellenado correctamente. 
+*          -1 = Trama nula. 
+* 
+************************************************/
+int FRAME_fillFrame(Frame *frame, int type, const char *data, size_t dataLength);
+
+/*********************************************** 
+* 
+* @Finalidad: Rellenar una trama con los datos indicados comprimidos, si vale la pena. 
+*             Una muestra del inicio decide si los datos son compresibles; si no lo son 
+*             (e.g., jpg, png, wav) o el resultado no ahorra al menos 1/16, los datos se 
+*             copian sin comprimir. Solo debe usarse en conexiones que hayan acordado 
+*             `CONN_CAP_COMPRESSION`. 
+* 
+* @Parámetros: 
+* in/out: frame = Puntero a la trama a rellenar. No puede compartir buffer con `data`. 
+* in: type = Tipo de la trama. 
+* in: data = Datos de la trama sin comprimir. 
+* in: dataLength = Longitud de los datos. Si excede la capacidad de la trama se trunca. 
+* 
+* @Retorno: 
+*           1 = La trama lleva los datos comprimidos. 
+*           0 = La trama lleva los datos sin comprimir. 
+*          -1 = Trama o datos nulos. 
+* 
+************************************************/
+int FRAME_fillFrameCompressed(Frame *frame, int type, const uint8_t *data, size_t dataLength);
+
 /*********************************************** 
 * 
 * @Finalidad: Liberar la memoria asignada dinámicamente para una estructura `Frame`. 
@@ -97,10 +212,181 @@ void FRAME_destroyFrame(Frame *frame);
 ************************************************/
 int FRAME_sendFrame(int socket, Frame *frame);
 
+/*********************************************** 
+* 
+* @Finalidad: Enviar una trama utilizando el formato acordado con el otro extremo de la 
+*             conexión (v1 de 256 bytes o v2 de longitud variable). En v2 el checksum es 
+*             el CRC32C de los `data_length` bytes de datos, y se omite si la conexión ha 
+*             acordado `CONN_CHECKSUM_NONE`. 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket donde se enviará la trama. 
+* in: frame = Puntero a la estructura `Frame` que se desea enviar. 
+* in: params = Parámetros acordados en el handshake. Si es NULL se usa el formato v1. 
+* 
+* @Retorno: 
+*           0 = La trama fue enviada con éxito. 
+*          -1 = Error al enviar la trama. 
+* 
+************************************************/
+int FRAME_sendFrameWithParams(int socket, Frame *frame, const ConnectionParams *params);
+
+/*********************************************** 
+* 
+* @Finalidad: Preparar una trama v2 del pool para enviarla con cualquier mecanismo de 
+*             escritura (e.g., un envío de io_uring): calcula su checksum si la conexión 
+*             lo usa y serializa su cabecera justo antes de los datos, de modo que la 
+*             trama completa queda en bytes consecutivos de su almacenamiento. 
+* 
+* @Parámetros: 
+* in/out: frame = Trama a preparar (inicializada con `FRAME_initFrame` o del pool). 
+* in: params = Parámetros acordados en el handshake. 
+* out: iov = Bytes que hay que escribir en el socket para enviar la trama. 
+* 
+* @Retorno: 
+*           0 = La trama está lista para enviarse. 
+*          -1 = La conexión no es v2 (las tramas v1 se serializan aparte). 
+* 
+************************************************/
+int FRAME_serializeInPlace(Frame *frame, const ConnectionParams *params, struct iovec *iov);
+
+/*********************************************** 
+* 
+* @Finalidad: Enviar varias tramas con el formato acordado usando una sola llamada a 
+*             `writev` por cada `FRAME_SEND_BATCH` tramas, en lugar de una escritura por 
+*             trama. Opcionalmente se activa `TCP_CORK` durante el envío para que el kernel 
+*             solo emita segmentos completos. 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket donde se enviarán las tramas. 
+* in: frames = Array de punteros a las tramas a enviar, en orden. 
+* in: n_frames = Número de tramas del array. 
+* in: params = Parámetros acordados en el handshake. Si es NULL se usa el formato v1. 
+* in: cork = 1 para envolver el envío con `TCP_CORK` (se ignora si el socket no es TCP). 
+* 
+* @Retorno: 
+*           0 = Todas las tramas fueron enviadas con éxito. 
+*          -1 = Error al enviar alguna trama. 
+* 
+************************************************/
+int FRAME_sendFrames(int socket, Frame **frames, int n_frames, const ConnectionParams *params, int cork);
+
+/*********************************************** 
+* 
+* @Finalidad: Consultar si los paquetes de fichero de una conexión se pueden enviar sin 
+*             copiarlos a memoria de usuario con `FRAME_sendFileFrame`: la conexión debe 
+*             ser v2, con paquetes de al menos `FRAME_ZEROCOPY_MIN_DATA_SIZE` bytes y sin 
+*             compresión (el payload comprimido no existe en el fichero). 
+* 
+* @Parámetros: 
+* in: params = Parámetros acordados en el handshake (puede ser NULL). 
+* 
+* @Retorno: 
+*           1 = Los paquetes de fichero se pueden enviar con `FRAME_sendFileFrame`. 
+*           0 = Hay que leerlos a una trama y enviarlos con `FRAME_sendFrames`. 
+* 
+************************************************/
+int FRAME_canSendFileFrames(const ConnectionParams *params);
+
+/*********************************************** 
+* 
+* @Finalidad: Enviar una trama v2 cuyos datos son un fragmento de un fichero sin pasar por 
+*             memoria de usuario: solo se escriben la cabecera y un prefijo opcional, y los 
+*             datos pasan del fichero al socket con `sendfile`. Si la conexión usa checksum, 
+*             el CRC32C se calcula sobre el fragmento proyectado con `mmap`, sin copiarlo. 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket donde se enviará la trama. 
+* in: type = Tipo de la trama. 
+* in: prefix = Bytes que van al principio de los datos, antes del fragmento (e.g., el 
+*              offset del paquete con `CONN_CAP_SACK`). Puede ser NULL si `prefix_length` es 0. 
+* in: prefix_length = Número de bytes de `prefix` (como mucho `FRAME_PACKET_OFFSET_SIZE`). 
+* in: fd = Descriptor del fichero abierto para lectura. 
+* in: offset = Posición del fragmento dentro del fichero. 
+* in: length = Número de bytes del fragmento. 
+* in: params = Parámetros acordados en el handshake (deben cumplir `FRAME_canSendFileFrames`). 
+* 
+* @Retorno: 
+*           0 = La trama fue enviada con éxito. 
+*          -1 = Parámetros inválidos, error al leer el fichero o al escribir en el socket 
+*               (`errno` indica la causa). 
+* 
+************************************************/
+int FRAME_sendFileFrame(int socket, int type, const uint8_t *prefix, uint32_t prefix_length, int fd, off_t offset, uint32_t length, const ConnectionParams *params);
+
+/*********************************************** 
+* 
+* @Finalidad: Inicializar una oferta con todo lo que soporta este extremo sin configuración 
+*             adicional: tramas v2 de hasta `FRAME_MAX_DATA_SIZE` bytes, ACK selectivos, 
+*             MD5 al final del fichero, checksum CRC32C, hash MD5, la ventana por defecto 
+*             y una sola conexión por fichero. Las capacidades opcionales (compresión) y 
+*             las conexiones paralelas las activa la configuración. 
+* 
+* @Parámetros: 
+* out: offer = Puntero a la estructura `ConnectionOffer` a inicializar. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void FRAME_initOffer(ConnectionOffer *offer);
+
+/*********************************************** 
+* 
+* @Finalidad: Inicializar unos parámetros de conexión con los valores del protocolo 
+*             clásico (tramas de 256 bytes, envío de una trama por ACK, sin capacidades, 
+*             hash MD5 y una sola conexión), usados con peers que no negocian. La oferta local se inicializa 
+*             con `FRAME_initOffer` y el motor de E/S es `CONN_IO_SYSCALLS`. 
+* 
+* @Parámetros: 
+* out: params = Puntero a la estructura `ConnectionParams` a inicializar. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void FRAME_initLegacyParams(ConnectionParams *params);
+
+/*********************************************** 
+* 
+* @Finalidad: Acordar la combinación más rápida que soportan los dos extremos a partir 
+*             de la oferta del otro extremo y la de este. El tamaño de trama y la ventana 
+*             son los menores de las dos ofertas, las capacidades las que anuncian ambos, 
+*             y el checksum y el hash los más rápidos de los comunes. Las conexiones 
+*             paralelas por fichero son las menores de las dos ofertas, y solo si se han 
+*             acordado ACK selectivos (los paquetes de cada conexión llevan su offset) y no 
+*             se ha acordado memoria compartida (`CONN_CAP_SHM`). Si 
+*             el otro extremo no anuncia tamaño de trama es un peer v1 y se mantiene el 
+*             formato clásico. 
+*             La oferta local de `params` no se modifica. 
+* 
+* @Parámetros: 
+* in: peer = Oferta del otro extremo (o combinación que ha escogido, en una respuesta). 
+* in: local = Oferta de este extremo. 
+* in/out: params = Puntero a la estructura `ConnectionParams` resultante. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void FRAME_negotiate(const ConnectionOffer *peer, const ConnectionOffer *local, ConnectionParams *params);
+
+/*********************************************** 
+* 
+* @Finalidad: Obtener el número de bytes de datos por paquete de fichero según los 
+*             parámetros de la conexión. Con `CONN_CAP_SACK` cada paquete reserva 
+*             `FRAME_PACKET_OFFSET_SIZE` bytes de la trama para su offset. 
+* 
+* @Parámetros: 
+* in: params = Parámetros acordados en el handshake (puede ser NULL). 
+* 
+* @Retorno: Bytes de datos por paquete (`DATA_SIZE` si la conexión es v1). 
+* 
+************************************************/
+uint32_t FRAME_getDataSize(const ConnectionParams *params);
+
 /*********************************************** 
 * 
 * @Finalidad: Recibir una trama (`Frame`) a través de un socket, deserializarla y verificar 
-*             su integridad mediante el cálculo de su checksum. 
+*             su integridad mediante el cálculo de su checksum. El formato (v1 o v2) se 
+*             detecta a partir del primer byte recibido. 
 * 
 * @Parámetros: 
 * in: socket = Descriptor del socket desde el cual se recibirá la trama. 
@@ -117,6 +403,272 @@ int FRAME_sendFrame(int socket, Frame *frame);
 ************************************************/
 FrameResult FRAME_receiveFrame(int socket);
 
+/*********************************************** 
+* 
+* @Finalidad: Recibir una trama sobre una estructura `Frame` proporcionada por quien llama 
+*             (inicializada con `FRAME_initFrame` u obtenida de un `FramePool`), sin 
+*             reservar memoria dinámica. 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket desde el cual se recibirá la trama. 
+* out: frame = Trama donde se almacenará el resultado. Sus datos solo son válidos si 
+*              se retorna `FRAME_SUCCESS`. 
+* 
+* @Retorno: 
+*           FRAME_SUCCESS = La trama se recibió correctamente. 
+*           FRAME_DISCONNECTED = El extremo remoto cerró la conexión. 
+*           FRAME_PENDING = Descriptor de archivo inválido. 
+*           FRAME_RECV_ERROR = Error de recepción, checksum incorrecto o datos que no 
+*                              caben en la capacidad de la trama. 
+* 
+************************************************/
+FrameErrorCode FRAME_receiveFrameInto(int socket, Frame *frame);
+
+/*********************************************** 
+* 
+* @Finalidad: Dejar un `FrameReader` vacío, sin socket asociado ni memoria reservada. 
+*             Equivale a `FRAME_EMPTY_READER`. 
+* 
+* @Parámetros: 
+* out: reader = Puntero al lector a inicializar. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void FRAME_initReader(FrameReader *reader);
+
+/*********************************************** 
+* 
+* @Finalidad: Asociar un lector con buffer a un socket recién conectado, descartando 
+*             cualquier byte que quedara de una conexión anterior. El buffer se reserva 
+*             la primera vez y se reutiliza en las siguientes conexiones. 
+* 
+* @Parámetros: 
+* in/out: reader = Puntero al lector de la conexión. 
+* in: socket = Descriptor del socket del que leerá el lector. 
+* 
+* @Retorno: 
+*           0 = El lector está listo. 
+*          -1 = Error al reservar el buffer. 
+* 
+************************************************/
+int FRAME_resetReader(FrameReader *reader, int socket);
+
+/*********************************************** 
+* 
+* @Finalidad: Liberar los buffers de un `FrameReader` y dejarlo vacío. 
+* 
+* @Parámetros: 
+* in/out: reader = Puntero al lector a liberar. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void FRAME_destroyReader(FrameReader *reader);
+
+/*********************************************** 
+* 
+* @Finalidad: Consultar cuántos bytes recibidos del socket están en el buffer del lector 
+*             pendientes de procesar. 
+* 
+* @Parámetros: 
+* in: reader = Puntero al lector. 
+* 
+* @Retorno: Número de bytes pendientes en el buffer. 
+* 
+************************************************/
+size_t FRAME_readerBufferedBytes(const FrameReader *reader);
+
+/*********************************************** 
+* 
+* @Finalidad: Comprobar si el buffer del lector contiene una trama completa, de modo que 
+*             `FRAME_readerReceiveFrameInto` la procesará sin leer del socket. Una trama 
+*             que no cabe entera en el buffer se considera disponible en cuanto está su 
+*             cabecera, ya que su payload se lee directamente del socket. 
+* 
+* @Parámetros: 
+* in: reader = Puntero al lector. 
+* 
+* @Retorno: 
+*           1 = Hay una trama disponible. 
+*           0 = Faltan bytes de la trama. 
+* 
+************************************************/
+int FRAME_readerHasFrame(const FrameReader *reader);
+
+/*********************************************** 
+* 
+* @Finalidad: Obtener la parte libre del buffer del lector, para que otro mecanismo (e.g., 
+*             una recepción de io_uring) escriba en ella los bytes del socket. Los bytes 
+*             pendientes se mueven antes al inicio del buffer. 
+* 
+* @Parámetros: 
+* in/out: reader = Puntero al lector. 
+* out: space = Número de bytes libres a partir del puntero devuelto. 
+* 
+* @Retorno: Inicio de la parte libre del buffer. 
+* 
+************************************************/
+uint8_t *FRAME_readerSpace(FrameReader *reader, size_t *space);
+
+/*********************************************** 
+* 
+* @Finalidad: Añadir a los bytes pendientes del lector los que se han escrito en la parte 
+*             libre obtenida con `FRAME_readerSpace`. 
+* 
+* @Parámetros: 
+* in/out: reader = Puntero al lector. 
+* in: length = Bytes escritos (como mucho el espacio libre). 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void FRAME_readerCommit(FrameReader *reader, size_t length);
+
+/*********************************************** 
+* 
+* @Finalidad: Recibir una trama a través del lector con buffer de la conexión. Se comporta 
+*             como `FRAME_receiveFrame`, pero las tramas que ya estén en el buffer se 
+*             procesan sin ninguna llamada al sistema. 
+* 
+* @Parámetros: 
+* in/out: reader = Lector asociado al socket con `FRAME_resetReader`. 
+* 
+* @Retorno: Igual que `FRAME_receiveFrame`. 
+* 
+************************************************/
+FrameResult FRAME_readerReceiveFrame(FrameReader *reader);
+
+/*********************************************** 
+* 
+* @Finalidad: Recibir una trama a través del lector con buffer sobre una trama 
+*             proporcionada por quien llama, sin reservar memoria dinámica. 
+* 
+* @Parámetros: 
+* in/out: reader = Lector asociado al socket con `FRAME_resetReader`. 
+* out: frame = Trama donde se almacenará el resultado. 
+* 
+* @Retorno: Igual que `FRAME_receiveFrameInto`. 
+* 
+************************************************/
+FrameErrorCode FRAME_readerReceiveFrameInto(FrameReader *reader, Frame *frame);
+
+/*********************************************** 
+* 
+* @Finalidad: Recibir una trama a través del lector con buffer sobre una trama 
+*             proporcionada por quien llama y, solo si sus datos no caben en ella, sobre 
+*             una trama reservada del tamaño justo. Sirve para las tramas que casi siempre 
+*             son pequeñas pero pueden llegar a ocupar todo el tamaño de datos acordado. 
+* 
+* @Parámetros: 
+* in/out: reader = Lector asociado al socket con `FRAME_resetReader`. 
+* out: frame = Trama donde se almacenará el resultado si cabe. 
+* out: allocated_frame = Trama reservada con el resultado, o NULL si ha cabido en `frame`. 
+*                        Quien llama la libera con `FRAME_destroyFrame`. 
+* 
+* @Retorno: Igual que `FRAME_receiveFrameInto`. 
+* 
+************************************************/
+FrameErrorCode FRAME_readerReceiveFrameFit(FrameReader *reader, Frame *frame, Frame **allocated_frame);
+
+/*********************************************** 
+* 
+* @Finalidad: Dejar un `FramePool` vacío, sin memoria reservada. Equivale a inicializar 
+*             la estructura a cero. 
+* 
+* @Parámetros: 
+* out: pool = Puntero al pool a inicializar. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void FRAME_initPool(FramePool *pool);
+
+/*********************************************** 
+* 
+* @Finalidad: Garantizar que el pool tenga al menos `n_frames` tramas con capacidad para 
+*             `capacity` bytes de datos. Solo se reserva memoria si el pool está vacío o se 
+*             queda pequeño (e.g., tras negociar un tamaño de paquete mayor), nunca por paquete. 
+* 
+* @Parámetros: 
+* in/out: pool = Puntero al pool de la conexión. 
+* in: capacity = Bytes de datos que deben caber en cada trama. 
+* in: n_frames = Tramas que se necesitan a la vez (se acota entre 1 y `FRAME_POOL_SIZE`). 
+* 
+* @Retorno: 
+*           0 = El pool tiene la capacidad pedida. 
+*          -1 = Error al reservar memoria o hay tramas del pool en uso. 
+* 
+************************************************/
+int FRAME_reservePool(FramePool *pool, uint32_t capacity, int n_frames);
+
+/*********************************************** 
+* 
+* @Finalidad: Obtener una trama libre del pool de la conexión. 
+* 
+* @Parámetros: 
+* in/out: pool = Puntero al pool de la conexión. 
+* 
+* @Retorno: 
+*           Puntero a una trama libre del pool. 
+*           Retorna NULL si el pool está vacío o todas sus tramas están en uso. 
+* 
+************************************************/
+Frame *FRAME_acquireFrame(FramePool *pool);
+
+/*********************************************** 
+* 
+* @Finalidad: Devolver al pool una trama obtenida con `FRAME_acquireFrame`. 
+* 
+* @Parámetros: 
+* in/out: pool = Puntero al pool de la conexión. 
+* in: frame = Trama a devolver (puede ser NULL). 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void FRAME_releaseFrame(FramePool *pool, Frame *frame);
+
+/*********************************************** 
+* 
+* @Finalidad: Liberar la memoria de un `FramePool` y dejarlo vacío. 
+* 
+* @Parámetros: 
+* in/out: pool = Puntero al pool a liberar. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void FRAME_destroyPool(FramePool *pool);
+
+/*********************************************** 
+* 
+* @Finalidad: Consultar cuántas reservas de memoria dinámica ha hecho el módulo de tramas 
+*             en el thread actual, para comprobar que un bucle de transferencia no reserva 
+*             memoria por paquete. 
+* 
+* @Parámetros: Ninguno. 
+* 
+* @Retorno: Número de reservas hechas por `FRAME_createFrame`, `FRAME_receiveFrame`, 
+*           `FRAME_reservePool`, `FRAME_resetReader` y la recepción de tramas comprimidas 
+*           en el thread actual. 
+* 
+************************************************/
+unsigned long FRAME_getAllocationCount(void);
+
+/*********************************************** 
+* 
+* @Finalidad: Consultar cuántas llamadas al sistema de escritura (`write`/`writev`/`sendfile`) ha 
+*             hecho el módulo de tramas en el thread actual, para medir cuántas se 
+*             necesitan por MB transferido. 
+* 
+* @Parámetros: Ninguno. 
+* 
+* @Retorno: Número de llamadas de escritura hechas al enviar tramas en el thread actual. 
+* 
+************************************************/
+unsigned long FRAME_getSendCallCount(void);
+
 /*********************************************** 
 * 
 * @Finalidad: Escribir entradas en un archivo de log, incluyendo un timestamp legible 
@@ -0,0 +1,287 @@
+/***********************************************
+*
+* @Autores: Alexandre Contreras, Armand López.
+*
+* @Finalidad: Proveer la compresión y descompresión de bloques usada en el payload de
+*             las tramas v2. Cada secuencia es un token (4 bits de longitud de literales
+*             y 4 de longitud de coincidencia), los literales, un offset de 16 bits y la
+*             extensión de la longitud de coincidencia, como en el formato de bloque LZ4.
+*
+* @Fecha de creación: 16 de octubre de 2026.
+*
+* @Última modificación: 16 de octubre de 2026.
+*
+************************************************/
+
+#include "frame_lz.h"
+
+#define FRAME_LZ_MIN_MATCH 4            // Longitud mínima d'una coincidència
+#define FRAME_LZ_HASH_BITS 12           // Entrades de la taula de hash (2^12)
+#define FRAME_LZ_MAX_OFFSET 65535       // Distància màxima d'una coincidència (offset de 16 bits)
+#define FRAME_LZ_LAST_LITERALS 5        // Els últims bytes del bloc sempre van com a literals
+#define FRAME_LZ_MATCH_LIMIT 12         // Cap coincidència comença a menys d'aquests bytes del final
+#define FRAME_LZ_SKIP_SHIFT 6           // Com més temps sense coincidències, més bytes se salten (dades incompressibles)
+
+/***********************************************
+*
+* @Finalidad: Leer 4 bytes sin requisitos de alineación.
+*
+* @Parámetros:
+* in: p = Puntero a los bytes.
+*
+* @Retorno: Valor de 32 bits leído.
+*
+************************************************/
+static uint32_t FRAME_lzRead32(const uint8_t *p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+/***********************************************
+*
+* @Finalidad: Calcular la entrada de la tabla de hash para 4 bytes de entrada.
+*
+* @Parámetros:
+* in: sequence = Los 4 bytes a partir de la posición actual.
+*
+* @Retorno: Índice de la tabla de hash.
+*
+************************************************/
+static uint32_t FRAME_lzHash(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - FRAME_LZ_HASH_BITS);
+}
+
+/***********************************************
+*
+* @Finalidad: Escribir la extensión de una longitud (literales o coincidencia) que no
+*             cabe en los 4 bits del token.
+*
+* @Parámetros:
+* in: length = Longitud que excede de 15.
+* out: op = Posición del buffer de salida.
+*
+* @Retorno: Nueva posición del buffer de salida.
+*
+************************************************/
+static uint8_t *FRAME_lzWriteLength(size_t length, uint8_t *op) {
+    while (length >= 255) {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = (uint8_t)length;
+    return op;
+}
+
+/***********************************************
+*
+* @Finalidad: Comprimir un bloque de bytes. La compresión se abandona en cuanto el
+*             resultado no cabe en `dst_capacity`, de modo que pasando una capacidad
+*             menor que `src_length` se obtiene 0 para los datos que no ganan nada.
+*
+* @Parámetros:
+* in: src = Bytes a comprimir.
+* in: src_length = Número de bytes de `src`.
+* out: dst = Buffer donde se escribirá el bloque comprimido.
+* in: dst_capacity = Tamaño de `dst`.
+*
+* @Retorno:
+*           > 0 = Número de bytes del bloque comprimido.
+*           0 = El bloque comprimido no cabe en `dst_capacity`.
+*
+************************************************/
+size_t FRAME_lzCompress(const uint8_t *src, size_t src_length, uint8_t *dst, size_t dst_capacity) {
+    uint32_t table[1 << FRAME_LZ_HASH_BITS];
+    const uint8_t *ip = src;
+    const uint8_t *anchor = src;
+    const uint8_t *end = src + src_length;
+    uint8_t *op = dst;
+    uint8_t *op_end = dst + dst_capacity;
+
+    memset(table, 0, sizeof(table));
+
+    if (src_length > FRAME_LZ_MATCH_LIMIT) {
+        const uint8_t *match_start_limit = end - FRAME_LZ_MATCH_LIMIT;
+        const uint8_t *match_end_limit = end - FRAME_LZ_LAST_LITERALS;
+
+        //el primer byte mai pot tenir coincidència
+        ip++;
+        while (ip < match_start_limit) {
+            uint32_t sequence = FRAME_lzRead32(ip);
+            uint32_t h = FRAME_lzHash(sequence);
+            const uint8_t *ref = src + table[h];
+            table[h] = (uint32_t)(ip - src);
+
+            if (ref >= ip || ip - ref > FRAME_LZ_MAX_OFFSET || FRAME_lzRead32(ref) != sequence) {
+                ip += 1 + ((ip - anchor) >> FRAME_LZ_SKIP_SHIFT);
+                continue;
+            }
+
+            //allarguem la coincidència cap enrere (fins als literals pendents) i cap endavant
+            while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+                ip--;
+                ref--;
+            }
+            const uint8_t *match_end = ip + FRAME_LZ_MIN_MATCH;
+            const uint8_t *ref_end = ref + FRAME_LZ_MIN_MATCH;
+            while (match_end < match_end_limit && *match_end == *ref_end) {
+                match_end++;
+                ref_end++;
+            }
+
+            size_t literals = (size_t)(ip - anchor);
+            size_t match_length = (size_t)(match_end - ip) - FRAME_LZ_MIN_MATCH;
+
+            //pitjor cas de la seqüència: token + extensió i literals + offset + extensió de la coincidència
+            if ((size_t)(op_end - op) < 1 + literals / 255 + 1 + literals + 2 + match_length / 255 + 1) return 0;
+
+            uint8_t *token = op++;
+            if (literals >= 15) {
+                *token = 15 << 4;
+                op = FRAME_lzWriteLength(literals - 15, op);
+            } else {
+                *token = (uint8_t)(literals << 4);
+            }
+            memcpy(op, anchor, literals);
+            op += literals;
+
+            uint16_t offset = (uint16_t)(ip - ref);
+            *op++ = offset & 0xFF;
+            *op++ = offset >> 8;
+
+            if (match_length >= 15) {
+                *token |= 15;
+                op = FRAME_lzWriteLength(match_length - 15, op);
+            } else {
+                *token |= (uint8_t)match_length;
+            }
+
+            ip = match_end;
+            anchor = ip;
+        }
+    }
+
+    //última seqüència: només literals
+    size_t literals = (size_t)(end - anchor);
+    if ((size_t)(op_end - op) < 1 + literals / 255 + 1 + literals) return 0;
+
+    if (literals >= 15) {
+        *op++ = 15 << 4;
+        op = FRAME_lzWriteLength(literals - 15, op);
+    } else {
+        *op++ = (uint8_t)(literals << 4);
+    }
+    memcpy(op, anchor, literals);
+    op += literals;
+
+    return (size_t)(op - dst);
+}
+
+/***********************************************
+*
+* @Finalidad: Leer la extensión de una longitud que no cabe en los 4 bits del token.
+*
+* @Parámetros:
+* in/out: ip = Posición actual del bloque comprimido.
+* in: ip_end = Final del bloque comprimido.
+* in/out: length = Longitud a la que se suman los bytes de extensión.
+*
+* @Retorno:
+*           0 = Extensión leída correctamente.
+*          -1 = El bloque termina en medio de la extensión.
+*
+************************************************/
+static int FRAME_lzReadLength(const uint8_t **ip, const uint8_t *ip_end, size_t *length) {
+    uint8_t byte;
+    do {
+        if (*ip >= ip_end) return -1;
+        byte = *(*ip)++;
+        *length += byte;
+    } while (byte == 255);
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalidad: Descomprimir un bloque generado por `FRAME_lzCompress`, comprobando que
+*             ninguna secuencia lea o escriba fuera de los buffers.
+*
+* @Parámetros:
+* in: src = Bloque comprimido.
+* in: src_length = Número de bytes de `src`.
+* out: dst = Buffer donde se escribirán los bytes descomprimidos.
+* in: dst_capacity = Tamaño de `dst`.
+*
+* @Retorno:
+*           >= 0 = Número de bytes descomprimidos.
+*           -1 = El bloque está corrupto o no cabe en `dst_capacity`.
+*
+************************************************/
+long FRAME_lzDecompress(const uint8_t *src, size_t src_length, uint8_t *dst, size_t dst_capacity) {
+    const uint8_t *ip = src;
+    const uint8_t *ip_end = src + src_length;
+    uint8_t *op = dst;
+    uint8_t *op_end = dst + dst_capacity;
+
+    while (ip < ip_end) {
+        uint8_t token = *ip++;
+
+        //literals
+        size_t literals = token >> 4;
+        if (literals == 15 && FRAME_lzReadLength(&ip, ip_end, &literals) < 0) return -1;
+        if (literals > (size_t)(ip_end - ip) || literals > (size_t)(op_end - op)) return -1;
+        memcpy(op, ip, literals);
+        ip += literals;
+        op += literals;
+
+        //l'última seqüència no porta coincidència
+        if (ip >= ip_end) break;
+
+        //coincidència
+        if (ip_end - ip < 2) return -1;
+        size_t offset = ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - dst)) return -1;
+
+        size_t match_length = token & 15;
+        if (match_length == 15 && FRAME_lzReadLength(&ip, ip_end, &match_length) < 0) return -1;
+        match_length += FRAME_LZ_MIN_MATCH;
+        if (match_length > (size_t)(op_end - op)) return -1;
+
+        //si la coincidència es solapa amb el que s'està escrivint cal copiar byte a byte
+        const uint8_t *ref = op - offset;
+        if (offset >= match_length) {
+            memcpy(op, ref, match_length);
+        } else {
+            for (size_t i = 0; i < match_length; i++) {
+                op[i] = ref[i];
+            }
+        }
+        op += match_length;
+    }
+
+    return (long)(op - dst);
+}
+
+/***********************************************
+*
+* @Finalidad: Estimar si vale la pena comprimir un payload comprimiendo de prueba sus
+*             primeros `FRAME_LZ_PROBE_SIZE` bytes. Los formatos ya comprimidos (jpg,
+*             png, wav codificado...) se detectan así sin recorrer todo el payload.
+*
+* @Parámetros:
+* in: data = Payload a evaluar.
+* in: length = Número de bytes del payload.
+*
+* @Retorno:
+*           1 = La muestra se reduce lo suficiente y el payload se debería comprimir.
+*           0 = El payload se debería enviar sin comprimir.
+*
+************************************************/
+int FRAME_lzIsCompressible(const uint8_t *data, size_t length) {
+    uint8_t sample[FRAME_LZ_PROBE_SIZE];
+    size_t sample_length = length < FRAME_LZ_PROBE_SIZE ? length : FRAME_LZ_PROBE_SIZE;
+
+    //exigim que la mostra es redueixi com a mínim un 1/8 per compensar el cost de comprimir
+    return FRAME_lzCompress(data, sample_length, sample, sample_length - sample_length / 8) > 0;
+}
@@ -0,0 +1,79 @@
+/***********************************************
+*
+* @Autores: Alexandre Contreras y Armand López
+* @Propósito: Proveer un compresor rápido de bloques (formato de secuencias tipo LZ4:
+*             token, literales, offset de 16 bits y longitud de coincidencia) para
+*             comprimir el payload de las tramas v2 sin dependencias externas.
+* @Fecha de creación: 16 de octubre de 2026
+* @Última modificación: 16 de octubre de 2026
+*
+************************************************/
+
+#ifndef _FRAME_LZ_CUSTOM_H_
+#define _FRAME_LZ_CUSTOM_H_
+
+//Libreries del sistema
+#include <stdint.h>    // uint8_t, uint32_t
+#include <stddef.h>    // size_t
+#include <string.h>    // memcpy, memset
+
+//Constants
+#define FRAME_LZ_PROBE_SIZE 4096        // Bytes que es comprimeixen de prova per decidir si un payload és compressible
+
+//Funcions
+
+/***********************************************
+*
+* @Finalidad: Comprimir un bloque de bytes. La compresión se abandona en cuanto el
+*             resultado no cabe en `dst_capacity`, de modo que pasando una capacidad
+*             menor que `src_length` se obtiene 0 para los datos que no ganan nada.
+*
+* @Parámetros:
+* in: src = Bytes a comprimir.
+* in: src_length = Número de bytes de `src`.
+* out: dst = Buffer donde se escribirá el bloque comprimido.
+* in: dst_capacity = Tamaño de `dst`.
+*
+* @Retorno:
+*           > 0 = Número de bytes del bloque comprimido.
+*           0 = El bloque comprimido no cabe en `dst_capacity`.
+*
+************************************************/
+size_t FRAME_lzCompress(const uint8_t *src, size_t src_length, uint8_t *dst, size_t dst_capacity);
+
+/***********************************************
+*
+* @Finalidad: Descomprimir un bloque generado por `FRAME_lzCompress`, comprobando que
+*             ninguna secuencia lea o escriba fuera de los buffers.
+*
+* @Parámetros:
+* in: src = Bloque comprimido.
+* in: src_length = Número de bytes de `src`.
+* out: dst = Buffer donde se escribirán los bytes descomprimidos.
+* in: dst_capacity = Tamaño de `dst`.
+*
+* @Retorno:
+*           >= 0 = Número de bytes descomprimidos.
+*           -1 = El bloque está corrupto o no cabe en `dst_capacity`.
+*
+************************************************/
+long FRAME_lzDecompress(const uint8_t *src, size_t src_length, uint8_t *dst, size_t dst_capacity);
+
+/***********************************************
+*
+* @Finalidad: Estimar si vale la pena comprimir un payload comprimiendo de prueba sus
+*             primeros `FRAME_LZ_PROBE_SIZE` bytes. Los formatos ya comprimidos (jpg,
+*             png, wav codificado...) se detectan así sin recorrer todo el payload.
+*
+* @Parámetros:
+* in: data = Payload a evaluar.
+* in: length = Número de bytes del payload.
+*
+* @Retorno:
+*           1 = La muestra se reduce lo suficiente y el payload se debería comprimir.
+*           0 = El payload se debería enviar sin comprimir.
+*
+************************************************/
+int FRAME_lzIsCompressible(const uint8_t *data, size_t length);
+
+#endif // _FRAME_LZ_CUSTOM_H_
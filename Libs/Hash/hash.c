@@ -0,0 +1,295 @@
+/***********************************************
+*
+* @Autores: Alexandre Contreras, Armand López.
+*
+* @Finalidad: Implementar el MD5 (RFC 1321) de forma incremental, para que los ficheros
+*             se resuman en la misma pasada en que se envían o se reciben en lugar de
+*             volver a leerlos con `md5sum` al acabar.
+*
+* @Fecha de creación: 16 de octubre de 2026.
+*
+* @Última modificación: 16 de octubre de 2026.
+*
+************************************************/
+
+#include "hash.h"
+
+#define HASH_ROTL(x, c) (((x) << (c)) | ((x) >> (32 - (c))))
+
+// Rotacions de cada pas (4 per ronda, es repeteixen dins la ronda)
+static const uint32_t md5_shifts[64] = {
+    7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+    5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+    4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+    6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+};
+
+// Constants de cada pas: floor(abs(sin(i + 1)) * 2^32)
+static const uint32_t md5_constants[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+/***********************************************
+*
+* @Finalidad: Aplicar la función de compresión del MD5 a un bloque de 64 bytes.
+*
+* @Parámetros:
+* in/out: state = Estado (A, B, C, D) a actualizar.
+* in: block = Bloque de 64 bytes.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+static void HASH_compress(uint32_t state[4], const uint8_t *block) {
+    uint32_t words[16];
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+
+    //les paraules del bloc són little endian
+    for (int i = 0; i < 16; i++) {
+        words[i] = (uint32_t)block[i * 4] | ((uint32_t)block[i * 4 + 1] << 8) |
+                   ((uint32_t)block[i * 4 + 2] << 16) | ((uint32_t)block[i * 4 + 3] << 24);
+    }
+
+    for (int i = 0; i < 64; i++) {
+        uint32_t f;
+        int g;
+
+        if (i < 16) {
+            f = (b & c) | (~b & d);
+            g = i;
+        } else if (i < 32) {
+            f = (d & b) | (~d & c);
+            g = (5 * i + 1) % 16;
+        } else if (i < 48) {
+            f = b ^ c ^ d;
+            g = (3 * i + 5) % 16;
+        } else {
+            f = c ^ (b | ~d);
+            g = (7 * i) % 16;
+        }
+
+        f += a + md5_constants[i] + words[g];
+        a = d;
+        d = c;
+        c = b;
+        b += HASH_ROTL(f, md5_shifts[i]);
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+}
+
+/***********************************************
+*
+* @Finalidad: Inicializar el MD5 incremental de un fichero sin ningún byte resumido.
+*
+* @Parámetros:
+* out: hash = Estado a inicializar.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void HASH_init(FileHash *hash) {
+    FileHash empty = HASH_EMPTY;
+
+    *hash = empty;
+}
+
+/***********************************************
+*
+* @Finalidad: Añadir al MD5 los bytes que siguen a los ya resumidos.
+*
+* @Parámetros:
+* in/out: hash = Estado del MD5.
+* in: data = Bytes a añadir.
+* in: length = Número de bytes de `data`.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void HASH_update(FileHash *hash, const void *data, size_t length) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    size_t used = (size_t)(hash->length % 64);
+
+    hash->length += length;
+
+    //completem el bloc que havia quedat a mitges
+    if (used) {
+        size_t take = 64 - used;
+
+        if (take > length) take = length;
+        memcpy(hash->block + used, bytes, take);
+        bytes += take;
+        length -= take;
+        if (used + take < 64) return;
+        HASH_compress(hash->state, hash->block);
+    }
+
+    //els blocs complets es comprimeixen directament des de les dades
+    while (length >= 64) {
+        HASH_compress(hash->state, bytes);
+        bytes += 64;
+        length -= 64;
+    }
+
+    if (length) memcpy(hash->block, bytes, length);
+}
+
+/***********************************************
+*
+* @Finalidad: Resumir los bytes del fichero entre `hash->length` y `end` que aún no se han
+*             añadido al MD5, leyéndolos de la proyección en memoria si se da o del
+*             descriptor en caso contrario. Si el MD5 ya llega a `end` no hace nada.
+*
+* @Parámetros:
+* in/out: hash = Estado del MD5.
+* in: fd = Descriptor del fichero (solo se usa si `mapped` es NULL).
+* in: mapped = Proyección en memoria del fichero completo, o NULL.
+* in: end = Posición del fichero hasta la que se quiere tener el MD5.
+*
+* @Retorno:
+*           0 = El MD5 llega hasta `end`.
+*          -1 = Error al leer el fichero (el MD5 queda en el último byte leído).
+*
+************************************************/
+int HASH_advance(FileHash *hash, int fd, const uint8_t *mapped, off_t end) {
+    uint8_t *buffer;
+
+    if (end <= (off_t)hash->length) return 0;
+
+    if (mapped) {
+        HASH_update(hash, mapped + hash->length, (size_t)(end - (off_t)hash->length));
+        return 0;
+    }
+
+    buffer = (uint8_t *)malloc(HASH_READ_CHUNK);
+    if (!buffer) return -1;
+
+    while ((off_t)hash->length < end) {
+        size_t want = (size_t)(end - (off_t)hash->length);
+        ssize_t got;
+
+        if (want > HASH_READ_CHUNK) want = HASH_READ_CHUNK;
+        got = pread(fd, buffer, want, (off_t)hash->length);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) {
+            free(buffer);
+            return -1;
+        }
+        HASH_update(hash, buffer, (size_t)got);
+    }
+
+    free(buffer);
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalidad: Obtener el MD5 (en binario) de los bytes resumidos hasta ahora. El estado
+*             no se modifica, de modo que se puede seguir añadiendo datos.
+*
+* @Parámetros:
+* in: hash = Estado del MD5.
+* out: digest = Buffer de `HASH_MD5_SIZE` bytes donde se escribe el MD5.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void HASH_digest(const FileHash *hash, uint8_t digest[HASH_MD5_SIZE]) {
+    FileHash final = *hash;
+    uint8_t padding[72] = {0x80};
+    uint64_t bits = hash->length * 8;
+    size_t used = (size_t)(hash->length % 64);
+    size_t pad = (used < 56 ? 56 : 120) - used;
+
+    //farciment fins a 56 bytes mòdul 64 i la longitud en bits (little endian)
+    for (int i = 0; i < 8; i++) padding[pad + i] = (uint8_t)(bits >> (8 * i));
+    HASH_update(&final, padding, pad + 8);
+
+    for (int i = 0; i < HASH_MD5_SIZE; i++) {
+        digest[i] = (uint8_t)(final.state[i / 4] >> (8 * (i % 4)));
+    }
+}
+
+/***********************************************
+*
+* @Finalidad: Obtener en hexadecimal el MD5 de los bytes resumidos hasta ahora. El estado
+*             no se modifica, de modo que se puede seguir añadiendo datos.
+*
+* @Parámetros:
+* in: hash = Estado del MD5.
+* out: hex = Buffer de `HASH_MD5_HEX_SIZE` bytes donde se escribe el MD5.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void HASH_toHex(const FileHash *hash, char hex[HASH_MD5_HEX_SIZE]) {
+    static const char digits[] = "0123456789abcdef";
+    uint8_t digest[HASH_MD5_SIZE];
+
+    HASH_digest(hash, digest);
+    for (int i = 0; i < HASH_MD5_SIZE; i++) {
+        hex[i * 2] = digits[digest[i] >> 4];
+        hex[i * 2 + 1] = digits[digest[i] & 0x0f];
+    }
+    hex[HASH_MD5_HEX_SIZE - 1] = '\0';
+}
+
+/***********************************************
+*
+* @Finalidad: Completar el MD5 de un fichero leyendo solo la parte que aún no se ha
+*             resumido (e.g., todo el fichero si el MD5 está vacío) y obtenerlo en
+*             hexadecimal.
+*
+* @Parámetros:
+* in/out: hash = Estado del MD5. Al acabar cubre el fichero entero.
+* in: file_path = Ruta del fichero.
+*
+* @Retorno:
+*           Cadena dinámica con el MD5 en hexadecimal.
+*           NULL si no se ha podido abrir o leer el fichero.
+*
+************************************************/
+char* HASH_completeFile(FileHash *hash, const char *file_path) {
+    struct stat file_stat;
+    char *hex;
+    int fd = open(file_path, O_RDONLY);
+
+    if (fd < 0) return NULL;
+    if (fstat(fd, &file_stat) < 0 || HASH_advance(hash, fd, NULL, file_stat.st_size) < 0) {
+        close(fd);
+        return NULL;
+    }
+    close(fd);
+
+    hex = (char *)malloc(HASH_MD5_HEX_SIZE);
+    if (hex) HASH_toHex(hash, hex);
+    return hex;
+}
+
+/***********************************************
+*
+* @Finalidad: Calcular el MD5 de un fichero completo leyéndolo de principio a fin.
+*
+* @Parámetros:
+* in: file_path = Ruta del fichero.
+*
+* @Retorno:
+*           Cadena dinámica con el MD5 en hexadecimal.
+*           NULL si no se ha podido abrir o leer el fichero.
+*
+************************************************/
+char* HASH_fileMD5(const char *file_path) {
+    FileHash hash = HASH_EMPTY;
+
+    return HASH_completeFile(&hash, file_path);
+}
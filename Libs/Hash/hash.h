@@ -0,0 +1,140 @@
+/***********************************************
+*
+* @Autores: Alexandre Contreras y Armand López
+* @Propósito: Proveer un cálculo incremental del MD5 de un fichero, que se alimenta con
+*             los paquetes a medida que se envían o se reciben y cuyo estado se puede
+*             guardar en memoria compartida para continuarlo al reanudar una transferencia.
+* @Fecha de creación: 16 de octubre de 2026
+* @Última modificación: 16 de octubre de 2026
+*
+************************************************/
+
+#ifndef _HASH_CUSTOM_H_
+#define _HASH_CUSTOM_H_
+
+//Libreries del sistema
+#include <stdint.h>    // uint8_t, uint32_t, uint64_t
+#include <stdlib.h>    // malloc, free
+#include <string.h>    // memcpy, memset
+#include <unistd.h>    // pread, close
+#include <fcntl.h>     // open, O_RDONLY
+#include <errno.h>     // errno, EINTR
+#include <sys/types.h> // off_t
+#include <sys/stat.h>  // fstat
+
+//Llibreries pròpies
+#include "../Structure/typeDistort.h"
+
+//Constants
+#define HASH_MD5_SIZE 16                // Bytes d'un MD5 en binari
+#define HASH_MD5_HEX_SIZE 33            // Dígits hexadecimals d'un MD5 més el '\0'
+#define HASH_READ_CHUNK (256 * 1024)    // Bytes que es llegeixen de cop quan s'ha de resumir des del disc
+#define HASH_EMPTY {{0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476}, 0, {0}}  // Inicialitzador d'un MD5 sense dades (equivalent a HASH_init)
+
+//Funcions
+
+/***********************************************
+*
+* @Finalidad: Inicializar el MD5 incremental de un fichero sin ningún byte resumido.
+*
+* @Parámetros:
+* out: hash = Estado a inicializar.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void HASH_init(FileHash *hash);
+
+/***********************************************
+*
+* @Finalidad: Añadir al MD5 los bytes que siguen a los ya resumidos.
+*
+* @Parámetros:
+* in/out: hash = Estado del MD5.
+* in: data = Bytes a añadir.
+* in: length = Número de bytes de `data`.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void HASH_update(FileHash *hash, const void *data, size_t length);
+
+/***********************************************
+*
+* @Finalidad: Resumir los bytes del fichero entre `hash->length` y `end` que aún no se han
+*             añadido al MD5, leyéndolos de la proyección en memoria si se da o del
+*             descriptor en caso contrario. Si el MD5 ya llega a `end` no hace nada.
+*
+* @Parámetros:
+* in/out: hash = Estado del MD5.
+* in: fd = Descriptor del fichero (solo se usa si `mapped` es NULL).
+* in: mapped = Proyección en memoria del fichero completo, o NULL.
+* in: end = Posición del fichero hasta la que se quiere tener el MD5.
+*
+* @Retorno:
+*           0 = El MD5 llega hasta `end`.
+*          -1 = Error al leer el fichero (el MD5 queda en el último byte leído).
+*
+************************************************/
+int HASH_advance(FileHash *hash, int fd, const uint8_t *mapped, off_t end);
+
+/***********************************************
+*
+* @Finalidad: Obtener el MD5 (en binario) de los bytes resumidos hasta ahora. El estado
+*             no se modifica, de modo que se puede seguir añadiendo datos.
+*
+* @Parámetros:
+* in: hash = Estado del MD5.
+* out: digest = Buffer de `HASH_MD5_SIZE` bytes donde se escribe el MD5.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void HASH_digest(const FileHash *hash, uint8_t digest[HASH_MD5_SIZE]);
+
+/***********************************************
+*
+* @Finalidad: Obtener en hexadecimal el MD5 de los bytes resumidos hasta ahora. El estado
+*             no se modifica, de modo que se puede seguir añadiendo datos.
+*
+* @Parámetros:
+* in: hash = Estado del MD5.
+* out: hex = Buffer de `HASH_MD5_HEX_SIZE` bytes donde se escribe el MD5.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void HASH_toHex(const FileHash *hash, char hex[HASH_MD5_HEX_SIZE]);
+
+/***********************************************
+*
+* @Finalidad: Completar el MD5 de un fichero leyendo solo la parte que aún no se ha
+*             resumido (e.g., todo el fichero si el MD5 está vacío) y obtenerlo en
+*             hexadecimal.
+*
+* @Parámetros:
+* in/out: hash = Estado del MD5. Al acabar cubre el fichero entero.
+* in: file_path = Ruta del fichero.
+*
+* @Retorno:
+*           Cadena dinámica con el MD5 en hexadecimal.
+*           NULL si no se ha podido abrir o leer el fichero.
+*
+************************************************/
+char* HASH_completeFile(FileHash *hash, const char *file_path);
+
+/***********************************************
+*
+* @Finalidad: Calcular el MD5 de un fichero completo leyéndolo de principio a fin.
+*
+* @Parámetros:
+* in: file_path = Ruta del fichero.
+*
+* @Retorno:
+*           Cadena dinámica con el MD5 en hexadecimal.
+*           NULL si no se ha podido abrir o leer el fichero.
+*
+************************************************/
+char* HASH_fileMD5(const char *file_path);
+
+#endif // _HASH_CUSTOM_H_
@@ -0,0 +1,416 @@
+/***********************************************
+*
+* @Autores: Alexandre Contreras, Armand López.
+*
+* @Finalidad: Implementar el árbol de Merkle de los bloques de un fichero: cálculo de
+*             las hojas y la raíz en el emisor y verificación de cada bloque contra su
+*             hoja en el receptor, para detectar la corrupción en cuanto llega un bloque
+*             y no solo con el MD5 del fichero entero al acabar.
+*
+* @Fecha de creación: 16 de octubre de 2026.
+*
+* @Última modificación: 16 de octubre de 2026.
+*
+************************************************/
+
+#include "merkle.h"
+
+/***********************************************
+*
+* @Finalidad: Resumir un tramo del fichero en el MD5 de un bloque y, si es justo lo que
+*             sigue a lo ya resumido, también en el MD5 del fichero entero.
+*
+* @Parámetros:
+* in/out: leaf = MD5 del bloque.
+* in/out: hash = MD5 del fichero entero, o NULL.
+* in: fd = Descriptor del fichero (solo se usa si `mapped` es NULL).
+* in: mapped = Proyección en memoria del fichero completo, o NULL.
+* in: buffer = Buffer de `HASH_READ_CHUNK` bytes para leer del descriptor.
+* in: offset = Posición del tramo.
+* in: length = Bytes del tramo.
+*
+* @Retorno:
+*           0 = Tramo resumido.
+*          -1 = Error al leer el fichero.
+*
+************************************************/
+static int MERKLE_hashRange(FileHash *leaf, FileHash *hash, int fd, const uint8_t *mapped, uint8_t *buffer, off_t offset, off_t length) {
+    while (length > 0) {
+        size_t want = length > HASH_READ_CHUNK ? HASH_READ_CHUNK : (size_t)length;
+        const uint8_t *data = mapped ? mapped + offset : buffer;
+        ssize_t got = (ssize_t)want;
+
+        if (!mapped) {
+            got = pread(fd, buffer, want, offset);
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) return -1;
+        }
+
+        HASH_update(leaf, data, (size_t)got);
+        //el MD5 del fitxer només avança si aquest tram continua el que ja tenia
+        if (hash && offset <= (off_t)hash->length && offset + got > (off_t)hash->length) {
+            HASH_update(hash, data + (hash->length - (uint64_t)offset), (size_t)(offset + got - (off_t)hash->length));
+        }
+        offset += got;
+        length -= got;
+    }
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalidad: Calcular la raíz a partir de las hojas, nivel a nivel. Cada nodo es el MD5
+*             de `MERKLE_NODE_PREFIX` y sus dos hijos; un nodo sin pareja sube tal cual.
+*
+* @Parámetros:
+* in: leaves = MD5 de los bloques.
+* in: n_chunks = Número de hojas (como mínimo una).
+* out: root = Raíz del árbol.
+*
+* @Retorno:
+*           0 = Raíz calculada.
+*          -1 = Error de memoria.
+*
+************************************************/
+static int MERKLE_computeRoot(const uint8_t *leaves, int n_chunks, uint8_t root[MERKLE_DIGEST_SIZE]) {
+    uint8_t *level = (uint8_t *)malloc((size_t)n_chunks * MERKLE_DIGEST_SIZE);
+    uint8_t prefix = MERKLE_NODE_PREFIX;
+    int n_nodes = n_chunks;
+
+    if (!level) return -1;
+    memcpy(level, leaves, (size_t)n_chunks * MERKLE_DIGEST_SIZE);
+
+    //cada nivell es calcula sobre el mateix buffer: el node i només llegeix els nodes 2i i 2i+1
+    while (n_nodes > 1) {
+        int parents = 0;
+
+        for (int i = 0; i < n_nodes; i += 2) {
+            if (i + 1 < n_nodes) {
+                FileHash node = HASH_EMPTY;
+
+                HASH_update(&node, &prefix, 1);
+                HASH_update(&node, level + (size_t)i * MERKLE_DIGEST_SIZE, 2 * MERKLE_DIGEST_SIZE);
+                HASH_digest(&node, level + (size_t)parents * MERKLE_DIGEST_SIZE);
+            } else {
+                memmove(level + (size_t)parents * MERKLE_DIGEST_SIZE, level + (size_t)i * MERKLE_DIGEST_SIZE, MERKLE_DIGEST_SIZE);
+            }
+            parents++;
+        }
+        n_nodes = parents;
+    }
+
+    memcpy(root, level, MERKLE_DIGEST_SIZE);
+    free(level);
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalidad: Dejar un `MerkleTree` vacío, sin bloques.
+*
+* @Parámetros:
+* out: tree = Árbol a inicializar.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void MERKLE_init(MerkleTree *tree) {
+    MerkleTree empty = MERKLE_EMPTY_TREE;
+
+    *tree = empty;
+}
+
+/***********************************************
+*
+* @Finalidad: Liberar la memoria de un árbol y dejarlo vacío.
+*
+* @Parámetros:
+* in/out: tree = Árbol a liberar.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void MERKLE_free(MerkleTree *tree) {
+    free(tree->leaves);
+    free(tree->verified);
+    MERKLE_init(tree);
+}
+
+/***********************************************
+*
+* @Finalidad: Escoger el tamaño de bloque de un fichero: un múltiplo del tamaño de paquete
+*             (así un bloque corrupto se vuelve a pedir con paquetes enteros) lo bastante
+*             grande para no pasar de `MERKLE_MAX_CHUNKS` bloques.
+*
+* @Parámetros:
+* in: file_size = Tamaño del fichero en bytes.
+* in: data_size = Bytes de datos por paquete.
+*
+* @Retorno: Bytes de cada bloque.
+*
+************************************************/
+uint32_t MERKLE_chooseChunkSize(off_t file_size, uint32_t data_size) {
+    off_t max_bytes = (off_t)data_size * MERKLE_MAX_CHUNKS;
+    uint32_t packets = (uint32_t)((file_size + max_bytes - 1) / max_bytes);
+
+    return data_size * (packets > 0 ? packets : 1);
+}
+
+/***********************************************
+*
+* @Finalidad: Calcular las hojas y la raíz del árbol de un fichero leyéndolo una sola vez.
+*             En la misma pasada se completa el MD5 del fichero entero, de modo que
+*             enviar la raíz no cuesta una segunda lectura.
+*
+* @Parámetros:
+* out: tree = Árbol del fichero. Se libera el anterior.
+* in: file_path = Ruta del fichero.
+* in: chunk_size = Bytes de cada bloque (e.g., de `MERKLE_chooseChunkSize`).
+* in/out: hash = MD5 incremental del fichero, o NULL. Se le añade lo que aún no resumía.
+*
+* @Retorno:
+*           0 = Árbol calculado (sin bloques si el fichero está vacío).
+*          -1 = Error al leer el fichero o de memoria.
+*
+************************************************/
+int MERKLE_build(MerkleTree *tree, const char *file_path, uint32_t chunk_size, FileHash *hash) {
+    struct stat file_stat;
+    uint8_t prefix = MERKLE_LEAF_PREFIX;
+    uint8_t *buffer;
+    int fd;
+
+    MERKLE_free(tree);
+    if (chunk_size == 0) return -1;
+
+    fd = open(file_path, O_RDONLY);
+    if (fd < 0) return -1;
+    if (fstat(fd, &file_stat) < 0 || (file_stat.st_size + chunk_size - 1) / chunk_size > MERKLE_MAX_CHUNKS) {
+        close(fd);
+        return -1;
+    }
+
+    tree->chunk_size = chunk_size;
+    tree->n_chunks = (int)((file_stat.st_size + chunk_size - 1) / chunk_size);
+    if (tree->n_chunks == 0) {
+        close(fd);
+        return 0;
+    }
+
+    tree->leaves = (uint8_t *)malloc((size_t)tree->n_chunks * MERKLE_DIGEST_SIZE);
+    buffer = (uint8_t *)malloc(HASH_READ_CHUNK);
+    if (!tree->leaves || !buffer) {
+        free(buffer);
+        close(fd);
+        MERKLE_free(tree);
+        return -1;
+    }
+
+    for (int i = 0; i < tree->n_chunks; i++) {
+        off_t offset = (off_t)i * chunk_size;
+        off_t length = file_stat.st_size - offset > (off_t)chunk_size ? (off_t)chunk_size : file_stat.st_size - offset;
+        FileHash leaf = HASH_EMPTY;
+
+        HASH_update(&leaf, &prefix, 1);
+        if (MERKLE_hashRange(&leaf, hash, fd, NULL, buffer, offset, length) < 0) {
+            free(buffer);
+            close(fd);
+            MERKLE_free(tree);
+            return -1;
+        }
+        HASH_digest(&leaf, tree->leaves + (size_t)i * MERKLE_DIGEST_SIZE);
+    }
+    free(buffer);
+    close(fd);
+
+    if (MERKLE_computeRoot(tree->leaves, tree->n_chunks, tree->root) < 0) {
+        MERKLE_free(tree);
+        return -1;
+    }
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalidad: Preparar el árbol del fichero que se va a recibir con la raíz y el tamaño de
+*             bloque de sus metadatos. Las hojas llegan después (`MERKLE_setLeaves`).
+*
+* @Parámetros:
+* out: tree = Árbol a preparar. Se libera el anterior.
+* in: root_hex = Raíz del árbol en hexadecimal.
+* in: chunk_size = Bytes de cada bloque.
+* in: file_size = Tamaño del fichero en bytes.
+*
+* @Retorno:
+*           0 = Árbol preparado.
+*          -1 = Raíz, tamaño de bloque o número de bloques no válidos.
+*
+************************************************/
+int MERKLE_setRoot(MerkleTree *tree, const char *root_hex, uint32_t chunk_size, off_t file_size) {
+    MERKLE_free(tree);
+    if (!root_hex || strlen(root_hex) != HASH_MD5_HEX_SIZE - 1 || chunk_size == 0 || file_size <= 0) return -1;
+    if ((file_size + chunk_size - 1) / chunk_size > MERKLE_MAX_CHUNKS) return -1;
+
+    for (int i = 0; i < MERKLE_DIGEST_SIZE; i++) {
+        int byte = 0;
+
+        for (int j = 0; j < 2; j++) {
+            char digit = root_hex[i * 2 + j];
+            int value = digit >= '0' && digit <= '9' ? digit - '0' : (digit >= 'a' && digit <= 'f' ? digit - 'a' + 10 : -1);
+
+            if (value < 0) return -1;
+            byte = (byte << 4) | value;
+        }
+        tree->root[i] = (uint8_t)byte;
+    }
+
+    tree->chunk_size = chunk_size;
+    tree->n_chunks = (int)((file_size + chunk_size - 1) / chunk_size);
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalidad: Guardar las hojas recibidas de un árbol preparado con `MERKLE_setRoot`,
+*             comprobando que llevan a la raíz de los metadatos. A partir de aquí se
+*             pueden verificar los bloques.
+*
+* @Parámetros:
+* in/out: tree = Árbol con la raíz.
+* in: leaves = MD5 de los `tree->n_chunks` bloques, uno detrás del otro.
+* in: length = Bytes de `leaves`.
+*
+* @Retorno:
+*           0 = Hojas guardadas.
+*          -1 = Las hojas no corresponden a la raíz o error de memoria.
+*
+************************************************/
+int MERKLE_setLeaves(MerkleTree *tree, const uint8_t *leaves, size_t length) {
+    uint8_t root[MERKLE_DIGEST_SIZE];
+
+    if (tree->n_chunks <= 0 || length != (size_t)tree->n_chunks * MERKLE_DIGEST_SIZE) return -1;
+    if (MERKLE_computeRoot(leaves, tree->n_chunks, root) < 0 || memcmp(root, tree->root, MERKLE_DIGEST_SIZE) != 0) return -1;
+
+    free(tree->leaves);
+    free(tree->verified);
+    tree->leaves = (uint8_t *)malloc(length);
+    tree->verified = (uint8_t *)calloc((size_t)tree->n_chunks, 1);
+    if (!tree->leaves || !tree->verified) {
+        free(tree->leaves);
+        free(tree->verified);
+        tree->leaves = NULL;
+        tree->verified = NULL;
+        return -1;
+    }
+    memcpy(tree->leaves, leaves, length);
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalidad: Obtener los paquetes que contienen los bytes de un bloque.
+*
+* @Parámetros:
+* in: tree = Árbol del fichero.
+* in: chunk = Índice del bloque.
+* in: data_size = Bytes de datos por paquete.
+* in: file_size = Tamaño del fichero en bytes.
+* out: first_packet = Primer paquete del bloque.
+* out: n_packets = Número de paquetes del bloque.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void MERKLE_getChunkPackets(const MerkleTree *tree, int chunk, uint32_t data_size, off_t file_size, int *first_packet, int *n_packets) {
+    off_t start = (off_t)chunk * tree->chunk_size;
+    off_t end = start + tree->chunk_size < file_size ? start + tree->chunk_size : file_size;
+
+    //si el bloc no comença o acaba en una frontera de paquet (e.g., s'ha acordat una altra mida de paquet) compartirà paquets amb els veïns
+    *first_packet = (int)(start / data_size);
+    *n_packets = (int)((end + data_size - 1) / data_size) - *first_packet;
+}
+
+/***********************************************
+*
+* @Finalidad: Comprobar un bloque escrito en el fichero contra su hoja, leyéndolo de la
+*             proyección en memoria si se da o del descriptor en caso contrario. Si
+*             coincide queda marcado como verificado.
+*
+* @Parámetros:
+* in/out: tree = Árbol con las hojas.
+* in: chunk = Índice del bloque.
+* in: fd = Descriptor del fichero (solo se usa si `mapped` es NULL).
+* in: mapped = Proyección en memoria del fichero completo, o NULL.
+* in: file_size = Tamaño del fichero en bytes.
+*
+* @Retorno:
+*           1 = El bloque es correcto.
+*           0 = El bloque no coincide con su hoja.
+*          -1 = Error al leer el fichero.
+*
+************************************************/
+int MERKLE_verifyChunk(MerkleTree *tree, int chunk, int fd, const uint8_t *mapped, off_t file_size) {
+    off_t offset = (off_t)chunk * tree->chunk_size;
+    off_t length = file_size - offset > (off_t)tree->chunk_size ? (off_t)tree->chunk_size : file_size - offset;
+    uint8_t prefix = MERKLE_LEAF_PREFIX;
+    uint8_t digest[MERKLE_DIGEST_SIZE];
+    uint8_t *buffer = NULL;
+    FileHash leaf = HASH_EMPTY;
+
+    if (!mapped) {
+        buffer = (uint8_t *)malloc(HASH_READ_CHUNK);
+        if (!buffer) return -1;
+    }
+
+    HASH_update(&leaf, &prefix, 1);
+    int read_result = MERKLE_hashRange(&leaf, NULL, fd, mapped, buffer, offset, length);
+    free(buffer);
+    if (read_result < 0) return -1;
+
+    HASH_digest(&leaf, digest);
+    tree->verified[chunk] = memcmp(digest, tree->leaves + (size_t)chunk * MERKLE_DIGEST_SIZE, MERKLE_DIGEST_SIZE) == 0;
+    return tree->verified[chunk];
+}
+
+/***********************************************
+*
+* @Finalidad: Calcular hasta qué posición del fichero llegan los bloques verificados sin
+*             ningún hueco, que es hasta donde se puede resumir el fichero recibido.
+*
+* @Parámetros:
+* in: tree = Árbol con las hojas.
+* in: start = Posición hasta la que ya se sabe que todo está verificado (e.g., lo que
+*             cubre el MD5 del fichero), para no volver a recorrer esos bloques.
+* in: file_size = Tamaño del fichero en bytes.
+*
+* @Retorno: Bytes del principio del fichero que están verificados.
+*
+************************************************/
+off_t MERKLE_verifiedPrefix(const MerkleTree *tree, off_t start, off_t file_size) {
+    int chunk = (int)(start / tree->chunk_size);
+
+    while (chunk < tree->n_chunks && tree->verified[chunk]) chunk++;
+
+    off_t prefix = (off_t)chunk * tree->chunk_size;
+    return prefix < file_size ? prefix : file_size;
+}
+
+/***********************************************
+*
+* @Finalidad: Obtener la raíz del árbol en hexadecimal, para los metadatos.
+*
+* @Parámetros:
+* in: tree = Árbol calculado con `MERKLE_build`.
+* out: hex = Buffer de `HASH_MD5_HEX_SIZE` bytes donde se escribe la raíz.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void MERKLE_rootToHex(const MerkleTree *tree, char hex[HASH_MD5_HEX_SIZE]) {
+    static const char digits[] = "0123456789abcdef";
+
+    for (int i = 0; i < MERKLE_DIGEST_SIZE; i++) {
+        hex[i * 2] = digits[tree->root[i] >> 4];
+        hex[i * 2 + 1] = digits[tree->root[i] & 0x0f];
+    }
+    hex[HASH_MD5_HEX_SIZE - 1] = '\0';
+}
@@ -0,0 +1,201 @@
+/***********************************************
+*
+* @Autores: Alexandre Contreras y Armand López
+* @Propósito: Proveer un árbol de Merkle sobre los bloques de un fichero: el emisor
+*             calcula el MD5 de cada bloque y la raíz del árbol, y el receptor, con la
+*             raíz de los metadatos y las hojas, comprueba cada bloque en cuanto lo tiene
+*             entero, de modo que solo se vuelven a pedir los bloques corruptos.
+* @Fecha de creación: 16 de octubre de 2026
+* @Última modificación: 16 de octubre de 2026
+*
+************************************************/
+
+#ifndef _MERKLE_CUSTOM_H_
+#define _MERKLE_CUSTOM_H_
+
+//Libreries del sistema
+#include <stdint.h>    // uint8_t, uint32_t
+#include <stdlib.h>    // malloc, calloc, free
+#include <string.h>    // memcpy, memcmp, strlen
+#include <unistd.h>    // pread, close
+#include <fcntl.h>     // open, O_RDONLY
+#include <errno.h>     // errno, EINTR
+#include <sys/types.h> // off_t
+#include <sys/stat.h>  // fstat
+
+//Llibreries pròpies
+#include "../Structure/typeDistort.h"
+#include "hash.h"
+
+//Constants
+#define MERKLE_DIGEST_SIZE HASH_MD5_SIZE    // Bytes de cada node de l'arbre (un MD5)
+#define MERKLE_MAX_CHUNKS (64 * 1024)       // Límit de blocs d'un fitxer: les fulles (1 MiB) caben en una trama v2
+#define MERKLE_MIN_FILE_SIZE (16 * 1024 * 1024)   // Bytes a partir dels quals es calcula l'arbre: per sota, tornar a enviar el fitxer sencer costa menys que llegir-lo un cop més abans d'enviar-lo
+#define MERKLE_LEAF_PREFIX 0x00             // Byte que precedeix les dades d'un bloc en calcular la seva fulla
+#define MERKLE_NODE_PREFIX 0x01             // Byte que precedeix els dos fills en calcular un node intern
+#define MERKLE_EMPTY_TREE {NULL, NULL, 0, 0, {0}}  // Inicialitzador d'un arbre buit (equivalent a MERKLE_init)
+
+//Funcions
+
+/***********************************************
+*
+* @Finalidad: Dejar un `MerkleTree` vacío, sin bloques.
+*
+* @Parámetros:
+* out: tree = Árbol a inicializar.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void MERKLE_init(MerkleTree *tree);
+
+/***********************************************
+*
+* @Finalidad: Liberar la memoria de un árbol y dejarlo vacío.
+*
+* @Parámetros:
+* in/out: tree = Árbol a liberar.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void MERKLE_free(MerkleTree *tree);
+
+/***********************************************
+*
+* @Finalidad: Escoger el tamaño de bloque de un fichero: un múltiplo del tamaño de paquete
+*             (así un bloque corrupto se vuelve a pedir con paquetes enteros) lo bastante
+*             grande para no pasar de `MERKLE_MAX_CHUNKS` bloques.
+*
+* @Parámetros:
+* in: file_size = Tamaño del fichero en bytes.
+* in: data_size = Bytes de datos por paquete.
+*
+* @Retorno: Bytes de cada bloque.
+*
+************************************************/
+uint32_t MERKLE_chooseChunkSize(off_t file_size, uint32_t data_size);
+
+/***********************************************
+*
+* @Finalidad: Calcular las hojas y la raíz del árbol de un fichero leyéndolo una sola vez.
+*             En la misma pasada se completa el MD5 del fichero entero, de modo que
+*             enviar la raíz no cuesta una segunda lectura.
+*
+* @Parámetros:
+* out: tree = Árbol del fichero. Se libera el anterior.
+* in: file_path = Ruta del fichero.
+* in: chunk_size = Bytes de cada bloque (e.g., de `MERKLE_chooseChunkSize`).
+* in/out: hash = MD5 incremental del fichero, o NULL. Se le añade lo que aún no resumía.
+*
+* @Retorno:
+*           0 = Árbol calculado (sin bloques si el fichero está vacío).
+*          -1 = Error al leer el fichero o de memoria.
+*
+************************************************/
+int MERKLE_build(MerkleTree *tree, const char *file_path, uint32_t chunk_size, FileHash *hash);
+
+/***********************************************
+*
+* @Finalidad: Preparar el árbol del fichero que se va a recibir con la raíz y el tamaño de
+*             bloque de sus metadatos. Las hojas llegan después (`MERKLE_setLeaves`).
+*
+* @Parámetros:
+* out: tree = Árbol a preparar. Se libera el anterior.
+* in: root_hex = Raíz del árbol en hexadecimal.
+* in: chunk_size = Bytes de cada bloque.
+* in: file_size = Tamaño del fichero en bytes.
+*
+* @Retorno:
+*           0 = Árbol preparado.
+*          -1 = Raíz, tamaño de bloque o número de bloques no válidos.
+*
+************************************************/
+int MERKLE_setRoot(MerkleTree *tree, const char *root_hex, uint32_t chunk_size, off_t file_size);
+
+/***********************************************
+*
+* @Finalidad: Guardar las hojas recibidas de un árbol preparado con `MERKLE_setRoot`,
+*             comprobando que llevan a la raíz de los metadatos. A partir de aquí se
+*             pueden verificar los bloques.
+*
+* @Parámetros:
+* in/out: tree = Árbol con la raíz.
+* in: leaves = MD5 de los `tree->n_chunks` bloques, uno detrás del otro.
+* in: length = Bytes de `leaves`.
+*
+* @Retorno:
+*           0 = Hojas guardadas.
+*          -1 = Las hojas no corresponden a la raíz o error de memoria.
+*
+************************************************/
+int MERKLE_setLeaves(MerkleTree *tree, const uint8_t *leaves, size_t length);
+
+/***********************************************
+*
+* @Finalidad: Obtener los paquetes que contienen los bytes de un bloque.
+*
+* @Parámetros:
+* in: tree = Árbol del fichero.
+* in: chunk = Índice del bloque.
+* in: data_size = Bytes de datos por paquete.
+* in: file_size = Tamaño del fichero en bytes.
+* out: first_packet = Primer paquete del bloque.
+* out: n_packets = Número de paquetes del bloque.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void MERKLE_getChunkPackets(const MerkleTree *tree, int chunk, uint32_t data_size, off_t file_size, int *first_packet, int *n_packets);
+
+/***********************************************
+*
+* @Finalidad: Comprobar un bloque escrito en el fichero contra su hoja, leyéndolo de la
+*             proyección en memoria si se da o del descriptor en caso contrario. Si
+*             coincide queda marcado como verificado.
+*
+* @Parámetros:
+* in/out: tree = Árbol con las hojas.
+* in: chunk = Índice del bloque.
+* in: fd = Descriptor del fichero (solo se usa si `mapped` es NULL).
+* in: mapped = Proyección en memoria del fichero completo, o NULL.
+* in: file_size = Tamaño del fichero en bytes.
+*
+* @Retorno:
+*           1 = El bloque es correcto.
+*           0 = El bloque no coincide con su hoja.
+*          -1 = Error al leer el fichero.
+*
+************************************************/
+int MERKLE_verifyChunk(MerkleTree *tree, int chunk, int fd, const uint8_t *mapped, off_t file_size);
+
+/***********************************************
+*
+* @Finalidad: Calcular hasta qué posición del fichero llegan los bloques verificados sin
+*             ningún hueco, que es hasta donde se puede resumir el fichero recibido.
+*
+* @Parámetros:
+* in: tree = Árbol con las hojas.
+* in: start = Posición hasta la que ya se sabe que todo está verificado (e.g., lo que
+*             cubre el MD5 del fichero), para no volver a recorrer esos bloques.
+* in: file_size = Tamaño del fichero en bytes.
+*
+* @Retorno: Bytes del principio del fichero que están verificados.
+*
+************************************************/
+off_t MERKLE_verifiedPrefix(const MerkleTree *tree, off_t start, off_t file_size);
+
+/***********************************************
+*
+* @Finalidad: Obtener la raíz del árbol en hexadecimal, para los metadatos.
+*
+* @Parámetros:
+* in: tree = Árbol calculado con `MERKLE_build`.
+* out: hex = Buffer de `HASH_MD5_HEX_SIZE` bytes donde se escribe la raíz.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void MERKLE_rootToHex(const MerkleTree *tree, char hex[HASH_MD5_HEX_SIZE]);
+
+#endif // _MERKLE_CUSTOM_H_
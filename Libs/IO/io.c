@@ -81,13 +81,16 @@ char *IO_readUntil(int fd, char cEnd) {
 * in: fd = Descriptor de archivo desde el cual se leerán los caracteres. 
 * in: cEnd = Carácter delimitador que indica el fin de la lectura. 
 * in: exit_flag = Puntero a una bandera `volatile int` que indica si se debe interrumpir la operación de lectura. 
+* in: flags = Array de banderas que también interrumpen la lectura si alguna se activa 
+*             (e.g., la de cada distorsión que termina). 
+* in: n_flags = Número de banderas de `flags`. 
 * 
 * @Retorno: 
 *           Puntero a una cadena dinámica que contiene los caracteres leídos hasta el delimitador. 
 *           Retorna NULL si ocurre un error, se alcanza el EOF sin leer nada, o si se detecta la señal de interrupción. 
 * 
 ************************************************/
-char *IO_nonBlockingReadUntil(int fd, char cEnd, volatile int* exit_flag, int* flag2, int* flag3) {
+char *IO_nonBlockingReadUntil(int fd, char cEnd, volatile int* exit_flag, int* flags, int n_flags) {
     int i = 0;
     ssize_t chars_read;
     char c = 0;
@@ -99,7 +102,9 @@ char *IO_nonBlockingReadUntil(int fd, char cEnd, volatile int* exit_flag, int* f
     //Bucle per anar mirant l'estat del fd i detectar si el usuari ens ha introduit alguna comanda
     while (1) {
         // Comprovem si s'ha de sortir del bucle per el cas de Ctrl+C, GothamCrash o Logout
-        if ((*exit_flag) || (*flag2) || (*flag3)) {
+        int flag_set = *exit_flag;
+        for (int k = 0; k < n_flags && !flag_set; k++) flag_set = flags[k];
+        if (flag_set) {
             free(buffer);
             return NULL;
         }
@@ -0,0 +1,362 @@
+/***********************************************
+*
+* @Autores: Alexandre Contreras, Armand López.
+*
+* @Finalidad: Implementar el motor de E/S asíncrona sobre io_uring: creación del ring,
+*             registro de buffers y preparación, envío y finalización de lecturas,
+*             escrituras y recepciones.
+*
+* @Fecha de creación: 16 de octubre de 2026.
+*
+* @Última modificación: 16 de octubre de 2026.
+*
+************************************************/
+
+#include "io_ring.h"
+
+#define IO_RING_CANCEL_USER_DATA UINT64_MAX     // Identificador de l'operació de cancel·lació (la seva finalització no es retorna)
+
+/***********************************************
+*
+* @Finalidad: Dejar un `IORing` vacío, sin ring del kernel asociado.
+*
+* @Parámetros:
+* out: ring = Ring a inicializar.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void IO_ringInitEmpty(IORing *ring) {
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+}
+
+/***********************************************
+*
+* @Finalidad: Crear un ring de io_uring con `IO_RING_ENTRIES` entradas y proyectar sus
+*             colas. Si el kernel no soporta io_uring o lo tiene deshabilitado, el ring
+*             queda vacío y quien llama debe usar las llamadas al sistema bloqueantes.
+*
+* @Parámetros:
+* out: ring = Ring a crear.
+*
+* @Retorno:
+*           0 = Ring creado.
+*          -1 = io_uring no disponible (`errno` indica la causa).
+*
+************************************************/
+int IO_ringInit(IORing *ring) {
+    struct io_uring_params params;
+    IO_ringInitEmpty(ring);
+    memset(&params, 0, sizeof(params));
+
+    int fd = (int)syscall(__NR_io_uring_setup, IO_RING_ENTRIES, &params);
+    if (fd < 0) return -1;
+
+    //amb IORING_FEAT_SINGLE_MMAP (kernel 5.4+) les dues cues comparteixen projecció; sense, no ho fem servir
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        close(fd);
+        errno = ENOSYS;
+        return -1;
+    }
+
+    size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->rings_size = sq_size > cq_size ? sq_size : cq_size;
+    ring->rings = mmap(NULL, ring->rings_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring->rings == MAP_FAILED) {
+        close(fd);
+        IO_ringInitEmpty(ring);
+        return -1;
+    }
+
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        munmap(ring->rings, ring->rings_size);
+        close(fd);
+        IO_ringInitEmpty(ring);
+        return -1;
+    }
+
+    ring->fd = fd;
+    ring->sq_head = (unsigned *)(ring->rings + params.sq_off.head);
+    ring->sq_tail = (unsigned *)(ring->rings + params.sq_off.tail);
+    ring->sq_mask = (unsigned *)(ring->rings + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(ring->rings + params.sq_off.array);
+    ring->cq_head = (unsigned *)(ring->rings + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(ring->rings + params.cq_off.tail);
+    ring->cq_mask = (unsigned *)(ring->rings + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(ring->rings + params.cq_off.cqes);
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalidad: Registrar en el kernel un buffer de usuario, para que las lecturas y
+*             escrituras que lo usan (`IO_ringPrepRead` e `IO_ringPrepWrite` con índice)
+*             no tengan que fijar sus páginas en cada operación.
+*
+* @Parámetros:
+* in/out: ring = Ring creado con `IO_ringInit`.
+* in: buffer = Inicio del buffer (e.g., el almacenamiento de un `FramePool`).
+* in: length = Tamaño del buffer en bytes.
+*
+* @Retorno:
+*           0 = Buffer registrado con el índice 0.
+*          -1 = Error al registrar el buffer.
+*
+************************************************/
+int IO_ringRegisterBuffer(IORing *ring, void *buffer, size_t length) {
+    struct iovec iov = {buffer, length};
+    return syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_BUFFERS, &iov, 1) < 0 ? -1 : 0;
+}
+
+/***********************************************
+*
+* @Finalidad: Obtener una entrada libre de la cola de envío, inicializada a cero.
+*
+* @Parámetros:
+* in/out: ring = Ring creado con `IO_ringInit`.
+*
+* @Retorno: Entrada a rellenar, o NULL si la cola está llena.
+*
+************************************************/
+static struct io_uring_sqe *IO_ringGetSqe(IORing *ring) {
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    unsigned tail = *ring->sq_tail + ring->to_submit;
+    if (tail - head >= IO_RING_ENTRIES) return NULL;
+
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[index] = index;
+    ring->to_submit++;
+    return sqe;
+}
+
+/***********************************************
+*
+* @Finalidad: Preparar una lectura de `length` bytes de un fichero a partir de `offset`.
+*
+* @Parámetros:
+* in/out: ring = Ring creado con `IO_ringInit`.
+* in: fd = Descriptor del fichero.
+* out: buffer = Destino de los datos.
+* in: length = Bytes a leer.
+* in: offset = Posición del fichero desde donde se lee.
+* in: buffer_index = Índice del buffer registrado que contiene `buffer`, o -1 si no lo está.
+* in: user_data = Identificador que devolverá la finalización de la operación.
+*
+* @Retorno:
+*           0 = Operación preparada (se enviará al kernel en la próxima espera).
+*          -1 = La cola de envío está llena.
+*
+************************************************/
+int IO_ringPrepRead(IORing *ring, int fd, void *buffer, unsigned length, uint64_t offset, int buffer_index, uint64_t user_data) {
+    struct io_uring_sqe *sqe = IO_ringGetSqe(ring);
+    if (!sqe) return -1;
+
+    sqe->opcode = buffer_index >= 0 ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)buffer;
+    sqe->len = length;
+    sqe->off = offset;
+    sqe->buf_index = buffer_index >= 0 ? (uint16_t)buffer_index : 0;
+    sqe->user_data = user_data;
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalidad: Preparar una escritura de `length` bytes en un fichero o un socket. En un
+*             socket `offset` se ignora y la escritura puede ser parcial.
+*
+* @Parámetros:
+* in/out: ring = Ring creado con `IO_ringInit`.
+* in: fd = Descriptor del fichero o socket.
+* in: buffer = Datos a escribir.
+* in: length = Bytes a escribir.
+* in: offset = Posición del fichero donde se escribe (0 en un socket).
+* in: buffer_index = Índice del buffer registrado que contiene `buffer`, o -1 si no lo está.
+* in: user_data = Identificador que devolverá la finalización de la operación.
+*
+* @Retorno:
+*           0 = Operación preparada (se enviará al kernel en la próxima espera).
+*          -1 = La cola de envío está llena.
+*
+************************************************/
+int IO_ringPrepWrite(IORing *ring, int fd, const void *buffer, unsigned length, uint64_t offset, int buffer_index, uint64_t user_data) {
+    struct io_uring_sqe *sqe = IO_ringGetSqe(ring);
+    if (!sqe) return -1;
+
+    sqe->opcode = buffer_index >= 0 ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)buffer;
+    sqe->len = length;
+    sqe->off = offset;
+    sqe->buf_index = buffer_index >= 0 ? (uint16_t)buffer_index : 0;
+    sqe->user_data = user_data;
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalidad: Preparar una recepción de como mucho `length` bytes de un socket.
+*
+* @Parámetros:
+* in/out: ring = Ring creado con `IO_ringInit`.
+* in: socket = Descriptor del socket.
+* out: buffer = Destino de los datos.
+* in: length = Bytes que caben en `buffer`.
+* in: user_data = Identificador que devolverá la finalización de la operación.
+*
+* @Retorno:
+*           0 = Operación preparada (se enviará al kernel en la próxima espera).
+*          -1 = La cola de envío está llena.
+*
+************************************************/
+int IO_ringPrepRecv(IORing *ring, int socket, void *buffer, size_t length, uint64_t user_data) {
+    struct io_uring_sqe *sqe = IO_ringGetSqe(ring);
+    if (!sqe) return -1;
+
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = socket;
+    sqe->addr = (uint64_t)(uintptr_t)buffer;
+    sqe->len = (uint32_t)length;
+    sqe->user_data = user_data;
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalidad: Publicar las entradas preparadas y llamar a `io_uring_enter`.
+*
+* @Parámetros:
+* in/out: ring = Ring creado con `IO_ringInit`.
+* in: wait_nr = Finalizaciones que hay que esperar (0 para no esperar).
+*
+* @Retorno:
+*           0 = Llamada hecha.
+*          -1 = Error de `io_uring_enter`.
+*
+************************************************/
+static int IO_ringEnter(IORing *ring, unsigned wait_nr) {
+    if (ring->to_submit > 0) {
+        //publiquem les entrades noves abans que el kernel les vegi
+        __atomic_store_n(ring->sq_tail, *ring->sq_tail + ring->to_submit, __ATOMIC_RELEASE);
+        ring->pending += ring->to_submit;
+        ring->to_submit = 0;
+    }
+
+    //si un senyal interromp una crida, les entrades que el kernel no ha consumit continuen a la cua i s'envien en aquesta
+    unsigned unsubmitted = *ring->sq_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (unsubmitted == 0 && wait_nr == 0) return 0;
+
+    ring->enter_calls++;
+    int result = (int)syscall(__NR_io_uring_enter, ring->fd, unsubmitted, wait_nr, wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    return result < 0 ? -1 : 0;
+}
+
+/***********************************************
+*
+* @Finalidad: Pasar al kernel las operaciones preparadas sin esperar a que acaben.
+*
+* @Parámetros:
+* in/out: ring = Ring creado con `IO_ringInit`.
+*
+* @Retorno:
+*           0 = Operaciones enviadas.
+*          -1 = Error de `io_uring_enter` (`errno` indica la causa, e.g., `EINTR`).
+*
+************************************************/
+int IO_ringSubmit(IORing *ring) {
+    return IO_ringEnter(ring, 0);
+}
+
+/***********************************************
+*
+* @Finalidad: Obtener la finalización de una operación. Antes se pasan al kernel las
+*             operaciones preparadas y, si se pide, se espera a que acabe alguna.
+*
+* @Parámetros:
+* in/out: ring = Ring creado con `IO_ringInit`.
+* out: completion = Identificador y resultado de la operación acabada.
+* in: wait = 1 para bloquearse hasta que acabe una operación, 0 para no esperar.
+*
+* @Retorno:
+*           1 = Se ha obtenido una finalización.
+*           0 = No hay ninguna finalización disponible (solo con `wait` a 0).
+*          -1 = Error de `io_uring_enter` (`errno` indica la causa, e.g., `EINTR` si ha
+*               llegado una señal mientras se esperaba).
+*
+************************************************/
+int IO_ringGetCompletion(IORing *ring, IORingCompletion *completion, int wait) {
+    if (IO_ringSubmit(ring) < 0) return -1;
+
+    while (1) {
+        unsigned head = *ring->cq_head;
+        if (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+            struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+            uint64_t user_data = cqe->user_data;
+            int result = cqe->res;
+            __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+            ring->pending--;
+
+            //la finalització de la cancel·lació no interessa a qui crida, només les de les operacions cancel·lades
+            if (user_data == IO_RING_CANCEL_USER_DATA) continue;
+            completion->user_data = user_data;
+            completion->result = result;
+            return 1;
+        }
+
+        if (!wait || ring->pending == 0) return 0;
+        if (IO_ringEnter(ring, 1) < 0) return -1;
+    }
+}
+
+/***********************************************
+*
+* @Finalidad: Pedir al kernel que cancele todas las operaciones en curso del ring (e.g.,
+*             una recepción que ya no se necesita). Sus finalizaciones llegan con
+*             `-ECANCELED` y se deben recoger igualmente con `IO_ringGetCompletion`.
+*
+* @Parámetros:
+* in/out: ring = Ring creado con `IO_ringInit`.
+*
+* @Retorno:
+*           0 = Cancelación enviada (o no había nada en curso).
+*          -1 = Error al enviar la cancelación.
+*
+************************************************/
+int IO_ringCancelAll(IORing *ring) {
+    if (ring->pending == 0 && ring->to_submit == 0) return 0;
+
+    struct io_uring_sqe *sqe = IO_ringGetSqe(ring);
+    if (!sqe) return -1;
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+    sqe->user_data = IO_RING_CANCEL_USER_DATA;
+    return IO_ringSubmit(ring);
+}
+
+/***********************************************
+*
+* @Finalidad: Cerrar el ring y liberar sus proyecciones. Las operaciones que quedaran en
+*             curso las cancela el kernel.
+*
+* @Parámetros:
+* in/out: ring = Ring a cerrar. Queda vacío.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void IO_ringDestroy(IORing *ring) {
+    if (ring->fd < 0) return;
+
+    munmap(ring->sqes, ring->sqes_size);
+    munmap(ring->rings, ring->rings_size);
+    close(ring->fd);
+    IO_ringInitEmpty(ring);
+}
@@ -0,0 +1,224 @@
+/***********************************************
+*
+* @Autores: Alexandre Contreras y Armand López
+* @Propósito: Proveer un motor de E/S asíncrona sobre io_uring (llamadas al sistema
+*             directas, sin liburing) para que las transferencias de ficheros puedan
+*             tener en curso a la vez lecturas y escrituras de disco con buffers
+*             registrados y envíos y recepciones por el socket.
+* @Fecha de creación: 16 de octubre de 2026
+* @Última modificación: 16 de octubre de 2026
+*
+************************************************/
+
+#ifndef _IO_RING_CUSTOM_H_
+#define _IO_RING_CUSTOM_H_
+
+// Constants del sistema
+#define _GNU_SOURCE
+
+//Libreries del sistema
+#include <stdint.h>         // uint8_t, uint64_t
+#include <stddef.h>         // size_t
+#include <string.h>         // memset
+#include <errno.h>          // errno, EINTR
+#include <unistd.h>         // syscall, close
+#include <sys/mman.h>       // mmap, munmap
+#include <sys/uio.h>        // struct iovec
+#include <sys/syscall.h>    // __NR_io_uring_setup, __NR_io_uring_enter, __NR_io_uring_register
+#include <linux/io_uring.h> // struct io_uring_sqe, struct io_uring_cqe, IORING_*
+
+//Constants
+#define IO_RING_ENTRIES 256             // Operacions que caben a la cua d'enviament del ring (com a mínim el doble de trames en vol)
+
+//Tipus propis
+typedef struct {
+    int fd;                             // Descriptor del ring (-1 si no està inicialitzat)
+    uint8_t *rings;                     // Cues d'enviament i de finalització (una sola projecció)
+    size_t rings_size;                  // Mida de la projecció de les cues
+    struct io_uring_sqe *sqes;          // Entrades de la cua d'enviament
+    size_t sqes_size;                   // Mida de la projecció de les entrades
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;          // Entrades de la cua de finalització
+    unsigned to_submit;                 // Operacions preparades que encara no s'han passat al kernel
+    unsigned pending;                   // Operacions passades al kernel que encara no han acabat
+    unsigned long enter_calls;          // Crides a io_uring_enter fetes amb aquest ring
+} IORing;                               // Ring per transferència, només l'utilitza el thread que l'ha creat
+
+typedef struct {
+    uint64_t user_data;                 // Identificador que es va passar en preparar l'operació
+    int result;                         // Bytes transferits, o -errno si l'operació ha fallat
+} IORingCompletion;
+
+#define IO_EMPTY_RING {-1, NULL, 0, NULL, 0, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, 0, 0, 0}   // Inicialitzador d'un ring buit (equivalent a IO_ringInitEmpty)
+
+//Funcions
+
+/***********************************************
+*
+* @Finalidad: Dejar un `IORing` vacío, sin ring del kernel asociado.
+*
+* @Parámetros:
+* out: ring = Ring a inicializar.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void IO_ringInitEmpty(IORing *ring);
+
+/***********************************************
+*
+* @Finalidad: Crear un ring de io_uring con `IO_RING_ENTRIES` entradas y proyectar sus
+*             colas. Si el kernel no soporta io_uring o lo tiene deshabilitado, el ring
+*             queda vacío y quien llama debe usar las llamadas al sistema bloqueantes.
+*
+* @Parámetros:
+* out: ring = Ring a crear.
+*
+* @Retorno:
+*           0 = Ring creado.
+*          -1 = io_uring no disponible (`errno` indica la causa).
+*
+************************************************/
+int IO_ringInit(IORing *ring);
+
+/***********************************************
+*
+* @Finalidad: Registrar en el kernel un buffer de usuario, para que las lecturas y
+*             escrituras que lo usan (`IO_ringPrepRead` e `IO_ringPrepWrite` con índice)
+*             no tengan que fijar sus páginas en cada operación.
+*
+* @Parámetros:
+* in/out: ring = Ring creado con `IO_ringInit`.
+* in: buffer = Inicio del buffer (e.g., el almacenamiento de un `FramePool`).
+* in: length = Tamaño del buffer en bytes.
+*
+* @Retorno:
+*           0 = Buffer registrado con el índice 0.
+*          -1 = Error al registrar el buffer.
+*
+************************************************/
+int IO_ringRegisterBuffer(IORing *ring, void *buffer, size_t length);
+
+/***********************************************
+*
+* @Finalidad: Preparar una lectura de `length` bytes de un fichero a partir de `offset`.
+*
+* @Parámetros:
+* in/out: ring = Ring creado con `IO_ringInit`.
+* in: fd = Descriptor del fichero.
+* out: buffer = Destino de los datos.
+* in: length = Bytes a leer.
+* in: offset = Posición del fichero desde donde se lee.
+* in: buffer_index = Índice del buffer registrado que contiene `buffer`, o -1 si no lo está.
+* in: user_data = Identificador que devolverá la finalización de la operación.
+*
+* @Retorno:
+*           0 = Operación preparada (se enviará al kernel en la próxima espera).
+*          -1 = La cola de envío está llena.
+*
+************************************************/
+int IO_ringPrepRead(IORing *ring, int fd, void *buffer, unsigned length, uint64_t offset, int buffer_index, uint64_t user_data);
+
+/***********************************************
+*
+* @Finalidad: Preparar una escritura de `length` bytes en un fichero o un socket. En un
+*             socket `offset` se ignora y la escritura puede ser parcial.
+*
+* @Parámetros:
+* in/out: ring = Ring creado con `IO_ringInit`.
+* in: fd = Descriptor del fichero o socket.
+* in: buffer = Datos a escribir.
+* in: length = Bytes a escribir.
+* in: offset = Posición del fichero donde se escribe (0 en un socket).
+* in: buffer_index = Índice del buffer registrado que contiene `buffer`, o -1 si no lo está.
+* in: user_data = Identificador que devolverá la finalización de la operación.
+*
+* @Retorno:
+*           0 = Operación preparada (se enviará al kernel en la próxima espera).
+*          -1 = La cola de envío está llena.
+*
+************************************************/
+int IO_ringPrepWrite(IORing *ring, int fd, const void *buffer, unsigned length, uint64_t offset, int buffer_index, uint64_t user_data);
+
+/***********************************************
+*
+* @Finalidad: Preparar una recepción de como mucho `length` bytes de un socket.
+*
+* @Parámetros:
+* in/out: ring = Ring creado con `IO_ringInit`.
+* in: socket = Descriptor del socket.
+* out: buffer = Destino de los datos.
+* in: length = Bytes que caben en `buffer`.
+* in: user_data = Identificador que devolverá la finalización de la operación.
+*
+* @Retorno:
+*           0 = Operación preparada (se enviará al kernel en la próxima espera).
+*          -1 = La cola de envío está llena.
+*
+************************************************/
+int IO_ringPrepRecv(IORing *ring, int socket, void *buffer, size_t length, uint64_t user_data);
+
+/***********************************************
+*
+* @Finalidad: Pasar al kernel las operaciones preparadas sin esperar a que acaben.
+*
+* @Parámetros:
+* in/out: ring = Ring creado con `IO_ringInit`.
+*
+* @Retorno:
+*           0 = Operaciones enviadas.
+*          -1 = Error de `io_uring_enter` (`errno` indica la causa, e.g., `EINTR`).
+*
+************************************************/
+int IO_ringSubmit(IORing *ring);
+
+/***********************************************
+*
+* @Finalidad: Obtener la finalización de una operación. Antes se pasan al kernel las
+*             operaciones preparadas y, si se pide, se espera a que acabe alguna.
+*
+* @Parámetros:
+* in/out: ring = Ring creado con `IO_ringInit`.
+* out: completion = Identificador y resultado de la operación acabada.
+* in: wait = 1 para bloquearse hasta que acabe una operación, 0 para no esperar.
+*
+* @Retorno:
+*           1 = Se ha obtenido una finalización.
+*           0 = No hay ninguna finalización disponible (solo con `wait` a 0).
+*          -1 = Error de `io_uring_enter` (`errno` indica la causa, e.g., `EINTR` si ha
+*               llegado una señal mientras se esperaba).
+*
+************************************************/
+int IO_ringGetCompletion(IORing *ring, IORingCompletion *completion, int wait);
+
+/***********************************************
+*
+* @Finalidad: Pedir al kernel que cancele todas las operaciones en curso del ring (e.g.,
+*             una recepción que ya no se necesita). Sus finalizaciones llegan con
+*             `-ECANCELED` y se deben recoger igualmente con `IO_ringGetCompletion`.
+*
+* @Parámetros:
+* in/out: ring = Ring creado con `IO_ringInit`.
+*
+* @Retorno:
+*           0 = Cancelación enviada (o no había nada en curso).
+*          -1 = Error al enviar la cancelación.
+*
+************************************************/
+int IO_ringCancelAll(IORing *ring);
+
+/***********************************************
+*
+* @Finalidad: Cerrar el ring y liberar sus proyecciones. Las operaciones que quedaran en
+*             curso las cancela el kernel.
+*
+* @Parámetros:
+* in/out: ring = Ring a cerrar. Queda vacío.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void IO_ringDestroy(IORing *ring);
+
+#endif // _IO_RING_CUSTOM_H_
@@ -14,6 +14,88 @@
 
 #include "load_config.h"
 
+/*********************************************** 
+* 
+* @Finalidad: Interpretar una línea opcional con una opción de las transferencias de 
+*             ficheros: `window <tramas>` (entre 1 y `CONN_MAX_WINDOW_SIZE`), `compression 
+*             on|off`, `io_engine io_uring|syscalls`, `stripes <conexiones>` (entre 1 y 
+*             `CONN_MAX_STRIPES`) o `stats on|off`, que muestra las medidas de cada 
+*             transferencia. 
+* 
+* @Parámetros: 
+* in/out: transfer = Opciones a las que se aplica la línea. 
+* in: line = Línea del fichero de configuración, sin el salto de línea. 
+* 
+* @Retorno: 
+*           1 = La línea era una opción de las transferencias y se ha aplicado. 
+*           0 = La línea no es una opción de las transferencias (o su valor no es válido). 
+* 
+************************************************/
+static int LOAD_parseTransferLine(LoadTransferOptions* transfer, const char* line) {
+    char value[16];
+    int number;
+
+    if (sscanf(line, "window %d", &number) == 1 && number > 0) {
+        transfer->window_size = number > CONN_MAX_WINDOW_SIZE ? CONN_MAX_WINDOW_SIZE : number;
+        return 1;
+    }
+    if (sscanf(line, "compression %15s", value) == 1 && (strcmp(value, "on") == 0 || strcmp(value, "off") == 0)) {
+        if (strcmp(value, "on") == 0) transfer->capabilities |= CONN_CAP_COMPRESSION;
+        else transfer->capabilities &= ~CONN_CAP_COMPRESSION;
+        return 1;
+    }
+    if (sscanf(line, "io_engine %15s", value) == 1 && (strcmp(value, "io_uring") == 0 || strcmp(value, "syscalls") == 0)) {
+        transfer->io_engine = strcmp(value, "io_uring") == 0 ? CONN_IO_URING : CONN_IO_SYSCALLS;
+        return 1;
+    }
+    if (sscanf(line, "stripes %d", &number) == 1 && number > 0) {
+        transfer->stripes = number > CONN_MAX_STRIPES ? CONN_MAX_STRIPES : number;
+        return 1;
+    }
+    if (sscanf(line, "stats %15s", value) == 1 && (strcmp(value, "on") == 0 || strcmp(value, "off") == 0)) {
+        transfer->statistics = strcmp(value, "on") == 0;
+        return 1;
+    }
+    return 0;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Leer las líneas opcionales del final del fichero, tras las de posición fija. 
+*             Cada una empieza por su clave y pueden ir en cualquier orden: las opciones de 
+*             las transferencias de ficheros que entiende `LOAD_parseTransferLine` (en 
+*             Gotham solo cuenta `stats`); en el worker, los límites de ancho de banda: 
+*             `ingress <MB/s>` y `egress <MB/s>` para el presupuesto global de recepción y 
+*             de envío de ficheros, y `share <usuario> <peso>` para la parte relativa de un 
+*             usuario (los demás pesan `SHAPER_DEFAULT_WEIGHT`); y en todos los procesos, 
+*             las opciones TCP que entiende `SOCKET_parseConfigLine`. Las líneas que no se 
+*             reconocen se ignoran. Si faltan, como en los ficheros antiguos, se usan los 
+*             valores por defecto y no hay límite de ancho de banda. 
+* 
+* @Parámetros: 
+* in: fd_file = Descriptor del fichero de configuración, posicionado tras las líneas con posición fija. 
+* out: transfer = Opciones de las transferencias leídas. 
+* out: shaping = Límites leídos, o NULL si el proceso no los admite. 
+* out: socket_options = Opciones TCP leídas. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+static void LOAD_readOptionLines(int fd_file, LoadTransferOptions* transfer, ShaperConfig* shaping, SocketOptions* socket_options) {
+    LoadTransferOptions transfer_defaults = LOAD_DEFAULT_TRANSFER_OPTIONS;
+    ShaperConfig empty = SHAPER_EMPTY_CONFIG;
+    SocketOptions defaults = SOCKET_DEFAULT_OPTIONS;
+    *transfer = transfer_defaults;
+    if (shaping) *shaping = empty;
+    *socket_options = defaults;
+
+    char* line = NULL;
+    while ((line = IO_readUntil(fd_file, '\n')) != NULL) {
+        if (!LOAD_parseTransferLine(transfer, line) && (!shaping || SHAPER_parseConfigLine(shaping, line) == 0)) SOCKET_parseConfigLine(socket_options, line);
+        free(line);
+    }
+}
+
 /*********************************************** 
 * 
 * @Finalidad: Imprimir la configuración de una estructura especificada según su tipo. 
@@ -26,6 +108,8 @@
 * 
 ************************************************/
 void LOAD_printConfig(void* config_struct, int type) {
+    char socket_description[SOCKET_DESCRIPTION_SIZE];
+
     switch (type) {
         case FLECK_CONF: 
             FleckConfig* fleck_config = (FleckConfig*) config_struct;
@@ -33,7 +117,18 @@ void LOAD_printConfig(void* config_struct, int type) {
             IO_printFormat(STDOUT_FILENO, "User - %s\n", fleck_config->username);
             IO_printFormat(STDOUT_FILENO, "Directory - %s\n", fleck_config->folder_path);
             IO_printFormat(STDOUT_FILENO, "IP - %s\n", fleck_config->gotham_ip);
-            IO_printFormat(STDOUT_FILENO, "Port - %d\n\n", fleck_config->gotham_port);
+            if (!fleck_config->statistics) {
+                IO_printFormat(STDOUT_FILENO, "Port - %d\n\n", fleck_config->gotham_port);
+                break;
+            }
+            // Amb "stats on" també es mostren les opcions de les transferències
+            IO_printFormat(STDOUT_FILENO, "Port - %d\n", fleck_config->gotham_port);
+            IO_printFormat(STDOUT_FILENO, "Window - %d\n", fleck_config->window_size);
+            IO_printFormat(STDOUT_FILENO, "Compression - %s\n", (fleck_config->capabilities & CONN_CAP_COMPRESSION) ? "on" : "off");
+            IO_printFormat(STDOUT_FILENO, "I/O engine - %s\n", fleck_config->io_engine == CONN_IO_URING ? "io_uring" : "syscalls");
+            IO_printFormat(STDOUT_FILENO, "Stripes - %d\n", fleck_config->stripes);
+            SOCKET_describeOptions(&fleck_config->socket_options, socket_description, sizeof(socket_description));
+            IO_printFormat(STDOUT_FILENO, "TCP - %s\n\n", socket_description);
             break; 
 
         case GOTHAM_CONF:
@@ -42,6 +137,9 @@ void LOAD_printConfig(void* config_struct, int type) {
             IO_printFormat(STDOUT_FILENO, "Fleck Port: %d\n", gotham_config->fleck_port);
             IO_printFormat(STDOUT_FILENO, "Worker IP: %s\n", gotham_config->worker_ip);
             IO_printFormat(STDOUT_FILENO, "Worker Port: %d\n", gotham_config->worker_port);
+            if (!gotham_config->statistics) break;
+            SOCKET_describeOptions(&gotham_config->socket_options, socket_description, sizeof(socket_description));
+            IO_printFormat(STDOUT_FILENO, "TCP: %s\n", socket_description);
             break; 
 
         case WORKER_CONF:
@@ -52,6 +150,17 @@ void LOAD_printConfig(void* config_struct, int type) {
             IO_printFormat(STDOUT_FILENO, "Fleck Port: %d\n", worker_config->worker_port);
             IO_printFormat(STDOUT_FILENO, "Folder Path: %s\n", worker_config->folder_path);
             IO_printFormat(STDOUT_FILENO, "Worker Type: %s\n", worker_config->worker_type);
+            if (!worker_config->statistics) break;
+            IO_printFormat(STDOUT_FILENO, "Window Size: %d\n", worker_config->window_size);
+            IO_printFormat(STDOUT_FILENO, "Compression: %s\n", (worker_config->capabilities & CONN_CAP_COMPRESSION) ? "on" : "off");
+            IO_printFormat(STDOUT_FILENO, "I/O Engine: %s\n", worker_config->io_engine == CONN_IO_URING ? "io_uring" : "syscalls");
+            if (worker_config->shaping.rates[SHAPER_INGRESS] > 0) IO_printFormat(STDOUT_FILENO, "Ingress Limit: %.1f MB/s\n", worker_config->shaping.rates[SHAPER_INGRESS] / (1024 * 1024));
+            if (worker_config->shaping.rates[SHAPER_EGRESS] > 0) IO_printFormat(STDOUT_FILENO, "Egress Limit: %.1f MB/s\n", worker_config->shaping.rates[SHAPER_EGRESS] / (1024 * 1024));
+            for (int i = 0; i < worker_config->shaping.n_shares; i++) {
+                IO_printFormat(STDOUT_FILENO, "Bandwidth Share: %s x%d\n", worker_config->shaping.shares[i].username, worker_config->shaping.shares[i].weight);
+            }
+            SOCKET_describeOptions(&worker_config->socket_options, socket_description, sizeof(socket_description));
+            IO_printFormat(STDOUT_FILENO, "TCP: %s\n", socket_description);
             break; 
 
         default:
@@ -77,6 +186,7 @@ void LOAD_printConfig(void* config_struct, int type) {
 ************************************************/
 int LOAD_loadConfigFile(char* filename, void* config_struct, int type) {
     char* port_str = NULL;
+    LoadTransferOptions transfer;
     int fd_file = open(filename, O_RDONLY);
     if(fd_file < 0) {
         IO_printStatic(STDOUT_FILENO, "Could not open config file\n");
@@ -93,6 +203,12 @@ int LOAD_loadConfigFile(char* filename, void* config_struct, int type) {
             port_str = IO_readUntil(fd_file, '\n');
             fleck_config->gotham_port = atoi(port_str);
             free(port_str);
+            LOAD_readOptionLines(fd_file, &transfer, NULL, &fleck_config->socket_options);
+            fleck_config->window_size = transfer.window_size;
+            fleck_config->statistics = transfer.statistics;
+            fleck_config->capabilities = transfer.capabilities;
+            fleck_config->io_engine = transfer.io_engine;
+            fleck_config->stripes = transfer.stripes;
             break;
 
         case GOTHAM_CONF: 
@@ -105,6 +221,8 @@ int LOAD_loadConfigFile(char* filename, void* config_struct, int type) {
             port_str = IO_readUntil(fd_file, '\n');
             gotham_config->worker_port = atoi(port_str);
             free(port_str);
+            LOAD_readOptionLines(fd_file, &transfer, NULL, &gotham_config->socket_options);
+            gotham_config->statistics = transfer.statistics;
             break; 
 
         case WORKER_CONF:
@@ -119,6 +237,11 @@ int LOAD_loadConfigFile(char* filename, void* config_struct, int type) {
             free(port_str);
             worker_config->folder_path = IO_readUntil(fd_file, '\n');
             worker_config->worker_type = IO_readUntil(fd_file, '\n');
+            LOAD_readOptionLines(fd_file, &transfer, &worker_config->shaping, &worker_config->socket_options);
+            worker_config->window_size = transfer.window_size;
+            worker_config->statistics = transfer.statistics;
+            worker_config->capabilities = transfer.capabilities;
+            worker_config->io_engine = transfer.io_engine;
             break;
 
         default:
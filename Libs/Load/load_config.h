@@ -35,6 +35,16 @@
 #define GOTHAM_CONF         1
 #define FLECK_CONF          2
 #define WORKER_CONF         3
+
+#define LOAD_DEFAULT_TRANSFER_OPTIONS {CONN_DEFAULT_WINDOW_SIZE, CONN_DEFAULT_CAPABILITIES, CONN_IO_SYSCALLS, 1, 0}   // Opcions de les transferències si el fitxer no en té cap línia
+
+typedef struct {
+    int window_size;        // Línia "window <trames>"
+    int capabilities;       // Capacitats CONN_CAP_* (la compressió amb la línia "compression on")
+    int io_engine;          // Línia "io_engine io_uring|syscalls"
+    int stripes;            // Línia "stripes <connexions>" (només Fleck)
+    int statistics;         // Línia "stats on|off"
+} LoadTransferOptions;      // Opcions de les transferències de fitxers que es llegeixen de les línies opcionals amb clau
 //Funcions
 
 /*********************************************** 
@@ -0,0 +1,482 @@
+/***********************************************
+*
+* @Autores: Alexandre Contreras, Armand López.
+*
+* @Finalidad: Implementar la codificación y decodificación de los metadatos de control
+*             en binario (TLV) y en texto delimitado por '&', generando las tablas del
+*             esquema a partir de las listas de `metadata_schema.h`.
+*
+* @Fecha de creación: 16 de octubre de 2026.
+*
+* @Última modificación: 16 de octubre de 2026.
+*
+************************************************/
+
+#include "metadata.h"
+
+typedef struct {
+    uint8_t tag;              // Etiqueta TLV del camp
+    MetadataKind kind;        // Tipus del valor
+} MetadataFieldSchema;
+
+typedef struct {
+    const uint8_t *fields;    // Camps del missatge en l'ordre del format de text
+    int n_fields;             // Nombre de camps del missatge
+    int n_required;           // Els primers n_required camps són obligatoris
+} MetadataMessageSchema;
+
+#define METADATA_FIELD_SCHEMA(name, tag, kind) {tag, kind},
+static const MetadataFieldSchema metadata_fields[METADATA_N_FIELDS] = {
+    METADATA_FIELDS(METADATA_FIELD_SCHEMA)
+};
+#undef METADATA_FIELD_SCHEMA
+
+#define METADATA_MESSAGE_FIELDS(name, required, ...) static const uint8_t metadata_fields_##name[] = {__VA_ARGS__};
+METADATA_MESSAGES(METADATA_MESSAGE_FIELDS)
+#undef METADATA_MESSAGE_FIELDS
+
+#define METADATA_MESSAGE_SCHEMA(name, required, ...) {metadata_fields_##name, sizeof(metadata_fields_##name), required},
+static const MetadataMessageSchema metadata_messages[METADATA_N_MESSAGES] = {
+    METADATA_MESSAGES(METADATA_MESSAGE_SCHEMA)
+};
+#undef METADATA_MESSAGE_SCHEMA
+
+/***********************************************
+*
+* @Finalidad: Traducir una etiqueta TLV al campo del esquema.
+*
+* @Parámetros:
+* in: tag = Etiqueta recibida.
+*
+* @Retorno:
+*           >= 0 = Campo correspondiente.
+*           -1 = Etiqueta desconocida.
+*
+************************************************/
+static int METADATA_fieldFromTag(uint8_t tag) {
+#define METADATA_TAG_CASE(name, field_tag, kind) case field_tag: return METADATA_##name;
+    switch (tag) {
+        METADATA_FIELDS(METADATA_TAG_CASE)
+        default: return -1;
+    }
+#undef METADATA_TAG_CASE
+}
+
+/***********************************************
+*
+* @Finalidad: Consultar si un campo forma parte de un mensaje del esquema.
+*
+* @Parámetros:
+* in: schema = Esquema del mensaje.
+* in: field = Campo a consultar.
+*
+* @Retorno:
+*           1 = El campo pertenece al mensaje.
+*           0 = El campo no pertenece al mensaje.
+*
+************************************************/
+static int METADATA_messageHasField(const MetadataMessageSchema *schema, int field) {
+    for (int i = 0; i < schema->n_fields; i++) {
+        if (schema->fields[i] == field) return 1;
+    }
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalidad: Comprobar que están presentes todos los campos obligatorios de un mensaje.
+*
+* @Parámetros:
+* in: metadata = Campos del mensaje.
+* in: schema = Esquema del mensaje.
+*
+* @Retorno:
+*           1 = Están todos los campos obligatorios.
+*           0 = Falta algún campo obligatorio.
+*
+************************************************/
+static int METADATA_hasRequired(const Metadata *metadata, const MetadataMessageSchema *schema) {
+    for (int i = 0; i < schema->n_required; i++) {
+        if (!METADATA_has(metadata, schema->fields[i])) return 0;
+    }
+    return 1;
+}
+
+/***********************************************
+*
+* @Finalidad: Inicializar una estructura `Metadata` sin ningún campo.
+*
+* @Parámetros:
+* out: metadata = Estructura a inicializar.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void METADATA_init(Metadata *metadata) {
+    memset(metadata, 0, sizeof(Metadata));
+}
+
+/***********************************************
+*
+* @Finalidad: Asignar un campo de texto. La cadena no se copia, así que debe seguir
+*             siendo válida hasta que se codifique el mensaje.
+*
+* @Parámetros:
+* in/out: metadata = Estructura de metadatos.
+* in: field = Campo a asignar. Se ignora si no es de tipo `METADATA_STRING`.
+* in: value = Cadena a asignar. Si es NULL el campo queda ausente.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void METADATA_setString(Metadata *metadata, MetadataField field, const char *value) {
+    if (field >= METADATA_N_FIELDS || metadata_fields[field].kind != METADATA_STRING || !value) return;
+    metadata->strings[field] = value;
+    metadata->present |= 1u << field;
+}
+
+/***********************************************
+*
+* @Finalidad: Asignar un campo numérico.
+*
+* @Parámetros:
+* in/out: metadata = Estructura de metadatos.
+* in: field = Campo a asignar. Se ignora si no es de tipo `METADATA_NUMBER`.
+* in: value = Valor a asignar.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void METADATA_setNumber(Metadata *metadata, MetadataField field, uint32_t value) {
+    if (field >= METADATA_N_FIELDS || metadata_fields[field].kind != METADATA_NUMBER) return;
+    metadata->numbers[field] = value;
+    metadata->present |= 1u << field;
+}
+
+/***********************************************
+*
+* @Finalidad: Consultar si un campo está presente.
+*
+* @Parámetros:
+* in: metadata = Estructura de metadatos.
+* in: field = Campo a consultar.
+*
+* @Retorno:
+*           1 = El campo está presente.
+*           0 = El campo no está presente.
+*
+************************************************/
+int METADATA_has(const Metadata *metadata, MetadataField field) {
+    return field < METADATA_N_FIELDS && (metadata->present & (1u << field)) != 0;
+}
+
+/***********************************************
+*
+* @Finalidad: Obtener un campo de texto. Tras `METADATA_decode` el puntero referencia el
+*             buffer de la trama recibida, por lo que solo es válido mientras la trama exista.
+*
+* @Parámetros:
+* in: metadata = Estructura de metadatos.
+* in: field = Campo de tipo `METADATA_STRING` a obtener.
+*
+* @Retorno:
+*           Puntero a la cadena del campo.
+*           NULL si el campo no está presente o no es de texto.
+*
+************************************************/
+const char *METADATA_getString(const Metadata *metadata, MetadataField field) {
+    if (!METADATA_has(metadata, field) || metadata_fields[field].kind != METADATA_STRING) return NULL;
+    return metadata->strings[field];
+}
+
+/***********************************************
+*
+* @Finalidad: Obtener un campo numérico.
+*
+* @Parámetros:
+* in: metadata = Estructura de metadatos.
+* in: field = Campo de tipo `METADATA_NUMBER` a obtener.
+* in: default_value = Valor a retornar si el campo no está presente.
+*
+* @Retorno: Valor del campo, o `default_value` si no está presente o no es numérico.
+*
+************************************************/
+uint32_t METADATA_getNumber(const Metadata *metadata, MetadataField field, uint32_t default_value) {
+    if (!METADATA_has(metadata, field) || metadata_fields[field].kind != METADATA_NUMBER) return default_value;
+    return metadata->numbers[field];
+}
+
+/***********************************************
+*
+* @Finalidad: Codificar un mensaje en binario: marcador, identificador del mensaje y una
+*             entrada TLV por cada campo presente.
+*
+* @Parámetros:
+* in: metadata = Campos del mensaje.
+* in: message = Mensaje del esquema.
+* in: schema = Esquema del mensaje.
+* out: buffer = Buffer de salida.
+* in: capacity = Tamaño del buffer.
+*
+* @Retorno:
+*           >= 0 = Número de bytes escritos.
+*           -1 = El mensaje no cabe en el buffer.
+*
+************************************************/
+static long METADATA_encodeBinary(const Metadata *metadata, MetadataMessage message, const MetadataMessageSchema *schema, uint8_t *buffer, size_t capacity) {
+    if (capacity < METADATA_HEADER_SIZE) return -1;
+    buffer[0] = METADATA_BINARY_MARKER;
+    buffer[1] = (uint8_t)message;
+    size_t offset = METADATA_HEADER_SIZE;
+
+    for (int i = 0; i < schema->n_fields; i++) {
+        int field = schema->fields[i];
+        if (!METADATA_has(metadata, field)) continue;
+
+        //els camps de text porten el '\0' final perquè el receptor els pugui usar sense copiar-los
+        size_t value_length = metadata_fields[field].kind == METADATA_STRING ? strlen(metadata->strings[field]) + 1 : METADATA_NUMBER_SIZE;
+        if (value_length > UINT16_MAX || capacity - offset < METADATA_ENTRY_HEADER_SIZE + value_length) return -1;
+
+        buffer[offset] = metadata_fields[field].tag;
+        buffer[offset + 1] = (value_length >> 8) & 0xFF;
+        buffer[offset + 2] = value_length & 0xFF;
+        offset += METADATA_ENTRY_HEADER_SIZE;
+
+        if (metadata_fields[field].kind == METADATA_STRING) {
+            memcpy(buffer + offset, metadata->strings[field], value_length);
+        } else {
+            uint32_t value = metadata->numbers[field];
+            buffer[offset] = (value >> 24) & 0xFF;
+            buffer[offset + 1] = (value >> 16) & 0xFF;
+            buffer[offset + 2] = (value >> 8) & 0xFF;
+            buffer[offset + 3] = value & 0xFF;
+        }
+        offset += value_length;
+    }
+
+    return (long)offset;
+}
+
+/***********************************************
+*
+* @Finalidad: Codificar un mensaje en texto: los campos en el orden del esquema separados
+*             por '&', hasta el primer campo ausente.
+*
+* @Parámetros:
+* in: metadata = Campos del mensaje.
+* in: schema = Esquema del mensaje.
+* out: buffer = Buffer de salida (se termina en '\0', que no se cuenta en la longitud).
+* in: capacity = Tamaño del buffer.
+*
+* @Retorno:
+*           >= 0 = Número de bytes escritos.
+*           -1 = El mensaje no cabe en el buffer.
+*
+************************************************/
+static long METADATA_encodeText(const Metadata *metadata, const MetadataMessageSchema *schema, uint8_t *buffer, size_t capacity) {
+    size_t offset = 0;
+    if (capacity == 0) return -1;
+    buffer[0] = '\0';
+
+    for (int i = 0; i < schema->n_fields; i++) {
+        int field = schema->fields[i];
+        //el format de text és posicional: un camp absent talla la resta
+        if (!METADATA_has(metadata, field)) break;
+
+        int written;
+        if (metadata_fields[field].kind == METADATA_STRING) {
+            written = snprintf((char *)buffer + offset, capacity - offset, "%s%s", i > 0 ? "&" : "", metadata->strings[field]);
+        } else {
+            written = snprintf((char *)buffer + offset, capacity - offset, "%s%u", i > 0 ? "&" : "", metadata->numbers[field]);
+        }
+        if (written < 0 || (size_t)written >= capacity - offset) return -1;
+        offset += (size_t)written;
+    }
+
+    return (long)offset;
+}
+
+/***********************************************
+*
+* @Finalidad: Codificar un mensaje con los campos asignados. En texto los campos se
+*             escriben en el orden del esquema separados por '&' y se termina en el
+*             primer campo ausente; en binario se escribe el marcador, el identificador
+*             del mensaje y una entrada TLV por campo presente.
+*
+* @Parámetros:
+* in: metadata = Campos del mensaje.
+* in: message = Mensaje del esquema a codificar.
+* in: encoding = `METADATA_TEXT` o `METADATA_BINARY`.
+* out: buffer = Buffer donde se escribirá el mensaje.
+* in: capacity = Tamaño del buffer.
+*
+* @Retorno:
+*           >= 0 = Número de bytes escritos en `buffer`.
+*           -1 = Falta un campo obligatorio o el mensaje no cabe en el buffer.
+*
+************************************************/
+long METADATA_encode(const Metadata *metadata, MetadataMessage message, int encoding, uint8_t *buffer, size_t capacity) {
+    if (!metadata || !buffer || message >= METADATA_N_MESSAGES) return -1;
+
+    const MetadataMessageSchema *schema = &metadata_messages[message];
+    if (!METADATA_hasRequired(metadata, schema)) return -1;
+
+    if (encoding == METADATA_BINARY) {
+        return METADATA_encodeBinary(metadata, message, schema, buffer, capacity);
+    }
+    return METADATA_encodeText(metadata, schema, buffer, capacity);
+}
+
+/***********************************************
+*
+* @Finalidad: Convertir un campo de texto a número, exigiendo que sean todo dígitos.
+*
+* @Parámetros:
+* in: text = Cadena a convertir.
+* out: value = Valor convertido.
+*
+* @Retorno:
+*           0 = Conversión correcta.
+*          -1 = La cadena está vacía, no es un número o no cabe en 32 bits.
+*
+************************************************/
+static int METADATA_parseNumber(const char *text, uint32_t *value) {
+    char *end = NULL;
+    if (*text < '0' || *text > '9') return -1;
+
+    errno = 0;
+    unsigned long number = strtoul(text, &end, 10);
+    if (errno != 0 || *end != '\0' || number > UINT32_MAX) return -1;
+
+    *value = (uint32_t)number;
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalidad: Decodificar las entradas TLV de un mensaje binario. Los campos de texto
+*             apuntan directamente a `data`.
+*
+* @Parámetros:
+* in: data = Mensaje recibido (incluido el marcador).
+* in: length = Número de bytes del mensaje.
+* in: schema = Esquema del mensaje esperado.
+* out: metadata = Campos decodificados.
+*
+* @Retorno:
+*           0 = Entradas decodificadas.
+*          -1 = Alguna entrada está truncada o tiene un valor inválido.
+*
+************************************************/
+static int METADATA_decodeBinary(const uint8_t *data, size_t length, const MetadataMessageSchema *schema, Metadata *metadata) {
+    size_t offset = METADATA_HEADER_SIZE;
+
+    while (offset < length) {
+        if (length - offset < METADATA_ENTRY_HEADER_SIZE) return -1;
+        uint8_t tag = data[offset];
+        size_t value_length = ((size_t)data[offset + 1] << 8) | data[offset + 2];
+        offset += METADATA_ENTRY_HEADER_SIZE;
+        if (value_length > length - offset) return -1;
+
+        const uint8_t *value = data + offset;
+        offset += value_length;
+
+        //les etiquetes desconegudes o d'altres missatges s'ignoren perquè els peers nous puguin afegir camps
+        int field = METADATA_fieldFromTag(tag);
+        if (field < 0 || !METADATA_messageHasField(schema, field)) continue;
+
+        if (metadata_fields[field].kind == METADATA_STRING) {
+            //la cadena ha d'acabar en el seu '\0' i no en pot tenir cap altre
+            if (value_length == 0 || value[value_length - 1] != '\0' || memchr(value, '\0', value_length - 1)) return -1;
+            metadata->strings[field] = (const char *)value;
+        } else {
+            if (value_length != METADATA_NUMBER_SIZE) return -1;
+            metadata->numbers[field] = ((uint32_t)value[0] << 24) | ((uint32_t)value[1] << 16) | ((uint32_t)value[2] << 8) | value[3];
+        }
+        metadata->present |= 1u << field;
+    }
+
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalidad: Decodificar un mensaje de texto separando sus campos en el propio buffer.
+*             Los campos que sobran respecto al esquema se ignoran, como hacían los
+*             peers antiguos.
+*
+* @Parámetros:
+* in/out: data = Mensaje recibido. Cada '&' se sustituye por '\0'.
+* in: length = Número de bytes del mensaje.
+* in: schema = Esquema del mensaje esperado.
+* out: metadata = Campos decodificados.
+*
+* @Retorno:
+*           0 = Campos decodificados.
+*          -1 = Algún campo numérico no es un número.
+*
+************************************************/
+static int METADATA_decodeText(uint8_t *data, size_t length, const MetadataMessageSchema *schema, Metadata *metadata) {
+    //el text acaba al primer '\0' (les trames v1 van farcides de zeros) o al final de les dades
+    uint8_t *end = memchr(data, '\0', length);
+    if (!end) end = data + length;
+
+    char *token = (char *)data;
+    for (int i = 0; i < schema->n_fields && token < (char *)end; i++) {
+        char *separator = memchr(token, '&', (size_t)((char *)end - token));
+        if (separator) *separator = '\0';
+
+        //un camp buit es tracta com a absent, igual que feia strtok
+        int field = schema->fields[i];
+        if (*token != '\0') {
+            if (metadata_fields[field].kind == METADATA_STRING) {
+                metadata->strings[field] = token;
+            } else if (METADATA_parseNumber(token, &metadata->numbers[field]) < 0) {
+                return -1;
+            }
+            metadata->present |= 1u << field;
+        }
+
+        if (!separator) break;
+        token = separator + 1;
+    }
+
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalidad: Decodificar un mensaje recibido, detectando si está en binario (TLV) o en
+*             texto. No reserva memoria: los campos de texto apuntan a `data`, que en
+*             el formato de texto se modifica para terminar cada campo en '\0'.
+*             Las etiquetas TLV desconocidas se ignoran.
+*
+* @Parámetros:
+* in/out: data = Datos de la trama recibida. Deben ir seguidos de un '\0', como los de
+*                cualquier trama recibida.
+* in: length = Número de bytes de `data`.
+* in: message = Mensaje del esquema que se espera recibir.
+* out: metadata = Campos decodificados.
+*
+* @Retorno:
+*           0 = Mensaje decodificado con todos los campos obligatorios.
+*          -1 = Mensaje malformado, de otro tipo o sin algún campo obligatorio.
+*
+************************************************/
+int METADATA_decode(uint8_t *data, size_t length, MetadataMessage message, Metadata *metadata) {
+    if (!data || !metadata || message >= METADATA_N_MESSAGES) return -1;
+    METADATA_init(metadata);
+
+    const MetadataMessageSchema *schema = &metadata_messages[message];
+    int result;
+
+    if (length >= METADATA_HEADER_SIZE && data[0] == METADATA_BINARY_MARKER) {
+        if (data[1] != message) return -1;
+        result = METADATA_decodeBinary(data, length, schema, metadata);
+    } else {
+        result = METADATA_decodeText(data, length, schema, metadata);
+    }
+
+    if (result < 0 || !METADATA_hasRequired(metadata, schema)) return -1;
+    return 0;
+}
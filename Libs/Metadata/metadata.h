@@ -0,0 +1,194 @@
+/***********************************************
+*
+* @Autores: Alexandre Contreras y Armand López
+* @Propósito: Codificar y decodificar los metadatos de control que viajan dentro de las
+*             tramas, a partir del esquema de `metadata_schema.h`. Los peers que han
+*             acordado tramas v2 usan un formato binario TLV (etiqueta, longitud,
+*             valor); con los peers antiguos se mantiene el texto delimitado por '&'.
+*             La decodificación no reserva memoria: los campos de texto apuntan al
+*             propio buffer de la trama recibida.
+* @Fecha de creación: 16 de octubre de 2026
+* @Última modificación: 16 de octubre de 2026
+*
+************************************************/
+
+#ifndef _METADATA_CUSTOM_H_
+#define _METADATA_CUSTOM_H_
+
+//Libreries del sistema
+#include <stdio.h>     // snprintf
+#include <stdlib.h>    // strtoul
+#include <errno.h>     // errno
+#include <string.h>    // memcpy, memchr, strlen
+#include <stdint.h>    // uint8_t, uint32_t
+#include <stddef.h>    // size_t
+
+//Llibreries pròpies
+#include "metadata_schema.h"
+
+//Constants
+#define METADATA_TEXT 0                 // Codificació de text amb camps separats per '&' (peers v1)
+#define METADATA_BINARY 1               // Codificació binària TLV (peers que han acordat trames v2)
+#define METADATA_BINARY_MARKER 0x00     // Primer byte d'un missatge TLV (un missatge de text mai comença per '\0')
+#define METADATA_HEADER_SIZE 2          // marcador(1) + identificador del missatge(1)
+#define METADATA_ENTRY_HEADER_SIZE 3    // etiqueta(1) + longitud del valor(2, big endian)
+#define METADATA_NUMBER_SIZE 4          // Els camps numèrics van en 4 bytes big endian
+#define METADATA_MAX_SIZE 4096          // Mida màxima d'un missatge codificat
+
+//Tipus propis
+typedef enum {
+    METADATA_STRING,          // Cadena acabada en '\0' (el '\0' forma part del valor TLV)
+    METADATA_NUMBER           // Enter sense signe de 32 bits
+} MetadataKind;
+
+#define METADATA_FIELD_ENUM(name, tag, kind) METADATA_##name,
+typedef enum {
+    METADATA_FIELDS(METADATA_FIELD_ENUM)
+    METADATA_N_FIELDS
+} MetadataField;
+#undef METADATA_FIELD_ENUM
+
+#define METADATA_MESSAGE_ENUM(name, required, ...) METADATA_MSG_##name,
+typedef enum {
+    METADATA_MESSAGES(METADATA_MESSAGE_ENUM)
+    METADATA_N_MESSAGES
+} MetadataMessage;
+#undef METADATA_MESSAGE_ENUM
+
+typedef struct {
+    const char *strings[METADATA_N_FIELDS];   // Camps de text (apunten al buffer rebut o a les cadenes de qui envia)
+    uint32_t numbers[METADATA_N_FIELDS];      // Camps numèrics
+    uint32_t present;                         // Bit (1 << camp) de cada camp present
+} Metadata;
+
+//Funcions
+
+/***********************************************
+*
+* @Finalidad: Inicializar una estructura `Metadata` sin ningún campo.
+*
+* @Parámetros:
+* out: metadata = Estructura a inicializar.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void METADATA_init(Metadata *metadata);
+
+/***********************************************
+*
+* @Finalidad: Asignar un campo de texto. La cadena no se copia, así que debe seguir
+*             siendo válida hasta que se codifique el mensaje.
+*
+* @Parámetros:
+* in/out: metadata = Estructura de metadatos.
+* in: field = Campo a asignar. Se ignora si no es de tipo `METADATA_STRING`.
+* in: value = Cadena a asignar. Si es NULL el campo queda ausente.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void METADATA_setString(Metadata *metadata, MetadataField field, const char *value);
+
+/***********************************************
+*
+* @Finalidad: Asignar un campo numérico.
+*
+* @Parámetros:
+* in/out: metadata = Estructura de metadatos.
+* in: field = Campo a asignar. Se ignora si no es de tipo `METADATA_NUMBER`.
+* in: value = Valor a asignar.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void METADATA_setNumber(Metadata *metadata, MetadataField field, uint32_t value);
+
+/***********************************************
+*
+* @Finalidad: Consultar si un campo está presente.
+*
+* @Parámetros:
+* in: metadata = Estructura de metadatos.
+* in: field = Campo a consultar.
+*
+* @Retorno:
+*           1 = El campo está presente.
+*           0 = El campo no está presente.
+*
+************************************************/
+int METADATA_has(const Metadata *metadata, MetadataField field);
+
+/***********************************************
+*
+* @Finalidad: Obtener un campo de texto. Tras `METADATA_decode` el puntero referencia el
+*             buffer de la trama recibida, por lo que solo es válido mientras la trama exista.
+*
+* @Parámetros:
+* in: metadata = Estructura de metadatos.
+* in: field = Campo de tipo `METADATA_STRING` a obtener.
+*
+* @Retorno:
+*           Puntero a la cadena del campo.
+*           NULL si el campo no está presente o no es de texto.
+*
+************************************************/
+const char *METADATA_getString(const Metadata *metadata, MetadataField field);
+
+/***********************************************
+*
+* @Finalidad: Obtener un campo numérico.
+*
+* @Parámetros:
+* in: metadata = Estructura de metadatos.
+* in: field = Campo de tipo `METADATA_NUMBER` a obtener.
+* in: default_value = Valor a retornar si el campo no está presente.
+*
+* @Retorno: Valor del campo, o `default_value` si no está presente o no es numérico.
+*
+************************************************/
+uint32_t METADATA_getNumber(const Metadata *metadata, MetadataField field, uint32_t default_value);
+
+/***********************************************
+*
+* @Finalidad: Codificar un mensaje con los campos asignados. En texto los campos se
+*             escriben en el orden del esquema separados por '&' y se termina en el
+*             primer campo ausente; en binario se escribe el marcador, el identificador
+*             del mensaje y una entrada TLV por campo presente.
+*
+* @Parámetros:
+* in: metadata = Campos del mensaje.
+* in: message = Mensaje del esquema a codificar.
+* in: encoding = `METADATA_TEXT` o `METADATA_BINARY`.
+* out: buffer = Buffer donde se escribirá el mensaje.
+* in: capacity = Tamaño del buffer.
+*
+* @Retorno:
+*           >= 0 = Número de bytes escritos en `buffer`.
+*           -1 = Falta un campo obligatorio o el mensaje no cabe en el buffer.
+*
+************************************************/
+long METADATA_encode(const Metadata *metadata, MetadataMessage message, int encoding, uint8_t *buffer, size_t capacity);
+
+/***********************************************
+*
+* @Finalidad: Decodificar un mensaje recibido, detectando si está en binario (TLV) o en
+*             texto. No reserva memoria: los campos de texto apuntan a `data`, que en
+*             el formato de texto se modifica para terminar cada campo en '\0'.
+*             Las etiquetas TLV desconocidas se ignoran.
+*
+* @Parámetros:
+* in/out: data = Datos de la trama recibida. Deben ir seguidos de un '\0', como los de
+*                cualquier trama recibida.
+* in: length = Número de bytes de `data`.
+* in: message = Mensaje del esquema que se espera recibir.
+* out: metadata = Campos decodificados.
+*
+* @Retorno:
+*           0 = Mensaje decodificado con todos los campos obligatorios.
+*          -1 = Mensaje malformado, de otro tipo o sin algún campo obligatorio.
+*
+************************************************/
+int METADATA_decode(uint8_t *data, size_t length, MetadataMessage message, Metadata *metadata);
+
+#endif // _METADATA_CUSTOM_H_
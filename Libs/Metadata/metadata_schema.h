@@ -0,0 +1,58 @@
+/***********************************************
+*
+* @Autores: Alexandre Contreras y Armand López
+* @Propósito: Definir en un único lugar el esquema de los mensajes de metadatos de
+*             control (handshakes, peticiones de distorsión y metadatos de fichero).
+*             A partir de estas listas se generan las etiquetas TLV, los tipos de cada
+*             campo y el orden de los campos en el formato de texto con '&'.
+* @Fecha de creación: 16 de octubre de 2026
+* @Última modificación: 16 de octubre de 2026
+*
+************************************************/
+
+#ifndef _METADATA_SCHEMA_CUSTOM_H_
+#define _METADATA_SCHEMA_CUSTOM_H_
+
+// Camps: X(nom, etiqueta TLV, tipus). Les etiquetes no es poden reutilitzar ni renumerar
+#define METADATA_FIELDS(X) \
+    X(USERNAME,    0x01, METADATA_STRING) \
+    X(WORKER_TYPE, 0x02, METADATA_STRING) \
+    X(IP,          0x03, METADATA_STRING) \
+    X(PORT,        0x04, METADATA_NUMBER) \
+    X(DATA_SIZE,   0x05, METADATA_NUMBER) \
+    X(CAPABILITIES, 0x06, METADATA_NUMBER) \
+    X(MEDIA_TYPE,  0x07, METADATA_STRING) \
+    X(FILENAME,    0x08, METADATA_STRING) \
+    X(FILE_SIZE,   0x09, METADATA_NUMBER) \
+    X(MD5SUM,      0x0A, METADATA_STRING) \
+    X(FACTOR,      0x0B, METADATA_NUMBER) \
+    X(CHECKSUMS,   0x0C, METADATA_NUMBER) \
+    X(HASHES,      0x0D, METADATA_NUMBER) \
+    X(WINDOW_SIZE, 0x0E, METADATA_NUMBER) \
+    X(STRIPES,     0x0F, METADATA_NUMBER) \
+    X(STRIPE,      0x10, METADATA_NUMBER) \
+    X(MERKLE_ROOT, 0x11, METADATA_STRING) \
+    X(MERKLE_CHUNK, 0x12, METADATA_NUMBER) \
+    X(DELTA_BLOCK, 0x13, METADATA_NUMBER) \
+    X(CANDIDATES,  0x14, METADATA_STRING) \
+    X(PIPELINED,   0x15, METADATA_NUMBER)
+
+// Oferta de capacitats que s'afegeix als handshakes (i combinació escollida, a la resposta)
+#define METADATA_OFFER METADATA_DATA_SIZE, METADATA_CAPABILITIES, METADATA_CHECKSUMS, METADATA_HASHES, METADATA_WINDOW_SIZE, METADATA_STRIPES
+
+// Missatges: M(nom, camps obligatoris, camps en l'ordre del format de text). Els camps
+// opcionals van sempre al final, que és com els peers antics els ignoren
+#define METADATA_MESSAGES(M) \
+    M(FLECK_CONNECTION,    3, METADATA_USERNAME, METADATA_IP, METADATA_PORT, METADATA_OFFER) \
+    M(WORKER_CONNECTION,   3, METADATA_WORKER_TYPE, METADATA_IP, METADATA_PORT, METADATA_OFFER) \
+    M(CONNECTION_RESPONSE, 0, METADATA_OFFER) \
+    M(DISTORT_REQUEST,     2, METADATA_MEDIA_TYPE, METADATA_FILENAME) \
+    M(WORKER_ASSIGNMENT,   2, METADATA_IP, METADATA_PORT, METADATA_DATA_SIZE, METADATA_CANDIDATES) \
+    M(FILE_REQUEST,        5, METADATA_USERNAME, METADATA_FILENAME, METADATA_FILE_SIZE, METADATA_MD5SUM, METADATA_FACTOR, METADATA_OFFER, METADATA_MERKLE_ROOT, METADATA_MERKLE_CHUNK, METADATA_PIPELINED) \
+    M(FILE_RESULT,         2, METADATA_FILE_SIZE, METADATA_MD5SUM, METADATA_MERKLE_ROOT, METADATA_MERKLE_CHUNK) \
+    M(STRIPE_JOIN,         3, METADATA_USERNAME, METADATA_FILENAME, METADATA_STRIPE) \
+    M(FILE_DIGEST,         1, METADATA_MD5SUM) \
+    M(DELTA_BASIS,         2, METADATA_FILE_SIZE, METADATA_DELTA_BLOCK) \
+    M(SESSION_OFFER,       0, METADATA_OFFER)
+
+#endif // _METADATA_SCHEMA_CUSTOM_H_
@@ -0,0 +1,1124 @@
+/***********************************************
+*
+* @Autores: Alexandre Contreras, Armand López.
+*
+* @Finalidad: Implementar las sesiones multiplexadas: el bucle que reparte los bytes de
+*             los streams en registros por la conexión, el control de flujo por stream y
+*             el pool de sesiones de un fleck.
+*
+* @Fecha de creación: 16 de octubre de 2026.
+*
+* @Última modificación: 16 de octubre de 2026.
+*
+************************************************/
+
+#include "mux.h"
+
+#define MUX_RECORD_HEADER_SIZE 9                    // stream(4) + kind(1) + length(4), big endian
+#define MUX_RECORD_DATA 0                           // Bytes d'un stream
+#define MUX_RECORD_OPEN 1                           // Obertura d'un stream (sense dades)
+#define MUX_RECORD_CLOSE 2                          // L'emissor ja no enviarà més bytes pel stream
+#define MUX_RECORD_RESET 3                          // L'emissor ha abandonat el stream
+#define MUX_RECORD_CREDIT 4                         // El camp length són bytes més que l'emissor accepta pel stream
+#define MUX_CREDIT_THRESHOLD (MUX_STREAM_WINDOW / 4)    // Bytes lliurats a partir dels quals es retorna el crèdit
+#define MUX_FRAME_CONTROL 1                         // La trama al capdavant d'un stream és de control
+#define MUX_FRAME_BULK 0                            // És de dades de fitxer
+#define MUX_FRAME_NONE -1                           // El stream no té res per enviar (o la capçalera encara no ha arribat)
+
+typedef struct MuxStream {
+    uint32_t id;
+    int socket;                 // Extrem del socketpair de la sessió (no bloquejant, -1 si ja s'ha tancat)
+    int user_socket;            // Extrem que fa servir el thread de la distorsió (només per identificar-lo)
+    ino_t user_inode;
+    uint8_t *tx;                // Bytes llegits del stream pendents d'enviar
+    size_t tx_start;
+    size_t tx_end;
+    uint32_t tx_credit;         // Bytes que l'altre extrem encara accepta
+    size_t frame_left;          // Bytes que falten per sortir de la trama al capdavant (0 = el següent byte n'inicia una)
+    int frame_class;            // MUX_FRAME_CONTROL o MUX_FRAME_BULK de la trama al capdavant
+    int tx_eof;                 // Qui usa el stream ja no hi escriurà més
+    uint8_t *rx;                // Anell de MUX_STREAM_WINDOW bytes rebuts pendents de lliurar
+    size_t rx_start;
+    size_t rx_length;
+    uint32_t rx_delivered;      // Bytes lliurats des de l'últim crèdit
+    uint32_t credit_pending;    // Crèdit per enviar
+    int rx_closed;              // L'altre extrem ha enviat CLOSE
+    int open_pending;           // Falta enviar l'OPEN (client)
+    int close_sent;
+    int reset_pending;          // Falta enviar el RESET
+    int reset_done;             // El stream s'ha abandonat (s'ha enviat o rebut un RESET)
+    struct MuxStream *next;     // Següent stream pendent d'adoptar
+} MuxStream;
+
+struct MuxSession {
+    int socket;
+    int role;
+    MuxStreamHandler handler;
+    void *handler_arg;
+    int wake[2];                                // Pipe per despertar el bucle quan s'obre un stream o es para la sessió
+    pthread_mutex_t mutex;                      // Protegeix la llista de streams, els pendents d'adoptar i els comptadors
+    MuxStream *streams[MUX_MAX_STREAMS];        // Només els canvia el bucle (amb el mutex)
+    MuxStream *opening;                         // Streams oberts amb MUX_openStream que el bucle encara no ha adoptat
+    int n_streams;                              // Streams de la llista més els pendents d'adoptar
+    uint32_t next_id;
+    int control_turn;                           // Següent stream a mirar a la ronda de control
+    int bulk_turn;                              // Següent stream a mirar a la ronda de dades
+    uint32_t refused[MUX_MAX_STREAMS];          // Streams de l'altre extrem rebutjats pendents del seu RESET
+    int n_refused;
+    uint8_t *out;                               // Registres pendents d'enviar
+    size_t out_start;
+    size_t out_end;
+    uint8_t *in;                                // Bytes rebuts pendents de repartir (registres incomplets)
+    size_t in_end;
+    volatile int alive;
+    volatile int stop;
+    pthread_t thread;
+    int has_thread;
+    MuxStats stats;
+    struct MuxSession *next_registered;         // Següent sessió del registre del procés
+};
+
+static MuxSession *registry = NULL;                                 // Sessions del procés, per MUX_getTransport
+static pthread_mutex_t registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/***********************************************
+*
+* @Finalidad: Escribir un entero de 32 bits en big endian.
+*
+* @Parámetros:
+* out: bytes = Destino (4 bytes).
+* in: value = Valor.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+static void MUX_putUint32(uint8_t *bytes, uint32_t value) {
+    bytes[0] = (uint8_t)(value >> 24);
+    bytes[1] = (uint8_t)(value >> 16);
+    bytes[2] = (uint8_t)(value >> 8);
+    bytes[3] = (uint8_t)value;
+}
+
+/***********************************************
+*
+* @Finalidad: Leer un entero de 32 bits en big endian.
+*
+* @Parámetros:
+* in: bytes = Origen (4 bytes).
+*
+* @Retorno: Valor leído.
+*
+************************************************/
+static uint32_t MUX_getUint32(const uint8_t *bytes) {
+    return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | (uint32_t)bytes[3];
+}
+
+/***********************************************
+*
+* @Finalidad: Poner un descriptor en modo no bloqueante.
+*
+* @Parámetros:
+* in: fd = Descriptor.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+static void MUX_setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags >= 0) fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+/***********************************************
+*
+* @Finalidad: Despertar el bucle de la sesión.
+*
+* @Parámetros:
+* in: session = Sesión.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+static void MUX_wake(MuxSession *session) {
+    uint8_t byte = 1;
+    ssize_t written = write(session->wake[1], &byte, 1);
+    (void)written;      // Si la pipe és plena el bucle ja es despertarà
+}
+
+/***********************************************
+*
+* @Finalidad: Crear un stream con su `socketpair` y sus buffers.
+*
+* @Parámetros:
+* in: id = Identificador del stream.
+*
+* @Retorno: Stream creado, o NULL si no se ha podido crear.
+*
+************************************************/
+static MuxStream *MUX_newStream(uint32_t id) {
+    int sockets[2];
+    struct stat status;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets) < 0) return NULL;
+
+    MuxStream *stream = calloc(1, sizeof(MuxStream));
+    if (stream != NULL) {
+        stream->tx = malloc(MUX_STREAM_BUFFER);
+        stream->rx = malloc(MUX_STREAM_WINDOW);
+    }
+    if (stream == NULL || stream->tx == NULL || stream->rx == NULL || fstat(sockets[1], &status) < 0) {
+        if (stream != NULL) {
+            free(stream->tx);
+            free(stream->rx);
+            free(stream);
+        }
+        close(sockets[0]);
+        close(sockets[1]);
+        return NULL;
+    }
+
+    MUX_setNonBlocking(sockets[0]);
+    stream->id = id;
+    stream->socket = sockets[0];
+    stream->user_socket = sockets[1];
+    stream->user_inode = status.st_ino;
+    stream->tx_credit = MUX_STREAM_WINDOW;
+    return stream;
+}
+
+/***********************************************
+*
+* @Finalidad: Cerrar el extremo de la sesión de un stream, de modo que quien lo usa lee
+*             el final y sus escrituras fallan.
+*
+* @Parámetros:
+* in/out: stream = Stream.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+static void MUX_closeStreamSocket(MuxStream *stream) {
+    if (stream->socket >= 0) {
+        close(stream->socket);
+        stream->socket = -1;
+    }
+}
+
+/***********************************************
+*
+* @Finalidad: Liberar un stream y cerrar su extremo.
+*
+* @Parámetros:
+* in/out: stream = Stream.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+static void MUX_freeStream(MuxStream *stream) {
+    MUX_closeStreamSocket(stream);
+    free(stream->tx);
+    free(stream->rx);
+    free(stream);
+}
+
+/***********************************************
+*
+* @Finalidad: Buscar un stream de la sesión por su identificador.
+*
+* @Parámetros:
+* in: session = Sesión.
+* in: id = Identificador.
+*
+* @Retorno: Posición del stream en la lista, o -1 si no está.
+*
+************************************************/
+static int MUX_findStream(MuxSession *session, uint32_t id) {
+    for (int i = 0; i < MUX_MAX_STREAMS; i++) {
+        if (session->streams[i] != NULL && session->streams[i]->id == id) return i;
+    }
+    return -1;
+}
+
+/***********************************************
+*
+* @Finalidad: Poner en la lista los streams abiertos con `MUX_openStream`.
+*
+* @Parámetros:
+* in/out: session = Sesión.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+static void MUX_adoptStreams(MuxSession *session) {
+    pthread_mutex_lock(&session->mutex);
+    for (int i = 0; i < MUX_MAX_STREAMS && session->opening != NULL; i++) {
+        if (session->streams[i] == NULL) {
+            session->streams[i] = session->opening;
+            session->opening = session->opening->next;
+            session->streams[i]->next = NULL;
+        }
+    }
+    pthread_mutex_unlock(&session->mutex);
+}
+
+/***********************************************
+*
+* @Finalidad: Determinar la trama que empieza al principio de los bytes pendientes de un
+*             stream (su longitud y si es de control), mirando el tipo y la longitud de su
+*             cabecera. Los tipos de datos de fichero son los paquetes (0x05), las hojas de
+*             Merkle (0x15), las firmas de delta (0x18), los deltas (0x19) y los paquetes
+*             con tramos (0x1A); el resto son de control.
+*
+* @Parámetros:
+* in/out: stream = Stream sin ninguna trama a medio enviar.
+*
+* @Retorno:
+*           1 = Trama determinada.
+*           0 = Aún no ha llegado su cabecera.
+*
+************************************************/
+static int MUX_parseFrame(MuxStream *stream) {
+    const uint8_t *bytes = stream->tx + stream->tx_start;
+    size_t buffered = stream->tx_end - stream->tx_start;
+    uint8_t type;
+
+    if (buffered == 0) return 0;
+    if (bytes[0] & FRAME_V2_FLAG) {
+        if (buffered < 5) {
+            if (!stream->tx_eof) return 0;
+            stream->frame_left = buffered;      // Final truncat: surt tal com és
+            stream->frame_class = MUX_FRAME_CONTROL;
+            return 1;
+        }
+        type = bytes[0] & ~(FRAME_V2_FLAG | FRAME_V2_NO_CHECKSUM_FLAG | FRAME_V2_COMPRESSED_FLAG);
+        stream->frame_left = FRAME_V2_HEADER_SIZE + (size_t)MUX_getUint32(bytes + 1);
+    } else {
+        type = bytes[0];
+        stream->frame_left = FRAME_SIZE;
+    }
+
+    switch (type) {
+        case 0x05: case 0x15: case 0x18: case 0x19: case 0x1A:
+            stream->frame_class = MUX_FRAME_BULK;
+            break;
+        default:
+            stream->frame_class = MUX_FRAME_CONTROL;
+            break;
+    }
+    return 1;
+}
+
+/***********************************************
+*
+* @Finalidad: Clasificar lo que un stream tiene listo para enviar.
+*
+* @Parámetros:
+* in/out: stream = Stream.
+*
+* @Retorno: `MUX_FRAME_CONTROL`, `MUX_FRAME_BULK` o `MUX_FRAME_NONE` si no puede enviar nada
+*          (sin bytes, sin crédito o pendiente de su apertura).
+*
+************************************************/
+static int MUX_frameClass(MuxStream *stream) {
+    if (stream->reset_done || stream->open_pending || stream->tx_credit == 0 || stream->tx_start == stream->tx_end) return MUX_FRAME_NONE;
+    if (stream->frame_left == 0 && !MUX_parseFrame(stream)) return MUX_FRAME_NONE;
+    return stream->frame_class;
+}
+
+/***********************************************
+*
+* @Finalidad: Marcar como enviados los primeros bytes pendientes de un stream, avanzando
+*             por las tramas que contienen.
+*
+* @Parámetros:
+* in/out: stream = Stream.
+* in: length = Bytes enviados.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+static void MUX_consume(MuxStream *stream, size_t length) {
+    while (length > 0) {
+        if (stream->frame_left == 0 && !MUX_parseFrame(stream)) {
+            stream->tx_start += length;     // Capçalera truncada al final del stream
+            break;
+        }
+        size_t step = length < stream->frame_left ? length : stream->frame_left;
+        stream->frame_left -= step;
+        stream->tx_start += step;
+        length -= step;
+    }
+    if (stream->tx_start == stream->tx_end) stream->tx_start = stream->tx_end = 0;
+}
+
+/***********************************************
+*
+* @Finalidad: Añadir un registro a los pendientes de enviar por la conexión.
+*
+* @Parámetros:
+* in/out: session = Sesión con espacio para el registro.
+* in: id = Stream del registro.
+* in: kind = Tipo `MUX_RECORD_*`.
+* in: length = Campo de longitud (bytes de datos, o crédito).
+* in: data = Datos del registro (NULL si no lleva).
+* in: data_length = Bytes de `data`.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+static void MUX_appendRecord(MuxSession *session, uint32_t id, uint8_t kind, uint32_t length, const uint8_t *data, size_t data_length) {
+    uint8_t *record = session->out + session->out_end;
+
+    MUX_putUint32(record, id);
+    record[4] = kind;
+    MUX_putUint32(record + 5, length);
+    if (data_length > 0) memcpy(record + MUX_RECORD_HEADER_SIZE, data, data_length);
+    session->out_end += MUX_RECORD_HEADER_SIZE + data_length;
+}
+
+/***********************************************
+*
+* @Finalidad: Añadir los registros de gestión pendientes de los streams (aperturas,
+*             rechazos, crédito, cierres y abandonos), que siempre salen antes que los datos.
+*
+* @Parámetros:
+* in/out: session = Sesión.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+static void MUX_fillManagement(MuxSession *session) {
+    while (session->n_refused > 0 && MUX_IO_BUFFER - session->out_end >= MUX_RECORD_HEADER_SIZE) {
+        MUX_appendRecord(session, session->refused[--session->n_refused], MUX_RECORD_RESET, 0, NULL, 0);
+    }
+
+    for (int i = 0; i < MUX_MAX_STREAMS; i++) {
+        MuxStream *stream = session->streams[i];
+        if (stream == NULL) continue;
+        if (MUX_IO_BUFFER - session->out_end < 2 * MUX_RECORD_HEADER_SIZE) return;
+
+        if (stream->open_pending) {
+            MUX_appendRecord(session, stream->id, MUX_RECORD_OPEN, 0, NULL, 0);
+            stream->open_pending = 0;
+        }
+        if (stream->reset_pending) {
+            MUX_appendRecord(session, stream->id, MUX_RECORD_RESET, 0, NULL, 0);
+            stream->reset_pending = 0;
+            stream->reset_done = 1;
+            continue;
+        }
+        if (stream->credit_pending > 0 && !stream->reset_done) {
+            MUX_appendRecord(session, stream->id, MUX_RECORD_CREDIT, stream->credit_pending, NULL, 0);
+            stream->credit_pending = 0;
+        }
+        if (stream->tx_eof && stream->tx_start == stream->tx_end && !stream->close_sent && !stream->reset_done) {
+            MUX_appendRecord(session, stream->id, MUX_RECORD_CLOSE, 0, NULL, 0);
+            stream->close_sent = 1;
+        }
+    }
+}
+
+/***********************************************
+*
+* @Finalidad: Elegir el siguiente stream que envía datos: primero, por turnos, los que
+*             tienen una trama de control al principio; después, por turnos, los que tienen
+*             datos de fichero.
+*
+* @Parámetros:
+* in/out: session = Sesión.
+* out: frame_class = Clase de lo que enviará el stream elegido.
+*
+* @Retorno: Posición del stream elegido, o -1 si ninguno tiene nada para enviar.
+*
+************************************************/
+static int MUX_pickStream(MuxSession *session, int *frame_class) {
+    for (int i = 0; i < MUX_MAX_STREAMS; i++) {
+        int index = (session->control_turn + i) % MUX_MAX_STREAMS;
+        if (session->streams[index] != NULL && MUX_frameClass(session->streams[index]) == MUX_FRAME_CONTROL) {
+            session->control_turn = (index + 1) % MUX_MAX_STREAMS;
+            *frame_class = MUX_FRAME_CONTROL;
+            return index;
+        }
+    }
+    for (int i = 0; i < MUX_MAX_STREAMS; i++) {
+        int index = (session->bulk_turn + i) % MUX_MAX_STREAMS;
+        if (session->streams[index] != NULL && MUX_frameClass(session->streams[index]) == MUX_FRAME_BULK) {
+            session->bulk_turn = (index + 1) % MUX_MAX_STREAMS;
+            *frame_class = MUX_FRAME_BULK;
+            return index;
+        }
+    }
+    return -1;
+}
+
+/***********************************************
+*
+* @Finalidad: Llenar el buffer de salida de la sesión con los registros pendientes: los de
+*             gestión y después los datos de los streams, de como mucho `MUX_QUANTUM` bytes
+*             por turno. Una trama de control sale entera (dentro del quantum) y cuenta
+*             como adelantada si otro stream esperaba con datos de fichero.
+*
+* @Parámetros:
+* in/out: session = Sesión.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+static void MUX_fillOutput(MuxSession *session) {
+    int frame_class;
+
+    if (session->out_start == session->out_end) {
+        session->out_start = session->out_end = 0;
+    } else if (session->out_start > 0 && MUX_IO_BUFFER - session->out_end < MUX_RECORD_HEADER_SIZE + MUX_QUANTUM) {
+        memmove(session->out, session->out + session->out_start, session->out_end - session->out_start);
+        session->out_end -= session->out_start;
+        session->out_start = 0;
+    }
+
+    MUX_fillManagement(session);
+
+    while (MUX_IO_BUFFER - session->out_end >= MUX_RECORD_HEADER_SIZE + MUX_QUANTUM) {
+        int index = MUX_pickStream(session, &frame_class);
+        if (index < 0) break;
+
+        MuxStream *stream = session->streams[index];
+        size_t length = stream->tx_end - stream->tx_start;
+        if (length > MUX_QUANTUM) length = MUX_QUANTUM;
+        if (length > stream->tx_credit) length = stream->tx_credit;
+        if (frame_class == MUX_FRAME_CONTROL) {
+            if (length > stream->frame_left) length = stream->frame_left;
+            session->stats.control_records++;
+            for (int i = 0; i < MUX_MAX_STREAMS; i++) {
+                if (i != index && session->streams[i] != NULL && MUX_frameClass(session->streams[i]) == MUX_FRAME_BULK) {
+                    session->stats.preemptions++;
+                    break;
+                }
+            }
+        }
+
+        MUX_appendRecord(session, stream->id, MUX_RECORD_DATA, (uint32_t)length, stream->tx + stream->tx_start, length);
+        stream->tx_credit -= (uint32_t)length;
+        session->stats.records++;
+        MUX_consume(stream, length);
+    }
+
+    MUX_fillManagement(session);    // Cierres de los streams que se acaban de vaciar
+}
+
+/***********************************************
+*
+* @Finalidad: Enviar por la conexión los registros pendientes que quepan sin bloquear.
+*
+* @Parámetros:
+* in/out: session = Sesión.
+*
+* @Retorno:
+*           0 = Enviado lo que cabía.
+*          -1 = La conexión ha caído.
+*
+************************************************/
+static int MUX_flushOutput(MuxSession *session) {
+    while (session->out_start < session->out_end) {
+        ssize_t sent = send(session->socket, session->out + session->out_start, session->out_end - session->out_start, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            return -1;
+        }
+        session->out_start += (size_t)sent;
+    }
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalidad: Leer lo que quien usa un stream ha escrito, hasta llenar su buffer.
+*
+* @Parámetros:
+* in/out: stream = Stream.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+static void MUX_readStream(MuxStream *stream) {
+    if (stream->tx_start > 0) {
+        memmove(stream->tx, stream->tx + stream->tx_start, stream->tx_end - stream->tx_start);
+        stream->tx_end -= stream->tx_start;
+        stream->tx_start = 0;
+    }
+
+    while (stream->tx_end < MUX_STREAM_BUFFER && !stream->tx_eof) {
+        ssize_t received = recv(stream->socket, stream->tx + stream->tx_end, MUX_STREAM_BUFFER - stream->tx_end, MSG_DONTWAIT);
+        if (received < 0 && errno == EINTR) continue;
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        if (received <= 0) {
+            stream->tx_eof = 1;     // Ha tancat el seu extrem o ha fet shutdown de l'escriptura
+            return;
+        }
+        stream->tx_end += (size_t)received;
+    }
+}
+
+/***********************************************
+*
+* @Finalidad: Entregar a quien usa un stream los bytes recibidos que acepte sin bloquear,
+*             devolver crédito al otro extremo cada `MUX_CREDIT_THRESHOLD` bytes y, cuando
+*             el otro extremo ha cerrado y ya se ha entregado todo, cerrar la escritura del
+*             stream para que lea el final. Si quien lo usa ya lo ha cerrado, el stream se
+*             abandona.
+*
+* @Parámetros:
+* in/out: stream = Stream.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+static void MUX_deliverStream(MuxStream *stream) {
+    while (stream->rx_length > 0 && stream->socket >= 0) {
+        size_t contiguous = MUX_STREAM_WINDOW - stream->rx_start;
+        if (contiguous > stream->rx_length) contiguous = stream->rx_length;
+
+        ssize_t sent = send(stream->socket, stream->rx + stream->rx_start, contiguous, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (sent < 0) {
+            stream->rx_length = 0;
+            stream->reset_pending = 1;
+            MUX_closeStreamSocket(stream);
+            return;
+        }
+
+        stream->rx_start = (stream->rx_start + (size_t)sent) % MUX_STREAM_WINDOW;
+        stream->rx_length -= (size_t)sent;
+        stream->rx_delivered += (uint32_t)sent;
+    }
+
+    if (stream->rx_delivered >= MUX_CREDIT_THRESHOLD && !stream->rx_closed) {
+        stream->credit_pending += stream->rx_delivered;
+        stream->rx_delivered = 0;
+    }
+    if (stream->rx_closed && stream->rx_length == 0 && stream->socket >= 0) shutdown(stream->socket, SHUT_WR);
+}
+
+/***********************************************
+*
+* @Finalidad: Atender un registro recibido por la conexión.
+*
+* @Parámetros:
+* in/out: session = Sesión.
+* in: id = Stream del registro.
+* in: kind = Tipo `MUX_RECORD_*`.
+* in: length = Campo de longitud.
+* in: data = Datos del registro (solo `MUX_RECORD_DATA`).
+*
+* @Retorno:
+*           0 = Registro atendido.
+*          -1 = Registro no válido (el otro extremo no respeta el protocolo).
+*
+************************************************/
+static int MUX_processRecord(MuxSession *session, uint32_t id, uint8_t kind, uint32_t length, const uint8_t *data) {
+    int index = MUX_findStream(session, id);
+    MuxStream *stream = index >= 0 ? session->streams[index] : NULL;
+
+    switch (kind) {
+        case MUX_RECORD_DATA:
+            if (stream == NULL || stream->reset_done || stream->reset_pending) return 0;     // Stream ja abandonat: es descarten les dades en vol
+            if (length > MUX_STREAM_WINDOW - stream->rx_length) return -1;                      // Més del crèdit concedit
+            for (uint32_t copied = 0; copied < length; ) {
+                size_t end = (stream->rx_start + stream->rx_length) % MUX_STREAM_WINDOW;
+                size_t chunk = MUX_STREAM_WINDOW - end;
+                if (chunk > length - copied) chunk = length - copied;
+                memcpy(stream->rx + end, data + copied, chunk);
+                stream->rx_length += chunk;
+                copied += (uint32_t)chunk;
+            }
+            MUX_deliverStream(stream);
+            return 0;
+
+        case MUX_RECORD_OPEN: {
+            if (session->role != MUX_SERVER || stream != NULL) return -1;
+            int free_index = -1;
+            for (int i = 0; i < MUX_MAX_STREAMS && free_index < 0; i++) {
+                if (session->streams[i] == NULL) free_index = i;
+            }
+            MuxStream *opened = free_index >= 0 ? MUX_newStream(id) : NULL;
+            if (opened == NULL) {
+                if (session->n_refused < MUX_MAX_STREAMS) session->refused[session->n_refused++] = id;
+                return 0;
+            }
+            pthread_mutex_lock(&session->mutex);
+            session->streams[free_index] = opened;
+            session->n_streams++;
+            session->stats.streams++;
+            pthread_mutex_unlock(&session->mutex);
+            if (session->handler == NULL || session->handler(session->handler_arg, opened->user_socket, id) != 0) {
+                close(opened->user_socket);     // Rebutjat: el stream llegeix el final i es tanca
+            }
+            return 0;
+        }
+
+        case MUX_RECORD_CLOSE:
+            if (stream != NULL) {
+                stream->rx_closed = 1;
+                MUX_deliverStream(stream);
+            }
+            return 0;
+
+        case MUX_RECORD_RESET:
+            if (stream != NULL) {
+                stream->reset_done = 1;
+                stream->rx_length = 0;
+                MUX_closeStreamSocket(stream);
+            }
+            return 0;
+
+        case MUX_RECORD_CREDIT:
+            if (stream != NULL) {
+                if (length > MUX_STREAM_WINDOW - stream->tx_credit) return -1;
+                stream->tx_credit += length;
+            }
+            return 0;
+
+        default:
+            return -1;
+    }
+}
+
+/***********************************************
+*
+* @Finalidad: Leer de la conexión y atender los registros completos que hayan llegado.
+*
+* @Parámetros:
+* in/out: session = Sesión.
+*
+* @Retorno:
+*           0 = Leído lo que había.
+*          -1 = La conexión se ha cerrado o ha caído, o el otro extremo no respeta el
+*               protocolo.
+*
+************************************************/
+static int MUX_receive(MuxSession *session) {
+    for (;;) {
+        ssize_t received = recv(session->socket, session->in + session->in_end, MUX_IO_BUFFER - session->in_end, MSG_DONTWAIT);
+        if (received < 0 && errno == EINTR) continue;
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+        if (received <= 0) return -1;
+        session->in_end += (size_t)received;
+
+        size_t position = 0;
+        while (session->in_end - position >= MUX_RECORD_HEADER_SIZE) {
+            const uint8_t *record = session->in + position;
+            uint32_t id = MUX_getUint32(record);
+            uint8_t kind = record[4];
+            uint32_t length = MUX_getUint32(record + 5);
+            size_t data_length = kind == MUX_RECORD_DATA ? length : 0;
+
+            if (data_length > MUX_IO_BUFFER - MUX_RECORD_HEADER_SIZE) return -1;
+            if (session->in_end - position < MUX_RECORD_HEADER_SIZE + data_length) break;
+            if (MUX_processRecord(session, id, kind, length, record + MUX_RECORD_HEADER_SIZE) < 0) return -1;
+            position += MUX_RECORD_HEADER_SIZE + data_length;
+        }
+        memmove(session->in, session->in + position, session->in_end - position);
+        session->in_end -= position;
+    }
+}
+
+/***********************************************
+*
+* @Finalidad: Liberar los streams acabados: los abandonados y los que ya se han cerrado en
+*             los dos sentidos.
+*
+* @Parámetros:
+* in/out: session = Sesión.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+static void MUX_reapStreams(MuxSession *session) {
+    for (int i = 0; i < MUX_MAX_STREAMS; i++) {
+        MuxStream *stream = session->streams[i];
+        if (stream == NULL) continue;
+
+        int finished = stream->reset_done || (stream->close_sent && stream->rx_closed && stream->rx_length == 0);
+        if (!finished) continue;
+
+        pthread_mutex_lock(&session->mutex);
+        session->streams[i] = NULL;
+        session->n_streams--;
+        pthread_mutex_unlock(&session->mutex);
+        MUX_freeStream(stream);
+    }
+}
+
+/***********************************************
+*
+* @Finalidad: Comprobar si todos los streams de la sesión están cerrados por quien los usa
+*             y ya se ha enviado todo lo que escribieron.
+*
+* @Parámetros:
+* in: session = Sesión.
+*
+* @Retorno:
+*           1 = No queda nada por enviar.
+*           0 = Algún stream sigue abierto o hay registros pendientes.
+*
+************************************************/
+static int MUX_isDrained(MuxSession *session) {
+    if (session->out_start < session->out_end) return 0;
+    for (int i = 0; i < MUX_MAX_STREAMS; i++) {
+        MuxStream *stream = session->streams[i];
+        if (stream != NULL && !stream->close_sent && !stream->reset_done) return 0;
+    }
+    return 1;
+}
+
+/***********************************************
+*
+* @Finalidad: Cerrar todos los streams de la sesión, entregando antes lo que se pueda de lo
+*             ya recibido (e.g., la desconexión con la que acaba un stream justo antes que la
+*             conexión).
+*
+* @Parámetros:
+* in/out: session = Sesión.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+static void MUX_closeStreams(MuxSession *session) {
+    pthread_mutex_lock(&session->mutex);
+    session->alive = 0;
+    for (int i = 0; i < MUX_MAX_STREAMS; i++) {
+        if (session->streams[i] != NULL) {
+            MUX_deliverStream(session->streams[i]);
+            MUX_freeStream(session->streams[i]);
+            session->streams[i] = NULL;
+        }
+    }
+    while (session->opening != NULL) {
+        MuxStream *stream = session->opening;
+        session->opening = stream->next;
+        MUX_freeStream(stream);
+    }
+    session->n_streams = 0;
+    pthread_mutex_unlock(&session->mutex);
+}
+
+MuxSession *MUX_createSession(int socket, int role, MuxStreamHandler handler, void *arg) {
+    int lowat = MUX_NOTSENT_LOWAT;
+
+    MuxSession *session = calloc(1, sizeof(MuxSession));
+    if (session == NULL) return NULL;
+
+    session->out = malloc(MUX_IO_BUFFER);
+    session->in = malloc(MUX_IO_BUFFER);
+    if (session->out == NULL || session->in == NULL || pipe2(session->wake, O_NONBLOCK | O_CLOEXEC) < 0) {
+        free(session->out);
+        free(session->in);
+        free(session);
+        return NULL;
+    }
+
+    session->socket = socket;
+    session->role = role;
+    session->handler = handler;
+    session->handler_arg = arg;
+    session->next_id = role == MUX_CLIENT ? 1 : 2;      // Senars els que obre el client, parells si mai n'obre el servidor
+    session->alive = 1;
+    pthread_mutex_init(&session->mutex, NULL);
+
+    MUX_setNonBlocking(socket);
+    setsockopt(socket, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &lowat, sizeof(lowat));   // Si no es pot, la cua del nucli només retarda el control
+
+    pthread_mutex_lock(&registry_mutex);
+    session->next_registered = registry;
+    registry = session;
+    pthread_mutex_unlock(&registry_mutex);
+
+    return session;
+}
+
+void MUX_runSession(MuxSession *session, volatile int *exit) {
+    struct pollfd fds[2 + MUX_MAX_STREAMS];
+    int indexes[MUX_MAX_STREAMS];
+
+    // En sortir del programa, la sessió continua fins que els streams que queden s'acaben: qui els usa pot enviar encara el que té pendent (e.g., desar el progrés abans de desconnectar-se)
+    while (session->alive && !session->stop && (exit == NULL || !*exit || !MUX_isDrained(session))) {
+        MUX_adoptStreams(session);
+        MUX_fillOutput(session);
+
+        fds[0].fd = session->socket;
+        fds[0].events = POLLIN | (session->out_start < session->out_end ? POLLOUT : 0);
+        fds[1].fd = session->wake[0];
+        fds[1].events = POLLIN;
+        int n_fds = 2;
+        for (int i = 0; i < MUX_MAX_STREAMS; i++) {
+            MuxStream *stream = session->streams[i];
+            if (stream == NULL || stream->socket < 0) continue;
+
+            short events = 0;
+            if (!stream->tx_eof && stream->tx_end - stream->tx_start < MUX_STREAM_BUFFER) events |= POLLIN;
+            if (stream->rx_length > 0) events |= POLLOUT;
+            if (events == 0) continue;
+            fds[n_fds].fd = stream->socket;
+            fds[n_fds].events = events;
+            indexes[n_fds - 2] = i;
+            n_fds++;
+        }
+
+        if (poll(fds, n_fds, MUX_POLL_MS) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            uint8_t drain[64];
+            while (read(session->wake[0], drain, sizeof(drain)) > 0);
+        }
+        if ((fds[0].revents & (POLLIN | POLLERR | POLLHUP)) && MUX_receive(session) < 0) break;
+
+        for (int i = 2; i < n_fds; i++) {
+            MuxStream *stream = session->streams[indexes[i - 2]];
+            if (stream->socket < 0) continue;
+            if (fds[i].revents & POLLOUT) MUX_deliverStream(stream);
+            if (stream->socket >= 0 && (fds[i].revents & (POLLIN | POLLHUP | POLLERR))) MUX_readStream(stream);
+        }
+
+        if (fds[0].revents & POLLOUT) {
+            if (MUX_flushOutput(session) < 0) break;
+        }
+        MUX_reapStreams(session);
+    }
+
+    MUX_closeStreams(session);
+}
+
+/***********************************************
+*
+* @Finalidad: Cuerpo del hilo de una sesión iniciada con `MUX_startSession`.
+*
+* @Parámetros:
+* in: arg = Sesión.
+*
+* @Retorno: NULL.
+*
+************************************************/
+static void *MUX_sessionThread(void *arg) {
+    MUX_runSession((MuxSession *)arg, NULL);
+    return NULL;
+}
+
+int MUX_startSession(MuxSession *session) {
+    if (pthread_create(&session->thread, NULL, MUX_sessionThread, session) != 0) return -1;
+    session->has_thread = 1;
+    return 0;
+}
+
+int MUX_openStream(MuxSession *session, uint32_t *id) {
+    int user_socket = -1;
+
+    pthread_mutex_lock(&session->mutex);
+    if (session->alive && !session->stop && session->n_streams < MUX_MAX_STREAMS) {
+        MuxStream *stream = MUX_newStream(session->next_id);
+        if (stream != NULL) {
+            stream->open_pending = 1;
+            stream->next = session->opening;
+            session->opening = stream;
+            session->n_streams++;
+            session->stats.streams++;
+            session->next_id += 2;
+            user_socket = stream->user_socket;
+            if (id != NULL) *id = stream->id;
+        }
+    }
+    pthread_mutex_unlock(&session->mutex);
+
+    if (user_socket >= 0) MUX_wake(session);
+    return user_socket;
+}
+
+int MUX_isAlive(MuxSession *session) {
+    return session != NULL && session->alive && !session->stop;
+}
+
+void MUX_getStats(MuxSession *session, MuxStats *stats) {
+    pthread_mutex_lock(&session->mutex);
+    *stats = session->stats;
+    pthread_mutex_unlock(&session->mutex);
+}
+
+void MUX_destroySession(MuxSession *session) {
+    if (session == NULL) return;
+
+    session->stop = 1;
+    MUX_wake(session);
+    if (session->has_thread) pthread_join(session->thread, NULL);
+    MUX_closeStreams(session);
+
+    pthread_mutex_lock(&registry_mutex);
+    for (MuxSession **link = &registry; *link != NULL; link = &(*link)->next_registered) {
+        if (*link == session) {
+            *link = session->next_registered;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&registry_mutex);
+
+    close(session->wake[0]);
+    close(session->wake[1]);
+    pthread_mutex_destroy(&session->mutex);
+    free(session->out);
+    free(session->in);
+    free(session);
+}
+
+/***********************************************
+*
+* @Finalidad: Comprobar si un socket es el extremo de usuario de un stream de la sesión.
+*
+* @Parámetros:
+* in: session = Sesión (con su mutex bloqueado).
+* in: socket = Socket.
+* in: inode = Inodo del socket (distingue un descriptor reutilizado por otro socket).
+*
+* @Retorno: 1 si lo es, 0 si no.
+*
+************************************************/
+static int MUX_ownsSocket(MuxSession *session, int socket, ino_t inode) {
+    for (int i = 0; i < MUX_MAX_STREAMS; i++) {
+        MuxStream *stream = session->streams[i];
+        if (stream != NULL && stream->user_socket == socket && stream->user_inode == inode) return 1;
+    }
+    for (MuxStream *stream = session->opening; stream != NULL; stream = stream->next) {
+        if (stream->user_socket == socket && stream->user_inode == inode) return 1;
+    }
+    return 0;
+}
+
+int MUX_getTransport(int socket) {
+    struct stat status;
+    int transport = socket;
+
+    if (fstat(socket, &status) < 0 || !S_ISSOCK(status.st_mode)) return socket;
+
+    pthread_mutex_lock(&registry_mutex);
+    for (MuxSession *session = registry; session != NULL && transport == socket; session = session->next_registered) {
+        pthread_mutex_lock(&session->mutex);
+        if (MUX_ownsSocket(session, socket, status.st_ino)) transport = session->socket;
+        pthread_mutex_unlock(&session->mutex);
+    }
+    pthread_mutex_unlock(&registry_mutex);
+
+    return transport;
+}
+
+/***********************************************
+*
+* @Finalidad: Cerrar una sesión del pool y su conexión, y sacarla del pool.
+*
+* @Parámetros:
+* in/out: pool = Sesiones del fleck (con su mutex bloqueado).
+* in: index = Posición de la sesión.
+* out: stats = Contadores a los que se suman los de la sesión (puede ser NULL).
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+static void MUX_poolRemove(MuxPool *pool, int index, MuxStats *stats) {
+    MuxPoolEntry *entry = &pool->entries[index];
+
+    if (stats != NULL) {
+        MuxStats session_stats;
+        MUX_getStats(entry->session, &session_stats);
+        stats->streams += session_stats.streams;
+        stats->records += session_stats.records;
+        stats->control_records += session_stats.control_records;
+        stats->preemptions += session_stats.preemptions;
+    }
+
+    MUX_destroySession(entry->session);
+    close(entry->socket);
+    free(entry->ip);
+    pool->entries[index] = pool->entries[pool->n_entries - 1];
+    pool->n_entries--;
+}
+
+int MUX_poolOpenStream(MuxPool *pool, const char *ip, int port, uint32_t *id, ConnectionOffer *agreed) {
+    int stream_socket = -1;
+
+    pthread_mutex_lock(&pool->mutex);
+    for (int i = 0; i < pool->n_entries && stream_socket < 0; ) {
+        MuxPoolEntry *entry = &pool->entries[i];
+        if (!MUX_isAlive(entry->session)) {
+            MUX_poolRemove(pool, i, NULL);
+            continue;
+        }
+        if (entry->port == port && strcmp(entry->ip, ip) == 0) {
+            stream_socket = MUX_openStream(entry->session, id);
+            if (stream_socket >= 0 && agreed != NULL) *agreed = entry->agreed;
+        }
+        i++;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    return stream_socket;
+}
+
+int MUX_poolHasSession(MuxPool *pool, const char *ip, int port) {
+    int found = 0;
+
+    pthread_mutex_lock(&pool->mutex);
+    for (int i = 0; i < pool->n_entries && !found; i++) {
+        MuxPoolEntry *entry = &pool->entries[i];
+        found = entry->port == port && strcmp(entry->ip, ip) == 0 && MUX_isAlive(entry->session);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    return found;
+}
+
+int MUX_poolAddSession(MuxPool *pool, const char *ip, int port, int socket, const ConnectionOffer *agreed, uint32_t *id) {
+    MuxSession *session = MUX_createSession(socket, MUX_CLIENT, NULL, NULL);
+    if (session == NULL) return -1;
+
+    int stream_socket = MUX_openStream(session, id);
+    if (stream_socket < 0 || MUX_startSession(session) < 0) {
+        if (stream_socket >= 0) close(stream_socket);
+        MUX_destroySession(session);
+        return -1;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    MuxPoolEntry *entries = realloc(pool->entries, (pool->n_entries + 1) * sizeof(MuxPoolEntry));
+    char *ip_copy = strdup(ip);
+    if (entries == NULL || ip_copy == NULL) {
+        if (entries != NULL) pool->entries = entries;
+        free(ip_copy);
+        pthread_mutex_unlock(&pool->mutex);
+        close(stream_socket);
+        MUX_destroySession(session);
+        return -1;
+    }
+    pool->entries = entries;
+    MuxPoolEntry entry = {session, ip_copy, port, socket, {0, 0, 0, 0, 0, 0}};
+    if (agreed != NULL) entry.agreed = *agreed;
+    pool->entries[pool->n_entries++] = entry;
+    pthread_mutex_unlock(&pool->mutex);
+
+    return stream_socket;
+}
+
+int MUX_destroyPool(MuxPool *pool, MuxStats *stats) {
+    int closed = 0;
+
+    if (stats != NULL) memset(stats, 0, sizeof(MuxStats));
+
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->n_entries > 0) {
+        MUX_poolRemove(pool, pool->n_entries - 1, stats);
+        closed++;
+    }
+    free(pool->entries);
+    pool->entries = NULL;
+    pthread_mutex_unlock(&pool->mutex);
+
+    return closed;
+}
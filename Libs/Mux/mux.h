@@ -0,0 +1,270 @@
+/***********************************************
+*
+* @Autores: Alexandre Contreras y Armand López
+* @Propósito: Multiplexar sobre una sola conexión TCP varios streams independientes entre
+*             un fleck y un worker, de modo que un fleck puede tener varias distorsiones en
+*             curso con el mismo worker sin abrir una conexión para cada una. Cada stream se
+*             entrega a quien lo usa como un extremo de un `socketpair`, así que las funciones
+*             de comunicación lo tratan igual que un socket propio. Un hilo por sesión reparte
+*             los bytes en registros con el identificador del stream, da el turno a los streams
+*             por rondas para que un fichero grande no retenga a uno pequeño, y adelanta las
+*             tramas de control (ACK, comprobaciones MD5, desconexiones) a los datos.
+* @Fecha de creación: 16 de octubre de 2026
+* @Última modificación: 16 de octubre de 2026
+*
+************************************************/
+
+#ifndef _MUX_CUSTOM_H_
+#define _MUX_CUSTOM_H_
+
+// Constants del sistema
+#define _GNU_SOURCE
+
+//Libreries del sistema
+#include <stdint.h>         // uint8_t, uint32_t
+#include <stddef.h>         // size_t
+#include <stdlib.h>         // malloc, calloc, free
+#include <string.h>         // memcpy, memmove, strcmp, strdup
+#include <errno.h>          // errno, EAGAIN, EINTR
+#include <fcntl.h>          // fcntl, O_NONBLOCK, O_CLOEXEC
+#include <unistd.h>         // close, read, write, pipe2
+#include <poll.h>           // poll, struct pollfd
+#include <pthread.h>        // pthread_t, pthread_mutex_t
+#include <sys/socket.h>     // socketpair, send, recv, shutdown
+#include <sys/stat.h>       // fstat, struct stat
+#include <netinet/in.h>     // IPPROTO_TCP
+#include <netinet/tcp.h>    // TCP_NOTSENT_LOWAT
+
+//Libreries pròpies
+#include "../Frame/frame.h"
+
+//Constants
+#define MUX_CLIENT 0                        // Extrem que obre els streams (el fleck)
+#define MUX_SERVER 1                        // Extrem que els accepta (el worker)
+#define MUX_MAX_STREAMS 64                  // Streams oberts alhora en una sessió
+#define MUX_STREAM_WINDOW (256 * 1024)      // Bytes que es poden enviar per un stream sense que l'altre extrem els hagi lliurat (crèdit inicial)
+#define MUX_STREAM_BUFFER (128 * 1024)      // Bytes llegits d'un stream que esperen el seu torn per sortir
+#define MUX_QUANTUM (16 * 1024)             // Bytes de dades de fitxer que surten d'un stream abans de passar el torn al següent
+#define MUX_IO_BUFFER (256 * 1024)          // Bytes de registres pendents d'enviar per la connexió, i de registres rebuts pendents de repartir
+#define MUX_NOTSENT_LOWAT (128 * 1024)      // Bytes sense enviar que es deixen a la cua del nucli (la resta espera a la sessió, on el control es pot avançar)
+#define MUX_POLL_MS 100                     // Espera màxima del bucle de la sessió, per atendre la sortida del programa
+
+//Tipus propis
+typedef struct MuxSession MuxSession;      // Sessió multiplexada sobre una connexió, definida a mux.c
+
+typedef int (*MuxStreamHandler)(void *arg, int socket, uint32_t id);   // Rep cada stream que obre l'altre extrem; retorna 0 si se n'encarrega (i tancarà `socket`) o -1 per rebutjar-lo
+
+typedef struct {
+    int streams;                    // Streams que s'han obert a la sessió
+    unsigned long records;          // Registres de dades enviats
+    unsigned long control_records;  // D'aquests, els que portaven una trama de control
+    unsigned long preemptions;      // Trames de control que han passat davant de dades de fitxer d'altres streams
+} MuxStats;
+
+typedef struct {
+    MuxSession *session;
+    char *ip;                       // Worker amb qui és la sessió
+    int port;
+    int socket;                     // Connexió de la sessió (la tanca el pool)
+    ConnectionOffer agreed;         // Combinació acordada en obrir la sessió per a totes les seves distorsions (a zero si el worker no n'ha acordat cap)
+} MuxPoolEntry;
+
+typedef struct {
+    MuxPoolEntry *entries;          // Una sessió per worker
+    int n_entries;
+    pthread_mutex_t mutex;
+} MuxPool;                          // Sessions obertes d'un fleck, compartides pels threads de les distorsions
+
+#define MUX_EMPTY_POOL {NULL, 0, PTHREAD_MUTEX_INITIALIZER}   // Inicialitzador d'un pool sense sessions
+
+//Funcions
+
+/***********************************************
+*
+* @Finalidad: Crear una sesión multiplexada sobre una conexión ya establecida y acordada
+*             con el otro extremo. La conexión pasa a ser no bloqueante y solo la usa la
+*             sesión, que no la cierra: sigue siendo de quien la ha abierto.
+*
+* @Parámetros:
+* in: socket = Conexión TCP de la sesión.
+* in: role = `MUX_CLIENT` si este extremo abre los streams o `MUX_SERVER` si los acepta.
+* in: handler = Función que recibe los streams que abre el otro extremo (NULL en el cliente).
+* in: arg = Argumento de `handler`.
+*
+* @Retorno: Sesión creada, o NULL si no se ha podido reservar.
+*
+************************************************/
+MuxSession *MUX_createSession(int socket, int role, MuxStreamHandler handler, void *arg);
+
+/***********************************************
+*
+* @Finalidad: Atender la sesión en el hilo que llama hasta que la conexión cae, el otro
+*             extremo la cierra o se destruye la sesión. Si se activa `exit`, la sesión acaba
+*             en cuanto quienes usan los streams los han cerrado y se ha enviado lo que
+*             escribieron. Al acabar se cierran los streams que quedan, de modo que quien los
+*             usa ve una desconexión.
+*
+* @Parámetros:
+* in/out: session = Sesión creada con `MUX_createSession`.
+* in: exit = Indicador de salida del programa (puede ser NULL).
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void MUX_runSession(MuxSession *session, volatile int *exit);
+
+/***********************************************
+*
+* @Finalidad: Atender la sesión en un hilo propio (`MUX_runSession` sin indicador de
+*             salida), que acaba al destruir la sesión.
+*
+* @Parámetros:
+* in/out: session = Sesión creada con `MUX_createSession`.
+*
+* @Retorno:
+*           0 = Hilo creado.
+*          -1 = No se ha podido crear.
+*
+************************************************/
+int MUX_startSession(MuxSession *session);
+
+/***********************************************
+*
+* @Finalidad: Abrir un stream nuevo en la sesión. El otro extremo lo recibe con su
+*             `handler` en cuanto llega el registro de apertura, que siempre sale antes
+*             que los datos que se escriban en el stream.
+*
+* @Parámetros:
+* in/out: session = Sesión activa como `MUX_CLIENT`.
+* out: id = Identificador del stream en la sesión (puede ser NULL).
+*
+* @Retorno: Socket del stream (lo cierra quien lo usa), o -1 si la sesión ya no está activa
+*           o tiene `MUX_MAX_STREAMS` streams abiertos.
+*
+************************************************/
+int MUX_openStream(MuxSession *session, uint32_t *id);
+
+/***********************************************
+*
+* @Finalidad: Comprobar si la conexión de la sesión sigue activa.
+*
+* @Parámetros:
+* in: session = Sesión.
+*
+* @Retorno:
+*           1 = Activa.
+*           0 = La conexión ha caído o la sesión se ha cerrado.
+*
+************************************************/
+int MUX_isAlive(MuxSession *session);
+
+/***********************************************
+*
+* @Finalidad: Consultar los contadores de la sesión.
+*
+* @Parámetros:
+* in: session = Sesión.
+* out: stats = Contadores.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void MUX_getStats(MuxSession *session, MuxStats *stats);
+
+/***********************************************
+*
+* @Finalidad: Parar la sesión, esperar a su hilo si lo tiene, cerrar los streams que
+*             quedan y liberarla. No cierra la conexión.
+*
+* @Parámetros:
+* in/out: session = Sesión a destruir (puede ser NULL).
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void MUX_destroySession(MuxSession *session);
+
+/***********************************************
+*
+* @Finalidad: Obtener la conexión TCP que transporta un socket, para consultar las
+*             direcciones o el estado TCP de un stream de una sesión.
+*
+* @Parámetros:
+* in: socket = Socket de un stream o de una conexión propia.
+*
+* @Retorno: Conexión de la sesión si `socket` es un stream, o el mismo `socket` si no.
+*
+************************************************/
+int MUX_getTransport(int socket);
+
+/***********************************************
+*
+* @Finalidad: Abrir un stream en la sesión que el pool tiene con un worker, descartando
+*             antes las sesiones cuya conexión ha caído.
+*
+* @Parámetros:
+* in/out: pool = Sesiones del fleck.
+* in: ip = IP del worker.
+* in: port = Puerto del worker.
+* out: id = Identificador del stream (puede ser NULL).
+* out: agreed = Combinación acordada al abrir la sesión, o a cero si no se acordó ninguna
+*               (puede ser NULL).
+*
+* @Retorno: Socket del stream, o -1 si no hay ninguna sesión activa con el worker o no
+*           admite más streams.
+*
+************************************************/
+int MUX_poolOpenStream(MuxPool *pool, const char *ip, int port, uint32_t *id, ConnectionOffer *agreed);
+
+/***********************************************
+*
+* @Finalidad: Comprobar si el pool tiene una sesión activa con un worker.
+*
+* @Parámetros:
+* in/out: pool = Sesiones del fleck.
+* in: ip = IP del worker.
+* in: port = Puerto del worker.
+*
+* @Retorno:
+*           1 = Hay una sesión activa.
+*           0 = No la hay.
+*
+************************************************/
+int MUX_poolHasSession(MuxPool *pool, const char *ip, int port);
+
+/***********************************************
+*
+* @Finalidad: Empezar una sesión sobre una conexión nueva con un worker, añadirla al pool
+*             y abrir en ella el primer stream. Si ya había otra sesión con el mismo worker
+*             (la abría otro hilo a la vez), la nueva se añade igualmente.
+*
+* @Parámetros:
+* in/out: pool = Sesiones del fleck.
+* in: ip = IP del worker.
+* in: port = Puerto del worker.
+* in: socket = Conexión ya acordada como sesión. Si todo va bien pasa a ser del pool.
+* in: agreed = Combinación acordada con el worker para todos los streams de la sesión, o
+*             NULL si no se ha acordado ninguna.
+* out: id = Identificador del stream (puede ser NULL).
+*
+* @Retorno: Socket del primer stream, o -1 si no se ha podido empezar la sesión (la
+*           conexión sigue siendo de quien llama).
+*
+************************************************/
+int MUX_poolAddSession(MuxPool *pool, const char *ip, int port, int socket, const ConnectionOffer *agreed, uint32_t *id);
+
+/***********************************************
+*
+* @Finalidad: Cerrar todas las sesiones del pool y sus conexiones. Se llama cuando ya no
+*             queda ninguna distorsión que use sus streams.
+*
+* @Parámetros:
+* in/out: pool = Sesiones del fleck. Queda vacío.
+* out: stats = Suma de los contadores de las sesiones cerradas (puede ser NULL).
+*
+* @Retorno: Número de sesiones cerradas.
+*
+************************************************/
+int MUX_destroyPool(MuxPool *pool, MuxStats *stats);
+
+#endif // _MUX_CUSTOM_H_
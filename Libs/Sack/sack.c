@@ -0,0 +1,446 @@
+/***********************************************
+*
+* @Autores: Alexandre Contreras, Armand López.
+*
+* @Finalidad: Implementar el bitmap de paquetes recibidos de un fichero, los ACK
+*             selectivos que lo transportan, su conversión a tramos para la memoria
+*             compartida de los workers y su reparto en franjas.
+*
+* @Fecha de creación: 16 de octubre de 2026.
+*
+* @Última modificación: 16 de octubre de 2026.
+*
+************************************************/
+
+#include "sack.h"
+
+/***********************************************
+*
+* @Finalidad: Reservar un bitmap sin ningún paquete marcado.
+*
+* @Parámetros:
+* out: map = Bitmap a reservar. No se libera el contenido anterior.
+* in: n_packets = Número de paquetes del fichero.
+* in: data_size = Bytes de datos por paquete.
+*
+* @Retorno:
+*           0 = Bitmap reservado.
+*          -1 = Error al reservar memoria.
+*
+************************************************/
+static int SACK_allocMap(PacketMap *map, int n_packets, int data_size) {
+    if (n_packets < 0) n_packets = 0;
+
+    //reservem com a mínim un byte perquè un fitxer buit també tingui bitmap
+    map->bits = (uint8_t *)calloc(n_packets / 8 + 1, 1);
+    if (!map->bits) return -1;
+
+    map->n_packets = n_packets;
+    map->data_size = data_size;
+    map->n_received = 0;
+    map->first_missing = 0;
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalidad: Inicializar un bitmap de paquetes vacío, sin memoria reservada.
+*
+* @Parámetros:
+* out: map = Bitmap a inicializar.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void SACK_initMap(PacketMap *map) {
+    map->bits = NULL;
+    map->n_packets = 0;
+    map->data_size = 0;
+    map->n_received = 0;
+    map->first_missing = 0;
+}
+
+/***********************************************
+*
+* @Finalidad: Preparar un bitmap para un fichero de `n_packets` paquetes de `data_size`
+*             bytes. Si el bitmap ya cubre el mismo fichero con el mismo tamaño de paquete se
+*             conserva; si se contó con otro tamaño, cada paquete nuevo se marca solo si
+*             todos sus bytes estaban en paquetes ya recibidos.
+*
+* @Parámetros:
+* in/out: map = Bitmap a preparar.
+* in: n_packets = Número de paquetes del fichero.
+* in: data_size = Bytes de datos por paquete.
+*
+* @Retorno:
+*           0 = Bitmap preparado.
+*          -1 = Error al reservar memoria (el bitmap anterior se conserva).
+*
+************************************************/
+int SACK_prepareMap(PacketMap *map, int n_packets, int data_size) {
+    if (map->bits && map->n_packets == n_packets && map->data_size == data_size) return 0;
+
+    PacketMap previous = *map;
+    if (SACK_allocMap(map, n_packets, data_size) < 0) {
+        *map = previous;
+        return -1;
+    }
+    if (!previous.bits) return 0;
+
+    //convertim a la nova mida: un paquet nou està rebut si tots els paquets antics que el cobreixen ho estan
+    for (int packet = 0; packet < n_packets && previous.data_size > 0; packet++) {
+        long long start = (long long)packet * data_size;
+        long long end = start + data_size;
+        int first = (int)(start / previous.data_size);
+        int last = (int)((end + previous.data_size - 1) / previous.data_size);
+        if (last > previous.n_packets) last = previous.n_packets;
+        if (first >= last) break;
+
+        int covered = 1;
+        for (int old = first; old < last && covered; old++) {
+            covered = SACK_isReceived(&previous, old);
+        }
+        if (covered) SACK_markReceived(map, packet);
+    }
+
+    free(previous.bits);
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalidad: Liberar la memoria de un bitmap y dejarlo vacío.
+*
+* @Parámetros:
+* in/out: map = Bitmap a liberar.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void SACK_freeMap(PacketMap *map) {
+    free(map->bits);
+    SACK_initMap(map);
+}
+
+/***********************************************
+*
+* @Finalidad: Consultar si un paquete está marcado como recibido.
+*
+* @Parámetros:
+* in: map = Bitmap de paquetes.
+* in: packet = Índice del paquete.
+*
+* @Retorno:
+*           1 = El paquete está recibido.
+*           0 = El paquete no está recibido o está fuera del bitmap.
+*
+************************************************/
+int SACK_isReceived(const PacketMap *map, int packet) {
+    if (!map->bits || packet < 0 || packet >= map->n_packets) return 0;
+    return (map->bits[packet / 8] >> (7 - packet % 8)) & 1;
+}
+
+/***********************************************
+*
+* @Finalidad: Marcar un paquete como recibido.
+*
+* @Parámetros:
+* in/out: map = Bitmap de paquetes.
+* in: packet = Índice del paquete.
+*
+* @Retorno:
+*           1 = El paquete no estaba marcado.
+*           0 = El paquete ya estaba marcado o está fuera del bitmap.
+*
+************************************************/
+int SACK_markReceived(PacketMap *map, int packet) {
+    if (!map->bits || packet < 0 || packet >= map->n_packets || SACK_isReceived(map, packet)) return 0;
+
+    map->bits[packet / 8] |= (uint8_t)(0x80 >> (packet % 8));
+    map->n_received++;
+
+    //avancem el primer paquet que falta per sobre del prefix que ja és complet
+    while (map->first_missing < map->n_packets && SACK_isReceived(map, map->first_missing)) {
+        map->first_missing++;
+    }
+    return 1;
+}
+
+/***********************************************
+*
+* @Finalidad: Desmarcar un tramo de paquetes que estaban recibidos, para que se vuelvan a
+*             pedir (e.g., los de un bloque que no coincide con su hash).
+*
+* @Parámetros:
+* in/out: map = Bitmap de paquetes.
+* in: first = Primer paquete del tramo.
+* in: count = Número de paquetes del tramo.
+*
+* @Retorno: Número de paquetes que estaban marcados y se han desmarcado.
+*
+************************************************/
+int SACK_markMissing(PacketMap *map, int first, int count) {
+    int cleared = 0;
+
+    if (!map->bits) return 0;
+    for (int packet = first < 0 ? 0 : first; packet < first + count && packet < map->n_packets; packet++) {
+        if (!SACK_isReceived(map, packet)) continue;
+        map->bits[packet / 8] &= (uint8_t)~(0x80 >> (packet % 8));
+        map->n_received--;
+        cleared++;
+        if (packet < map->first_missing) map->first_missing = packet;
+    }
+    return cleared;
+}
+
+/***********************************************
+*
+* @Finalidad: Contar los paquetes consecutivos sin recibir a partir de uno dado, para
+*             leerlos del fichero y enviarlos en un solo lote.
+*
+* @Parámetros:
+* in: map = Bitmap de paquetes.
+* in: first = Primer paquete del hueco.
+* in: max_packets = Máximo de paquetes a contar.
+*
+* @Retorno: Número de paquetes sin recibir consecutivos desde `first` (como mucho `max_packets`).
+*
+************************************************/
+int SACK_countMissing(const PacketMap *map, int first, int max_packets) {
+    int count = 0;
+    while (count < max_packets && first + count < map->n_packets && !SACK_isReceived(map, first + count)) {
+        count++;
+    }
+    return count;
+}
+
+/***********************************************
+*
+* @Finalidad: Codificar un ACK selectivo: el primer paquete no recibido (todos los
+*             anteriores lo están) seguido del bitmap de los paquetes a partir de este,
+*             truncado a lo que quepa en el buffer.
+*
+* @Parámetros:
+* in: map = Bitmap de paquetes recibidos.
+* out: buffer = Buffer donde se escribirá el ACK.
+* in: capacity = Tamaño del buffer (como mínimo `SACK_ACK_HEADER_SIZE`).
+*
+* @Retorno: Número de bytes escritos en `buffer` (0 si no cabe la cabecera).
+*
+************************************************/
+size_t SACK_encodeAck(const PacketMap *map, uint8_t *buffer, size_t capacity) {
+    if (capacity < SACK_ACK_HEADER_SIZE) return 0;
+
+    uint32_t base = (uint32_t)map->first_missing;
+    buffer[0] = (base >> 24) & 0xFF;
+    buffer[1] = (base >> 16) & 0xFF;
+    buffer[2] = (base >> 8) & 0xFF;
+    buffer[3] = base & 0xFF;
+
+    //bit k del bitmap = paquet base + k. Només hi posem bytes si queda algun paquet rebut per sobre de la base
+    size_t length = SACK_ACK_HEADER_SIZE;
+    if (map->n_received > map->first_missing) {
+        size_t bitmap_bytes = (size_t)(map->n_packets - map->first_missing + 7) / 8;
+        if (bitmap_bytes > capacity - SACK_ACK_HEADER_SIZE) bitmap_bytes = capacity - SACK_ACK_HEADER_SIZE;
+        memset(buffer + length, 0, bitmap_bytes);
+
+        for (size_t k = 0; k < bitmap_bytes * 8; k++) {
+            if (SACK_isReceived(map, map->first_missing + (int)k)) {
+                buffer[length + k / 8] |= (uint8_t)(0x80 >> (k % 8));
+            }
+        }
+        length += bitmap_bytes;
+    }
+    return length;
+}
+
+/***********************************************
+*
+* @Finalidad: Marcar en el bitmap del emisor los paquetes que confirma un ACK selectivo.
+*
+* @Parámetros:
+* in/out: map = Bitmap de paquetes confirmados por el receptor.
+* in: data = Datos del ACK.
+* in: length = Número de bytes de `data`.
+* in: limit = Los paquetes nuevos con índice menor que `limit` se cuentan en el retorno
+*             (e.g., los que el emisor ya ha enviado y tiene en vuelo).
+*
+* @Retorno:
+*           >= 0 = Paquetes confirmados por primera vez con índice menor que `limit`.
+*           -1 = ACK malformado.
+*
+************************************************/
+int SACK_applyAck(PacketMap *map, const uint8_t *data, size_t length, int limit) {
+    if (length < SACK_ACK_HEADER_SIZE) return -1;
+
+    uint32_t base = ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | (uint32_t)data[3];
+    if (base > (uint32_t)map->n_packets) return -1;
+
+    int newly_acked = 0;
+    for (int packet = map->first_missing; packet < (int)base; packet++) {
+        if (SACK_markReceived(map, packet) && packet < limit) newly_acked++;
+    }
+
+    for (size_t k = 0; k < (length - SACK_ACK_HEADER_SIZE) * 8; k++) {
+        int packet = (int)base + (int)k;
+        if (packet >= map->n_packets) break;
+        if (((data[SACK_ACK_HEADER_SIZE + k / 8] >> (7 - k % 8)) & 1) && SACK_markReceived(map, packet) && packet < limit) {
+            newly_acked++;
+        }
+    }
+    return newly_acked;
+}
+
+/***********************************************
+*
+* @Finalidad: Resumir un bitmap en tramos de paquetes recibidos para guardarlo en memoria
+*             compartida. Si hay más tramos de los que caben, los últimos se descartan y
+*             esos paquetes se volverán a pedir.
+*
+* @Parámetros:
+* in: map = Bitmap de paquetes.
+* out: ranges = Tramos resultantes.
+* in: max_ranges = Número máximo de tramos de `ranges`.
+*
+* @Retorno: Número de tramos escritos en `ranges`.
+*
+************************************************/
+int SACK_toRanges(const PacketMap *map, DistortionRange *ranges, int max_ranges) {
+    int n_ranges = 0;
+    int packet = 0;
+
+    while (packet < map->n_packets && n_ranges < max_ranges) {
+        if (!SACK_isReceived(map, packet)) {
+            packet++;
+            continue;
+        }
+
+        ranges[n_ranges].first_packet = packet;
+        while (packet < map->n_packets && SACK_isReceived(map, packet)) packet++;
+        ranges[n_ranges].n_packets = packet - ranges[n_ranges].first_packet;
+        n_ranges++;
+    }
+    return n_ranges;
+}
+
+/***********************************************
+*
+* @Finalidad: Reconstruir un bitmap a partir de los tramos guardados con `SACK_toRanges`.
+*
+* @Parámetros:
+* out: map = Bitmap a reconstruir. Se libera el contenido anterior.
+* in: n_packets = Número de paquetes del fichero con los que se guardaron los tramos.
+* in: data_size = Tamaño de paquete con el que se guardaron los tramos.
+* in: ranges = Tramos de paquetes recibidos.
+* in: n_ranges = Número de tramos de `ranges`.
+*
+* @Retorno:
+*           0 = Bitmap reconstruido.
+*          -1 = Error al reservar memoria.
+*
+************************************************/
+int SACK_fromRanges(PacketMap *map, int n_packets, int data_size, const DistortionRange *ranges, int n_ranges) {
+    SACK_freeMap(map);
+    if (SACK_allocMap(map, n_packets, data_size) < 0) return -1;
+
+    for (int i = 0; i < n_ranges; i++) {
+        for (int packet = ranges[i].first_packet; packet < ranges[i].first_packet + ranges[i].n_packets; packet++) {
+            SACK_markReceived(map, packet);
+        }
+    }
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalidad: Calcular la franja `stripe` de un fichero repartido en `n_stripes` franjas
+*             de paquetes consecutivos, lo más iguales posible, que se envían por
+*             conexiones paralelas.
+*
+* @Parámetros:
+* in: n_packets = Número de paquetes del fichero.
+* in: n_stripes = Número de franjas.
+* in: stripe = Índice de la franja (de 0 a `n_stripes` - 1).
+* out: range = Primer paquete y número de paquetes de la franja, sin ninguno recibido.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void SACK_getStripe(int n_packets, int n_stripes, int stripe, DistortionStripe *range) {
+    range->first_packet = (int)(((long long)n_packets * stripe) / n_stripes);
+    range->n_packets = (int)(((long long)n_packets * (stripe + 1)) / n_stripes) - range->first_packet;
+    range->n_received = 0;
+}
+
+/***********************************************
+*
+* @Finalidad: Marcar como recibidos todos los paquetes de fuera de una franja, de modo
+*             que una transferencia con este bitmap solo trata los paquetes de la franja.
+*
+* @Parámetros:
+* in/out: map = Bitmap de paquetes preparado para el fichero entero.
+* in: range = Franja que queda sin marcar.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void SACK_markOutsideStripe(PacketMap *map, const DistortionStripe *range) {
+    for (int packet = 0; packet < range->first_packet; packet++) {
+        SACK_markReceived(map, packet);
+    }
+    for (int packet = range->first_packet + range->n_packets; packet < map->n_packets; packet++) {
+        SACK_markReceived(map, packet);
+    }
+}
+
+/***********************************************
+*
+* @Finalidad: Preparar el bitmap propio de una franja a partir del bitmap del fichero:
+*             los paquetes de la franja que ya se tienen y todos los de fuera quedan
+*             marcados. Cada conexión paralela escribe en su bitmap sin compartirlo.
+*
+* @Parámetros:
+* out: map = Bitmap de la franja. No se libera el contenido anterior.
+* in: received = Bitmap de paquetes recibidos del fichero entero.
+* in: range = Franja de la conexión.
+*
+* @Retorno:
+*           0 = Bitmap preparado.
+*          -1 = Error al reservar memoria.
+*
+************************************************/
+int SACK_prepareStripeMap(PacketMap *map, const PacketMap *received, const DistortionStripe *range) {
+    if (SACK_allocMap(map, received->n_packets, received->data_size) < 0) return -1;
+
+    for (int packet = range->first_packet; packet < range->first_packet + range->n_packets; packet++) {
+        if (SACK_isReceived(received, packet)) SACK_markReceived(map, packet);
+    }
+    SACK_markOutsideStripe(map, range);
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalidad: Pasar al bitmap del fichero los paquetes de una franja recibidos por su
+*             conexión y anotar cuántos paquetes consecutivos de la franja se tienen.
+*
+* @Parámetros:
+* in/out: received = Bitmap de paquetes recibidos del fichero entero.
+* in: map = Bitmap de la franja (preparado con `SACK_prepareStripeMap`).
+* in/out: range = Franja de la conexión. Se actualiza su número de paquetes recibidos.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void SACK_mergeStripe(PacketMap *received, const PacketMap *map, DistortionStripe *range) {
+    int end = range->first_packet + range->n_packets;
+
+    for (int packet = range->first_packet; packet < end; packet++) {
+        if (SACK_isReceived(map, packet)) SACK_markReceived(received, packet);
+    }
+
+    range->n_received = 0;
+    while (range->first_packet + range->n_received < end && SACK_isReceived(received, range->first_packet + range->n_received)) {
+        range->n_received++;
+    }
+}
@@ -0,0 +1,267 @@
+/***********************************************
+*
+* @Autores: Alexandre Contreras y Armand López
+* @Propósito: Llevar el registro de los paquetes de un fichero que ha recibido cada
+*             extremo (bitmap de paquetes), codificarlo en los ACK selectivos que
+*             informan al emisor de los tramos recibidos y guardarlo por tramos en
+*             memoria compartida, de modo que al reanudar solo se reenvían los huecos.
+*             También reparte un fichero en franjas para las conexiones paralelas.
+* @Fecha de creación: 16 de octubre de 2026
+* @Última modificación: 16 de octubre de 2026
+*
+************************************************/
+
+#ifndef _SACK_CUSTOM_H_
+#define _SACK_CUSTOM_H_
+
+//Libreries del sistema
+#include <stdlib.h>    // calloc, free
+#include <string.h>    // memset
+#include <stdint.h>    // uint8_t, uint32_t
+#include <stddef.h>    // size_t
+
+//Llibreries pròpies
+#include "../Structure/typeDistort.h"
+
+//Constants
+#define SACK_ACK_HEADER_SIZE 4          // Primer paquet no rebut (4 bytes, big endian) al davant del bitmap d'un ACK selectiu
+#define SACK_EMPTY_MAP {NULL, 0, 0, 0, 0}   // Inicialitzador d'un bitmap buit (equivalent a SACK_initMap)
+
+//Funcions
+
+/***********************************************
+*
+* @Finalidad: Inicializar un bitmap de paquetes vacío, sin memoria reservada.
+*
+* @Parámetros:
+* out: map = Bitmap a inicializar.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void SACK_initMap(PacketMap *map);
+
+/***********************************************
+*
+* @Finalidad: Preparar un bitmap para un fichero de `n_packets` paquetes de `data_size`
+*             bytes. Si el bitmap ya cubre el mismo fichero con el mismo tamaño de paquete se
+*             conserva; si se contó con otro tamaño, cada paquete nuevo se marca solo si
+*             todos sus bytes estaban en paquetes ya recibidos.
+*
+* @Parámetros:
+* in/out: map = Bitmap a preparar.
+* in: n_packets = Número de paquetes del fichero.
+* in: data_size = Bytes de datos por paquete.
+*
+* @Retorno:
+*           0 = Bitmap preparado.
+*          -1 = Error al reservar memoria (el bitmap anterior se conserva).
+*
+************************************************/
+int SACK_prepareMap(PacketMap *map, int n_packets, int data_size);
+
+/***********************************************
+*
+* @Finalidad: Liberar la memoria de un bitmap y dejarlo vacío.
+*
+* @Parámetros:
+* in/out: map = Bitmap a liberar.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void SACK_freeMap(PacketMap *map);
+
+/***********************************************
+*
+* @Finalidad: Consultar si un paquete está marcado como recibido.
+*
+* @Parámetros:
+* in: map = Bitmap de paquetes.
+* in: packet = Índice del paquete.
+*
+* @Retorno:
+*           1 = El paquete está recibido.
+*           0 = El paquete no está recibido o está fuera del bitmap.
+*
+************************************************/
+int SACK_isReceived(const PacketMap *map, int packet);
+
+/***********************************************
+*
+* @Finalidad: Marcar un paquete como recibido.
+*
+* @Parámetros:
+* in/out: map = Bitmap de paquetes.
+* in: packet = Índice del paquete.
+*
+* @Retorno:
+*           1 = El paquete no estaba marcado.
+*           0 = El paquete ya estaba marcado o está fuera del bitmap.
+*
+************************************************/
+int SACK_markReceived(PacketMap *map, int packet);
+
+/***********************************************
+*
+* @Finalidad: Desmarcar un tramo de paquetes que estaban recibidos, para que se vuelvan a
+*             pedir (e.g., los de un bloque que no coincide con su hash).
+*
+* @Parámetros:
+* in/out: map = Bitmap de paquetes.
+* in: first = Primer paquete del tramo.
+* in: count = Número de paquetes del tramo.
+*
+* @Retorno: Número de paquetes que estaban marcados y se han desmarcado.
+*
+************************************************/
+int SACK_markMissing(PacketMap *map, int first, int count);
+
+/***********************************************
+*
+* @Finalidad: Contar los paquetes consecutivos sin recibir a partir de uno dado, para
+*             leerlos del fichero y enviarlos en un solo lote.
+*
+* @Parámetros:
+* in: map = Bitmap de paquetes.
+* in: first = Primer paquete del hueco.
+* in: max_packets = Máximo de paquetes a contar.
+*
+* @Retorno: Número de paquetes sin recibir consecutivos desde `first` (como mucho `max_packets`).
+*
+************************************************/
+int SACK_countMissing(const PacketMap *map, int first, int max_packets);
+
+/***********************************************
+*
+* @Finalidad: Codificar un ACK selectivo: el primer paquete no recibido (todos los
+*             anteriores lo están) seguido del bitmap de los paquetes a partir de este,
+*             truncado a lo que quepa en el buffer.
+*
+* @Parámetros:
+* in: map = Bitmap de paquetes recibidos.
+* out: buffer = Buffer donde se escribirá el ACK.
+* in: capacity = Tamaño del buffer (como mínimo `SACK_ACK_HEADER_SIZE`).
+*
+* @Retorno: Número de bytes escritos en `buffer` (0 si no cabe la cabecera).
+*
+************************************************/
+size_t SACK_encodeAck(const PacketMap *map, uint8_t *buffer, size_t capacity);
+
+/***********************************************
+*
+* @Finalidad: Marcar en el bitmap del emisor los paquetes que confirma un ACK selectivo.
+*
+* @Parámetros:
+* in/out: map = Bitmap de paquetes confirmados por el receptor.
+* in: data = Datos del ACK.
+* in: length = Número de bytes de `data`.
+* in: limit = Los paquetes nuevos con índice menor que `limit` se cuentan en el retorno
+*             (e.g., los que el emisor ya ha enviado y tiene en vuelo).
+*
+* @Retorno:
+*           >= 0 = Paquetes confirmados por primera vez con índice menor que `limit`.
+*           -1 = ACK malformado.
+*
+************************************************/
+int SACK_applyAck(PacketMap *map, const uint8_t *data, size_t length, int limit);
+
+/***********************************************
+*
+* @Finalidad: Resumir un bitmap en tramos de paquetes recibidos para guardarlo en memoria
+*             compartida. Si hay más tramos de los que caben, los últimos se descartan y
+*             esos paquetes se volverán a pedir.
+*
+* @Parámetros:
+* in: map = Bitmap de paquetes.
+* out: ranges = Tramos resultantes.
+* in: max_ranges = Número máximo de tramos de `ranges`.
+*
+* @Retorno: Número de tramos escritos en `ranges`.
+*
+************************************************/
+int SACK_toRanges(const PacketMap *map, DistortionRange *ranges, int max_ranges);
+
+/***********************************************
+*
+* @Finalidad: Reconstruir un bitmap a partir de los tramos guardados con `SACK_toRanges`.
+*
+* @Parámetros:
+* out: map = Bitmap a reconstruir. Se libera el contenido anterior.
+* in: n_packets = Número de paquetes del fichero con los que se guardaron los tramos.
+* in: data_size = Tamaño de paquete con el que se guardaron los tramos.
+* in: ranges = Tramos de paquetes recibidos.
+* in: n_ranges = Número de tramos de `ranges`.
+*
+* @Retorno:
+*           0 = Bitmap reconstruido.
+*          -1 = Error al reservar memoria.
+*
+************************************************/
+int SACK_fromRanges(PacketMap *map, int n_packets, int data_size, const DistortionRange *ranges, int n_ranges);
+
+/***********************************************
+*
+* @Finalidad: Calcular la franja `stripe` de un fichero repartido en `n_stripes` franjas
+*             de paquetes consecutivos, lo más iguales posible, que se envían por
+*             conexiones paralelas.
+*
+* @Parámetros:
+* in: n_packets = Número de paquetes del fichero.
+* in: n_stripes = Número de franjas.
+* in: stripe = Índice de la franja (de 0 a `n_stripes` - 1).
+* out: range = Primer paquete y número de paquetes de la franja, sin ninguno recibido.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void SACK_getStripe(int n_packets, int n_stripes, int stripe, DistortionStripe *range);
+
+/***********************************************
+*
+* @Finalidad: Marcar como recibidos todos los paquetes de fuera de una franja, de modo
+*             que una transferencia con este bitmap solo trata los paquetes de la franja.
+*
+* @Parámetros:
+* in/out: map = Bitmap de paquetes preparado para el fichero entero.
+* in: range = Franja que queda sin marcar.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void SACK_markOutsideStripe(PacketMap *map, const DistortionStripe *range);
+
+/***********************************************
+*
+* @Finalidad: Preparar el bitmap propio de una franja a partir del bitmap del fichero:
+*             los paquetes de la franja que ya se tienen y todos los de fuera quedan
+*             marcados. Cada conexión paralela escribe en su bitmap sin compartirlo.
+*
+* @Parámetros:
+* out: map = Bitmap de la franja. No se libera el contenido anterior.
+* in: received = Bitmap de paquetes recibidos del fichero entero.
+* in: range = Franja de la conexión.
+*
+* @Retorno:
+*           0 = Bitmap preparado.
+*          -1 = Error al reservar memoria.
+*
+************************************************/
+int SACK_prepareStripeMap(PacketMap *map, const PacketMap *received, const DistortionStripe *range);
+
+/***********************************************
+*
+* @Finalidad: Pasar al bitmap del fichero los paquetes de una franja recibidos por su
+*             conexión y anotar cuántos paquetes consecutivos de la franja se tienen.
+*
+* @Parámetros:
+* in/out: received = Bitmap de paquetes recibidos del fichero entero.
+* in: map = Bitmap de la franja (preparado con `SACK_prepareStripeMap`).
+* in/out: range = Franja de la conexión. Se actualiza su número de paquetes recibidos.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void SACK_mergeStripe(PacketMap *received, const PacketMap *map, DistortionStripe *range);
+
+#endif // _SACK_CUSTOM_H_
@@ -0,0 +1,259 @@
+/***********************************************
+*
+* @Autores: Alexandre Contreras, Armand López.
+*
+* @Finalidad: Implementar el reparto del ancho de banda de entrada y de salida de un
+*             worker entre los usuarios que transfieren ficheros, con una cubeta de
+*             fichas por usuario y sentido.
+*
+* @Fecha de creación: 16 de octubre de 2026.
+*
+* @Última modificación: 16 de octubre de 2026.
+*
+************************************************/
+
+#include "shaper.h"
+
+#include <stdio.h>     // sscanf
+
+/***********************************************
+*
+* @Finalidad: Calcular los segundos entre dos instantes.
+*
+* @Parámetros:
+* in: from = Instante inicial.
+* in: to = Instante final.
+*
+* @Retorno: Segundos transcurridos.
+*
+************************************************/
+static double SHAPER_elapsed(const struct timespec* from, const struct timespec* to) {
+    return (to->tv_sec - from->tv_sec) + (to->tv_nsec - from->tv_nsec) / 1000000000.0;
+}
+
+/***********************************************
+*
+* @Finalidad: Buscar el peso configurado de un usuario.
+*
+* @Parámetros:
+* in: config = Límites configurados, o NULL.
+* in: username = Nombre del usuario.
+*
+* @Retorno: Peso del usuario (`SHAPER_DEFAULT_WEIGHT` si no tiene línea `share`).
+*
+************************************************/
+static int SHAPER_findWeight(const ShaperConfig* config, const char* username) {
+    for (int i = 0; config && i < config->n_shares; i++) {
+        if (strcmp(config->shares[i].username, username) == 0) return config->shares[i].weight;
+    }
+    return SHAPER_DEFAULT_WEIGHT;
+}
+
+/***********************************************
+*
+* @Finalidad: Preparar el reparto del ancho de banda de un worker a partir de su
+*             configuración.
+*
+* @Parámetros:
+* out: shaper = Reparto a preparar.
+* in: config = Límites configurados. Debe existir mientras se use el reparto.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void SHAPER_init(Shaper* shaper, const ShaperConfig* config) {
+    pthread_mutex_init(&shaper->mutex, NULL);
+    for (int direction = 0; direction < SHAPER_DIRECTIONS; direction++) {
+        shaper->rates[direction] = config ? config->rates[direction] : 0;
+    }
+    shaper->config = config;
+    shaper->users = NULL;
+    shaper->n_users = 0;
+}
+
+/***********************************************
+*
+* @Finalidad: Liberar los usuarios de un reparto.
+*
+* @Parámetros:
+* in/out: shaper = Reparto a liberar.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void SHAPER_destroy(Shaper* shaper) {
+    for (int i = 0; i < shaper->n_users; i++) {
+        free(shaper->users[i]->username);
+        free(shaper->users[i]);
+    }
+    free(shaper->users);
+    shaper->users = NULL;
+    shaper->n_users = 0;
+    pthread_mutex_destroy(&shaper->mutex);
+}
+
+/***********************************************
+*
+* @Finalidad: Liberar las líneas `share` de una configuración y dejarla sin límites.
+*
+* @Parámetros:
+* in/out: config = Configuración a liberar.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void SHAPER_freeConfig(ShaperConfig* config) {
+    for (int i = 0; i < config->n_shares; i++) {
+        free(config->shares[i].username);
+    }
+    free(config->shares);
+    config->shares = NULL;
+    config->n_shares = 0;
+    for (int direction = 0; direction < SHAPER_DIRECTIONS; direction++) {
+        config->rates[direction] = 0;
+    }
+}
+
+/***********************************************
+*
+* @Finalidad: Leer una línea opcional de límites de la configuración del worker:
+*             `ingress <MB/s>`, `egress <MB/s>` o `share <usuario> <peso>`.
+*
+* @Parámetros:
+* in/out: config = Configuración a la que se añade el límite.
+* in: line = Línea del fichero de configuración.
+*
+* @Retorno:
+*           1 = La línea era un límite y se ha añadido.
+*           0 = La línea no es un límite (se ignora).
+*          -1 = Error de memoria.
+*
+************************************************/
+int SHAPER_parseConfigLine(ShaperConfig* config, const char* line) {
+    double megabytes;
+    char username[256];
+    int weight;
+
+    if (sscanf(line, "ingress %lf", &megabytes) == 1 && megabytes >= 0) {
+        config->rates[SHAPER_INGRESS] = megabytes * 1024 * 1024;
+        return 1;
+    }
+    if (sscanf(line, "egress %lf", &megabytes) == 1 && megabytes >= 0) {
+        config->rates[SHAPER_EGRESS] = megabytes * 1024 * 1024;
+        return 1;
+    }
+    if (sscanf(line, "share %255s %d", username, &weight) == 2 && weight > 0) {
+        ShaperShare* shares = realloc(config->shares, (config->n_shares + 1) * sizeof(ShaperShare));
+        if (!shares) return -1;
+        config->shares = shares;
+        config->shares[config->n_shares].username = strdup(username);
+        if (!config->shares[config->n_shares].username) return -1;
+        config->shares[config->n_shares++].weight = weight;
+        return 1;
+    }
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalidad: Obtener la parte del presupuesto de un usuario, creándola la primera vez
+*             que se conecta. Todas las conexiones del usuario comparten la misma.
+*
+* @Parámetros:
+* in/out: shaper = Reparto del worker.
+* in: username = Nombre del usuario.
+*
+* @Retorno:
+*           Parte del usuario.
+*           NULL si el worker no tiene límites o si falla la memoria (sin límite).
+*
+************************************************/
+ShaperUser* SHAPER_getUser(Shaper* shaper, const char* username) {
+    if (!shaper || !username || (shaper->rates[SHAPER_INGRESS] <= 0 && shaper->rates[SHAPER_EGRESS] <= 0)) return NULL;
+
+    pthread_mutex_lock(&shaper->mutex);
+    for (int i = 0; i < shaper->n_users; i++) {
+        if (strcmp(shaper->users[i]->username, username) == 0) {
+            pthread_mutex_unlock(&shaper->mutex);
+            return shaper->users[i];
+        }
+    }
+
+    ShaperUser* user = NULL;
+    ShaperUser** users = realloc(shaper->users, (shaper->n_users + 1) * sizeof(ShaperUser*));
+    if (users) {
+        shaper->users = users;
+        user = calloc(1, sizeof(ShaperUser));
+    }
+    if (user) user->username = strdup(username);
+    if (user && !user->username) {
+        free(user);
+        user = NULL;
+    }
+    if (user) {
+        user->weight = SHAPER_findWeight(shaper->config, username);
+        user->shaper = shaper;
+        shaper->users[shaper->n_users++] = user;
+    }
+    pthread_mutex_unlock(&shaper->mutex);
+    return user;
+}
+
+/***********************************************
+*
+* @Finalidad: Gastar las fichas de los bytes que se van a transferir y esperar, si hace
+*             falta, hasta que la cubeta del usuario las haya recuperado. Cada usuario
+*             recibe fichas a la parte del presupuesto global que le corresponde según su
+*             peso y los pesos de los usuarios que están transfiriendo en ese sentido, y
+*             un usuario inactivo acumula unas cuantas para transferir un fichero pequeño
+*             sin esperar.
+*
+* @Parámetros:
+* in/out: user = Parte del usuario, o NULL (sin límite, no espera).
+* in: direction = Sentido de la transferencia (`SHAPER_INGRESS` o `SHAPER_EGRESS`).
+* in: bytes = Bytes que se van a transferir.
+* in: exit = Bandera que interrumpe la espera.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void SHAPER_acquire(ShaperUser* user, int direction, size_t bytes, volatile int* exit) {
+    if (!user || user->shaper->rates[direction] <= 0) return;
+    Shaper* shaper = user->shaper;
+    ShaperBucket* bucket = &user->buckets[direction];
+    struct timespec now;
+
+    pthread_mutex_lock(&shaper->mutex);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    // El pressupost es reparteix entre els usuaris que han transferit en aquest sentit fa poc, segons el seu pes
+    int active_weight = user->weight;
+    for (int i = 0; i < shaper->n_users; i++) {
+        const ShaperBucket* other = &shaper->users[i]->buckets[direction];
+        if (shaper->users[i] != user && other->used && SHAPER_elapsed(&other->last_use, &now) * 1000 < SHAPER_IDLE_MS) active_weight += shaper->users[i]->weight;
+    }
+    double rate = shaper->rates[direction] * user->weight / active_weight;
+    double burst = rate * SHAPER_BURST_SECONDS > SHAPER_MIN_BURST ? rate * SHAPER_BURST_SECONDS : SHAPER_MIN_BURST;
+
+    // Afegim les fitxes del temps transcorregut (un usuari que comença té la cubeta plena) i gastem les d'aquests bytes, encara que quedi en deute
+    if (!bucket->used) {
+        bucket->tokens = burst;
+        bucket->used = 1;
+    } else {
+        bucket->tokens += rate * SHAPER_elapsed(&bucket->refill, &now);
+        if (bucket->tokens > burst) bucket->tokens = burst;
+    }
+    bucket->refill = now;
+    bucket->last_use = now;
+    bucket->tokens -= (double)bytes;
+    double wait = bucket->tokens < 0 ? -bucket->tokens / rate : 0;
+    pthread_mutex_unlock(&shaper->mutex);
+
+    // Esperem a trams curts per sortir de seguida si s'interromp el programa
+    while (wait > 0 && !(exit && *exit)) {
+        double slice = wait * 1000 > SHAPER_MAX_SLEEP_MS ? SHAPER_MAX_SLEEP_MS / 1000.0 : wait;
+        struct timespec sleep_time = {(time_t)slice, (long)((slice - (time_t)slice) * 1000000000.0)};
+        nanosleep(&sleep_time, NULL);
+        wait -= slice;
+    }
+}
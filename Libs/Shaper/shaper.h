@@ -0,0 +1,166 @@
+/***********************************************
+*
+* @Autores: Alexandre Contreras y Armand López
+* @Propósito: Limitar el ancho de banda que un worker dedica a recibir y a enviar
+*             ficheros con cubetas de fichas (token bucket): un presupuesto global de
+*             entrada y otro de salida que se reparte entre los usuarios que están
+*             transfiriendo según su peso, de modo que un fleck con un fichero enorme no
+*             deja sin ancho de banda a los demás y los ficheros pequeños salen enseguida.
+* @Fecha de creación: 16 de octubre de 2026
+* @Última modificación: 16 de octubre de 2026
+*
+************************************************/
+
+#ifndef _SHAPER_CUSTOM_H_
+#define _SHAPER_CUSTOM_H_
+
+//Constant del sistema
+#define _GNU_SOURCE
+
+//Libreries del sistema
+#include <stdlib.h>    // malloc, realloc, free
+#include <string.h>    // strcmp, strdup
+#include <stddef.h>    // size_t
+#include <pthread.h>   // pthread_mutex_t
+#include <time.h>      // clock_gettime, nanosleep, CLOCK_MONOTONIC
+
+//Constants
+#define SHAPER_INGRESS 0                  // Bytes que rep el worker (els fitxers originals dels flecks)
+#define SHAPER_EGRESS 1                   // Bytes que envia el worker (els fitxers distorsionats)
+#define SHAPER_DIRECTIONS 2
+#define SHAPER_DEFAULT_WEIGHT 1           // Pes dels usuaris sense línia `share` a la configuració
+#define SHAPER_BURST_SECONDS 0.25         // Fitxes que acumula un usuari inactiu, en segons de la seva part (el que un fitxer petit envia sense esperar)
+#define SHAPER_MIN_BURST (1024 * 1024)    // Fitxes mínimes acumulables, perquè hi càpiga una trama v2 sencera
+#define SHAPER_IDLE_MS 200                // Un usuari que fa aquest temps que no transfereix deixa de comptar en el repartiment
+#define SHAPER_MAX_SLEEP_MS 50            // Espera màxima d'un tram, per atendre de seguida la sortida del programa
+#define SHAPER_EMPTY_CONFIG {{0, 0}, NULL, 0}   // Inicialitzador d'una configuració sense límits
+
+typedef struct {
+    char* username;
+    int weight;                 // Part relativa del pressupost (SHAPER_DEFAULT_WEIGHT si no es configura)
+} ShaperShare;                  // Línia `share <usuari> <pes>` de la configuració
+
+typedef struct {
+    double rates[SHAPER_DIRECTIONS];    // Pressupost global de cada sentit en bytes per segon (0 = sense límit)
+    ShaperShare* shares;
+    int n_shares;
+} ShaperConfig;                 // Límits d'amplada de banda configurats al worker
+
+typedef struct {
+    double tokens;              // Bytes que es poden transferir sense esperar (negatiu = deute que s'ha d'esperar)
+    struct timespec refill;     // Última vegada que s'hi han afegit fitxes
+    struct timespec last_use;   // Última transferència (per saber si l'usuari és actiu)
+    int used;                   // 1 si alguna vegada ha transferit en aquest sentit
+} ShaperBucket;                 // Cubeta de fitxes d'un usuari en un sentit
+
+typedef struct Shaper Shaper;
+
+typedef struct ShaperUser {
+    char* username;
+    int weight;
+    ShaperBucket buckets[SHAPER_DIRECTIONS];
+    Shaper* shaper;
+} ShaperUser;                   // Part del pressupost d'un usuari, compartida per totes les seves connexions
+
+struct Shaper {
+    pthread_mutex_t mutex;      // Protegeix les cubetes i la llista d'usuaris
+    double rates[SHAPER_DIRECTIONS];
+    const ShaperConfig* config; // Pesos configurats
+    ShaperUser** users;         // Usuaris que s'han connectat alguna vegada (no es mouen de memòria)
+    int n_users;
+};                              // Repartiment de l'amplada de banda d'un worker
+
+//Funcions
+
+/***********************************************
+*
+* @Finalidad: Preparar el reparto del ancho de banda de un worker a partir de su
+*             configuración.
+*
+* @Parámetros:
+* out: shaper = Reparto a preparar.
+* in: config = Límites configurados. Debe existir mientras se use el reparto.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void SHAPER_init(Shaper* shaper, const ShaperConfig* config);
+
+/***********************************************
+*
+* @Finalidad: Liberar los usuarios de un reparto.
+*
+* @Parámetros:
+* in/out: shaper = Reparto a liberar.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void SHAPER_destroy(Shaper* shaper);
+
+/***********************************************
+*
+* @Finalidad: Liberar las líneas `share` de una configuración y dejarla sin límites.
+*
+* @Parámetros:
+* in/out: config = Configuración a liberar.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void SHAPER_freeConfig(ShaperConfig* config);
+
+/***********************************************
+*
+* @Finalidad: Leer una línea opcional de límites de la configuración del worker:
+*             `ingress <MB/s>`, `egress <MB/s>` o `share <usuario> <peso>`.
+*
+* @Parámetros:
+* in/out: config = Configuración a la que se añade el límite.
+* in: line = Línea del fichero de configuración.
+*
+* @Retorno:
+*           1 = La línea era un límite y se ha añadido.
+*           0 = La línea no es un límite (se ignora).
+*          -1 = Error de memoria.
+*
+************************************************/
+int SHAPER_parseConfigLine(ShaperConfig* config, const char* line);
+
+/***********************************************
+*
+* @Finalidad: Obtener la parte del presupuesto de un usuario, creándola la primera vez
+*             que se conecta. Todas las conexiones del usuario comparten la misma.
+*
+* @Parámetros:
+* in/out: shaper = Reparto del worker.
+* in: username = Nombre del usuario.
+*
+* @Retorno:
+*           Parte del usuario.
+*           NULL si el worker no tiene límites o si falla la memoria (sin límite).
+*
+************************************************/
+ShaperUser* SHAPER_getUser(Shaper* shaper, const char* username);
+
+/***********************************************
+*
+* @Finalidad: Gastar las fichas de los bytes que se van a transferir y esperar, si hace
+*             falta, hasta que la cubeta del usuario las haya recuperado. Cada usuario
+*             recibe fichas a la parte del presupuesto global que le corresponde según su
+*             peso y los pesos de los usuarios que están transfiriendo en ese sentido, y
+*             un usuario inactivo acumula unas cuantas para transferir un fichero pequeño
+*             sin esperar.
+*
+* @Parámetros:
+* in/out: user = Parte del usuario, o NULL (sin límite, no espera).
+* in: direction = Sentido de la transferencia (`SHAPER_INGRESS` o `SHAPER_EGRESS`).
+* in: bytes = Bytes que se van a transferir.
+* in: exit = Bandera que interrumpe la espera.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void SHAPER_acquire(ShaperUser* user, int direction, size_t bytes, volatile int* exit);
+
+#endif // _SHAPER_CUSTOM_H_
@@ -0,0 +1,427 @@
+/***********************************************
+*
+* @Autores: Alexandre Contreras, Armand López.
+*
+* @Finalidad: Implementar el anillo de memoria compartida de un solo productor y un solo
+*             consumidor por el que pasan los datos de los ficheros entre dos procesos de
+*             la misma máquina, con las esperas sobre futex compartidos.
+*
+* @Fecha de creación: 16 de octubre de 2026.
+*
+* @Última modificación: 16 de octubre de 2026.
+*
+************************************************/
+
+#include "shm.h"
+
+#define SHM_MAGIC 0x4D524A52            // "MRJR": identifica un segment que és un anell
+#define SHM_NAME_PREFIX "/mrj-ring-"    // Prefix dels noms dels segments (només s'obren segments amb aquest prefix)
+#define SHM_RECORD_ALIGN 64             // Els registres comencen a una línia de memòria cau
+#define SHM_RECORD_DATA 1               // Registre amb dades d'un paquet del fitxer
+#define SHM_RECORD_WRAP 2               // Final de l'anell sense registre: el següent és al principi
+#define SHM_SPIN_LOOPS 2000             // Voltes que es mira la posició de l'altre extrem abans d'adormir-se (uns microsegons: el que triga a publicar un registre)
+#define SHM_ALIGN(bytes) (((uint64_t)(bytes) + SHM_RECORD_ALIGN - 1) & ~(uint64_t)(SHM_RECORD_ALIGN - 1))
+
+struct ShmHeader {
+    uint32_t magic;
+    uint32_t closed;                                        // 1 = algun extrem ha tancat l'anell
+    uint64_t capacity;                                      // Bytes de dades darrere de la capçalera
+    uint64_t head __attribute__((aligned(64)));             // Bytes publicats pel productor des de l'inici (només l'escriu ell)
+    uint32_t data_signal;                                   // Futex on dorm el consumidor sense dades
+    uint32_t consumer_waiting;                              // 1 = el consumidor dorm o està a punt de dormir
+    uint64_t tail __attribute__((aligned(64)));             // Bytes alliberats pel consumidor des de l'inici (només l'escriu ell)
+    uint32_t space_signal;                                  // Futex on dorm el productor sense espai
+    uint32_t producer_waiting;                              // 1 = el productor dorm o està a punt de dormir
+} __attribute__((aligned(64)));                             // Cada posició en una línia de memòria cau pròpia, perquè els extrems no se la disputin
+
+typedef struct {
+    uint64_t offset;        // Posició de les dades al fitxer
+    uint32_t length;        // Bytes de dades darrere del registre
+    uint32_t type;          // SHM_RECORD_*
+} ShmRecord;                // Capçalera de cada registre de l'anell
+
+static uint32_t ring_counter = 0;      // Anells creats pel procés (per fer únic el nom del segment)
+static int spin_loops = -1;            // Voltes d'espera activa (0 amb una sola CPU, on l'altre extrem no pot avançar mentre aquest espera; -1 = per calcular)
+
+/***********************************************
+*
+* @Finalidad: Calcular el instante en que se agota una espera.
+*
+* @Parámetros:
+* out: deadline = Instante límite (reloj monotónico).
+* in: timeout_ms = Milisegundos de espera.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+static void SHM_setDeadline(struct timespec *deadline, int timeout_ms) {
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    deadline->tv_sec += timeout_ms / 1000;
+    deadline->tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline->tv_nsec >= 1000000000L) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000L;
+    }
+}
+
+/***********************************************
+*
+* @Finalidad: Dormir en un futex del anillo hasta que el otro extremo mueva su posición,
+*             cierre el anillo o se agote la espera. Antes de dormir se anuncia la espera y
+*             se vuelve a mirar la posición, de modo que una publicación que llega entre
+*             la comprobación y el futex no se pierde. Antes se espera activamente unos 
+*             microsegundos, que suele ser lo que tarda el otro extremo en publicar.
+*
+* @Parámetros:
+* in/out: ring = Anillo abierto.
+* in/out: signal = Futex en el que se duerme.
+* in/out: waiting = Indicador de espera de este extremo.
+* in: position = Posición del otro extremo.
+* in: seen = Valor de `position` que se ha visto por última vez.
+* in: deadline = Instante en que se agota la espera.
+*
+* @Retorno:
+*           1 = Se debe volver a mirar la posición.
+*           0 = La espera se ha agotado.
+*
+************************************************/
+static int SHM_wait(ShmRing *ring, uint32_t *signal, uint32_t *waiting, const uint64_t *position, uint64_t seen, const struct timespec *deadline) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long remaining_ns = (deadline->tv_sec - now.tv_sec) * 1000000000L + (deadline->tv_nsec - now.tv_nsec);
+    if (remaining_ns <= 0) return 0;
+
+    // L'altre extrem sol publicar al cap de poc: una espera activa curta estalvia el futex als dos extrems
+    if (spin_loops < 0) spin_loops = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? SHM_SPIN_LOOPS : 0;
+    for (int spin = 0; spin < spin_loops; spin++) {
+        if (__atomic_load_n(position, __ATOMIC_ACQUIRE) != seen || __atomic_load_n(&ring->header->closed, __ATOMIC_ACQUIRE)) return 1;
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+
+    uint32_t value = __atomic_load_n(signal, __ATOMIC_ACQUIRE);
+    __atomic_store_n(waiting, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(position, __ATOMIC_SEQ_CST) == seen && !__atomic_load_n(&ring->header->closed, __ATOMIC_SEQ_CST)) {
+        // El futex no és privat: l'altre extrem és un altre procés que té el segment projectat a una altra adreça
+        struct timespec timeout = {remaining_ns / 1000000000L, remaining_ns % 1000000000L};
+        ring->waits++;
+        syscall(SYS_futex, signal, FUTEX_WAIT, value, &timeout, NULL, 0);
+    }
+    __atomic_store_n(waiting, 0, __ATOMIC_RELAXED);
+    return 1;
+}
+
+/***********************************************
+*
+* @Finalidad: Despertar al otro extremo si está esperando en un futex del anillo. Si no
+*             espera, o ya se le ha despertado y aún no ha vuelto a dormirse, no se hace 
+*             ninguna llamada al sistema.
+*
+* @Parámetros:
+* in/out: ring = Anillo abierto.
+* in/out: signal = Futex en el que duerme el otro extremo.
+* in/out: waiting = Indicador de espera del otro extremo. Se baja al despertarlo.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+static void SHM_signal(ShmRing *ring, uint32_t *signal, uint32_t *waiting) {
+    // Qui desperta baixa l'indicador: fins que l'altre extrem no torni a anunciar una espera, les publicacions següents no fan cap crida
+    if (__atomic_exchange_n(waiting, 0, __ATOMIC_SEQ_CST)) {
+        __atomic_add_fetch(signal, 1, __ATOMIC_RELEASE);
+        syscall(SYS_futex, signal, FUTEX_WAKE, 1, NULL, NULL, 0);
+        ring->wakeups++;
+    }
+}
+
+/***********************************************
+*
+* @Finalidad: Crear un segmento de memoria compartida con un nombre único, darle el tamaño
+*             de la cabecera más `capacity` bytes de datos y proyectarlo como productor del
+*             anillo. El segmento sigue enlazado hasta que el consumidor lo abre (o hasta
+*             `SHM_destroyRing`), de modo que no queda ninguno en `/dev/shm` al acabar.
+*
+* @Parámetros:
+* out: ring = Anillo creado.
+* in: capacity = Bytes de datos que se quieren (se redondea a una potencia de 2, como
+*                mínimo `SHM_MIN_CAPACITY`).
+*
+* @Retorno:
+*           0 = Anillo creado; su nombre está en `ring->name`.
+*          -1 = No se ha podido crear o proyectar el segmento (e.g., sin `/dev/shm`).
+*
+************************************************/
+int SHM_createRing(ShmRing *ring, uint64_t capacity) {
+    ShmRing empty = SHM_EMPTY_RING;
+    *ring = empty;
+
+    uint64_t size = SHM_MIN_CAPACITY;
+    while (size < capacity) size <<= 1;
+    snprintf(ring->name, sizeof(ring->name), SHM_NAME_PREFIX "%d-%u", (int)getpid(), __atomic_add_fetch(&ring_counter, 1, __ATOMIC_RELAXED));
+
+    int fd = shm_open(ring->name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) return -1;
+    ring->owner = 1;
+
+    // El segment es crea ple de zeros (posicions a 0 i anell obert); les pàgines es reserven ara per no fallar-hi durant la transferència
+    size_t map_size = sizeof(struct ShmHeader) + size;
+    void *mapped = MAP_FAILED;
+    if (ftruncate(fd, (off_t)map_size) == 0) mapped = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        SHM_destroyRing(ring);
+        return -1;
+    }
+
+    ring->header = (struct ShmHeader *)mapped;
+    ring->data = (uint8_t *)mapped + sizeof(struct ShmHeader);
+    ring->capacity = size;
+    ring->map_size = map_size;
+    ring->header->capacity = size;
+    __atomic_store_n(&ring->header->magic, SHM_MAGIC, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalidad: Abrir como consumidor el anillo que ha creado el otro extremo, comprobar su
+*             cabecera y borrar su nombre, para que el segmento desaparezca cuando los dos
+*             extremos lo dejen de proyectar aunque alguno caiga.
+*
+* @Parámetros:
+* out: ring = Anillo abierto.
+* in: name = Nombre del segmento que ha enviado el productor.
+*
+* @Retorno:
+*           0 = Anillo abierto.
+*          -1 = El segmento no existe (e.g., el otro extremo está en otra máquina o en
+*               otro contenedor), no se puede proyectar o no es un anillo.
+*
+************************************************/
+int SHM_attachRing(ShmRing *ring, const char *name) {
+    ShmRing empty = SHM_EMPTY_RING;
+    *ring = empty;
+
+    // Només s'obren segments d'anell, amb el nom sencer dins del buffer
+    if (strncmp(name, SHM_NAME_PREFIX, strlen(SHM_NAME_PREFIX)) != 0 || strlen(name) >= SHM_NAME_SIZE || strchr(name + 1, '/') != NULL) return -1;
+
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) return -1;
+    struct stat segment;
+    if (fstat(fd, &segment) < 0 || segment.st_size <= (off_t)sizeof(struct ShmHeader)) {
+        close(fd);
+        return -1;
+    }
+    size_t map_size = (size_t)segment.st_size;
+    void *mapped = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) return -1;
+
+    struct ShmHeader *header = (struct ShmHeader *)mapped;
+    uint64_t capacity = header->capacity;
+    if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != SHM_MAGIC || capacity < SHM_MIN_CAPACITY || (capacity & (capacity - 1)) != 0 || sizeof(struct ShmHeader) + capacity != map_size) {
+        munmap(mapped, map_size);
+        return -1;
+    }
+
+    // Un cop projectat pels dos extrems el nom ja no cal
+    shm_unlink(name);
+    ring->header = header;
+    ring->data = (uint8_t *)mapped + sizeof(struct ShmHeader);
+    ring->capacity = capacity;
+    ring->map_size = map_size;
+    ring->position = __atomic_load_n(&header->tail, __ATOMIC_ACQUIRE);
+    snprintf(ring->name, sizeof(ring->name), "%s", name);
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalidad: Reservar en el anillo un registro para `length` bytes de datos, esperando
+*             como mucho `timeout_ms` a que el consumidor libere espacio. Si el registro no
+*             cabe antes del final del anillo, se salta el trozo que queda y empieza al
+*             principio. Los datos se escriben directamente en el puntero devuelto y el
+*             registro se publica con `SHM_commit`.
+*
+* @Parámetros:
+* in/out: ring = Anillo abierto como productor.
+* in: length = Bytes de datos del registro.
+* in: timeout_ms = Milisegundos que se espera espacio como mucho.
+* out: data = Donde se deben escribir los datos del registro.
+*
+* @Retorno:
+*           1 = Registro reservado.
+*           0 = Aún no hay espacio (se ha agotado la espera).
+*          -1 = El consumidor ha cerrado el anillo o el registro no cabe en él.
+*
+************************************************/
+int SHM_reserve(ShmRing *ring, uint32_t length, int timeout_ms, uint8_t **data) {
+    struct ShmHeader *header = ring->header;
+    uint64_t size = SHM_ALIGN(sizeof(ShmRecord) + (uint64_t)length);
+    if (size > ring->capacity / 2) return -1;
+
+    // Un registre no es parteix mai: si no cap fins al final de l'anell, el tros que queda se salta
+    uint64_t index = ring->position & (ring->capacity - 1);
+    uint64_t skip = ring->capacity - index < size ? ring->capacity - index : 0;
+
+    struct timespec deadline;
+    SHM_setDeadline(&deadline, timeout_ms);
+    for (;;) {
+        if (__atomic_load_n(&header->closed, __ATOMIC_ACQUIRE)) return -1;
+        uint64_t tail = __atomic_load_n(&header->tail, __ATOMIC_ACQUIRE);
+        if (ring->capacity - (ring->position - tail) >= skip + size) break;
+        if (!SHM_wait(ring, &header->space_signal, &header->producer_waiting, &header->tail, tail, &deadline)) return 0;
+    }
+
+    if (skip > 0) {
+        ShmRecord *wrap = (ShmRecord *)(ring->data + index);
+        wrap->offset = 0;
+        wrap->length = 0;
+        wrap->type = SHM_RECORD_WRAP;
+        ring->position += skip;
+    }
+    ring->record_size = size;
+    *data = ring->data + (ring->position & (ring->capacity - 1)) + sizeof(ShmRecord);
+    return 1;
+}
+
+/***********************************************
+*
+* @Finalidad: Publicar el registro reservado con `SHM_reserve` con la posición de sus
+*             datos en el fichero y despertar al consumidor si está esperando.
+*
+* @Parámetros:
+* in/out: ring = Anillo abierto como productor con un registro reservado.
+* in: offset = Posición de los datos del registro en el fichero.
+* in: length = Bytes de datos escritos (como mucho los reservados).
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void SHM_commit(ShmRing *ring, uint64_t offset, uint32_t length) {
+    ShmRecord *record = (ShmRecord *)(ring->data + (ring->position & (ring->capacity - 1)));
+    record->offset = offset;
+    record->length = length;
+    record->type = SHM_RECORD_DATA;
+
+    // La publicació de la posició fa visibles les dades i la capçalera del registre al consumidor
+    ring->position += ring->record_size;
+    ring->record_size = 0;
+    __atomic_store_n(&ring->header->head, ring->position, __ATOMIC_SEQ_CST);
+    SHM_signal(ring, &ring->header->data_signal, &ring->header->consumer_waiting);
+}
+
+/***********************************************
+*
+* @Finalidad: Obtener el siguiente registro del anillo sin sacarlo, esperando como mucho
+*             `timeout_ms` a que el productor publique alguno. Los datos siguen en el
+*             anillo hasta `SHM_release`, de modo que se copian una sola vez al fichero.
+*
+* @Parámetros:
+* in/out: ring = Anillo abierto como consumidor.
+* in: timeout_ms = Milisegundos que se esperan datos como mucho.
+* out: offset = Posición de los datos del registro en el fichero.
+* out: data = Datos del registro dentro del anillo.
+* out: length = Bytes de datos del registro.
+*
+* @Retorno:
+*           1 = Hay un registro.
+*           0 = Aún no hay ninguno (se ha agotado la espera).
+*          -1 = El productor ha cerrado el anillo y ya se han leído todos sus registros.
+*
+************************************************/
+int SHM_peek(ShmRing *ring, int timeout_ms, uint64_t *offset, const uint8_t **data, uint32_t *length) {
+    struct ShmHeader *header = ring->header;
+    struct timespec deadline;
+    SHM_setDeadline(&deadline, timeout_ms);
+
+    for (;;) {
+        uint64_t head = __atomic_load_n(&header->head, __ATOMIC_ACQUIRE);
+        if (head != ring->position) {
+            uint64_t index = ring->position & (ring->capacity - 1);
+            const ShmRecord *record = (const ShmRecord *)(ring->data + index);
+            if (record->type == SHM_RECORD_WRAP) {
+                ring->position += ring->capacity - index;
+                __atomic_store_n(&header->tail, ring->position, __ATOMIC_SEQ_CST);
+                SHM_signal(ring, &header->space_signal, &header->producer_waiting);
+                continue;
+            }
+
+            // El registre l'ha escrit l'altre procés: si no és a dins de l'anell i del que s'ha publicat, es tracta com un tancament
+            uint64_t size = SHM_ALIGN(sizeof(ShmRecord) + (uint64_t)record->length);
+            if (record->type != SHM_RECORD_DATA || size > ring->capacity - index || size > head - ring->position) return -1;
+            *offset = record->offset;
+            *length = record->length;
+            *data = (const uint8_t *)(record + 1);
+            ring->record_size = size;
+            return 1;
+        }
+        if (__atomic_load_n(&header->closed, __ATOMIC_ACQUIRE)) {
+            // El productor publica abans de tancar: si ara hi ha registres, encara s'han de llegir
+            if (__atomic_load_n(&header->head, __ATOMIC_ACQUIRE) != ring->position) continue;
+            return -1;
+        }
+        if (!SHM_wait(ring, &header->data_signal, &header->consumer_waiting, &header->head, head, &deadline)) return 0;
+    }
+}
+
+/***********************************************
+*
+* @Finalidad: Liberar el registro obtenido con `SHM_peek` y despertar al productor si
+*             está esperando espacio.
+*
+* @Parámetros:
+* in/out: ring = Anillo abierto como consumidor con un registro leído.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void SHM_release(ShmRing *ring) {
+    ring->position += ring->record_size;
+    ring->record_size = 0;
+    __atomic_store_n(&ring->header->tail, ring->position, __ATOMIC_SEQ_CST);
+    SHM_signal(ring, &ring->header->space_signal, &ring->header->producer_waiting);
+}
+
+/***********************************************
+*
+* @Finalidad: Cerrar el anillo y despertar al otro extremo. Lo cierra el productor cuando
+*             ya ha publicado todos los registros, o cualquiera de los dos para abandonar
+*             la transferencia.
+*
+* @Parámetros:
+* in/out: ring = Anillo abierto.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void SHM_close(ShmRing *ring) {
+    if (!ring->header) return;
+
+    __atomic_store_n(&ring->header->closed, 1, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&ring->header->data_signal, 1, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&ring->header->space_signal, 1, __ATOMIC_RELEASE);
+    syscall(SYS_futex, &ring->header->data_signal, FUTEX_WAKE, 1, NULL, NULL, 0);
+    syscall(SYS_futex, &ring->header->space_signal, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+/***********************************************
+*
+* @Finalidad: Dejar de proyectar el anillo y, si lo ha creado este extremo y el otro no
+*             lo ha llegado a abrir, borrar su segmento.
+*
+* @Parámetros:
+* in/out: ring = Anillo a destruir (puede estar vacío). Queda como `SHM_EMPTY_RING`.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void SHM_destroyRing(ShmRing *ring) {
+    // Si el consumidor ja l'ha obert el nom no existeix (ENOENT), i si no l'ha obert el segment s'esborra aquí
+    if (ring->owner) shm_unlink(ring->name);
+    if (ring->header) munmap(ring->header, ring->map_size);
+
+    ShmRing empty = SHM_EMPTY_RING;
+    *ring = empty;
+}
@@ -0,0 +1,195 @@
+/***********************************************
+*
+* @Autores: Alexandre Contreras y Armand López
+* @Propósito: Proveer un anillo de memoria compartida de un solo productor y un solo
+*             consumidor por el que dos procesos de la misma máquina se pasan los datos
+*             de un fichero sin pasar por el socket. El anillo vive en un segmento POSIX
+*             (`shm_open`) que el emisor crea y el receptor abre por su nombre; las
+*             posiciones de escritura y lectura se publican con operaciones atómicas y el
+*             extremo que se queda sin datos o sin espacio duerme en un futex compartido.
+* @Fecha de creación: 16 de octubre de 2026
+* @Última modificación: 16 de octubre de 2026
+*
+************************************************/
+
+#ifndef _SHM_CUSTOM_H_
+#define _SHM_CUSTOM_H_
+
+// Constants del sistema
+#define _GNU_SOURCE
+
+//Libreries del sistema
+#include <stdint.h>         // uint8_t, uint32_t, uint64_t
+#include <stddef.h>         // size_t
+#include <stdio.h>          // snprintf
+#include <string.h>         // memset
+#include <errno.h>          // errno, EINTR, ETIMEDOUT
+#include <fcntl.h>          // O_RDWR, O_CREAT, O_EXCL
+#include <unistd.h>         // ftruncate, close, getpid, syscall, sysconf
+#include <time.h>           // clock_gettime, CLOCK_MONOTONIC, struct timespec
+#include <sys/mman.h>       // shm_open, shm_unlink, mmap, munmap
+#include <sys/stat.h>       // fstat
+#include <sys/syscall.h>    // SYS_futex
+#include <linux/futex.h>    // FUTEX_WAIT, FUTEX_WAKE
+
+//Constants
+#define SHM_DEFAULT_CAPACITY (8 * 1024 * 1024)   // Bytes de dades de l'anell d'una transferència (com a mínim dos paquets d'1 MiB, el màxim d'una trama v2)
+#define SHM_MIN_CAPACITY (64 * 1024)             // Capacitat mínima (la capacitat s'arrodoneix a una potència de 2)
+#define SHM_NAME_SIZE 64                         // Bytes del nom del segment, acabat en '\0'
+
+//Tipus propis
+struct ShmHeader;                       // Capçalera de l'anell dins del segment (posicions, futex i tancament), definida a shm.c
+
+typedef struct {
+    struct ShmHeader *header;           // Capçalera a l'inici del segment projectat (NULL si l'anell no està obert)
+    uint8_t *data;                      // Dades de l'anell, darrere de la capçalera
+    uint64_t capacity;                  // Bytes de dades (potència de 2)
+    size_t map_size;                    // Mida de la projecció del segment
+    uint64_t position;                  // Productor: on s'escriurà el següent registre. Consumidor: on comença el registre que s'està llegint
+    uint64_t record_size;               // Bytes que ocupa a l'anell el registre reservat o llegit (0 si no n'hi ha cap)
+    int owner;                          // 1 = aquest extrem ha creat el segment i l'ha d'esborrar si l'altre no ho ha fet
+    char name[SHM_NAME_SIZE];           // Nom del segment (el que s'envia a l'altre extrem)
+    unsigned long waits;                // Vegades que aquest extrem s'ha adormit al futex
+    unsigned long wakeups;              // Vegades que aquest extrem ha despertat l'altre
+} ShmRing;                              // Extrem d'un anell, només l'utilitza el thread que l'ha obert
+
+#define SHM_EMPTY_RING {NULL, NULL, 0, 0, 0, 0, 0, "", 0, 0}   // Inicialitzador d'un anell sense segment
+
+//Funcions
+
+/***********************************************
+*
+* @Finalidad: Crear un segmento de memoria compartida con un nombre único, darle el tamaño
+*             de la cabecera más `capacity` bytes de datos y proyectarlo como productor del
+*             anillo. El segmento sigue enlazado hasta que el consumidor lo abre (o hasta
+*             `SHM_destroyRing`), de modo que no queda ninguno en `/dev/shm` al acabar.
+*
+* @Parámetros:
+* out: ring = Anillo creado.
+* in: capacity = Bytes de datos que se quieren (se redondea a una potencia de 2, como
+*                mínimo `SHM_MIN_CAPACITY`).
+*
+* @Retorno:
+*           0 = Anillo creado; su nombre está en `ring->name`.
+*          -1 = No se ha podido crear o proyectar el segmento (e.g., sin `/dev/shm`).
+*
+************************************************/
+int SHM_createRing(ShmRing *ring, uint64_t capacity);
+
+/***********************************************
+*
+* @Finalidad: Abrir como consumidor el anillo que ha creado el otro extremo, comprobar su
+*             cabecera y borrar su nombre, para que el segmento desaparezca cuando los dos
+*             extremos lo dejen de proyectar aunque alguno caiga.
+*
+* @Parámetros:
+* out: ring = Anillo abierto.
+* in: name = Nombre del segmento que ha enviado el productor.
+*
+* @Retorno:
+*           0 = Anillo abierto.
+*          -1 = El segmento no existe (e.g., el otro extremo está en otra máquina o en
+*               otro contenedor), no se puede proyectar o no es un anillo.
+*
+************************************************/
+int SHM_attachRing(ShmRing *ring, const char *name);
+
+/***********************************************
+*
+* @Finalidad: Reservar en el anillo un registro para `length` bytes de datos, esperando
+*             como mucho `timeout_ms` a que el consumidor libere espacio. Si el registro no
+*             cabe antes del final del anillo, se salta el trozo que queda y empieza al
+*             principio. Los datos se escriben directamente en el puntero devuelto y el
+*             registro se publica con `SHM_commit`.
+*
+* @Parámetros:
+* in/out: ring = Anillo abierto como productor.
+* in: length = Bytes de datos del registro.
+* in: timeout_ms = Milisegundos que se espera espacio como mucho.
+* out: data = Donde se deben escribir los datos del registro.
+*
+* @Retorno:
+*           1 = Registro reservado.
+*           0 = Aún no hay espacio (se ha agotado la espera).
+*          -1 = El consumidor ha cerrado el anillo o el registro no cabe en él.
+*
+************************************************/
+int SHM_reserve(ShmRing *ring, uint32_t length, int timeout_ms, uint8_t **data);
+
+/***********************************************
+*
+* @Finalidad: Publicar el registro reservado con `SHM_reserve` con la posición de sus
+*             datos en el fichero y despertar al consumidor si está esperando.
+*
+* @Parámetros:
+* in/out: ring = Anillo abierto como productor con un registro reservado.
+* in: offset = Posición de los datos del registro en el fichero.
+* in: length = Bytes de datos escritos (como mucho los reservados).
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void SHM_commit(ShmRing *ring, uint64_t offset, uint32_t length);
+
+/***********************************************
+*
+* @Finalidad: Obtener el siguiente registro del anillo sin sacarlo, esperando como mucho
+*             `timeout_ms` a que el productor publique alguno. Los datos siguen en el
+*             anillo hasta `SHM_release`, de modo que se copian una sola vez al fichero.
+*
+* @Parámetros:
+* in/out: ring = Anillo abierto como consumidor.
+* in: timeout_ms = Milisegundos que se esperan datos como mucho.
+* out: offset = Posición de los datos del registro en el fichero.
+* out: data = Datos del registro dentro del anillo.
+* out: length = Bytes de datos del registro.
+*
+* @Retorno:
+*           1 = Hay un registro.
+*           0 = Aún no hay ninguno (se ha agotado la espera).
+*          -1 = El productor ha cerrado el anillo y ya se han leído todos sus registros.
+*
+************************************************/
+int SHM_peek(ShmRing *ring, int timeout_ms, uint64_t *offset, const uint8_t **data, uint32_t *length);
+
+/***********************************************
+*
+* @Finalidad: Liberar el registro obtenido con `SHM_peek` y despertar al productor si
+*             está esperando espacio.
+*
+* @Parámetros:
+* in/out: ring = Anillo abierto como consumidor con un registro leído.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void SHM_release(ShmRing *ring);
+
+/***********************************************
+*
+* @Finalidad: Cerrar el anillo y despertar al otro extremo. Lo cierra el productor cuando
+*             ya ha publicado todos los registros, o cualquiera de los dos para abandonar
+*             la transferencia.
+*
+* @Parámetros:
+* in/out: ring = Anillo abierto.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void SHM_close(ShmRing *ring);
+
+/***********************************************
+*
+* @Finalidad: Dejar de proyectar el anillo y, si lo ha creado este extremo y el otro no
+*             lo ha llegado a abrir, borrar su segmento.
+*
+* @Parámetros:
+* in/out: ring = Anillo a destruir (puede estar vacío). Queda como `SHM_EMPTY_RING`.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+void SHM_destroyRing(ShmRing *ring);
+
+#endif // _SHM_CUSTOM_H_
@@ -3,17 +3,42 @@
 * @Autores: Alexandre Contreras, Armand López.
 * 
 * @Finalidad: Implementar funciones para la gestión de sockets en aplicaciones cliente-servidor, 
-*             incluyendo la creación de sockets de escucha y cliente, y operaciones seguras 
-*             como aceptar conexiones con `select`.
+*             incluyendo la creación de sockets de escucha y cliente, operaciones seguras 
+*             como aceptar conexiones con `select` y el ajuste de las opciones TCP de cada 
+*             conexión según la configuración.
 * 
 * @Fecha de creación: 11 de noviembre de 2024.
 * 
-* @Última modificación: 4 de enero de 2025.
+* @Última modificación: 16 de octubre de 2026.
 * 
 ************************************************/
 
 #include "socket.h"
 
+// Opcions TCP del procés (les fixa SOCKET_configure en carregar la configuració)
+static SocketOptions socket_options = SOCKET_DEFAULT_OPTIONS;
+// Buffers màxims que l'autoajust del nucli pot assolir per si sol (tercer valor de net.ipv4.tcp_wmem i tcp_rmem)
+static int autotune_send_max = 4 * 1024 * 1024;
+static int autotune_receive_max = 6 * 1024 * 1024;
+
+/*********************************************** 
+* 
+* @Finalidad: Fijar el tamaño de los buffers de envío y recepción de un socket. Los fallos 
+*             se ignoran: el socket se queda con los buffers del autoajuste. 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket. 
+* in: send_bytes = Bytes del buffer de envío (0 = no se cambia). 
+* in: receive_bytes = Bytes del buffer de recepción (0 = no se cambia). 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+static void SOCKET_setBuffers(int socket, int send_bytes, int receive_bytes) {
+    if (send_bytes > 0) setsockopt(socket, SOL_SOCKET, SO_SNDBUF, &send_bytes, sizeof(send_bytes));
+    if (receive_bytes > 0) setsockopt(socket, SOL_SOCKET, SO_RCVBUF, &receive_bytes, sizeof(receive_bytes));
+}
+
 /*********************************************** 
 * 
 * @Finalidad: Inicializar un socket en modo escucha, enlazándolo a una dirección IP y un puerto específicos, 
@@ -39,6 +64,9 @@ int SOCKET_initListenSocket(const char* ip, int port, int max_clients) {
         return -1; 
     }
 
+    // Els buffers fixos es posen abans del bind perquè el factor d'escala de la finestra que s'anuncia en el SYN hi compti (les connexions acceptades els hereten)
+    SOCKET_setBuffers(listen_socket, socket_options.buffer_bytes, socket_options.buffer_bytes);
+
     addr.sin_family = AF_INET;
     addr.sin_port = htons(port);
     addr.sin_addr.s_addr = inet_addr(ip);
@@ -55,55 +83,334 @@ int SOCKET_initListenSocket(const char* ip, int port, int max_clients) {
         return -1; 
     }
 
+    // Amb Fast Open un client que ja s'ha connectat abans envia la primera trama dins del SYN (si net.ipv4.tcp_fastopen no ho permet, s'ignora)
+    if (socket_options.fastopen) {
+        int queue = SOCKET_FASTOPEN_QUEUE;
+        setsockopt(listen_socket, IPPROTO_TCP, TCP_FASTOPEN, &queue, sizeof(queue));
+    }
+
     return listen_socket;
 }
 
 /*********************************************** 
 * 
-* @Finalidad: Crear e inicializar un socket cliente para conectarse a un servidor 
-*             en una dirección IP y puerto específicos. 
+* @Finalidad: Obtener el tiempo del reloj monotónico en milisegundos, para medir los 
+*             plazos de conexión. 
+* 
+* @Parámetros: Ninguno. 
+* 
+* @Retorno: Milisegundos desde un origen arbitrario. 
+* 
+************************************************/
+static long long SOCKET_nowMs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Crear un socket cliente y empezar a conectarlo con un destino. 
 * 
 * @Parámetros: 
-* in: ip = Dirección IP del servidor al que se conectará el cliente. 
-* in: port = Puerto del servidor al que se conectará el cliente. 
+* in: endpoint = Destino de la conexión. 
+* in: blocking = 1 si `connect` debe esperar a que la conexión se establezca; 0 si el 
+*                socket es no bloqueante y la conexión puede quedar en curso. 
+* out: connected = 1 si la conexión ya está establecida; 0 si está en curso. 
 * 
 * @Retorno: 
-*           Descriptor del socket del cliente si la conexión es exitosa. 
-*          -1 = Error al crear, configurar o establecer la conexión con el servidor. 
+*           Descriptor del socket (conectado o conectándose). 
+*          -1 = Error al crear el socket, dirección inválida o conexión rechazada. 
 * 
 ************************************************/
-int SOCKET_initClientSocket(const char* ip, int port) {
-    int client_socket;
+static int SOCKET_startConnect(const SocketEndpoint* endpoint, int blocking, int* connected) {
     struct sockaddr_in server_addr;
 
-    //crea el socket
-    client_socket = socket(AF_INET, SOCK_STREAM, 0);
-    if (client_socket < 0) {
-        IO_printStatic(STDOUT_FILENO, RED "Error creating client socket. Exiting...\n" RESET);
-        return -1;
-    }
-
     //configura l'adreça del servidor
     memset(&server_addr, 0, sizeof(server_addr));
     server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(port);
+    server_addr.sin_port = htons(endpoint->port);
 
     //converteix l'adreça IP a format binari
-    if (inet_pton(AF_INET, ip, &server_addr.sin_addr) <= 0) {
-        //IO_printStatic(STDOUT_FILENO, RED "Invalid IP address. Exiting...\n" RESET);
-        close(client_socket);
+    if (inet_pton(AF_INET, endpoint->ip, &server_addr.sin_addr) <= 0) {
         return -1;
     }
 
-    //estableix la connexió
-    if (connect(client_socket, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
-        close(client_socket);
+    //crea el socket
+    int client_socket = socket(AF_INET, SOCK_STREAM, 0);
+    if (client_socket < 0) {
+        IO_printStatic(STDOUT_FILENO, RED "Error creating client socket. Exiting...\n" RESET);
         return -1;
     }
 
+    // Opcions que s'han de posar abans de connectar: els buffers fixos (per a l'escala de la finestra) i Fast Open, que amb una galeta del servidor envia la primera trama dins del SYN
+    SOCKET_setBuffers(client_socket, socket_options.buffer_bytes, socket_options.buffer_bytes);
+    if (blocking && socket_options.fastopen) {
+        int enable = 1;
+        setsockopt(client_socket, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, &enable, sizeof(enable));
+    }
+    if (!blocking) fcntl(client_socket, F_SETFL, fcntl(client_socket, F_GETFL) | O_NONBLOCK);
+
+    //estableix la connexió
+    if (connect(client_socket, (struct sockaddr *)&server_addr, sizeof(server_addr)) == 0) {
+        *connected = 1;
+        return client_socket;
+    }
+    if (!blocking && errno == EINPROGRESS) {
+        *connected = 0;
+        return client_socket;
+    }
+
+    close(client_socket);
+    return -1;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Comprobar el resultado de una conexión no bloqueante que `poll` indica que 
+*             ha terminado. 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket. 
+* 
+* @Retorno: 
+*           0 = Conexión establecida. 
+*          -1 = Conexión rechazada o fallida. 
+* 
+************************************************/
+static int SOCKET_finishConnect(int socket) {
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (getsockopt(socket, SOL_SOCKET, SO_ERROR, &error, &length) < 0 || error != 0) return -1;
+    return 0;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Crear e inicializar un socket cliente para conectarse a un servidor 
+*             en una dirección IP y puerto específicos, dentro del plazo configurado. 
+* 
+* @Parámetros: 
+* in: ip = Dirección IP del servidor al que se conectará el cliente. 
+* in: port = Puerto del servidor al que se conectará el cliente. 
+* 
+* @Retorno: 
+*           Descriptor del socket del cliente si la conexión es exitosa. 
+*          -1 = Error al crear, configurar o establecer la conexión con el servidor. 
+* 
+************************************************/
+int SOCKET_initClientSocket(const char* ip, int port) {
+    SocketEndpoint endpoint;
+    if (SOCKET_setEndpoint(&endpoint, ip, port) < 0) return -1;
+
+    return SOCKET_raceConnect(&endpoint, 1, NULL);
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Conectar con el primero de varios destinos que responda, dentro del plazo 
+*             configurado. Los intentos empiezan en orden y escalonados: el siguiente 
+*             destino se prueba cuando el anterior lleva `connect_stagger_ms` sin responder 
+*             o en cuanto lo rechaza, y los intentos siguen en paralelo hasta que uno se 
+*             establece. Los demás se cierran. 
+* 
+* @Parámetros: 
+* in: endpoints = Destinos en orden de preferencia. 
+* in: n_endpoints = Número de destinos (como mucho `SOCKET_MAX_ENDPOINTS`). 
+* out: winner = Índice del destino conectado. 
+* 
+* @Retorno: 
+*           Descriptor del socket conectado (bloqueante). 
+*          -1 = Ningún destino ha respondido dentro del plazo. 
+* 
+************************************************/
+static int SOCKET_raceEndpoints(const SocketEndpoint* endpoints, int n_endpoints, int* winner) {
+    struct pollfd attempts[SOCKET_MAX_ENDPOINTS];
+    int chosen = -1;
+    int connected = 0;
+    int started = 0;
+    int in_flight = 0;
+    long long now = SOCKET_nowMs();
+    long long deadline = now + socket_options.connect_timeout_ms;
+    long long next_start = now;
+
+    while (chosen < 0 && now < deadline) {
+        // El destí següent comença quan l'anterior fa massa que no respon o quan ja no en queda cap en curs
+        if (started < n_endpoints && (now >= next_start || in_flight == 0)) {
+            attempts[started].fd = SOCKET_startConnect(&endpoints[started], 0, &connected);
+            attempts[started].events = POLLOUT;
+            attempts[started].revents = 0;
+            if (attempts[started].fd >= 0 && connected) chosen = started;
+            else if (attempts[started].fd >= 0) in_flight++;
+            started++;
+            next_start = now + socket_options.connect_stagger_ms;
+            continue;
+        }
+        if (in_flight == 0) break;      // Tots els destins han rebutjat la connexió
+
+        long long wake = (started < n_endpoints && next_start < deadline) ? next_start : deadline;
+        int ready = poll(attempts, (nfds_t)started, (int)(wake - now));
+        if (ready < 0 && errno != EINTR) break;
+
+        for (int i = 0; ready > 0 && i < started && chosen < 0; i++) {
+            if (attempts[i].fd < 0 || attempts[i].revents == 0) continue;
+            if (SOCKET_finishConnect(attempts[i].fd) == 0) {
+                chosen = i;
+            } else {
+                // Un destí que rebutja la connexió deixa pas al següent immediatament
+                close(attempts[i].fd);
+                attempts[i].fd = -1;
+                in_flight--;
+                next_start = now;
+            }
+        }
+        now = SOCKET_nowMs();
+    }
+
+    // Es tanquen els intents que han perdut la cursa
+    for (int i = 0; i < started; i++) {
+        if (i != chosen && attempts[i].fd >= 0) close(attempts[i].fd);
+    }
+    if (chosen < 0) return -1;
+
+    *winner = chosen;
+    fcntl(attempts[chosen].fd, F_SETFL, fcntl(attempts[chosen].fd, F_GETFL) & ~O_NONBLOCK);
+    return attempts[chosen].fd;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Conectar con el primer destino o, si no responde, con uno de los 
+*             alternativos, dentro del plazo configurado. El primero se intenta solo y 
+*             con todo el plazo: los alternativos (e.g., workers en espera, que ya escuchan 
+*             aunque no atiendan) solo se prueban si el primero rechaza la conexión o agota 
+*             el plazo, y entonces se intentan escalonados (el siguiente cuando el anterior 
+*             lleva `connect_stagger_ms` sin responder o en cuanto lo rechaza) con un plazo 
+*             nuevo. Sin plazo configurado, los destinos se prueban uno tras otro con 
+*             `connect` bloqueante. 
+* 
+* @Parámetros: 
+* in: endpoints = Destinos en orden de preferencia. 
+* in: n_endpoints = Número de destinos (como mucho `SOCKET_MAX_ENDPOINTS`). 
+* out: winner = Índice del destino conectado, o NULL si no interesa. 
+* 
+* @Retorno: 
+*           Descriptor del socket conectado (bloqueante y con las opciones TCP aplicadas). 
+*          -1 = Ningún destino ha respondido dentro del plazo. 
+* 
+************************************************/
+int SOCKET_raceConnect(const SocketEndpoint* endpoints, int n_endpoints, int* winner) {
+    int client_socket = -1;
+    int chosen = -1;
+    int connected = 0;
+    if (n_endpoints > SOCKET_MAX_ENDPOINTS) n_endpoints = SOCKET_MAX_ENDPOINTS;
+
+    if (socket_options.connect_timeout_ms <= 0) {
+        // Sense termini, connect bloquejant destí per destí
+        for (int i = 0; i < n_endpoints && chosen < 0; i++) {
+            client_socket = SOCKET_startConnect(&endpoints[i], 1, &connected);
+            if (client_socket >= 0) chosen = i;
+        }
+    } else if (n_endpoints > 0) {
+        // El primer destí no competeix amb els alternatius: un d'aquests podria guanyar-li la cursa sense estar preparat per atendre'ns
+        client_socket = SOCKET_raceEndpoints(endpoints, 1, &chosen);
+        if (client_socket < 0 && n_endpoints > 1) {
+            client_socket = SOCKET_raceEndpoints(endpoints + 1, n_endpoints - 1, &chosen);
+            chosen++;
+        }
+    }
+
+    if (client_socket < 0) return -1;
+    if (winner) *winner = chosen;
+    SOCKET_tuneConnection(client_socket);
     return client_socket;
 }
 
+/*********************************************** 
+* 
+* @Finalidad: Esperar a que llegue la primera respuesta de un destino recién conectado, 
+*             como mucho el plazo de conexión configurado. Un proceso que escucha pero no 
+*             atiende la conexión (e.g., un worker en espera) la acepta igualmente y, sin 
+*             este plazo, dejaría bloqueado a quien espera su respuesta. 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket recién conectado. 
+* 
+* @Retorno: 
+*           0 = Hay datos para leer (o no hay plazo configurado). 
+*          -1 = El destino no ha respondido dentro del plazo. 
+* 
+************************************************/
+int SOCKET_waitForReply(int socket) {
+    if (socket_options.connect_timeout_ms <= 0) return 0;
+
+    struct pollfd reply = {socket, POLLIN, 0};
+    long long deadline = SOCKET_nowMs() + socket_options.connect_timeout_ms;
+    long long now = SOCKET_nowMs();
+    while (now < deadline) {
+        int ready = poll(&reply, 1, (int)(deadline - now));
+        if (ready > 0) return 0;
+        if (ready < 0 && errno != EINTR) return -1;
+        now = SOCKET_nowMs();
+    }
+    return -1;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Preparar un destino de conexión a partir de su dirección IP y su puerto. 
+* 
+* @Parámetros: 
+* out: endpoint = Destino. 
+* in: ip = Dirección IPv4 en texto. 
+* in: port = Puerto. 
+* 
+* @Retorno: 
+*           0 = Destino preparado. 
+*          -1 = La dirección no cabe o el puerto no es válido. 
+* 
+************************************************/
+int SOCKET_setEndpoint(SocketEndpoint* endpoint, const char* ip, int port) {
+    if (!ip || strlen(ip) >= sizeof(endpoint->ip) || port <= 0 || port > 65535) return -1;
+
+    strcpy(endpoint->ip, ip);
+    endpoint->port = port;
+    return 0;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Leer una lista de destinos en texto (`ip:puerto` separados por comas), como 
+*             la de los workers alternativos que envía Gotham. Las entradas mal formadas 
+*             se saltan. 
+* 
+* @Parámetros: 
+* in: list = Lista en texto, o NULL. 
+* out: endpoints = Destinos leídos. 
+* in: max_endpoints = Número máximo de destinos que caben en `endpoints`. 
+* 
+* @Retorno: Número de destinos leídos. 
+* 
+************************************************/
+int SOCKET_parseEndpoints(const char* list, SocketEndpoint* endpoints, int max_endpoints) {
+    int n_endpoints = 0;
+    char ip[INET_ADDRSTRLEN];
+
+    while (list && *list != '\0' && n_endpoints < max_endpoints) {
+        const char *separator = strchr(list, ',');
+        size_t length = separator ? (size_t)(separator - list) : strlen(list);
+        const char *colon = memchr(list, ':', length);
+
+        if (colon && (size_t)(colon - list) < sizeof(ip)) {
+            memcpy(ip, list, (size_t)(colon - list));
+            ip[colon - list] = '\0';
+            if (SOCKET_setEndpoint(&endpoints[n_endpoints], ip, atoi(colon + 1)) == 0) n_endpoints++;
+        }
+        list = separator ? separator + 1 : list + length;
+    }
+    return n_endpoints;
+}
+
 /*********************************************** 
 * 
 * @Finalidad: Cerrar un socket abierto y establecer su descriptor a `-1` para indicar 
@@ -154,9 +461,411 @@ int SOCKET_safe_accept(int listen_socket) {
     if (FD_ISSET(listen_socket, &read_fds)) {
         // The socket is ready to accept a connection
         int client_socket = accept(listen_socket, NULL, NULL);
+        if (client_socket >= 0) SOCKET_tuneConnection(client_socket);
 
         return client_socket;  // Return the accepted socket, even in case of errors.
     }
 
     return -1;  // This should never be reached if the socket is ready to accept
-}
\ No newline at end of file
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Comprobar si una dirección es de loopback (127.0.0.0/8 o ::1). 
+* 
+* @Parámetros: 
+* in: address = Dirección a comprobar. 
+* 
+* @Retorno: 
+*           1 = La dirección es de loopback. 
+*           0 = La dirección no es de loopback o su familia no es IPv4/IPv6. 
+* 
+************************************************/
+static int SOCKET_isLoopbackAddress(const struct sockaddr_storage *address) {
+    if (address->ss_family == AF_INET) {
+        const struct sockaddr_in *ipv4 = (const struct sockaddr_in *)address;
+        return (ntohl(ipv4->sin_addr.s_addr) >> 24) == 127;
+    }
+    if (address->ss_family == AF_INET6) {
+        const struct sockaddr_in6 *ipv6 = (const struct sockaddr_in6 *)address;
+        return IN6_IS_ADDR_LOOPBACK(&ipv6->sin6_addr);
+    }
+    return 0;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Comprobar si un socket conectado comunica dos extremos de la misma máquina 
+*             a través de la interfaz de loopback (127.0.0.0/8 o ::1). 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket conectado. 
+* 
+* @Retorno: 
+*           1 = Ambos extremos del socket son direcciones de loopback. 
+*           0 = Algún extremo no es de loopback o no se ha podido consultar. 
+* 
+************************************************/
+int SOCKET_isLoopback(int socket) {
+    struct sockaddr_storage local_address, peer_address;
+    socklen_t local_length = sizeof(local_address);
+    socklen_t peer_length = sizeof(peer_address);
+
+    if (getsockname(socket, (struct sockaddr *)&local_address, &local_length) < 0) return 0;
+    if (getpeername(socket, (struct sockaddr *)&peer_address, &peer_length) < 0) return 0;
+
+    return SOCKET_isLoopbackAddress(&local_address) && SOCKET_isLoopbackAddress(&peer_address);
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Comprobar si los dos extremos de un socket conectado están en esta máquina 
+*             (por loopback o porque la dirección local y la remota son la misma) y la 
+*             configuración permite pasar los datos de los ficheros por memoria compartida. 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket conectado. 
+* 
+* @Retorno: 
+*           1 = El otro extremo está en esta máquina y la memoria compartida está activada. 
+*           0 = Está en otra máquina, no se ha podido consultar o la configuración tiene 
+*               `shm off`. 
+* 
+************************************************/
+int SOCKET_canShareMemory(int socket) {
+    struct sockaddr_storage local_address, peer_address;
+    socklen_t local_length = sizeof(local_address);
+    socklen_t peer_length = sizeof(peer_address);
+
+    if (!socket_options.shared_memory) return 0;
+    if (getsockname(socket, (struct sockaddr *)&local_address, &local_length) < 0) return 0;
+    if (getpeername(socket, (struct sockaddr *)&peer_address, &peer_length) < 0) return 0;
+    if (SOCKET_isLoopbackAddress(&local_address) && SOCKET_isLoopbackAddress(&peer_address)) return 1;
+
+    // Connectar-se a una adreça pròpia que no és de loopback (e.g., la IP de la màquina a config.dat) també deixa els dos extrems amb la mateixa adreça
+    if (local_address.ss_family != peer_address.ss_family) return 0;
+    if (local_address.ss_family == AF_INET) {
+        return ((struct sockaddr_in *)&local_address)->sin_addr.s_addr == ((struct sockaddr_in *)&peer_address)->sin_addr.s_addr;
+    }
+    if (local_address.ss_family == AF_INET6) {
+        return IN6_ARE_ADDR_EQUAL(&((struct sockaddr_in6 *)&local_address)->sin6_addr, &((struct sockaddr_in6 *)&peer_address)->sin6_addr);
+    }
+    return 0;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Interpretar el valor `on` u `off` de una opción TCP. 
+* 
+* @Parámetros: 
+* in: value = Valor leído de la configuración. 
+* 
+* @Retorno: 
+*           1 = `on`. 
+*           0 = `off`. 
+*          -1 = Valor no válido. 
+* 
+************************************************/
+static int SOCKET_parseSwitch(const char* value) {
+    if (strcmp(value, "on") == 0) return 1;
+    if (strcmp(value, "off") == 0) return 0;
+    return -1;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Interpretar una línea opcional del fichero de configuración con una opción 
+*             TCP: `nodelay on|off`, `quickack on|off`, `buffer auto|<KB>`, `link <MB/s>`, 
+*             `keepalive <segundos> [<intervalo> <sondeos>]|off`, `fastopen on|off`, 
+*             `connect_timeout <ms>|off`, `connect_stagger <ms>`, `shm on|off` o 
+*             `multiplex on|off`. La línea se reconoce por su clave, sea cual sea su 
+*             posición en el fichero. 
+* 
+* @Parámetros: 
+* in/out: options = Opciones a las que se aplica la línea. 
+* in: line = Línea del fichero de configuración, sin el salto de línea. 
+* 
+* @Retorno: 
+*           1 = La línea era una opción TCP y se ha aplicado. 
+*           0 = La línea no es una opción TCP (o su valor no es válido). 
+* 
+************************************************/
+int SOCKET_parseConfigLine(SocketOptions* options, const char* line) {
+    char value[16];
+    double megabytes;
+    int idle, interval, count, milliseconds;
+
+    if (sscanf(line, "nodelay %15s", value) == 1 && SOCKET_parseSwitch(value) >= 0) {
+        options->nodelay = SOCKET_parseSwitch(value);
+        return 1;
+    }
+    if (sscanf(line, "quickack %15s", value) == 1 && SOCKET_parseSwitch(value) >= 0) {
+        options->quickack = SOCKET_parseSwitch(value);
+        return 1;
+    }
+    if (sscanf(line, "fastopen %15s", value) == 1 && SOCKET_parseSwitch(value) >= 0) {
+        options->fastopen = SOCKET_parseSwitch(value);
+        return 1;
+    }
+    if (sscanf(line, "shm %15s", value) == 1 && SOCKET_parseSwitch(value) >= 0) {
+        options->shared_memory = SOCKET_parseSwitch(value);
+        return 1;
+    }
+    if (sscanf(line, "multiplex %15s", value) == 1 && SOCKET_parseSwitch(value) >= 0) {
+        options->multiplex = SOCKET_parseSwitch(value);
+        return 1;
+    }
+    if (sscanf(line, "buffer %15s", value) == 1) {
+        if (strcmp(value, "auto") == 0) {
+            options->buffer_bytes = 0;
+            return 1;
+        }
+        int kilobytes = atoi(value);
+        if (kilobytes <= 0) return 0;
+        options->buffer_bytes = kilobytes > SOCKET_MAX_BUFFER / 1024 ? SOCKET_MAX_BUFFER : kilobytes * 1024;
+        return 1;
+    }
+    if (sscanf(line, "link %lf", &megabytes) == 1 && megabytes >= 0) {
+        options->link_rate = megabytes * 1024 * 1024;
+        return 1;
+    }
+    if (sscanf(line, "connect_timeout %15s", value) == 1) {
+        milliseconds = strcmp(value, "off") == 0 ? 0 : atoi(value);
+        if (milliseconds < 0 || (milliseconds == 0 && strcmp(value, "off") != 0)) return 0;
+        options->connect_timeout_ms = milliseconds;
+        return 1;
+    }
+    if (sscanf(line, "connect_stagger %d", &milliseconds) == 1 && milliseconds >= 0) {
+        options->connect_stagger_ms = milliseconds;
+        return 1;
+    }
+    if (sscanf(line, "keepalive %15s", value) == 1 && strcmp(value, "off") == 0) {
+        options->keepalive_idle = 0;
+        return 1;
+    }
+    int n_values = sscanf(line, "keepalive %d %d %d", &idle, &interval, &count);
+    if (n_values >= 1 && idle > 0) {
+        options->keepalive_idle = idle;
+        if (n_values == 3 && interval > 0 && count > 0) {
+            options->keepalive_interval = interval;
+            options->keepalive_count = count;
+        }
+        return 1;
+    }
+    return 0;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Leer el máximo que el autoajuste del núcleo puede dar a un buffer TCP, el 
+*             tercer valor de `/proc/sys/net/ipv4/tcp_wmem` o `tcp_rmem`. 
+* 
+* @Parámetros: 
+* in: path = Ruta del fichero de `/proc`. 
+* in: fallback = Valor que se devuelve si no se puede leer (el del núcleo por defecto). 
+* 
+* @Retorno: Bytes máximos del buffer. 
+* 
+************************************************/
+static int SOCKET_readAutotuneMax(const char* path, int fallback) {
+    char content[128];
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return fallback;
+
+    ssize_t length = read(fd, content, sizeof(content) - 1);
+    close(fd);
+    if (length <= 0) return fallback;
+    content[length] = '\0';
+
+    int maximum;
+    if (sscanf(content, "%*d %*d %d", &maximum) != 1 || maximum <= 0) return fallback;
+    return maximum;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Fijar las opciones TCP de todas las conexiones que el proceso cree o acepte a 
+*             partir de ahora. Se llama una sola vez al cargar la configuración, antes de 
+*             abrir ningún socket. 
+* 
+* @Parámetros: 
+* in: options = Opciones configuradas. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void SOCKET_configure(const SocketOptions* options) {
+    socket_options = *options;
+    autotune_send_max = SOCKET_readAutotuneMax("/proc/sys/net/ipv4/tcp_wmem", autotune_send_max);
+    autotune_receive_max = SOCKET_readAutotuneMax("/proc/sys/net/ipv4/tcp_rmem", autotune_receive_max);
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Describir unas opciones TCP en una línea para mostrarlas con la configuración. 
+* 
+* @Parámetros: 
+* in: options = Opciones a describir. 
+* out: buffer = Texto de la descripción, acabado en '\0'. 
+* in: size = Bytes de `buffer`. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void SOCKET_describeOptions(const SocketOptions* options, char* buffer, size_t size) {
+    char buffers[64], keepalive[64], connect[64];
+
+    if (options->buffer_bytes > 0) snprintf(buffers, sizeof(buffers), "%d KB", options->buffer_bytes / 1024);
+    else if (options->link_rate > 0) snprintf(buffers, sizeof(buffers), "BDP at %.1f MB/s", options->link_rate / (1024 * 1024));
+    else snprintf(buffers, sizeof(buffers), "auto");
+
+    if (options->keepalive_idle > 0) snprintf(keepalive, sizeof(keepalive), "%d s (every %d s, %d probes)", options->keepalive_idle, options->keepalive_interval, options->keepalive_count);
+    else snprintf(keepalive, sizeof(keepalive), "off");
+
+    if (options->connect_timeout_ms > 0) snprintf(connect, sizeof(connect), "%d ms (stagger %d ms)", options->connect_timeout_ms, options->connect_stagger_ms);
+    else snprintf(connect, sizeof(connect), "off");
+
+    snprintf(buffer, size, "nodelay %s, quickack %s, buffers %s, keepalive %s, fastopen %s, connect timeout %s, shared memory %s, multiplex %s",
+             options->nodelay ? "on" : "off", options->quickack ? "on" : "off", buffers, keepalive, options->fastopen ? "on" : "off", connect, options->shared_memory ? "on" : "off", options->multiplex ? "on" : "off");
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Aplicar las opciones TCP configuradas a una conexión recién establecida o 
+*             aceptada: Nagle, ACK inmediatos, keepalive y buffers según el BDP. Los fallos 
+*             se ignoran, porque la conexión funciona igual con las opciones por defecto. 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket conectado. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void SOCKET_tuneConnection(int socket) {
+    int enable = 1;
+
+    // Les trames de 256 bytes (ACK, handshakes, peticions) no s'han d'esperar a omplir un segment
+    if (socket_options.nodelay) setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+    SOCKET_rearmQuickAck(socket);
+
+    if (socket_options.keepalive_idle > 0) {
+        setsockopt(socket, SOL_SOCKET, SO_KEEPALIVE, &enable, sizeof(enable));
+        setsockopt(socket, IPPROTO_TCP, TCP_KEEPIDLE, &socket_options.keepalive_idle, sizeof(socket_options.keepalive_idle));
+        setsockopt(socket, IPPROTO_TCP, TCP_KEEPINTVL, &socket_options.keepalive_interval, sizeof(socket_options.keepalive_interval));
+        setsockopt(socket, IPPROTO_TCP, TCP_KEEPCNT, &socket_options.keepalive_count, sizeof(socket_options.keepalive_count));
+    }
+
+    SOCKET_sizeBuffers(socket);
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Dimensionar los buffers de envío y recepción de una conexión con el producto 
+*             ancho de banda por retardo, tomando el RTT que TCP ha medido hasta ahora. Solo 
+*             se fijan si superan lo que el autoajuste del núcleo ya alcanza por sí solo 
+*             (fijarlos lo desactiva), o si la configuración indica un tamaño fijo. 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket conectado. 
+* 
+* @Retorno: 
+*           > 0 = Bytes que se han pedido para cada buffer. 
+*           0 = Los buffers se dejan al autoajuste del núcleo. 
+* 
+************************************************/
+int SOCKET_sizeBuffers(int socket) {
+    if (socket_options.buffer_bytes > 0) {
+        SOCKET_setBuffers(socket, socket_options.buffer_bytes, socket_options.buffer_bytes);
+        return socket_options.buffer_bytes;
+    }
+    if (socket_options.link_rate <= 0) return 0;
+
+    struct tcp_info info;
+    socklen_t length = sizeof(info);
+    if (getsockopt(socket, IPPROTO_TCP, TCP_INFO, &info, &length) < 0 || info.tcpi_rtt == 0) return 0;
+
+    // BDP = amplada de banda x RTT: els bytes en vol que mantenen l'enllaç ple
+    double bdp = socket_options.link_rate * info.tcpi_rtt / 1000000.0;
+    double wanted = bdp * SOCKET_BDP_FACTOR;
+    if (wanted < SOCKET_MIN_BUFFER) wanted = SOCKET_MIN_BUFFER;
+    if (wanted > SOCKET_MAX_BUFFER) wanted = SOCKET_MAX_BUFFER;
+
+    int bytes = (int)wanted;
+    int send_bytes = bytes > autotune_send_max ? bytes : 0;
+    int receive_bytes = bytes > autotune_receive_max ? bytes : 0;
+    SOCKET_setBuffers(socket, send_bytes, receive_bytes);
+    return send_bytes > 0 || receive_bytes > 0 ? bytes : 0;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Volver a activar `TCP_QUICKACK` en una conexión, si está configurado. El 
+*             núcleo lo desactiva por su cuenta, por lo que el receptor de un fichero lo 
+*             rearma cada vez que confirma paquetes para que el ACK de TCP no se retrase. 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket conectado. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void SOCKET_rearmQuickAck(int socket) {
+    if (!socket_options.quickack) return;
+
+    int enable = 1;
+    setsockopt(socket, IPPROTO_TCP, TCP_QUICKACK, &enable, sizeof(enable));
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Tomar una instantánea del estado TCP de una conexión (`TCP_INFO`) y del 
+*             tamaño efectivo de sus buffers. 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket conectado. 
+* out: info = Estado de la conexión. 
+* 
+* @Retorno: 
+*           0 = Estado obtenido. 
+*          -1 = El socket no es TCP o no se ha podido consultar. 
+* 
+************************************************/
+int SOCKET_getInfo(int socket, SocketInfo* info) {
+    struct tcp_info tcp;
+    socklen_t length = sizeof(tcp);
+    memset(info, 0, sizeof(*info));
+    if (getsockopt(socket, IPPROTO_TCP, TCP_INFO, &tcp, &length) < 0) return -1;
+
+    info->rtt_ms = tcp.tcpi_rtt / 1000.0;
+    info->rtt_var_ms = tcp.tcpi_rttvar / 1000.0;
+    info->rcv_rtt_ms = tcp.tcpi_rcv_rtt / 1000.0;
+    info->cwnd = tcp.tcpi_snd_cwnd;
+    info->mss = tcp.tcpi_snd_mss;
+    info->unacked = tcp.tcpi_unacked;
+    info->total_retrans = tcp.tcpi_total_retrans;
+    info->rcv_space = tcp.tcpi_rcv_space;
+
+    length = sizeof(info->send_buffer);
+    getsockopt(socket, SOL_SOCKET, SO_SNDBUF, &info->send_buffer, &length);
+    length = sizeof(info->receive_buffer);
+    getsockopt(socket, SOL_SOCKET, SO_RCVBUF, &info->receive_buffer, &length);
+    return 0;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Describir el estado TCP de una conexión en una línea para los logs. 
+* 
+* @Parámetros: 
+* in: info = Estado obtenido con `SOCKET_getInfo`. 
+* out: buffer = Texto de la descripción, acabado en salto de línea y '\0'. 
+* in: size = Bytes de `buffer`. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void SOCKET_describeInfo(const SocketInfo* info, char* buffer, size_t size) {
+    snprintf(buffer, size, "TCP: RTT %.2f ms (var %.2f ms, receiver %.2f ms), cwnd %u segments of %u bytes, %u unacked, %u retransmitted, buffers: send %d KB, receive %d KB (window need %u KB)\n",
+             info->rtt_ms, info->rtt_var_ms, info->rcv_rtt_ms, info->cwnd, info->mss, info->unacked, info->total_retrans,
+             info->send_buffer / 1024, info->receive_buffer / 1024, info->rcv_space / 1024);
+}
@@ -1,9 +1,14 @@
 /*********************************************** 
 * 
 * @Autores: Alexandre Contreras y Armand López
-* @Propósito: Proveer funciones para la inicialización, manejo y cierre de sockets en sistemas distribuidos.
+* @Propósito: Proveer funciones para la inicialización, manejo y cierre de sockets en sistemas distribuidos,
+*             y ajustar las opciones TCP de cada conexión (Nagle, ACK retardados, buffers según
+*             el producto ancho de banda por retardo, keepalive y TCP Fast Open) según la
+*             configuración, además de consultar el estado TCP de una conexión para los logs.
+*             Las conexiones salientes tienen un plazo máximo y, si hay varios destinos
+*             posibles, se intentan escalonadamente y gana la primera que se establece.
 * @Fecha de creación: 15 de octubre de 2024
-* @Última modificación: 4 de enero de 2025
+* @Última modificación: 16 de octubre de 2026
 * 
 ************************************************/
 
@@ -16,10 +21,63 @@
 #include <sys/socket.h>   // socket, bind, listen, connect
 #include <netinet/in.h>   // struct sockaddr_in, htons
 #include <arpa/inet.h>    // inet_addr, inet_pton
+#include <netinet/tcp.h>  // TCP_NODELAY, TCP_QUICKACK, TCP_KEEPIDLE, TCP_FASTOPEN, TCP_INFO, struct tcp_info
+#include <fcntl.h>        // open, O_RDONLY, fcntl, O_NONBLOCK
+#include <stdio.h>        // sscanf, snprintf
+#include <poll.h>         // poll, struct pollfd
+#include <errno.h>        // errno, EINPROGRESS, EINTR
+#include <time.h>         // clock_gettime, CLOCK_MONOTONIC
 
 //Libreries pròpies
 #include "../IO/io.h"
 
+//Constants
+#define SOCKET_DEFAULT_KEEPALIVE_IDLE 60      // Segons sense trànsit abans del primer sondeig de keepalive
+#define SOCKET_DEFAULT_KEEPALIVE_INTERVAL 10  // Segons entre sondejos de keepalive
+#define SOCKET_DEFAULT_KEEPALIVE_COUNT 6      // Sondejos sense resposta abans de donar la connexió per morta
+#define SOCKET_MIN_BUFFER (64 * 1024)         // Buffer mínim que es fixa en dimensionar-lo pel BDP
+#define SOCKET_MAX_BUFFER (64 * 1024 * 1024)  // Buffer màxim que es demana (el nucli el retalla encara a net.core.*mem_max)
+#define SOCKET_BDP_FACTOR 2                   // Els buffers es fan d'aquest múltiple del BDP (un per les dades en vol i un de marge per a la cua)
+#define SOCKET_FASTOPEN_QUEUE 16              // Connexions Fast Open pendents que accepta un socket d'escolta
+#define SOCKET_DEFAULT_CONNECT_TIMEOUT 3000   // Mil·lisegons que s'espera com a màxim una connexió sortint (un host caigut no respon al SYN i el nucli trigaria uns dos minuts)
+#define SOCKET_DEFAULT_CONNECT_STAGGER 250    // Mil·lisegons que s'espera un destí abans de provar també el següent (com Happy Eyeballs)
+#define SOCKET_MAX_ENDPOINTS 8                // Destins que es poden intentar alhora en una connexió
+#define SOCKET_DESCRIPTION_SIZE 256           // Bytes dels buffers on es descriuen les opcions o l'estat TCP
+#define SOCKET_DEFAULT_OPTIONS {1, 1, 0, 0, SOCKET_DEFAULT_KEEPALIVE_IDLE, SOCKET_DEFAULT_KEEPALIVE_INTERVAL, SOCKET_DEFAULT_KEEPALIVE_COUNT, 1, SOCKET_DEFAULT_CONNECT_TIMEOUT, SOCKET_DEFAULT_CONNECT_STAGGER, 1, 0}   // Inicialitzador de les opcions per defecte
+
+typedef struct {
+    int nodelay;                // 1 = TCP_NODELAY (les trames petites, com els ACK, surten sense esperar Nagle)
+    int quickack;               // 1 = TCP_QUICKACK en connectar i cada vegada que el receptor envia un ACK
+    int buffer_bytes;           // SO_SNDBUF/SO_RCVBUF fixos (0 = automàtic, segons el BDP si hi ha `link_rate`)
+    double link_rate;           // Amplada de banda de l'enllaç en bytes per segon per calcular el BDP (0 = desconeguda, autoajust del nucli)
+    int keepalive_idle;         // Segons sense trànsit abans del keepalive (0 = sense keepalive)
+    int keepalive_interval;
+    int keepalive_count;
+    int fastopen;               // 1 = TCP Fast Open als sockets d'escolta, i en connectar si no hi ha termini (amb galeta el SYN s'envia amb la primera escriptura, on cap termini el pot limitar)
+    int connect_timeout_ms;     // Termini de les connexions sortints (0 = connect bloquejant, sense termini)
+    int connect_stagger_ms;     // Espera abans de provar el destí següent mentre l'anterior no respon
+    int shared_memory;          // 1 = les dades dels fitxers entre processos de la mateixa màquina passen per un anell de memòria compartida (CONN_CAP_SHM)
+    int multiplex;              // 1 = les distorsions d'un fleck amb un mateix worker comparteixen una sola connexió (sessió multiplexada). Cal als dos extrems i per defecte no s'activa: els streams no poden fer servir sendfile ni writev directes al socket
+} SocketOptions;                // Opcions TCP que s'apliquen a totes les connexions del procés
+
+typedef struct {
+    char ip[INET_ADDRSTRLEN];
+    int port;
+} SocketEndpoint;               // Destí possible d'una connexió
+
+typedef struct {
+    double rtt_ms;              // RTT suavitzat que mesura TCP
+    double rtt_var_ms;
+    double rcv_rtt_ms;          // RTT estimat pel receptor (0 si encara no ha rebut prou dades)
+    unsigned int cwnd;          // Finestra de congestió en segments
+    unsigned int mss;           // Bytes per segment enviat
+    unsigned int unacked;       // Segments en vol sense confirmar
+    unsigned int total_retrans; // Segments retransmesos durant tota la connexió
+    unsigned int rcv_space;     // Finestra de recepció que l'autoajust considera necessària
+    int send_buffer;            // SO_SNDBUF efectiu
+    int receive_buffer;         // SO_RCVBUF efectiu
+} SocketInfo;                   // Estat TCP d'una connexió en un moment donat
+
 //Funcions
 
 /*********************************************** 
@@ -39,6 +97,38 @@
 ************************************************/
 int SOCKET_initListenSocket(const char* ip, int port, int max_clients);
 
+/*********************************************** 
+* 
+* @Finalidad: Comprobar si un socket conectado comunica dos extremos de la misma máquina 
+*             a través de la interfaz de loopback (127.0.0.0/8 o ::1). 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket conectado. 
+* 
+* @Retorno: 
+*           1 = Ambos extremos del socket son direcciones de loopback. 
+*           0 = Algún extremo no es de loopback o no se ha podido consultar. 
+* 
+************************************************/
+int SOCKET_isLoopback(int socket);
+
+/*********************************************** 
+* 
+* @Finalidad: Comprobar si los dos extremos de un socket conectado están en esta máquina 
+*             (por loopback o porque la dirección local y la remota son la misma) y la 
+*             configuración permite pasar los datos de los ficheros por memoria compartida. 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket conectado. 
+* 
+* @Retorno: 
+*           1 = El otro extremo está en esta máquina y la memoria compartida está activada. 
+*           0 = Está en otra máquina, no se ha podido consultar o la configuración tiene 
+*               `shm off`. 
+* 
+************************************************/
+int SOCKET_canShareMemory(int socket);
+
 /*********************************************** 
 * 
 * @Finalidad: Crear e inicializar un socket cliente para conectarse a un servidor 
@@ -55,6 +145,78 @@ int SOCKET_initListenSocket(const char* ip, int port, int max_clients);
 ************************************************/
 int SOCKET_initClientSocket(const char* ip, int port);
 
+/*********************************************** 
+* 
+* @Finalidad: Conectar con el primer destino o, si no responde, con uno de los 
+*             alternativos, dentro del plazo configurado. El primero se intenta solo y 
+*             con todo el plazo: los alternativos (e.g., workers en espera, que ya escuchan 
+*             aunque no atiendan) solo se prueban si el primero rechaza la conexión o agota 
+*             el plazo, y entonces se intentan escalonados (el siguiente cuando el anterior 
+*             lleva `connect_stagger_ms` sin responder o en cuanto lo rechaza) con un plazo 
+*             nuevo. Sin plazo configurado, los destinos se prueban uno tras otro con 
+*             `connect` bloqueante. 
+* 
+* @Parámetros: 
+* in: endpoints = Destinos en orden de preferencia. 
+* in: n_endpoints = Número de destinos (como mucho `SOCKET_MAX_ENDPOINTS`). 
+* out: winner = Índice del destino conectado, o NULL si no interesa. 
+* 
+* @Retorno: 
+*           Descriptor del socket conectado (bloqueante y con las opciones TCP aplicadas). 
+*          -1 = Ningún destino ha respondido dentro del plazo. 
+* 
+************************************************/
+int SOCKET_raceConnect(const SocketEndpoint* endpoints, int n_endpoints, int* winner);
+
+/*********************************************** 
+* 
+* @Finalidad: Esperar a que llegue la primera respuesta de un destino recién conectado, 
+*             como mucho el plazo de conexión configurado. Un proceso que escucha pero no 
+*             atiende la conexión (e.g., un worker en espera) la acepta igualmente y, sin 
+*             este plazo, dejaría bloqueado a quien espera su respuesta. 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket recién conectado. 
+* 
+* @Retorno: 
+*           0 = Hay datos para leer (o no hay plazo configurado). 
+*          -1 = El destino no ha respondido dentro del plazo. 
+* 
+************************************************/
+int SOCKET_waitForReply(int socket);
+
+/*********************************************** 
+* 
+* @Finalidad: Preparar un destino de conexión a partir de su dirección IP y su puerto. 
+* 
+* @Parámetros: 
+* out: endpoint = Destino. 
+* in: ip = Dirección IPv4 en texto. 
+* in: port = Puerto. 
+* 
+* @Retorno: 
+*           0 = Destino preparado. 
+*          -1 = La dirección no cabe o el puerto no es válido. 
+* 
+************************************************/
+int SOCKET_setEndpoint(SocketEndpoint* endpoint, const char* ip, int port);
+
+/*********************************************** 
+* 
+* @Finalidad: Leer una lista de destinos en texto (`ip:puerto` separados por comas), como 
+*             la de los workers alternativos que envía Gotham. Las entradas mal formadas 
+*             se saltan. 
+* 
+* @Parámetros: 
+* in: list = Lista en texto, o NULL. 
+* out: endpoints = Destinos leídos. 
+* in: max_endpoints = Número máximo de destinos que caben en `endpoints`. 
+* 
+* @Retorno: Número de destinos leídos. 
+* 
+************************************************/
+int SOCKET_parseEndpoints(const char* list, SocketEndpoint* endpoints, int max_endpoints);
+
 /*********************************************** 
 * 
 * @Finalidad: Cerrar un socket abierto y establecer su descriptor a `-1` para indicar 
@@ -83,4 +245,127 @@ void SOCKET_closeSocket(int* socket);
 ************************************************/
 int SOCKET_safe_accept(int listen_socket);
 
+/*********************************************** 
+* 
+* @Finalidad: Interpretar una línea opcional del fichero de configuración con una opción 
+*             TCP: `nodelay on|off`, `quickack on|off`, `buffer auto|<KB>`, `link <MB/s>`, 
+*             `keepalive <segundos> [<intervalo> <sondeos>]|off`, `fastopen on|off`, 
+*             `connect_timeout <ms>|off`, `connect_stagger <ms>`, `shm on|off` o 
+*             `multiplex on|off`. La línea se reconoce por su clave, sea cual sea su 
+*             posición en el fichero. 
+* 
+* @Parámetros: 
+* in/out: options = Opciones a las que se aplica la línea. 
+* in: line = Línea del fichero de configuración, sin el salto de línea. 
+* 
+* @Retorno: 
+*           1 = La línea era una opción TCP y se ha aplicado. 
+*           0 = La línea no es una opción TCP (o su valor no es válido). 
+* 
+************************************************/
+int SOCKET_parseConfigLine(SocketOptions* options, const char* line);
+
+/*********************************************** 
+* 
+* @Finalidad: Fijar las opciones TCP de todas las conexiones que el proceso cree o acepte a 
+*             partir de ahora. Se llama una sola vez al cargar la configuración, antes de 
+*             abrir ningún socket. 
+* 
+* @Parámetros: 
+* in: options = Opciones configuradas. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void SOCKET_configure(const SocketOptions* options);
+
+/*********************************************** 
+* 
+* @Finalidad: Describir unas opciones TCP en una línea para mostrarlas con la configuración. 
+* 
+* @Parámetros: 
+* in: options = Opciones a describir. 
+* out: buffer = Texto de la descripción, acabado en '\0'. 
+* in: size = Bytes de `buffer`. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void SOCKET_describeOptions(const SocketOptions* options, char* buffer, size_t size);
+
+/*********************************************** 
+* 
+* @Finalidad: Aplicar las opciones TCP configuradas a una conexión recién establecida o 
+*             aceptada: Nagle, ACK inmediatos, keepalive y buffers según el BDP. Los fallos 
+*             se ignoran, porque la conexión funciona igual con las opciones por defecto. 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket conectado. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void SOCKET_tuneConnection(int socket);
+
+/*********************************************** 
+* 
+* @Finalidad: Dimensionar los buffers de envío y recepción de una conexión con el producto 
+*             ancho de banda por retardo, tomando el RTT que TCP ha medido hasta ahora. Solo 
+*             se fijan si superan lo que el autoajuste del núcleo ya alcanza por sí solo 
+*             (fijarlos lo desactiva), o si la configuración indica un tamaño fijo. 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket conectado. 
+* 
+* @Retorno: 
+*           > 0 = Bytes que se han pedido para cada buffer. 
+*           0 = Los buffers se dejan al autoajuste del núcleo. 
+* 
+************************************************/
+int SOCKET_sizeBuffers(int socket);
+
+/*********************************************** 
+* 
+* @Finalidad: Volver a activar `TCP_QUICKACK` en una conexión, si está configurado. El 
+*             núcleo lo desactiva por su cuenta, por lo que el receptor de un fichero lo 
+*             rearma cada vez que confirma paquetes para que el ACK de TCP no se retrase. 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket conectado. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void SOCKET_rearmQuickAck(int socket);
+
+/*********************************************** 
+* 
+* @Finalidad: Tomar una instantánea del estado TCP de una conexión (`TCP_INFO`) y del 
+*             tamaño efectivo de sus buffers. 
+* 
+* @Parámetros: 
+* in: socket = Descriptor del socket conectado. 
+* out: info = Estado de la conexión. 
+* 
+* @Retorno: 
+*           0 = Estado obtenido. 
+*          -1 = El socket no es TCP o no se ha podido consultar. 
+* 
+************************************************/
+int SOCKET_getInfo(int socket, SocketInfo* info);
+
+/*********************************************** 
+* 
+* @Finalidad: Describir el estado TCP de una conexión en una línea para los logs. 
+* 
+* @Parámetros: 
+* in: info = Estado obtenido con `SOCKET_getInfo`. 
+* out: buffer = Texto de la descripción, acabado en salto de línea y '\0'. 
+* in: size = Bytes de `buffer`. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+void SOCKET_describeInfo(const SocketInfo* info, char* buffer, size_t size);
+
 #endif // _SOCKET_CUSTOM_H_
\ No newline at end of file
@@ -0,0 +1,305 @@
+/***********************************************
+*
+* @Autores: Alexandre Contreras, Armand López.
+*
+* @Finalidad: Implementar la detección de los tramos de un mismo byte de los paquetes de
+*             un fichero, su codificación y su materialización en el fichero recibido
+*             como agujeros o rellenos.
+*
+* @Fecha de creación: 16 de octubre de 2026.
+*
+* @Última modificación: 16 de octubre de 2026.
+*
+************************************************/
+
+#include "sparse.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>  // _mm_loadu_si128, _mm_cmpeq_epi8, _mm_movemask_epi8
+#define SPARSE_HAS_SSE2_PATH 1
+#else
+#define SPARSE_HAS_SSE2_PATH 0
+#endif
+
+typedef struct {
+    uint32_t start;     // Inici del tram dins del paquet
+    uint32_t length;    // Bytes del tram (múltiple de SPARSE_BLOCK_SIZE)
+    uint8_t value;      // Byte repetit
+} SparseRun;            // Tram d'un mateix byte d'un paquet
+
+/***********************************************
+*
+* @Finalidad: Escribir un entero de 32 bits en big endian.
+*
+* @Parámetros:
+* out: data = Destino (4 bytes).
+* in: value = Valor a escribir.
+*
+* @Retorno: Ninguno.
+*
+************************************************/
+static void SPARSE_writeUint32(uint8_t *data, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        data[i] = (uint8_t)(value >> (24 - 8 * i));
+    }
+}
+
+/***********************************************
+*
+* @Finalidad: Leer un entero de 32 bits en big endian.
+*
+* @Parámetros:
+* in: data = Origen (4 bytes).
+*
+* @Retorno: Valor leído.
+*
+************************************************/
+static uint32_t SPARSE_readUint32(const uint8_t *data) {
+    return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | (uint32_t)data[3];
+}
+
+/***********************************************
+*
+* @Finalidad: Comprobar si todos los bytes de un bloque son iguales a un valor, con
+*             instrucciones SSE2 (16 bytes por comparación) cuando el procesador las tiene.
+*             Acaba en cuanto encuentra un byte distinto, de modo que en datos sin tramos
+*             solo se mira el principio de cada bloque.
+*
+* @Parámetros:
+* in: data = Bytes a comprobar.
+* in: length = Número de bytes de `data`.
+* in: value = Byte esperado.
+*
+* @Retorno:
+*           1 = Todos los bytes son `value`.
+*           0 = Algún byte es distinto.
+*
+************************************************/
+int SPARSE_isUniform(const uint8_t *data, size_t length, uint8_t value) {
+#if SPARSE_HAS_SSE2_PATH
+    //comparem 64 bytes per iteració i només mirem la màscara un cop per iteració
+    const __m128i pattern = _mm_set1_epi8((char)value);
+    while (length >= 64) {
+        __m128i equal = _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)data), pattern), _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data + 16)), pattern));
+        equal = _mm_and_si128(equal, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data + 32)), pattern));
+        equal = _mm_and_si128(equal, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data + 48)), pattern));
+        if (_mm_movemask_epi8(equal) != 0xFFFF) return 0;
+        data += 64;
+        length -= 64;
+    }
+#endif
+
+    //sense SSE2 (i per a la cua) comparem paraules de 8 bytes amb el byte repetit
+    uint64_t pattern_word = 0x0101010101010101ULL * value;
+    while (length >= 8) {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        if (word != pattern_word) return 0;
+        data += 8;
+        length -= 8;
+    }
+    while (length--) {
+        if (*data++ != value) return 0;
+    }
+    return 1;
+}
+
+/***********************************************
+*
+* @Finalidad: Buscar los tramos de un paquete: bloques de `SPARSE_BLOCK_SIZE` bytes
+*             alineados al fichero con todos los bytes iguales. Los bloques consecutivos
+*             del mismo byte forman un solo tramo.
+*
+* @Parámetros:
+* in: data = Datos del paquete.
+* in: length = Número de bytes de `data`.
+* in: offset = Posición del paquete en el fichero.
+* out: runs = Tramos encontrados (`SPARSE_MAX_RUNS` como mucho).
+*
+* @Retorno: Número de tramos encontrados.
+*
+************************************************/
+static int SPARSE_findRuns(const uint8_t *data, uint32_t length, uint64_t offset, SparseRun *runs) {
+    int n_runs = 0;
+    uint32_t position = (uint32_t)((SPARSE_BLOCK_SIZE - offset % SPARSE_BLOCK_SIZE) % SPARSE_BLOCK_SIZE);
+
+    for (; position + SPARSE_BLOCK_SIZE <= length; position += SPARSE_BLOCK_SIZE) {
+        uint8_t value = data[position];
+        if (!SPARSE_isUniform(data + position, SPARSE_BLOCK_SIZE, value)) continue;
+
+        if (n_runs > 0 && runs[n_runs - 1].value == value && runs[n_runs - 1].start + runs[n_runs - 1].length == position) {
+            runs[n_runs - 1].length += SPARSE_BLOCK_SIZE;
+        } else if (n_runs < SPARSE_MAX_RUNS) {
+            runs[n_runs].start = position;
+            runs[n_runs].length = SPARSE_BLOCK_SIZE;
+            runs[n_runs++].value = value;
+        }
+    }
+    return n_runs;
+}
+
+/***********************************************
+*
+* @Finalidad: Codificar un paquete de fichero con sus tramos de un mismo byte: el número
+*             de tramos, el inicio, la longitud y el byte de cada uno y, a continuación,
+*             los bytes del paquete que no forman parte de ningún tramo. Los tramos son
+*             bloques de `SPARSE_BLOCK_SIZE` bytes alineados al fichero y enteros dentro
+*             del paquete.
+*
+* @Parámetros:
+* in: data = Datos del paquete.
+* in: length = Número de bytes de `data` (como mucho `SPARSE_MAX_RUNS` bloques).
+* in: offset = Posición del paquete en el fichero (para alinear los bloques).
+* out: encoded = Paquete codificado. Debe tener espacio para `length` bytes y no compartir
+*                memoria con `data`.
+* in/out: stats = Estadísticas a las que se suma el paquete si tiene tramos, o NULL.
+*
+* @Retorno:
+*           > 0 = Bytes del paquete codificado (siempre menos que `length`).
+*           0 = El paquete no tiene ningún tramo (se debe enviar tal cual).
+*
+************************************************/
+uint32_t SPARSE_encodePacket(const uint8_t *data, uint32_t length, uint64_t offset, uint8_t *encoded, SparseStats *stats) {
+    SparseRun runs[SPARSE_MAX_RUNS];
+    int n_runs = SPARSE_findRuns(data, length, offset, runs);
+    if (n_runs == 0) return 0;
+
+    //cada tram estalvia com a mínim un bloc i en costa SPARSE_RUN_SIZE, així que el paquet codificat sempre és més petit
+    SPARSE_writeUint32(encoded, (uint32_t)n_runs);
+    uint8_t *run_data = encoded + SPARSE_COUNT_SIZE;
+    uint8_t *literal = run_data + (size_t)n_runs * SPARSE_RUN_SIZE;
+    uint32_t position = 0;
+    unsigned long long run_bytes = 0;
+
+    for (int i = 0; i < n_runs; i++) {
+        SPARSE_writeUint32(run_data, runs[i].start);
+        SPARSE_writeUint32(run_data + 4, runs[i].length);
+        run_data[8] = runs[i].value;
+        run_data += SPARSE_RUN_SIZE;
+
+        memcpy(literal, data + position, runs[i].start - position);
+        literal += runs[i].start - position;
+        position = runs[i].start + runs[i].length;
+        run_bytes += runs[i].length;
+    }
+    memcpy(literal, data + position, length - position);
+    literal += length - position;
+
+    if (stats) {
+        stats->packets++;
+        stats->run_bytes += run_bytes;
+    }
+    return (uint32_t)(literal - encoded);
+}
+
+/***********************************************
+*
+* @Finalidad: Rellenar una región de un fichero con un mismo byte. Los ceros se dejan como
+*             un agujero del fichero (`FALLOC_FL_PUNCH_HOLE`), que no ocupa disco y se lee
+*             como ceros; si el sistema de ficheros no lo permite, o con otro byte, se
+*             escribe el byte en la proyección o con `pwrite`.
+*
+* @Parámetros:
+* in: fd = Descriptor del fichero abierto para escritura.
+* in: mapped = Proyección del fichero entero, o NULL.
+* in: offset = Posición de la región.
+* in: length = Bytes de la región.
+* in: value = Byte de la región.
+*
+* @Retorno:
+*           1 = Región dejada como agujero.
+*           0 = Región escrita.
+*          -1 = Error de escritura.
+*
+************************************************/
+int SPARSE_fillRegion(int fd, uint8_t *mapped, off_t offset, off_t length, uint8_t value) {
+    if (length <= 0) return 0;
+    if (value == 0 && fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, length) == 0) return 1;
+
+    if (mapped) {
+        memset(mapped + offset, value, (size_t)length);
+        return 0;
+    }
+
+    uint8_t block[SPARSE_BLOCK_SIZE];
+    memset(block, value, sizeof(block));
+    while (length > 0) {
+        size_t size = length > (off_t)sizeof(block) ? sizeof(block) : (size_t)length;
+        if (pwrite(fd, block, size, offset) != (ssize_t)size) return -1;
+        offset += size;
+        length -= size;
+    }
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalidad: Escribir en su posición del fichero un paquete codificado con
+*             `SPARSE_encodePacket`: los bytes sueltos se copian y los tramos se
+*             materializan con `SPARSE_fillRegion`. Antes de escribir nada se comprueba que
+*             los tramos están ordenados y caben en el paquete.
+*
+* @Parámetros:
+* in: fd = Descriptor del fichero abierto para escritura.
+* in: mapped = Proyección del fichero entero, o NULL.
+* in: file_size = Tamaño final del fichero en bytes.
+* in: offset = Posición del paquete en el fichero.
+* in: encoded = Paquete codificado.
+* in: encoded_length = Bytes de `encoded`.
+* in: max_length = Bytes que puede tener el paquete como mucho (los de un paquete).
+* in/out: stats = Estadísticas a las que se suma el paquete, o NULL.
+*
+* @Retorno:
+*           >= 0 = Bytes del paquete escritos en el fichero.
+*           -1 = Paquete mal formado, fuera del fichero o error de escritura.
+*
+************************************************/
+long SPARSE_writePacket(int fd, uint8_t *mapped, off_t file_size, off_t offset, const uint8_t *encoded, uint32_t encoded_length, uint32_t max_length, SparseStats *stats) {
+    if (encoded_length < SPARSE_COUNT_SIZE) return -1;
+    uint32_t n_runs = SPARSE_readUint32(encoded);
+    if (n_runs == 0 || n_runs > SPARSE_MAX_RUNS || SPARSE_COUNT_SIZE + n_runs * SPARSE_RUN_SIZE > encoded_length) return -1;
+
+    const uint8_t *run_data = encoded + SPARSE_COUNT_SIZE;
+    const uint8_t *literal = run_data + n_runs * SPARSE_RUN_SIZE;
+    uint64_t length = encoded_length - SPARSE_COUNT_SIZE - n_runs * SPARSE_RUN_SIZE;
+    uint64_t end = 0;
+
+    //validem tots els trams abans d'escriure res: ordenats, sense solapar-se i dins del paquet
+    for (uint32_t i = 0; i < n_runs; i++) {
+        uint32_t start = SPARSE_readUint32(run_data + i * SPARSE_RUN_SIZE);
+        uint32_t run_length = SPARSE_readUint32(run_data + i * SPARSE_RUN_SIZE + 4);
+        if (start < end || run_length == 0) return -1;
+        end = (uint64_t)start + run_length;
+        length += run_length;
+    }
+    if (end > length || length > max_length || offset < 0 || offset + (off_t)length > file_size) return -1;
+
+    uint64_t position = 0;
+    for (uint32_t i = 0; i <= n_runs; i++) {
+        uint64_t start = i < n_runs ? SPARSE_readUint32(run_data + i * SPARSE_RUN_SIZE) : length;
+        uint32_t gap = (uint32_t)(start - position);
+
+        //bytes solts fins al tram
+        if (gap > 0) {
+            if (mapped) {
+                memcpy(mapped + offset + position, literal, gap);
+            } else if (pwrite(fd, literal, gap, offset + (off_t)position) != (ssize_t)gap) {
+                return -1;
+            }
+            literal += gap;
+        }
+        if (i == n_runs) break;
+
+        uint32_t run_length = SPARSE_readUint32(run_data + i * SPARSE_RUN_SIZE + 4);
+        int filled = SPARSE_fillRegion(fd, mapped, offset + (off_t)start, run_length, run_data[i * SPARSE_RUN_SIZE + 8]);
+        if (filled < 0) return -1;
+        if (stats) {
+            stats->run_bytes += run_length;
+            if (filled) stats->hole_bytes += run_length;
+        }
+        position = start + run_length;
+    }
+
+    if (stats) stats->packets++;
+    return (long)length;
+}
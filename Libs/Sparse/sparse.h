@@ -0,0 +1,132 @@
+/***********************************************
+*
+* @Autores: Alexandre Contreras y Armand López
+* @Propósito: Detectar en los paquetes de un fichero los tramos largos de un mismo byte
+*             (el silencio de un WAV, el relleno de un BMP o un TGA) y codificar el
+*             paquete como una lista de tramos más los bytes restantes, de modo que los
+*             tramos no viajan por la conexión. El receptor los materializa sin
+*             recibirlos: los de ceros como agujeros del fichero (`fallocate`) y los
+*             demás rellenando el byte.
+* @Fecha de creación: 16 de octubre de 2026
+* @Última modificación: 16 de octubre de 2026
+*
+************************************************/
+
+#ifndef _SPARSE_CUSTOM_H_
+#define _SPARSE_CUSTOM_H_
+
+//Constant del sistema
+#define _GNU_SOURCE
+
+//Libreries del sistema
+#include <stdint.h>    // uint8_t, uint32_t, uint64_t
+#include <stddef.h>    // size_t
+#include <string.h>    // memcpy, memset
+#include <fcntl.h>     // fallocate, FALLOC_FL_PUNCH_HOLE, FALLOC_FL_KEEP_SIZE
+#include <unistd.h>    // pwrite
+#include <sys/types.h> // off_t
+
+//Constants
+#define SPARSE_BLOCK_SIZE 4096            // Els trams es detecten per blocs alineats al fitxer d'aquesta mida (la d'un bloc del sistema de fitxers, perquè els forats alliberin disc)
+#define SPARSE_MAX_RUNS (1024 * 1024 / SPARSE_BLOCK_SIZE)   // Trams com a màxim d'un paquet (un per bloc d'un paquet d'1 MiB, el màxim d'una trama v2)
+#define SPARSE_COUNT_SIZE 4               // Nombre de trams (big endian) al davant d'un paquet codificat
+#define SPARSE_RUN_SIZE 9                 // Inici dins del paquet (4 bytes), longitud (4 bytes) i byte repetit de cada tram
+#define SPARSE_EMPTY_STATS {0, 0, 0}      // Inicialitzador d'unes estadístiques buides
+
+typedef struct {
+    int packets;                    // Paquets que s'han codificat amb trams
+    unsigned long long run_bytes;   // Bytes dels trams (els que no viatgen per la connexió)
+    unsigned long long hole_bytes;  // Bytes dels trams que el receptor ha deixat com a forats
+} SparseStats;                      // Estadístiques dels trams d'una transferència
+
+//Funcions
+
+/***********************************************
+*
+* @Finalidad: Comprobar si todos los bytes de un bloque son iguales a un valor, con
+*             instrucciones SSE2 (16 bytes por comparación) cuando el procesador las tiene.
+*             Acaba en cuanto encuentra un byte distinto, de modo que en datos sin tramos
+*             solo se mira el principio de cada bloque.
+*
+* @Parámetros:
+* in: data = Bytes a comprobar.
+* in: length = Número de bytes de `data`.
+* in: value = Byte esperado.
+*
+* @Retorno:
+*           1 = Todos los bytes son `value`.
+*           0 = Algún byte es distinto.
+*
+************************************************/
+int SPARSE_isUniform(const uint8_t *data, size_t length, uint8_t value);
+
+/***********************************************
+*
+* @Finalidad: Codificar un paquete de fichero con sus tramos de un mismo byte: el número
+*             de tramos, el inicio, la longitud y el byte de cada uno y, a continuación,
+*             los bytes del paquete que no forman parte de ningún tramo. Los tramos son
+*             bloques de `SPARSE_BLOCK_SIZE` bytes alineados al fichero y enteros dentro
+*             del paquete.
+*
+* @Parámetros:
+* in: data = Datos del paquete.
+* in: length = Número de bytes de `data` (como mucho `SPARSE_MAX_RUNS` bloques).
+* in: offset = Posición del paquete en el fichero (para alinear los bloques).
+* out: encoded = Paquete codificado. Debe tener espacio para `length` bytes y no compartir
+*                memoria con `data`.
+* in/out: stats = Estadísticas a las que se suma el paquete si tiene tramos, o NULL.
+*
+* @Retorno:
+*           > 0 = Bytes del paquete codificado (siempre menos que `length`).
+*           0 = El paquete no tiene ningún tramo (se debe enviar tal cual).
+*
+************************************************/
+uint32_t SPARSE_encodePacket(const uint8_t *data, uint32_t length, uint64_t offset, uint8_t *encoded, SparseStats *stats);
+
+/***********************************************
+*
+* @Finalidad: Rellenar una región de un fichero con un mismo byte. Los ceros se dejan como
+*             un agujero del fichero (`FALLOC_FL_PUNCH_HOLE`), que no ocupa disco y se lee
+*             como ceros; si el sistema de ficheros no lo permite, o con otro byte, se
+*             escribe el byte en la proyección o con `pwrite`.
+*
+* @Parámetros:
+* in: fd = Descriptor del fichero abierto para escritura.
+* in: mapped = Proyección del fichero entero, o NULL.
+* in: offset = Posición de la región.
+* in: length = Bytes de la región.
+* in: value = Byte de la región.
+*
+* @Retorno:
+*           1 = Región dejada como agujero.
+*           0 = Región escrita.
+*          -1 = Error de escritura.
+*
+************************************************/
+int SPARSE_fillRegion(int fd, uint8_t *mapped, off_t offset, off_t length, uint8_t value);
+
+/***********************************************
+*
+* @Finalidad: Escribir en su posición del fichero un paquete codificado con
+*             `SPARSE_encodePacket`: los bytes sueltos se copian y los tramos se
+*             materializan con `SPARSE_fillRegion`. Antes de escribir nada se comprueba que
+*             los tramos están ordenados y caben en el paquete.
+*
+* @Parámetros:
+* in: fd = Descriptor del fichero abierto para escritura.
+* in: mapped = Proyección del fichero entero, o NULL.
+* in: file_size = Tamaño final del fichero en bytes.
+* in: offset = Posición del paquete en el fichero.
+* in: encoded = Paquete codificado.
+* in: encoded_length = Bytes de `encoded`.
+* in: max_length = Bytes que puede tener el paquete como mucho (los de un paquete).
+* in/out: stats = Estadísticas a las que se suma el paquete, o NULL.
+*
+* @Retorno:
+*           >= 0 = Bytes del paquete escritos en el fichero.
+*           -1 = Paquete mal formado, fuera del fichero o error de escritura.
+*
+************************************************/
+long SPARSE_writePacket(int fd, uint8_t *mapped, off_t file_size, off_t offset, const uint8_t *encoded, uint32_t encoded_length, uint32_t max_length, SparseStats *stats);
+
+#endif // _SPARSE_CUSTOM_H_
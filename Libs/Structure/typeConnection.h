@@ -0,0 +1,66 @@
+/***********************************************
+*
+* @Autores: Alexandre Contreras y Armand López
+* @Propósito: Definir las capacidades que cada extremo anuncia en los handshakes
+*             (tamaño máximo de trama, capacidades, algoritmos de checksum y de hash,
+*             ventana de envío) y la estructura con la combinación acordada para
+*             cada conexión, que consultan las funciones de comunicación.
+* @Fecha de creación: 16 de octubre de 2026
+* @Última modificación: 16 de octubre de 2026
+*
+************************************************/
+
+#ifndef _TYPE_CONNECTION_CUSTOM_H_
+#define _TYPE_CONNECTION_CUSTOM_H_
+
+#include <stdint.h>
+
+#define CONN_DEFAULT_WINDOW_SIZE 8     // Trames de fitxer en vol per defecte si la configuració no n'indica
+#define CONN_MAX_WINDOW_SIZE 64        // Límit de trames de fitxer en vol sense confirmar
+#define CONN_MAX_STRIPES 8             // Límit de connexions paral·leles per les quals s'envia un fitxer
+
+// Capacitats (bitmap). Només s'activen les que anuncien els dos extrems
+#define CONN_CAP_COMPRESSION 0x01      // Els paquets de fitxer v2 compressibles s'envien comprimits (s'activa per configuració)
+#define CONN_CAP_SACK 0x02             // Els paquets de fitxer v2 porten el seu offset i els ACK indiquen quins paquets s'han rebut (sempre s'ofereix)
+#define CONN_CAP_HASH_TRAILER 0x04     // El MD5 del fitxer es pot enviar darrere dels paquets (trama 0x14) en lloc de a les metadades (sempre s'ofereix)
+#define CONN_CAP_MERKLE 0x08           // L'arrel d'un arbre de hashos per blocs va a les metadades i el receptor demana de nou només els blocs corruptes (sempre s'ofereix, però l'emissor només calcula l'arbre dels fitxers de com a mínim MERKLE_MIN_FILE_SIZE; requereix CONN_CAP_SACK)
+#define CONN_CAP_DELTA 0x10            // El fitxer s'envia com a delta respecte a l'última versió que en conserva el receptor (sempre s'ofereix, només en enviar el fitxer original)
+#define CONN_CAP_SPARSE 0x20           // Els paquets amb trams d'un mateix byte s'envien com a llista de trams (trama 0x1A) i el receptor els deixa com a forats (sempre s'ofereix, requereix CONN_CAP_SACK)
+#define CONN_CAP_SHM 0x40              // Les dades dels fitxers passen per un anell de memòria compartida (el nom del segment va a la trama 0x1B) i pel socket només el control (només si els dos extrems són a la mateixa màquina, requereix CONN_CAP_SACK)
+#define CONN_CAP_PIPELINE 0x80         // Les fases d'una distorsió s'encadenen: l'emisor no espera el primer ACK selectiu d'una transferència nova, el MD5 surt just darrere de l'últim paquet i, dins d'una sessió multiplexada, la petició 0x03 no espera resposta (sempre s'ofereix, requereix CONN_CAP_SACK)
+#define CONN_DEFAULT_CAPABILITIES (CONN_CAP_SACK | CONN_CAP_HASH_TRAILER | CONN_CAP_MERKLE | CONN_CAP_DELTA | CONN_CAP_SPARSE | CONN_CAP_PIPELINE)   // Capacitats que s'ofereixen sense dependre de la configuració
+
+// Algorismes de checksum de les trames v2 (bitmap dels suportats a l'oferta, un sol bit a l'acord)
+#define CONN_CHECKSUM_CRC32C 0x01      // CRC32C del payload (obligatori per a qualsevol peer v2)
+#define CONN_CHECKSUM_NONE 0x02        // Sense checksum (només en loopback, el MD5 del fitxer ja protegeix la transferència)
+
+// Algorismes de hash del fitxer complet (bitmap dels suportats a l'oferta, un sol bit a l'acord)
+#define CONN_HASH_MD5 0x01             // MD5 (l'únic que entenen els peers v1)
+
+// Motor d'E/S de les transferències de fitxers (local a cada extrem, no es negocia)
+#define CONN_IO_SYSCALLS 0             // Crides al sistema bloquejants (preadv/writev/sendfile, recv, mmap), el motor per defecte
+#define CONN_IO_URING 1                // io_uring: lectures i escriptures de disc en paral·lel amb el socket (s'activa per configuració)
+
+typedef struct {
+    uint32_t data_size;     // Bytes de dades per trama que accepta (0 = peer v1, només trames de 256 bytes)
+    int capabilities;       // Capacitats CONN_CAP_*
+    int checksums;          // Algorismes CONN_CHECKSUM_* suportats
+    int hashes;             // Algorismes CONN_HASH_* suportats
+    int window_size;        // Trames de fitxer en vol que accepta (0 = no l'anuncia)
+    int stripes;            // Connexions paral·leles per enviar un fitxer que accepta (0 = no l'anuncia, una sola)
+} ConnectionOffer;
+
+typedef struct {
+    int frame_version;      // Format de trama acordat (FRAME_V1 = 256 bytes fixos, FRAME_V2 = longitud de 32 bits)
+    uint32_t data_size;     // Bytes de dades per paquet de fitxer acordats amb l'altre extrem
+    int window_size;        // Trames de fitxer que s'envien sense esperar ACK (la menor de les dues ofertes)
+    int capabilities;       // Capacitats CONN_CAP_* acordades amb l'altre extrem
+    int checksum;           // Algorisme CONN_CHECKSUM_* de les trames v2 (0 en connexions v1, que porten el seu propi checksum)
+    int hash;               // Algorisme CONN_HASH_* del fitxer complet
+    int stripes;            // Connexions paral·leles per les quals s'envia un fitxer (1 = només aquesta; més només amb CONN_CAP_SACK)
+    ConnectionOffer local;  // Què ofereix aquest extrem per configuració (configuració local)
+    int io_engine;          // Motor d'E/S CONN_IO_* que fa servir aquest extrem per configuració (configuració local)
+    struct ShaperUser *shaper;  // Part de l'amplada de banda del worker de l'usuari de la connexió, o NULL sense límit (configuració local)
+} ConnectionParams;
+
+#endif // _TYPE_CONNECTION_CUSTOM_H_
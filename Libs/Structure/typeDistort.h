@@ -11,6 +11,46 @@
 #ifndef _TYPE_DISTORT_CUSTOM_H_
 #define _TYPE_DISTORT_CUSTOM_H_
 
+#include <stdint.h>
+
+#include "typeConnection.h"
+
+#define DIST_MAX_RANGES 16          // Trams de paquets rebuts que es desen a memòria compartida per reprendre una recepció
+#define DIST_MAX_STRIPES CONN_MAX_STRIPES   // Franges (connexions paral·leles) d'un fitxer en recepció que es desen a memòria compartida
+
+typedef struct {
+    uint8_t *bits;              // Bit i (el més alt de cada byte primer) = paquet i rebut
+    int n_packets;              // Paquets que cobreix el bitmap
+    int data_size;              // Mida de paquet amb què es compten
+    int n_received;             // Paquets marcats com a rebuts
+    int first_missing;          // Primer paquet no rebut (tots els anteriors ho estan)
+} PacketMap;
+
+typedef struct {
+    uint32_t state[4];          // Estat MD5 (A, B, C, D) després dels blocs complets
+    uint64_t length;            // Bytes del fitxer ja resumits (sempre un prefix contigu)
+    uint8_t block[64];          // Bytes resumits que encara no omplen un bloc
+} FileHash;
+
+typedef struct {
+    uint8_t *leaves;            // MD5 de cada bloc (fulles de l'arbre), NULL fins que es coneixen
+    uint8_t *verified;          // verified[i] = 1 si el bloc i rebut coincideix amb la seva fulla (només en recepció)
+    int n_chunks;               // Blocs del fitxer (0 = sense arbre)
+    uint32_t chunk_size;        // Bytes de cada bloc (l'últim pot ser més curt)
+    uint8_t root[16];           // MD5 de l'arrel de l'arbre
+} MerkleTree;
+
+typedef struct {
+    int first_packet;           // Primer paquet del tram
+    int n_packets;              // Paquets consecutius rebuts a partir de first_packet
+} DistortionRange;
+
+typedef struct {
+    int first_packet;           // Primer paquet de la franja
+    int n_packets;              // Paquets de la franja
+    int n_received;             // Paquets consecutius rebuts a partir de first_packet
+} DistortionStripe;
+
 typedef struct {
     char* file_path;
     char* filename; 
@@ -21,12 +61,24 @@ typedef struct {
     int current_stage;
     int n_packets;
     int n_processed_packets;
+    int data_size;              // Bytes de dades per paquet acordats amb l'altre extrem
+    PacketMap received;         // Paquets del fitxer en recepció escrits a disc, en qualsevol ordre
+    int n_stripes;              // Franges en què s'ha repartit l'última recepció (0 = una sola connexió)
+    DistortionStripe stripes[DIST_MAX_STRIPES]; // Progrés de cada franja de l'última recepció
+    FileHash hash;              // MD5 incremental del fitxer que s'està enviant o rebent
+    MerkleTree merkle;          // Arbre de hashos per blocs del fitxer que s'està enviant o rebent
 } DistortionContext;
 
 typedef struct {
     int current_stage;
     int n_packets;
     int n_processed_packets;
+    int data_size;              // Mida de paquet amb què es van comptar els paquets processats
+    int n_ranges;               // Trams vàlids de 'ranges'
+    DistortionRange ranges[DIST_MAX_RANGES];    // Paquets rebuts fora d'ordre (en unitats de data_size)
+    int n_stripes;              // Franges vàlides de 'stripes'
+    DistortionStripe stripes[DIST_MAX_STRIPES]; // Progrés de cada franja, que es conserva encara que els trams no hi càpiguen
+    FileHash hash;              // MD5 parcial del fitxer, per continuar-lo sense rellegir el que ja s'ha resumit
 } DistortionProgress;
 
 #endif // _TYPE_DISTORT_CUSTOM_H_
\ No newline at end of file
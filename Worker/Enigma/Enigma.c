@@ -54,6 +54,7 @@ volatile int exit_program = 0; // Per tancar workerServer
 volatile int exit_distortion = 0; // Per tancar threads de distorsió distortions
 pthread_mutex_t print_mutex = PTHREAD_MUTEX_INITIALIZER;           // Mutex per a la impressió per pantalla 
 int gotham_socket = -1;
+ConnectionParams gotham_params = FRAME_LEGACY_PARAMS;           // Paràmetres de trama acordats amb Gotham en el handshake 0x02
 
 //Funcions
 
@@ -118,6 +119,7 @@ int main(int argc, char** argv) {
 
     signal(SIGUSR1, handle_thread_signal);  // Configurem senyal SIGUSR1 per a interrompre mètodes bloquejants als threads principals
     signal(SIGINT, handle_sigint);          // Configurem handler de la senyal sigint
+    signal(SIGPIPE, SIG_IGN);               // Si el fleck cau mentre li enviem un fitxer, el send retorna error en lloc de matar el procés
 
     STRING_initScreenMutex(print_mutex);
 
@@ -136,6 +138,8 @@ int main(int argc, char** argv) {
         exit(EXIT_FAILURE);
     }
     LOAD_printConfig(enigma_conf, WORKER_CONF);
+    COMM_setStatistics(enigma_conf->statistics);
+    SOCKET_configure(&enigma_conf->socket_options);
     
     // Creem i establim connexió amb Gotham
     gotham_socket = SOCKET_initClientSocket(enigma_conf->gotham_ip, enigma_conf->gotham_port);
@@ -147,7 +151,7 @@ int main(int argc, char** argv) {
 
 
     // Establim connexió formal amb Gotham
-    if (COMM_connectToGotham(gotham_socket, enigma_conf) < 0) {
+    if (COMM_connectToGotham(gotham_socket, enigma_conf, &gotham_params) < 0) {
         IO_printStatic(STDOUT_FILENO, RED "Failed to connect to Gotham. Exiting...\n" RESET);
         close(gotham_socket);
         EXIT_freeMemory(&enigma_conf, NULL);
@@ -17,38 +17,31 @@
 /*********************************************** 
 * 
 * @Finalidad: Crear y enviar una trama de conexión al servidor Gotham, incluyendo 
-*             el tipo de worker, su IP y puerto. 
+*             el tipo de worker, su IP y puerto y las capacidades que ofrece. 
 * 
 * @Parámetros: 
 * in: gotham_socket = Descriptor del socket conectado al servidor Gotham. 
 * in: config = Puntero a la estructura `WorkerConfig` que contiene la configuración del worker. 
+* in: offer = Capacidades que el worker anuncia a Gotham. 
 * 
 * @Retorno: 
 *           0 = La trama de conexión fue enviada con éxito. 
 *          -1 = Error al asignar memoria o al enviar la trama. 
 * 
 ************************************************/
-int COMM_sendConnectionFrame(int gotham_socket, WorkerConfig *config) {
-    char *data;
-    // Format: TYPE: 0x02, DATA: <workerType>&<IP>&<Port>
-
-    //creem la cadena amb el tipus de worker, IP i port dinàmics
-    if (asprintf(&data, "%s&%s&%d", config->worker_type, config->worker_ip, config->worker_port) == -1) {
-        return -1;  // Error allocating memory for data
-    }
-
-    //creem la trama de connexió
-    Frame *connect_frame = FRAME_createFrame(0x02, (const char *)data, strlen(data));
-
-    //enviem la trama de connexió a Gotham
-    int result = FRAME_sendFrame(gotham_socket, connect_frame);
-
-    //destruïm la trama 
-    FRAME_destroyFrame(connect_frame);
-
-    free(data);
-
-    return result; // Retornar el resultat de l'enviament
+int COMM_sendConnectionFrame(int gotham_socket, WorkerConfig *config, const ConnectionOffer *offer) {
+    // Format: TYPE: 0x02, DATA: <workerType>&<IP>&<Port>&<MaxDataSize>
+    Metadata metadata;
+
+    //tipus de worker, IP i port dinàmics i les capacitats que oferim (un Gotham v1 les ignora)
+    METADATA_init(&metadata);
+    METADATA_setString(&metadata, METADATA_WORKER_TYPE, config->worker_type);
+    METADATA_setString(&metadata, METADATA_IP, config->worker_ip);
+    METADATA_setNumber(&metadata, METADATA_PORT, (uint32_t)config->worker_port);
+    COMM_setOfferMetadata(&metadata, offer);
+
+    //encara no sabem si Gotham accepta trames v2, així que la trama de connexió va en text
+    return COMM_sendMetadata(gotham_socket, 0x02, &metadata, METADATA_MSG_WORKER_CONNECTION, NULL);
 }
 
 /*********************************************** 
@@ -59,6 +52,7 @@ int COMM_sendConnectionFrame(int gotham_socket, WorkerConfig *config) {
 * @Parámetros: 
 * in: gotham_socket = Descriptor del socket conectado al servidor Gotham. 
 * in: config = Puntero a la estructura `WorkerConfig` que contiene la configuración del worker. 
+* out: gotham_params = Parámetros de trama acordados con Gotham (v1 si Gotham no los negocia). 
 * 
 * @Retorno: 
 *           0 = Conexión establecida exitosamente. 
@@ -66,9 +60,16 @@ int COMM_sendConnectionFrame(int gotham_socket, WorkerConfig *config) {
 *               devuelve un estado negativo. 
 * 
 ************************************************/
-int COMM_connectToGotham(int gotham_socket, WorkerConfig *config) {
+int COMM_connectToGotham(int gotham_socket, WorkerConfig *config, ConnectionParams *gotham_params) {
+    //a Gotham li oferim el mateix que als flecks segons la configuració
+    ConnectionOffer offer;
+    FRAME_initLegacyParams(gotham_params);
+    gotham_params->local.window_size = config->window_size;
+    gotham_params->local.capabilities = config->capabilities;
+    COMM_getLocalOffer(gotham_socket, gotham_params, &offer);
+
     //enviem trama de connexió
-    if (COMM_sendConnectionFrame(gotham_socket, config) < 0) {
+    if (COMM_sendConnectionFrame(gotham_socket, config, &offer) < 0) {
         IO_printStatic(STDOUT_FILENO, RED "Error: failed to send Gotham the connection frame\n" RESET);
         return -1;  
     }
@@ -83,15 +84,22 @@ int COMM_connectToGotham(int gotham_socket, WorkerConfig *config) {
 
     //verifiquem la resposta de Gotham
     if (frame->type == 0x02) {
-        if (frame->data_length == 0) {
-            IO_printStatic(STDOUT_FILENO, GREEN "\nConnected to Mr. J. System.\n" RESET); //gotham ha retornat OK
-            FRAME_destroyFrame(frame);
-            return 0;  
-        }
         if (frame->data_length > 0 && strcmp((char *)frame->data, "CON_KO") == 0) {
             FRAME_destroyFrame(frame); //gotham ha retornat KO
             return -1;  
         }
+
+        //gotham ha retornat OK. Si la resposta porta la combinació escollida, Gotham accepta trames v2
+        Metadata response;
+        ConnectionOffer chosen;
+        if (METADATA_decode(frame->data, frame->data_length, METADATA_MSG_CONNECTION_RESPONSE, &response) < 0) {
+            METADATA_init(&response);
+        }
+        COMM_getOfferMetadata(&response, &chosen);
+        FRAME_negotiate(&chosen, &offer, gotham_params);
+        IO_printStatic(STDOUT_FILENO, GREEN "\nConnected to Mr. J. System.\n" RESET);
+        FRAME_destroyFrame(frame);
+        return 0;  
     }
 
     //gotham no ha rebut la trama correctament i ha enviat errorFrame
@@ -156,11 +164,40 @@ int COMM_waitForMainWorkerAssignment(int gotham_socket, volatile int* exit_progr
     return COMM_PENDING;
 }
 
+/*********************************************** 
+* 
+* @Finalidad: Comprobar si la combinación acordada con el fleck es la que él ya ha dado por 
+*             acordada en la sesión (petición sin espera de respuesta). 
+* 
+* @Parámetros: 
+* in: params = Parámetros acordados a partir de la petición. 
+* in: peer = Oferta de la petición, que es la combinación de la sesión. 
+* 
+* @Retorno: 
+*           1 = Coinciden. 
+*           0 = No coinciden (e.g., ha cambiado la configuración de este worker). 
+* 
+************************************************/
+static int COMM_matchesOffer(const ConnectionParams* params, const ConnectionOffer* peer) {
+    return params->frame_version == FRAME_V2 && params->data_size == peer->data_size && params->capabilities == peer->capabilities && params->checksum == peer->checksums && params->hash == peer->hashes && params->window_size == peer->window_size && params->stripes == 1;
+}
+
 /*********************************************** 
 * 
 * @Finalidad: Recibir y procesar los metadatos de un archivo enviados por un fleck, 
 *             validarlos, inicializar el contexto de distorsión, y gestionar el progreso 
-*             asociado a la distorsión. 
+*             asociado a la distorsión. Si en lugar de los metadatos llega una trama 0x13, 
+*             la conexión es una franja adicional de la distorsión de otra conexión del 
+*             mismo fleck: se confirma y se devuelve para que se registre. Si llega una trama 
+*             0x1C, el fleck quiere hacer de la conexión una sesión multiplexada; quien llama 
+*             decide si la acepta, y si lleva la oferta del fleck se acuerda con ella la 
+*             combinación de todas las distorsiones de la sesión. Una petición que la da 
+*             por acordada (`METADATA_PIPELINED`) no espera respuesta: solo se le responde 
+*             con CON_KO si la combinación ya no es la misma. Si la petición lleva la raíz del árbol de Merkle del 
+*             archivo, se prepara el árbol del contexto (sus hojas llegan después de la 
+*             respuesta). Si el fleck ofrece enviar el archivo como delta y este worker 
+*             conserva su última versión, se acepta (sin árbol de Merkle ni franjas, que 
+*             trabajan por paquetes). 
 * 
 * @Parámetros: 
 * in: fleck_socket = Descriptor del socket del fleck desde el cual se recibirán los metadatos. 
@@ -168,17 +205,22 @@ int COMM_waitForMainWorkerAssignment(int gotham_socket, volatile int* exit_progr
 *                              los metadatos recibidos y procesados. 
 * in: distortions_folder_path = Ruta a la carpeta donde se almacenarán los archivos distorsionados. 
 * out: shm_id = Puntero al identificador de memoria compartida para gestionar el progreso. 
+* out: params = Parámetros de trama acordados con el fleck a partir de su petición (o de 
+*               la oferta de la sesión, con `COMM_SESSION_OPEN`). 
+* out: stripe = Franja a la que se une la conexión (solo con `COMM_STRIPE_JOIN`). 
+* out: basis_path = Ruta de la última versión del archivo si se ha acordado `CONN_CAP_DELTA`, 
+*                  o NULL. Se debe liberar. 
 * 
 * @Retorno: 
 *           1 = Los metadatos fueron recibidos y procesados correctamente. 
 *           0 = Error en la recepción, validación de atributos, o inicialización del contexto. 
+*           COMM_STRIPE_JOIN = La conexión es una franja de otra distorsión, ya confirmada. 
+*           COMM_SESSION_OPEN = El fleck pide una sesión multiplexada (aún sin respuesta). 
 * 
 ************************************************/
-int COMM_retrieveFileMetadata(int fleck_socket, DistortionContext* distortion_context, char* distortions_folder_path, int* shm_id) {
-    // Atributs a extreure del camp de dades de la trama
-    char *username = NULL, *filename = NULL, *md5sum = NULL;
-    int filesize = 0, factor = 0;
-    char* data_buffer = NULL; 
+int COMM_retrieveFileMetadata(int fleck_socket, DistortionContext* distortion_context, char* distortions_folder_path, int* shm_id, ConnectionParams* params, PendingStripe* stripe, char** basis_path) {
+    // Atributs a extreure del camp de dades de la trama (apunten a les dades de la trama rebuda)
+    Metadata metadata;
     // 1- Rebem la trama de fleck
     FrameResult result = FRAME_receiveFrame(fleck_socket);
 
@@ -191,32 +233,66 @@ int COMM_retrieveFileMetadata(int fleck_socket, DistortionContext* distortion_co
 
     Frame *response_frame = result.frame;
     if(response_frame->type == 0x03) {
-        data_buffer = strdup((char *)response_frame->data);  // Copiem les dades de la trama a buffer auxiliar
-        FRAME_destroyFrame(response_frame);
-        if (!data_buffer) {
-            IO_printStatic(STDOUT_FILENO, "Error: Could not allocate memory for response.\n");
-            return 0; // Retornem codi d'error
-        }
-
-        // 2- Extreiem i validem atributs
-        int valid_attributes = CONTEXT_extractAndValidateMetadata(data_buffer, &username, &filename, &filesize, &md5sum, &factor);
+        // 2- Extreiem i validem atributs directament de les dades de la trama
+        int valid_attributes = CONTEXT_extractAndValidateMetadata(response_frame->data, response_frame->data_length, &metadata);
 
         // 3- Enviem check_ok o check_ko al fleck
         if(!valid_attributes) {
-            COMM_sendConnectionResponse(fleck_socket, "CON_KO" , 0, 0x03);  // KO si els atributs no són vàlids
-            free(data_buffer);
+            COMM_sendConnectionResponse(fleck_socket, "CON_KO" , 0, 0x03, NULL);  // KO si els atributs no són vàlids
+            FRAME_destroyFrame(response_frame);
             return 0;
         }
         
-        // Si les metadades rebudes són vàlides responem amb un CHECK_OK
-        COMM_sendConnectionResponse(fleck_socket, NULL, 1, 0x03);  //OK
+        // Escollim la combinació més ràpida que suportem tots dos: si el fleck no ha anunciat cap capacitat és un peer v1
+        ConnectionOffer peer, offer;
+        COMM_getOfferMetadata(&metadata, &peer);
+        COMM_getLocalOffer(fleck_socket, params, &offer);
+        FRAME_negotiate(&peer, &offer, params);
+
+        // Un md5sum buit vol dir que el fleck l'enviarà darrere del fitxer (trama 0x14), cosa que només pot fer si s'ha acordat CONN_CAP_HASH_TRAILER
+        if(!*METADATA_getString(&metadata, METADATA_MD5SUM) && !(params->capabilities & CONN_CAP_HASH_TRAILER)) {
+            COMM_sendConnectionResponse(fleck_socket, "CON_KO" , 0, 0x03, NULL);
+            FRAME_destroyFrame(response_frame);
+            return 0;
+        }
 
-        // Inicialitzem les metadades del context de la distorsió. 
-        CONTEXT_initContextMetadata(distortion_context, filename, username, md5sum, filesize, factor, distortions_folder_path);
+        // Si conservem l'última versió que el fleck ens va enviar d'aquest fitxer, en rebrem només els canvis. El delta no va per paquets, així que no hi ha arbre de Merkle ni franges
+        if(params->capabilities & CONN_CAP_DELTA) {
+            *basis_path = CONTEXT_findDeltaBasis(distortions_folder_path, METADATA_getString(&metadata, METADATA_FILENAME), METADATA_getString(&metadata, METADATA_USERNAME));
+            if(!*basis_path) {
+                params->capabilities &= ~CONN_CAP_DELTA;
+            } else {
+                params->capabilities &= ~CONN_CAP_MERKLE;
+                params->stripes = 1;
+            }
+        }
+
+        // Si el fleck comprova els blocs ens envia l'arrel de l'arbre de Merkle del fitxer, que ha de ser vàlida per a la seva mida (les fulles arriben després de la resposta)
+        if((params->capabilities & CONN_CAP_MERKLE) && COMM_getMerkleMetadata(&metadata, &distortion_context->merkle, (off_t)METADATA_getNumber(&metadata, METADATA_FILE_SIZE, 0)) < 0) {
+            COMM_sendConnectionResponse(fleck_socket, "CON_KO" , 0, 0x03, NULL);
+            FRAME_destroyFrame(response_frame);
+            return 0;
+        }
+
+        // Dins d'una sessió el fleck pot enviar la combinació acordada en obrir-la sense esperar la resposta: només responem (amb un KO) si ara no hi estem d'acord
+        int pipelined = METADATA_getNumber(&metadata, METADATA_PIPELINED, 0) != 0;
+        if(pipelined && !COMM_matchesOffer(params, &peer)) {
+            COMM_sendConnectionResponse(fleck_socket, "CON_KO" , 0, 0x03, NULL);
+            FRAME_destroyFrame(response_frame);
+            return 0;
+        }
+
+        // Si les metadades rebudes són vàlides responem amb un CHECK_OK (amb la combinació escollida si el fleck és v2)
+        if(!pipelined) COMM_sendConnectionResponse(fleck_socket, NULL, 1, 0x03, params);  //OK
+
+        // Inicialitzem les metadades del context de la distorsió (en copia les cadenes, així que després ja podem alliberar la trama)
+        int init_successfull = CONTEXT_initContextMetadata(distortion_context, METADATA_getString(&metadata, METADATA_FILENAME), METADATA_getString(&metadata, METADATA_USERNAME), METADATA_getString(&metadata, METADATA_MD5SUM), (int)METADATA_getNumber(&metadata, METADATA_FILE_SIZE, 0), (int)METADATA_getNumber(&metadata, METADATA_FACTOR, 0), distortions_folder_path);
+        distortion_context->data_size = FRAME_getDataSize(params);
+        FRAME_destroyFrame(response_frame);
+        if(!init_successfull) return 0;
 
         // 4- Creem o recuperem el progrés de la distorsió
-        int fetch_successfull = CONTEXT_fetchDistortionContext(distortion_context, filename, shm_id);
-        free(data_buffer); 
+        int fetch_successfull = CONTEXT_fetchDistortionContext(distortion_context, distortion_context->filename, shm_id);
 
         if(!fetch_successfull) {
             IO_printStatic(STDOUT_FILENO, RED "ERROR: Failed to fetch distortion context\n" RESET); 
@@ -226,6 +302,44 @@ int COMM_retrieveFileMetadata(int fleck_socket, DistortionContext* distortion_co
         return 1; // Procés executat satisfactòriament 
     }
 
+    if(response_frame->type == 0x13) {
+        // La connexió s'afegeix com a franja a la distorsió d'aquest fitxer, que ja ha acordat el nombre de franges per la connexió principal
+        int valid_join = METADATA_decode(response_frame->data, response_frame->data_length, METADATA_MSG_STRIPE_JOIN, &metadata) == 0;
+        uint32_t index = valid_join ? METADATA_getNumber(&metadata, METADATA_STRIPE, 0) : 0;
+        if(!valid_join || index == 0 || index >= CONN_MAX_STRIPES) {
+            COMM_sendConnectionResponse(fleck_socket, "CON_KO", 0, 0x13, NULL);
+            FRAME_destroyFrame(response_frame);
+            return 0;
+        }
+
+        stripe->username = strdup(METADATA_getString(&metadata, METADATA_USERNAME));
+        stripe->filename = strdup(METADATA_getString(&metadata, METADATA_FILENAME));
+        stripe->index = (int)index;
+        stripe->socket = fleck_socket;
+        FRAME_destroyFrame(response_frame);
+        if(!stripe->username || !stripe->filename) {
+            freePointer((void**)&stripe->username);
+            freePointer((void**)&stripe->filename);
+            COMM_sendConnectionResponse(fleck_socket, "CON_KO", 0, 0x13, NULL);
+            return 0;
+        }
+
+        COMM_sendConnectionResponse(fleck_socket, NULL, 1, 0x13, NULL);  //OK buit
+        return COMM_STRIPE_JOIN;
+    }
+
+    if(response_frame->type == 0x1C) {
+        // El fleck vol fer servir la connexió per a totes les seves distorsions amb aquest worker, cadascuna en un stream. Si hi porta la seva oferta, la combinació de la sessió s'acorda ara
+        if(response_frame->data_length > 0 && METADATA_decode(response_frame->data, response_frame->data_length, METADATA_MSG_SESSION_OFFER, &metadata) == 0) {
+            ConnectionOffer peer, offer;
+            COMM_getOfferMetadata(&metadata, &peer);
+            COMM_getLocalOffer(fleck_socket, params, &offer);
+            FRAME_negotiate(&peer, &offer, params);
+        }
+        FRAME_destroyFrame(response_frame);
+        return COMM_SESSION_OPEN;
+    }
+
     FRAME_destroyFrame(response_frame);
     return 0; 
 }
@@ -233,11 +347,14 @@ int COMM_retrieveFileMetadata(int fleck_socket, DistortionContext* distortion_co
 /*********************************************** 
 * 
 * @Finalidad: Enviar los metadatos de un archivo distorsionado a un fleck mediante un socket. 
-*             Los metadatos incluyen el tamaño del archivo y su hash MD5. 
+*             Los metadatos incluyen el tamaño del archivo y su hash MD5 y, si la conexión 
+*             ha acordado `CONN_CAP_MERKLE`, la raíz de su árbol de Merkle, cuyas hojas se 
+*             envían justo después. 
 * 
 * @Parámetros: 
 * in: context = Estructura `DistortionContext` que contiene los metadatos del archivo distorsionado. 
 * in: fleck_socket = Descriptor del socket del fleck al que se enviarán los metadatos. 
+* in: params = Parámetros de trama acordados con el fleck (en binario si es v2, en texto si es v1). 
 * in: print_mutex = Puntero al mutex utilizado para sincronizar los mensajes de impresión. 
 * 
 * @Retorno: 
@@ -245,19 +362,26 @@ int COMM_retrieveFileMetadata(int fleck_socket, DistortionContext* distortion_co
 *           UNEXPECTED_ERROR = Error al enviar los metadatos. 
 * 
 ************************************************/
-int COMM_sendFleckFileMetadata(DistortionContext context, int fleck_socket, pthread_mutex_t* print_mutex) {
-    char* data = NULL;
+int COMM_sendFleckFileMetadata(DistortionContext context, int fleck_socket, const ConnectionParams* params, pthread_mutex_t* print_mutex) {
+    Metadata metadata;
+    char merkle_root[HASH_MD5_HEX_SIZE];
+    int merkle_tree = (params->capabilities & CONN_CAP_MERKLE) && context.merkle.n_chunks > 0;
     int success = 1; 
 
-    if(asprintf(&data, "%d&%s", context.filesize, context.md5sum) < 0) return 0; 
+    METADATA_init(&metadata);
+    METADATA_setNumber(&metadata, METADATA_FILE_SIZE, (uint32_t)context.filesize);
+    METADATA_setString(&metadata, METADATA_MD5SUM, context.md5sum);
+    if(merkle_tree) COMM_setMerkleMetadata(&metadata, &context.merkle, merkle_root);
 
-    Frame *metadata_frame = FRAME_createFrame(0x04, data, strlen(data)); 
-    if(FRAME_sendFrame(fleck_socket, metadata_frame) < 0) {
+    if(COMM_sendMetadata(fleck_socket, 0x04, &metadata, METADATA_MSG_FILE_RESULT, params) < 0) {
         STRING_printF(print_mutex, STDOUT_FILENO, RED, "ERROR: failed to send distorted file's metadata\n");
         success = 0;
     }
-    FRAME_destroyFrame(metadata_frame);
-    free(data);
+    // Les fulles de l'arbre de Merkle van just darrere de les metadades
+    else if(merkle_tree && COMM_sendMerkleLeaves(fleck_socket, &context.merkle, params) < 0) {
+        STRING_printF(print_mutex, STDOUT_FILENO, RED, "ERROR: failed to send distorted file's chunk hashes\n");
+        success = 0;
+    }
 
     STRING_printF(print_mutex, STDOUT_FILENO, MAGENTA, "Sent fleck distorted file's metadada\n");
     return success ? TRANSFER_SUCCESS : UNEXPECTED_ERROR;
@@ -269,16 +393,16 @@ int COMM_sendFleckFileMetadata(DistortionContext context, int fleck_socket, pthr
 *             de desconexión enviada por el fleck. 
 * 
 * @Parámetros: 
-* in: fleck_socket = Descriptor del socket del fleck que se desconecta. 
+* in/out: reader = Lector con buffer de la conexión del fleck que se desconecta. 
 * in: print_mutex = Mutex para sincronizar los mensajes de impresión. 
 * 
 * @Retorno: Ninguno. 
 * 
 ************************************************/
-void COMM_handleFleckDisconnection(int fleck_socket, pthread_mutex_t* print_mutex) {
+void COMM_handleFleckDisconnection(FrameReader *reader, pthread_mutex_t* print_mutex) {
     char* data = NULL;
 
-    FrameResult result = FRAME_receiveFrame(fleck_socket);
+    FrameResult result = FRAME_readerReceiveFrame(reader);
     if (result.error_code != FRAME_SUCCESS) {
         if (result.frame) FRAME_destroyFrame(result.frame);
         return;
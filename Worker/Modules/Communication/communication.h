@@ -40,6 +40,9 @@
 #define COMM_SIGINT_RECEIVED      2   
 #define COMM_PENDING              3   
 
+#define COMM_STRIPE_JOIN          2     // La connexió és una franja addicional d'una altra distorsió
+#define COMM_SESSION_OPEN         3     // La connexió és una sessió multiplexada (trama 0x1C), encara sense resposta
+
 
 #define UNEXPECTED_ERROR        -1
 #define REMOTE_END_DISCONNECTION 0
@@ -55,6 +58,7 @@
 * @Parámetros: 
 * in: gotham_socket = Descriptor del socket conectado al servidor Gotham. 
 * in: config = Puntero a la estructura `WorkerConfig` que contiene la configuración del worker. 
+* out: gotham_params = Parámetros de trama acordados con Gotham (v1 si Gotham no los negocia). 
 * 
 * @Retorno: 
 *           0 = Conexión establecida exitosamente. 
@@ -62,13 +66,24 @@
 *               devuelve un estado negativo. 
 * 
 ************************************************/
-int COMM_connectToGotham(int gotham_socket, WorkerConfig *config);
+int COMM_connectToGotham(int gotham_socket, WorkerConfig *config, ConnectionParams *gotham_params);
 
 /*********************************************** 
 * 
 * @Finalidad: Recibir y procesar los metadatos de un archivo enviados por un fleck, 
 *             validarlos, inicializar el contexto de distorsión, y gestionar el progreso 
-*             asociado a la distorsión. 
+*             asociado a la distorsión. Si en lugar de los metadatos llega una trama 0x13, 
+*             la conexión es una franja adicional de la distorsión de otra conexión del 
+*             mismo fleck: se confirma y se devuelve para que se registre. Si llega una trama 
+*             0x1C, el fleck quiere hacer de la conexión una sesión multiplexada; quien llama 
+*             decide si la acepta, y si lleva la oferta del fleck se acuerda con ella la 
+*             combinación de todas las distorsiones de la sesión. Una petición que la da 
+*             por acordada (`METADATA_PIPELINED`) no espera respuesta: solo se le responde 
+*             con CON_KO si la combinación ya no es la misma. Si la petición lleva la raíz del árbol de Merkle del 
+*             archivo, se prepara el árbol del contexto (sus hojas llegan después de la 
+*             respuesta). Si el fleck ofrece enviar el archivo como delta y este worker 
+*             conserva su última versión, se acepta (sin árbol de Merkle ni franjas, que 
+*             trabajan por paquetes). 
 * 
 * @Parámetros: 
 * in: fleck_socket = Descriptor del socket del fleck desde el cual se recibirán los metadatos. 
@@ -76,22 +91,32 @@ int COMM_connectToGotham(int gotham_socket, WorkerConfig *config);
 *                              los metadatos recibidos y procesados. 
 * in: distortions_folder_path = Ruta a la carpeta donde se almacenarán los archivos distorsionados. 
 * out: shm_id = Puntero al identificador de memoria compartida para gestionar el progreso. 
+* out: params = Parámetros de trama acordados con el fleck a partir de su petición (o de 
+*               la oferta de la sesión, con `COMM_SESSION_OPEN`). 
+* out: stripe = Franja a la que se une la conexión (solo con `COMM_STRIPE_JOIN`). 
+* out: basis_path = Ruta de la última versión del archivo si se ha acordado `CONN_CAP_DELTA`, 
+*                  o NULL. Se debe liberar. 
 * 
 * @Retorno: 
 *           1 = Los metadatos fueron recibidos y procesados correctamente. 
 *           0 = Error en la recepción, validación de atributos, o inicialización del contexto. 
+*           COMM_STRIPE_JOIN = La conexión es una franja de otra distorsión, ya confirmada. 
+*           COMM_SESSION_OPEN = El fleck pide una sesión multiplexada (aún sin respuesta). 
 * 
 ************************************************/
-int COMM_retrieveFileMetadata(int fleck_socket, DistortionContext* distortion_context, char* distortions_folder_path, int* shm_id);
+int COMM_retrieveFileMetadata(int fleck_socket, DistortionContext* distortion_context, char* distortions_folder_path, int* shm_id, ConnectionParams* params, PendingStripe* stripe, char** basis_path);
 
 /*********************************************** 
 * 
 * @Finalidad: Enviar los metadatos de un archivo distorsionado a un fleck mediante un socket. 
-*             Los metadatos incluyen el tamaño del archivo y su hash MD5. 
+*             Los metadatos incluyen el tamaño del archivo y su hash MD5 y, si la conexión 
+*             ha acordado `CONN_CAP_MERKLE`, la raíz de su árbol de Merkle, cuyas hojas se 
+*             envían justo después. 
 * 
 * @Parámetros: 
 * in: context = Estructura `DistortionContext` que contiene los metadatos del archivo distorsionado. 
 * in: fleck_socket = Descriptor del socket del fleck al que se enviarán los metadatos. 
+* in: params = Parámetros de trama acordados con el fleck (en binario si es v2, en texto si es v1). 
 * in: print_mutex = Puntero al mutex utilizado para sincronizar los mensajes de impresión. 
 * 
 * @Retorno: 
@@ -99,7 +124,7 @@ int COMM_retrieveFileMetadata(int fleck_socket, DistortionContext* distortion_co
 *           UNEXPECTED_ERROR = Error al enviar los metadatos. 
 * 
 ************************************************/
-int COMM_sendFleckFileMetadata(DistortionContext context, int fleck_socket, pthread_mutex_t* print_mutex);
+int COMM_sendFleckFileMetadata(DistortionContext context, int fleck_socket, const ConnectionParams* params, pthread_mutex_t* print_mutex);
 
 /*********************************************** 
 * 
@@ -125,11 +150,11 @@ int COMM_waitForMainWorkerAssignment(int gotham_socket, volatile int* exit_progr
 *             de desconexión enviada por el fleck. 
 * 
 * @Parámetros: 
-* in: fleck_socket = Descriptor del socket del fleck que se desconecta. 
+* in/out: reader = Lector con buffer de la conexión del fleck que se desconecta. 
 * in: print_mutex = Mutex para sincronizar los mensajes de impresión. 
 * 
 * @Retorno: Ninguno. 
 * 
 ************************************************/
-void COMM_handleFleckDisconnection(int fleck_socket, pthread_mutex_t* print_mutex);
+void COMM_handleFleckDisconnection(FrameReader *reader, pthread_mutex_t* print_mutex);
 #endif // _WORKER_COMMUNICATION_CUSTOM_H_
\ No newline at end of file
@@ -28,6 +28,11 @@ DistortionContext CONTEXT_initializeContext() {
     context.current_stage = 0;
     context.n_packets = 0;
     context.n_processed_packets = 0;
+    context.data_size = DATA_SIZE;
+    SACK_initMap(&context.received);
+    context.n_stripes = 0;
+    HASH_init(&context.hash);
+    MERKLE_init(&context.merkle);
     return context;
 }
 
@@ -99,44 +104,35 @@ int CONTEXT_updateWorkerCount(semaphore *sWorkerCountMutex, int increment, int t
 
 /*********************************************** 
 * 
-* @Finalidad: Extraer y validar los metadatos de un archivo a partir de una cadena de datos 
-*             en formato delimitado. 
+* @Finalidad: Extraer y validar los metadatos de un archivo a partir de los datos de la 
+*             trama 0x03, tanto en binario como en texto delimitado por `&`. 
 * 
 * @Parámetros: 
-* in: data_buffer = Cadena que contiene los metadatos delimitados por el carácter `&`. 
-* out: username = Puntero que recibirá el nombre del usuario. 
-* out: filename = Puntero que recibirá el nombre del archivo. 
-* out: filesize = Puntero que recibirá el tamaño del archivo. 
-* out: md5sum = Puntero que recibirá el hash MD5 del archivo. 
-* out: factor = Puntero que recibirá el factor de distorsión. 
+* in/out: data = Datos de la trama recibida. Los campos de texto extraídos apuntan a ellos. 
+* in: length = Número de bytes de `data`. 
+* out: metadata = Metadatos del archivo. La mida de dades y las opciones de trama solo 
+*                 están presentes si el fleck las anuncia (fleck v2). 
 * 
 * @Retorno: 
 *           1 = Los metadatos fueron extraídos y validados correctamente. 
 *           0 = Error en la extracción o alguno de los atributos es inválido. 
 * 
 ************************************************/
-int CONTEXT_extractAndValidateMetadata(char *data_buffer, char **username, char **filename, int *filesize, char **md5sum, int *factor) {
-    //extreiem els atributs del camp de dades 
-    *username = strtok(data_buffer, "&");
-    *filename = strtok(NULL, "&");
-    char *filesize_str = strtok(NULL, "&");
-    *md5sum = strtok(NULL, "&");
-    char *factor_str = strtok(NULL, "&");
-
-    //verifiquem que no hi ha cap atribut buit
-    if (!(*username) || !(*filename) || !filesize_str || !(*md5sum) || !factor_str) {
+int CONTEXT_extractAndValidateMetadata(uint8_t *data, size_t length, Metadata *metadata) {
+    //extreiem els atributs del camp de dades i verifiquem que no n'hi ha cap d'obligatori buit
+    if (METADATA_decode(data, length, METADATA_MSG_FILE_REQUEST, metadata) < 0) {
         return 0;  
     }
 
-    //convertim i validem filesize
-    *filesize = atoi(filesize_str);
-    if (*filesize <= 0) {
+    //validem filesize (el context el desa com a int)
+    uint32_t filesize = METADATA_getNumber(metadata, METADATA_FILE_SIZE, 0);
+    if (filesize == 0 || filesize > INT_MAX) {
         return 0;  //filesize no vàlid
     }
 
-    //convertim i validem factor
-    *factor = atoi(factor_str);
-    if (*factor <= 0) {
+    //validem factor
+    uint32_t factor = METADATA_getNumber(metadata, METADATA_FACTOR, 0);
+    if (factor == 0 || factor > INT_MAX) {
         return 0;  //factor no vàlid
     }
 
@@ -154,24 +150,31 @@ int CONTEXT_extractAndValidateMetadata(char *data_buffer, char **username, char
 * in: current_stage = Etapa actual de la distorsión en caso de reanudarla. 
 * in: shm_total_packets = Número total de paquetes almacenados en memoria compartida (usado al reanudar). 
 * in: n_processed_packets = Número de paquetes ya procesados en caso de reanudación. 
+* in: processed_data_size = Tamaño de paquete con el que se contaron `n_processed_packets`. 
+*                           Si difiere del acordado con el fleck actual, se convierten a bytes. 
 * 
 * @Retorno: 
 *           1 = Inicialización exitosa. 
 * 
 ************************************************/
-int CONTEXT_initDistortionProgress(DistortionContext* distortion_context, int current_stage, int n_processed_packets) {
+int CONTEXT_initDistortionProgress(DistortionContext* distortion_context, int current_stage, int n_processed_packets, int processed_data_size) {
     // Inicialitzem etapa de distorsió a "recepció del fitxer"
     distortion_context->current_stage = current_stage;
 
-    int total_packets = distortion_context->filesize / DATA_SIZE;
-    if (distortion_context->filesize % DATA_SIZE != 0) {
+    // Comptem els paquets amb la mida de dades acordada amb el fleck
+    int data_size = distortion_context->data_size;
+    int total_packets = distortion_context->filesize / data_size;
+    if (distortion_context->filesize % data_size != 0) {
         total_packets++;
     }
 
     // Inicialitzem el nombre de paquets
     distortion_context->n_packets = total_packets; 
 
-    // Inicialitzem paquets processats
+    // Inicialitzem paquets processats. Si la distorsió es va començar amb una altra mida de paquet, arrodonim cap avall per no deixar forats al fitxer
+    if (processed_data_size > 0 && processed_data_size != data_size) {
+        n_processed_packets = (int)(((long long)n_processed_packets * processed_data_size) / data_size);
+    }
     distortion_context->n_processed_packets = n_processed_packets; 
 
     return 1;
@@ -258,9 +261,29 @@ int CONTEXT_fetchDistortionContext(DistortionContext* distortion_context, char*
     }
 
     // 5- Preparem la distorsió segons si l'hem d'iniciar o resumir
-    int init_ok = CONTEXT_initDistortionProgress(distortion_context, resume_distortion ? distortion_progress->current_stage : STAGE_RECV_FILE,  resume_distortion ? distortion_progress->n_processed_packets : 0); 
+    int init_ok = CONTEXT_initDistortionProgress(distortion_context, resume_distortion ? distortion_progress->current_stage : STAGE_RECV_FILE,  resume_distortion ? distortion_progress->n_processed_packets : 0, resume_distortion ? distortion_progress->data_size : distortion_context->data_size); 
 
     if(resume_distortion) { 
+        // Recuperem els paquets del fitxer original que ja es van escriure, encara que no fossin consecutius, perquè el fleck només enviï els que falten
+        int valid_ranges = distortion_progress->n_ranges > 0 && distortion_progress->n_ranges <= DIST_MAX_RANGES;
+        int valid_stripes = distortion_progress->n_stripes > 0 && distortion_progress->n_stripes <= DIST_MAX_STRIPES;
+        if (init_ok && distortion_progress->current_stage == STAGE_RECV_FILE && (valid_ranges || valid_stripes)) {
+            init_ok = SACK_fromRanges(&distortion_context->received, distortion_progress->n_packets, distortion_progress->data_size, distortion_progress->ranges, valid_ranges ? distortion_progress->n_ranges : 0) == 0;
+
+            // Si el fitxer es rebia en franges, el principi de cada franja es conserva encara que no hi hagin cabut tots els trams
+            for (int i = 0; init_ok && valid_stripes && i < distortion_progress->n_stripes; i++) {
+                DistortionStripe stripe = distortion_progress->stripes[i];
+                for (int packet = stripe.first_packet; packet < stripe.first_packet + stripe.n_received; packet++) {
+                    SACK_markReceived(&distortion_context->received, packet);
+                }
+                IO_printFormat(STDOUT_FILENO, MAGENTA "Stripe %d: %d of %d packets already received\n" RESET, i, stripe.n_received, stripe.n_packets);
+            }
+        }
+
+        // Continuem el MD5 des d'on el va deixar l'altre worker, sense rellegir la part del fitxer que ja havia resumit
+        if (distortion_progress->hash.length > 0 && distortion_progress->hash.length <= (uint64_t)distortion_context->filesize) {
+            distortion_context->hash = distortion_progress->hash;
+        }
         if (shmdt(distortion_progress) == -1 || !init_ok) return 0;
         float progress_percentage = getProgressPercentage(*distortion_context);
         IO_printFormat(STDOUT_FILENO, MAGENTA "Fetched distortion context. Current progress: %d%%. Resuming distortion...\n" RESET, (int)progress_percentage);
@@ -292,7 +315,7 @@ int CONTEXT_fetchDistortionContext(DistortionContext* distortion_context, char*
 *           0 = Error durante la asignación de memoria o construcción de rutas. 
 * 
 ************************************************/
-int CONTEXT_initContextMetadata(DistortionContext* distortion_context, char* filename, char* username, char* md5sum, int filesize, int factor, char* distortions_folder_path) {
+int CONTEXT_initContextMetadata(DistortionContext* distortion_context, const char* filename, const char* username, const char* md5sum, int filesize, int factor, char* distortions_folder_path) {
     // Creem i assignem el path del fitxer a distorsionar
     distortion_context->file_path = FILE_buildPrivateFilePath(distortions_folder_path, filename, username);
     if (!distortion_context->file_path) return 0;
@@ -312,4 +335,35 @@ int CONTEXT_initContextMetadata(DistortionContext* distortion_context, char* fil
     distortion_context->factor = factor;
 
     return 1;
-}
\ No newline at end of file
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Buscar la última versión que este worker conserva de un archivo de un usuario, 
+*             respecto a la cual el fleck puede enviar solo los cambios. No se usa si hay una 
+*             distorsión del archivo a medias, que se reanuda por paquetes. 
+* 
+* @Parámetros: 
+* in: distortions_folder_path = Ruta al directorio donde se procesan los archivos. 
+* in: filename = Nombre del archivo. 
+* in: username = Nombre del usuario asociado al archivo. 
+* 
+* @Retorno: 
+*           Ruta de la versión conservada (se debe liberar). 
+*           NULL si no hay ninguna, si se debe reanudar la distorsión o si falla la memoria. 
+* 
+************************************************/
+char* CONTEXT_findDeltaBasis(char* distortions_folder_path, const char* filename, const char* username) {
+    char* shared_file_path = FILE_buildSharedFilePath((char*)filename, (char*)username);
+    if (!shared_file_path) return NULL;
+    int resume_distortion = DIR_directoryExists(shared_file_path);
+    free(shared_file_path);
+    if (resume_distortion) return NULL;
+
+    char* basis_path = FILE_buildBasisFilePath(distortions_folder_path, filename, username);
+    if (basis_path && access(basis_path, R_OK) != 0) freePointer((void**)&basis_path);
+
+    // Marquem la versió com a usada perquè sigui l'última que es descarti en retallar la carpeta
+    if (basis_path) FILE_touchBasisFile(basis_path);
+    return basis_path;
+}
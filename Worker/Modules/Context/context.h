@@ -25,6 +25,7 @@
 #include <sys/ipc.h>
 #include <sys/shm.h>
 #include <errno.h>
+#include <limits.h>
 
 //Llibreries pròpies
 #include "../../../Libs/IO/io.h"                          // Per a les funcions d'entrada/sortida
@@ -32,6 +33,10 @@
 #include "../../../Libs/File/file.h"                      // Per a les funcions de manipulació de fitxers
 #include "../../../Libs/Dir/dir.h"                        // Per a les funcions de manipulació de directoris
 #include "../../../Libs/Frame/frame.h"                    // Per a les funcions de creació i destrucció de trames
+#include "../../../Libs/Metadata/metadata.h"              // Per a la decodificació de les metadades del fitxer
+#include "../../../Libs/Sack/sack.h"                      // Per reconstruir els paquets rebuts en reprendre una distorsió
+#include "../../../Libs/Hash/hash.h"                      // Per continuar el MD5 del fitxer en reprendre una distorsió
+#include "../../../Libs/Hash/merkle.h"                    // Per inicialitzar l'arbre de blocs del fitxer
 
 //.h estructures
 #include "../../typeWorker.h"           // Per a les estructures de configuració de Worker
@@ -59,23 +64,21 @@ int CONTEXT_updateWorkerCount(semaphore *sWorkerCountMutex, int increment, int t
 
 /*********************************************** 
 * 
-* @Finalidad: Extraer y validar los metadatos de un archivo a partir de una cadena de datos 
-*             en formato delimitado. 
+* @Finalidad: Extraer y validar los metadatos de un archivo a partir de los datos de la 
+*             trama 0x03, tanto en binario como en texto delimitado por `&`. 
 * 
 * @Parámetros: 
-* in: data_buffer = Cadena que contiene los metadatos delimitados por el carácter `&`. 
-* out: username = Puntero que recibirá el nombre del usuario. 
-* out: filename = Puntero que recibirá el nombre del archivo. 
-* out: filesize = Puntero que recibirá el tamaño del archivo. 
-* out: md5sum = Puntero que recibirá el hash MD5 del archivo. 
-* out: factor = Puntero que recibirá el factor de distorsión. 
+* in/out: data = Datos de la trama recibida. Los campos de texto extraídos apuntan a ellos. 
+* in: length = Número de bytes de `data`. 
+* out: metadata = Metadatos del archivo. La mida de dades y las opciones de trama solo 
+*                 están presentes si el fleck las anuncia (fleck v2). 
 * 
 * @Retorno: 
 *           1 = Los metadatos fueron extraídos y validados correctamente. 
 *           0 = Error en la extracción o alguno de los atributos es inválido. 
 * 
 ************************************************/
-int CONTEXT_extractAndValidateMetadata(char *data_buffer, char **username, char **filename, int *filesize, char **md5sum, int *factor);
+int CONTEXT_extractAndValidateMetadata(uint8_t *data, size_t length, Metadata *metadata);
 
 /*********************************************** 
 * 
@@ -114,7 +117,25 @@ int CONTEXT_fetchDistortionContext(DistortionContext* distortion_context, char*
 *           0 = Error durante la asignación de memoria o construcción de rutas. 
 * 
 ************************************************/
-int CONTEXT_initContextMetadata(DistortionContext* distortion_context, char* filename, char* username, char* md5sum, int filesize, int factor, char* distortions_folder_path);
+int CONTEXT_initContextMetadata(DistortionContext* distortion_context, const char* filename, const char* username, const char* md5sum, int filesize, int factor, char* distortions_folder_path);
+
+/*********************************************** 
+* 
+* @Finalidad: Buscar la última versión que este worker conserva de un archivo de un usuario, 
+*             respecto a la cual el fleck puede enviar solo los cambios. No se usa si hay una 
+*             distorsión del archivo a medias, que se reanuda por paquetes. 
+* 
+* @Parámetros: 
+* in: distortions_folder_path = Ruta al directorio donde se procesan los archivos. 
+* in: filename = Nombre del archivo. 
+* in: username = Nombre del usuario asociado al archivo. 
+* 
+* @Retorno: 
+*           Ruta de la versión conservada (se debe liberar). 
+*           NULL si no hay ninguna, si se debe reanudar la distorsión o si falla la memoria. 
+* 
+************************************************/
+char* CONTEXT_findDeltaBasis(char* distortions_folder_path, const char* filename, const char* username);
 
 DistortionContext CONTEXT_initializeContext();
 
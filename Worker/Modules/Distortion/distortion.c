@@ -172,8 +172,8 @@ int DIST_distortText(char* original_file, char* tmp_file, int threshold) {
 /*********************************************** 
 * 
 * @Finalidad: Distorsionar un archivo de acuerdo a su tipo (texto, audio o imagen), 
-*             aplicando un factor específico y reemplazando el archivo original 
-*             con el contenido distorsionado. 
+*             aplicando un factor específico y sustituyendo el archivo original por el 
+*             distorsionado con `rename`, sin reescribir el original. 
 * 
 * @Parámetros: 
 * in/out: context = Puntero a la estructura `sDistortionContext` que contiene los metadatos del archivo. 
@@ -221,14 +221,13 @@ int DIST_distortFile(DistortionContext context, char* folder_path, pthread_mutex
         return distortion_result;  
     }
 
-    // Reemplacem el contingut del fitxer original amb el del fitxer temporal
-    if (FILE_replaceFile(tmp_file, context.file_path) < 0) {
+    // Substituïm el fitxer original pel temporal sense reescriure'l: si s'ha conservat com a versió de referència per als deltes, l'enllaç continua apuntant a l'original
+    if (rename(tmp_file, context.file_path) < 0) {
         SO_deleteImage(tmp_file);
         free(tmp_file);
         return DISTORTION_FAILED;
     }
 
-    SO_deleteImage(tmp_file);
     free(tmp_file);
     STRING_printF(print_mutex, STDOUT_FILENO, GREEN, "Compression successful\n");
     return DISTORTION_SUCCESSFUL;
@@ -237,34 +236,109 @@ int DIST_distortFile(DistortionContext context, char* folder_path, pthread_mutex
 /*********************************************** 
 * 
 * @Finalidad: Configurar el contexto de distorsión actualizando el tamaño del archivo, 
-*             el hash MD5 y el progreso de la distorsión. 
+*             el hash MD5 y el progreso de la distorsión. Si el MD5 se enviará al final 
+*             del archivo, se deja vacío y se calculará durante el envío. 
 * 
 * @Parámetros: 
 * in/out: context = Puntero a la estructura `sDistortionContext` que será configurada. 
+* in: digest_trailer = 1 si la conexión ha acordado `CONN_CAP_HASH_TRAILER`. 
+* in: merkle_tree = 1 si la conexión ha acordado `CONN_CAP_MERKLE`. Si el archivo tiene al 
+*                  menos `MERKLE_MIN_FILE_SIZE` bytes se calcula su árbol, que en la misma 
+*                  lectura completa el MD5. 
 * 
 * @Retorno: 
 *           1 = El contexto fue configurado correctamente. 
 *           0 = Error durante la configuración del contexto. 
 * 
 ************************************************/
-int DIST_setupDistortionContext(DistortionContext* context) {    
+int DIST_setupDistortionContext(DistortionContext* context, int digest_trailer, int merkle_tree) {    
     context->filesize = FILE_getFileSize(context->file_path);
     if (context->filesize < 0) return 0; 
 
+    // L'md5sum del fitxer distorsionat es calcula mentre s'envia i va darrere dels paquets; si el fleck no ho suporta, el calculem ara llegint el fitxer
     freePointer((void**)&(context->md5sum)); // Alliberem l'md5sum del fitxer original
-    context->md5sum = FILE_calculateMD5(context->file_path); // Assignem l'md5sum del fitxer distorsionat
+    HASH_init(&context->hash);
+    // Si el fleck comprova els blocs i el fitxer és gran, l'arbre de Merkle es calcula ara amb blocs de paquets sencers i la mateixa lectura ja dona l'md5sum
+    MERKLE_free(&context->merkle);
+    merkle_tree = merkle_tree && context->filesize >= MERKLE_MIN_FILE_SIZE;
+    if (merkle_tree && MERKLE_build(&context->merkle, context->file_path, MERKLE_chooseChunkSize(context->filesize, context->data_size), &context->hash) < 0) return 0;
+    context->md5sum = digest_trailer && !merkle_tree ? strdup("") : HASH_completeFile(&context->hash, context->file_path);
     if (!context->md5sum) return 0;
 
-    context->n_packets = context->filesize / DATA_SIZE;
-    if (context->filesize % DATA_SIZE != 0) {
+    // Comptem els paquets amb la mida de dades acordada amb el fleck
+    context->n_packets = context->filesize / context->data_size;
+    if (context->filesize % context->data_size != 0) {
         (context->n_packets)++;
     }
 
     context->n_processed_packets = 0;
+    SACK_freeMap(&context->received); // El bitmap de paquets rebuts era del fitxer original
+    context->n_stripes = 0;
 
     return 1;
 }
 
+/*********************************************** 
+* 
+* @Finalidad: Atender un stream que el fleck abre en su sesión multiplexada: cada stream 
+*             es una distorsión, que se maneja en un hilo propio igual que una conexión 
+*             aceptada por el servidor. 
+* 
+* @Parámetros: 
+* in: arg = Argumentos del hilo de la sesión (`DistortionThreadArgsW`). 
+* in: stream_socket = Socket del stream. 
+* in: id = Identificador del stream en la sesión. 
+* 
+* @Retorno: 
+*           0 = Se ha lanzado el hilo de la distorsión, que cerrará el stream. 
+*          -1 = El worker se está cerrando o no se ha podido lanzar el hilo. 
+* 
+************************************************/
+static int DIST_acceptStream(void* arg, int stream_socket, uint32_t id) {
+    DistortionThreadArgsW* session_args = (DistortionThreadArgsW*)arg;
+    if(*(session_args->exit_distortion)) return -1;
+
+    DistortionThreadArgsW* args = DIST_initDistortionArgs(session_args->server, session_args->distortions_folder_path, session_args->exit_distortion, session_args->sWorkerCountMutex, session_args->file_type, stream_socket, session_args->print_mutex);
+    if(!args) return -1;
+
+    pthread_t distorsion_thread;
+    if(pthread_create(&distorsion_thread, NULL, DIST_handleFileDistortion, (void *)args) != 0) {
+        STRING_printF(session_args->print_mutex, STDOUT_FILENO, RED, "Failed to create distortion thread\n");
+        free(args);
+        return -1;
+    }
+
+    // Com al servidor, el stream i el thread queden a les llistes de l'estructura de servidor (el socket el tanca el thread en acabar)
+    MC_addClient(session_args->server, stream_socket);
+    MC_addActiveThread(session_args->server, distorsion_thread);
+    STRING_printF(session_args->print_mutex, STDOUT_FILENO, GREEN, "\nNew distortion on stream %u of the fleck's session\n", id);
+    return 0;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Servir la sesión multiplexada que el fleck ha abierto sobre la conexión del 
+*             hilo hasta que la cierra, cae o el worker se cierra. 
+* 
+* @Parámetros: 
+* in: thread_args = Argumentos del hilo, con la conexión de la sesión. 
+* 
+* @Retorno: Ninguno. 
+* 
+************************************************/
+static void DIST_serveSession(DistortionThreadArgsW* thread_args) {
+    MuxSession* session = MUX_createSession(thread_args->client_socket, MUX_SERVER, DIST_acceptStream, thread_args);
+    if(!session) return;
+
+    STRING_printF(thread_args->print_mutex, STDOUT_FILENO, GREEN, "Fleck opened a multiplexed session, its distortions will arrive as streams\n");
+    MUX_runSession(session, thread_args->exit_distortion);
+
+    MuxStats stats;
+    MUX_getStats(session, &stats);
+    STRING_printF(thread_args->print_mutex, STDOUT_FILENO, YELLOW, "Multiplexed session closed after %d distortions (%lu control frames sent ahead of file data)\n", stats.streams, stats.preemptions);
+    MUX_destroySession(session);
+}
+
 /*********************************************** 
 * 
 * @Finalidad: Manejar el proceso completo de distorsión de un archivo en un hilo dedicado, 
@@ -289,26 +363,125 @@ void* DIST_handleFileDistortion(void* args) {
 
     DistortionContext distortion_context = CONTEXT_initializeContext();   // Estructura de context de distorsió que emmagatzemarà el progrés de la distorsió de manera que si cau el worker principal, el worker que prengui el relleu la pugui resumir
     int shm_id = 0;                                                       // Identificador associat a la regió de memòria compartida on es troba el context de la distorsió
+    ConnectionParams connection_params;                                   // Format de trama i mida de paquet acordats amb el fleck en el handshake 0x03
+    FramePool frame_pool;                                                 // Trames reutilitzables per rebre i enviar el fitxer sense reservar memòria per paquet
+    FrameReader frame_reader;                                             // Lector amb buffer de les trames que arriben del fleck
     int finished_distortion = 0;                                          // Flag per a sortir del bucle de distorsió
+    PendingStripe stripe_join;                                            // Franja a què s'afegeix la connexió si no és la principal d'una distorsió
+    int stripe_sockets[CONN_MAX_STRIPES] = {client_socket};               // Connexions per on es rep el fitxer original (la 0 és la principal)
+    int n_stripe_sockets = 1;
+    char* basis_path = NULL;                                              // Última versió que conservem del fitxer, si el fleck ens l'envia com a delta
+    DeltaSignature delta_signature = DELTA_EMPTY_SIGNATURE;               // Signatura d'aquesta versió que s'envia al fleck
+
+    // La finestra, les capacitats que s'ofereixen al fleck i el motor d'E/S les fixa la configuració d'aquest worker
+    FRAME_initLegacyParams(&connection_params);
+    connection_params.window_size = server->window_size;
+    connection_params.local.window_size = server->window_size;
+    connection_params.local.capabilities = server->capabilities;
+    connection_params.io_engine = server->io_engine;
+    connection_params.local.stripes = CONN_MAX_STRIPES;
+    FRAME_initPool(&frame_pool);
+    FRAME_initReader(&frame_reader);
 
     // 1- Rebem metadades del fitxer a distorsionar i, a partir d'aquestes, recuperem o creem el context de distorsió
-    int stage_successfull = COMM_retrieveFileMetadata(client_socket, &distortion_context, thread_args->distortions_folder_path, &shm_id);
-    if(!stage_successfull) goto exit_thread;
+    // El handshake és la primera trama de la connexió i es llegeix directament del socket; a partir d'aquí tot passa pel lector
+    int stage_successfull = COMM_retrieveFileMetadata(client_socket, &distortion_context, thread_args->distortions_folder_path, &shm_id, &connection_params, &stripe_join, &basis_path);
+    if(stage_successfull == COMM_SESSION_OPEN && !server->multiplex) {
+        // Sense sessions per configuració, el fleck fa servir la connexió per a una sola distorsió i ens envia les metadades
+        COMM_sendConnectionResponse(client_socket, "CON_KO", 0, 0x1C, NULL);
+        stage_successfull = COMM_retrieveFileMetadata(client_socket, &distortion_context, thread_args->distortions_folder_path, &shm_id, &connection_params, &stripe_join, &basis_path);
+        if(stage_successfull == COMM_SESSION_OPEN) stage_successfull = 0;
+    }
+    if(stage_successfull == COMM_SESSION_OPEN) {
+        // La connexió transportarà totes les distorsions d'aquest fleck amb nosaltres: aquest thread la serveix i cada stream té el seu thread de distorsió.
+        // La resposta porta la combinació acordada per a les distorsions de la sessió (buida si el fleck no ha enviat la seva oferta)
+        COMM_sendConnectionResponse(client_socket, NULL, 1, 0x1C, &connection_params);
+        DIST_serveSession(thread_args);
+        MC_removeClient(server, client_socket);
+        EXIT_cleanupDistortionContext(&distortion_context);
+        FRAME_destroyPool(&frame_pool);
+        FRAME_destroyReader(&frame_reader);
+        free(args);
+        return NULL;
+    }
+    if(stage_successfull == COMM_STRIPE_JOIN) {
+        // La connexió és una franja d'una altra distorsió: es queda a la llista de clients fins que la reculli el thread d'aquella distorsió
+        if(MC_addPendingStripe(server, &stripe_join) < 0) {
+            free(stripe_join.username);
+            free(stripe_join.filename);
+            MC_removeClient(server, client_socket);
+        }
+        EXIT_cleanupDistortionContext(&distortion_context);
+        FRAME_destroyPool(&frame_pool);
+        FRAME_destroyReader(&frame_reader);
+        free(args);
+        return NULL;
+    }
+    if(!stage_successfull || FRAME_resetReader(&frame_reader, client_socket) < 0) goto exit_thread;
+
+    // Els fitxers d'aquest fleck es reben i s'envien dins de la part de l'amplada de banda configurada que li correspon (totes les seves connexions la comparteixen)
+    connection_params.shaper = SHAPER_getUser(&server->shaper, distortion_context.username);
+
+    // Si el fleck ens ha enviat l'arrel de l'arbre de Merkle del fitxer, les fulles arriben just després de la resposta a les metadades
+    if(distortion_context.merkle.n_chunks > 0 && COMM_retrieveMerkleLeaves(&frame_reader, &distortion_context.merkle, WORKER, thread_args->print_mutex) != TRANSFER_SUCCESS) goto exit_thread;
+
+    // Si el fleck ens enviarà el fitxer com a delta, li enviem la signatura de la versió que conservem perquè hi busqui els blocs que no han canviat
+    if(basis_path && (DELTA_buildSignature(&delta_signature, basis_path, DELTA_chooseBlockSize(FILE_getFileSize(basis_path))) < 0 || COMM_sendDeltaSignature(client_socket, &delta_signature, &connection_params) < 0)) goto exit_thread;
+
+    // Si el fleck repartirà el fitxer en franges, recollim les seves connexions addicionals (si no arriben totes, el fitxer es rep per la principal)
+    if(connection_params.stripes > 1 && MC_takePendingStripes(server, distortion_context.username, distortion_context.filename, stripe_sockets, connection_params.stripes, exit_distortion) == 0) {
+        n_stripe_sockets = connection_params.stripes;
+    }
+    // Si en reprendre la distorsió el fitxer original ja s'havia rebut, les franges no s'utilitzaran
+    for(; n_stripe_sockets > 1 && distortion_context.current_stage != STAGE_RECV_FILE; n_stripe_sockets--) {
+        MC_removeClient(server, stripe_sockets[n_stripe_sockets - 1]);
+    }
 
     // Iniciem o resumim la distorsió a partir de la fase indicada a l'estructura de context. Implementem un bucle per a poder llegir la flag "exit_distorsion" cada vegada que completem una fase. 
     while(!*(exit_distortion) && !finished_distortion) {
         switch(distortion_context.current_stage) {
             case STAGE_RECV_FILE: 
                 // 2- Rebem el fitxer a distorsionar
-                int recv_result = COMM_receiveFile(distortion_context.file_path, distortion_context.filename, distortion_context.n_packets, &(distortion_context.n_processed_packets), client_socket, exit_distortion, WORKER, thread_args->print_mutex);
+                int recv_result;
+                int inline_digest = 0;      // L'md5sum arriba darrere de l'últim paquet i el recull COMM_receiveFile
+                FileTransfer recv_transfer;
+                if(basis_path) {
+                    // El fitxer es reconstrueix a partir de la versió que conservem i els canvis que ens envia el fleck
+                    recv_result = COMM_receiveFileDelta(distortion_context.file_path, basis_path, distortion_context.filename, distortion_context.filesize, &delta_signature, &(distortion_context.hash), &connection_params, &frame_pool, &frame_reader, exit_distortion, WORKER, thread_args->print_mutex);
+                    if(recv_result == TRANSFER_SUCCESS) distortion_context.n_processed_packets = distortion_context.n_packets;
+                } else if(n_stripe_sockets > 1) {
+                    // El progrés de cada franja es desa a la memòria compartida, tant si la recepció acaba com si no
+                    distortion_context.n_stripes = n_stripe_sockets;
+                    COMM_initTransfer(&recv_transfer, &distortion_context, &frame_pool, &frame_reader, exit_distortion, WORKER, thread_args->print_mutex);
+                    recv_result = COMM_receiveFileStriped(&recv_transfer, distortion_context.stripes, stripe_sockets, n_stripe_sockets, &connection_params);
+                } else {
+                    inline_digest = COMM_hasInlineDigest(&connection_params);
+                    COMM_initTransfer(&recv_transfer, &distortion_context, &frame_pool, &frame_reader, exit_distortion, WORKER, thread_args->print_mutex);
+                    recv_result = COMM_receiveFile(&recv_transfer, client_socket, &connection_params);
+                }
                 if(recv_result != TRANSFER_SUCCESS) goto exit_thread; // Tant si cau fleck com si hi ha error inesperat abortem distorsió
+
+                // Darrere dels paquets el fleck ens envia l'md5sum del fitxer, que ha calculat mentre l'enviava
+                if((connection_params.capabilities & CONN_CAP_HASH_TRAILER) && !inline_digest) {
+                    if(COMM_retrieveFileDigest(&frame_reader, &distortion_context.md5sum, WORKER, thread_args->print_mutex) != TRANSFER_SUCCESS) goto exit_thread;
+                }
                 
                 distortion_context.current_stage = STAGE_CHECK_MD5; // Actualitzem estat de la distorsió a "comprovant md5"
             break; 
             case STAGE_CHECK_MD5:
                 // 3- Comparem md5sum de les metadades amb md5sum del fitxer reconstruït. Enviem trama pertinent a fleck
-                int verify_status = COMM_verifyFileIntegrity(distortion_context.file_path, distortion_context.md5sum, client_socket, thread_args->print_mutex);
-                if(verify_status != TRANSFER_SUCCESS) goto exit_thread; // Tant si no coincideix l'md5 com si falla el send degut a un ctrl+c (tanca els sockets de clients) abortem distorsió. 
+                int verify_status = COMM_verifyFileIntegrity(distortion_context.file_path, distortion_context.md5sum, &(distortion_context.hash), client_socket, thread_args->print_mutex);
+                if(verify_status != TRANSFER_SUCCESS) {
+                    // Si el fitxer reconstruït a partir d'un delta no coincideix, no ens podem fiar de la versió conservada: l'esborrem perquè en reintentar el fleck l'enviï sencer
+                    if(basis_path) unlink(basis_path);
+                    goto exit_thread; // Tant si no coincideix l'md5 com si falla el send degut a un ctrl+c (tanca els sockets de clients) abortem distorsió. 
+                }
+
+                // Abans de distorsionar-lo, enllacem el fitxer original com a versió de referència per al pròxim delta (DIST_distortFile el substitueix per un fitxer nou, no el reescriu)
+                // Si no es pot conservar, la distorsió continua igualment: el pròxim enviament anirà sencer o contra la versió anterior, que es manté intacta
+                if(FILE_keepBasisFile(thread_args->distortions_folder_path, distortion_context.filename, distortion_context.username, distortion_context.file_path) < 0) {
+                    STRING_printF(thread_args->print_mutex, STDOUT_FILENO, RED, "Error: Could not keep the file for future deltas\n");
+                }
 
                 distortion_context.current_stage = STAGE_DISTORT; // Actualitzem estat de la distorsió a "distorsionant"
             break;
@@ -320,25 +493,30 @@ void* DIST_handleFileDistortion(void* args) {
             break;
             case STAGE_SND_METADATA:
                 // Una vegada la fase de processament del fitxer original ha estat completada, la informació que conté l'estrcutura de context ha de referenciar el fitxer distorionat
-                int update_success = DIST_setupDistortionContext(&distortion_context); 
+                int update_success = DIST_setupDistortionContext(&distortion_context, connection_params.capabilities & CONN_CAP_HASH_TRAILER, (connection_params.capabilities & CONN_CAP_MERKLE) != 0); 
                 if(update_success <= 0) goto exit_thread;
                 // 5- Enviem metadades del fitxer distorsionat
-                if(COMM_sendFleckFileMetadata(distortion_context, client_socket, thread_args->print_mutex) != TRANSFER_SUCCESS) goto exit_thread;
+                if(COMM_sendFleckFileMetadata(distortion_context, client_socket, &connection_params, thread_args->print_mutex) != TRANSFER_SUCCESS) goto exit_thread;
 
                 distortion_context.current_stage = STAGE_SND_FILE; // Actualitzem estat de la distorsió a "enviant fitxer"
             break;
             case STAGE_SND_FILE:
                 // 6- Enviem fitxer distorsionat a fleck i processem resposta de comprovació d'md5
-                int snd_result = COMM_sendFile(distortion_context.file_path, distortion_context.filename, distortion_context.n_packets, &(distortion_context.n_processed_packets), client_socket, exit_distortion, WORKER, thread_args->print_mutex);
+                FileTransfer snd_transfer;
+                COMM_initTransfer(&snd_transfer, &distortion_context, &frame_pool, &frame_reader, exit_distortion, WORKER, thread_args->print_mutex);
+                int snd_result = COMM_sendFile(&snd_transfer, client_socket, &connection_params);
                 if(snd_result != TRANSFER_SUCCESS) goto exit_thread;
 
+                // L'md5sum del fitxer distorsionat va darrere dels paquets (amb CONN_CAP_PIPELINE ja l'ha enviat COMM_sendFile)
+                if((connection_params.capabilities & CONN_CAP_HASH_TRAILER) && !COMM_hasInlineDigest(&connection_params) && COMM_sendFileDigest(client_socket, &(distortion_context.hash), &connection_params) < 0) goto exit_thread;
+
                 // Processem verificació de l'md5 del fleck
-                int check_ok = COMM_retrieveMD5Check(client_socket, WORKER, thread_args->print_mutex);
+                int check_ok = COMM_retrieveMD5Check(&frame_reader, WORKER, thread_args->print_mutex);
                 if(check_ok != TRANSFER_SUCCESS) goto exit_thread;
                 distortion_context.current_stage = STAGE_FINISHED; // Actualitzem estat de la distorsió a "enviant fitxer"
             break; 
             case STAGE_FINISHED:
-                COMM_handleFleckDisconnection(client_socket, thread_args->print_mutex); 
+                COMM_handleFleckDisconnection(&frame_reader, thread_args->print_mutex); 
                 finished_distortion = 1;
             break;
         }
@@ -346,10 +524,16 @@ void* DIST_handleFileDistortion(void* args) {
 exit_thread:
     STRING_printF(thread_args->print_mutex, STDOUT_FILENO, YELLOW, "Exiting distortion thread...\n");
 
-    MC_removeClient(server, client_socket); // Eliminem el socket del fleck de la llista de clients connectats
+    // El progrés es desa abans de tancar la connexió: el fleck es reconnecta en veure-la tancada i el worker que el rebi l'ha de trobar
     EXIT_cleanupDistortionFiles(distortion_context, *exit_distortion, shm_id, sWorkerCountMutex, thread_args->file_type);
     EXIT_cleanupSharedMemory(distortion_context, shm_id, *exit_distortion, sWorkerCountMutex, thread_args->file_type);
+    MC_removeClient(server, client_socket); // Eliminem el socket del fleck de la llista de clients connectats
+    for(int i = 1; i < n_stripe_sockets; i++) MC_removeClient(server, stripe_sockets[i]);
     EXIT_cleanupDistortionContext(&distortion_context);  // Netegem l'estructura de context
+    FRAME_destroyPool(&frame_pool); // Alliberem les trames de la connexió
+    FRAME_destroyReader(&frame_reader);
+    DELTA_freeSignature(&delta_signature);
+    free(basis_path);
     free(args); // Alliberem arguments del thread de distorsió
     return NULL;
 }
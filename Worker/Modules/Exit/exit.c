@@ -34,6 +34,7 @@ void EXIT_freeMemory(WorkerConfig** worker, WorkerServer** server) {
         freePointer((void**)&((*worker)->worker_ip));
         freePointer((void**)&((*worker)->folder_path));
         freePointer((void**)&((*worker)->worker_type));
+        SHAPER_freeConfig(&(*worker)->shaping);
         freePointer((void**)worker);  
     }
     
@@ -41,8 +42,19 @@ void EXIT_freeMemory(WorkerConfig** worker, WorkerServer** server) {
         freePointer((void**)&((*server)->clients));
         freePointer((void**)&((*server)->active_threads));
 
+        //connexions de franja que cap thread de distorsió ha arribat a recollir
+        for (int i = 0; i < (*server)->n_pending_stripes; i++) {
+            close((*server)->pending_stripes[i].socket);
+            freePointer((void**)&((*server)->pending_stripes[i].username));
+            freePointer((void**)&((*server)->pending_stripes[i].filename));
+        }
+        freePointer((void**)&((*server)->pending_stripes));
+
         pthread_mutex_destroy(&(*server)->clients_mutex);
         pthread_mutex_destroy(&(*server)->thread_list_mutex);
+        pthread_mutex_destroy(&(*server)->stripes_mutex);
+        pthread_cond_destroy(&(*server)->stripes_cond);
+        SHAPER_destroy(&(*server)->shaper);
 
         freePointer((void**)server);
     }
@@ -51,23 +63,29 @@ void EXIT_freeMemory(WorkerConfig** worker, WorkerServer** server) {
 /*********************************************** 
 * 
 * @Finalidad: Esperar a que terminen todos los hilos activos almacenados en un array, 
-*             utilizando un mutex para sincronizar el acceso al array. 
+*             utilizando un mutex para sincronizar el acceso al array. Los hilos se esperan 
+*             de uno en uno sin retener el mutex, porque el hilo de una sesión multiplexada 
+*             puede añadir hilos de distorsión mientras tanto (también se esperan). 
 * 
 * @Parámetros: 
-* in: threads = Puntero al array de identificadores de hilos (`pthread_t`). 
-* in: thread_count = Número de hilos activos en el array. 
+* in: threads = Puntero al array de identificadores de hilos (`pthread_t`), que puede crecer. 
+* in: thread_count = Puntero al número de hilos activos en el array. 
 * in: thread_list_mutex = Puntero al mutex utilizado para sincronizar el acceso al array de hilos. 
 * 
 * @Retorno: Ninguno. 
 * 
 ************************************************/
-void EXIT_joinActiveThreads(pthread_t *threads, int thread_count, pthread_mutex_t *thread_list_mutex) {
-    if (threads != NULL) {
+void EXIT_joinActiveThreads(pthread_t **threads, int *thread_count, pthread_mutex_t *thread_list_mutex) {
+    for (int i = 0; ; i++) {
         pthread_mutex_lock(thread_list_mutex);
-        for (int i = 0; i < thread_count; i++) {
-            pthread_join(threads[i], NULL);
+        if (*threads == NULL || i >= *thread_count) {
+            pthread_mutex_unlock(thread_list_mutex);
+            break;
         }
+        pthread_t thread = (*threads)[i];
         pthread_mutex_unlock(thread_list_mutex);
+
+        pthread_join(thread, NULL);
     }
 }
 
@@ -91,7 +109,7 @@ void EXIT_cleanupMainWorker(WorkerServer* server) {
         }
 
         IO_printStatic(STDOUT_FILENO, PURPLE "Waiting for active distortion threads to finish...\n" RESET);
-        EXIT_joinActiveThreads(server->active_threads, server->active_thread_count, &server->thread_list_mutex); // Tanquem sockets de clients en terminar els threads per a no interrommpre cap fase del procés de distorsió
+        EXIT_joinActiveThreads(&server->active_threads, &server->active_thread_count, &server->thread_list_mutex); // Tanquem sockets de clients en terminar els threads per a no interrommpre cap fase del procés de distorsió
         IO_printStatic(STDOUT_FILENO, PURPLE "Distortion threads successfully terminated\n" RESET);
     }
 }
@@ -203,6 +221,11 @@ void EXIT_cleanupSharedMemory(DistortionContext distortion_context, int shm_id,
         distortion_progress->current_stage = distortion_context.current_stage;
         distortion_progress->n_packets = distortion_context.n_packets;
         distortion_progress->n_processed_packets = distortion_context.n_processed_packets;
+        distortion_progress->data_size = distortion_context.data_size;
+        distortion_progress->n_ranges = SACK_toRanges(&distortion_context.received, distortion_progress->ranges, DIST_MAX_RANGES);
+        distortion_progress->n_stripes = distortion_context.n_stripes;
+        memcpy(distortion_progress->stripes, distortion_context.stripes, sizeof(distortion_progress->stripes));
+        distortion_progress->hash = distortion_context.hash;
         
         if (shmdt(distortion_progress) == -1) return;
     }
@@ -225,4 +248,6 @@ void EXIT_cleanupDistortionContext(DistortionContext *context) {
     freePointer((void**)&((context)->md5sum));
     freePointer((void**)&((context)->file_path));
     freePointer((void**)&((context)->username));
+    SACK_freeMap(&(context)->received);
+    MERKLE_free(&(context)->merkle);
 }
\ No newline at end of file
@@ -16,7 +16,7 @@
 //Llibreries del sistema
 #include <stdlib.h>      // malloc, free
 #include <stdio.h>       // perror
-#include <string.h>      // strcmp
+#include <string.h>      // strcmp, memcpy
 #include <unistd.h>      // close, STDOUT_FILENO
 #include <pthread.h>     // pthread_mutex_destroy, pthread_join, pthread_mutex_lock, pthread_mutex_unlock
 #include <sys/ipc.h>     // ftok
@@ -28,6 +28,8 @@
 #include "../../../Libs/File/file.h"                      // Per a les funcions de manipulació de fitxers
 #include "../../../Libs/Dir/dir.h"                      // Per a les funcions de manipulació de fitxers
 #include "../../../Libs/Compress/so_compression.h"
+#include "../../../Libs/Sack/sack.h"                      // Per desar els paquets rebuts a memòria compartida
+#include "../../../Libs/Hash/merkle.h"                    // Per alliberar l'arbre de blocs del fitxer
 
 //.h estructuctures
 #include "../../typeWorker.h"           // Per a les estructures de configuració de Worker
@@ -104,4 +104,114 @@ void MC_addActiveThread(WorkerServer *server, pthread_t thread_id) {
     server->active_threads[server->active_thread_count++] = thread_id;
 
     pthread_mutex_unlock(&server->thread_list_mutex);
-}
\ No newline at end of file
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Registrar una conexión de franja de un fleck (trama 0x13) para que el hilo 
+*             de distorsión del mismo archivo la recoja. Si ya había una de la misma franja 
+*             (e.g., de un intento anterior del fleck que no se llegó a recoger), se cierra. 
+* 
+* @Parámetros: 
+* in/out: server = Puntero a la estructura `WorkerServer` que contiene la lista de franjas pendientes. 
+* in: stripe = Franja a registrar. La lista se queda con sus cadenas. 
+* 
+* @Retorno: 
+*           0 = Franja registrada. 
+*          -1 = Error al asignar memoria (las cadenas de `stripe` no se liberan). 
+* 
+************************************************/
+int MC_addPendingStripe(WorkerServer *server, PendingStripe *stripe) {
+    pthread_mutex_lock(&server->stripes_mutex);
+
+    //si la franja ja estava pendent, la connexió antiga ja no s'utilitzarà
+    for (int i = 0; i < server->n_pending_stripes; i++) {
+        PendingStripe *pending = &server->pending_stripes[i];
+        if (pending->index == stripe->index && !strcmp(pending->username, stripe->username) && !strcmp(pending->filename, stripe->filename)) {
+            MC_removeClient(server, pending->socket);
+            free(pending->username);
+            free(pending->filename);
+            *pending = *stripe;
+            pthread_cond_broadcast(&server->stripes_cond);
+            pthread_mutex_unlock(&server->stripes_mutex);
+            return 0;
+        }
+    }
+
+    PendingStripe *stripes = realloc(server->pending_stripes, (server->n_pending_stripes + 1) * sizeof(PendingStripe));
+    if (stripes == NULL) {
+        pthread_mutex_unlock(&server->stripes_mutex);
+        return -1;
+    }
+    server->pending_stripes = stripes;
+    server->pending_stripes[server->n_pending_stripes++] = *stripe;
+
+    pthread_cond_broadcast(&server->stripes_cond);  //despertem els threads que esperen franges
+    pthread_mutex_unlock(&server->stripes_mutex);
+    return 0;
+}
+
+/*********************************************** 
+* 
+* @Finalidad: Recoger las conexiones de franja (de la 1 a la `n_stripes - 1`) que un fleck 
+*             abre para enviar un archivo, esperando como mucho `STRIPE_JOIN_TIMEOUT` 
+*             segundos a que lleguen todas. Si no llegan todas, se cierran las recogidas. 
+* 
+* @Parámetros: 
+* in/out: server = Puntero a la estructura `WorkerServer` que contiene la lista de franjas pendientes. 
+* in: username = Nombre del usuario del fleck. 
+* in: filename = Nombre del archivo de la distorsión. 
+* out: sockets = Conexiones de las franjas (la posición 0, la conexión principal, no se modifica). 
+* in: n_stripes = Número de franjas acordado con el fleck. 
+* in: exit_distortion = Bandera que indica si se debe interrumpir la espera. 
+* 
+* @Retorno: 
+*           0 = Se han recogido todas las franjas. 
+*          -1 = Alguna franja no ha llegado a tiempo o se ha interrumpido la espera. 
+* 
+************************************************/
+int MC_takePendingStripes(WorkerServer *server, const char *username, const char *filename, int *sockets, int n_stripes, volatile int *exit_distortion) {
+    int n_taken = 0;
+    for (int i = 1; i < n_stripes; i++) sockets[i] = -1;
+
+    //el termini es fixa un cop: cada franja que arriba desperta l'espera abans d'hora
+    struct timespec limit;
+    clock_gettime(CLOCK_REALTIME, &limit);
+    limit.tv_sec += STRIPE_JOIN_TIMEOUT;
+
+    pthread_mutex_lock(&server->stripes_mutex);
+    while (!*exit_distortion) {
+        //traiem de la llista les franges d'aquesta distorsió que ja han arribat
+        for (int i = 0; i < server->n_pending_stripes; ) {
+            PendingStripe *pending = &server->pending_stripes[i];
+            if (pending->index < n_stripes && sockets[pending->index] == -1 && !strcmp(pending->username, username) && !strcmp(pending->filename, filename)) {
+                sockets[pending->index] = pending->socket;
+                free(pending->username);
+                free(pending->filename);
+                server->pending_stripes[i] = server->pending_stripes[--server->n_pending_stripes];
+                n_taken++;
+                continue;
+            }
+            i++;
+        }
+        if (n_taken == n_stripes - 1) break;
+
+        //esperem la següent franja en intervals d'un segon per poder llegir la flag de sortida
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        if (deadline.tv_sec > limit.tv_sec || (deadline.tv_sec == limit.tv_sec && deadline.tv_nsec >= limit.tv_nsec)) break;
+        deadline.tv_sec++;
+        if (deadline.tv_sec > limit.tv_sec || (deadline.tv_sec == limit.tv_sec && deadline.tv_nsec > limit.tv_nsec)) deadline = limit;
+        pthread_cond_timedwait(&server->stripes_cond, &server->stripes_mutex, &deadline);
+    }
+    pthread_mutex_unlock(&server->stripes_mutex);
+
+    if (n_taken == n_stripes - 1) return 0;
+
+    //sense totes les franges el fitxer es rep per la connexió principal
+    for (int i = 1; i < n_stripes; i++) {
+        if (sockets[i] != -1) MC_removeClient(server, sockets[i]);
+        sockets[i] = -1;
+    }
+    return -1;
+}
@@ -16,6 +16,8 @@
 #include <stdlib.h>       // malloc, realloc, free
 #include <pthread.h>      // pthread_mutex_lock, pthread_mutex_unlock, pthread_t
 #include <unistd.h>       // close
+#include <string.h>       // strcmp
+#include <time.h>         // clock_gettime
 
 //Llibreries pròpies
 #include "../../../Libs/IO/io.h"                          // Per a les funcions d'entrada/sortida
@@ -66,4 +68,42 @@ void MC_removeClient(WorkerServer *server, int client_socket);
 * 
 ************************************************/
 void MC_addActiveThread(WorkerServer *server, pthread_t thread_id);
+
+/*********************************************** 
+* 
+* @Finalidad: Registrar una conexión de franja de un fleck (trama 0x13) para que el hilo 
+*             de distorsión del mismo archivo la recoja. Si ya había una de la misma franja 
+*             (e.g., de un intento anterior del fleck que no se llegó a recoger), se cierra. 
+* 
+* @Parámetros: 
+* in/out: server = Puntero a la estructura `WorkerServer` que contiene la lista de franjas pendientes. 
+* in: stripe = Franja a registrar. La lista se queda con sus cadenas. 
+* 
+* @Retorno: 
+*           0 = Franja registrada. 
+*          -1 = Error al asignar memoria (las cadenas de `stripe` no se liberan). 
+* 
+************************************************/
+int MC_addPendingStripe(WorkerServer *server, PendingStripe *stripe);
+
+/*********************************************** 
+* 
+* @Finalidad: Recoger las conexiones de franja (de la 1 a la `n_stripes - 1`) que un fleck 
+*             abre para enviar un archivo, esperando como mucho `STRIPE_JOIN_TIMEOUT` 
+*             segundos a que lleguen todas. Si no llegan todas, se cierran las recogidas. 
+* 
+* @Parámetros: 
+* in/out: server = Puntero a la estructura `WorkerServer` que contiene la lista de franjas pendientes. 
+* in: username = Nombre del usuario del fleck. 
+* in: filename = Nombre del archivo de la distorsión. 
+* out: sockets = Conexiones de las franjas (la posición 0, la conexión principal, no se modifica). 
+* in: n_stripes = Número de franjas acordado con el fleck. 
+* in: exit_distortion = Bandera que indica si se debe interrumpir la espera. 
+* 
+* @Retorno: 
+*           0 = Se han recogido todas las franjas. 
+*          -1 = Alguna franja no ha llegado a tiempo o se ha interrumpido la espera. 
+* 
+************************************************/
+int MC_takePendingStripes(WorkerServer *server, const char *username, const char *filename, int *sockets, int n_stripes, volatile int *exit_distortion);
 #endif // _MANAGE_CLIENT_WORKER_H_
\ No newline at end of file
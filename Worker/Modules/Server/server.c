@@ -30,10 +30,15 @@ int SRV_initWorkerServer(WorkerServer *server, WorkerConfig *config) {
     //inicialitzem estructures dinàmiques a null per si falla alguna de les següents operacions que al fer el free memory no s'intenti alliberar memòria que no s'ha demanat
     server->active_threads = NULL;
     server->clients = NULL; 
+    server->pending_stripes = NULL;
+    server->n_pending_stripes = 0;
 
     //inicialitzem mutex's per si falla alguna de les següents operacions que el freeMemory no intenti destruir un mutex no inicialitzat
     pthread_mutex_init(&server->thread_list_mutex, NULL); 
     pthread_mutex_init(&server->clients_mutex, NULL);
+    pthread_mutex_init(&server->stripes_mutex, NULL);
+    pthread_cond_init(&server->stripes_cond, NULL);
+    SHAPER_init(&server->shaper, &config->shaping);
 
     //inicialitzm socket d'escolta de flecks
     server->listen_socket = SOCKET_initListenSocket(config->worker_ip, config->worker_port, MAX_CLIENTS);
@@ -41,6 +46,10 @@ int SRV_initWorkerServer(WorkerServer *server, WorkerConfig *config) {
         return -1;
     }
     server->n_clients = 0;
+    server->window_size = config->window_size;
+    server->capabilities = config->capabilities;
+    server->io_engine = config->io_engine;
+    server->multiplex = config->socket_options.multiplex;
 
     server->clients = (int*) malloc(sizeof(int));
     if(server->clients == NULL) {
@@ -14,9 +14,13 @@
 #define STAGE_FINISHED      5
 
 #define MAX_CLIENTS 10
+#define STRIPE_JOIN_TIMEOUT 5   // Segons que s'esperen les connexions de franja d'un fleck abans de rebre el fitxer per una sola connexió
 
 //Llibreries pròpies
 #include "../Libs/Semaphore/semaphore_v2.h"                   // Per a les funcions de semàfors
+#include "../Libs/Structure/typeConnection.h"                 // Per a la mida de finestra per defecte
+#include "../Libs/Shaper/shaper.h"                            // Per als límits d'amplada de banda
+#include "../Libs/Socket/socket.h"                            // Per a les opcions TCP
 
 typedef struct {
     char* gotham_ip; 
@@ -25,8 +29,21 @@ typedef struct {
     int worker_port; 
     char* folder_path;
     char* worker_type;
+    int window_size;        // Trames de fitxer en vol sense ACK (línia opcional "window <trames>", CONN_DEFAULT_WINDOW_SIZE si no hi és)
+    int statistics;         // 1 = es mostren les opcions en arrencar i les mesures de cada transferència (línia opcional "stats on", 0 si no hi és)
+    int capabilities;       // Capacitats CONN_CAP_* que s'ofereixen (ACK selectius i MD5 final sempre, compressió amb la línia opcional "compression on")
+    int io_engine;          // Motor d'E/S CONN_IO_* de les transferències (línia opcional "io_engine io_uring", crides al sistema si no hi és)
+    ShaperConfig shaping;   // Límits d'amplada de banda (línies opcionals "ingress <MB/s>", "egress <MB/s>" i "share <usuari> <pes>", sense límit si no hi són)
+    SocketOptions socket_options;   // Opcions TCP (línies opcionals "nodelay", "quickack", "buffer", "link", "keepalive", "fastopen", "connect_timeout", "connect_stagger", "shm" i "multiplex", en qualsevol ordre; SOCKET_DEFAULT_OPTIONS si no hi són)
 } WorkerConfig;
 
+typedef struct {
+    char* username;         // Fleck i fitxer de la distorsió a què s'afegeix la connexió
+    char* filename;
+    int index;              // Franja que transportarà (1..CONN_MAX_STRIPES-1)
+    int socket;
+} PendingStripe;            // Connexió de franja d'un fleck que espera que el thread de la seva distorsió la reculli
+
 typedef struct {
     int listen_socket;
     int n_clients; 
@@ -35,6 +52,15 @@ typedef struct {
     pthread_t* active_threads;
     int active_thread_count;
     pthread_mutex_t thread_list_mutex;
+    int window_size;        // Finestra d'enviament configurada que fan servir els threads de distorsió
+    int capabilities;       // Capacitats CONN_CAP_* configurades que els threads de distorsió ofereixen als flecks
+    int io_engine;          // Motor d'E/S CONN_IO_* configurat amb què els threads de distorsió envien i reben els fitxers
+    int multiplex;          // 1 = s'accepten sessions multiplexades (trama 0x1C), amb una distorsió per stream
+    Shaper shaper;          // Repartiment de l'amplada de banda configurada entre els usuaris que transfereixen fitxers
+    PendingStripe* pending_stripes;     // Connexions de franja pendents de recollir
+    int n_pending_stripes;
+    pthread_mutex_t stripes_mutex;
+    pthread_cond_t stripes_cond;        // S'avisa cada vegada que arriba una connexió de franja
 } WorkerServer;
 
 typedef struct {